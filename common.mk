@@ -33,6 +33,9 @@ endif
 
 ifneq (,$(filter userdebug eng, $(TARGET_BUILD_VARIANT)))
     common_flags += -DUSER_DEBUG
+    ifneq ($(TARGET_DISABLE_FRAME_TRACE), true)
+        common_flags += -DFRAME_TRACE_ENABLE
+    endif
 endif
 
 ifeq ($(LLVM_SA), true)
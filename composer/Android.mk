@@ -21,7 +21,7 @@ LOCAL_SHARED_LIBRARIES        := libhistogram libbinder libhardware libutils lib
                                  libc++ liblog libhidlbase \
                                  liblog libfmq libhardware_legacy \
                                  libsdmcore libqservice libqdutils libqdMetaData \
-                                 libdisplaydebug libsdmutils libgrallocutils libui \
+                                 libdisplaydebug libsdmutils libgrallocutils libui liblayertrace \
                                  libgpu_tonemapper libEGL libGLESv2 libGLESv3 \
                                  vendor.qti.hardware.display.composer@3.0 \
                                  android.hardware.graphics.composer@2.1 \
@@ -45,9 +45,11 @@ LOCAL_SRC_FILES               := QtiComposer.cpp QtiComposerClient.cpp service.c
                                  hwc_display_pluggable.cpp \
                                  hwc_display_dummy.cpp \
                                  hwc_display_pluggable_test.cpp \
+                                 hwc_test_pattern.cpp \
                                  hwc_display_virtual.cpp \
                                  hwc_debugger.cpp \
                                  hwc_buffer_sync_handler.cpp \
+                                 hwc_capture_scheduler.cpp \
                                  hwc_color_manager.cpp \
                                  hwc_layers.cpp \
                                  hwc_callbacks.cpp \
@@ -77,3 +79,28 @@ LOCAL_VINTF_FRAGMENTS         := vendor.qti.hardware.display.composer-service-lo
 endif
 
 include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := hwc_composer_test
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes) $(kernel_includes)
+LOCAL_HEADER_LIBRARIES        := display_headers
+LOCAL_CFLAGS                  := -fno-operator-names -Wno-unused-parameter -DLOG_TAG=\"SDM\" \
+                                 $(common_flags)
+LOCAL_SRC_FILES               := hwc_test_pattern.cpp \
+                                 hwc_test_pattern_test.cpp \
+                                 hwc_debugger.cpp \
+                                 cpuhint.cpp \
+                                 cpuhint_test.cpp \
+                                 hwc_capture_scheduler.cpp \
+                                 hwc_capture_scheduler_test.cpp \
+                                 QtiComposerHandleImporter.cpp \
+                                 QtiComposerHandleImporter_test.cpp
+LOCAL_STATIC_LIBRARIES        := libgtest libgtest_main
+LOCAL_SHARED_LIBRARIES        := libdisplaydebug libsdmutils libcutils libutils liblog libdl \
+                                 libhidlbase android.hardware.graphics.mapper@2.0 \
+                                 android.hardware.graphics.mapper@3.0
+
+include $(BUILD_EXECUTABLE)
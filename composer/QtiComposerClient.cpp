@@ -17,6 +17,7 @@
  * limitations under the License.
  */
 
+#include <utils/frame_trace.h>
 #include <vector>
 #include <string>
 
@@ -1251,6 +1252,7 @@ bool QtiComposerClient::CommandReader::parseCommonCmd(
 Error QtiComposerClient::CommandReader::parse() {
   IQtiComposerClient::Command qticommand;
   uint16_t length;
+  FRAME_TRACE_SCOPED(-1, sdm::kFrameTraceCommands);
 
   while (!isEmpty()) {
     if (!beginCommand(qticommand, length)) {
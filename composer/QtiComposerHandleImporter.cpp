@@ -17,7 +17,10 @@
  * limitations under the License.
  */
 
+#include <gralloc_priv.h>
+#include <inttypes.h>
 #include <log/log.h>
+#include <sys/stat.h>
 
 #include "QtiComposerHandleImporter.h"
 
@@ -52,7 +55,20 @@ void ComposerHandleImporter::initialize() {
   return;
 }
 
+void ComposerHandleImporter::initialize(const sp<IMapperV3> &mapper) {
+  Mutex::Autolock lock(mLock);
+  mMapper_V3 = mapper;
+  mMapper_V2.clear();
+  mInitialized = (mapper != nullptr);
+}
+
 void ComposerHandleImporter::cleanup() {
+  Stats stats = getStats();
+  ALOGI("%s: imports %" PRIu64 " cache hits %" PRIu64 " mapper imports %" PRIu64
+        " mapper frees %" PRIu64, __FUNCTION__, stats.imports, stats.cacheHits,
+        stats.mapperImports, stats.mapperFrees);
+
+  Mutex::Autolock lock(mLock);
   if (mMapper_V3 != nullptr) {
     mMapper_V3.clear();
   } else {
@@ -61,6 +77,38 @@ void ComposerHandleImporter::cleanup() {
   mInitialized = false;
 }
 
+// Returns the gralloc buffer id and the identity of its fd, false for handles that are not
+// gralloc buffers and so are not cached.
+static bool getBufferIdentity(buffer_handle_t handle, uint64_t *id, struct stat *st) {
+  if (private_handle_t::validate(handle)) {
+    return false;
+  }
+
+  const private_handle_t *hnd = static_cast<const private_handle_t *>(handle);
+  if (fstat(hnd->fd, st)) {
+    return false;
+  }
+
+  *id = hnd->id;
+  return true;
+}
+
+bool ComposerHandleImporter::getMappers(sp<IMapperV2> *mapperV2, sp<IMapperV3> *mapperV3) {
+  Mutex::Autolock lock(mLock);
+  if (!mInitialized) {
+    initialize();
+  }
+
+  *mapperV2 = mMapper_V2;
+  *mapperV3 = mMapper_V3;
+  if (*mapperV3 == nullptr && *mapperV2 == nullptr) {
+    ALOGE("%s: mMapper is null!", __FUNCTION__);
+    return false;
+  }
+
+  return true;
+}
+
 // In IComposer, any buffer_handle_t is owned by the caller and we need to
 // make a clone for hwcomposer2.  We also need to translate empty handle
 // to nullptr.  This function does that, in-place.
@@ -74,21 +122,93 @@ bool ComposerHandleImporter::importBuffer(buffer_handle_t& handle) {
     return true;
   }
 
-  Mutex::Autolock lock(mLock);
-  if (!mInitialized) {
-    initialize();
+  mImports++;
+
+  uint64_t id = 0;
+  struct stat st = {};
+  if (!getBufferIdentity(handle, &id, &st)) {
+    return importWithMapper(handle);
   }
 
-  if (mMapper_V3 == nullptr && mMapper_V2 == nullptr) {
-    ALOGE("%s: mMapper is null!", __FUNCTION__);
+  // Fast path: the buffer is already imported for another slot or layer, share its clone.
+  CacheShard &shard = getShard(id);
+  {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto it = shard.entries.find(id);
+    if (it != shard.entries.end() && it->second.dev == st.st_dev && it->second.ino == st.st_ino) {
+      it->second.refCount++;
+      handle = it->second.handle;
+      mCacheHits++;
+      return true;
+    }
+  }
+
+  buffer_handle_t importedHandle = handle;
+  if (!importWithMapper(importedHandle)) {
     return false;
   }
 
-  if (mMapper_V3 != nullptr) {
+  buffer_handle_t duplicate = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto it = shard.entries.find(id);
+    if (it == shard.entries.end()) {
+      CacheEntry &entry = shard.entries[id];
+      entry.handle = importedHandle;
+      entry.refCount = 1;
+      entry.dev = st.st_dev;
+      entry.ino = st.st_ino;
+    } else if (it->second.dev == st.st_dev && it->second.ino == st.st_ino) {
+      // Another thread imported the same buffer meanwhile, keep a single clone.
+      it->second.refCount++;
+      duplicate = importedHandle;
+      importedHandle = it->second.handle;
+    }
+    // Otherwise the id is held by a different buffer, the clone stays uncached.
+  }
+
+  if (duplicate) {
+    freeWithMapper(duplicate);
+  }
+
+  handle = importedHandle;
+  return true;
+}
+
+void ComposerHandleImporter::freeBuffer(buffer_handle_t handle) {
+  if (!handle) {
+    return;
+  }
+
+  if (!private_handle_t::validate(handle)) {
+    CacheShard &shard = getShard(static_cast<const private_handle_t *>(handle)->id);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto it = shard.entries.find(static_cast<const private_handle_t *>(handle)->id);
+    if (it != shard.entries.end() && it->second.handle == handle) {
+      if (--it->second.refCount) {
+        return;
+      }
+      shard.entries.erase(it);
+    }
+  }
+
+  freeWithMapper(handle);
+}
+
+bool ComposerHandleImporter::importWithMapper(buffer_handle_t& handle) {
+  sp<IMapperV2> mapperV2;
+  sp<IMapperV3> mapperV3;
+  if (!getMappers(&mapperV2, &mapperV3)) {
+    return false;
+  }
+
+  mMapperImports++;
+
+  if (mapperV3 != nullptr) {
     MapperV3Error error;
     buffer_handle_t importedHandle;
 
-    auto ret = mMapper_V3->importBuffer(
+    auto ret = mapperV3->importBuffer(
         hidl_handle(handle),
         [&](const auto &tmpError, const auto &tmpBufferHandle) {
           error = tmpError;
@@ -109,7 +229,7 @@ bool ComposerHandleImporter::importBuffer(buffer_handle_t& handle) {
     MapperV2Error error;
     buffer_handle_t importedHandle;
 
-    auto ret = mMapper_V2->importBuffer(
+    auto ret = mapperV2->importBuffer(
         hidl_handle(handle),
         [&](const auto &tmpError, const auto &tmpBufferHandle) {
           error = tmpError;
@@ -131,30 +251,44 @@ bool ComposerHandleImporter::importBuffer(buffer_handle_t& handle) {
   return true;
 }
 
-void ComposerHandleImporter::freeBuffer(buffer_handle_t handle) {
-  if (!handle) {
-    return;
+void ComposerHandleImporter::freeWithMapper(buffer_handle_t handle) {
+  sp<IMapperV2> mapperV2;
+  sp<IMapperV3> mapperV3;
+  {
+    Mutex::Autolock lock(mLock);
+    mapperV2 = mMapper_V2;
+    mapperV3 = mMapper_V3;
   }
 
-  Mutex::Autolock lock(mLock);
-
-  if (mMapper_V3 == nullptr && mMapper_V2 == nullptr) {
+  if (mapperV3 == nullptr && mapperV2 == nullptr) {
     ALOGE("%s: mMapper is null!", __FUNCTION__);
     return;
   }
 
-  if (mMapper_V3 != nullptr) {
-    auto ret = mMapper_V3->freeBuffer(const_cast<native_handle_t *>(handle));
+  mMapperFrees++;
+
+  if (mapperV3 != nullptr) {
+    auto ret = mapperV3->freeBuffer(const_cast<native_handle_t *>(handle));
     if (!ret.isOk()) {
       ALOGE("%s: mapper freeBuffer failed: %s", __FUNCTION__, ret.description().c_str());
     }
   } else {
-    auto ret = mMapper_V2->freeBuffer(const_cast<native_handle_t *>(handle));
+    auto ret = mapperV2->freeBuffer(const_cast<native_handle_t *>(handle));
     if (!ret.isOk()) {
-      ALOGE("%s: mapper freeBuffer failed: %s", __FUNCTION__, ret.description().c_str()); }
+      ALOGE("%s: mapper freeBuffer failed: %s", __FUNCTION__, ret.description().c_str());
+    }
   }
 }
 
+ComposerHandleImporter::Stats ComposerHandleImporter::getStats() const {
+  Stats stats;
+  stats.imports = mImports;
+  stats.cacheHits = mCacheHits;
+  stats.mapperImports = mMapperImports;
+  stats.mapperFrees = mMapperFrees;
+  return stats;
+}
+
 }  // namespace V3_0
 }  // namespace composer
 }  // namespace display
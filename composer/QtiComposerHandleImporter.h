@@ -22,8 +22,13 @@
 
 #include <android/hardware/graphics/mapper/2.0/IMapper.h>
 #include <android/hardware/graphics/mapper/3.0/IMapper.h>
+#include <sys/types.h>
 #include <utils/Mutex.h>
 
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
 namespace vendor {
 namespace qti {
 namespace hardware {
@@ -39,21 +44,57 @@ using ::android::hardware::hidl_handle;
 
 class ComposerHandleImporter {
  public:
+  struct Stats {
+    uint64_t imports = 0;        // importBuffer calls with a non-empty handle
+    uint64_t cacheHits = 0;      // imports served from the cache
+    uint64_t mapperImports = 0;  // imports that went to the mapper
+    uint64_t mapperFrees = 0;    // frees that went to the mapper
+  };
+
   ComposerHandleImporter();
 
   // In IComposer, any buffer_handle_t is owned by the caller and we need to
   // make a clone for hwcomposer2.  We also need to translate empty handle
   // to nullptr.  This function does that, in-place.
+  // A gralloc buffer that is already imported, e.g. for another slot or layer, gets the same
+  // clone back with its reference count raised. Every import must be paired with a freeBuffer.
   bool importBuffer(buffer_handle_t& handle);
   void freeBuffer(buffer_handle_t handle);
   void initialize();
+  // Uses the given mapper instead of the mapper service, e.g. a fake one in tests.
+  void initialize(const sp<IMapperV3> &mapper);
   void cleanup();
+  Stats getStats() const;
 
  private:
+  struct CacheEntry {
+    buffer_handle_t handle = nullptr;  // Clone returned by the mapper
+    uint32_t refCount = 0;
+    dev_t dev = 0;  // Identity of the buffer fd, guards against a reused buffer id
+    ino_t ino = 0;
+  };
+
+  struct CacheShard {
+    std::mutex lock;
+    std::unordered_map<uint64_t, CacheEntry> entries;
+  };
+
+  static const uint32_t kNumShards = 16;
+
+  bool getMappers(sp<IMapperV2> *mapperV2, sp<IMapperV3> *mapperV3);
+  bool importWithMapper(buffer_handle_t& handle);
+  void freeWithMapper(buffer_handle_t handle);
+  CacheShard &getShard(uint64_t id) { return mShards[id % kNumShards]; }
+
   Mutex mLock;
   bool mInitialized = false;
   sp<IMapperV2> mMapper_V2;
   sp<IMapperV3> mMapper_V3;
+  CacheShard mShards[kNumShards];
+  std::atomic<uint64_t> mImports{0};
+  std::atomic<uint64_t> mCacheHits{0};
+  std::atomic<uint64_t> mMapperImports{0};
+  std::atomic<uint64_t> mMapperFrees{0};
 };
 
 }  // namespace V3_0
@@ -0,0 +1,360 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cutils/native_handle.h>
+#include <fcntl.h>
+#include <gralloc_priv.h>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "QtiComposerHandleImporter.h"
+
+using namespace vendor::qti::hardware::display::composer::V3_0;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+using ::android::hardware::graphics::mapper::V3_0::Error;
+
+namespace {
+
+// Clones handles the way gralloc does, duplicating their fds, and checks that every clone is
+// freed exactly once.
+class FakeMapper : public IMapperV3 {
+ public:
+  Return<void> createDescriptor(const BufferDescriptorInfo &info,
+                                createDescriptor_cb hidl_cb) override {
+    hidl_cb(Error::UNSUPPORTED, {});
+    return Void();
+  }
+
+  Return<void> importBuffer(const hidl_handle &raw_handle, importBuffer_cb hidl_cb) override {
+    const native_handle_t *handle = raw_handle.getNativeHandle();
+    imports_++;
+    if (fail_imports_) {
+      hidl_cb(Error::BAD_BUFFER, nullptr);
+      return Void();
+    }
+
+    native_handle_t *clone = nullptr;
+    bool gralloc = !private_handle_t::validate(handle);
+    if (gralloc) {
+      auto hnd = new private_handle_t(*static_cast<const private_handle_t *>(handle));
+      hnd->fd = dup(hnd->fd);
+      hnd->fd_metadata = dup(hnd->fd_metadata);
+      clone = hnd;
+    } else {
+      clone = native_handle_clone(handle);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      live_[clone] = gralloc;
+    }
+    hidl_cb(Error::NONE, clone);
+    return Void();
+  }
+
+  Return<Error> freeBuffer(void *buffer) override {
+    auto handle = static_cast<native_handle_t *>(buffer);
+    bool gralloc = false;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      auto it = live_.find(handle);
+      if (it == live_.end()) {
+        ADD_FAILURE() << "Freed a handle that is not live";
+        return Error::BAD_BUFFER;
+      }
+      gralloc = it->second;
+      live_.erase(it);
+    }
+
+    frees_++;
+    if (gralloc) {
+      auto hnd = static_cast<private_handle_t *>(handle);
+      close(hnd->fd);
+      close(hnd->fd_metadata);
+      delete hnd;
+    } else {
+      native_handle_close(handle);
+      native_handle_delete(handle);
+    }
+    return Error::NONE;
+  }
+
+  Return<Error> validateBufferSize(void *buffer, const BufferDescriptorInfo &info,
+                                   uint32_t stride) override {
+    return Error::UNSUPPORTED;
+  }
+
+  Return<void> getTransportSize(void *buffer, getTransportSize_cb hidl_cb) override {
+    hidl_cb(Error::UNSUPPORTED, 0, 0);
+    return Void();
+  }
+
+  Return<void> lock(void *buffer, uint64_t cpu_usage, const Rect &access_region,
+                    const hidl_handle &acquire_fence, lock_cb hidl_cb) override {
+    hidl_cb(Error::UNSUPPORTED, nullptr, 0, 0);
+    return Void();
+  }
+
+  Return<void> lockYCbCr(void *buffer, uint64_t cpu_usage, const Rect &access_region,
+                         const hidl_handle &acquire_fence, lockYCbCr_cb hidl_cb) override {
+    hidl_cb(Error::UNSUPPORTED, {});
+    return Void();
+  }
+
+  Return<void> unlock(void *buffer, unlock_cb hidl_cb) override {
+    hidl_cb(Error::UNSUPPORTED, hidl_handle());
+    return Void();
+  }
+
+  Return<void> isSupported(const BufferDescriptorInfo &info, isSupported_cb hidl_cb) override {
+    hidl_cb(Error::NONE, false);
+    return Void();
+  }
+
+  size_t Live() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return live_.size();
+  }
+
+  std::atomic<uint32_t> imports_{0};
+  std::atomic<uint32_t> frees_{0};
+  std::atomic<bool> fail_imports_{false};
+
+ private:
+  std::mutex lock_;
+  std::map<const native_handle_t *, bool> live_;
+};
+
+class ComposerHandleImporterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_NE(nullptr, mkdtemp(dir_));
+    mapper_ = new FakeMapper();
+    importer_.initialize(mapper_);
+  }
+
+  void TearDown() override {
+    importer_.cleanup();
+    for (auto &buffer : buffers_) {
+      close(buffer->fd);
+      close(buffer->fd_metadata);
+    }
+    for (auto &path : paths_) {
+      unlink(path.c_str());
+    }
+    rmdir(dir_);
+  }
+
+  // A gralloc buffer backed by a file of its own, so its fd identity differs from every other
+  // buffer made here.
+  const private_handle_t *MakeBuffer(uint64_t id) {
+    std::string path = std::string(dir_) + "/buffer" + std::to_string(paths_.size());
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    int meta_fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    paths_.push_back(path);
+    buffers_.emplace_back(new private_handle_t(fd, meta_fd, 0, 64, 64, 64, 64,
+                                               HAL_PIXEL_FORMAT_RGBA_8888, 0, 16384));
+    buffers_.back()->id = id;
+    return buffers_.back().get();
+  }
+
+  char dir_[32] = "/tmp/handle_importer_XXXXXX";
+  std::vector<std::string> paths_;
+  std::vector<std::unique_ptr<private_handle_t>> buffers_;
+  android::sp<FakeMapper> mapper_;
+  ComposerHandleImporter importer_;
+};
+
+}  // namespace
+
+TEST_F(ComposerHandleImporterTest, SharesCloneAcrossSlots) {
+  const private_handle_t *buffer = MakeBuffer(1);
+  buffer_handle_t slot0 = buffer;
+  buffer_handle_t slot1 = buffer;
+  ASSERT_TRUE(importer_.importBuffer(slot0));
+  ASSERT_TRUE(importer_.importBuffer(slot1));
+  EXPECT_NE(buffer, slot0);
+  EXPECT_EQ(slot0, slot1);
+  EXPECT_EQ(1u, mapper_->imports_);
+
+  // The clone stays until the last slot lets go of it.
+  importer_.freeBuffer(slot0);
+  EXPECT_EQ(1u, mapper_->Live());
+  importer_.freeBuffer(slot1);
+  EXPECT_EQ(0u, mapper_->Live());
+
+  ComposerHandleImporter::Stats stats = importer_.getStats();
+  EXPECT_EQ(2u, stats.imports);
+  EXPECT_EQ(1u, stats.cacheHits);
+  EXPECT_EQ(1u, stats.mapperImports);
+  EXPECT_EQ(1u, stats.mapperFrees);
+}
+
+TEST_F(ComposerHandleImporterTest, KeepsBuffersApart) {
+  buffer_handle_t first = MakeBuffer(1);
+  buffer_handle_t second = MakeBuffer(2);
+  ASSERT_TRUE(importer_.importBuffer(first));
+  ASSERT_TRUE(importer_.importBuffer(second));
+  EXPECT_NE(first, second);
+  EXPECT_EQ(2u, mapper_->Live());
+
+  importer_.freeBuffer(first);
+  importer_.freeBuffer(second);
+  EXPECT_EQ(0u, mapper_->Live());
+}
+
+TEST_F(ComposerHandleImporterTest, ReusedIdGetsItsOwnClone) {
+  // gralloc ids are only unique among live buffers of one process; a buffer from elsewhere may
+  // carry the id of one still imported here.
+  buffer_handle_t original = MakeBuffer(5);
+  buffer_handle_t reused = MakeBuffer(5);
+  ASSERT_TRUE(importer_.importBuffer(original));
+  ASSERT_TRUE(importer_.importBuffer(reused));
+  EXPECT_NE(original, reused);
+  EXPECT_EQ(2u, mapper_->imports_);
+
+  int original_fd = static_cast<const private_handle_t *>(original)->fd;
+  int reused_fd = static_cast<const private_handle_t *>(reused)->fd;
+  struct stat original_st = {}, reused_st = {};
+  ASSERT_EQ(0, fstat(original_fd, &original_st));
+  ASSERT_EQ(0, fstat(reused_fd, &reused_st));
+  EXPECT_NE(original_st.st_ino, reused_st.st_ino);
+
+  importer_.freeBuffer(reused);
+  EXPECT_EQ(1u, mapper_->Live());
+  importer_.freeBuffer(original);
+  EXPECT_EQ(0u, mapper_->Live());
+}
+
+TEST_F(ComposerHandleImporterTest, ReusedIdAfterFreeIsImportedAgain) {
+  buffer_handle_t original = MakeBuffer(5);
+  ASSERT_TRUE(importer_.importBuffer(original));
+  importer_.freeBuffer(original);
+
+  const private_handle_t *buffer = MakeBuffer(5);
+  buffer_handle_t reused = buffer;
+  ASSERT_TRUE(importer_.importBuffer(reused));
+  EXPECT_EQ(2u, mapper_->imports_);
+  EXPECT_EQ(buffer->size, static_cast<const private_handle_t *>(reused)->size);
+  importer_.freeBuffer(reused);
+  EXPECT_EQ(0u, mapper_->Live());
+}
+
+TEST_F(ComposerHandleImporterTest, TranslatesEmptyHandles) {
+  buffer_handle_t null_handle = nullptr;
+  EXPECT_TRUE(importer_.importBuffer(null_handle));
+  EXPECT_EQ(nullptr, null_handle);
+
+  native_handle_t *empty = native_handle_create(0, 0);
+  buffer_handle_t empty_handle = empty;
+  EXPECT_TRUE(importer_.importBuffer(empty_handle));
+  EXPECT_EQ(nullptr, empty_handle);
+  EXPECT_EQ(0u, mapper_->imports_);
+  native_handle_delete(empty);
+}
+
+TEST_F(ComposerHandleImporterTest, DoesNotCacheOtherHandles) {
+  native_handle_t *raw = native_handle_create(0, 2);
+  buffer_handle_t first = raw;
+  buffer_handle_t second = raw;
+  ASSERT_TRUE(importer_.importBuffer(first));
+  ASSERT_TRUE(importer_.importBuffer(second));
+  EXPECT_NE(first, second);
+  EXPECT_EQ(2u, mapper_->imports_);
+
+  importer_.freeBuffer(first);
+  importer_.freeBuffer(second);
+  EXPECT_EQ(0u, mapper_->Live());
+  native_handle_delete(raw);
+}
+
+TEST_F(ComposerHandleImporterTest, FailedImportIsNotCached) {
+  const private_handle_t *buffer = MakeBuffer(1);
+  buffer_handle_t handle = buffer;
+  mapper_->fail_imports_ = true;
+  EXPECT_FALSE(importer_.importBuffer(handle));
+
+  mapper_->fail_imports_ = false;
+  handle = buffer;
+  ASSERT_TRUE(importer_.importBuffer(handle));
+  EXPECT_NE(buffer, handle);
+  importer_.freeBuffer(handle);
+  EXPECT_EQ(0u, mapper_->Live());
+}
+
+TEST_F(ComposerHandleImporterTest, ConcurrentImportAndFree) {
+  const uint32_t kThreads = 8;
+  const uint32_t kBuffers = 32;
+  const uint32_t kIterations = 2000;
+  std::vector<const private_handle_t *> buffers;
+  for (uint32_t i = 0; i < kBuffers; i++) {
+    buffers.push_back(MakeBuffer(100 + i));
+  }
+
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t] {
+      // Each thread holds a few slots at a time, like layers of several displays.
+      std::vector<buffer_handle_t> held;
+      for (uint32_t n = 0; n < kIterations; n++) {
+        buffer_handle_t handle = buffers[(n * 7 + t) % kBuffers];
+        ASSERT_TRUE(importer_.importBuffer(handle));
+        held.push_back(handle);
+        if (held.size() == 3) {
+          for (auto &imported : held) {
+            importer_.freeBuffer(imported);
+          }
+          held.clear();
+        }
+      }
+      for (auto &imported : held) {
+        importer_.freeBuffer(imported);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(0u, mapper_->Live());
+  ComposerHandleImporter::Stats stats = importer_.getStats();
+  EXPECT_EQ(kThreads * kIterations, stats.imports);
+  EXPECT_EQ(stats.mapperImports, stats.mapperFrees);
+  EXPECT_EQ(stats.mapperImports, mapper_->imports_);
+}
@@ -29,7 +29,12 @@
 
 #include <cutils/properties.h>
 #include <dlfcn.h>
+#include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/Timers.h>
+
+#include <algorithm>
+#include <utility>
 
 #include "cpuhint.h"
 #include "hwc_debugger.h"
@@ -38,13 +43,122 @@
 
 namespace sdm {
 
-DisplayError CPUHint::Init(HWCDebugHandler *debug_handler) {
-  char path[PROPERTY_VALUE_MAX];
-  if (debug_handler->GetProperty("ro.vendor.extension_library", path) != kErrorNone) {
-    DLOGI("Vendor Extension Library not enabled");
-    return kErrorNotSupported;
+class PerfLockBackend : public CPUBoostBackend {
+ public:
+  bool Load(const char *path);
+  bool Acquire(uint32_t duration_ms) override;
+  void Release() override;
+
+ private:
+  enum { HINT =  0x4501 /* 45-display layer hint, 01-Enable */ };
+  int lock_handle_ = 0;
+  DynLib vendor_ext_lib_;
+  int (*fn_lock_acquire_)(int handle, int duration, int *hints, int num_args) = NULL;
+  int (*fn_lock_release_)(int value) = NULL;
+};
+
+bool PerfLockBackend::Load(const char *path) {
+  if (!vendor_ext_lib_.Open(path)) {
+    DLOGW("Failed to open %s : %s", path, vendor_ext_lib_.Error());
+    return false;
+  }
+
+  if (!vendor_ext_lib_.Sym("perf_lock_acq", reinterpret_cast<void **>(&fn_lock_acquire_)) ||
+      !vendor_ext_lib_.Sym("perf_lock_rel", reinterpret_cast<void **>(&fn_lock_release_))) {
+    DLOGW("Failed to load symbols for Vendor Extension Library");
+    return false;
+  }
+  DLOGI("Successfully Loaded Vendor Extension Library symbols");
+
+  return true;
+}
+
+bool PerfLockBackend::Acquire(uint32_t duration_ms) {
+  // Passing the current handle extends the lock instead of stacking a new one.
+  int hint = HINT;
+  int handle = fn_lock_acquire_(lock_handle_, INT32(duration_ms), &hint,
+                                sizeof(hint) / sizeof(int));
+  if (handle < 0) {
+    return false;
+  }
+  lock_handle_ = handle;
+
+  return true;
+}
+
+void PerfLockBackend::Release() {
+  fn_lock_release_(lock_handle_);
+  lock_handle_ = 0;
+}
+
+// Stands in for the vendor perf lock when tuning or testing the controller on any device.
+class StubBoostBackend : public CPUBoostBackend {
+ public:
+  bool Acquire(uint32_t duration_ms) override {
+    if (!boosted_) {
+      DLOGI("Boost acquired for %u ms, acquire count %u", duration_ms, ++acquire_count_);
+    }
+    boosted_ = true;
+    ATRACE_INT("CPUHintBoost", 1);
+    return true;
+  }
+
+  void Release() override {
+    DLOGI("Boost released");
+    boosted_ = false;
+    ATRACE_INT("CPUHintBoost", 0);
   }
 
+ private:
+  bool boosted_ = false;
+  uint32_t acquire_count_ = 0;
+};
+
+bool CPUBoostController::Update(const FrameSample &sample, int64_t vsync_period_ns) {
+  if (vsync_period_ns <= 0) {
+    return boosted_;
+  }
+
+  cpu_avg_ns_ += (sample.cpu_ns - cpu_avg_ns_) / (1 << kAverageShift);
+  latency_avg_ns_ += (sample.latency_ns - latency_avg_ns_) / (1 << kAverageShift);
+  gpu_rate_ = gpu_rate_ - gpu_rate_ / (1 << kAverageShift) +
+              (sample.gpu_composition ? 100 : 0) / (1 << kAverageShift);
+  predicted_ns_ = latency_avg_ns_;
+
+  // Client composition leaves part of the frame to SurfaceFlinger's GPU work, so frequent GPU
+  // fallback shrinks the share of the vsync period composer may use.
+  int64_t budget_ns = vsync_period_ns * (100 - config_.margin_percent) / 100;
+  budget_ns = budget_ns * (200 - gpu_rate_) / 200;
+  // Boosted frames run faster, so release only well below the budget to avoid oscillating.
+  int64_t release_budget_ns = budget_ns / 2;
+
+  if (!boosted_) {
+    // A boost only helps when most of the latency is composer CPU time rather than fence waits.
+    bool cpu_bound = (cpu_avg_ns_ * 2 >= latency_avg_ns_);
+    over_budget_frames_ = (predicted_ns_ > budget_ns && cpu_bound) ? over_budget_frames_ + 1 : 0;
+    if (over_budget_frames_ >= config_.enter_frames) {
+      boosted_ = true;
+      over_budget_frames_ = 0;
+    }
+  } else {
+    under_budget_frames_ = (predicted_ns_ < release_budget_ns) ? under_budget_frames_ + 1 : 0;
+    if (under_budget_frames_ >= config_.exit_frames) {
+      boosted_ = false;
+      under_budget_frames_ = 0;
+    }
+  }
+
+  return boosted_;
+}
+
+void CPUBoostController::Reset() {
+  Config config = config_;
+  *this = CPUBoostController();
+  config_ = config;
+}
+
+DisplayError CPUHint::Init(HWCDebugHandler *debug_handler,
+                           std::unique_ptr<CPUBoostBackend> backend) {
   int pre_enable_window = -1;
   debug_handler->GetProperty(PERF_HINT_WINDOW_PROP, &pre_enable_window);
   if (pre_enable_window <= 0) {
@@ -52,57 +166,122 @@ DisplayError CPUHint::Init(HWCDebugHandler *debug_handler) {
     return kErrorNotSupported;
   }
 
-  DLOGI("CPU Hint Pre-enable Window %d", pre_enable_window);
-  pre_enable_window_ = pre_enable_window;
+  CPUBoostController::Config config;
+  config.enter_frames = UINT32(pre_enable_window);
+  config.exit_frames = 4 * config.enter_frames;
+  int margin = -1;
+  debug_handler->GetProperty(PERF_HINT_MARGIN_PROP, &margin);
+  if (margin >= 0 && margin < 100) {
+    config.margin_percent = UINT32(margin);
+  }
+  controller_.SetConfig(config);
+  DLOGI("CPU Hint Pre-enable Window %d, deadline margin %u%%", pre_enable_window,
+        config.margin_percent);
 
-  if (vendor_ext_lib_.Open(path)) {
-    if (!vendor_ext_lib_.Sym("perf_lock_acq", reinterpret_cast<void **>(&fn_lock_acquire_)) ||
-        !vendor_ext_lib_.Sym("perf_lock_rel", reinterpret_cast<void **>(&fn_lock_release_))) {
-      DLOGW("Failed to load symbols for Vendor Extension Library");
-      return kErrorNotSupported;
+  if (!backend) {
+    int use_stub = 0;
+    debug_handler->GetProperty(PERF_HINT_STUB_PROP, &use_stub);
+    if (use_stub) {
+      backend.reset(new StubBoostBackend());
+    } else {
+      char path[PROPERTY_VALUE_MAX];
+      if (debug_handler->GetProperty("ro.vendor.extension_library", path) != kErrorNone) {
+        DLOGI("Vendor Extension Library not enabled");
+        return kErrorNotSupported;
+      }
+
+      std::unique_ptr<PerfLockBackend> perf_lock(new PerfLockBackend());
+      if (!perf_lock->Load(path)) {
+        return kErrorNotSupported;
+      }
+      backend = std::move(perf_lock);
     }
-    DLOGI("Successfully Loaded Vendor Extension Library symbols");
-    enabled_ = true;
-  } else {
-    DLOGW("Failed to open %s : %s", path, vendor_ext_lib_.Error());
   }
 
+  backend_ = std::move(backend);
+  enabled_ = true;
+
   return kErrorNone;
 }
 
-void CPUHint::Set() {
+void CPUHint::StartPhase() {
+  phase_start_ns_ = systemTime(SYSTEM_TIME_MONOTONIC);
+  phase_start_cpu_ns_ = systemTime(SYSTEM_TIME_THREAD);
+}
+
+void CPUHint::EndPhase() {
+  frame_.latency_ns += systemTime(SYSTEM_TIME_MONOTONIC) - phase_start_ns_;
+  frame_.cpu_ns += systemTime(SYSTEM_TIME_THREAD) - phase_start_cpu_ns_;
+}
+
+void CPUHint::ValidateStart() {
   if (!enabled_) {
     return;
   }
-  if (lock_acquired_) {
+
+  StartPhase();
+}
+
+void CPUHint::ValidateDone(bool gpu_composition, uint32_t refresh_rate) {
+  if (!enabled_) {
     return;
   }
-  if (frame_countdown_) {
-    --frame_countdown_;
-    return;
+
+  EndPhase();
+  frame_.gpu_composition = gpu_composition;
+  if (refresh_rate) {
+    vsync_period_ns_ = 1000000000LL / refresh_rate;
   }
+}
 
-  int hint = HINT;
-  lock_handle_ = fn_lock_acquire_(0 /*handle*/, 0/*duration*/,
-                                  &hint, sizeof(hint) / sizeof(int));
-  if (lock_handle_ >= 0) {
-    lock_acquired_ = true;
+void CPUHint::PresentStart() {
+  if (!enabled_) {
+    return;
   }
+
+  StartPhase();
 }
 
-void CPUHint::Reset() {
+void CPUHint::PresentDone() {
   if (!enabled_) {
     return;
   }
 
-  frame_countdown_ = pre_enable_window_;
+  EndPhase();
+  int64_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+  int64_t lease_ns = ms2ns(kLeaseMs);
+  if (now - last_frame_ns_ > lease_ns) {
+    // Frames before an idle period do not predict the load after it.
+    controller_.Reset();
+  }
+  last_frame_ns_ = now;
+
+  if (lock_acquired_ && now >= lease_end_ns_) {
+    // The lease ran out while the screen was idle.
+    backend_->Release();
+    lock_acquired_ = false;
+  }
 
-  if (!lock_acquired_) {
+  bool boost = controller_.Update(frame_, vsync_period_ns_);
+  frame_ = {};
+
+  if (!boost) {
+    if (lock_acquired_) {
+      backend_->Release();
+      lock_acquired_ = false;
+    }
     return;
   }
 
-  fn_lock_release_(lock_handle_);
-  lock_acquired_ = false;
+  // Renew at half the lease to keep the boost continuous without a vendor call every frame.
+  if (lock_acquired_ && (lease_end_ns_ - now) > lease_ns / 2) {
+    return;
+  }
+
+  lock_acquired_ = backend_->Acquire(kLeaseMs);
+  if (lock_acquired_) {
+    lease_end_ns_ = now + lease_ns;
+  }
 }
 
 }  // namespace sdm
@@ -32,28 +32,83 @@
 
 #include <core/sdm_types.h>
 #include <utils/sys.h>
+#include <memory>
 
 namespace sdm {
 
 class HWCDebugHandler;
 
-class CPUHint {
+// Applies the CPU boost requested by CPUHint.
+class CPUBoostBackend {
+ public:
+  virtual ~CPUBoostBackend() {}
+  // Takes or renews a boost that expires on its own after duration_ms.
+  virtual bool Acquire(uint32_t duration_ms) = 0;
+  virtual void Release() = 0;
+};
+
+// Decides from per frame composer timings whether the CPU needs a boost to meet the deadline.
+// Kept free of any clock or backend so that it can be driven by recorded traces.
+class CPUBoostController {
  public:
-  DisplayError Init(HWCDebugHandler *debug_handler);
-  void Set();
+  struct Config {
+    uint32_t margin_percent = 25;  // Part of the vsync period that should stay free
+    uint32_t enter_frames = 2;     // Consecutive frames over budget before boosting
+    uint32_t exit_frames = 8;      // Consecutive frames under release budget before unboosting
+  };
+
+  struct FrameSample {
+    int64_t cpu_ns = 0;      // Composer thread CPU time spent in validate and present
+    int64_t latency_ns = 0;  // Wall time spent in validate and present
+    bool gpu_composition = false;
+  };
+
+  void SetConfig(const Config &config) { config_ = config; }
+  // Returns whether the CPU should be boosted after this frame.
+  bool Update(const FrameSample &sample, int64_t vsync_period_ns);
   void Reset();
+  int64_t GetPredictedLoad() const { return predicted_ns_; }
 
  private:
-  enum { HINT =  0x4501 /* 45-display layer hint, 01-Enable */ };
+  static const int kAverageShift = 2;  // Moving averages weigh new frames by 1/4
+
+  Config config_;
+  int64_t cpu_avg_ns_ = 0;
+  int64_t latency_avg_ns_ = 0;
+  int64_t predicted_ns_ = 0;
+  uint32_t gpu_rate_ = 0;  // Percentage of recent frames that fell back to GPU composition
+  uint32_t over_budget_frames_ = 0;
+  uint32_t under_budget_frames_ = 0;
+  bool boosted_ = false;
+};
+
+class CPUHint {
+ public:
+  DisplayError Init(HWCDebugHandler *debug_handler,
+                    std::unique_ptr<CPUBoostBackend> backend = nullptr);
+  void ValidateStart();
+  void ValidateDone(bool gpu_composition, uint32_t refresh_rate);
+  void PresentStart();
+  // Ends the frame and acquires or releases the boost.
+  void PresentDone();
+
+ private:
+  void StartPhase();
+  void EndPhase();
+
+  // Boost lease, renewed while frames keep needing it, so that idle screens drop it on their own.
+  static const uint32_t kLeaseMs = 100;
+
   bool enabled_ = false;
-  // frames to wait before setting this hint
-  int pre_enable_window_ = 0;
-  int frame_countdown_ = 0;
-  int lock_handle_ = 0;
+  CPUBoostController controller_;
+  std::unique_ptr<CPUBoostBackend> backend_;
+  int64_t vsync_period_ns_ = 0;
+  int64_t phase_start_ns_ = 0;
+  int64_t phase_start_cpu_ns_ = 0;
+  CPUBoostController::FrameSample frame_ = {};
   bool lock_acquired_ = false;
-  DynLib vendor_ext_lib_;
-  int (*fn_lock_acquire_)(int handle, int duration, int *hints, int num_args) = NULL;
-  int (*fn_lock_release_)(int value) = NULL;
+  int64_t lease_end_ns_ = 0;
+  int64_t last_frame_ns_ = 0;
 };
 
 }  // namespace sdm
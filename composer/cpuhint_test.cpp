@@ -0,0 +1,205 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "cpuhint.h"
+
+using namespace sdm;
+
+namespace {
+
+const int64_t kVsync60Ns = 16666666;
+const int64_t kVsync120Ns = 8333333;
+
+// A run of identical frames in a recorded composer timing trace.
+struct TraceSegment {
+  uint32_t frames;
+  int64_t cpu_us;
+  int64_t latency_us;
+  bool gpu_composition;
+};
+
+// Replays the trace through the controller and returns the boost decision after every frame.
+std::vector<bool> Replay(CPUBoostController *controller, const std::vector<TraceSegment> &trace,
+                         int64_t vsync_period_ns) {
+  std::vector<bool> boosts;
+  for (auto &segment : trace) {
+    CPUBoostController::FrameSample sample;
+    sample.cpu_ns = segment.cpu_us * 1000;
+    sample.latency_ns = segment.latency_us * 1000;
+    sample.gpu_composition = segment.gpu_composition;
+    for (uint32_t i = 0; i < segment.frames; i++) {
+      boosts.push_back(controller->Update(sample, vsync_period_ns));
+    }
+  }
+  return boosts;
+}
+
+int FirstBoost(const std::vector<bool> &boosts, size_t from = 0) {
+  for (size_t i = from; i < boosts.size(); i++) {
+    if (boosts[i]) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+int FirstRelease(const std::vector<bool> &boosts, size_t from) {
+  for (size_t i = from; i < boosts.size(); i++) {
+    if (!boosts[i]) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+uint32_t Transitions(const std::vector<bool> &boosts) {
+  uint32_t count = 0;
+  for (size_t i = 1; i < boosts.size(); i++) {
+    count += (boosts[i] != boosts[i - 1]);
+  }
+  return count;
+}
+
+CPUBoostController MakeController(uint32_t enter_frames, uint32_t exit_frames) {
+  CPUBoostController controller;
+  CPUBoostController::Config config;
+  config.enter_frames = enter_frames;
+  config.exit_frames = exit_frames;
+  controller.SetConfig(config);
+  return controller;
+}
+
+}  // namespace
+
+TEST(CPUBoostControllerTest, LightLoadNeverBoosts) {
+  CPUBoostController controller = MakeController(2, 8);
+  auto boosts = Replay(&controller, {{600, 4000, 5000, false}}, kVsync60Ns);
+  EXPECT_EQ(-1, FirstBoost(boosts));
+}
+
+TEST(CPUBoostControllerTest, SustainedCpuBoundLoadBoosts) {
+  CPUBoostController controller = MakeController(2, 8);
+  auto boosts = Replay(&controller, {{60, 4000, 5000, false}, {60, 15000, 15000, false}},
+                       kVsync60Ns);
+  int boost = FirstBoost(boosts);
+  // The moving average needs a few frames to cross the 12.5 ms budget, then enter_frames more.
+  ASSERT_GT(boost, 60 + 2);
+  EXPECT_LT(boost, 60 + 12);
+  EXPECT_EQ(-1, FirstRelease(boosts, boost));
+}
+
+TEST(CPUBoostControllerTest, SingleSlowFrameDoesNotBoost) {
+  CPUBoostController controller = MakeController(2, 8);
+  std::vector<TraceSegment> trace;
+  for (int i = 0; i < 20; i++) {
+    trace.push_back({29, 4000, 5000, false});
+    trace.push_back({1, 30000, 30000, false});
+  }
+  EXPECT_EQ(-1, FirstBoost(Replay(&controller, trace, kVsync60Ns)));
+}
+
+TEST(CPUBoostControllerTest, FenceBoundLatencyDoesNotBoost) {
+  // Most of the frame is spent waiting on fences, which a faster CPU does not shorten.
+  CPUBoostController controller = MakeController(2, 8);
+  auto boosts = Replay(&controller, {{300, 3000, 16000, false}}, kVsync60Ns);
+  EXPECT_EQ(-1, FirstBoost(boosts));
+}
+
+TEST(CPUBoostControllerTest, ReleasesAfterLoadDrops) {
+  CPUBoostController controller = MakeController(2, 8);
+  auto boosts = Replay(&controller, {{60, 15000, 15000, false}, {60, 2000, 2000, false}},
+                       kVsync60Ns);
+  int boost = FirstBoost(boosts);
+  ASSERT_GE(boost, 0);
+  ASSERT_LT(boost, 60);
+  int release = FirstRelease(boosts, boost);
+  // The average falls under half the budget within a few frames, then exit_frames more.
+  ASSERT_GT(release, 60 + 8);
+  EXPECT_LT(release, 60 + 20);
+  EXPECT_EQ(-1, FirstBoost(boosts, release));
+}
+
+TEST(CPUBoostControllerTest, BoostedLoadNearBudgetDoesNotOscillate) {
+  // Once boosted, frames land between the release and the enter budget. The controller must hold
+  // the boost instead of toggling it every few frames.
+  CPUBoostController controller = MakeController(2, 8);
+  std::vector<TraceSegment> trace = {{40, 15000, 15000, false}};
+  for (int i = 0; i < 50; i++) {
+    trace.push_back({3, 9000, 9000, false});
+    trace.push_back({1, 13000, 13000, false});
+  }
+  auto boosts = Replay(&controller, trace, kVsync60Ns);
+  EXPECT_EQ(1U, Transitions(boosts));
+  EXPECT_TRUE(boosts.back());
+}
+
+TEST(CPUBoostControllerTest, GpuFallbackShrinksBudget) {
+  // 10 ms fits the 12.5 ms budget with device composition, but not once SurfaceFlinger also needs
+  // GPU time for client composition.
+  CPUBoostController device = MakeController(2, 8);
+  EXPECT_EQ(-1, FirstBoost(Replay(&device, {{120, 10000, 10000, false}}, kVsync60Ns)));
+
+  CPUBoostController client = MakeController(2, 8);
+  EXPECT_GE(FirstBoost(Replay(&client, {{120, 10000, 10000, true}}, kVsync60Ns)), 0);
+}
+
+TEST(CPUBoostControllerTest, HigherRefreshRateTightensBudget) {
+  // 8 ms per frame is comfortable at 60 Hz but over the 6.25 ms budget at 120 Hz.
+  CPUBoostController at60 = MakeController(2, 8);
+  EXPECT_EQ(-1, FirstBoost(Replay(&at60, {{120, 8000, 8000, false}}, kVsync60Ns)));
+
+  CPUBoostController at120 = MakeController(2, 8);
+  EXPECT_GE(FirstBoost(Replay(&at120, {{120, 8000, 8000, false}}, kVsync120Ns)), 0);
+}
+
+TEST(CPUBoostControllerTest, UnknownVsyncPeriodKeepsDecision) {
+  CPUBoostController controller = MakeController(2, 8);
+  EXPECT_EQ(-1, FirstBoost(Replay(&controller, {{60, 30000, 30000, false}}, 0)));
+
+  auto boosts = Replay(&controller, {{60, 15000, 15000, false}}, kVsync60Ns);
+  int boost = FirstBoost(boosts);
+  ASSERT_GE(boost, 0);
+  EXPECT_EQ(-1, FirstRelease(Replay(&controller, {{60, 1000, 1000, false}}, 0), 0));
+}
+
+TEST(CPUBoostControllerTest, ResetDropsHistoryButKeepsConfig) {
+  CPUBoostController controller = MakeController(1, 8);
+  auto boosts = Replay(&controller, {{60, 15000, 15000, false}}, kVsync60Ns);
+  int first = FirstBoost(boosts);
+  ASSERT_GE(first, 0);
+
+  controller.Reset();
+  EXPECT_EQ(0, controller.GetPredictedLoad());
+  boosts = Replay(&controller, {{60, 15000, 15000, false}}, kVsync60Ns);
+  // Same warm up as from a fresh controller with enter_frames of 1.
+  EXPECT_EQ(first, FirstBoost(boosts));
+}
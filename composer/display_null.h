@@ -80,6 +80,7 @@ class DisplayNull : public DisplayInterface {
   MAKE_NO_OP(DisablePartialUpdateOneFrame())
   MAKE_NO_OP(SetDisplayMode(uint32_t))
   MAKE_NO_OP(SetPanelBrightness(float))
+  MAKE_NO_OP(SetPanelBrightnessRamp(float, uint32_t))
   MAKE_NO_OP(CachePanelBrightness(int))
   MAKE_NO_OP(OnMinHdcpEncryptionLevelChange(uint32_t))
   MAKE_NO_OP(ColorSVCRequestRoute(const PPDisplayAPIPayload &, PPDisplayAPIPayload *,
@@ -122,6 +123,7 @@ class DisplayNull : public DisplayInterface {
   MAKE_NO_OP(colorSamplingOff());
   MAKE_NO_OP(SetDisplayElapseTime(uint64_t))
   MAKE_NO_OP(ClearLUTs())
+  MAKE_NO_OP(GetFrameLayout(DisplayFrameLayout *))
 
  protected:
   DisplayConfigVariableInfo default_variable_config_ = {};
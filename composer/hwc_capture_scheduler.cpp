@@ -0,0 +1,206 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <utils/debug.h>
+
+#include <iterator>
+#include <utility>
+
+#include "hwc_capture_scheduler.h"
+#include "hwc_debugger.h"
+
+#define __CLASS__ "CaptureScheduler"
+
+namespace sdm {
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+// Retries while another writeback user holds the output.
+static const uint32_t kBusyRetryMs = 16;
+static const uint32_t kBusyRetryMax = 60;
+
+CaptureScheduler::CaptureScheduler(CaptureBackend *backend)
+  : backend_(backend), worker_(&CaptureScheduler::Run, this) {
+}
+
+CaptureScheduler::~CaptureScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    exit_ = true;
+  }
+  cv_.notify_all();
+  worker_.join();
+
+  for (auto &client : clients_) {
+    for (auto &pending : client.second.requests) {
+      pending.request.done(-ECANCELED);
+    }
+  }
+}
+
+void CaptureScheduler::Queue(CaptureRequest request) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    PendingRequest pending;
+    pending.request = std::move(request);
+    pending.sequence = sequence_++;
+    clients_[pending.request.client_id].requests.push_back(std::move(pending));
+  }
+  cv_.notify_one();
+}
+
+void CaptureScheduler::SetMinInterval(uint32_t min_interval_ms) {
+  std::lock_guard<std::mutex> lock(lock_);
+  min_interval_ = milliseconds(min_interval_ms);
+}
+
+bool CaptureScheduler::PickBatch(std::vector<ClientIter> *batch, steady_clock::time_point *wake) {
+  auto now = steady_clock::now();
+  std::vector<ClientIter> ready;
+
+  *wake = steady_clock::time_point();
+  for (auto it = clients_.begin(); it != clients_.end();) {
+    auto ready_time = it->second.last_capture + min_interval_;
+    if (it->second.requests.empty()) {
+      // Idle clients are only kept to rate limit their next request.
+      it = (ready_time <= now) ? clients_.erase(it) : std::next(it);
+      continue;
+    }
+
+    if (ready_time > now) {
+      if (*wake == steady_clock::time_point() || ready_time < *wake) {
+        *wake = ready_time;
+      }
+    } else {
+      ready.push_back(it);
+    }
+    it++;
+  }
+
+  if (ready.empty()) {
+    return false;
+  }
+
+  // Highest priority first, then the oldest request.
+  ClientIter head = ready.front();
+  for (auto it : ready) {
+    const PendingRequest &front = it->second.requests.front();
+    const PendingRequest &head_front = head->second.requests.front();
+    if (front.request.priority < head_front.request.priority ||
+        (front.request.priority == head_front.request.priority &&
+         front.sequence < head_front.sequence)) {
+      head = it;
+    }
+  }
+
+  const CaptureRequest &primary = head->second.requests.front().request;
+  batch->push_back(head);
+  for (auto it : ready) {
+    const CaptureRequest &request = it->second.requests.front().request;
+    if (it != head && request.post_processed == primary.post_processed &&
+        backend_->CanShare(primary.buffer, request.buffer)) {
+      batch->push_back(it);
+    }
+  }
+
+  return true;
+}
+
+int CaptureScheduler::CaptureBatch(const std::vector<PendingRequest *> &batch) {
+  const CaptureRequest &primary = batch.front()->request;
+
+  int status = backend_->Configure(primary.buffer, primary.post_processed);
+  for (uint32_t retry = 0; status == -EBUSY && retry < kBusyRetryMax; retry++) {
+    {
+      // The destructor wakes this wait, so that it does not sit out the retries.
+      std::unique_lock<std::mutex> lock(lock_);
+      if (cv_.wait_for(lock, milliseconds(kBusyRetryMs), [this] { return exit_; })) {
+        status = -ECANCELED;
+        break;
+      }
+    }
+    status = backend_->Configure(primary.buffer, primary.post_processed);
+  }
+
+  if (!status) {
+    status = backend_->Capture();
+  }
+
+  // Copy before notifying anyone, the primary client may reuse its buffer once notified.
+  std::vector<int> statuses(batch.size(), status);
+  for (size_t i = 1; i < batch.size() && !status; i++) {
+    statuses[i] = backend_->Copy(primary.buffer, batch[i]->request.buffer);
+  }
+
+  for (size_t i = 0; i < batch.size(); i++) {
+    batch[i]->request.done(statuses[i]);
+  }
+
+  DLOGD("Captured frame for %zu clients, status %d", batch.size(), status);
+
+  return status;
+}
+
+void CaptureScheduler::Run() {
+  std::unique_lock<std::mutex> lock(lock_);
+
+  while (!exit_) {
+    std::vector<ClientIter> batch;
+    steady_clock::time_point wake;
+    if (!PickBatch(&batch, &wake)) {
+      if (wake == steady_clock::time_point()) {
+        cv_.wait(lock);
+      } else {
+        cv_.wait_until(lock, wake);
+      }
+      continue;
+    }
+
+    // Only this thread removes requests, and deque elements stay in place while others are
+    // queued behind them, so the batch can be served without holding the lock.
+    std::vector<PendingRequest *> requests;
+    for (auto &client : batch) {
+      requests.push_back(&client->second.requests.front());
+    }
+
+    lock.unlock();
+    CaptureBatch(requests);
+    lock.lock();
+
+    auto now = steady_clock::now();
+    for (auto &client : batch) {
+      client->second.requests.pop_front();
+      client->second.last_capture = now;
+    }
+  }
+}
+
+}  // namespace sdm
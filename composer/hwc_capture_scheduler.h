@@ -0,0 +1,118 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_CAPTURE_SCHEDULER_H__
+#define __HWC_CAPTURE_SCHEDULER_H__
+
+#include <cutils/native_handle.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sdm {
+
+enum CapturePriority {
+  kCapturePriorityHigh,
+  kCapturePriorityNormal,
+  kCapturePriorityLow,
+};
+
+struct CaptureRequest {
+  uint64_t client_id = 0;  // Requests of one client are served in order
+  CapturePriority priority = kCapturePriorityNormal;
+  bool post_processed = false;
+  const native_handle_t *buffer = nullptr;
+  // Called from the scheduler thread once the buffer holds a frame, or the capture failed.
+  std::function<void(int status)> done;
+};
+
+// Writeback path used by CaptureScheduler.
+class CaptureBackend {
+ public:
+  virtual ~CaptureBackend() {}
+  // Points the writeback output at buffer for the next frame. Returns -EBUSY while another
+  // writeback user holds the output.
+  virtual int Configure(const native_handle_t *buffer, bool post_processed) = 0;
+  // Triggers a frame and waits until the configured buffer holds it. The wait must be bounded,
+  // the scheduler and its destructor wait for it. Returns -ENODATA if the frame did not write
+  // the buffer. A failure fails every request of the batch.
+  virtual int Capture() = 0;
+  // Whether a frame captured into src can be handed out by copying it into dst.
+  virtual bool CanShare(const native_handle_t *src, const native_handle_t *dst) = 0;
+  virtual int Copy(const native_handle_t *src, const native_handle_t *dst) = 0;
+};
+
+// Serves capture requests of several clients through the single writeback output. Each client
+// has its own queue. The next capture goes to the head of the highest priority queue whose rate
+// limit allows it, oldest request first, and the heads of other queues that can share that frame
+// get a copy of it instead of waiting for frames of their own.
+class CaptureScheduler {
+ public:
+  explicit CaptureScheduler(CaptureBackend *backend);
+  ~CaptureScheduler();
+
+  void Queue(CaptureRequest request);
+  // Minimum time between two captures delivered to the same client.
+  void SetMinInterval(uint32_t min_interval_ms);
+
+ private:
+  struct PendingRequest {
+    CaptureRequest request;
+    uint64_t sequence = 0;
+  };
+
+  struct ClientQueue {
+    std::deque<PendingRequest> requests;
+    std::chrono::steady_clock::time_point last_capture;
+  };
+
+  typedef std::map<uint64_t, ClientQueue>::iterator ClientIter;
+
+  void Run();
+  bool PickBatch(std::vector<ClientIter> *batch, std::chrono::steady_clock::time_point *wake);
+  int CaptureBatch(const std::vector<PendingRequest *> &batch);
+
+  CaptureBackend *backend_ = nullptr;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::map<uint64_t, ClientQueue> clients_;
+  std::chrono::milliseconds min_interval_{0};
+  uint64_t sequence_ = 0;
+  bool exit_ = false;
+  std::thread worker_;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_CAPTURE_SCHEDULER_H__
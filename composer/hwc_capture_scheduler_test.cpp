@@ -0,0 +1,353 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cutils/native_handle.h>
+#include <errno.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hwc_capture_scheduler.h"
+
+using namespace sdm;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+// Buffers of equal size share frames.
+class Buffer {
+ public:
+  explicit Buffer(int size) : handle_(native_handle_create(0, 1)) { handle_->data[0] = size; }
+  ~Buffer() { native_handle_delete(handle_); }
+  const native_handle_t *get() const { return handle_; }
+
+ private:
+  native_handle_t *handle_;
+};
+
+// Records the calls and lets a test hold captures until it has queued what it needs.
+class StubBackend : public CaptureBackend {
+ public:
+  int Configure(const native_handle_t *buffer, bool post_processed) override {
+    std::lock_guard<std::mutex> lock(lock_);
+    configures_++;
+    if (busy_configures_) {
+      busy_configures_--;
+      return -EBUSY;
+    }
+    configured_ = buffer;
+    return 0;
+  }
+
+  int Capture() override {
+    std::unique_lock<std::mutex> lock(lock_);
+    captured_.push_back(configured_);
+    // Bounded like the writeback wait of the real backend.
+    cv_.wait_for(lock, milliseconds(capture_wait_ms_), [this] { return open_; });
+    // Like the real backend when the frame came without a readback fence.
+    if (!picked_up_) {
+      return -ENODATA;
+    }
+    return capture_status_;
+  }
+
+  bool CanShare(const native_handle_t *src, const native_handle_t *dst) override {
+    return src->data[0] == dst->data[0];
+  }
+
+  int Copy(const native_handle_t *src, const native_handle_t *dst) override {
+    std::lock_guard<std::mutex> lock(lock_);
+    copies_++;
+    return 0;
+  }
+
+  // Captures block until Open(), or until capture_wait_ms passed.
+  void Hold(uint32_t capture_wait_ms = 2000) {
+    std::lock_guard<std::mutex> lock(lock_);
+    open_ = false;
+    capture_wait_ms_ = capture_wait_ms;
+  }
+
+  void Open() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      open_ = true;
+    }
+    cv_.notify_all();
+  }
+
+  // Blocks until a capture started.
+  bool WaitForCaptures(size_t count) {
+    auto deadline = steady_clock::now() + milliseconds(2000);
+    while (steady_clock::now() < deadline) {
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (captured_.size() >= count) {
+          return true;
+        }
+      }
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+    return false;
+  }
+
+  std::mutex lock_;
+  std::condition_variable cv_;
+  bool open_ = true;
+  uint32_t capture_wait_ms_ = 0;
+  int capture_status_ = 0;
+  bool picked_up_ = true;  // Whether the triggered frame writes the configured buffer
+  uint32_t busy_configures_ = 0;
+  uint32_t configures_ = 0;
+  uint32_t copies_ = 0;
+  const native_handle_t *configured_ = nullptr;
+  std::vector<const native_handle_t *> captured_;
+};
+
+// Completion status of each request, by the tag the test gave it.
+class Results {
+ public:
+  std::function<void(int)> Done(int tag) {
+    return [this, tag](int status) {
+      std::lock_guard<std::mutex> lock(lock_);
+      statuses_[tag] = status;
+      order_.push_back(tag);
+      times_[tag] = steady_clock::now();
+      cv_.notify_all();
+    };
+  }
+
+  bool WaitFor(size_t count) {
+    std::unique_lock<std::mutex> lock(lock_);
+    return cv_.wait_for(lock, milliseconds(3000), [this, count] {
+      return statuses_.size() >= count;
+    });
+  }
+
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::map<int, int> statuses_;
+  std::map<int, steady_clock::time_point> times_;
+  std::vector<int> order_;
+};
+
+CaptureRequest Request(uint64_t client, const Buffer &buffer, std::function<void(int)> done,
+                       CapturePriority priority = kCapturePriorityNormal) {
+  CaptureRequest request;
+  request.client_id = client;
+  request.priority = priority;
+  request.buffer = buffer.get();
+  request.done = done;
+  return request;
+}
+
+}  // namespace
+
+TEST(CaptureSchedulerTest, DeliversCapture) {
+  StubBackend backend;
+  Results results;
+  Buffer buffer(100);
+  {
+    CaptureScheduler scheduler(&backend);
+    scheduler.Queue(Request(1, buffer, results.Done(1)));
+    ASSERT_TRUE(results.WaitFor(1));
+  }
+  EXPECT_EQ(0, results.statuses_[1]);
+  ASSERT_EQ(1u, backend.captured_.size());
+  EXPECT_EQ(buffer.get(), backend.captured_[0]);
+  EXPECT_EQ(0u, backend.copies_);
+}
+
+TEST(CaptureSchedulerTest, SharesFrameAcrossCompatibleClients) {
+  StubBackend backend;
+  Results results;
+  Buffer first(100), shared_a(200), shared_b(200), other(300);
+  {
+    CaptureScheduler scheduler(&backend);
+    backend.Hold();
+    scheduler.Queue(Request(1, first, results.Done(1)));
+    ASSERT_TRUE(backend.WaitForCaptures(1));
+    scheduler.Queue(Request(2, shared_a, results.Done(2)));
+    scheduler.Queue(Request(3, shared_b, results.Done(3)));
+    scheduler.Queue(Request(4, other, results.Done(4)));
+    backend.Open();
+    ASSERT_TRUE(results.WaitFor(4));
+  }
+  for (int tag = 1; tag <= 4; tag++) {
+    EXPECT_EQ(0, results.statuses_[tag]) << tag;
+  }
+  // Clients 2 and 3 got one frame, copied for the second of them.
+  EXPECT_EQ(3u, backend.captured_.size());
+  EXPECT_EQ(1u, backend.copies_);
+}
+
+TEST(CaptureSchedulerTest, FailsWholeBatchOnCaptureTimeout) {
+  StubBackend backend;
+  Results results;
+  Buffer first(100), shared_a(200), shared_b(200);
+  {
+    CaptureScheduler scheduler(&backend);
+    backend.Hold();
+    scheduler.Queue(Request(1, first, results.Done(1)));
+    ASSERT_TRUE(backend.WaitForCaptures(1));
+    scheduler.Queue(Request(2, shared_a, results.Done(2)));
+    scheduler.Queue(Request(3, shared_b, results.Done(3)));
+    {
+      std::lock_guard<std::mutex> lock(backend.lock_);
+      backend.capture_status_ = -ETIMEDOUT;
+    }
+    backend.Open();
+    ASSERT_TRUE(results.WaitFor(3));
+  }
+  EXPECT_EQ(-ETIMEDOUT, results.statuses_[1]);
+  EXPECT_EQ(-ETIMEDOUT, results.statuses_[2]);
+  EXPECT_EQ(-ETIMEDOUT, results.statuses_[3]);
+  // Nothing is copied out of a frame that never arrived.
+  EXPECT_EQ(0u, backend.copies_);
+}
+
+TEST(CaptureSchedulerTest, FailsWholeBatchWithoutReadbackFence) {
+  StubBackend backend;
+  Results results;
+  Buffer first(100), shared_a(200), shared_b(200);
+  {
+    CaptureScheduler scheduler(&backend);
+    backend.Hold();
+    scheduler.Queue(Request(1, first, results.Done(1)));
+    ASSERT_TRUE(backend.WaitForCaptures(1));
+    scheduler.Queue(Request(2, shared_a, results.Done(2)));
+    scheduler.Queue(Request(3, shared_b, results.Done(3)));
+    {
+      std::lock_guard<std::mutex> lock(backend.lock_);
+      backend.picked_up_ = false;
+    }
+    backend.Open();
+    ASSERT_TRUE(results.WaitFor(3));
+  }
+  EXPECT_EQ(-ENODATA, results.statuses_[1]);
+  EXPECT_EQ(-ENODATA, results.statuses_[2]);
+  EXPECT_EQ(-ENODATA, results.statuses_[3]);
+  // The unwritten buffer is not copied out to the clients sharing the frame.
+  EXPECT_EQ(0u, backend.copies_);
+}
+
+TEST(CaptureSchedulerTest, RetriesWhileOutputBusy) {
+  StubBackend backend;
+  Results results;
+  Buffer buffer(100);
+  backend.busy_configures_ = 3;
+  {
+    CaptureScheduler scheduler(&backend);
+    scheduler.Queue(Request(1, buffer, results.Done(1)));
+    ASSERT_TRUE(results.WaitFor(1));
+  }
+  EXPECT_EQ(0, results.statuses_[1]);
+  EXPECT_EQ(4u, backend.configures_);
+}
+
+TEST(CaptureSchedulerTest, DestructionCancelsBusyRetries) {
+  StubBackend backend;
+  Results results;
+  Buffer buffer(100), other(200);
+  backend.busy_configures_ = 1000;
+  auto start = steady_clock::now();
+  {
+    CaptureScheduler scheduler(&backend);
+    scheduler.Queue(Request(1, buffer, results.Done(1)));
+    scheduler.Queue(Request(2, other, results.Done(2)));
+    std::this_thread::sleep_for(milliseconds(50));
+  }
+  // Far less than the second of retries a busy output gets otherwise.
+  EXPECT_LT(steady_clock::now() - start, milliseconds(500));
+  ASSERT_TRUE(results.WaitFor(2));
+  EXPECT_EQ(-ECANCELED, results.statuses_[1]);
+  EXPECT_EQ(-ECANCELED, results.statuses_[2]);
+}
+
+TEST(CaptureSchedulerTest, DestructionWaitsOutBoundedCapture) {
+  // A display that stopped presenting: the capture gives up after its timeout, and destruction
+  // returns once it did.
+  StubBackend backend;
+  Results results;
+  Buffer buffer(100), other(200);
+  backend.Hold(100);
+  backend.capture_status_ = -ETIMEDOUT;
+  {
+    CaptureScheduler scheduler(&backend);
+    scheduler.Queue(Request(1, buffer, results.Done(1)));
+    scheduler.Queue(Request(2, other, results.Done(2)));
+    ASSERT_TRUE(backend.WaitForCaptures(1));
+  }
+  ASSERT_TRUE(results.WaitFor(2));
+  EXPECT_EQ(-ETIMEDOUT, results.statuses_[1]);
+  EXPECT_EQ(-ECANCELED, results.statuses_[2]);
+}
+
+TEST(CaptureSchedulerTest, ServesHigherPriorityFirst) {
+  StubBackend backend;
+  Results results;
+  Buffer first(100), low(200), high(300), normal(400);
+  {
+    CaptureScheduler scheduler(&backend);
+    backend.Hold();
+    scheduler.Queue(Request(1, first, results.Done(1)));
+    ASSERT_TRUE(backend.WaitForCaptures(1));
+    scheduler.Queue(Request(2, low, results.Done(2), kCapturePriorityLow));
+    scheduler.Queue(Request(3, high, results.Done(3), kCapturePriorityHigh));
+    scheduler.Queue(Request(4, normal, results.Done(4), kCapturePriorityNormal));
+    backend.Open();
+    ASSERT_TRUE(results.WaitFor(4));
+  }
+  EXPECT_EQ((std::vector<int>{1, 3, 4, 2}), results.order_);
+}
+
+TEST(CaptureSchedulerTest, RateLimitsEachClient) {
+  StubBackend backend;
+  Results results;
+  Buffer a(100), b(100), c(200);
+  {
+    CaptureScheduler scheduler(&backend);
+    scheduler.SetMinInterval(50);
+    scheduler.Queue(Request(1, a, results.Done(1)));
+    scheduler.Queue(Request(1, b, results.Done(2)));
+    scheduler.Queue(Request(2, c, results.Done(3)));
+    ASSERT_TRUE(results.WaitFor(3));
+  }
+  EXPECT_GE(results.times_[2] - results.times_[1], milliseconds(45));
+  // Another client is not held back by the first one's limit.
+  EXPECT_LT(results.times_[3] - results.times_[1], milliseconds(45));
+}
@@ -27,6 +27,7 @@
 #include <utils/debug.h>
 #include <utils/utils.h>
 #include <utils/formats.h>
+#include <utils/frame_trace.h>
 #include <utils/rect.h>
 #include <qd_utils.h>
 #include <vendor/qti/hardware/display/composer/3.0/IQtiComposerClient.h>
@@ -541,6 +542,8 @@ int HWCDisplay::Init() {
 
   game_supported_ = display_intf_->GameEnhanceSupported();
 
+  InitLayerTrace();
+
   DLOGI("Display created with id: %d, game_supported_: %d", UINT32(id_), game_supported_);
 
   return 0;
@@ -609,6 +612,8 @@ int HWCDisplay::Deinit() {
     tone_mapper_ = nullptr;
   }
 
+  layer_trace_ = nullptr;
+
   return 0;
 }
 
@@ -668,6 +673,7 @@ void HWCDisplay::BuildLayerStack() {
   layer_stack_.flags.fast_path = fast_path_enabled_ && fast_path_composition_;
 
   DTRACE_SCOPED();
+  FRAME_TRACE_SCOPED(sdm_id_, kFrameTraceBuildLayerStack);
   // Add one layer for fb target
   for (auto hwc_layer : layer_set_) {
     // Reset layer data which SDM may change
@@ -1630,6 +1636,7 @@ HWC2::Error HWCDisplay::CommitLayerStack(void) {
   }
 
   DumpInputBuffers();
+  RecordLayerTrace();
 
   DisplayError error = kErrorUndefined;
   int status = 0;
@@ -1675,6 +1682,7 @@ HWC2::Error HWCDisplay::CommitLayerStack(void) {
 
 HWC2::Error HWCDisplay::PostCommitLayerStack(shared_ptr<Fence> *out_retire_fence) {
   auto status = HWC2::Error::None;
+  FRAME_TRACE_SCOPED(sdm_id_, kFrameTraceReleaseFences);
 
   // Do no call flush on errors, if a successful buffer is never submitted.
   if (flush_ && flush_on_error_) {
@@ -1760,6 +1768,150 @@ DisplayError HWCDisplay::SetMaxMixerStages(uint32_t max_mixer_stages) {
   return error;
 }
 
+void HWCDisplay::InitLayerTrace() {
+  int layer_trace = 0;
+  HWCDebugHandler::Get()->GetProperty(LAYER_TRACE_PROP, &layer_trace);
+  if (!layer_trace) {
+    return;
+  }
+
+  char trace_path[PATH_MAX];
+  snprintf(trace_path, sizeof(trace_path), "%s/layer_trace_disp_id_%02u_%s.sdmt",
+           HWCDebugHandler::DumpDir(), UINT32(id_), GetDisplayString());
+
+  layer_trace_ = std::make_unique<layer_trace::Writer>();
+  int status = layer_trace_->Open(trace_path);
+  if (status != 0) {
+    DLOGW("Failed to open layer trace %s, error = %d", trace_path, status);
+    layer_trace_ = nullptr;
+    return;
+  }
+
+  layer_trace_frame_ = 0;
+  layer_trace_checksums_ = (layer_trace == 2);
+  DLOGI("Recording layer trace to %s, checksums %d", trace_path, layer_trace_checksums_);
+}
+
+uint32_t HWCDisplay::GetLayerChecksum(Layer *layer) {
+  const private_handle_t *pvt_handle =
+      reinterpret_cast<const private_handle_t *>(layer->input_buffer.buffer_id);
+  if (!pvt_handle || (pvt_handle->flags & private_handle_t::PRIV_FLAGS_SECURE_BUFFER)) {
+    return 0;
+  }
+
+  Fence::Wait(layer->input_buffer.acquire_fence);
+
+  if (!pvt_handle->base) {
+    DisplayError error = buffer_allocator_->MapBuffer(pvt_handle, nullptr);
+    if (error != kErrorNone) {
+      DLOGE("Failed to map buffer, error = %d", error);
+      return 0;
+    }
+  }
+
+  uint32_t checksum = layer_trace::Checksum(reinterpret_cast<void *>(pvt_handle->base),
+                                            pvt_handle->size);
+
+  int release_fence = -1;
+  DisplayError error = buffer_allocator_->UnmapBuffer(pvt_handle, &release_fence);
+  if (error != kErrorNone) {
+    DLOGE("Failed to unmap buffer, error = %d", error);
+  }
+
+  return checksum;
+}
+
+void HWCDisplay::RecordLayerTrace() {
+  if (!layer_trace_ || flush_) {
+    return;
+  }
+
+  DTRACE_SCOPED();
+
+  // SDM decisions of the frame are final once validated, record them before Commit consumes the
+  // acquire fences and the tone mapper rewrites the input buffers.
+  layer_trace::Frame frame;
+  layer_trace::FrameHeader &header = frame.header;
+  header.display_id = INT32(id_);
+  header.frame_number = layer_trace_frame_++;
+  header.timestamp_ns = systemTime(SYSTEM_TIME_MONOTONIC);
+  header.stack_flags = layer_stack_.flags.flags;
+  header.blend_primaries = UINT32(layer_stack_.blend_cs.primaries);
+  header.blend_transfer = UINT32(layer_stack_.blend_cs.transfer);
+  header.validated = (validate_state_ != kSkipValidate);
+
+  std::map<Layer *, HWC2::Composition> client_composition;
+  for (auto hwc_layer : layer_set_) {
+    client_composition[hwc_layer->GetSDMLayer()] = hwc_layer->GetClientRequestedCompositionType();
+  }
+
+  size_t layer_count = std::min(layer_stack_.layers.size(), size_t(layer_trace::kMaxTraceLayers));
+  for (size_t i = 0; i < layer_count; i++) {
+    Layer *layer = layer_stack_.layers.at(i);
+    const LayerBuffer &buffer = layer->input_buffer;
+    const private_handle_t *pvt_handle =
+        reinterpret_cast<const private_handle_t *>(buffer.buffer_id);
+    layer_trace::LayerRecord record = {};
+
+    record.buffer_id = pvt_handle ? pvt_handle->id : 0;
+    record.format = UINT32(buffer.format);
+    record.width = buffer.width;
+    record.height = buffer.height;
+    record.buffer_flags = buffer.flags.flags;
+    record.primaries = UINT32(buffer.color_metadata.colorPrimaries);
+    record.transfer = UINT32(buffer.color_metadata.transfer);
+    record.range = UINT32(buffer.color_metadata.range);
+    record.layer_flags = layer->flags.flags;
+    auto it = client_composition.find(layer);
+    record.client_composition = (it != client_composition.end()) ? UINT32(it->second) : 0;
+    record.composition = UINT32(layer->composition);
+    record.request_flags = layer->request.flags.request_flags;
+    record.blending = UINT32(layer->blending);
+    record.transform = (layer->transform.flip_horizontal ? 1u : 0u) |
+                       (layer->transform.flip_vertical ? 2u : 0u) |
+                       (UINT32(layer->transform.rotation) << 16);
+    record.plane_alpha = layer->plane_alpha;
+    record.frame_rate = layer->frame_rate;
+    record.solid_fill_color = layer->solid_fill_color;
+    record.src_rect = {layer->src_rect.left, layer->src_rect.top, layer->src_rect.right,
+                       layer->src_rect.bottom};
+    record.dst_rect = {layer->dst_rect.left, layer->dst_rect.top, layer->dst_rect.right,
+                       layer->dst_rect.bottom};
+    record.damage_count = UINT32(layer->dirty_regions.size());
+    for (uint32_t j = 0; j < std::min(record.damage_count, layer_trace::kMaxDamageRects); j++) {
+      const LayerRect &rect = layer->dirty_regions.at(j);
+      record.damage[j] = {rect.left, rect.top, rect.right, rect.bottom};
+    }
+    if (layer_trace_checksums_ && layer->composition != kCompositionGPUTarget) {
+      record.checksum = GetLayerChecksum(layer);
+    }
+
+    frame.layers.push_back(record);
+  }
+
+  DisplayFrameLayout layout = {};
+  if (display_intf_->GetFrameLayout(&layout) == kErrorNone) {
+    header.gpu_target_index = layout.gpu_target_index;
+    header.fast_path = layout.fast_path;
+    for (auto &pipe : layout.pipes) {
+      frame.pipes.push_back({pipe.layer_index, pipe.left_pipe_id, pipe.right_pipe_id, 0});
+    }
+    for (auto *roi : {&layout.left_roi, &layout.right_roi}) {
+      for (auto &rect : *roi) {
+        if (frame.roi.size() < layer_trace::kMaxTraceRects) {
+          frame.roi.push_back({rect.left, rect.top, rect.right, rect.bottom});
+        }
+      }
+    }
+  }
+
+  int status = layer_trace_->Write(frame);
+  if (status != 0) {
+    DLOGW("Failed to write layer trace, error = %d. Stopped recording.", status);
+    layer_trace_ = nullptr;
+  }
+}
+
 void HWCDisplay::DumpInputBuffers() {
   char dir_path[PATH_MAX];
   int  status;
@@ -24,12 +24,14 @@
 #include <android/hardware/graphics/common/1.2/types.h>
 #include <core/core_interface.h>
 #include <hardware/hwcomposer.h>
+#include <layer_trace.h>
 #include <private/color_params.h>
 #include <qdMetaData.h>
 #include <sys/stat.h>
 #include <algorithm>
 #include <bitset>
 #include <map>
+#include <memory>
 #include <queue>
 #include <set>
 #include <string>
@@ -491,6 +493,9 @@ class HWCDisplay : public DisplayEventHandler {
   uint32_t dump_frame_count_ = 0;
   uint32_t dump_frame_index_ = 0;
   bool dump_input_layers_ = false;
+  std::unique_ptr<layer_trace::Writer> layer_trace_ = nullptr;
+  uint64_t layer_trace_frame_ = 0;
+  bool layer_trace_checksums_ = false;
   HWC2::PowerMode current_power_mode_ = HWC2::PowerMode::Off;
   HWC2::PowerMode pending_power_mode_ = HWC2::PowerMode::Off;
   bool swap_interval_zero_ = false;
@@ -539,6 +544,9 @@ class HWCDisplay : public DisplayEventHandler {
 
  private:
   void DumpInputBuffers(void);
+  void InitLayerTrace();
+  void RecordLayerTrace();
+  uint32_t GetLayerChecksum(Layer *layer);
   bool CanSkipSdmPrepare(uint32_t *num_types, uint32_t *num_requests);
   void UpdateRefreshRate();
   void WaitOnPreviousFence();
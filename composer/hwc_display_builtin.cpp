@@ -214,6 +214,10 @@ HWC2::Error HWCDisplayBuiltIn::Validate(uint32_t *out_num_types, uint32_t *out_n
     return status;
   }
 
+  if (cpu_hint_) {
+    cpu_hint_->ValidateStart();
+  }
+
   if (color_tranform_failed_) {
     // Must fall back to client composition
     MarkLayersForClientComposition();
@@ -253,10 +257,6 @@ HWC2::Error HWCDisplayBuiltIn::Validate(uint32_t *out_num_types, uint32_t *out_n
 
   uint32_t num_updating_layers = GetUpdatingLayersCount();
   bool one_updating_layer = (num_updating_layers == 1);
-  if (num_updating_layers != 0) {
-    ToggleCPUHint(one_updating_layer);
-  }
-
   uint32_t refresh_rate = GetOptimalRefreshRate(one_updating_layer);
   bool idle_screen = GetUpdatingAppLayersCount() == 0;
   error = display_intf_->SetRefreshRate(refresh_rate, force_refresh_rate_, idle_screen);
@@ -284,11 +284,17 @@ HWC2::Error HWCDisplayBuiltIn::Validate(uint32_t *out_num_types, uint32_t *out_n
     // Avoid flush for Command mode panel.
     flush_ = !client_connected_;
     validated_ = true;
-    return status;
+  } else {
+    status = PrepareLayerStack(out_num_types, out_num_requests);
+    pending_commit_ = true;
   }
 
-  status = PrepareLayerStack(out_num_types, out_num_requests);
-  pending_commit_ = true;
+  // Close the validate phase on every path that opened it, else the frame sample loses the
+  // validate time and keeps a stale refresh rate.
+  if (cpu_hint_) {
+    bool gpu_composition = !layer_set_.empty() && has_client_composition_;
+    cpu_hint_->ValidateDone(gpu_composition, current_refresh_rate_);
+  }
   return status;
 }
 
@@ -486,6 +492,9 @@ HWC2::Error HWCDisplayBuiltIn::Present(shared_ptr<Fence> *out_retire_fence) {
       DLOGE("Flush failed. Error = %d", error);
     }
   } else {
+    if (cpu_hint_) {
+      cpu_hint_->PresentStart();
+    }
     CacheAvrStatus();
     DisplayConfigFixedInfo fixed_info = {};
     display_intf_->GetConfig(&fixed_info);
@@ -518,6 +527,9 @@ HWC2::Error HWCDisplayBuiltIn::Present(shared_ptr<Fence> *out_retire_fence) {
         SetActiveConfigIndex(active_config);
       }
     }
+    if (cpu_hint_) {
+      cpu_hint_->PresentDone();
+    }
   }
 
   pending_commit_ = false;
@@ -850,18 +862,6 @@ void HWCDisplayBuiltIn::SetQDCMSolidFillInfo(bool enable, const LayerSolidFill &
   solid_fill_color_ = color;
 }
 
-void HWCDisplayBuiltIn::ToggleCPUHint(bool set) {
-  if (!cpu_hint_) {
-    return;
-  }
-
-  if (set) {
-    cpu_hint_->Set();
-  } else {
-    cpu_hint_->Reset();
-  }
-}
-
 int HWCDisplayBuiltIn::HandleSecureSession(const std::bitset<kSecureMax> &secure_sessions,
                                            bool *power_on_pending, bool is_active_secure_display) {
   if (!power_on_pending) {
@@ -941,7 +941,7 @@ void HWCDisplayBuiltIn::HandleFrameOutput() {
 
 void HWCDisplayBuiltIn::HandleFrameCapture() {
   if (readback_configured_ && output_buffer_.release_fence) {
-    frame_capture_status_ = Fence::Wait(output_buffer_.release_fence);
+    WatchFrameCaptureFence(output_buffer_.release_fence);
   }
 
   frame_capture_buffer_queued_ = false;
@@ -952,6 +952,32 @@ void HWCDisplayBuiltIn::HandleFrameCapture() {
   cwb_client_ = kCWBClientNone;
 }
 
+void HWCDisplayBuiltIn::WatchFrameCaptureFence(const shared_ptr<Fence> &release_fence) {
+  // The client polls GetFrameCaptureStatus() until it is no longer -EAGAIN, so the status can be
+  // set once readback completes instead of stalling this commit on the readback fence.
+  FenceWatcher *watcher = Fence::GetWatcher();
+  auto on_done = [this](FenceWatcher::Result result, int64_t wait_ns) {
+    switch (result) {
+      case FenceWatcher::Result::kSignaled:
+        frame_capture_status_ = kErrorNone;
+        break;
+      case FenceWatcher::Result::kTimedOut:
+        frame_capture_status_ = kErrorTimeOut;
+        break;
+      case FenceWatcher::Result::kFailed:
+        frame_capture_status_ = kErrorUndefined;
+        break;
+      case FenceWatcher::Result::kCancelled:
+        break;
+    }
+  };
+
+  if (!watcher || watcher->Watch(release_fence, kFrameCaptureTimeoutMs, "frame_capture", on_done,
+                                 &frame_capture_watch_id_) != kErrorNone) {
+    frame_capture_status_ = Fence::Wait(release_fence, kFrameCaptureTimeoutMs);
+  }
+}
+
 void HWCDisplayBuiltIn::HandleFrameDump() {
   if (dump_frame_count_) {
     int ret = 0;
@@ -1071,6 +1097,9 @@ int HWCDisplayBuiltIn::FrameCaptureAsync(const BufferInfo &output_buffer_info,
     return -1;
   }
 
+  // A capture still waiting on its fence must not report over the new one.
+  CancelFrameCaptureWatch();
+
   const native_handle_t *buffer = static_cast<native_handle_t *>(output_buffer_info.private_data);
   SetReadbackBuffer(buffer, nullptr, post_processed_output, kCWBClientColor);
   frame_capture_buffer_queued_ = true;
@@ -1079,6 +1108,16 @@ int HWCDisplayBuiltIn::FrameCaptureAsync(const BufferInfo &output_buffer_info,
   return 0;
 }
 
+void HWCDisplayBuiltIn::CancelFrameCaptureWatch() {
+  if (frame_capture_watch_id_ == FenceWatcher::kInvalidWatchId) {
+    return;
+  }
+
+  // A valid id means the shared watcher is running.
+  Fence::GetWatcher()->Cancel(frame_capture_watch_id_);
+  frame_capture_watch_id_ = FenceWatcher::kInvalidWatchId;
+}
+
 DisplayError HWCDisplayBuiltIn::SetDetailEnhancerConfig
                                    (const DisplayDetailEnhancerData &de_data) {
   DisplayError error = kErrorNotSupported;
@@ -1345,6 +1384,8 @@ int HWCDisplayBuiltIn::Deinit() {
     layer_stitch_task_.PerformTask(LayerStitchTaskCode::kCodeDestroyInstance, nullptr);
   }
 
+  CancelFrameCaptureWatch();
+
   histogram.stop();
   return HWCDisplay::Deinit();
 }
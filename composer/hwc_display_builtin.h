@@ -31,12 +31,14 @@
 #define __HWC_DISPLAY_BUILTIN_H__
 
 #include <thermal_client.h>
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <vector>
 
 #include "utils/sync_task.h"
 #include "utils/constants.h"
+#include "utils/fence_watcher.h"
 #include "cpuhint.h"
 #include "hwc_display.h"
 #include "hwc_layers.h"
@@ -155,12 +157,13 @@ class HWCDisplayBuiltIn : public HWCDisplay, public SyncTask<LayerStitchTaskCode
   virtual DisplayError DisablePartialUpdateOneFrame();
   void ProcessBootAnimCompleted(void);
   void SetQDCMSolidFillInfo(bool enable, const LayerSolidFill &color);
-  void ToggleCPUHint(bool set);
   void ForceRefreshRate(uint32_t refresh_rate);
   uint32_t GetOptimalRefreshRate(bool one_updating_layer);
   void HandleFrameOutput();
   void HandleFrameDump();
   void HandleFrameCapture();
+  void WatchFrameCaptureFence(const shared_ptr<Fence> &release_fence);
+  void CancelFrameCaptureWatch();
   bool CanSkipCommit();
   DisplayError SetMixerResolution(uint32_t width, uint32_t height);
   DisplayError GetMixerResolution(uint32_t *width, uint32_t *height);
@@ -184,6 +187,7 @@ class HWCDisplayBuiltIn : public HWCDisplay, public SyncTask<LayerStitchTaskCode
   constexpr static int kBwLow = 2;
   constexpr static int kBwMedium = 3;
   constexpr static int kBwHigh = 4;
+  constexpr static int kFrameCaptureTimeoutMs = 1000;
 
   BufferAllocator *buffer_allocator_ = nullptr;
   CPUHint *cpu_hint_ = nullptr;
@@ -205,7 +209,8 @@ class HWCDisplayBuiltIn : public HWCDisplay, public SyncTask<LayerStitchTaskCode
 
   // Members for 1 frame capture in a client provided buffer
   bool frame_capture_buffer_queued_ = false;
-  int frame_capture_status_ = -EAGAIN;
+  std::atomic<int> frame_capture_status_ {-EAGAIN};  // Set from the fence watcher thread
+  FenceWatcher::WatchId frame_capture_watch_id_ = FenceWatcher::kInvalidWatchId;
   bool is_primary_ = false;
   bool disable_layer_stitch_ = true;
   HWCLayer* stitch_target_ = nullptr;
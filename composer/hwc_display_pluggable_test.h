@@ -30,10 +30,9 @@
 #ifndef __HWC_DISPLAY_PLUGGABLE_TEST_H__
 #define __HWC_DISPLAY_PLUGGABLE_TEST_H__
 
-#include <bitset>
-
 #include "hwc_display.h"
 #include "hwc_buffer_allocator.h"
+#include "hwc_test_pattern.h"
 
 namespace sdm {
 
@@ -53,31 +52,6 @@ class HWCDisplayPluggableTest : public HWCDisplay {
   uint32_t panel_bpp_ = 0;
   uint32_t pattern_type_ = 0;
 
-  enum ColorPatternType {
-    kPatternNone = 0,
-    kPatternColorRamp,
-    kPatternBWVertical,
-    kPatternColorSquare,
-  };
-
-  enum DisplayBpp {
-    kDisplayBpp18 = 18,
-    kDisplayBpp24 = 24,
-    kDisplayBpp30 = 30,
-  };
-
-  enum ColorRamp {
-    kColorRedRamp = 0,
-    kColorGreenRamp = 1,
-    kColorBlueRamp = 2,
-    kColorWhiteRamp = 3,
-  };
-
-  enum Colors {
-    kColorBlack = 0,
-    kColorWhite = 1,
-  };
-
  private:
   HWCDisplayPluggableTest(CoreInterface *core_intf, HWCBufferAllocator *buffer_allocator,
                           HWCCallbacks *callbacks, HWCDisplayEventHandler *event_handler,
@@ -86,13 +60,7 @@ class HWCDisplayPluggableTest : public HWCDisplay {
   int Init();
   int Deinit();
   void DumpInputBuffer();
-  void CalcCRC(uint32_t color_value, std::bitset<16> *crc_data);
   int FillBuffer();
-  int GetStride(LayerBufferFormat format, uint32_t width, uint32_t *stride);
-  void PixelCopy(uint32_t red, uint32_t green, uint32_t blue, uint32_t alpha, uint8_t **buffer);
-  void GenerateColorRamp(uint8_t *buffer);
-  void GenerateBWVertical(uint8_t *buffer);
-  void GenerateColorSquare(uint8_t *buffer);
   int InitLayer(Layer *layer);
   int DeinitLayer(Layer *layer);
   int CreateLayerStack();
@@ -31,6 +31,7 @@
 #include <utils/String16.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/frame_trace.h>
 #include <QService.h>
 #include <utils/utils.h>
 #include <algorithm>
@@ -192,6 +193,18 @@ int HWCSession::Init() {
   async_vds_creation_ = (value == 1);
   DLOGI("async_vds_creation: %d", async_vds_creation_);
 
+  value = 0;
+  Debug::Get()->GetProperty(CWB_MIN_INTERVAL_PROP, &value);
+  cwb_.SetMinInterval(UINT32(std::max(value, 0)));
+
+  value = 0;
+  Debug::Get()->GetProperty(LOCK_PROFILE_PROP, &value);
+  if (value) {
+    NameLockers();
+    Locker::EnableProfiling(true);
+    DLOGI("Lock contention profiling enabled");
+  }
+
   InitSupportedDisplaySlots();
   // Create primary display here. Remaining builtin displays will be created after client has set
   // display indexes which may happen sometime before callback is registered.
@@ -544,7 +557,10 @@ void HWCSession::Dump(uint32_t *out_size, char *out_buffer) {
         hwc_display_[id]->Dump(&os);
       }
     }
+    FrameTrace::Dump(&os);
+    ExportFrameTrace(&os);
     Fence::Dump(&os);
+    Locker::DumpProfile(&os);
 
     std::string s = os.str();
     auto copied = s.copy(out_buffer, std::min(s.size(), max_dump_size), 0);
@@ -552,6 +568,32 @@ void HWCSession::Dump(uint32_t *out_size, char *out_buffer) {
   }
 }
 
+void HWCSession::NameLockers() {
+  for (int i = 0; i < HWCCallbacks::kNumDisplays; i++) {
+    locker_[i].SetName("HWCSession::locker_", i);
+    power_state_[i].SetName("HWCSession::power_state_", i);
+    hdr_locker_[i].SetName("HWCSession::hdr_locker_", i);
+  }
+  display_config_locker_.SetName("HWCSession::display_config_locker_");
+  system_locker_.SetName("HWCSession::system_locker_");
+}
+
+void HWCSession::ExportFrameTrace(std::ostringstream *os) {
+  int format = 0;
+  HWCDebugHandler::Get()->GetProperty(FRAME_TRACE_EXPORT_PROP, &format);
+  if (format != 1 && format != 2) {
+    return;
+  }
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/frame_trace.%s", HWCDebugHandler::DumpDir(),
+           (format == 1) ? "sdft" : "json");
+  if (FrameTrace::Export(path, (format == 1) ? kFrameTraceBinary : kFrameTraceJson) ==
+      kErrorNone) {
+    *os << "Frame trace exported to " << path << "\n";
+  }
+}
+
 uint32_t HWCSession::GetMaxVirtualDisplayCount() {
   return map_info_virtual_.size();
 }
@@ -46,6 +46,7 @@
 #include "hwc_socket_handler.h"
 #include "hwc_display_event_handler.h"
 #include "hwc_buffer_sync_handler.h"
+#include "hwc_capture_scheduler.h"
 #include "hwc_display_virtual_factory.h"
 
 using ::android::hardware::Return;
@@ -300,34 +301,27 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   static Locker system_locker_;
 
  private:
-  class CWB {
+  // Serves DisplayConfig CWB requests through the capture scheduler, on the primary display.
+  class CWB : public CaptureBackend {
    public:
-    explicit CWB(HWCSession *hwc_session) : hwc_session_(hwc_session) { }
+    explicit CWB(HWCSession *hwc_session) : hwc_session_(hwc_session), scheduler_(this) { }
     void PresentDisplayDone(hwc2_display_t disp_id);
+    void SetMinInterval(uint32_t min_interval_ms) { scheduler_.SetMinInterval(min_interval_ms); }
 
     int32_t PostBuffer(std::weak_ptr<DisplayConfig::ConfigCallback> callback, bool post_processed,
                        const native_handle_t *buffer);
 
-   private:
-    struct QueueNode {
-      QueueNode(std::weak_ptr<DisplayConfig::ConfigCallback> cb, bool pp, const hidl_handle& buf)
-        : callback(cb), post_processed(pp), buffer(buf) { }
-
-      std::weak_ptr<DisplayConfig::ConfigCallback> callback;
-      bool post_processed = false;
-      const native_handle_t *buffer;
-    };
-
-    void ProcessRequests();
-    static void AsyncTask(CWB *cwb);
+    int Configure(const native_handle_t *buffer, bool post_processed) override;
+    int Capture() override;
+    bool CanShare(const native_handle_t *src, const native_handle_t *dst) override;
+    int Copy(const native_handle_t *src, const native_handle_t *dst) override;
 
-    std::queue<QueueNode *> queue_;
-
-    std::future<void> future_;
-    Locker queue_lock_;
+   private:
     std::mutex mutex_;
     std::condition_variable cv_;
+    uint64_t present_count_ = 0;
     HWCSession *hwc_session_ = nullptr;
+    CaptureScheduler scheduler_;  // Last, so that its thread stops before the rest goes away
   };
 
   class DisplayConfigImpl: public DisplayConfig::ConfigInterface {
@@ -503,6 +497,8 @@ class HWCSession : hwc2_device_t, HWCUEventListener, public qClient::BnQClient,
   int32_t GetVirtualDisplayId();
   void PerformQsyncCallback(hwc2_display_t display);
   bool isSmartPanelConfig(uint32_t disp_id, uint32_t config_id);
+  void ExportFrameTrace(std::ostringstream *os);
+  void NameLockers();
 
   CoreInterface *core_intf_ = nullptr;
   HWCDisplay *hwc_display_[HWCCallbacks::kNumDisplays] = {nullptr};
@@ -30,6 +30,9 @@
 #include <core/buffer_allocator.h>
 #include <utils/debug.h>
 #include <sync/sync.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/dma-buf.h>
 #include <vector>
 #include <string>
 
@@ -987,110 +990,146 @@ int HWCSession::DisplayConfigImpl::SetCWBOutputBuffer(uint32_t disp_id,
 
 int32_t HWCSession::CWB::PostBuffer(std::weak_ptr<DisplayConfig::ConfigCallback> callback,
                                     bool post_processed, const native_handle_t *buffer) {
-  SCOPE_LOCK(queue_lock_);
+  CaptureRequest request;
+  // Requests of the same DisplayConfig client are queued together.
+  request.client_id = reinterpret_cast<uintptr_t>(callback.lock().get());
+  request.post_processed = post_processed;
+  request.buffer = buffer;
+  request.done = [callback, buffer](int status) {
+    // Notify client about buffer status and release the cloned handle.
+    std::shared_ptr<DisplayConfig::ConfigCallback> config_callback = callback.lock();
+    if (config_callback) {
+      config_callback->NotifyCWBBufferDone(status, buffer);
+    }
 
-  // Ensure that async task runs only until all queued CWB requests have been fulfilled.
-  // If cwb queue is empty, async task has not either started or async task has finished
-  // processing previously queued cwb requests. Start new async task on such a case as
-  // currently running async task will automatically desolve without processing more requests.
-  bool post_future = !queue_.size();
+    native_handle_close(buffer);
+    native_handle_delete(const_cast<native_handle_t *>(buffer));
+  };
+  scheduler_.Queue(std::move(request));
 
-  QueueNode *node = new QueueNode(callback, post_processed, buffer);
-  queue_.push(node);
+  return 0;
+}
 
-  if (post_future) {
-    // No need to do future.get() here for previously running async task. Async method will
-    // guarantee to exit after cwb for all queued requests is indeed complete i.e. the respective
-    // fences have signaled and client is notified through registered callbacks. This will make
-    // sure that the new async task does not concurrently work with previous task. Let async running
-    // thread dissolve on its own.
-    future_ = std::async(HWCSession::CWB::AsyncTask, this);
+int HWCSession::CWB::Configure(const native_handle_t *buffer, bool post_processed) {
+  HWCDisplay *hwc_display = hwc_session_->hwc_display_[HWC_DISPLAY_PRIMARY];
+  Locker &locker = hwc_session_->locker_[HWC_DISPLAY_PRIMARY];
+
+  // Wait for previous commit to finish before configuring next buffer.
+  SEQUENCE_WAIT_SCOPE_LOCK(locker);
+  auto error = hwc_display->SetReadbackBuffer(buffer, nullptr, post_processed,
+                                              kCWBClientExternal);
+  if (error == HWC2::Error::NoResources) {
+    // Frame dump, color manager or SurfaceFlinger readback holds the output.
+    return -EBUSY;
+  } else if (error != HWC2::Error::None) {
+    DLOGE("CWB buffer could not be set.");
+    return -EINVAL;
   }
 
   return 0;
 }
 
-void HWCSession::CWB::ProcessRequests() {
+// Longest wait for the frame a capture triggered, several vsyncs at any refresh rate.
+static const uint32_t kCWBCaptureTimeoutMs = 1000;
+
+int HWCSession::CWB::Capture() {
   HWCDisplay *hwc_display = hwc_session_->hwc_display_[HWC_DISPLAY_PRIMARY];
   Locker &locker = hwc_session_->locker_[HWC_DISPLAY_PRIMARY];
 
-  while (true) {
-    QueueNode *node = nullptr;
-    int status = 0;
-
-    // Mutex scope
-    // Just check if there is a next cwb request queued, exit the thread if nothing is pending.
-    // Do not keep mutex locked so that client can freely queue more jobs to the current thread.
-    {
-      SCOPE_LOCK(queue_lock_);
-      if (!queue_.size()) {
-        break;
-      }
+  // Trigger refresh, wait for commit, get the release fence and wait for fence to signal.
+  bool presented = false;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t present_count = present_count_;
+    hwc_session_->callbacks_.Refresh(HWC_DISPLAY_PRIMARY);
+    // A display that stopped presenting must not stall the scheduler and every queued client.
+    presented = cv_.wait_for(lock, std::chrono::milliseconds(kCWBCaptureTimeoutMs),
+                             [this, present_count] { return present_count_ != present_count; });
+  }
 
-      node = queue_.front();
-    }
+  shared_ptr<Fence> release_fence = nullptr;
+  // Also detaches the buffer from the display, so that a late frame does not write into it.
+  {
+    SCOPE_LOCK(locker);
+    hwc_display->GetReadbackBufferFence(&release_fence);
+  }
 
-    // Configure cwb parameters, trigger refresh, wait for commit, get the release fence and
-    // wait for fence to signal.
-
-    // Mutex scope
-    // Wait for previous commit to finish before configuring next buffer.
-    {
-      SEQUENCE_WAIT_SCOPE_LOCK(locker);
-      if (hwc_display->SetReadbackBuffer(node->buffer, nullptr, node->post_processed,
-                                         kCWBClientExternal) != HWC2::Error::None) {
-        DLOGE("CWB buffer could not be set.");
-        status = -1;
-      }
+  if (!presented) {
+    DLOGE("CWB capture timed out after %u ms", kCWBCaptureTimeoutMs);
+    if (release_fence) {
+      // A commit picked the buffer up after all, let it finish writing before the buffer is freed.
+      Fence::Wait(release_fence, INT(kCWBCaptureTimeoutMs));
     }
+    return -ETIMEDOUT;
+  }
 
-    if (!status) {
-      hwc_session_->callbacks_.Refresh(HWC_DISPLAY_PRIMARY);
+  if (!release_fence) {
+    // The frame that was presented did not pick the buffer up, it holds no capture.
+    DLOGE("CWB release fence could not be retrieved.");
+    return -ENODATA;
+  }
 
-      std::unique_lock<std::mutex> lock(mutex_);
-      cv_.wait(lock);
+  // The commit is done, its writeback finishes within a frame.
+  return (Fence::Wait(release_fence, INT(kCWBCaptureTimeoutMs)) == kErrorNone) ? 0 : -ETIMEDOUT;
+}
 
-      shared_ptr<Fence> release_fence = nullptr;
-      // Mutex scope
-      {
-        SCOPE_LOCK(locker);
-        hwc_display->GetReadbackBufferFence(&release_fence);
-      }
+bool HWCSession::CWB::CanShare(const native_handle_t *src, const native_handle_t *dst) {
+  auto src_handle = reinterpret_cast<const private_handle_t *>(src);
+  auto dst_handle = reinterpret_cast<const private_handle_t *>(dst);
 
-      if (release_fence >= 0) {
-        status = Fence::Wait(release_fence);
-      } else {
-        DLOGE("CWB release fence could not be retrieved.");
-        status = -1;
-      }
-    }
+  return src_handle && dst_handle && (src_handle->width == dst_handle->width) &&
+         (src_handle->height == dst_handle->height) &&
+         (src_handle->format == dst_handle->format) &&
+         (src_handle->flags == dst_handle->flags) && (src_handle->size == dst_handle->size);
+}
 
-    // Notify client about buffer status and erase the node from pending request queue.
-    std::shared_ptr<DisplayConfig::ConfigCallback> callback = node->callback.lock();
-    if (callback) {
-      callback->NotifyCWBBufferDone(status, node->buffer);
-    }
+static int SyncDmaBuf(int fd, uint64_t flags) {
+  struct dma_buf_sync sync = {};
+  sync.flags = flags;
+  if (ioctl(fd, INT(DMA_BUF_IOCTL_SYNC), &sync)) {
+    int err = errno;
+    DLOGE("DMA_BUF_IOCTL_SYNC on fd %d failed with err %d", fd, err);
+    return -err;
+  }
 
-    native_handle_close(node->buffer);
-    native_handle_delete(const_cast<native_handle_t *>(node->buffer));
-    delete node;
+  return 0;
+}
 
-    // Mutex scope
-    // Make sure to exit here, if queue becomes empty after erasing current node from queue,
-    // so that the current async task does not operate concurrently with a new future task.
-    {
-      SCOPE_LOCK(queue_lock_);
-      queue_.pop();
+int HWCSession::CWB::Copy(const native_handle_t *src, const native_handle_t *dst) {
+  auto src_handle = reinterpret_cast<const private_handle_t *>(src);
+  auto dst_handle = reinterpret_cast<const private_handle_t *>(dst);
+  size_t size = src_handle->size;
 
-      if (!queue_.size()) {
-        break;
-      }
+  void *src_base = mmap(NULL, size, PROT_READ, MAP_SHARED, src_handle->fd, 0);
+  if (src_base == MAP_FAILED) {
+    DLOGE("mmap of CWB output failed with err %d", errno);
+    return -errno;
+  }
+
+  void *dst_base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, dst_handle->fd, 0);
+  if (dst_base == MAP_FAILED) {
+    int err = errno;
+    DLOGE("mmap of shared CWB buffer failed with err %d", err);
+    munmap(src_base, size);
+    return -err;
+  }
+
+  // The buffers may be cached, bracket the CPU access so that the copy reads what writeback wrote
+  // and the client reads what the copy wrote.
+  int err = SyncDmaBuf(src_handle->fd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ);
+  if (!err) {
+    err = SyncDmaBuf(dst_handle->fd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE);
+    if (!err) {
+      memcpy(dst_base, src_base, size);
+      err = SyncDmaBuf(dst_handle->fd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE);
     }
+    SyncDmaBuf(src_handle->fd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ);
   }
-}
 
-void HWCSession::CWB::AsyncTask(CWB *cwb) {
-  cwb->ProcessRequests();
+  munmap(dst_base, size);
+  munmap(src_base, size);
+
+  return err;
 }
 
 void HWCSession::CWB::PresentDisplayDone(hwc2_display_t disp_id) {
@@ -1099,6 +1138,7 @@ void HWCSession::CWB::PresentDisplayDone(hwc2_display_t disp_id) {
   }
 
   std::unique_lock<std::mutex> lock(mutex_);
+  present_count_++;
   cv_.notify_one();
 }
 
@@ -0,0 +1,413 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <errno.h>
+#include <algorithm>
+#include <cstring>
+
+#include "hwc_test_pattern.h"
+
+#define __CLASS__ "HWCTestPattern"
+
+namespace sdm {
+
+using std::array;
+
+HWCTestPattern::HWCTestPattern(uint32_t panel_bpp, LayerBufferFormat format, uint32_t width,
+                               uint32_t height, uint32_t stride)
+  : panel_bpp_(panel_bpp), format_(format), width_(width), height_(height), stride_(stride) {
+}
+
+int HWCTestPattern::Generate(uint32_t pattern_type, uint8_t *buffer, ComponentCRC *crc) {
+  *crc = {};
+
+  switch (pattern_type) {
+    case kPatternColorRamp:
+      GenerateColorRamp(buffer, crc);
+      break;
+    case kPatternBWVertical:
+      GenerateBWVertical(buffer, crc);
+      break;
+    case kPatternColorSquare:
+      GenerateColorSquare(buffer, crc);
+      break;
+    default:
+      DLOGW("Invalid Pattern type %d", pattern_type);
+      return -EINVAL;
+  }
+
+  return 0;
+}
+
+// The panel CRC folds each 16 bit component word into the CRC as crc' = L(crc ^ word), where bit
+// n of L(x) is the parity of x masked with kCRCMasks[n]. L is linear, so it is tabulated per byte.
+static const uint16_t kCRCMasks[16] = {
+  0xBFFF, 0x7FFE, 0x4003, 0x8006, 0x000C, 0x0018, 0x0030, 0x0060,
+  0x00C0, 0x0180, 0x0300, 0x0600, 0x0C00, 0x1800, 0x3000, 0xDFFF,
+};
+
+static uint16_t CRCTransform(uint16_t value) {
+  uint16_t result = 0;
+  for (uint32_t bit = 0; bit < 16; bit++) {
+    result |= UINT16(__builtin_parity(value & kCRCMasks[bit]) << bit);
+  }
+
+  return result;
+}
+
+struct CRCTable {
+  CRCTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+      lo[i] = CRCTransform(UINT16(i));
+      hi[i] = CRCTransform(UINT16(i << 8));
+    }
+  }
+
+  array<uint16_t, 256> lo = {};
+  array<uint16_t, 256> hi = {};
+};
+
+uint16_t HWCTestPattern::UpdateCRC(uint16_t crc, uint16_t word) {
+  static const CRCTable crc_table;
+  uint16_t value = crc ^ word;
+
+  return crc_table.lo[value & 0xFF] ^ crc_table.hi[value >> 8];
+}
+
+bool HWCTestPattern::GetCRCWord(uint32_t color_val, uint16_t *word) {
+  switch (panel_bpp_) {
+    case kDisplayBpp18:
+      *word = UINT16((color_val & 0xFC) << 8);
+      return true;
+    case kDisplayBpp24:
+      *word = UINT16(color_val << 8);
+      return true;
+    case kDisplayBpp30:
+      *word = UINT16(color_val << 6);
+      return true;
+    default:
+      // Unsupported panel depths leave the CRC untouched.
+      return false;
+  }
+}
+
+void HWCTestPattern::InitCRCJump(uint32_t count, CRCJump *jump) {
+  // Image of each CRC bit after count zero words; any other CRC is a xor of these.
+  array<uint16_t, 16> basis = {};
+  for (uint32_t bit = 0; bit < 16; bit++) {
+    uint16_t crc = UINT16(1 << bit);
+    for (uint32_t i = 0; i < count; i++) {
+      crc = UpdateCRC(crc, 0);
+    }
+    basis[bit] = crc;
+  }
+
+  for (uint32_t i = 0; i < 256; i++) {
+    jump->lo[i] = 0;
+    jump->hi[i] = 0;
+    for (uint32_t bit = 0; bit < 8; bit++) {
+      if (i & (1 << bit)) {
+        jump->lo[i] ^= basis[bit];
+        jump->hi[i] ^= basis[bit + 8];
+      }
+    }
+  }
+}
+
+void HWCTestPattern::AccumulateCRC(const RowCRC &row_crc, const CRCJump &jump, ComponentCRC *crc) {
+  for (uint32_t i = 0; i < crc->size(); i++) {
+    uint16_t value = (*crc)[i];
+    (*crc)[i] = jump.lo[value & 0xFF] ^ jump.hi[value >> 8] ^ row_crc.component[i];
+  }
+}
+
+int HWCTestPattern::GetStride(LayerBufferFormat format, uint32_t width, uint32_t *stride) {
+  switch (format) {
+  case kFormatRGBA8888:
+  case kFormatRGBA1010102:
+    *stride = width * 4;
+    break;
+  case kFormatRGB888:
+    *stride = width * 3;
+    break;
+  default:
+    DLOGW("Unsupported format type %d", format);
+    return -EINVAL;
+  }
+
+  return 0;
+}
+
+void HWCTestPattern::PixelCopy(uint32_t red, uint32_t green, uint32_t blue, uint32_t alpha,
+                               uint8_t **buffer) {
+  switch (format_) {
+    case kFormatRGBA8888:
+      *(*buffer)++ = UINT8(red & 0xFF);
+      *(*buffer)++ = UINT8(green & 0xFF);
+      *(*buffer)++ = UINT8(blue & 0xFF);
+      *(*buffer)++ = UINT8(alpha & 0xFF);
+      break;
+    case kFormatRGB888:
+      *(*buffer)++ = UINT8(red & 0xFF);
+      *(*buffer)++ = UINT8(green & 0xFF);
+      *(*buffer)++ = UINT8(blue & 0xFF);
+      break;
+    case kFormatRGBA1010102:
+      // Lower 8 bits of red
+      *(*buffer)++ = UINT8(red & 0xFF);
+
+      // Upper 2 bits of Red + Lower 6 bits of green
+      *(*buffer)++ = UINT8(((green & 0x3F) << 2) | ((red >> 0x8) & 0x3));
+
+      // Upper 4 bits of green + Lower 4 bits of blue
+      *(*buffer)++ = UINT8(((blue & 0xF) << 4) | ((green >> 6) & 0xF));
+
+      // Upper 6 bits of blue + Lower 2 bits of alpha
+      *(*buffer)++ = UINT8(((alpha & 0x3) << 6) | ((blue >> 4) & 0x3F));
+      break;
+    default:
+      DLOGW("format not supported format = %d", format_);
+      break;
+  }
+}
+
+void HWCTestPattern::WriteRow(const std::vector<PixelColor> &pixels, uint8_t *buffer,
+                              RowCRC *row_crc) {
+  uint8_t *temp = buffer;
+  uint8_t *last_pixel = nullptr;
+  size_t pixel_size = 0;
+  *row_crc = {};
+
+  for (uint32_t i = 0; i < pixels.size(); i++) {
+    const PixelColor &color = pixels[i];
+    if (last_pixel && color == pixels[i - 1]) {
+      // Runs of one color are copied from the previously packed pixel.
+      memcpy(temp, last_pixel, pixel_size);
+      last_pixel = temp;
+      temp += pixel_size;
+    } else {
+      last_pixel = temp;
+      PixelCopy(color[0], color[1], color[2], 0, &temp);
+      pixel_size = size_t(temp - last_pixel);
+    }
+
+    for (uint32_t c = 0; c < color.size(); c++) {
+      uint16_t word = 0;
+      if (GetCRCWord(color[c], &word)) {
+        row_crc->component[c] = UpdateCRC(row_crc->component[c], word);
+      }
+    }
+  }
+}
+
+void HWCTestPattern::GenerateColorRamp(uint8_t *buffer, ComponentCRC *crc) {
+  uint32_t width = width_;
+  uint32_t height = height_;
+  uint32_t buffer_stride = stride_;
+
+  uint32_t color_ramp = 0;
+  uint32_t start_color_val = 0;
+  uint32_t step_size = 1;
+  uint32_t ramp_width = 0;
+  uint32_t ramp_height = 0;
+  uint32_t shift_by = 0;
+
+  std::vector<PixelColor> pixels(width);
+  RowCRC row_crc = {};
+  CRCJump jump = {};
+
+  switch (panel_bpp_) {
+    case kDisplayBpp18:
+      ramp_height = 64;
+      ramp_width = 64;
+      shift_by = 2;
+      break;
+    case kDisplayBpp24:
+      ramp_height = 64;
+      ramp_width = 256;
+      break;
+    case kDisplayBpp30:
+      ramp_height = 32;
+      ramp_width = 256;
+      start_color_val = 0x180;
+      break;
+    default:
+      return;
+  }
+
+  InitCRCJump(width, &jump);
+
+  // Rows only change at ramp boundaries; repeated rows are copied from the previous one.
+  bool row_changed = true;
+  for (uint32_t loop_height = 0; loop_height < height; loop_height++) {
+    uint8_t *temp = buffer + (loop_height * buffer_stride);
+
+    if (row_changed) {
+      uint32_t color_value = start_color_val;
+      for (uint32_t loop_width = 0; loop_width < width; loop_width++) {
+        PixelColor &pixel = pixels[loop_width];
+        pixel = {};
+        if (color_ramp == kColorWhiteRamp) {
+          pixel = {{color_value, color_value, color_value}};
+        } else {
+          pixel[color_ramp] = color_value;
+        }
+        color_value = (start_color_val + (((loop_width + 1) % ramp_width) * step_size)) << shift_by;
+      }
+      WriteRow(pixels, temp, &row_crc);
+      row_changed = false;
+    } else {
+      memcpy(temp, temp - buffer_stride, buffer_stride);
+    }
+    AccumulateCRC(row_crc, jump, crc);
+
+    if (panel_bpp_ == kDisplayBpp30 && ((loop_height + 1) % ramp_height) == 0) {
+      if (start_color_val == 0x180) {
+        start_color_val = 0;
+        step_size = 4;
+      } else {
+        start_color_val = 0x180;
+        step_size = 1;
+        color_ramp = (color_ramp + 1) % 4;
+      }
+      row_changed = true;
+      continue;
+    }
+
+    if (((loop_height + 1) % ramp_height) == 0) {
+      color_ramp = (color_ramp + 1) % 4;
+      row_changed = true;
+    }
+  }
+}
+
+void HWCTestPattern::GenerateBWVertical(uint8_t *buffer, ComponentCRC *crc) {
+  uint32_t width = width_;
+  uint32_t height = height_;
+  uint32_t buffer_stride = stride_;
+  uint32_t bits_per_component = panel_bpp_ / 3;
+  uint32_t max_color_val = (1 << bits_per_component) - 1;
+
+  std::vector<PixelColor> pixels(width);
+  RowCRC row_crc = {};
+  CRCJump jump = {};
+
+  if (panel_bpp_ == kDisplayBpp18) {
+    max_color_val <<= 2;
+  }
+
+  InitCRCJump(width, &jump);
+
+  uint32_t color = 0;
+  for (uint32_t loop_width = 0; loop_width < width; loop_width++) {
+    uint32_t color_val = (color == kColorWhite) ? max_color_val : 0;
+    pixels[loop_width] = {{color_val, color_val, color_val}};
+    color = (color + 1) % 2;
+  }
+
+  // Every row is identical, so only the first one is generated.
+  for (uint32_t loop_height = 0; loop_height < height; loop_height++) {
+    uint8_t *temp = buffer + (loop_height * buffer_stride);
+    if (loop_height == 0) {
+      WriteRow(pixels, temp, &row_crc);
+    } else {
+      memcpy(temp, temp - buffer_stride, buffer_stride);
+    }
+    AccumulateCRC(row_crc, jump, crc);
+  }
+}
+
+void HWCTestPattern::GenerateColorSquare(uint8_t *buffer, ComponentCRC *crc) {
+  uint32_t width = width_;
+  uint32_t height = height_;
+  uint32_t buffer_stride = stride_;
+  uint32_t max_color_val = 0;
+  uint32_t min_color_val = 0;
+
+  std::vector<PixelColor> pixels(width);
+  RowCRC row_crc = {};
+  CRCJump jump = {};
+
+  switch (panel_bpp_) {
+    case kDisplayBpp18:
+      max_color_val = 63 << 2;  // CEA Dynamic range for 18bpp 0 - 63
+      min_color_val = 0;
+      break;
+    case kDisplayBpp24:
+      max_color_val = 235;  // CEA Dynamic range for 24bpp 16 - 235
+      min_color_val = 16;
+      break;
+    case kDisplayBpp30:
+      max_color_val = 940;  // CEA Dynamic range for 30bpp 64 - 940
+      min_color_val = 64;
+      break;
+    default:
+      return;
+  }
+
+  array<PixelColor, 8> colors = {{
+    {{max_color_val, max_color_val, max_color_val}},  // White Color
+    {{max_color_val, max_color_val, min_color_val}},  // Yellow Color
+    {{min_color_val, max_color_val, max_color_val}},  // Cyan Color
+    {{min_color_val, max_color_val, min_color_val}},  // Green Color
+    {{max_color_val, min_color_val, max_color_val}},  // Megenta Color
+    {{max_color_val, min_color_val, min_color_val}},  // Red Color
+    {{min_color_val, min_color_val, max_color_val}},  // Blue Color
+    {{min_color_val, min_color_val, min_color_val}},  // Black Color
+  }};
+
+  InitCRCJump(width, &jump);
+
+  // Rows only change every 64 lines; repeated rows are copied from the previous one.
+  for (uint32_t loop_height = 0; loop_height < height; loop_height++) {
+    uint8_t *temp = buffer + (loop_height * buffer_stride);
+
+    if ((loop_height % 64) == 0) {
+      uint32_t color = 0;
+      for (uint32_t loop_width = 0; loop_width < width; loop_width++) {
+        pixels[loop_width] = colors[color];
+        if (((loop_width + 1) % 64) == 0) {
+          color = (color + 1) % colors.size();
+        }
+      }
+      WriteRow(pixels, temp, &row_crc);
+    } else {
+      memcpy(temp, temp - buffer_stride, buffer_stride);
+    }
+    AccumulateCRC(row_crc, jump, crc);
+
+    if (((loop_height + 1) % 64) == 0) {
+      std::reverse(colors.begin(), (colors.end() - 1));
+    }
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,108 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_TEST_PATTERN_H__
+#define __HWC_TEST_PATTERN_H__
+
+#include <core/layer_buffer.h>
+#include <array>
+#include <vector>
+
+namespace sdm {
+
+// Test patterns for the pluggable display test mode and the CRC the panel reports for them.
+class HWCTestPattern {
+ public:
+  enum PatternType {
+    kPatternNone = 0,
+    kPatternColorRamp,
+    kPatternBWVertical,
+    kPatternColorSquare,
+  };
+
+  enum DisplayBpp {
+    kDisplayBpp18 = 18,
+    kDisplayBpp24 = 24,
+    kDisplayBpp30 = 30,
+  };
+
+  typedef std::array<uint16_t, 3> ComponentCRC;  // Red, green and blue CRC.
+
+  HWCTestPattern(uint32_t panel_bpp, LayerBufferFormat format, uint32_t width, uint32_t height,
+                 uint32_t stride);
+  // Writes the pattern into buffer, stride bytes per row, and returns the CRC of its components.
+  int Generate(uint32_t pattern_type, uint8_t *buffer, ComponentCRC *crc);
+  static int GetStride(LayerBufferFormat format, uint32_t width, uint32_t *stride);
+
+ private:
+  enum ColorRamp {
+    kColorRedRamp = 0,
+    kColorGreenRamp = 1,
+    kColorBlueRamp = 2,
+    kColorWhiteRamp = 3,
+  };
+
+  enum Colors {
+    kColorBlack = 0,
+    kColorWhite = 1,
+  };
+
+  typedef std::array<uint32_t, 3> PixelColor;  // Red, green and blue component values.
+
+  // CRC of each component over one row, starting from a zero CRC.
+  struct RowCRC {
+    ComponentCRC component = {};
+  };
+
+  // Advances a CRC over a fixed count of zero words, looked up by low and high byte.
+  struct CRCJump {
+    std::array<uint16_t, 256> lo = {};
+    std::array<uint16_t, 256> hi = {};
+  };
+
+  static uint16_t UpdateCRC(uint16_t crc, uint16_t word);
+  bool GetCRCWord(uint32_t color_value, uint16_t *word);
+  void InitCRCJump(uint32_t count, CRCJump *jump);
+  void AccumulateCRC(const RowCRC &row_crc, const CRCJump &jump, ComponentCRC *crc);
+  void PixelCopy(uint32_t red, uint32_t green, uint32_t blue, uint32_t alpha, uint8_t **buffer);
+  void WriteRow(const std::vector<PixelColor> &pixels, uint8_t *buffer, RowCRC *row_crc);
+  void GenerateColorRamp(uint8_t *buffer, ComponentCRC *crc);
+  void GenerateBWVertical(uint8_t *buffer, ComponentCRC *crc);
+  void GenerateColorSquare(uint8_t *buffer, ComponentCRC *crc);
+
+  uint32_t panel_bpp_ = 0;
+  LayerBufferFormat format_ = kFormatInvalid;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  uint32_t stride_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_TEST_PATTERN_H__
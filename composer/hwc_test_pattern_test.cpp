@@ -0,0 +1,317 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+#include <utils/constants.h>
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <vector>
+
+#include "hwc_test_pattern.h"
+
+using namespace sdm;
+
+namespace {
+
+// Pattern generation and CRC as done per pixel before HWCTestPattern, kept as the golden model.
+class ReferencePattern {
+ public:
+  ReferencePattern(uint32_t panel_bpp, LayerBufferFormat format, uint32_t width, uint32_t height,
+                   uint32_t stride)
+    : panel_bpp_(panel_bpp), format_(format), width_(width), height_(height), stride_(stride) {}
+
+  void Generate(uint32_t pattern_type, uint8_t *buffer, HWCTestPattern::ComponentCRC *crc) {
+    crc_ = {};
+    switch (pattern_type) {
+      case HWCTestPattern::kPatternColorRamp: ColorRamp(buffer); break;
+      case HWCTestPattern::kPatternBWVertical: BWVertical(buffer); break;
+      case HWCTestPattern::kPatternColorSquare: ColorSquare(buffer); break;
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+      (*crc)[i] = UINT16(crc_[i].to_ulong());
+    }
+  }
+
+ private:
+  void CalcCRC(uint32_t color_val, std::bitset<16> *crc_data) {
+    std::bitset<16> color = {};
+    std::bitset<16> c = *crc_data;
+    std::bitset<16> t = {};
+
+    switch (panel_bpp_) {
+      case 18: color = (color_val & 0xFC) << 8; break;
+      case 24: color = color_val << 8; break;
+      case 30: color = color_val << 6; break;
+      default: return;
+    }
+
+    std::bitset<16> x = c ^ color;
+    t[15] = x[0] ^ x[1] ^ x[2] ^ x[3] ^ x[4] ^ x[5] ^ x[6] ^ x[7] ^ x[8] ^ x[9] ^ x[10] ^ x[11] ^
+            x[12] ^ x[14] ^ x[15];
+    for (uint32_t bit = 4; bit <= 14; bit++) {
+      t[bit] = x[bit - 2] ^ x[bit - 1];
+    }
+    t[3] = x[1] ^ x[2] ^ x[15];
+    t[2] = x[0] ^ x[1] ^ x[14];
+    t[1] = x[1] ^ x[2] ^ x[3] ^ x[4] ^ x[5] ^ x[6] ^ x[7] ^ x[8] ^ x[9] ^ x[10] ^ x[11] ^
+           x[12] ^ x[13] ^ x[14];
+    t[0] = x[0] ^ x[1] ^ x[2] ^ x[3] ^ x[4] ^ x[5] ^ x[6] ^ x[7] ^ x[8] ^ x[9] ^ x[10] ^
+           x[11] ^ x[12] ^ x[13] ^ x[15];
+    *crc_data = t;
+  }
+
+  void Pixel(uint32_t red, uint32_t green, uint32_t blue, uint8_t **buffer) {
+    CalcCRC(red, &crc_[0]);
+    CalcCRC(green, &crc_[1]);
+    CalcCRC(blue, &crc_[2]);
+    switch (format_) {
+      case kFormatRGB888:
+        *(*buffer)++ = UINT8(red & 0xFF);
+        *(*buffer)++ = UINT8(green & 0xFF);
+        *(*buffer)++ = UINT8(blue & 0xFF);
+        break;
+      case kFormatRGBA1010102:
+        *(*buffer)++ = UINT8(red & 0xFF);
+        *(*buffer)++ = UINT8(((green & 0x3F) << 2) | ((red >> 0x8) & 0x3));
+        *(*buffer)++ = UINT8(((blue & 0xF) << 4) | ((green >> 6) & 0xF));
+        *(*buffer)++ = UINT8((blue >> 4) & 0x3F);
+        break;
+      default:
+        *(*buffer)++ = UINT8(red & 0xFF);
+        *(*buffer)++ = UINT8(green & 0xFF);
+        *(*buffer)++ = UINT8(blue & 0xFF);
+        *(*buffer)++ = 0;
+        break;
+    }
+  }
+
+  void ColorRamp(uint8_t *buffer) {
+    uint32_t color_ramp = 0, start_color_val = 0, step_size = 1;
+    uint32_t ramp_width = 0, ramp_height = 0, shift_by = 0;
+    switch (panel_bpp_) {
+      case 18: ramp_height = 64; ramp_width = 64; shift_by = 2; break;
+      case 24: ramp_height = 64; ramp_width = 256; break;
+      case 30: ramp_height = 32; ramp_width = 256; start_color_val = 0x180; break;
+      default: return;
+    }
+
+    for (uint32_t y = 0; y < height_; y++) {
+      uint32_t color_value = start_color_val;
+      uint8_t *temp = buffer + (y * stride_);
+      for (uint32_t x = 0; x < width_; x++) {
+        uint32_t v = color_value;
+        switch (color_ramp) {
+          case 0: Pixel(v, 0, 0, &temp); break;
+          case 1: Pixel(0, v, 0, &temp); break;
+          case 2: Pixel(0, 0, v, &temp); break;
+          default: Pixel(v, v, v, &temp); break;
+        }
+        color_value = (start_color_val + (((x + 1) % ramp_width) * step_size)) << shift_by;
+      }
+      if (panel_bpp_ == 30 && ((y + 1) % ramp_height) == 0) {
+        if (start_color_val == 0x180) {
+          start_color_val = 0;
+          step_size = 4;
+        } else {
+          start_color_val = 0x180;
+          step_size = 1;
+          color_ramp = (color_ramp + 1) % 4;
+        }
+        continue;
+      }
+      if (((y + 1) % ramp_height) == 0) {
+        color_ramp = (color_ramp + 1) % 4;
+      }
+    }
+  }
+
+  void BWVertical(uint8_t *buffer) {
+    uint32_t max_color_val = (1 << (panel_bpp_ / 3)) - 1;
+    if (panel_bpp_ == 18) {
+      max_color_val <<= 2;
+    }
+    for (uint32_t y = 0; y < height_; y++) {
+      uint8_t *temp = buffer + (y * stride_);
+      for (uint32_t x = 0; x < width_; x++) {
+        uint32_t v = (x % 2) ? max_color_val : 0;
+        Pixel(v, v, v, &temp);
+      }
+    }
+  }
+
+  void ColorSquare(uint8_t *buffer) {
+    uint32_t max = 0, min = 0;
+    switch (panel_bpp_) {
+      case 18: max = 63 << 2; min = 0; break;
+      case 24: max = 235; min = 16; break;
+      case 30: max = 940; min = 64; break;
+      default: return;
+    }
+    std::array<std::array<uint32_t, 3>, 8> colors = {{
+      {{max, max, max}}, {{max, max, min}}, {{min, max, max}}, {{min, max, min}},
+      {{max, min, max}}, {{max, min, min}}, {{min, min, max}}, {{min, min, min}},
+    }};
+    for (uint32_t y = 0; y < height_; y++) {
+      uint32_t color = 0;
+      uint8_t *temp = buffer + (y * stride_);
+      for (uint32_t x = 0; x < width_; x++) {
+        Pixel(colors[color][0], colors[color][1], colors[color][2], &temp);
+        if (((x + 1) % 64) == 0) {
+          color = (color + 1) % colors.size();
+        }
+      }
+      if (((y + 1) % 64) == 0) {
+        std::reverse(colors.begin(), (colors.end() - 1));
+      }
+    }
+  }
+
+  uint32_t panel_bpp_;
+  LayerBufferFormat format_;
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t stride_;
+  std::array<std::bitset<16>, 3> crc_ = {};
+};
+
+LayerBufferFormat FormatForBpp(uint32_t panel_bpp) {
+  return (panel_bpp == HWCTestPattern::kDisplayBpp30) ? kFormatRGBA1010102 : kFormatRGB888;
+}
+
+const uint32_t kPatterns[] = {
+  HWCTestPattern::kPatternColorRamp, HWCTestPattern::kPatternBWVertical,
+  HWCTestPattern::kPatternColorSquare,
+};
+
+}  // namespace
+
+// Every pattern must produce the same bytes and CRCs as the per-pixel golden model, including
+// buffers with padded rows and sizes that do not divide the ramp and square sizes.
+TEST(HWCTestPatternTest, MatchesGoldenModel) {
+  const uint32_t sizes[][2] = {{1920, 1080}, {333, 257}, {64, 1}, {1, 64}};
+
+  for (uint32_t panel_bpp : {18u, 24u, 30u, 16u}) {
+    LayerBufferFormat format = FormatForBpp(panel_bpp);
+    for (auto &size : sizes) {
+      uint32_t aligned_width = (size[0] + 31) & ~31U;
+      uint32_t stride = 0;
+      ASSERT_EQ(0, HWCTestPattern::GetStride(format, aligned_width, &stride));
+
+      for (uint32_t pattern_type : kPatterns) {
+        std::vector<uint8_t> expected(stride * size[1], 0xA5);
+        std::vector<uint8_t> actual(stride * size[1], 0xA5);
+        HWCTestPattern::ComponentCRC expected_crc = {}, crc = {};
+
+        ReferencePattern(panel_bpp, format, size[0], size[1], stride)
+            .Generate(pattern_type, expected.data(), &expected_crc);
+        HWCTestPattern pattern(panel_bpp, format, size[0], size[1], stride);
+        ASSERT_EQ(0, pattern.Generate(pattern_type, actual.data(), &crc));
+
+        SCOPED_TRACE(testing::Message() << panel_bpp << " bpp, pattern " << pattern_type << ", "
+                     << size[0] << "x" << size[1]);
+        EXPECT_EQ(expected_crc, crc);
+        // Row padding is not part of the pattern.
+        for (uint32_t y = 0; y < size[1]; y++) {
+          uint32_t row_bytes = 0;
+          HWCTestPattern::GetStride(format, size[0], &row_bytes);
+          ASSERT_TRUE(std::equal(expected.begin() + y * stride,
+                                 expected.begin() + y * stride + row_bytes,
+                                 actual.begin() + y * stride)) << "row " << y;
+        }
+      }
+    }
+  }
+}
+
+// An unsupported panel depth must not touch the CRC, whatever is written to the buffer.
+TEST(HWCTestPatternTest, UnsupportedDepthLeavesCRCUntouched) {
+  uint32_t stride = 0;
+  HWCTestPattern::GetStride(kFormatRGB888, 64, &stride);
+  std::vector<uint8_t> buffer(stride * 64);
+
+  for (uint32_t pattern_type : kPatterns) {
+    HWCTestPattern::ComponentCRC crc = {{1, 2, 3}};
+    HWCTestPattern pattern(16, kFormatRGB888, 64, 64, stride);
+    ASSERT_EQ(0, pattern.Generate(pattern_type, buffer.data(), &crc));
+    EXPECT_EQ((HWCTestPattern::ComponentCRC{{0, 0, 0}}), crc) << pattern_type;
+  }
+
+  HWCTestPattern::ComponentCRC crc = {};
+  EXPECT_EQ(-EINVAL, HWCTestPattern(24, kFormatRGB888, 64, 64, stride)
+                         .Generate(HWCTestPattern::kPatternNone, buffer.data(), &crc));
+}
+
+// CRCs of the 1080p 24 bpp patterns, pinned so that a change to both models is still caught.
+TEST(HWCTestPatternTest, GoldenCRC1080p) {
+  const HWCTestPattern::ComponentCRC golden[] = {
+    {{0x1f83, 0xfceb, 0x47cf}},
+    {{0x5b2c, 0x5b2c, 0x5b2c}},
+    {{0xe098, 0x886f, 0xa475}},
+  };
+  uint32_t stride = 0;
+  HWCTestPattern::GetStride(kFormatRGB888, 1920, &stride);
+  std::vector<uint8_t> buffer(stride * 1080);
+
+  for (uint32_t i = 0; i < 3; i++) {
+    HWCTestPattern::ComponentCRC crc = {};
+    HWCTestPattern(24, kFormatRGB888, 1920, 1080, stride)
+        .Generate(kPatterns[i], buffer.data(), &crc);
+    EXPECT_EQ(golden[i], crc) << "pattern " << kPatterns[i];
+  }
+}
+
+// Prints the generation time of every pattern at 1080p and 4K, next to the per-pixel model.
+TEST(HWCTestPatternTest, Benchmark) {
+  const uint32_t sizes[][2] = {{1920, 1080}, {3840, 2160}};
+
+  for (auto &size : sizes) {
+    for (uint32_t panel_bpp : {24u, 30u}) {
+      LayerBufferFormat format = FormatForBpp(panel_bpp);
+      uint32_t stride = 0;
+      HWCTestPattern::GetStride(format, size[0], &stride);
+      std::vector<uint8_t> buffer(stride * size[1]);
+
+      for (uint32_t pattern_type : kPatterns) {
+        HWCTestPattern::ComponentCRC crc = {};
+        auto start = std::chrono::steady_clock::now();
+        ReferencePattern(panel_bpp, format, size[0], size[1], stride)
+            .Generate(pattern_type, buffer.data(), &crc);
+        auto mid = std::chrono::steady_clock::now();
+        HWCTestPattern(panel_bpp, format, size[0], size[1], stride)
+            .Generate(pattern_type, buffer.data(), &crc);
+        auto end = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::milli> reference = mid - start, elapsed = end - mid;
+        printf("%4ux%-4u %u bpp pattern %u: %7.2f ms (per pixel %7.2f ms)\n", size[0], size[1],
+               panel_bpp, pattern_type, elapsed.count(), reference.count());
+      }
+    }
+  }
+}
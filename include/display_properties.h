@@ -63,6 +63,10 @@
 #define SIMULATED_CONFIG_PROP                DISPLAY_PROP("simulated_config")
 #define MAX_EXTERNAL_LAYERS_PROP             DISPLAY_PROP("max_external_layers")
 #define PERF_HINT_WINDOW_PROP                DISPLAY_PROP("perf_hint_window")
+// Percentage of the vsync period kept free before composer asks for a CPU boost
+#define PERF_HINT_MARGIN_PROP                DISPLAY_PROP("perf_hint_margin")
+// Log CPU boost decisions instead of taking vendor perf locks
+#define PERF_HINT_STUB_PROP                  DISPLAY_PROP("perf_hint_stub")
 #define ENABLE_EXTERNAL_DOWNSCALE_PROP       DISPLAY_PROP("enable_external_downscale")
 #define EXTERNAL_ACTION_SAFE_WIDTH_PROP      DISPLAY_PROP("external_action_safe_width")
 #define EXTERNAL_ACTION_SAFE_HEIGHT_PROP     DISPLAY_PROP("external_action_safe_height")
@@ -123,6 +127,16 @@
 #define ENABLE_POMS_DURING_DOZE              DISPLAY_PROP("enable_poms_during_doze")
 #define DISABLE_DYNAMIC_FPS                  DISPLAY_PROP("disable_dynamic_fps")
 #define ENHANCE_IDLE_TIME                    DISPLAY_PROP("enhance_idle_time")
+#define DISABLE_VALIDATE_CACHE_PROP          DISPLAY_PROP("disable_validate_cache")
+// Minimum time in ms between two CWB captures delivered to the same DisplayConfig client
+#define CWB_MIN_INTERVAL_PROP                DISPLAY_PROP("cwb_min_interval")
+// 1 records a layer trace per display, 2 also records buffer checksums (slow)
+#define LAYER_TRACE_PROP                     DISPLAY_PROP("layer_trace")
+// Exports the frame trace rings on dumpsys, 1 as compact binary, 2 as Chrome trace JSON
+#define FRAME_TRACE_EXPORT_PROP              DISPLAY_PROP("frame_trace_export")
+#define LOCK_PROFILE_PROP                    DISPLAY_PROP("lock_profile")
+// 1 rediscovers hardware resources on every start instead of using the saved snapshot
+#define DISABLE_HW_INFO_SNAPSHOT_PROP        DISPLAY_PROP("disable_hw_info_snapshot")
 
 // Add all vendor.display properties above
 
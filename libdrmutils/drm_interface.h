@@ -770,6 +770,15 @@ struct DRMDppsFeatureInfo {
   void *payload;
 };
 
+/* Time spent enumerating KMS objects when the DRM manager was created */
+struct DRMInitStats {
+  uint64_t total_us = 0;
+  uint64_t connectors_us = 0;
+  uint64_t encoders_us = 0;
+  uint64_t crtcs_us = 0;
+  uint64_t planes_us = 0;
+};
+
 enum AD4Modes {
   kAd4Off,
   kAd4AutoStrength,
@@ -1057,6 +1066,18 @@ class DRMManagerInterface {
    * [output]: Dpps feature version, info->version
    */
   virtual void GetDppsFeatureInfo(DRMDppsFeatureInfo *info) = 0;
+
+  /*
+   * Get the startup timing of the DRM manager
+   * [output]: DRMInitStats: Time spent per KMS object type
+   */
+  virtual void GetInitStats(DRMInitStats *stats) = 0;
+
+  /*
+   * Get a fingerprint of the CRTC and plane capability blobs read at startup
+   * [output]: hash: Changes when any of the blobs does
+   */
+  virtual void GetCapabilitiesHash(uint64_t *hash) = 0;
 };
 
 }  // namespace sde_drm
@@ -0,0 +1,93 @@
+ifneq ($(TARGET_IS_HEADLESS), true)
+LOCAL_PATH := $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := libfakekms
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/ \
+                                 -isystem external/libdrm
+LOCAL_HEADER_LIBRARIES        := display_headers
+LOCAL_SHARED_LIBRARIES        := libdisplaydebug
+LOCAL_CFLAGS                  := -DLOG_TAG=\"FAKE_KMS\" -Wall -Werror -fno-operator-names \
+                                 -Wno-unused-parameter
+LOCAL_CLANG                   := true
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := fake_kms_device.cpp fake_libdrm.cpp
+
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+# libfakekms comes first in the benchmarks so that libdrmutils, libsdmcore and the dlopened
+# libsdedrm bind to the fake libdrm.
+LOCAL_MODULE                  := sde_drm_bench
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/ \
+                                 -isystem external/libdrm
+LOCAL_HEADER_LIBRARIES        := display_headers
+LOCAL_SHARED_LIBRARIES        := libfakekms libdrmutils libdisplaydebug
+LOCAL_REQUIRED_MODULES        := libsdedrm
+LOCAL_CFLAGS                  := -DLOG_TAG=\"FAKE_KMS\" -Wall -Werror -fno-operator-names \
+                                 -Wno-unused-parameter
+LOCAL_CLANG                   := true
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := sde_drm_bench.cpp
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := sdm_core_bench
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/ \
+                                 -isystem external/libdrm
+LOCAL_HEADER_LIBRARIES        := display_headers
+LOCAL_SHARED_LIBRARIES        := libfakekms libsdmcore libsdmutils libdisplaydebug
+LOCAL_REQUIRED_MODULES        := libsdedrm
+LOCAL_CFLAGS                  := -DLOG_TAG=\"FAKE_KMS\" -Wall -Werror -fno-operator-names \
+                                 -Wno-unused-parameter
+LOCAL_CLANG                   := true
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := sdm_core_bench.cpp
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := sdm_core_replay
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/ \
+                                 -isystem external/libdrm
+LOCAL_HEADER_LIBRARIES        := display_headers
+LOCAL_SHARED_LIBRARIES        := libfakekms libsdmcore libsdmutils libdisplaydebug liblayertrace
+LOCAL_REQUIRED_MODULES        := libsdedrm
+LOCAL_CFLAGS                  := -DLOG_TAG=\"FAKE_KMS\" -Wall -Werror -fno-operator-names \
+                                 -Wno-unused-parameter
+LOCAL_CLANG                   := true
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := sdm_core_replay.cpp
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := fake_kms_test
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/ \
+                                 -isystem external/libdrm
+LOCAL_HEADER_LIBRARIES        := display_headers
+LOCAL_STATIC_LIBRARIES        := libgtest libgtest_main
+LOCAL_SHARED_LIBRARIES        := libfakekms libdisplaydebug
+LOCAL_CFLAGS                  := -DLOG_TAG=\"FAKE_KMS\" -Wall -Werror -fno-operator-names \
+                                 -Wno-unused-parameter
+LOCAL_CLANG                   := true
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_SRC_FILES               := fake_kms_test.cpp
+
+include $(BUILD_EXECUTABLE)
+endif
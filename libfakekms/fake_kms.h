@@ -0,0 +1,128 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __FAKE_KMS_H__
+#define __FAKE_KMS_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// libfakekms exports the libdrm entry points used by libdrmutils, libsdedrm and the SDM core and
+// backs them with an in-process model of an SDE KMS device: CRTCs, planes, connectors, property
+// blobs, framebuffers, atomic commits with TEST_ONLY and NONBLOCK semantics, out-fences and
+// vblank events. A process that links libfakekms ahead of libdrm runs the display stack unmodified
+// without a /dev/dri node, which is how the benchmarks in this directory measure the CPU cost of a
+// frame.
+//
+// This header is the control interface for the harness driving the fake.
+
+namespace fake_kms {
+
+enum class PlaneType {
+  kVig,
+  kDma,
+  kCursor,
+};
+
+struct PlaneConfig {
+  PlaneType type = PlaneType::kDma;
+  std::string capabilities = {};  // Contents of the "capabilities" blob, key=value lines
+};
+
+struct ConnectorConfig {
+  uint32_t type = 0;                  // DRM_MODE_CONNECTOR_*, 0 for DSI
+  bool connected = true;
+  uint32_t width = 1080;
+  uint32_t height = 2400;
+  uint32_t refresh = 60;
+  std::string capabilities = {};      // Contents of the "capabilities" blob
+  std::string mode_properties = {};   // Contents of the "mode_properties" blob
+};
+
+struct Config {
+  uint32_t num_crtcs = 2;
+  std::vector<PlaneConfig> planes = {};
+  std::vector<ConnectorConfig> connectors = {};
+  std::string crtc_capabilities = {};  // Contents of the CRTC "capabilities" blob
+  uint32_t max_blend_stages = 11;      // Planes a CRTC accepts, TEST_ONLY rejects more
+  int64_t vblank_period_ns = 0;        // 0 derives the period from the first connector refresh
+  // Extra range properties attached to every object of the type, e.g. the names a device exposes
+  // as listed by modetest. Names the model already attaches are skipped.
+  std::vector<std::string> crtc_properties = {};
+  std::vector<std::string> plane_properties = {};
+  std::vector<std::string> connector_properties = {};
+};
+
+// Counters since the last ResetStats(). ioctls counts the calls the real libdrm would make into the
+// kernel for the same API calls, e.g. two for each drmModeGetProperty(), so that per-frame syscall
+// counts measured on the fake carry over to a device.
+struct Stats {
+  uint64_t ioctls = 0;
+  uint64_t atomic_commits = 0;      // All drmModeAtomicCommit() calls, TEST_ONLY included
+  uint64_t test_only_commits = 0;
+  uint64_t nonblock_commits = 0;
+  uint64_t rejected_commits = 0;    // Failed validation
+  uint64_t atomic_properties = 0;   // Properties carried by all atomic commits
+  uint64_t blobs_created = 0;
+  uint64_t blobs_destroyed = 0;
+  uint64_t fences_created = 0;
+  uint64_t vblanks = 0;
+  uint64_t events = 0;              // vblank and page flip events delivered
+};
+
+// Model of an SDM845-class target: one DSI command mode panel, four VIG and four DMA planes.
+Config DefaultConfig();
+
+// Replaces the device model. Returns -EBUSY while a device fd is open.
+int Configure(const Config &config);
+
+void GetStats(Stats *stats);
+void ResetStats();
+
+// Number of frames latched on screen by the CRTC so far, for harnesses that pace on vblank.
+uint64_t GetFrameCount(uint32_t crtc_id);
+
+// Number of commits since the last ResetStats() that set the named property of the object,
+// TEST_ONLY and rejected ones excluded. The driver reprograms a post-processing feature on each of
+// them, even when its blob id did not change.
+uint64_t GetPropertyWrites(uint32_t object_id, const std::string &name);
+
+// Adds a connector to the open device, like an MST sink appearing behind a dock. The display stack
+// sees it on its next drmModeGetResources(), as after a hotplug uevent. Returns the connector id,
+// or 0 when no device fd is open.
+uint32_t AttachConnector(const ConnectorConfig &config);
+
+// Removes a connector from the open device, whether or not a CRTC still drives it. Returns 0 or
+// -ENOENT.
+int DetachConnector(uint32_t connector_id);
+
+}  // namespace fake_kms
+
+#endif  // __FAKE_KMS_H__
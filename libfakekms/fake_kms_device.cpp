@@ -0,0 +1,1306 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <drm/drm_fourcc.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+#include "drm_logger.h"
+#include "fake_kms_device.h"
+
+#define __CLASS__ "FakeKMS"
+
+namespace fake_kms {
+
+using std::lock_guard;
+using std::mutex;
+using std::string;
+using std::unique_lock;
+using std::vector;
+
+// sw_sync interface, not part of the exported uapi headers.
+struct sw_sync_create_fence_data {
+  uint32_t value;
+  char name[32];
+  int32_t fence;
+};
+
+#define SW_SYNC_IOC_MAGIC 'W'
+#define SW_SYNC_IOC_CREATE_FENCE _IOWR(SW_SYNC_IOC_MAGIC, 0, struct sw_sync_create_fence_data)
+#define SW_SYNC_IOC_INC _IOW(SW_SYNC_IOC_MAGIC, 1, uint32_t)
+
+static const char *kSwSyncPaths[] = {"/dev/sw_sync", "/sys/kernel/debug/sync/sw_sync"};
+
+static int64_t NowNs() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+FenceTimeline::FenceTimeline() {
+  for (auto path : kSwSyncPaths) {
+    sw_sync_fd_ = open(path, O_RDWR | O_CLOEXEC);
+    if (sw_sync_fd_ >= 0) {
+      break;
+    }
+  }
+}
+
+FenceTimeline::~FenceTimeline() {
+  // Nothing may wait forever on a fence of a device that is gone.
+  Signal(next_point_);
+  if (sw_sync_fd_ >= 0) {
+    close(sw_sync_fd_);
+  }
+}
+
+int FenceTimeline::CreateFence(uint64_t *point) {
+  uint64_t next = next_point_ + 1;
+  int fd = -1;
+  if (sw_sync_fd_ >= 0) {
+    struct sw_sync_create_fence_data data = {};
+    data.value = static_cast<uint32_t>(next);
+    snprintf(data.name, sizeof(data.name), "fake_kms_%u", data.value);
+    if (ioctl(sw_sync_fd_, SW_SYNC_IOC_CREATE_FENCE, &data) < 0) {
+      return -errno;
+    }
+    fd = data.fence;
+  } else {
+    int event_fd = eventfd(0, EFD_CLOEXEC);
+    if (event_fd < 0) {
+      return -errno;
+    }
+    fd = dup(event_fd);
+    if (fd < 0) {
+      int error = -errno;
+      close(event_fd);
+      return error;
+    }
+    eventfds_[next] = event_fd;
+  }
+
+  next_point_ = next;
+  *point = next;
+  return fd;
+}
+
+void FenceTimeline::Signal(uint64_t point) {
+  point = std::min(point, next_point_);
+  if (point <= signaled_point_) {
+    return;
+  }
+
+  if (sw_sync_fd_ >= 0) {
+    uint32_t increment = static_cast<uint32_t>(point - signaled_point_);
+    if (ioctl(sw_sync_fd_, SW_SYNC_IOC_INC, &increment) < 0) {
+      DRM_LOGE("Failed to signal timeline to %" PRIu64 ", error %d", point, errno);
+    }
+  } else {
+    auto end = eventfds_.upper_bound(point);
+    for (auto it = eventfds_.begin(); it != end; it++) {
+      uint64_t count = 1;
+      if (write(it->second, &count, sizeof(count)) < 0) {
+        DRM_LOGE("Failed to signal fence %" PRIu64 ", error %d", it->first, errno);
+      }
+      close(it->second);
+    }
+    eventfds_.erase(eventfds_.begin(), end);
+  }
+
+  signaled_point_ = point;
+}
+
+Config DefaultConfig() {
+  const string rgb_formats = "AB24 AR24 RA24 BA24 XB24 XR24 RX24 BX24 AB30 AR30 XB30 XR30 BG24 "
+                             "RG24 BG16 RG16 AB24/5/1 AR24/5/1 XB24/5/1 XR24/5/1 BG16/5/1";
+  const string yuv_formats = "NV12 NV21 NV16 NV61 YV12 P010 NV12/5/1 Q410/5/1";
+  const string bandwidth = "max_per_pipe_bw=4500000\nmax_per_pipe_bw_high=4500000\n";
+
+  Config config = {};
+  PlaneConfig vig = {};
+  vig.type = PlaneType::kVig;
+  vig.capabilities = "pixel_formats=" + rgb_formats + " " + yuv_formats + "\n"
+                     "max_linewidth=4096\nmax_upscale=20\nmax_downscale=4\n"
+                     "scaler_step_ver=4100\n" + bandwidth;
+  PlaneConfig dma = {};
+  dma.type = PlaneType::kDma;
+  dma.capabilities = "pixel_formats=" + rgb_formats + "\n"
+                     "max_linewidth=4096\nmax_upscale=1\nmax_downscale=1\n" + bandwidth;
+  config.planes.insert(config.planes.end(), 4, vig);
+  config.planes.insert(config.planes.end(), 4, dma);
+
+  config.crtc_capabilities = "max_blendstages=11\nqseed_type=qseed3\n"
+                             "smart_dma_rev=smart_dma_v2p5\nhas_src_split=1\nhas_hdr=1\n"
+                             "max_mdp_clk=460000000\nmax_bandwidth_low=9600000\n"
+                             "max_bandwidth_high=9600000\ndim_layer_v1_max_layers=7\n";
+
+  ConnectorConfig panel = {};
+  panel.capabilities = "display type=primary\npanel name=fake_kms cmd mode dsi panel\n"
+                       "panel mode=command\nmaxlinewidth=4096\ndfps support=false\n"
+                       "qsync support=false\n";
+  config.connectors.push_back(panel);
+
+  return config;
+}
+
+Device *Device::s_instance = nullptr;
+mutex Device::s_lock;
+
+Device *Device::GetInstance() {
+  lock_guard<mutex> lock(s_lock);
+  if (!s_instance) {
+    s_instance = new Device();
+  }
+
+  return s_instance;
+}
+
+int Device::Configure(const Config &config) {
+  lock_guard<mutex> lock(lock_);
+  if (!clients_.empty()) {
+    return -EBUSY;
+  }
+
+  config_ = config;
+  built_ = false;
+  return 0;
+}
+
+void Device::GetStats(Stats *stats) {
+  lock_guard<mutex> lock(lock_);
+  *stats = stats_;
+  stats->ioctls = stats_ioctls_;
+}
+
+void Device::ResetStats() {
+  lock_guard<mutex> lock(lock_);
+  stats_ = {};
+  stats_ioctls_ = 0;
+  property_writes_.clear();
+}
+
+uint64_t Device::GetFrameCount(uint32_t crtc_id) {
+  lock_guard<mutex> lock(lock_);
+  Crtc *crtc = FindCrtc(crtc_id);
+  return crtc ? crtc->frame_count : 0;
+}
+
+uint64_t Device::GetPropertyWrites(uint32_t object_id, const string &name) {
+  lock_guard<mutex> lock(lock_);
+  auto it = property_writes_.find({object_id, GetPropertyId(name)});
+  return it != property_writes_.end() ? it->second : 0;
+}
+
+uint32_t Device::AttachConnector(const ConnectorConfig &config) {
+  lock_guard<mutex> lock(lock_);
+  if (!built_) {
+    return 0;
+  }
+
+  uint32_t connector_id = AddConnector(config);
+  DRM_LOGI("Attached connector %u, type %u", connector_id, config.type);
+  return connector_id;
+}
+
+int Device::DetachConnector(uint32_t connector_id) {
+  lock_guard<mutex> lock(lock_);
+  auto connector = std::find_if(connectors_.begin(), connectors_.end(),
+                                [connector_id](const Connector &c) {
+                                  return c.id == connector_id;
+                                });
+  if (connector == connectors_.end()) {
+    return -ENOENT;
+  }
+
+  // The capability blobs go with the connector, like the driver frees them on MST teardown.
+  for (auto &property : objects_[connector_id].properties) {
+    if (properties_[property.first].flags & DRM_MODE_PROP_BLOB) {
+      blobs_.erase(static_cast<uint32_t>(property.second));
+    }
+  }
+  objects_.erase(connector_id);
+  objects_.erase(connector->encoder_id);
+  encoders_.erase(std::remove(encoders_.begin(), encoders_.end(), connector->encoder_id),
+                  encoders_.end());
+  connectors_.erase(connector);
+  DRM_LOGI("Detached connector %u", connector_id);
+
+  return 0;
+}
+
+uint32_t Device::AddProperty(uint32_t object_id, const string &name, uint32_t flags,
+                             uint64_t value, const vector<string> &enums) {
+  uint32_t property_id = 0;
+  auto it = property_ids_.find(name);
+  if (it != property_ids_.end()) {
+    property_id = it->second;
+  } else {
+    Property property = {};
+    property.id = property_id = NewId();
+    property.name = name;
+    property.flags = flags;
+    if (flags & DRM_MODE_PROP_RANGE) {
+      property.values = {0, UINT64_MAX};
+    }
+    for (size_t i = 0; i < enums.size(); i++) {
+      drm_mode_property_enum entry = {};
+      // Bitmask entries carry the bit position, plain enums the value.
+      entry.value = i;
+      snprintf(entry.name, sizeof(entry.name), "%s", enums.at(i).c_str());
+      property.enums.push_back(entry);
+      property.values.push_back(i);
+    }
+    properties_[property_id] = property;
+    property_ids_[name] = property_id;
+  }
+
+  objects_[object_id].properties.push_back({property_id, value});
+  return property_id;
+}
+
+uint32_t Device::AddBlob(const void *data, size_t size) {
+  uint32_t blob_id = NewId();
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  blobs_[blob_id] = vector<uint8_t>(bytes, bytes + size);
+  return blob_id;
+}
+
+uint32_t Device::AddBlobProperty(uint32_t object_id, const string &name, const string &data) {
+  uint32_t blob_id = data.empty() ? 0 : AddBlob(data.c_str(), data.size() + 1);
+  return AddProperty(object_id, name, DRM_MODE_PROP_BLOB | DRM_MODE_PROP_IMMUTABLE, blob_id);
+}
+
+void Device::AddExtraProperties(uint32_t object_id, const vector<string> &names) {
+  for (auto &name : names) {
+    auto it = property_ids_.find(name);
+    const auto &attached = objects_[object_id].properties;
+    if (it == property_ids_.end() ||
+        std::none_of(attached.begin(), attached.end(),
+                     [&it](const std::pair<uint32_t, uint64_t> &property) {
+                       return property.first == it->second;
+                     })) {
+      AddProperty(object_id, name, DRM_MODE_PROP_RANGE, 0);
+    }
+  }
+}
+
+uint32_t Device::AddConnector(const ConnectorConfig &config) {
+  const vector<string> translation_modes = {"non_sec", "sec", "non_sec_direct_translation",
+                                            "sec_direct_translation"};
+  const uint32_t range = DRM_MODE_PROP_RANGE;
+  const uint32_t enumeration = DRM_MODE_PROP_ENUM;
+
+  Connector connector = {};
+  connector.id = NewId();
+  connector.encoder_id = NewId();
+  connector.config = config;
+  if (!connector.config.type) {
+    connector.config.type = DRM_MODE_CONNECTOR_DSI;
+  }
+
+  drmModeModeInfo &mode = connector.mode;
+  const ConnectorConfig &cfg = connector.config;
+  mode.hdisplay = static_cast<uint16_t>(cfg.width);
+  mode.hsync_start = static_cast<uint16_t>(cfg.width + 40);
+  mode.hsync_end = static_cast<uint16_t>(cfg.width + 60);
+  mode.htotal = static_cast<uint16_t>(cfg.width + 100);
+  mode.vdisplay = static_cast<uint16_t>(cfg.height);
+  mode.vsync_start = static_cast<uint16_t>(cfg.height + 8);
+  mode.vsync_end = static_cast<uint16_t>(cfg.height + 12);
+  mode.vtotal = static_cast<uint16_t>(cfg.height + 20);
+  mode.vrefresh = cfg.refresh;
+  mode.clock = static_cast<uint32_t>(uint64_t(mode.htotal) * mode.vtotal * cfg.refresh / 1000);
+  mode.type = DRM_MODE_TYPE_PREFERRED | DRM_MODE_TYPE_DRIVER;
+  snprintf(mode.name, sizeof(mode.name), "%ux%u", cfg.width, cfg.height);
+
+  string mode_properties = cfg.mode_properties;
+  if (mode_properties.empty()) {
+    std::ostringstream stream;
+    stream << "mode_name=" << mode.name << "\ntopology=sde_singlepipe_dsc\n"
+           << "mdp_transfer_time_us=" << (800000 / std::max(cfg.refresh, 1u)) << "\n";
+    mode_properties = stream.str();
+  }
+
+  objects_[connector.id].type = DRM_MODE_OBJECT_CONNECTOR;
+  AddProperty(connector.id, "CRTC_ID", range, 0);
+  AddProperty(connector.id, "RETIRE_FENCE", range, 0);
+  AddProperty(connector.id, "LP", enumeration, 0, {"ON", "LP1", "LP2", "OFF"});
+  AddBlobProperty(connector.id, "capabilities", cfg.capabilities);
+  AddBlobProperty(connector.id, "mode_properties", mode_properties);
+  AddProperty(connector.id, "sde_drm_roi_v1", range, 0);
+  AddProperty(connector.id, "fb_translation_mode", enumeration, 0, translation_modes);
+  AddProperty(connector.id, "autorefresh", range, 0);
+  AddProperty(connector.id, "qsync_mode", enumeration, 0, {"none", "continuous", "one_shot"});
+  AddProperty(connector.id, "frame_trigger_mode", enumeration, 0,
+              {"default", "serilize_frame_trigger", "posted_start"});
+  AddProperty(connector.id, "bl_scale", range, 1024);
+  AddProperty(connector.id, "sv_bl_scale", range, 1024);
+  AddProperty(connector.id, "topology_control", range, 0);
+  AddExtraProperties(connector.id, config_.connector_properties);
+
+  objects_[connector.encoder_id].type = DRM_MODE_OBJECT_ENCODER;
+  encoders_.push_back(connector.encoder_id);
+  connectors_.push_back(connector);
+
+  return connector.id;
+}
+
+// Lays out the objects and properties of the configured device the way the SDE driver exposes
+// them, with the names libsdedrm looks up.
+void Device::Build() {
+  const vector<string> translation_modes = {"non_sec", "sec", "non_sec_direct_translation",
+                                            "sec_direct_translation"};
+  const uint32_t range = DRM_MODE_PROP_RANGE;
+  const uint32_t blob = DRM_MODE_PROP_BLOB;
+  const uint32_t enumeration = DRM_MODE_PROP_ENUM;
+
+  crtcs_.clear();
+  for (uint32_t i = 0; i < config_.num_crtcs; i++) {
+    Crtc crtc = {};
+    crtc.id = NewId();
+    crtc.index = i;
+    crtc.release_timeline.reset(new FenceTimeline());
+    crtc.retire_timeline.reset(new FenceTimeline());
+    objects_[crtc.id].type = DRM_MODE_OBJECT_CRTC;
+    AddProperty(crtc.id, "ACTIVE", range, 0);
+    AddProperty(crtc.id, "MODE_ID", blob, 0);
+    AddProperty(crtc.id, "output_fence", range, 0);
+    AddProperty(crtc.id, "output_fence_offset", range, 0);
+    AddBlobProperty(crtc.id, "capabilities", config_.crtc_capabilities);
+    AddProperty(crtc.id, "sde_drm_roi_v1", range, 0);
+    for (auto name : {"core_clk", "core_ab", "core_ib", "llcc_ab", "llcc_ib", "dram_ab",
+                      "dram_ib", "rot_prefill_bw", "rot_clk", "idle_time"}) {
+      AddProperty(crtc.id, name, range, 0);
+    }
+    AddProperty(crtc.id, "security_level", enumeration, 0, {"sec_and_non_sec", "sec_only"});
+    AddProperty(crtc.id, "dim_layer_v1", range, 0);
+    AddProperty(crtc.id, "capture_mode", enumeration, 0, {"capture_mixer_out", "capture_pp_out"});
+    AddProperty(crtc.id, "idle_pc_state", enumeration, 0,
+                {"idle_pc_none", "idle_pc_enable", "idle_pc_disable"});
+    AddExtraProperties(crtc.id, config_.crtc_properties);
+    crtcs_.push_back(std::move(crtc));
+  }
+
+  planes_.clear();
+  for (auto &plane_config : config_.planes) {
+    uint32_t plane_id = NewId();
+    uint64_t type = (plane_config.type == PlaneType::kCursor) ? DRM_PLANE_TYPE_CURSOR :
+                    (planes_.empty() ? DRM_PLANE_TYPE_PRIMARY : DRM_PLANE_TYPE_OVERLAY);
+    objects_[plane_id].type = DRM_MODE_OBJECT_PLANE;
+    AddProperty(plane_id, "type", enumeration | DRM_MODE_PROP_IMMUTABLE, type,
+                {"Overlay", "Primary", "Cursor"});
+    for (auto name : {"FB_ID", "CRTC_ID", "CRTC_X", "CRTC_Y", "CRTC_W", "CRTC_H", "SRC_X",
+                      "SRC_Y", "SRC_W", "SRC_H", "zpos", "input_fence", "src_config"}) {
+      AddProperty(plane_id, name, range, 0);
+    }
+    AddProperty(plane_id, "alpha", range, 0xff);
+    AddProperty(plane_id, "blend_op", enumeration, 0,
+                {"not_defined", "opaque", "premultiplied", "coverage"});
+    AddProperty(plane_id, "rotation", DRM_MODE_PROP_BITMASK, 1,
+                {"rotate-0", "rotate-90", "rotate-180", "rotate-270", "reflect-x", "reflect-y"});
+    AddProperty(plane_id, "fb_translation_mode", enumeration, 0, translation_modes);
+    AddProperty(plane_id, "multirect_mode", enumeration, 0, {"none", "parallel", "serial"});
+    AddProperty(plane_id, "excl_rect_v1", range, 0);
+    AddBlobProperty(plane_id, "capabilities", plane_config.capabilities);
+    if (plane_config.type == PlaneType::kVig) {
+      // Like the SDE driver, the csc, scaler and rect properties carry user pointers
+      AddProperty(plane_id, "csc_v1", range, 0);
+      AddProperty(plane_id, "scaler_v2", range, 0);
+      for (auto name : {"lut_ed", "lut_cir", "lut_sep"}) {
+        AddProperty(plane_id, name, blob, 0);
+      }
+      AddProperty(plane_id, "inverse_pma", range, 0);
+    }
+    AddExtraProperties(plane_id, config_.plane_properties);
+    planes_.push_back(plane_id);
+  }
+
+  connectors_.clear();
+  encoders_.clear();
+  for (auto &connector_config : config_.connectors) {
+    AddConnector(connector_config);
+  }
+
+  if (!config_.vblank_period_ns) {
+    uint32_t refresh = connectors_.empty() ? 60 : std::max(connectors_.at(0).config.refresh, 1u);
+    config_.vblank_period_ns = 1000000000LL / refresh;
+  }
+
+  built_ = true;
+  DRM_LOGI("Built %zu crtcs, %zu planes, %zu connectors, vblank every %" PRId64 " ns",
+           crtcs_.size(), planes_.size(), connectors_.size(), config_.vblank_period_ns);
+}
+
+void Device::Teardown() {
+  vblank_events_.clear();
+  // Destroying the timelines signals every outstanding fence.
+  crtcs_.clear();
+  planes_.clear();
+  connectors_.clear();
+  encoders_.clear();
+  objects_.clear();
+  properties_.clear();
+  property_ids_.clear();
+  blobs_.clear();
+  framebuffers_.clear();
+  property_writes_.clear();
+  next_id_ = 1;
+  built_ = false;
+}
+
+int Device::Open() {
+  int fds[2] = {-1, -1};
+  if (pipe2(fds, O_CLOEXEC)) {
+    return -errno;
+  }
+  // Events to a client that stopped reading are dropped rather than stalling the vblank thread.
+  fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+  lock_guard<mutex> lock(lock_);
+  if (!built_) {
+    Build();
+  }
+
+  if (clients_.empty()) {
+    vblank_thread_exit_ = false;
+    vblank_thread_ = std::thread(&Device::VBlankThread, this);
+  }
+  clients_[fds[0]] = fds[1];
+
+  return fds[0];
+}
+
+int Device::Close(int fd) {
+  std::thread vblank_thread;
+  {
+    lock_guard<mutex> lock(lock_);
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) {
+      return -EBADF;
+    }
+
+    close(it->second);
+    close(it->first);
+    clients_.erase(it);
+    vblank_events_.erase(std::remove_if(vblank_events_.begin(), vblank_events_.end(),
+                                        [fd](const VBlankEvent &event) { return event.fd == fd; }),
+                         vblank_events_.end());
+    for (auto &crtc : crtcs_) {
+      crtc.flip_events.erase(std::remove_if(crtc.flip_events.begin(), crtc.flip_events.end(),
+                                            [fd](const std::pair<int, uint64_t> &event) {
+                                              return event.first == fd;
+                                            }), crtc.flip_events.end());
+    }
+
+    if (clients_.empty()) {
+      vblank_thread_exit_ = true;
+      vblank_cv_.notify_all();
+      vblank_thread = std::move(vblank_thread_);
+      // The device state goes away with its last client, like the driver state of a closed node.
+      Teardown();
+    }
+  }
+
+  if (vblank_thread.joinable()) {
+    vblank_thread.join();
+  }
+
+  return 0;
+}
+
+bool Device::IsDeviceFd(int fd) {
+  lock_guard<mutex> lock(lock_);
+  return clients_.count(fd);
+}
+
+Device::Object *Device::FindObject(uint32_t object_id, uint32_t type) {
+  auto it = objects_.find(object_id);
+  if (it == objects_.end() || (type && it->second.type != type)) {
+    return nullptr;
+  }
+
+  return &it->second;
+}
+
+uint32_t Device::GetPropertyId(const string &name) {
+  auto it = property_ids_.find(name);
+  return (it != property_ids_.end()) ? it->second : 0;
+}
+
+uint64_t Device::GetValue(uint32_t object_id, const string &name) {
+  Object *object = FindObject(object_id, 0);
+  uint32_t property_id = GetPropertyId(name);
+  if (!object || !property_id) {
+    return 0;
+  }
+
+  for (auto &property : object->properties) {
+    if (property.first == property_id) {
+      return property.second;
+    }
+  }
+
+  return 0;
+}
+
+Device::Crtc *Device::FindCrtc(uint32_t crtc_id) {
+  for (auto &crtc : crtcs_) {
+    if (crtc.id == crtc_id) {
+      return &crtc;
+    }
+  }
+
+  return nullptr;
+}
+
+template <class T>
+static T *CopyArray(const vector<T> &values) {
+  if (values.empty()) {
+    return nullptr;
+  }
+
+  T *array = reinterpret_cast<T *>(calloc(values.size(), sizeof(T)));
+  if (array) {
+    std::copy(values.begin(), values.end(), array);
+  }
+
+  return array;
+}
+
+drmModeResPtr Device::GetResources(int fd) {
+  lock_guard<mutex> lock(lock_);
+  drmModeResPtr resources = reinterpret_cast<drmModeResPtr>(calloc(1, sizeof(drmModeRes)));
+  if (!resources) {
+    return nullptr;
+  }
+
+  vector<uint32_t> crtcs, connectors;
+  for (auto &crtc : crtcs_) {
+    crtcs.push_back(crtc.id);
+  }
+  for (auto &connector : connectors_) {
+    connectors.push_back(connector.id);
+  }
+
+  resources->count_crtcs = static_cast<int>(crtcs.size());
+  resources->crtcs = CopyArray(crtcs);
+  resources->count_connectors = static_cast<int>(connectors.size());
+  resources->connectors = CopyArray(connectors);
+  resources->count_encoders = static_cast<int>(encoders_.size());
+  resources->encoders = CopyArray(encoders_);
+  resources->min_width = resources->min_height = 1;
+  resources->max_width = resources->max_height = 16384;
+
+  return resources;
+}
+
+drmModeCrtcPtr Device::GetCrtc(int fd, uint32_t crtc_id) {
+  lock_guard<mutex> lock(lock_);
+  if (!FindCrtc(crtc_id)) {
+    errno = ENOENT;
+    return nullptr;
+  }
+
+  drmModeCrtcPtr crtc = reinterpret_cast<drmModeCrtcPtr>(calloc(1, sizeof(drmModeCrtc)));
+  if (!crtc) {
+    return nullptr;
+  }
+
+  crtc->crtc_id = crtc_id;
+  uint64_t mode_blob = GetValue(crtc_id, "MODE_ID");
+  auto it = blobs_.find(static_cast<uint32_t>(mode_blob));
+  if (it != blobs_.end() && it->second.size() == sizeof(drmModeModeInfo)) {
+    memcpy(&crtc->mode, it->second.data(), sizeof(drmModeModeInfo));
+    crtc->mode_valid = 1;
+    crtc->width = crtc->mode.hdisplay;
+    crtc->height = crtc->mode.vdisplay;
+  }
+
+  return crtc;
+}
+
+drmModeEncoderPtr Device::GetEncoder(int fd, uint32_t encoder_id) {
+  lock_guard<mutex> lock(lock_);
+  for (auto &connector : connectors_) {
+    if (connector.encoder_id != encoder_id) {
+      continue;
+    }
+
+    drmModeEncoderPtr encoder =
+        reinterpret_cast<drmModeEncoderPtr>(calloc(1, sizeof(drmModeEncoder)));
+    if (!encoder) {
+      return nullptr;
+    }
+
+    encoder->encoder_id = encoder_id;
+    switch (connector.config.type) {
+      case DRM_MODE_CONNECTOR_DSI: encoder->encoder_type = DRM_MODE_ENCODER_DSI; break;
+      case DRM_MODE_CONNECTOR_VIRTUAL: encoder->encoder_type = DRM_MODE_ENCODER_VIRTUAL; break;
+      default: encoder->encoder_type = DRM_MODE_ENCODER_TMDS; break;
+    }
+    encoder->crtc_id = static_cast<uint32_t>(GetValue(connector.id, "CRTC_ID"));
+    encoder->possible_crtcs = (1u << crtcs_.size()) - 1;
+    return encoder;
+  }
+
+  errno = ENOENT;
+  return nullptr;
+}
+
+drmModeConnectorPtr Device::GetConnector(int fd, uint32_t connector_id) {
+  lock_guard<mutex> lock(lock_);
+  for (auto &connector : connectors_) {
+    if (connector.id != connector_id) {
+      continue;
+    }
+
+    drmModeConnectorPtr conn =
+        reinterpret_cast<drmModeConnectorPtr>(calloc(1, sizeof(drmModeConnector)));
+    if (!conn) {
+      return nullptr;
+    }
+
+    const Object &object = objects_[connector_id];
+    vector<uint32_t> props;
+    vector<uint64_t> values;
+    for (auto &property : object.properties) {
+      props.push_back(property.first);
+      values.push_back(property.second);
+    }
+
+    conn->connector_id = connector_id;
+    conn->encoder_id = connector.encoder_id;
+    conn->connector_type = connector.config.type;
+    conn->connector_type_id = 1;
+    conn->connection = connector.config.connected ? DRM_MODE_CONNECTED : DRM_MODE_DISCONNECTED;
+    conn->mmWidth = 68;
+    conn->mmHeight = 152;
+    conn->count_modes = 1;
+    conn->modes = CopyArray(vector<drmModeModeInfo>{connector.mode});
+    conn->count_props = static_cast<int>(props.size());
+    conn->props = CopyArray(props);
+    conn->prop_values = CopyArray(values);
+    conn->count_encoders = 1;
+    conn->encoders = CopyArray(vector<uint32_t>{connector.encoder_id});
+    return conn;
+  }
+
+  errno = ENOENT;
+  return nullptr;
+}
+
+drmModePlaneResPtr Device::GetPlaneResources(int fd) {
+  lock_guard<mutex> lock(lock_);
+  drmModePlaneResPtr resources =
+      reinterpret_cast<drmModePlaneResPtr>(calloc(1, sizeof(drmModePlaneRes)));
+  if (!resources) {
+    return nullptr;
+  }
+
+  resources->count_planes = static_cast<uint32_t>(planes_.size());
+  resources->planes = CopyArray(planes_);
+  return resources;
+}
+
+drmModePlanePtr Device::GetPlane(int fd, uint32_t plane_id) {
+  lock_guard<mutex> lock(lock_);
+  if (!FindObject(plane_id, DRM_MODE_OBJECT_PLANE)) {
+    errno = ENOENT;
+    return nullptr;
+  }
+
+  drmModePlanePtr plane = reinterpret_cast<drmModePlanePtr>(calloc(1, sizeof(drmModePlane)));
+  if (!plane) {
+    return nullptr;
+  }
+
+  // SDE planes advertise their formats and modifiers through the capabilities blob, the legacy
+  // list only carries the basics.
+  vector<uint32_t> formats = {DRM_FORMAT_ABGR8888, DRM_FORMAT_ARGB8888, DRM_FORMAT_XBGR8888,
+                              DRM_FORMAT_RGB565};
+  plane->plane_id = plane_id;
+  plane->crtc_id = static_cast<uint32_t>(GetValue(plane_id, "CRTC_ID"));
+  plane->fb_id = static_cast<uint32_t>(GetValue(plane_id, "FB_ID"));
+  plane->possible_crtcs = (1u << crtcs_.size()) - 1;
+  plane->count_formats = static_cast<uint32_t>(formats.size());
+  plane->formats = CopyArray(formats);
+  return plane;
+}
+
+drmModeObjectPropertiesPtr Device::GetObjectProperties(int fd, uint32_t object_id,
+                                                       uint32_t type) {
+  lock_guard<mutex> lock(lock_);
+  Object *object = FindObject(object_id, type);
+  if (!object) {
+    errno = ENOENT;
+    return nullptr;
+  }
+
+  drmModeObjectPropertiesPtr props =
+      reinterpret_cast<drmModeObjectPropertiesPtr>(calloc(1, sizeof(drmModeObjectProperties)));
+  if (!props) {
+    return nullptr;
+  }
+
+  vector<uint32_t> ids;
+  vector<uint64_t> values;
+  for (auto &property : object->properties) {
+    ids.push_back(property.first);
+    values.push_back(property.second);
+  }
+
+  props->count_props = static_cast<uint32_t>(ids.size());
+  props->props = CopyArray(ids);
+  props->prop_values = CopyArray(values);
+  return props;
+}
+
+drmModePropertyPtr Device::GetProperty(int fd, uint32_t property_id) {
+  lock_guard<mutex> lock(lock_);
+  auto it = properties_.find(property_id);
+  if (it == properties_.end()) {
+    errno = ENOENT;
+    return nullptr;
+  }
+
+  const Property &property = it->second;
+  drmModePropertyPtr prop =
+      reinterpret_cast<drmModePropertyPtr>(calloc(1, sizeof(drmModePropertyRes)));
+  if (!prop) {
+    return nullptr;
+  }
+
+  prop->prop_id = property.id;
+  prop->flags = property.flags;
+  snprintf(prop->name, sizeof(prop->name), "%s", property.name.c_str());
+  prop->count_values = static_cast<int>(property.values.size());
+  prop->values = CopyArray(property.values);
+  prop->count_enums = static_cast<int>(property.enums.size());
+  prop->enums = CopyArray(property.enums);
+  return prop;
+}
+
+drmModePropertyBlobPtr Device::GetPropertyBlob(int fd, uint32_t blob_id) {
+  lock_guard<mutex> lock(lock_);
+  auto it = blobs_.find(blob_id);
+  if (it == blobs_.end()) {
+    errno = ENOENT;
+    return nullptr;
+  }
+
+  drmModePropertyBlobPtr blob =
+      reinterpret_cast<drmModePropertyBlobPtr>(calloc(1, sizeof(drmModePropertyBlobRes)));
+  if (!blob) {
+    return nullptr;
+  }
+
+  blob->id = blob_id;
+  blob->length = static_cast<uint32_t>(it->second.size());
+  blob->data = CopyArray(it->second);
+  return blob;
+}
+
+int Device::CreatePropertyBlob(int fd, const void *data, size_t size, uint32_t *blob_id) {
+  if (!data || !size || !blob_id) {
+    return -EINVAL;
+  }
+
+  lock_guard<mutex> lock(lock_);
+  *blob_id = AddBlob(data, size);
+  stats_.blobs_created++;
+  return 0;
+}
+
+int Device::DestroyPropertyBlob(int fd, uint32_t blob_id) {
+  lock_guard<mutex> lock(lock_);
+  if (!blobs_.erase(blob_id)) {
+    return -ENOENT;
+  }
+
+  // Objects keep showing the id like the driver keeps its reference, reads just find no data.
+  stats_.blobs_destroyed++;
+  return 0;
+}
+
+int Device::AddFramebuffer(int fd, uint32_t width, uint32_t height, uint32_t format,
+                           uint32_t *fb_id) {
+  if (!width || !height) {
+    return -EINVAL;
+  }
+
+  lock_guard<mutex> lock(lock_);
+  *fb_id = NewId();
+  Framebuffer &buffer = framebuffers_[*fb_id];
+  buffer.width = width;
+  buffer.height = height;
+  buffer.format = format;
+  return 0;
+}
+
+int Device::RemoveFramebuffer(int fd, uint32_t fb_id) {
+  lock_guard<mutex> lock(lock_);
+  if (!framebuffers_.erase(fb_id)) {
+    return -ENOENT;
+  }
+
+  // Like the kernel, removing a framebuffer that is still scanned out disables its planes.
+  const uint32_t fb_prop = GetPropertyId("FB_ID");
+  const uint32_t crtc_prop = GetPropertyId("CRTC_ID");
+  for (auto plane_id : planes_) {
+    if (GetValue(plane_id, "FB_ID") != fb_id) {
+      continue;
+    }
+    for (auto &property : objects_[plane_id].properties) {
+      if (property.first == fb_prop || property.first == crtc_prop) {
+        property.second = 0;
+      }
+    }
+  }
+
+  return 0;
+}
+
+int Device::PrimeFDToHandle(int fd, int prime_fd, uint32_t *handle) {
+  if (prime_fd < 0) {
+    return -EBADF;
+  }
+
+  lock_guard<mutex> lock(lock_);
+  *handle = next_handle_++;
+  return 0;
+}
+
+// Collects the new property values per object and the out-fence requests, checking that every
+// property belongs to its object and every referenced blob, framebuffer and CRTC exists.
+int Device::Stage(const AtomicItem *items, size_t count,
+                  std::map<uint32_t, std::map<uint32_t, uint64_t>> *staged,
+                  vector<std::pair<uint32_t, int64_t *>> *out_fences) {
+  const uint32_t output_fence = GetPropertyId("output_fence");
+  const uint32_t retire_fence = GetPropertyId("RETIRE_FENCE");
+  const uint32_t fb_id = GetPropertyId("FB_ID");
+  const uint32_t crtc_id = GetPropertyId("CRTC_ID");
+
+  for (size_t i = 0; i < count; i++) {
+    const AtomicItem &item = items[i];
+    Object *object = FindObject(item.object_id, 0);
+    if (!object) {
+      return -ENOENT;
+    }
+
+    auto prop = std::find_if(object->properties.begin(), object->properties.end(),
+                             [&item](const std::pair<uint32_t, uint64_t> &property) {
+                               return property.first == item.property_id;
+                             });
+    if (prop == object->properties.end()) {
+      DRM_LOGW("Object %u has no property %u", item.object_id, item.property_id);
+      return -EINVAL;
+    }
+
+    const Property &property = properties_[item.property_id];
+    if (property.flags & DRM_MODE_PROP_IMMUTABLE) {
+      DRM_LOGW("Property %s of object %u is immutable", property.name.c_str(), item.object_id);
+      return -EINVAL;
+    }
+
+    if (item.property_id == output_fence || item.property_id == retire_fence) {
+      if (!item.value) {
+        return -EFAULT;
+      }
+      out_fences->push_back({item.object_id, reinterpret_cast<int64_t *>(item.value)});
+      continue;
+    }
+
+    if ((property.flags & DRM_MODE_PROP_BLOB) && item.value &&
+        !blobs_.count(static_cast<uint32_t>(item.value))) {
+      DRM_LOGW("Property %s of object %u set to unknown blob %" PRIu64, property.name.c_str(),
+               item.object_id, item.value);
+      return -EINVAL;
+    }
+    if (item.property_id == fb_id && item.value &&
+        !framebuffers_.count(static_cast<uint32_t>(item.value))) {
+      return -ENOENT;
+    }
+    if (item.property_id == crtc_id && item.value &&
+        !FindCrtc(static_cast<uint32_t>(item.value))) {
+      return -ENOENT;
+    }
+
+    (*staged)[item.object_id][item.property_id] = item.value;
+  }
+
+  return 0;
+}
+
+// Validates the state the commit would leave behind and returns the CRTCs it updates. The checks
+// are the ones a malformed SDM commit trips on: a plane without a CRTC, a source outside the
+// framebuffer, more planes than blend stages and planes on an inactive CRTC.
+int Device::Check(const std::map<uint32_t, std::map<uint32_t, uint64_t>> &staged,
+                  vector<uint32_t> *crtcs) {
+  auto value = [this, &staged](uint32_t object_id, const string &name) -> uint64_t {
+    auto object = staged.find(object_id);
+    if (object != staged.end()) {
+      auto prop = object->second.find(GetPropertyId(name));
+      if (prop != object->second.end()) {
+        return prop->second;
+      }
+    }
+    return GetValue(object_id, name);
+  };
+
+  std::set<uint32_t> touched;
+  for (auto &crtc : crtcs_) {
+    if (staged.count(crtc.id)) {
+      touched.insert(crtc.id);
+    }
+  }
+  for (auto &connector : connectors_) {
+    if (staged.count(connector.id)) {
+      touched.insert(static_cast<uint32_t>(GetValue(connector.id, "CRTC_ID")));
+      touched.insert(static_cast<uint32_t>(value(connector.id, "CRTC_ID")));
+    }
+  }
+
+  std::map<uint32_t, uint32_t> stages;
+  for (auto plane_id : planes_) {
+    uint32_t old_crtc = static_cast<uint32_t>(GetValue(plane_id, "CRTC_ID"));
+    uint32_t crtc = static_cast<uint32_t>(value(plane_id, "CRTC_ID"));
+    uint32_t fb = static_cast<uint32_t>(value(plane_id, "FB_ID"));
+    if (staged.count(plane_id)) {
+      touched.insert(old_crtc);
+      touched.insert(crtc);
+    }
+
+    if (!fb) {
+      continue;
+    }
+    if (!crtc) {
+      DRM_LOGW("Plane %u has fb %u and no crtc", plane_id, fb);
+      return -EINVAL;
+    }
+
+    auto buffer_it = framebuffers_.find(fb);
+    if (buffer_it == framebuffers_.end()) {
+      return -ENOENT;
+    }
+    const Framebuffer &buffer = buffer_it->second;
+    uint64_t src_right = (value(plane_id, "SRC_X") + value(plane_id, "SRC_W")) >> 16;
+    uint64_t src_bottom = (value(plane_id, "SRC_Y") + value(plane_id, "SRC_H")) >> 16;
+    if (src_right > buffer.width || src_bottom > buffer.height) {
+      DRM_LOGW("Plane %u source %" PRIu64 "x%" PRIu64 " exceeds fb %ux%u", plane_id, src_right,
+               src_bottom, buffer.width, buffer.height);
+      return -ENOSPC;
+    }
+
+    if (!value(crtc, "ACTIVE")) {
+      DRM_LOGW("Plane %u staged on inactive crtc %u", plane_id, crtc);
+      return -EINVAL;
+    }
+
+    if (++stages[crtc] > config_.max_blend_stages) {
+      DRM_LOGW("Crtc %u exceeds %u blend stages", crtc, config_.max_blend_stages);
+      return -E2BIG;
+    }
+  }
+
+  touched.erase(0);
+  crtcs->assign(touched.begin(), touched.end());
+  return 0;
+}
+
+int Device::AtomicCommit(int fd, const AtomicItem *items, size_t count, uint32_t flags,
+                         void *user_data) {
+  bool test_only = flags & DRM_MODE_ATOMIC_TEST_ONLY;
+  bool nonblock = flags & DRM_MODE_ATOMIC_NONBLOCK;
+  std::map<uint32_t, std::map<uint32_t, uint64_t>> staged;
+  vector<std::pair<uint32_t, int64_t *>> out_fences;
+  vector<uint32_t> crtc_ids;
+
+  unique_lock<mutex> lock(lock_);
+  stats_.atomic_commits++;
+  stats_.atomic_properties += count;
+  stats_.test_only_commits += test_only;
+  stats_.nonblock_commits += nonblock;
+  if (!clients_.count(fd)) {
+    return -EBADF;
+  }
+
+  while (true) {
+    staged.clear();
+    out_fences.clear();
+    int ret = Stage(items, count, &staged, &out_fences);
+    if (!ret) {
+      ret = Check(staged, &crtc_ids);
+    }
+    if (ret) {
+      stats_.rejected_commits++;
+      return ret;
+    }
+
+    if (test_only) {
+      return 0;
+    }
+
+    bool busy = std::any_of(crtc_ids.begin(), crtc_ids.end(), [this](uint32_t crtc_id) {
+      return FindCrtc(crtc_id)->pending;
+    });
+    if (!busy) {
+      break;
+    }
+    // Like start_atomic() of the msm driver, any commit, nonblocking ones included, waits for
+    // the previous frame on its CRTCs to be latched, then validates again against whatever
+    // state that left behind.
+    vblank_cv_.wait(lock);
+    if (!clients_.count(fd)) {
+      return -EBADF;
+    }
+  }
+
+  for (auto &object : staged) {
+    for (auto &property : objects_[object.first].properties) {
+      auto it = object.second.find(property.first);
+      if (it != object.second.end()) {
+        property.second = it->second;
+        property_writes_[{object.first, property.first}]++;
+      }
+    }
+  }
+
+  vector<std::pair<uint32_t, uint64_t>> waits;
+  vector<bool> fence_created(out_fences.size(), false);
+  for (auto crtc_id : crtc_ids) {
+    Crtc *crtc = FindCrtc(crtc_id);
+    for (size_t i = 0; i < out_fences.size(); i++) {
+      auto &out_fence = out_fences.at(i);
+      bool is_crtc = (out_fence.first == crtc_id);
+      bool is_connector = !is_crtc && (GetValue(out_fence.first, "CRTC_ID") == crtc_id);
+      if (!is_crtc && !is_connector) {
+        continue;
+      }
+
+      uint64_t point = 0;
+      FenceTimeline *timeline = is_crtc ? crtc->release_timeline.get() :
+                                          crtc->retire_timeline.get();
+      int fence = timeline->CreateFence(&point);
+      *out_fence.second = fence;
+      fence_created.at(i) = true;
+      if (fence >= 0) {
+        stats_.fences_created++;
+        uint64_t &pending = is_crtc ? crtc->pending_release : crtc->pending_retire;
+        pending = std::max(pending, point);
+      }
+    }
+
+    if (flags & DRM_MODE_PAGE_FLIP_EVENT) {
+      crtc->flip_events.push_back({fd, reinterpret_cast<uint64_t>(user_data)});
+    }
+
+    if (GetValue(crtc_id, "ACTIVE")) {
+      crtc->pending = true;
+      waits.push_back({crtc_id, crtc->frame_count});
+    } else {
+      // Nothing is scanned out from an inactive CRTC, its fences signal right away.
+      crtc->release_timeline->Signal(crtc->pending_release);
+      crtc->release_timeline->Signal(crtc->displayed_release);
+      crtc->retire_timeline->Signal(crtc->pending_retire);
+      for (auto &event : crtc->flip_events) {
+        SendEvent(event.first, DRM_EVENT_FLIP_COMPLETE, event.second, vblank_sequence_, crtc_id,
+                  NowNs());
+      }
+      crtc->flip_events.clear();
+    }
+  }
+
+  // Fences of objects outside any CRTC are already signaled.
+  for (size_t i = 0; i < out_fences.size(); i++) {
+    if (!fence_created.at(i)) {
+      FenceTimeline timeline;
+      uint64_t point = 0;
+      *out_fences.at(i).second = timeline.CreateFence(&point);
+    }
+  }
+
+  if (!nonblock) {
+    for (auto &wait : waits) {
+      vblank_cv_.wait(lock, [this, &wait] {
+        Crtc *crtc = FindCrtc(wait.first);
+        return !crtc || crtc->frame_count > wait.second;
+      });
+    }
+  }
+
+  return 0;
+}
+
+int Device::WaitVBlank(int fd, drmVBlankPtr vbl) {
+  uint32_t type = vbl->request.type;
+  uint32_t crtc_index = (type & DRM_VBLANK_SECONDARY) ? 1 :
+                        ((type & DRM_VBLANK_HIGH_CRTC_MASK) >> DRM_VBLANK_HIGH_CRTC_SHIFT);
+
+  unique_lock<mutex> lock(lock_);
+  if (!clients_.count(fd) || crtc_index >= crtcs_.size()) {
+    return -EINVAL;
+  }
+  if (!GetValue(crtcs_.at(crtc_index).id, "ACTIVE")) {
+    return -EINVAL;
+  }
+
+  uint64_t target = vbl->request.sequence;
+  if (type & DRM_VBLANK_RELATIVE) {
+    target += vblank_sequence_;
+  }
+
+  if (type & DRM_VBLANK_EVENT) {
+    vblank_events_.push_back({fd, crtc_index, target, vbl->request.signal});
+    vbl->reply.sequence = static_cast<uint32_t>(target);
+    return 0;
+  }
+
+  vblank_cv_.wait(lock, [this, target, fd] {
+    return vblank_sequence_ >= target || !clients_.count(fd);
+  });
+  vbl->reply.sequence = static_cast<uint32_t>(vblank_sequence_);
+  vbl->reply.tval_sec = static_cast<long>(vblank_timestamp_ns_ / 1000000000LL);  // NOLINT
+  vbl->reply.tval_usec = static_cast<long>((vblank_timestamp_ns_ % 1000000000LL) / 1000);  // NOLINT
+  return 0;
+}
+
+void Device::SendEvent(int fd, uint32_t type, uint64_t user_data, uint64_t sequence,
+                       uint32_t crtc_id, int64_t timestamp_ns) {
+  auto client = clients_.find(fd);
+  if (client == clients_.end()) {
+    return;
+  }
+
+  struct drm_event_vblank event = {};
+  event.base.type = type;
+  event.base.length = sizeof(event);
+  event.user_data = user_data;
+  event.tv_sec = static_cast<uint32_t>(timestamp_ns / 1000000000LL);
+  event.tv_usec = static_cast<uint32_t>((timestamp_ns % 1000000000LL) / 1000);
+  event.sequence = static_cast<uint32_t>(sequence);
+  event.crtc_id = crtc_id;
+  if (write(client->second, &event, sizeof(event)) == sizeof(event)) {
+    stats_.events++;
+  }
+}
+
+int Device::HandleEvent(int fd, drmEventContextPtr context) {
+  char buffer[1024];
+  ssize_t length = read(fd, buffer, sizeof(buffer));
+  if (length <= 0) {
+    return -1;
+  }
+
+  // The pipe only carries whole events, each written atomically.
+  for (ssize_t offset = 0; offset + ssize_t(sizeof(drm_event_vblank)) <= length;
+       offset += sizeof(drm_event_vblank)) {
+    struct drm_event_vblank event;
+    memcpy(&event, buffer + offset, sizeof(event));
+    void *user_data = reinterpret_cast<void *>(event.user_data);
+    if (event.base.type == DRM_EVENT_VBLANK) {
+      if (context->vblank_handler) {
+        context->vblank_handler(fd, event.sequence, event.tv_sec, event.tv_usec, user_data);
+      }
+    } else if (event.base.type == DRM_EVENT_FLIP_COMPLETE) {
+      if (context->version >= 3 && context->page_flip_handler2) {
+        context->page_flip_handler2(fd, event.sequence, event.tv_sec, event.tv_usec,
+                                    event.crtc_id, user_data);
+      } else if (context->page_flip_handler) {
+        context->page_flip_handler(fd, event.sequence, event.tv_sec, event.tv_usec, user_data);
+      }
+    }
+  }
+
+  return 0;
+}
+
+// Latches pending commits and delivers events on a fixed vblank cadence shared by all CRTCs.
+void Device::VBlankThread() {
+  struct timespec next = {};
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  unique_lock<mutex> lock(lock_);
+  while (!vblank_thread_exit_) {
+    int64_t next_ns = next.tv_sec * 1000000000LL + next.tv_nsec + config_.vblank_period_ns;
+    next.tv_sec = next_ns / 1000000000LL;
+    next.tv_nsec = next_ns % 1000000000LL;
+
+    lock.unlock();
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) == EINTR) { }
+    lock.lock();
+    if (vblank_thread_exit_) {
+      break;
+    }
+
+    vblank_sequence_++;
+    vblank_timestamp_ns_ = NowNs();
+    stats_.vblanks++;
+
+    for (auto &crtc : crtcs_) {
+      if (crtc.pending) {
+        // The new frame is on screen and the buffers of the previous one are free.
+        crtc.retire_timeline->Signal(crtc.pending_retire);
+        crtc.release_timeline->Signal(crtc.displayed_release);
+        crtc.displayed_release = crtc.pending_release;
+        crtc.pending = false;
+        crtc.frame_count++;
+        for (auto &event : crtc.flip_events) {
+          SendEvent(event.first, DRM_EVENT_FLIP_COMPLETE, event.second, vblank_sequence_, crtc.id,
+                    vblank_timestamp_ns_);
+        }
+        crtc.flip_events.clear();
+      }
+    }
+
+    auto end = std::remove_if(vblank_events_.begin(), vblank_events_.end(),
+                              [this](const VBlankEvent &event) {
+      if (event.sequence > vblank_sequence_) {
+        return false;
+      }
+      SendEvent(event.fd, DRM_EVENT_VBLANK, event.user_data, vblank_sequence_,
+                crtcs_.at(event.crtc_index).id, vblank_timestamp_ns_);
+      return true;
+    });
+    vblank_events_.erase(end, vblank_events_.end());
+
+    vblank_cv_.notify_all();
+  }
+}
+
+}  // namespace fake_kms
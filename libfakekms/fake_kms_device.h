@@ -0,0 +1,214 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __FAKE_KMS_DEVICE_H__
+#define __FAKE_KMS_DEVICE_H__
+
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fake_kms.h"
+
+namespace fake_kms {
+
+struct AtomicItem {
+  uint32_t object_id;
+  uint32_t property_id;
+  uint64_t value;
+};
+
+// Out-fences of one kind on one CRTC. Points are signaled in creation order, like a sync timeline
+// in the driver. Fences are sync files from sw_sync when the kernel offers it and eventfds
+// otherwise; both poll readable once signaled, which is all sync_wait() needs.
+class FenceTimeline {
+ public:
+  FenceTimeline();
+  ~FenceTimeline();
+  // Returns a fence fd owned by the caller, or a negative errno. point is the timeline value that
+  // signals it.
+  int CreateFence(uint64_t *point);
+  // Signals every fence up to and including point.
+  void Signal(uint64_t point);
+
+ private:
+  int sw_sync_fd_ = -1;
+  uint64_t next_point_ = 0;
+  uint64_t signaled_point_ = 0;
+  std::map<uint64_t, int> eventfds_ = {};
+};
+
+class Device {
+ public:
+  static Device *GetInstance();
+
+  int Configure(const Config &config);
+  void GetStats(Stats *stats);
+  void ResetStats();
+  uint64_t GetFrameCount(uint32_t crtc_id);
+  uint64_t GetPropertyWrites(uint32_t object_id, const std::string &name);
+  uint32_t AttachConnector(const ConnectorConfig &config);
+  int DetachConnector(uint32_t connector_id);
+  void CountIoctls(uint32_t count) { stats_ioctls_ += count; }
+
+  int Open();
+  int Close(int fd);
+
+  drmModeResPtr GetResources(int fd);
+  drmModeCrtcPtr GetCrtc(int fd, uint32_t crtc_id);
+  drmModeEncoderPtr GetEncoder(int fd, uint32_t encoder_id);
+  drmModeConnectorPtr GetConnector(int fd, uint32_t connector_id);
+  drmModePlaneResPtr GetPlaneResources(int fd);
+  drmModePlanePtr GetPlane(int fd, uint32_t plane_id);
+  drmModeObjectPropertiesPtr GetObjectProperties(int fd, uint32_t object_id, uint32_t type);
+  drmModePropertyPtr GetProperty(int fd, uint32_t property_id);
+  drmModePropertyBlobPtr GetPropertyBlob(int fd, uint32_t blob_id);
+  // The calls below return 0 or a negative errno.
+  int CreatePropertyBlob(int fd, const void *data, size_t size, uint32_t *blob_id);
+  int DestroyPropertyBlob(int fd, uint32_t blob_id);
+  int AddFramebuffer(int fd, uint32_t width, uint32_t height, uint32_t format, uint32_t *fb_id);
+  int RemoveFramebuffer(int fd, uint32_t fb_id);
+  int PrimeFDToHandle(int fd, int prime_fd, uint32_t *handle);
+  int AtomicCommit(int fd, const AtomicItem *items, size_t count, uint32_t flags,
+                   void *user_data);
+  int WaitVBlank(int fd, drmVBlankPtr vbl);
+  int HandleEvent(int fd, drmEventContextPtr context);
+  bool IsDeviceFd(int fd);
+
+ private:
+  struct Property {
+    uint32_t id = 0;
+    std::string name = {};
+    uint32_t flags = 0;
+    std::vector<uint64_t> values = {};
+    std::vector<drm_mode_property_enum> enums = {};
+  };
+
+  struct Object {
+    uint32_t type = 0;
+    std::vector<std::pair<uint32_t, uint64_t>> properties = {};  // In attach order
+  };
+
+  struct Framebuffer {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t format = 0;
+  };
+
+  struct Connector {
+    uint32_t id = 0;
+    uint32_t encoder_id = 0;
+    ConnectorConfig config = {};
+    drmModeModeInfo mode = {};
+  };
+
+  struct Crtc {
+    uint32_t id = 0;
+    uint32_t index = 0;
+    uint64_t frame_count = 0;
+    bool pending = false;               // A commit waits to be latched at the next vblank
+    uint64_t pending_release = 0;
+    uint64_t pending_retire = 0;
+    uint64_t displayed_release = 0;     // Released when the next frame is latched
+    std::vector<std::pair<int, uint64_t>> flip_events = {};
+    std::unique_ptr<FenceTimeline> release_timeline = nullptr;
+    std::unique_ptr<FenceTimeline> retire_timeline = nullptr;
+  };
+
+  struct VBlankEvent {
+    int fd;
+    uint32_t crtc_index;
+    uint64_t sequence;
+    uint64_t user_data;
+  };
+
+  Device() { }
+  void Build();
+  void Teardown();
+  uint32_t NewId() { return next_id_++; }
+  uint32_t AddProperty(uint32_t object_id, const std::string &name, uint32_t flags,
+                       uint64_t value, const std::vector<std::string> &enums = {});
+  uint32_t AddBlob(const void *data, size_t size);
+  uint32_t AddBlobProperty(uint32_t object_id, const std::string &name, const std::string &data);
+  void AddExtraProperties(uint32_t object_id, const std::vector<std::string> &names);
+  uint32_t AddConnector(const ConnectorConfig &config);
+  Object *FindObject(uint32_t object_id, uint32_t type);
+  uint32_t GetPropertyId(const std::string &name);
+  uint64_t GetValue(uint32_t object_id, const std::string &name);
+  Crtc *FindCrtc(uint32_t crtc_id);
+  int Stage(const AtomicItem *items, size_t count,
+            std::map<uint32_t, std::map<uint32_t, uint64_t>> *staged,
+            std::vector<std::pair<uint32_t, int64_t *>> *out_fences);
+  int Check(const std::map<uint32_t, std::map<uint32_t, uint64_t>> &staged,
+            std::vector<uint32_t> *crtcs);
+  void SendEvent(int fd, uint32_t type, uint64_t user_data, uint64_t sequence, uint32_t crtc_id,
+                 int64_t timestamp_ns);
+  void VBlankThread();
+
+  static Device *s_instance;
+  static std::mutex s_lock;
+
+  std::mutex lock_;
+  std::condition_variable vblank_cv_;
+  Config config_ = DefaultConfig();
+  bool built_ = false;
+  uint32_t next_id_ = 1;
+  uint32_t next_handle_ = 1;
+  std::map<uint32_t, Property> properties_ = {};
+  std::map<std::string, uint32_t> property_ids_ = {};
+  std::map<uint32_t, Object> objects_ = {};
+  std::map<uint32_t, std::vector<uint8_t>> blobs_ = {};
+  std::map<uint32_t, Framebuffer> framebuffers_ = {};
+  std::vector<uint32_t> planes_ = {};
+  std::vector<uint32_t> encoders_ = {};
+  std::vector<Connector> connectors_ = {};
+  std::vector<Crtc> crtcs_ = {};
+  std::map<int, int> clients_ = {};  // Device fd to the write end of its event pipe
+  std::vector<VBlankEvent> vblank_events_ = {};
+  uint64_t vblank_sequence_ = 0;
+  int64_t vblank_timestamp_ns_ = 0;
+  std::thread vblank_thread_;
+  bool vblank_thread_exit_ = false;
+
+  std::atomic<uint64_t> stats_ioctls_ {0};
+  Stats stats_ = {};  // All but ioctls, under lock_
+  std::map<std::pair<uint32_t, uint32_t>, uint64_t> property_writes_ = {};  // Object, property
+};
+
+}  // namespace fake_kms
+
+#endif  // __FAKE_KMS_DEVICE_H__
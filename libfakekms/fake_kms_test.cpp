@@ -0,0 +1,277 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <drm/drm_fourcc.h>
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "fake_kms.h"
+
+namespace {
+
+struct EventCounts {
+  int vblanks = 0;
+  int flips = 0;
+};
+
+void OnVBlank(int fd, unsigned int sequence, unsigned int sec, unsigned int usec, void *data) {
+  reinterpret_cast<EventCounts *>(data)->vblanks++;
+}
+
+void OnFlip(int fd, unsigned int sequence, unsigned int sec, unsigned int usec,
+            unsigned int crtc_id, void *data) {
+  reinterpret_cast<EventCounts *>(data)->flips++;
+}
+
+// Opens the default device with two blend stages and lights up the panel on the first CRTC.
+class FakeKmsTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    config_ = fake_kms::DefaultConfig();
+    config_.vblank_period_ns = 4000000;
+    config_.max_blend_stages = 2;
+    ASSERT_EQ(0, fake_kms::Configure(config_));
+    fd_ = drmOpen("msm_drm", nullptr);
+    ASSERT_GE(fd_, 0);
+
+    resources_ = drmModeGetResources(fd_);
+    ASSERT_NE(nullptr, resources_);
+    ASSERT_EQ(2, resources_->count_crtcs);
+    ASSERT_EQ(1, resources_->count_connectors);
+    crtc_ = resources_->crtcs[0];
+    connector_ = drmModeGetConnector(fd_, resources_->connectors[0]);
+    ASSERT_NE(nullptr, connector_);
+    ASSERT_GE(connector_->count_modes, 1);
+    planes_ = drmModeGetPlaneResources(fd_);
+    ASSERT_NE(nullptr, planes_);
+
+    uint32_t mode_blob = 0;
+    ASSERT_EQ(0, drmModeCreatePropertyBlob(fd_, &connector_->modes[0],
+                                           sizeof(connector_->modes[0]), &mode_blob));
+    drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+    Add(req, crtc_, DRM_MODE_OBJECT_CRTC, "MODE_ID", mode_blob);
+    Add(req, crtc_, DRM_MODE_OBJECT_CRTC, "ACTIVE", 1);
+    Add(req, connector_->connector_id, DRM_MODE_OBJECT_CONNECTOR, "CRTC_ID", crtc_);
+    ASSERT_EQ(0, drmModeAtomicCommit(fd_, req, DRM_MODE_ATOMIC_ALLOW_MODESET, nullptr));
+    drmModeAtomicFree(req);
+
+    uint32_t handles[4] = {1}, pitches[4] = {4096}, offsets[4] = {};
+    uint64_t modifiers[4] = {};
+    for (uint32_t &fb : fbs_) {
+      ASSERT_EQ(0, drmModeAddFB2WithModifiers(fd_, 1024, 1024, DRM_FORMAT_ABGR8888, handles,
+                                              pitches, offsets, modifiers, &fb, 0));
+    }
+  }
+
+  void TearDown() {
+    drmModeFreePlaneResources(planes_);
+    drmModeFreeConnector(connector_);
+    drmModeFreeResources(resources_);
+    if (fd_ >= 0) {
+      drmClose(fd_);
+    }
+  }
+
+  uint32_t Prop(uint32_t object_id, uint32_t type, const char *name) {
+    drmModeObjectPropertiesPtr props = drmModeObjectGetProperties(fd_, object_id, type);
+    uint32_t id = 0;
+    for (uint32_t i = 0; props && i < props->count_props; i++) {
+      drmModePropertyPtr prop = drmModeGetProperty(fd_, props->props[i]);
+      if (!strcmp(prop->name, name)) {
+        id = prop->prop_id;
+      }
+      drmModeFreeProperty(prop);
+    }
+    drmModeFreeObjectProperties(props);
+    return id;
+  }
+
+  void Add(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t type, const char *name,
+           uint64_t value) {
+    uint32_t prop_id = Prop(object_id, type, name);
+    ASSERT_NE(0u, prop_id) << name;
+    drmModeAtomicAddProperty(req, object_id, prop_id, value);
+  }
+
+  void AddPlane(drmModeAtomicReqPtr req, uint32_t index, uint32_t fb, uint32_t size) {
+    uint32_t plane = planes_->planes[index];
+    Add(req, plane, DRM_MODE_OBJECT_PLANE, "FB_ID", fb);
+    Add(req, plane, DRM_MODE_OBJECT_PLANE, "CRTC_ID", crtc_);
+    Add(req, plane, DRM_MODE_OBJECT_PLANE, "SRC_W", uint64_t(size) << 16);
+    Add(req, plane, DRM_MODE_OBJECT_PLANE, "SRC_H", uint64_t(size) << 16);
+  }
+
+  // Delivers pending events until both counts are non zero or a second has passed.
+  void DrainEvents(EventCounts *counts) {
+    drmEventContext context = {};
+    context.version = 3;
+    context.vblank_handler = OnVBlank;
+    context.page_flip_handler2 = OnFlip;
+    for (int i = 0; i < 10 && !(counts->vblanks && counts->flips); i++) {
+      struct pollfd pfd = {fd_, POLLIN, 0};
+      if (poll(&pfd, 1, 100) == 1) {
+        drmHandleEvent(fd_, &context);
+      }
+    }
+  }
+
+  fake_kms::Config config_;
+  int fd_ = -1;
+  drmModeResPtr resources_ = nullptr;
+  drmModeConnectorPtr connector_ = nullptr;
+  drmModePlaneResPtr planes_ = nullptr;
+  uint32_t crtc_ = 0;
+  uint32_t fbs_[3] = {};
+};
+
+}  // namespace
+
+TEST_F(FakeKmsTest, ConfigureFailsWhileOpen) {
+  EXPECT_EQ(-EBUSY, fake_kms::Configure(config_));
+  drmClose(fd_);
+  fd_ = -1;
+  EXPECT_EQ(0, fake_kms::Configure(config_));
+}
+
+TEST_F(FakeKmsTest, ExposesDefaultResources) {
+  EXPECT_EQ(1080, connector_->modes[0].hdisplay);
+  EXPECT_EQ(8u, planes_->count_planes);
+  EXPECT_EQ(1u, fake_kms::GetFrameCount(crtc_));  // The modeset
+}
+
+TEST_F(FakeKmsTest, TestOnlyRejectsMorePlanesThanBlendStages) {
+  drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+  for (uint32_t i = 0; i < 3; i++) {
+    AddPlane(req, i, fbs_[i], 1024);
+  }
+  EXPECT_EQ(-E2BIG, drmModeAtomicCommit(fd_, req, DRM_MODE_ATOMIC_TEST_ONLY, nullptr));
+  drmModeAtomicFree(req);
+
+  req = drmModeAtomicAlloc();
+  for (uint32_t i = 0; i < 2; i++) {
+    AddPlane(req, i, fbs_[i], 1024);
+  }
+  EXPECT_EQ(0, drmModeAtomicCommit(fd_, req, DRM_MODE_ATOMIC_TEST_ONLY, nullptr));
+  drmModeAtomicFree(req);
+
+  fake_kms::Stats stats;
+  fake_kms::GetStats(&stats);
+  EXPECT_EQ(1u, stats.rejected_commits);
+}
+
+TEST_F(FakeKmsTest, TestOnlyRejectsSourceLargerThanFramebuffer) {
+  drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+  AddPlane(req, 0, fbs_[0], 2048);
+  EXPECT_EQ(-ENOSPC, drmModeAtomicCommit(fd_, req, DRM_MODE_ATOMIC_TEST_ONLY, nullptr));
+  drmModeAtomicFree(req);
+}
+
+TEST_F(FakeKmsTest, NonblockingCommitSignalsFencesOnVBlank) {
+  int64_t release = -1, retire = -1;
+  drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+  AddPlane(req, 0, fbs_[0], 1024);
+  Add(req, crtc_, DRM_MODE_OBJECT_CRTC, "output_fence", uint64_t(&release));
+  Add(req, connector_->connector_id, DRM_MODE_OBJECT_CONNECTOR, "RETIRE_FENCE",
+      uint64_t(&retire));
+  ASSERT_EQ(0, drmModeAtomicCommit(fd_, req, DRM_MODE_ATOMIC_NONBLOCK, nullptr));
+  drmModeAtomicFree(req);
+  ASSERT_GE(release, 0);
+  ASSERT_GE(retire, 0);
+
+  struct pollfd pfd = {static_cast<int>(retire), POLLIN, 0};
+  EXPECT_EQ(0, poll(&pfd, 1, 0));
+
+  // The next commit on the CRTC waits for the pending frame to be latched, as on msm
+  req = drmModeAtomicAlloc();
+  AddPlane(req, 0, fbs_[1], 1024);
+  ASSERT_EQ(0, drmModeAtomicCommit(fd_, req, DRM_MODE_ATOMIC_NONBLOCK, nullptr));
+  drmModeAtomicFree(req);
+  EXPECT_EQ(1, poll(&pfd, 1, 0));
+  EXPECT_EQ(2u, fake_kms::GetFrameCount(crtc_));
+  close(static_cast<int>(retire));
+  close(static_cast<int>(release));
+}
+
+TEST_F(FakeKmsTest, DeliversVBlankAndFlipEvents) {
+  // Both events carry the counts as user data
+  EventCounts counts;
+  drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+  AddPlane(req, 0, fbs_[0], 1024);
+  ASSERT_EQ(0, drmModeAtomicCommit(fd_, req, DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT,
+                                   &counts));
+  drmModeAtomicFree(req);
+
+  drmVBlank vblank = {};
+  vblank.request.type = drmVBlankSeqType(DRM_VBLANK_RELATIVE | DRM_VBLANK_EVENT);
+  vblank.request.sequence = 1;
+  vblank.request.signal = reinterpret_cast<unsigned long>(&counts);  // NOLINT
+  ASSERT_EQ(0, drmWaitVBlank(fd_, &vblank));
+
+  DrainEvents(&counts);
+  EXPECT_EQ(1, counts.vblanks);
+  EXPECT_EQ(1, counts.flips);
+}
+
+TEST_F(FakeKmsTest, BlockingVBlankWaitAdvancesSequence) {
+  drmVBlank vblank = {};
+  vblank.request.type = DRM_VBLANK_RELATIVE;
+  vblank.request.sequence = 0;
+  ASSERT_EQ(0, drmWaitVBlank(fd_, &vblank));
+  unsigned int sequence = vblank.reply.sequence;
+
+  vblank = {};
+  vblank.request.type = DRM_VBLANK_RELATIVE;
+  vblank.request.sequence = 2;
+  ASSERT_EQ(0, drmWaitVBlank(fd_, &vblank));
+  EXPECT_EQ(sequence + 2, vblank.reply.sequence);
+}
+
+TEST_F(FakeKmsTest, RemovingScannedOutFramebufferDetachesPlane) {
+  drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+  AddPlane(req, 0, fbs_[0], 1024);
+  ASSERT_EQ(0, drmModeAtomicCommit(fd_, req, 0, nullptr));
+  drmModeAtomicFree(req);
+
+  drmModePlanePtr plane = drmModeGetPlane(fd_, planes_->planes[0]);
+  ASSERT_NE(nullptr, plane);
+  EXPECT_EQ(fbs_[0], plane->fb_id);
+  drmModeFreePlane(plane);
+
+  ASSERT_EQ(0, drmModeRmFB(fd_, fbs_[0]));
+  plane = drmModeGetPlane(fd_, planes_->planes[0]);
+  ASSERT_NE(nullptr, plane);
+  EXPECT_EQ(0u, plane->fb_id);
+  EXPECT_EQ(0u, plane->crtc_id);
+  drmModeFreePlane(plane);
+}
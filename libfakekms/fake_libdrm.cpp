@@ -0,0 +1,368 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <drm/msm_drm.h>
+#include <drm/sde_drm.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <new>
+#include <vector>
+
+#include "fake_kms_device.h"
+
+// libdrm entry points served by the fake device. Each one accounts for the ioctls libdrm issues for
+// it: the getters that return variable length arrays ask the kernel for the count first and for the
+// data second.
+
+using fake_kms::AtomicItem;
+using fake_kms::Device;
+
+struct _drmModeAtomicReq {
+  uint32_t cursor;
+  std::vector<AtomicItem> items;
+};
+
+static Device *FakeDevice(uint32_t ioctls) {
+  Device *device = Device::GetInstance();
+  device->CountIoctls(ioctls);
+  return device;
+}
+
+// libdrm reports errors of the modesetting calls as a negative errno and also leaves it in errno.
+static int SetErrno(int ret) {
+  if (ret < 0) {
+    errno = -ret;
+  }
+  return ret;
+}
+
+// Plain ioctl wrappers return -1 and leave the error in errno.
+static int IoctlResult(int ret) {
+  if (ret < 0) {
+    errno = -ret;
+    return -1;
+  }
+  return ret;
+}
+
+namespace fake_kms {
+
+int Configure(const Config &config) {
+  return Device::GetInstance()->Configure(config);
+}
+
+void GetStats(Stats *stats) {
+  Device::GetInstance()->GetStats(stats);
+}
+
+void ResetStats() {
+  Device::GetInstance()->ResetStats();
+}
+
+uint64_t GetFrameCount(uint32_t crtc_id) {
+  return Device::GetInstance()->GetFrameCount(crtc_id);
+}
+
+uint64_t GetPropertyWrites(uint32_t object_id, const std::string &name) {
+  return Device::GetInstance()->GetPropertyWrites(object_id, name);
+}
+
+uint32_t AttachConnector(const ConnectorConfig &config) {
+  return Device::GetInstance()->AttachConnector(config);
+}
+
+int DetachConnector(uint32_t connector_id) {
+  return Device::GetInstance()->DetachConnector(connector_id);
+}
+
+}  // namespace fake_kms
+
+extern "C" {
+
+int drmOpen(const char *name, const char *busid) {
+  return SetErrno(FakeDevice(1)->Open());
+}
+
+int drmClose(int fd) {
+  return SetErrno(FakeDevice(0)->Close(fd));
+}
+
+int drmSetClientCap(int fd, uint64_t capability, uint64_t value) {
+  return FakeDevice(1)->IsDeviceFd(fd) ? 0 : SetErrno(-EBADF);
+}
+
+// Reports a fixed driver version, so that anything keyed on it, like the resource snapshot of the
+// SDM core, stays valid across runs.
+drmVersionPtr drmGetVersion(int fd) {
+  static const char kName[] = "msm_drm";
+  if (!FakeDevice(2)->IsDeviceFd(fd)) {
+    SetErrno(-EBADF);
+    return nullptr;
+  }
+
+  drmVersionPtr version = reinterpret_cast<drmVersionPtr>(calloc(1, sizeof(drmVersion)));
+  if (version) {
+    version->version_major = 1;
+    version->version_minor = 5;
+    version->name_len = static_cast<int>(sizeof(kName) - 1);
+    version->name = strdup(kName);
+    version->date = strdup("");
+    version->desc = strdup("");
+  }
+  return version;
+}
+
+void drmFreeVersion(drmVersionPtr version) {
+  if (version) {
+    free(version->name);
+    free(version->date);
+    free(version->desc);
+    free(version);
+  }
+}
+
+int drmIoctl(int fd, unsigned long request, void *arg) {  // NOLINT
+  Device *device = FakeDevice(1);
+  if (!device->IsDeviceFd(fd)) {
+    return IoctlResult(-EBADF);
+  }
+
+  switch (request) {
+    case DRM_IOCTL_MODE_ADDFB2: {
+      struct drm_mode_fb_cmd2 *cmd = reinterpret_cast<struct drm_mode_fb_cmd2 *>(arg);
+      return IoctlResult(device->AddFramebuffer(fd, cmd->width, cmd->height, cmd->pixel_format,
+                                                &cmd->fb_id));
+    }
+    case DRM_IOCTL_MODE_RMFB:
+#ifdef DRM_IOCTL_MSM_RMFB2
+    case DRM_IOCTL_MSM_RMFB2:
+#endif
+      return IoctlResult(device->RemoveFramebuffer(fd, *reinterpret_cast<uint32_t *>(arg)));
+    case DRM_IOCTL_PRIME_FD_TO_HANDLE: {
+      struct drm_prime_handle *prime = reinterpret_cast<struct drm_prime_handle *>(arg);
+      return IoctlResult(device->PrimeFDToHandle(fd, prime->fd, &prime->handle));
+    }
+    case DRM_IOCTL_GEM_CLOSE:
+    case DRM_IOCTL_SET_CLIENT_CAP:
+#ifdef DRM_IOCTL_MSM_REGISTER_EVENT
+    case DRM_IOCTL_MSM_REGISTER_EVENT:
+    case DRM_IOCTL_MSM_DEREGISTER_EVENT:
+#endif
+#ifdef DRM_IOCTL_SDE_WB_CONFIG
+    case DRM_IOCTL_SDE_WB_CONFIG:
+#endif
+      // Accepted; the fake raises no driver events and has no writeback.
+      return 0;
+    default:
+      return IoctlResult(-ENOTTY);
+  }
+}
+
+int drmPrimeFDToHandle(int fd, int prime_fd, uint32_t *handle) {
+  return IoctlResult(FakeDevice(1)->PrimeFDToHandle(fd, prime_fd, handle));
+}
+
+int drmWaitVBlank(int fd, drmVBlankPtr vbl) {
+  return IoctlResult(FakeDevice(1)->WaitVBlank(fd, vbl));
+}
+
+int drmHandleEvent(int fd, drmEventContextPtr evctx) {
+  return FakeDevice(1)->HandleEvent(fd, evctx);
+}
+
+drmModeResPtr drmModeGetResources(int fd) {
+  return FakeDevice(2)->GetResources(fd);
+}
+
+void drmModeFreeResources(drmModeResPtr ptr) {
+  if (ptr) {
+    free(ptr->fbs);
+    free(ptr->crtcs);
+    free(ptr->connectors);
+    free(ptr->encoders);
+    free(ptr);
+  }
+}
+
+drmModeCrtcPtr drmModeGetCrtc(int fd, uint32_t crtc_id) {
+  return FakeDevice(1)->GetCrtc(fd, crtc_id);
+}
+
+void drmModeFreeCrtc(drmModeCrtcPtr ptr) {
+  free(ptr);
+}
+
+int drmModeSetCrtc(int fd, uint32_t crtc_id, uint32_t buffer_id, uint32_t x, uint32_t y,
+                   uint32_t *connectors, int count, drmModeModeInfoPtr mode) {
+  // Legacy modesetting is only used to tear a display down, which the atomic state covers.
+  return FakeDevice(1)->IsDeviceFd(fd) ? 0 : SetErrno(-EBADF);
+}
+
+drmModeEncoderPtr drmModeGetEncoder(int fd, uint32_t encoder_id) {
+  return FakeDevice(1)->GetEncoder(fd, encoder_id);
+}
+
+void drmModeFreeEncoder(drmModeEncoderPtr ptr) {
+  free(ptr);
+}
+
+drmModeConnectorPtr drmModeGetConnector(int fd, uint32_t connector_id) {
+  return FakeDevice(2)->GetConnector(fd, connector_id);
+}
+
+void drmModeFreeConnector(drmModeConnectorPtr ptr) {
+  if (ptr) {
+    free(ptr->modes);
+    free(ptr->props);
+    free(ptr->prop_values);
+    free(ptr->encoders);
+    free(ptr);
+  }
+}
+
+drmModePlaneResPtr drmModeGetPlaneResources(int fd) {
+  return FakeDevice(2)->GetPlaneResources(fd);
+}
+
+void drmModeFreePlaneResources(drmModePlaneResPtr ptr) {
+  if (ptr) {
+    free(ptr->planes);
+    free(ptr);
+  }
+}
+
+drmModePlanePtr drmModeGetPlane(int fd, uint32_t plane_id) {
+  return FakeDevice(2)->GetPlane(fd, plane_id);
+}
+
+void drmModeFreePlane(drmModePlanePtr ptr) {
+  if (ptr) {
+    free(ptr->formats);
+    free(ptr);
+  }
+}
+
+drmModeObjectPropertiesPtr drmModeObjectGetProperties(int fd, uint32_t object_id,
+                                                      uint32_t object_type) {
+  return FakeDevice(2)->GetObjectProperties(fd, object_id, object_type);
+}
+
+void drmModeFreeObjectProperties(drmModeObjectPropertiesPtr ptr) {
+  if (ptr) {
+    free(ptr->props);
+    free(ptr->prop_values);
+    free(ptr);
+  }
+}
+
+drmModePropertyPtr drmModeGetProperty(int fd, uint32_t property_id) {
+  return FakeDevice(2)->GetProperty(fd, property_id);
+}
+
+void drmModeFreeProperty(drmModePropertyPtr ptr) {
+  if (ptr) {
+    free(ptr->values);
+    free(ptr->enums);
+    free(ptr->blob_ids);
+    free(ptr);
+  }
+}
+
+drmModePropertyBlobPtr drmModeGetPropertyBlob(int fd, uint32_t blob_id) {
+  return FakeDevice(2)->GetPropertyBlob(fd, blob_id);
+}
+
+void drmModeFreePropertyBlob(drmModePropertyBlobPtr ptr) {
+  if (ptr) {
+    free(ptr->data);
+    free(ptr);
+  }
+}
+
+int drmModeCreatePropertyBlob(int fd, const void *data, size_t size, uint32_t *id) {
+  return SetErrno(FakeDevice(1)->CreatePropertyBlob(fd, data, size, id));
+}
+
+int drmModeDestroyPropertyBlob(int fd, uint32_t id) {
+  return SetErrno(FakeDevice(1)->DestroyPropertyBlob(fd, id));
+}
+
+int drmModeAddFB2WithModifiers(int fd, uint32_t width, uint32_t height, uint32_t pixel_format,
+                               const uint32_t bo_handles[4], const uint32_t pitches[4],
+                               const uint32_t offsets[4], const uint64_t modifier[4],
+                               uint32_t *buf_id, uint32_t flags) {
+  return SetErrno(FakeDevice(1)->AddFramebuffer(fd, width, height, pixel_format, buf_id));
+}
+
+int drmModeRmFB(int fd, uint32_t buffer_id) {
+  return SetErrno(FakeDevice(1)->RemoveFramebuffer(fd, buffer_id));
+}
+
+drmModeAtomicReqPtr drmModeAtomicAlloc(void) {
+  return new (std::nothrow) _drmModeAtomicReq{0, {}};
+}
+
+void drmModeAtomicFree(drmModeAtomicReqPtr req) {
+  delete req;
+}
+
+int drmModeAtomicGetCursor(drmModeAtomicReqPtr req) {
+  return req ? static_cast<int>(req->cursor) : -EINVAL;
+}
+
+void drmModeAtomicSetCursor(drmModeAtomicReqPtr req, int cursor) {
+  if (req) {
+    req->cursor = static_cast<uint32_t>(cursor);
+  }
+}
+
+int drmModeAtomicAddProperty(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t property_id,
+                             uint64_t value) {
+  if (!req) {
+    return -EINVAL;
+  }
+
+  req->items.resize(req->cursor);
+  req->items.push_back({object_id, property_id, value});
+  return static_cast<int>(++req->cursor);
+}
+
+int drmModeAtomicCommit(int fd, drmModeAtomicReqPtr req, uint32_t flags, void *user_data) {
+  if (!req) {
+    return SetErrno(-EINVAL);
+  }
+
+  return SetErrno(FakeDevice(1)->AtomicCommit(fd, req->items.data(), req->cursor, flags,
+                                              user_data));
+}
+
+}  // extern "C"
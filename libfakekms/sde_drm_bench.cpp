@@ -0,0 +1,353 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Measures the CPU cost and the kernel traffic of a frame through libsdedrm, the way HWDeviceDRM
+// drives it: plane setup, a TEST_ONLY validation, the same setup again and a NONBLOCK commit with
+// release and retire fences. Runs against libfakekms, so it needs no display hardware; linking
+// libfakekms ahead of libdrm makes libsdedrm resolve its libdrm calls to the fake.
+
+#include <drm/drm_fourcc.h>
+#include <drm_lib_loader.h>
+#include <drm_master.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "fake_kms.h"
+
+using drm_utils::DRMBuffer;
+using drm_utils::DRMLibLoader;
+using drm_utils::DRMMaster;
+using sde_drm::DRMAtomicReqInterface;
+using sde_drm::DRMBlendType;
+using sde_drm::DRMConnectorInfo;
+using sde_drm::DRMDisplayToken;
+using sde_drm::DRMDisplayType;
+using sde_drm::DRMManagerInterface;
+using sde_drm::DRMOps;
+using sde_drm::DRMPlaneType;
+using sde_drm::DRMPlanesInfo;
+using sde_drm::DRMPowerMode;
+using sde_drm::DRMRect;
+using std::string;
+using std::vector;
+
+struct BenchLayer {
+  uint32_t width;
+  uint32_t height;
+  uint32_t format;
+  DRMRect dst;  // In display coordinates scaled by 1000, resolved against the mode
+};
+
+struct LayerMix {
+  const char *name;
+  vector<BenchLayer> layers;
+};
+
+struct PlaneSetup {
+  uint32_t plane_id;
+  uint32_t fb_id;
+  DRMRect src;
+  DRMRect dst;
+};
+
+struct Sample {
+  int64_t validate_ns;
+  int64_t commit_ns;
+  uint64_t ioctls;
+  uint64_t properties;
+};
+
+static const int kDefaultFrames = 600;
+
+static vector<LayerMix> GetLayerMixes(uint32_t width, uint32_t height) {
+  return {
+    {"fullscreen", {{width, height, DRM_FORMAT_ABGR8888, {0, 0, 1000, 1000}}}},
+    {"ui", {{width, height, DRM_FORMAT_XBGR8888, {0, 0, 1000, 1000}},
+            {width, height, DRM_FORMAT_ABGR8888, {0, 0, 1000, 1000}},
+            {width, height / 25, DRM_FORMAT_ABGR8888, {0, 0, 1000, 40}},
+            {width, height / 20, DRM_FORMAT_ABGR8888, {0, 950, 1000, 1000}}}},
+    {"video", {{1920, 1080, DRM_FORMAT_NV12, {0, 350, 1000, 650}},
+               {width, height, DRM_FORMAT_ABGR8888, {0, 0, 1000, 1000}},
+               {width, height / 25, DRM_FORMAT_ABGR8888, {0, 0, 1000, 40}}}},
+    {"all_pipes", {{width, height, DRM_FORMAT_XBGR8888, {0, 0, 1000, 1000}},
+                   {width, height, DRM_FORMAT_ABGR8888, {0, 0, 1000, 1000}},
+                   {width / 2, height / 2, DRM_FORMAT_ABGR8888, {0, 0, 500, 500}},
+                   {width / 2, height / 2, DRM_FORMAT_ABGR8888, {500, 0, 1000, 500}},
+                   {width / 2, height / 2, DRM_FORMAT_ABGR8888, {0, 500, 500, 1000}},
+                   {width / 2, height / 2, DRM_FORMAT_ABGR8888, {500, 500, 1000, 1000}},
+                   {width, height / 25, DRM_FORMAT_ABGR8888, {0, 0, 1000, 40}},
+                   {width, height / 20, DRM_FORMAT_ABGR8888, {0, 950, 1000, 1000}}}},
+  };
+}
+
+static int64_t ThreadCpuNs() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint64_t Ioctls() {
+  fake_kms::Stats stats = {};
+  fake_kms::GetStats(&stats);
+  return stats.ioctls;
+}
+
+static void WaitFence(int64_t fence) {
+  if (fence >= 0) {
+    struct pollfd pfd = {static_cast<int>(fence), POLLIN, 0};
+    while (poll(&pfd, 1, 1000) < 0 && errno == EINTR) { }
+    close(static_cast<int>(fence));
+  }
+}
+
+static void SetupPlanes(DRMAtomicReqInterface *req, const DRMDisplayToken &token,
+                        const vector<PlaneSetup> &planes) {
+  uint32_t zorder = 0;
+  for (auto &plane : planes) {
+    req->Perform(DRMOps::PLANE_SET_SRC_RECT, plane.plane_id, plane.src);
+    req->Perform(DRMOps::PLANE_SET_DST_RECT, plane.plane_id, plane.dst);
+    req->Perform(DRMOps::PLANE_SET_ZORDER, plane.plane_id, zorder++);
+    req->Perform(DRMOps::PLANE_SET_ALPHA, plane.plane_id, 0xffu);
+    req->Perform(DRMOps::PLANE_SET_BLEND_TYPE, plane.plane_id,
+                 static_cast<uint32_t>(DRMBlendType::PREMULTIPLIED));
+    req->Perform(DRMOps::PLANE_SET_FB_ID, plane.plane_id, plane.fb_id);
+    req->Perform(DRMOps::PLANE_SET_CRTC, plane.plane_id, token.crtc_id);
+    req->Perform(DRMOps::PLANE_SET_INPUT_FENCE, plane.plane_id, -1);
+  }
+}
+
+static int64_t Percentile(vector<int64_t> values, size_t percent) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values.at(std::min(values.size() - 1, values.size() * percent / 100));
+}
+
+static int RunMix(const LayerMix &mix, DRMManagerInterface *drm_mgr, DRMMaster *master,
+                  const DRMDisplayToken &token, const drmModeModeInfo &mode, int frames) {
+  DRMPlanesInfo planes_info;
+  drm_mgr->GetPlanesInfo(&planes_info);
+  vector<uint32_t> vig_planes, dma_planes;
+  for (auto &plane : planes_info) {
+    if (plane.second.type == DRMPlaneType::VIG) {
+      vig_planes.push_back(plane.first);
+    } else if (plane.second.type == DRMPlaneType::DMA) {
+      dma_planes.push_back(plane.first);
+    }
+  }
+
+  int buffer_fd = open("/dev/zero", O_RDONLY | O_CLOEXEC);
+  vector<PlaneSetup> planes;
+  for (auto &layer : mix.layers) {
+    bool yuv = (layer.format == DRM_FORMAT_NV12);
+    vector<uint32_t> &pool = (yuv || dma_planes.empty()) ? vig_planes : dma_planes;
+    vector<uint32_t> &spare = (&pool == &vig_planes) ? dma_planes : vig_planes;
+    vector<uint32_t> &source = !pool.empty() ? pool : spare;
+    if (source.empty() || (yuv && vig_planes.empty())) {
+      printf("%-12s skipped, not enough planes\n", mix.name);
+      close(buffer_fd);
+      return 0;
+    }
+
+    DRMBuffer buffer = {};
+    buffer.fd = buffer_fd;
+    buffer.width = layer.width;
+    buffer.height = layer.height;
+    buffer.drm_format = layer.format;
+    buffer.stride[0] = layer.width * 4;
+    PlaneSetup plane = {};
+    plane.plane_id = source.back();
+    source.pop_back();
+    if (master->CreateFbId(buffer, &plane.fb_id)) {
+      printf("%-12s failed to create framebuffers\n", mix.name);
+      close(buffer_fd);
+      return -1;
+    }
+    plane.src = {0, 0, layer.width, layer.height};
+    plane.dst = {layer.dst.left * mode.hdisplay / 1000, layer.dst.top * mode.vdisplay / 1000,
+                 layer.dst.right * mode.hdisplay / 1000, layer.dst.bottom * mode.vdisplay / 1000};
+    planes.push_back(plane);
+  }
+  close(buffer_fd);
+
+  DRMAtomicReqInterface *req = nullptr;
+  drm_mgr->CreateAtomicReq(token, &req);
+  vector<Sample> samples;
+  int64_t retire_fence = -1;
+  int failures = 0;
+  fake_kms::Stats start = {};
+  fake_kms::GetStats(&start);
+
+  for (int frame = 0; frame < frames; frame++) {
+    // Frames are paced by the display like SurfaceFlinger paces them on the retire fence.
+    WaitFence(retire_fence);
+
+    Sample sample = {};
+    uint64_t ioctls = Ioctls();
+    int64_t start_ns = ThreadCpuNs();
+    SetupPlanes(req, token, planes);
+    int ret = req->Validate();
+    sample.validate_ns = ThreadCpuNs() - start_ns;
+
+    int64_t release_fence = -1;
+    start_ns = ThreadCpuNs();
+    SetupPlanes(req, token, planes);
+    req->Perform(DRMOps::CRTC_GET_RELEASE_FENCE, token.crtc_id, &release_fence);
+    req->Perform(DRMOps::CONNECTOR_GET_RETIRE_FENCE, token.conn_id, &retire_fence);
+    ret = ret ? ret : req->Commit(false /* synchronous */, false /* retain_planes */);
+    sample.commit_ns = ThreadCpuNs() - start_ns;
+    sample.ioctls = Ioctls() - ioctls;
+    failures += (ret != 0);
+    if (release_fence >= 0) {
+      close(static_cast<int>(release_fence));
+    }
+    samples.push_back(sample);
+  }
+  WaitFence(retire_fence);
+
+  fake_kms::Stats end = {};
+  fake_kms::GetStats(&end);
+
+  // Framebuffers are only removed once no plane scans them out, as SDM does. A commit without
+  // planes unsets every plane libsdedrm assigned to the CRTC.
+  req->Commit(true /* synchronous */, false /* retain_planes */);
+  drm_mgr->DestroyAtomicReq(req);
+  for (auto &plane : planes) {
+    master->RemoveFbId(plane.fb_id);
+  }
+
+  vector<int64_t> validate, commit, total;
+  uint64_t ioctls = 0;
+  for (auto &sample : samples) {
+    validate.push_back(sample.validate_ns);
+    commit.push_back(sample.commit_ns);
+    total.push_back(sample.validate_ns + sample.commit_ns);
+    ioctls += sample.ioctls;
+  }
+
+  double count = static_cast<double>(std::max<size_t>(samples.size(), 1));
+  printf("%-12s %6zu %7" PRId64 " %7" PRId64 " %7" PRId64 " %7" PRId64 " %7" PRId64 " %8.1f %8.1f"
+         " %6d\n", mix.name, planes.size(), Percentile(validate, 50) / 1000,
+         Percentile(commit, 50) / 1000, Percentile(total, 50) / 1000, Percentile(total, 90) / 1000,
+         Percentile(total, 99) / 1000, static_cast<double>(ioctls) / count,
+         static_cast<double>(end.atomic_properties - start.atomic_properties) / count, failures);
+  return failures ? -1 : 0;
+}
+
+static void Usage(const char *name) {
+  fprintf(stderr, "usage: %s [-f frames] [-v vblank_us] [-m mix]\n"
+                  "mixes: fullscreen ui video all_pipes\n", name);
+}
+
+int main(int argc, char **argv) {
+  int frames = kDefaultFrames;
+  int64_t vblank_us = 0;
+  string only_mix;
+  int opt;
+  while ((opt = getopt(argc, argv, "f:v:m:h")) != -1) {
+    switch (opt) {
+      case 'f': frames = atoi(optarg); break;
+      case 'v': vblank_us = atoll(optarg); break;
+      case 'm': only_mix = optarg; break;
+      default: Usage(argv[0]); return 2;
+    }
+  }
+
+  fake_kms::Config config = fake_kms::DefaultConfig();
+  config.vblank_period_ns = vblank_us * 1000;
+  fake_kms::Configure(config);
+
+  DRMMaster *master = nullptr;
+  DRMLibLoader *loader = DRMLibLoader::GetInstance();
+  if (DRMMaster::GetInstance(&master) || !loader->IsLoaded()) {
+    fprintf(stderr, "Failed to open the fake device or load libsdedrm\n");
+    return 1;
+  }
+
+  int fd = -1;
+  master->GetHandle(&fd);
+  DRMManagerInterface *drm_mgr = nullptr;
+  if (loader->FuncGetDRMManager()(fd, &drm_mgr)) {
+    fprintf(stderr, "Failed to create the DRM manager\n");
+    return 1;
+  }
+
+  DRMDisplayToken token = {};
+  DRMConnectorInfo conn_info = {};
+  if (drm_mgr->RegisterDisplay(DRMDisplayType::PERIPHERAL, &token) ||
+      drm_mgr->GetConnectorInfo(token.conn_id, &conn_info) || conn_info.modes.empty()) {
+    fprintf(stderr, "No built-in display on the fake device\n");
+    return 1;
+  }
+
+  // Power on with the preferred mode, as the first commit of a built-in display does.
+  drmModeModeInfo mode = conn_info.modes.at(0).mode;
+  DRMAtomicReqInterface *req = nullptr;
+  drm_mgr->CreateAtomicReq(token, &req);
+  req->Perform(DRMOps::CRTC_SET_MODE, token.crtc_id, &mode);
+  req->Perform(DRMOps::CRTC_SET_ACTIVE, token.crtc_id, 1);
+  req->Perform(DRMOps::CONNECTOR_SET_CRTC, token.conn_id, token.crtc_id);
+  req->Perform(DRMOps::CONNECTOR_SET_POWER_MODE, token.conn_id, DRMPowerMode::ON);
+  int ret = req->Commit(true /* synchronous */, false /* retain_planes */);
+  drm_mgr->DestroyAtomicReq(req);
+  if (ret) {
+    fprintf(stderr, "Power on commit failed: %d\n", ret);
+    return 1;
+  }
+
+  printf("%s %ux%u@%u, %d frames per mix, times in us of thread CPU\n",
+         conn_info.panel_name.c_str(), mode.hdisplay, mode.vdisplay, mode.vrefresh, frames);
+  printf("%-12s %6s %7s %7s %7s %7s %7s %8s %8s %6s\n", "mix", "layers", "valid50", "commit50",
+         "frame50", "frame90", "frame99", "ioctls", "props", "failed");
+
+  int status = 0;
+  for (auto &mix : GetLayerMixes(mode.hdisplay, mode.vdisplay)) {
+    if (only_mix.empty() || only_mix == mix.name) {
+      status |= RunMix(mix, drm_mgr, master, token, mode, frames);
+    }
+  }
+
+  drm_mgr->UnregisterDisplay(&token);
+  loader->FuncDestroyDRMManager()();
+  DRMMaster::DestroyInstance();
+  DRMLibLoader::Destroy();
+
+  return status ? 1 : 0;
+}
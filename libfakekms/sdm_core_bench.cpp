@@ -0,0 +1,303 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Measures the CPU cost and the kernel traffic of DisplayBase::Prepare() and Commit() on the
+// built-in display, i.e. the whole SDM core path from the layer stack down to the atomic commit.
+// libsdmcore runs unmodified on libfakekms, with small stand-ins for the buffer allocator, sync
+// handler and socket handler that the composer normally provides. Without the strategy extension
+// library every app layer is GPU composed, so a frame commits the GPU target layer alone and the
+// cost measured is the core and resource manager overhead, not plane allocation.
+
+#include <core/core_interface.h>
+#include <core/display_interface.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <utils/fence.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "fake_kms.h"
+#include "sdm_core_host.h"
+
+using sdm::CoreInterface;
+using sdm::DisplayConfigVariableInfo;
+using sdm::DisplayError;
+using sdm::DisplayInterface;
+using sdm::Fence;
+using sdm::Layer;
+using sdm::LayerBufferFormat;
+using sdm::LayerRect;
+using sdm::LayerStack;
+using sdm::kErrorNone;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+struct BenchLayer {
+  uint32_t width;
+  uint32_t height;
+  LayerBufferFormat format;
+  LayerRect dst;  // In display coordinates scaled by 1000, resolved against the mode
+};
+
+struct LayerMix {
+  const char *name;
+  vector<BenchLayer> layers;
+};
+
+struct Sample {
+  int64_t prepare_ns;
+  int64_t commit_ns;
+  uint64_t ioctls;
+};
+
+static const int kDefaultFrames = 600;
+static const uint64_t kTargetBufferId = 1;  // Buffers of the mix layers count up from here
+
+static vector<LayerMix> GetLayerMixes(uint32_t width, uint32_t height) {
+  return {
+    {"fullscreen", {{width, height, sdm::kFormatRGBA8888, {0, 0, 1000, 1000}}}},
+    {"ui", {{width, height, sdm::kFormatRGBX8888, {0, 0, 1000, 1000}},
+            {width, height, sdm::kFormatRGBA8888, {0, 0, 1000, 1000}},
+            {width, height / 25, sdm::kFormatRGBA8888, {0, 0, 1000, 40}},
+            {width, height / 20, sdm::kFormatRGBA8888, {0, 950, 1000, 1000}}}},
+    {"video", {{1920, 1088, sdm::kFormatYCbCr420SemiPlanarVenus, {0, 350, 1000, 650}},
+               {width, height, sdm::kFormatRGBA8888, {0, 0, 1000, 1000}},
+               {width, height / 25, sdm::kFormatRGBA8888, {0, 0, 1000, 40}}}},
+    {"all_pipes", {{width, height, sdm::kFormatRGBX8888, {0, 0, 1000, 1000}},
+                   {width, height, sdm::kFormatRGBA8888, {0, 0, 1000, 1000}},
+                   {width / 2, height / 2, sdm::kFormatRGBA8888, {0, 0, 500, 500}},
+                   {width / 2, height / 2, sdm::kFormatRGBA8888, {500, 0, 1000, 500}},
+                   {width / 2, height / 2, sdm::kFormatRGBA8888, {0, 500, 500, 1000}},
+                   {width / 2, height / 2, sdm::kFormatRGBA8888, {500, 500, 1000, 1000}},
+                   {width, height / 25, sdm::kFormatRGBA8888, {0, 0, 1000, 40}},
+                   {width, height / 20, sdm::kFormatRGBA8888, {0, 950, 1000, 1000}}}},
+  };
+}
+
+static int64_t ThreadCpuNs() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint64_t Ioctls() {
+  fake_kms::Stats stats = {};
+  fake_kms::GetStats(&stats);
+  return stats.ioctls;
+}
+
+static int64_t Percentile(vector<int64_t> values, size_t percent) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values.at(std::min(values.size() - 1, values.size() * percent / 100));
+}
+
+static void SetBuffer(uint32_t width, uint32_t height, LayerBufferFormat format, int fd,
+                      uint64_t id, Layer *layer) {
+  layer->input_buffer.width = layer->input_buffer.unaligned_width = width;
+  layer->input_buffer.height = layer->input_buffer.unaligned_height = height;
+  layer->input_buffer.format = format;
+  layer->input_buffer.planes[0].fd = fd;
+  layer->input_buffer.planes[0].stride = width * 4;
+  layer->input_buffer.size = width * height * 4;
+  layer->input_buffer.buffer_id = id;
+  layer->input_buffer.handle_id = id;
+  layer->src_rect = {0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height)};
+}
+
+static int RunMix(const LayerMix &mix, DisplayInterface *display, uint32_t width,
+                  uint32_t height, Layer *target, int frames) {
+  int buffer_fd = open("/dev/zero", O_RDONLY | O_CLOEXEC);
+  vector<Layer> layers(mix.layers.size());
+  uint64_t id = kTargetBufferId;
+  for (size_t i = 0; i < mix.layers.size(); i++) {
+    const BenchLayer &bench_layer = mix.layers.at(i);
+    Layer *layer = &layers.at(i);
+    SetBuffer(bench_layer.width, bench_layer.height, bench_layer.format, buffer_fd, ++id, layer);
+    layer->input_buffer.flags.video = (bench_layer.format == sdm::kFormatYCbCr420SemiPlanarVenus);
+    layer->dst_rect = {bench_layer.dst.left * width / 1000, bench_layer.dst.top * height / 1000,
+                       bench_layer.dst.right * width / 1000,
+                       bench_layer.dst.bottom * height / 1000};
+    layer->frame_rate = 60;
+  }
+
+
+  vector<Sample> samples;
+  shared_ptr<Fence> retire_fence = nullptr;
+  int failures = 0;
+  fake_kms::Stats start = {};
+  fake_kms::GetStats(&start);
+
+  for (int frame = 0; frame < frames; frame++) {
+    // Frames are paced by the display like SurfaceFlinger paces them on the retire fence.
+    Fence::Wait(retire_fence, fake_kms::kHostFenceTimeoutMs);
+
+    LayerStack stack;
+    for (auto &layer : layers) {
+      stack.layers.push_back(&layer);
+    }
+    stack.layers.push_back(target);
+    for (auto layer : stack.layers) {
+      layer->composition = sdm::kCompositionGPU;
+      layer->flags = {};
+      layer->flags.updating = true;
+      layer->visible_regions = {layer->dst_rect};
+      layer->dirty_regions = {layer->dst_rect};
+      layer->input_buffer.acquire_fence = nullptr;
+      layer->input_buffer.release_fence = nullptr;
+    }
+    target->composition = sdm::kCompositionGPUTarget;
+    stack.flags.geometry_changed = (frame == 0);
+
+    Sample sample = {};
+    uint64_t ioctls = Ioctls();
+    int64_t start_ns = ThreadCpuNs();
+    DisplayError error = display->Prepare(&stack);
+    sample.prepare_ns = ThreadCpuNs() - start_ns;
+
+    start_ns = ThreadCpuNs();
+    if (error == kErrorNone) {
+      error = display->Commit(&stack);
+    }
+    sample.commit_ns = ThreadCpuNs() - start_ns;
+    sample.ioctls = Ioctls() - ioctls;
+    failures += (error != kErrorNone);
+    retire_fence = stack.retire_fence;
+    samples.push_back(sample);
+  }
+  Fence::Wait(retire_fence, fake_kms::kHostFenceTimeoutMs);
+
+  fake_kms::Stats end = {};
+  fake_kms::GetStats(&end);
+  close(buffer_fd);
+
+  vector<int64_t> prepare, commit, total;
+  uint64_t ioctls = 0;
+  for (auto &sample : samples) {
+    prepare.push_back(sample.prepare_ns);
+    commit.push_back(sample.commit_ns);
+    total.push_back(sample.prepare_ns + sample.commit_ns);
+    ioctls += sample.ioctls;
+  }
+
+  double count = static_cast<double>(std::max<size_t>(samples.size(), 1));
+  printf("%-12s %6zu %7" PRId64 " %7" PRId64 " %7" PRId64 " %7" PRId64 " %7" PRId64 " %8.1f %8.1f"
+         " %6d\n", mix.name, mix.layers.size(), Percentile(prepare, 50) / 1000,
+         Percentile(commit, 50) / 1000, Percentile(total, 50) / 1000, Percentile(total, 90) / 1000,
+         Percentile(total, 99) / 1000, static_cast<double>(ioctls) / count,
+         static_cast<double>(end.atomic_properties - start.atomic_properties) / count, failures);
+  return failures ? -1 : 0;
+}
+
+static void Usage(const char *name) {
+  fprintf(stderr, "usage: %s [-f frames] [-v vblank_us] [-m mix]\n"
+                  "mixes: fullscreen ui video all_pipes\n", name);
+}
+
+int main(int argc, char **argv) {
+  int frames = kDefaultFrames;
+  int64_t vblank_us = 0;
+  string only_mix;
+  int opt;
+  while ((opt = getopt(argc, argv, "f:v:m:h")) != -1) {
+    switch (opt) {
+      case 'f': frames = atoi(optarg); break;
+      case 'v': vblank_us = atoll(optarg); break;
+      case 'm': only_mix = optarg; break;
+      default: Usage(argv[0]); return 2;
+    }
+  }
+
+  fake_kms::Config config = fake_kms::DefaultConfig();
+  config.vblank_period_ns = vblank_us * 1000;
+  fake_kms::Configure(config);
+
+  fake_kms::HostBufferAllocator buffer_allocator;
+  fake_kms::HostSyncHandler sync_handler;
+  fake_kms::HostSocketHandler socket_handler;
+  fake_kms::HostEventHandler event_handler;
+  CoreInterface *core = nullptr;
+  DisplayInterface *display = nullptr;
+  if (CoreInterface::CreateCore(&buffer_allocator, &sync_handler, &socket_handler, &core) ||
+      core->CreateDisplay(sdm::kBuiltIn, &event_handler, &display)) {
+    fprintf(stderr, "Failed to create the core or the built-in display on the fake device\n");
+    return 1;
+  }
+
+  shared_ptr<Fence> release_fence = nullptr;
+  uint32_t index = 0;
+  DisplayConfigVariableInfo mode = {};
+  if (display->SetDisplayState(sdm::kStateOn, false /* teardown */, &release_fence) ||
+      display->GetActiveConfig(&index) || display->GetConfig(index, &mode)) {
+    fprintf(stderr, "Failed to power on the built-in display\n");
+    return 1;
+  }
+
+  printf("%ux%u@%u, %d frames per mix, times in us of thread CPU\n", mode.x_pixels,
+         mode.y_pixels, mode.fps, frames);
+  printf("%-12s %6s %7s %7s %7s %7s %7s %8s %8s %6s\n", "mix", "layers", "prep50", "commit50",
+         "frame50", "frame90", "frame99", "ioctls", "props", "failed");
+
+  // The GPU target goes last and covers the display, as the composer adds it. Like the client
+  // target of the composer it outlives the layer mixes, so that its framebuffer, which is on
+  // screen when a mix ends, is not removed under the display.
+  int target_fd = open("/dev/zero", O_RDONLY | O_CLOEXEC);
+  Layer target;
+  SetBuffer(mode.x_pixels, mode.y_pixels, sdm::kFormatRGBA8888, target_fd, kTargetBufferId,
+            &target);
+  target.dst_rect = {0.0f, 0.0f, static_cast<float>(mode.x_pixels),
+                     static_cast<float>(mode.y_pixels)};
+  target.frame_rate = 60;
+
+  int status = 0;
+  for (auto &mix : GetLayerMixes(mode.x_pixels, mode.y_pixels)) {
+    if (only_mix.empty() || only_mix == mix.name) {
+      status |= RunMix(mix, display, mode.x_pixels, mode.y_pixels, &target, frames);
+    }
+  }
+
+  if (display->SetDisplayState(sdm::kStateOff, false /* teardown */, &release_fence)) {
+    fprintf(stderr, "Failed to power off the built-in display\n");
+    status = -1;
+  }
+  target.buffer_map = nullptr;
+  close(target_fd);
+  core->DestroyDisplay(display);
+  CoreInterface::DestroyCore();
+
+  return status ? 1 : 0;
+}
@@ -0,0 +1,158 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __SDM_CORE_HOST_H__
+#define __SDM_CORE_HOST_H__
+
+#include <core/buffer_allocator.h>
+#include <core/buffer_sync_handler.h>
+#include <core/display_interface.h>
+#include <core/socket_handler.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sync_file.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <utils/fence.h>
+#include <sstream>
+
+// Stand-ins for the buffer allocator, sync handler, socket handler and event handler that the
+// composer gives the SDM core, for the tools that run libsdmcore on libfakekms.
+namespace fake_kms {
+
+using sdm::AllocatedBufferInfo;
+using sdm::BufferConfig;
+using sdm::BufferInfo;
+using sdm::DisplayError;
+using sdm::DisplayEvent;
+using sdm::DisplayEventVSync;
+using sdm::Fence;
+using sdm::kErrorNone;
+
+static const int kHostFenceTimeoutMs = 1000;
+
+// Buffers are only ever scanned out by the fake, so any open fd stands in for the dma-buf.
+class HostBufferAllocator : public sdm::BufferAllocator {
+ public:
+  DisplayError AllocateBuffer(BufferInfo *buffer_info) {
+    AllocatedBufferInfo *alloc = &buffer_info->alloc_buffer_info;
+    GetAllocatedBufferInfo(buffer_info->buffer_config, alloc);
+    alloc->fd = open("/dev/zero", O_RDONLY | O_CLOEXEC);
+    alloc->id = ++next_id_;
+    return (alloc->fd < 0) ? sdm::kErrorMemory : kErrorNone;
+  }
+
+  DisplayError FreeBuffer(BufferInfo *buffer_info) {
+    if (buffer_info->alloc_buffer_info.fd >= 0) {
+      close(buffer_info->alloc_buffer_info.fd);
+      buffer_info->alloc_buffer_info.fd = -1;
+    }
+    return kErrorNone;
+  }
+
+  uint32_t GetBufferSize(BufferInfo *buffer_info) {
+    AllocatedBufferInfo alloc = {};
+    GetAllocatedBufferInfo(buffer_info->buffer_config, &alloc);
+    return alloc.size;
+  }
+
+  DisplayError GetAllocatedBufferInfo(const BufferConfig &buffer_config,
+                                      AllocatedBufferInfo *allocated_buffer_info) {
+    allocated_buffer_info->aligned_width = buffer_config.width;
+    allocated_buffer_info->aligned_height = buffer_config.height;
+    allocated_buffer_info->stride = buffer_config.width * 4;
+    allocated_buffer_info->size = allocated_buffer_info->stride * buffer_config.height;
+    allocated_buffer_info->format = buffer_config.format;
+    return kErrorNone;
+  }
+
+ private:
+  uint64_t next_id_ = 0;
+};
+
+// libfakekms hands out sw_sync fences where the kernel allows it and eventfds otherwise. Both poll
+// readable once signaled; only the former can be merged by the kernel, for the latter a merge waits
+// for the first fence, which has always signaled by then on the single timeline of a CRTC.
+class HostSyncHandler : public sdm::BufferSyncHandler {
+ public:
+  HostSyncHandler() { Fence::Set(this); }
+
+  DisplayError SyncWait(int fd) { return SyncWait(fd, -1); }
+
+  DisplayError SyncWait(int fd, int timeout) {
+    if (fd < 0) {
+      return kErrorNone;
+    }
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ret = 0;
+    while ((ret = poll(&pfd, 1, timeout)) < 0 && errno == EINTR) { }
+    return (ret == 1) ? kErrorNone : sdm::kErrorTimeOut;
+  }
+
+  DisplayError SyncMerge(int fd1, int fd2, int *merged_fd) {
+    if (fd1 < 0 || fd2 < 0) {
+      *merged_fd = dup((fd1 < 0) ? fd2 : fd1);
+      return kErrorNone;
+    }
+    struct sync_merge_data data = {};
+    data.fd2 = fd2;
+    snprintf(data.name, sizeof(data.name), "sdm_core_host");
+    if (ioctl(fd1, SYNC_IOC_MERGE, &data) == 0) {
+      *merged_fd = data.fence;
+      return kErrorNone;
+    }
+    SyncWait(fd1, kHostFenceTimeoutMs);
+    *merged_fd = dup(fd2);
+    return kErrorNone;
+  }
+
+  bool IsSyncSignaled(int fd) { return SyncWait(fd, 0) == kErrorNone; }
+
+  void GetSyncInfo(int fd, std::ostringstream *os) { *os << "fd " << fd; }
+};
+
+class HostSocketHandler : public sdm::SocketHandler {
+ public:
+  int GetSocketFd(sdm::SocketType socket_type) { return -1; }
+};
+
+class HostEventHandler : public sdm::DisplayEventHandler {
+ public:
+  DisplayError VSync(const DisplayEventVSync &vsync) { return kErrorNone; }
+  DisplayError Refresh() { return kErrorNone; }
+  DisplayError CECMessage(char *message) { return kErrorNone; }
+  DisplayError HistogramEvent(int source_fd, uint32_t blob_id) { return kErrorNone; }
+  DisplayError HandleEvent(DisplayEvent event) { return kErrorNone; }
+};
+
+}  // namespace fake_kms
+
+#endif  // __SDM_CORE_HOST_H__
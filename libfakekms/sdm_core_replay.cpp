@@ -0,0 +1,336 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Replays a layer trace recorded by the composer through the SDM core on libfakekms and writes the
+// decisions taken for each frame, strategy, pipes, ROI and fallback to the GPU, as a trace of its
+// own. Two replays of one recording, e.g. before and after a change to the core, are compared with
+// "layer_trace_tool diff".
+//
+// The core is driven through DisplayInterface with the recorded layer stacks, not through the
+// composer, which needs the Android services. Buffers are stand-ins with the recorded geometry and
+// format, their contents are not replayed. Pipe ids are the plane ids of the fake device, so a
+// replay compares with other replays, not with the recording. Without the strategy extension
+// library every app layer is GPU composed.
+
+#include <core/core_interface.h>
+#include <core/display_interface.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <utils/fence.h>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "fake_kms.h"
+#include "layer_trace.h"
+#include "sdm_core_host.h"
+
+using layer_trace::Frame;
+using layer_trace::LayerRecord;
+using layer_trace::RectRecord;
+using sdm::CoreInterface;
+using sdm::DisplayError;
+using sdm::DisplayFrameLayout;
+using sdm::DisplayInterface;
+using sdm::Fence;
+using sdm::Layer;
+using sdm::LayerComposition;
+using sdm::LayerRect;
+using sdm::LayerStack;
+using sdm::kErrorNone;
+using std::shared_ptr;
+
+static const int64_t kDefaultVBlankUs = 1000;
+static const uint64_t kNoHandleId = 1ULL << 63;  // Layers recorded without a buffer count up here
+
+struct ReplayStats {
+  uint32_t frames = 0;
+  uint32_t validated = 0;
+  uint32_t failed = 0;
+  uint32_t fallback_layers = 0;
+  uint32_t sde_layers = 0;
+  uint32_t gpu_layers = 0;
+};
+
+static LayerRect ToLayerRect(const RectRecord &rect) {
+  return LayerRect(rect.left, rect.top, rect.right, rect.bottom);
+}
+
+static RectRecord ToRectRecord(const LayerRect &rect) {
+  return {rect.left, rect.top, rect.right, rect.bottom};
+}
+
+static bool IsTarget(uint32_t composition) {
+  return composition == sdm::kCompositionGPUTarget ||
+         composition == sdm::kCompositionStitchTarget;
+}
+
+// Sets up the layer the way the composer would have handed it to SDM for the recorded frame.
+// Compositions are only reset for a frame that goes through Prepare(), a frame that skipped
+// validation commits with the decisions of the last validated one, as it did on the device.
+static void SetLayer(const LayerRecord &record, size_t index, int buffer_fd, bool validate,
+                     Layer *layer) {
+  sdm::LayerBuffer *buffer = &layer->input_buffer;
+  buffer->width = buffer->unaligned_width = record.width;
+  buffer->height = buffer->unaligned_height = record.height;
+  buffer->format = static_cast<sdm::LayerBufferFormat>(record.format);
+  buffer->flags.flags = record.buffer_flags;
+  buffer->color_metadata.colorPrimaries = static_cast<ColorPrimaries>(record.primaries);
+  buffer->color_metadata.transfer = static_cast<GammaTransfer>(record.transfer);
+  buffer->color_metadata.range = static_cast<ColorRange>(record.range);
+  buffer->planes[0].fd = buffer_fd;
+  buffer->planes[0].stride = record.width * 4;
+  buffer->size = record.width * record.height * 4;
+  // The framebuffers of the fake are cached per handle id, an id of 0 would drop them each frame.
+  buffer->buffer_id = record.buffer_id ? record.buffer_id : (kNoHandleId + index);
+  buffer->handle_id = buffer->buffer_id;
+  buffer->acquire_fence = nullptr;
+  buffer->release_fence = nullptr;
+
+  layer->flags.flags = record.layer_flags;
+  layer->blending = static_cast<sdm::LayerBlending>(record.blending);
+  layer->transform.flip_horizontal = (record.transform & 1);
+  layer->transform.flip_vertical = (record.transform & 2);
+  layer->transform.rotation = static_cast<float>(record.transform >> 16);
+  layer->plane_alpha = static_cast<uint8_t>(record.plane_alpha);
+  layer->frame_rate = record.frame_rate;
+  layer->solid_fill_color = record.solid_fill_color;
+  layer->src_rect = ToLayerRect(record.src_rect);
+  layer->dst_rect = ToLayerRect(record.dst_rect);
+  layer->visible_regions = {layer->dst_rect};
+  // Damage beyond the rects kept by the recorder is unknown, the whole layer counts as dirty then.
+  layer->dirty_regions.clear();
+  if (record.damage_count > layer_trace::kMaxDamageRects) {
+    layer->dirty_regions.push_back(layer->dst_rect);
+  } else {
+    for (uint32_t i = 0; i < record.damage_count; i++) {
+      layer->dirty_regions.push_back(ToLayerRect(record.damage[i]));
+    }
+  }
+
+  if (validate) {
+    layer->composition = IsTarget(record.composition) ?
+                         static_cast<LayerComposition>(record.composition) : sdm::kCompositionGPU;
+    layer->request.flags = {};
+  }
+}
+
+// Copies the decisions SDM took for the stack into the replayed frame.
+static void RecordDecisions(DisplayInterface *display, const LayerStack &stack, bool validated,
+                            Frame *frame) {
+  frame->header.validated = validated;
+  frame->header.blend_primaries = static_cast<uint32_t>(stack.blend_cs.primaries);
+  frame->header.blend_transfer = static_cast<uint32_t>(stack.blend_cs.transfer);
+  for (size_t i = 0; i < frame->layers.size(); i++) {
+    frame->layers.at(i).composition = static_cast<uint32_t>(stack.layers.at(i)->composition);
+    frame->layers.at(i).request_flags = stack.layers.at(i)->request.flags.request_flags;
+  }
+
+  frame->pipes.clear();
+  frame->roi.clear();
+  DisplayFrameLayout layout = {};
+  if (display->GetFrameLayout(&layout) != kErrorNone) {
+    return;
+  }
+
+  frame->header.gpu_target_index = layout.gpu_target_index;
+  frame->header.fast_path = layout.fast_path;
+  for (auto &pipe : layout.pipes) {
+    frame->pipes.push_back({pipe.layer_index, pipe.left_pipe_id, pipe.right_pipe_id, 0});
+  }
+  for (auto *roi : {&layout.left_roi, &layout.right_roi}) {
+    for (auto &rect : *roi) {
+      if (frame->roi.size() < layer_trace::kMaxTraceRects) {
+        frame->roi.push_back(ToRectRecord(rect));
+      }
+    }
+  }
+}
+
+static void CountDecisions(const Frame &frame, ReplayStats *stats) {
+  stats->frames++;
+  stats->validated += frame.header.validated;
+  stats->fallback_layers += layer_trace::CountFallbackLayers(frame);
+  for (auto &record : frame.layers) {
+    if (record.composition == sdm::kCompositionSDE ||
+        record.composition == sdm::kCompositionCursor) {
+      stats->sde_layers++;
+    } else if (record.composition == sdm::kCompositionGPU) {
+      stats->gpu_layers++;
+    }
+  }
+}
+
+static void Usage(const char *name) {
+  fprintf(stderr, "usage: %s [-p] [-v vblank_us] <recorded trace> <replayed trace>\n"
+                  "  -p  print the decisions of each replayed frame\n", name);
+}
+
+int main(int argc, char **argv) {
+  int64_t vblank_us = kDefaultVBlankUs;
+  bool print = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "pv:h")) != -1) {
+    switch (opt) {
+      case 'p': print = true; break;
+      case 'v': vblank_us = atoll(optarg); break;
+      default: Usage(argv[0]); return 2;
+    }
+  }
+  if (argc - optind != 2) {
+    Usage(argv[0]);
+    return 2;
+  }
+  const char *in_path = argv[optind];
+  const char *out_path = argv[optind + 1];
+
+  layer_trace::Reader reader;
+  layer_trace::Writer writer;
+  Frame frame;
+  int ret = reader.Open(in_path);
+  if (ret == 0) {
+    ret = reader.Next(&frame);
+    ret = (ret == 0) ? -ENODATA : ((ret < 0) ? ret : 0);
+  }
+  if (ret) {
+    fprintf(stderr, "%s: cannot read trace: %s\n", in_path, strerror(-ret));
+    return 2;
+  }
+  ret = writer.Open(out_path);
+  if (ret) {
+    fprintf(stderr, "%s: cannot write trace: %s\n", out_path, strerror(-ret));
+    return 2;
+  }
+
+  // The panel takes the size of the client target of the first frame, which covers the display.
+  fake_kms::Config config = fake_kms::DefaultConfig();
+  for (auto &record : frame.layers) {
+    if (IsTarget(record.composition)) {
+      config.connectors.at(0).width = static_cast<uint32_t>(record.dst_rect.right);
+      config.connectors.at(0).height = static_cast<uint32_t>(record.dst_rect.bottom);
+      break;
+    }
+  }
+  config.vblank_period_ns = vblank_us * 1000;
+  fake_kms::Configure(config);
+
+  fake_kms::HostBufferAllocator buffer_allocator;
+  fake_kms::HostSyncHandler sync_handler;
+  fake_kms::HostSocketHandler socket_handler;
+  fake_kms::HostEventHandler event_handler;
+  CoreInterface *core = nullptr;
+  DisplayInterface *display = nullptr;
+  if (CoreInterface::CreateCore(&buffer_allocator, &sync_handler, &socket_handler, &core) ||
+      core->CreateDisplay(sdm::kBuiltIn, &event_handler, &display)) {
+    fprintf(stderr, "Failed to create the core or the built-in display on the fake device\n");
+    return 1;
+  }
+
+  shared_ptr<Fence> release_fence = nullptr;
+  if (display->SetDisplayState(sdm::kStateOn, false /* teardown */, &release_fence)) {
+    fprintf(stderr, "Failed to power on the built-in display\n");
+    return 1;
+  }
+
+  // Layers are kept by their index in the stack and never freed during the replay, so that the
+  // framebuffer of a layer is not removed while the display still scans it out.
+  int buffer_fd = open("/dev/zero", O_RDONLY | O_CLOEXEC);
+  std::deque<Layer> layers;
+  shared_ptr<Fence> retire_fence = nullptr;
+  ReplayStats stats;
+  do {
+    // Frames are paced by the display like SurfaceFlinger paces them on the retire fence.
+    Fence::Wait(retire_fence, fake_kms::kHostFenceTimeoutMs);
+
+    bool validate = frame.header.validated || frame.layers.size() != layers.size();
+    while (layers.size() < frame.layers.size()) {
+      layers.emplace_back();
+    }
+    LayerStack stack;
+    for (size_t i = 0; i < frame.layers.size(); i++) {
+      SetLayer(frame.layers.at(i), i, buffer_fd, validate, &layers.at(i));
+      stack.layers.push_back(&layers.at(i));
+    }
+    stack.flags.flags = frame.header.stack_flags;
+
+    // A frame the composer committed without validation is committed the same way, the core
+    // rejects it if it needs a validation after all, as it would have on the device.
+    DisplayError error = validate ? display->Prepare(&stack) : display->Commit(&stack);
+    if (!validate && error == sdm::kErrorNotValidated) {
+      validate = true;
+      error = display->Prepare(&stack);
+    }
+    if (validate && error == kErrorNone) {
+      error = display->Commit(&stack);
+    }
+    if (error != kErrorNone) {
+      stats.failed++;
+    }
+    retire_fence = stack.retire_fence;
+
+    RecordDecisions(display, stack, validate, &frame);
+    CountDecisions(frame, &stats);
+    if (print) {
+      printf("%s", layer_trace::FormatFrame(frame).c_str());
+    }
+    ret = writer.Write(frame);
+    if (ret) {
+      fprintf(stderr, "%s: cannot write trace: %s\n", out_path, strerror(-ret));
+      break;
+    }
+    ret = reader.Next(&frame);
+    if (ret < 0) {
+      fprintf(stderr, "%s: corrupt frame record after frame %u: %s\n", in_path, stats.frames,
+              strerror(-ret));
+    }
+  } while (ret > 0);
+  Fence::Wait(retire_fence, fake_kms::kHostFenceTimeoutMs);
+  writer.Close();
+
+  printf("%u frames, %u validated, %u failed; layers: %u SDE, %u GPU, %u fell back to the GPU\n",
+         stats.frames, stats.validated, stats.failed, stats.sde_layers, stats.gpu_layers,
+         stats.fallback_layers);
+
+  if (display->SetDisplayState(sdm::kStateOff, false /* teardown */, &release_fence)) {
+    fprintf(stderr, "Failed to power off the built-in display\n");
+    ret = -1;
+  }
+  layers.clear();
+  close(buffer_fd);
+  core->DestroyDisplay(display);
+  CoreInterface::DestroyCore();
+
+  return (ret < 0 || stats.failed) ? 1 : 0;
+}
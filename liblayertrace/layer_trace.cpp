@@ -0,0 +1,342 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <string.h>
+#include <utils/hash.h>
+#include <string>
+#include <vector>
+
+#include "layer_trace.h"
+
+namespace layer_trace {
+
+// HWC2 composition requested by the client for a layer.
+static const uint32_t kClientCompositionClient = 1;
+
+// Indexed by LayerComposition.
+static const char *kCompositionNames[] = {
+  "GPU", "Stitch", "SDE", "Cursor", "None", "GPUTarget", "StitchTarget",
+};
+
+static const char *CompositionName(uint32_t composition) {
+  if (composition < sizeof(kCompositionNames) / sizeof(kCompositionNames[0])) {
+    return kCompositionNames[composition];
+  }
+
+  return "Unknown";
+}
+
+static bool IsGPUComposition(uint32_t composition) {
+  return composition == 0 /* kCompositionGPU */ || composition == 1 /* kCompositionStitch */;
+}
+
+static bool SameRect(const RectRecord &a, const RectRecord &b) {
+  return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+static std::string FormatRect(const RectRecord &rect) {
+  char buf[96];
+  snprintf(buf, sizeof(buf), "[%.0f %.0f %.0f %.0f]", rect.left, rect.top, rect.right,
+           rect.bottom);
+  return buf;
+}
+
+static std::string Format(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static std::string Format(const char *format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  return buf;
+}
+
+int Writer::Open(const std::string &path) {
+  Close();
+
+  file_ = fopen(path.c_str(), "wbe");
+  if (!file_) {
+    return -errno;
+  }
+
+  FileHeader header = {};
+  header.magic = kTraceMagic;
+  header.version_major = kTraceVersionMajor;
+  header.version_minor = kTraceVersionMinor;
+  header.header_size = sizeof(FileHeader);
+  if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+    Close();
+    return -EIO;
+  }
+
+  return 0;
+}
+
+void Writer::Close() {
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+int Writer::Write(const Frame &frame) {
+  if (!file_) {
+    return -EBADF;
+  }
+
+  FrameHeader header = frame.header;
+  header.layer_count = static_cast<uint32_t>(frame.layers.size());
+  header.pipe_count = static_cast<uint32_t>(frame.pipes.size());
+  header.roi_count = static_cast<uint32_t>(frame.roi.size());
+  header.size = static_cast<uint32_t>(sizeof(FrameHeader) +
+                                      (header.layer_count * sizeof(LayerRecord)) +
+                                      (header.pipe_count * sizeof(PipeRecord)) +
+                                      (header.roi_count * sizeof(RectRecord)));
+
+  bool ok = fwrite(&header, sizeof(header), 1, file_) == 1;
+  ok = ok && fwrite(frame.layers.data(), sizeof(LayerRecord), frame.layers.size(), file_) ==
+             frame.layers.size();
+  ok = ok && fwrite(frame.pipes.data(), sizeof(PipeRecord), frame.pipes.size(), file_) ==
+             frame.pipes.size();
+  ok = ok && fwrite(frame.roi.data(), sizeof(RectRecord), frame.roi.size(), file_) ==
+             frame.roi.size();
+
+  return ok ? 0 : -EIO;
+}
+
+void Writer::Flush() {
+  if (file_) {
+    fflush(file_);
+  }
+}
+
+int Reader::Open(const std::string &path) {
+  Close();
+
+  file_ = fopen(path.c_str(), "rbe");
+  if (!file_) {
+    return -errno;
+  }
+
+  FileHeader header = {};
+  if (fread(&header, sizeof(header), 1, file_) != 1 || header.magic != kTraceMagic ||
+      header.version_major != kTraceVersionMajor || header.header_size < sizeof(FileHeader) ||
+      fseek(file_, static_cast<long>(header.header_size), SEEK_SET)) {
+    Close();
+    return -EPROTO;
+  }
+
+  return 0;
+}
+
+void Reader::Close() {
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+template <class T>
+static bool ReadRecords(FILE *file, uint32_t count, std::vector<T> *records) {
+  records->resize(count);
+  return fread(records->data(), sizeof(T), count, file) == count;
+}
+
+int Reader::Next(Frame *frame) {
+  if (!file_) {
+    return -EBADF;
+  }
+
+  FrameHeader header = {};
+  size_t read = fread(&header, sizeof(header), 1, file_);
+  if (read != 1) {
+    return feof(file_) ? 0 : -EIO;
+  }
+
+  uint64_t body = (uint64_t(header.layer_count) * sizeof(LayerRecord)) +
+                  (uint64_t(header.pipe_count) * sizeof(PipeRecord)) +
+                  (uint64_t(header.roi_count) * sizeof(RectRecord));
+  if (header.layer_count > kMaxTraceLayers || header.pipe_count > kMaxTraceLayers ||
+      header.roi_count > kMaxTraceRects || header.size < sizeof(FrameHeader) + body) {
+    return -EPROTO;
+  }
+
+  frame->header = header;
+  if (!ReadRecords(file_, header.layer_count, &frame->layers) ||
+      !ReadRecords(file_, header.pipe_count, &frame->pipes) ||
+      !ReadRecords(file_, header.roi_count, &frame->roi)) {
+    return -EPROTO;
+  }
+
+  // Skip fields appended by a newer minor version.
+  uint64_t extra = header.size - sizeof(FrameHeader) - body;
+  if (extra && fseek(file_, static_cast<long>(extra), SEEK_CUR)) {
+    return -EPROTO;
+  }
+
+  return 1;
+}
+
+uint32_t Checksum(const void *data, size_t size) {
+  // Folded to the 32 bits kept per layer record.
+  uint64_t hash = sdm::HashBytes(data, size);
+
+  return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+uint32_t CountFallbackLayers(const Frame &frame) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < frame.layers.size(); i++) {
+    const LayerRecord &layer = frame.layers[i];
+    if (i != frame.header.gpu_target_index &&
+        layer.client_composition != kClientCompositionClient &&
+        IsGPUComposition(layer.composition)) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+static bool SameInput(const LayerRecord &a, const LayerRecord &b) {
+  return a.format == b.format && a.width == b.width && a.height == b.height &&
+         a.layer_flags == b.layer_flags && a.client_composition == b.client_composition &&
+         a.blending == b.blending && a.transform == b.transform &&
+         a.plane_alpha == b.plane_alpha && SameRect(a.src_rect, b.src_rect) &&
+         SameRect(a.dst_rect, b.dst_rect) && (!a.checksum || !b.checksum ||
+                                              a.checksum == b.checksum);
+}
+
+std::vector<std::string> DiffFrames(const Frame &a, const Frame &b) {
+  std::vector<std::string> diffs;
+
+  if (a.layers.size() != b.layers.size()) {
+    diffs.push_back(Format("input: layer count %zu vs %zu", a.layers.size(), b.layers.size()));
+    return diffs;
+  }
+
+  for (size_t i = 0; i < a.layers.size(); i++) {
+    if (!SameInput(a.layers[i], b.layers[i])) {
+      diffs.push_back(Format("input: layer %zu differs", i));
+    }
+  }
+  if (!diffs.empty()) {
+    return diffs;
+  }
+
+  if (a.header.gpu_target_index != b.header.gpu_target_index) {
+    diffs.push_back(Format("client target index %u vs %u", a.header.gpu_target_index,
+                           b.header.gpu_target_index));
+  }
+
+  for (size_t i = 0; i < a.layers.size(); i++) {
+    const LayerRecord &la = a.layers[i];
+    const LayerRecord &lb = b.layers[i];
+    if (la.composition != lb.composition) {
+      diffs.push_back(Format("layer %zu: composition %s vs %s", i, CompositionName(la.composition),
+                             CompositionName(lb.composition)));
+    }
+    if (la.request_flags != lb.request_flags) {
+      diffs.push_back(Format("layer %zu: request flags 0x%x vs 0x%x", i, la.request_flags,
+                             lb.request_flags));
+    }
+  }
+
+  uint32_t fallback_a = CountFallbackLayers(a);
+  uint32_t fallback_b = CountFallbackLayers(b);
+  if (fallback_a != fallback_b) {
+    diffs.push_back(Format("fallback layers %u vs %u", fallback_a, fallback_b));
+  }
+
+  if (a.pipes.size() != b.pipes.size()) {
+    diffs.push_back(Format("pipes: %zu vs %zu", a.pipes.size(), b.pipes.size()));
+  } else {
+    for (size_t i = 0; i < a.pipes.size(); i++) {
+      const PipeRecord &pa = a.pipes[i];
+      const PipeRecord &pb = b.pipes[i];
+      if (pa.layer_index != pb.layer_index || pa.left_pipe_id != pb.left_pipe_id ||
+          pa.right_pipe_id != pb.right_pipe_id) {
+        diffs.push_back(Format("pipe %zu: layer %u pipes %u/%u vs layer %u pipes %u/%u", i,
+                               pa.layer_index, pa.left_pipe_id, pa.right_pipe_id, pb.layer_index,
+                               pb.left_pipe_id, pb.right_pipe_id));
+      }
+    }
+  }
+
+  bool same_roi = a.roi.size() == b.roi.size();
+  for (size_t i = 0; same_roi && i < a.roi.size(); i++) {
+    same_roi = SameRect(a.roi[i], b.roi[i]);
+  }
+  if (!same_roi) {
+    std::string roi_a, roi_b;
+    for (auto &rect : a.roi) {
+      roi_a += FormatRect(rect);
+    }
+    for (auto &rect : b.roi) {
+      roi_b += FormatRect(rect);
+    }
+    diffs.push_back("roi: " + roi_a + " vs " + roi_b);
+  }
+
+  return diffs;
+}
+
+std::string FormatFrame(const Frame &frame) {
+  const FrameHeader &header = frame.header;
+  std::string out = Format("frame %" PRIu64 " display %d %s%s layers %u fallback %u\n",
+                           header.frame_number, header.display_id,
+                           header.validated ? "validated" : "skip-validate",
+                           header.fast_path ? " fast-path" : "", header.layer_count,
+                           CountFallbackLayers(frame));
+
+  for (size_t i = 0; i < frame.layers.size(); i++) {
+    const LayerRecord &layer = frame.layers[i];
+    out += Format("  layer %zu: %-12s fmt %u %ux%u src %s dst %s damage %u req 0x%x%s\n", i,
+                  CompositionName(layer.composition), layer.format, layer.width, layer.height,
+                  FormatRect(layer.src_rect).c_str(), FormatRect(layer.dst_rect).c_str(),
+                  layer.damage_count, layer.request_flags,
+                  (i == header.gpu_target_index) ? " (client target)" : "");
+  }
+
+  for (auto &pipe : frame.pipes) {
+    out += Format("  pipe: layer %u left %u right %u\n", pipe.layer_index, pipe.left_pipe_id,
+                  pipe.right_pipe_id);
+  }
+
+  for (auto &rect : frame.roi) {
+    out += "  roi: " + FormatRect(rect) + "\n";
+  }
+
+  return out;
+}
+
+}  // namespace layer_trace
@@ -0,0 +1,96 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __LAYER_TRACE_H__
+#define __LAYER_TRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "layer_trace_format.h"
+
+// Traces are compared run against run with layer_trace_tool. sdm_core_replay in libfakekms replays
+// a recorded trace through the SDM core on the host and records the decisions it takes.
+namespace layer_trace {
+
+struct Frame {
+  FrameHeader header = {};
+  std::vector<LayerRecord> layers;
+  std::vector<PipeRecord> pipes;
+  std::vector<RectRecord> roi;
+};
+
+// Appends frames to a trace file. Writes are buffered by stdio; Flush() is only needed to read the
+// trace while it is still being written.
+class Writer {
+ public:
+  ~Writer() { Close(); }
+  // Returns 0 or a negative errno.
+  int Open(const std::string &path);
+  void Close();
+  int Write(const Frame &frame);
+  void Flush();
+  bool IsOpen() const { return file_ != nullptr; }
+
+ private:
+  FILE *file_ = nullptr;
+};
+
+class Reader {
+ public:
+  ~Reader() { Close(); }
+  // Returns 0 or a negative errno, -EPROTO for a file that is not a readable trace.
+  int Open(const std::string &path);
+  void Close();
+  // Returns 1 for a frame, 0 at the end of the trace and a negative errno on a corrupt record.
+  int Next(Frame *frame);
+
+ private:
+  FILE *file_ = nullptr;
+};
+
+uint32_t Checksum(const void *data, size_t size);
+
+// Compares the SDM decisions of two frames recorded from the same content: compositions, layer
+// requests, pipes, ROI and fallback to the client target. Differing inputs are reported as such,
+// as decisions are not comparable then. Returns one line per difference.
+std::vector<std::string> DiffFrames(const Frame &a, const Frame &b);
+
+// Human readable dump of a frame and the decisions taken for it.
+std::string FormatFrame(const Frame &frame);
+
+// Number of layers the client asked the device to compose that SDM sent to the GPU instead.
+uint32_t CountFallbackLayers(const Frame &frame);
+
+}  // namespace layer_trace
+
+#endif  // __LAYER_TRACE_H__
@@ -0,0 +1,120 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __LAYER_TRACE_FORMAT_H__
+#define __LAYER_TRACE_FORMAT_H__
+
+#include <stdint.h>
+
+// On-disk layout of a layer trace, one file per display. All fields are little endian.
+//
+//   FileHeader
+//   frame record 0: FrameHeader, LayerRecord[layer_count], PipeRecord[pipe_count],
+//                   RectRecord[roi_count]
+//   frame record 1: ...
+//
+// FrameHeader::size covers the whole record, so a reader can step over records written by a
+// newer minor version that appends fields. A major version change is not readable.
+
+namespace layer_trace {
+
+const uint32_t kTraceMagic = 0x544d4453;  // "SDMT"
+const uint16_t kTraceVersionMajor = 1;
+const uint16_t kTraceVersionMinor = 0;
+const uint32_t kMaxDamageRects = 4;
+const uint32_t kMaxTraceLayers = 256;
+const uint32_t kMaxTraceRects = 64;
+
+struct FileHeader {
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  uint32_t header_size;  // sizeof(FileHeader) of the writer
+  uint32_t reserved;
+};
+
+struct RectRecord {
+  float left;
+  float top;
+  float right;
+  float bottom;
+};
+
+struct FrameHeader {
+  uint32_t size;              // Bytes in this frame record, header included
+  int32_t display_id;
+  uint64_t frame_number;      // Commit count on this display
+  int64_t timestamp_ns;       // CLOCK_MONOTONIC at commit
+  uint32_t stack_flags;       // LayerStackFlags
+  uint32_t layer_count;
+  uint32_t pipe_count;
+  uint32_t roi_count;
+  uint32_t gpu_target_index;  // Index of the client target in the layer records
+  uint32_t blend_primaries;   // Blend color space chosen by SDM
+  uint32_t blend_transfer;
+  uint32_t validated;         // 1 if this frame went through SDM Prepare, 0 if it reused the last
+  uint32_t fast_path;
+  uint32_t reserved;
+};
+
+struct LayerRecord {
+  uint64_t buffer_id;           // Gralloc buffer id, stable across runs of the same content
+  uint32_t format;              // LayerBufferFormat
+  uint32_t width;
+  uint32_t height;
+  uint32_t buffer_flags;        // LayerBufferFlags
+  uint32_t primaries;           // Dataspace of the buffer
+  uint32_t transfer;
+  uint32_t range;
+  uint32_t layer_flags;         // LayerFlags set by the client
+  uint32_t client_composition;  // Composition requested by the client
+  uint32_t composition;         // o/p - LayerComposition chosen by SDM
+  uint32_t request_flags;       // o/p - LayerRequestFlags set by SDM
+  uint32_t blending;
+  uint32_t transform;           // bit 0 flip_h, bit 1 flip_v, bits 16+ rotation in degrees
+  uint32_t plane_alpha;
+  uint32_t frame_rate;
+  uint32_t solid_fill_color;
+  uint32_t damage_count;        // Dirty rects in the frame, the first kMaxDamageRects are kept
+  uint32_t checksum;            // Buffer contents checksum, 0 when not captured
+  RectRecord src_rect;
+  RectRecord dst_rect;
+  RectRecord damage[kMaxDamageRects];
+};
+
+struct PipeRecord {
+  uint32_t layer_index;    // Index into the layer records
+  uint32_t left_pipe_id;   // 0 if unused
+  uint32_t right_pipe_id;  // 0 if unused
+  uint32_t reserved;
+};
+
+}  // namespace layer_trace
+
+#endif  // __LAYER_TRACE_FORMAT_H__
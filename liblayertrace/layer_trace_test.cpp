@@ -0,0 +1,289 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "layer_trace.h"
+
+using namespace layer_trace;
+
+namespace {
+
+Frame MakeFrame(uint64_t frame_number, uint32_t layer_count) {
+  Frame frame;
+  frame.header.display_id = 1;
+  frame.header.frame_number = frame_number;
+  frame.header.timestamp_ns = int64_t(frame_number) * 16666667;
+  frame.header.validated = 1;
+  frame.header.gpu_target_index = layer_count;
+
+  for (uint32_t i = 0; i <= layer_count; i++) {
+    LayerRecord layer = {};
+    layer.buffer_id = 1000 + i;
+    layer.format = 1;
+    layer.width = 1080;
+    layer.height = 2400;
+    layer.composition = (i == layer_count) ? 5 /* GPUTarget */ : 2 /* SDE */;
+    layer.client_composition = 2;
+    layer.dst_rect = {0.0f, float(i) * 100.0f, 1080.0f, float(i + 1) * 100.0f};
+    layer.damage_count = 1;
+    layer.damage[0] = layer.dst_rect;
+    layer.checksum = Checksum(&layer.buffer_id, sizeof(layer.buffer_id));
+    frame.layers.push_back(layer);
+    if (i < layer_count) {
+      frame.pipes.push_back({i, 45 + i, 0, 0});
+    }
+  }
+  frame.roi.push_back({0.0f, 0.0f, 1080.0f, 2400.0f});
+
+  return frame;
+}
+
+void ExpectSameFrame(const Frame &a, const Frame &b) {
+  // The writer fills in the record size and counts.
+  FrameHeader header = a.header;
+  header.size = b.header.size;
+  header.layer_count = uint32_t(a.layers.size());
+  header.pipe_count = uint32_t(a.pipes.size());
+  header.roi_count = uint32_t(a.roi.size());
+  EXPECT_EQ(0, memcmp(&header, &b.header, sizeof(header)));
+  ASSERT_EQ(a.layers.size(), b.layers.size());
+  ASSERT_EQ(a.pipes.size(), b.pipes.size());
+  ASSERT_EQ(a.roi.size(), b.roi.size());
+  EXPECT_EQ(0, memcmp(a.layers.data(), b.layers.data(), a.layers.size() * sizeof(LayerRecord)));
+  EXPECT_EQ(0, memcmp(a.pipes.data(), b.pipes.data(), a.pipes.size() * sizeof(PipeRecord)));
+  EXPECT_EQ(0, memcmp(a.roi.data(), b.roi.data(), a.roi.size() * sizeof(RectRecord)));
+}
+
+class LayerTraceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_NE(nullptr, mkdtemp(dir_));
+    path_ = std::string(dir_) + "/display1.sdmt";
+  }
+
+  void TearDown() override {
+    unlink(path_.c_str());
+    rmdir(dir_);
+  }
+
+  void WriteRaw(const void *data, size_t size, const char *mode = "wb") {
+    FILE *file = fopen(path_.c_str(), mode);
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(size, fwrite(data, 1, size, file));
+    fclose(file);
+  }
+
+  char dir_[32] = "/tmp/layer_trace_XXXXXX";
+  std::string path_;
+};
+
+}  // namespace
+
+TEST_F(LayerTraceTest, RoundTripsFrames) {
+  std::vector<Frame> frames = {MakeFrame(1, 3), MakeFrame(2, 0), MakeFrame(3, 12)};
+  frames[1].roi.clear();
+  frames[2].header.fast_path = 1;
+
+  Writer writer;
+  ASSERT_EQ(0, writer.Open(path_));
+  for (auto &frame : frames) {
+    ASSERT_EQ(0, writer.Write(frame));
+  }
+  writer.Close();
+
+  Reader reader;
+  ASSERT_EQ(0, reader.Open(path_));
+  Frame frame;
+  for (auto &expected : frames) {
+    ASSERT_EQ(1, reader.Next(&frame));
+    ExpectSameFrame(expected, frame);
+    EXPECT_TRUE(DiffFrames(expected, frame).empty());
+  }
+  EXPECT_EQ(0, reader.Next(&frame));
+}
+
+TEST_F(LayerTraceTest, ReadsTraceWhileItIsWritten) {
+  Writer writer;
+  ASSERT_EQ(0, writer.Open(path_));
+  ASSERT_EQ(0, writer.Write(MakeFrame(1, 2)));
+  writer.Flush();
+
+  Reader reader;
+  ASSERT_EQ(0, reader.Open(path_));
+  Frame frame;
+  EXPECT_EQ(1, reader.Next(&frame));
+  EXPECT_EQ(0, reader.Next(&frame));
+}
+
+TEST_F(LayerTraceTest, RejectsFilesThatAreNotTraces) {
+  Reader reader;
+  EXPECT_EQ(-ENOENT, reader.Open(path_));
+
+  const char text[] = "not a layer trace at all";
+  WriteRaw(text, sizeof(text));
+  EXPECT_EQ(-EPROTO, reader.Open(path_));
+
+  FileHeader header = {kTraceMagic, kTraceVersionMajor + 1, 0, sizeof(FileHeader), 0};
+  WriteRaw(&header, sizeof(header));
+  EXPECT_EQ(-EPROTO, reader.Open(path_));
+
+  Frame frame;
+  EXPECT_EQ(-EBADF, reader.Next(&frame));
+}
+
+TEST_F(LayerTraceTest, SkipsFieldsOfNewerMinorVersion) {
+  // A newer writer with a longer file header and a field appended to each frame record.
+  struct NewerFileHeader {
+    FileHeader header;
+    uint64_t extra;
+  } file_header = {{kTraceMagic, kTraceVersionMajor, kTraceVersionMinor + 1,
+                    sizeof(NewerFileHeader), 0}, 0};
+  WriteRaw(&file_header, sizeof(file_header));
+
+  Frame frames[] = {MakeFrame(1, 1), MakeFrame(2, 2)};
+  for (auto &frame : frames) {
+    FrameHeader header = frame.header;
+    header.layer_count = uint32_t(frame.layers.size());
+    header.pipe_count = uint32_t(frame.pipes.size());
+    header.roi_count = uint32_t(frame.roi.size());
+    header.size = uint32_t(sizeof(FrameHeader) + (frame.layers.size() * sizeof(LayerRecord)) +
+                           (frame.pipes.size() * sizeof(PipeRecord)) +
+                           (frame.roi.size() * sizeof(RectRecord)) + sizeof(uint64_t));
+    uint64_t extra = 0xdeadbeef;
+    WriteRaw(&header, sizeof(header), "ab");
+    WriteRaw(frame.layers.data(), frame.layers.size() * sizeof(LayerRecord), "ab");
+    WriteRaw(frame.pipes.data(), frame.pipes.size() * sizeof(PipeRecord), "ab");
+    WriteRaw(frame.roi.data(), frame.roi.size() * sizeof(RectRecord), "ab");
+    WriteRaw(&extra, sizeof(extra), "ab");
+  }
+
+  Reader reader;
+  ASSERT_EQ(0, reader.Open(path_));
+  Frame frame;
+  for (auto &expected : frames) {
+    ASSERT_EQ(1, reader.Next(&frame));
+    EXPECT_EQ(expected.header.frame_number, frame.header.frame_number);
+    ASSERT_EQ(expected.layers.size(), frame.layers.size());
+    EXPECT_EQ(0, memcmp(expected.layers.data(), frame.layers.data(),
+                        expected.layers.size() * sizeof(LayerRecord)));
+  }
+  EXPECT_EQ(0, reader.Next(&frame));
+}
+
+TEST_F(LayerTraceTest, ReportsCorruptRecords) {
+  Writer writer;
+  ASSERT_EQ(0, writer.Open(path_));
+  ASSERT_EQ(0, writer.Write(MakeFrame(1, 4)));
+  writer.Close();
+
+  // Cut the record short, as when the device stopped mid write.
+  long size = 0;
+  {
+    FILE *file = fopen(path_.c_str(), "rb");
+    ASSERT_NE(nullptr, file);
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fclose(file);
+  }
+  ASSERT_EQ(0, truncate(path_.c_str(), size - long(sizeof(LayerRecord))));
+
+  Reader reader;
+  ASSERT_EQ(0, reader.Open(path_));
+  Frame frame;
+  EXPECT_EQ(-EPROTO, reader.Next(&frame));
+
+  // Counts beyond the format limits are not trusted to size allocations.
+  FileHeader file_header = {kTraceMagic, kTraceVersionMajor, kTraceVersionMinor,
+                            sizeof(FileHeader), 0};
+  FrameHeader header = {};
+  header.layer_count = kMaxTraceLayers + 1;
+  header.size = UINT32_MAX;
+  WriteRaw(&file_header, sizeof(file_header));
+  WriteRaw(&header, sizeof(header), "ab");
+  ASSERT_EQ(0, reader.Open(path_));
+  EXPECT_EQ(-EPROTO, reader.Next(&frame));
+}
+
+TEST(LayerTraceDiffTest, ReportsDecisionChanges) {
+  Frame a = MakeFrame(1, 3);
+  Frame b = MakeFrame(1, 3);
+  EXPECT_TRUE(DiffFrames(a, b).empty());
+
+  // Layer 1 fell back to the GPU and its pipe was released.
+  b.layers[1].composition = 0;
+  b.pipes.erase(b.pipes.begin() + 1);
+  std::vector<std::string> diffs = DiffFrames(a, b);
+  ASSERT_EQ(3u, diffs.size());
+  EXPECT_EQ("layer 1: composition SDE vs GPU", diffs[0]);
+  EXPECT_EQ("fallback layers 0 vs 1", diffs[1]);
+  EXPECT_EQ("pipes: 3 vs 2", diffs[2]);
+  EXPECT_EQ(1u, CountFallbackLayers(b));
+
+  b = MakeFrame(1, 3);
+  b.roi[0].bottom = 1200.0f;
+  diffs = DiffFrames(a, b);
+  ASSERT_EQ(1u, diffs.size());
+  EXPECT_EQ("roi: [0 0 1080 2400] vs [0 0 1080 1200]", diffs[0]);
+}
+
+TEST(LayerTraceDiffTest, DoesNotCompareDecisionsOnDifferentInput) {
+  Frame a = MakeFrame(1, 3);
+  Frame b = MakeFrame(1, 3);
+  b.layers[2].checksum ^= 1;
+  b.layers[2].composition = 0;
+  std::vector<std::string> diffs = DiffFrames(a, b);
+  ASSERT_EQ(1u, diffs.size());
+  EXPECT_EQ("input: layer 2 differs", diffs[0]);
+
+  // A layer recorded without a checksum matches any contents.
+  b.layers[2].checksum = 0;
+  b.layers[2].composition = a.layers[2].composition;
+  EXPECT_TRUE(DiffFrames(a, b).empty());
+
+  diffs = DiffFrames(a, MakeFrame(1, 2));
+  ASSERT_EQ(1u, diffs.size());
+  EXPECT_EQ("input: layer count 4 vs 3", diffs[0]);
+}
+
+TEST(LayerTraceDiffTest, ClientCompositionIsNotFallback) {
+  Frame frame = MakeFrame(1, 2);
+  frame.layers[0].client_composition = 1;
+  frame.layers[0].composition = 0;
+  EXPECT_EQ(0u, CountFallbackLayers(frame));
+  EXPECT_NE(std::string::npos, FormatFrame(frame).find("layer 0: GPU"));
+  EXPECT_NE(std::string::npos, FormatFrame(frame).find("(client target)"));
+}
@@ -0,0 +1,136 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "layer_trace.h"
+
+using layer_trace::Frame;
+using layer_trace::Reader;
+
+namespace {
+
+void ShowUsage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s dump <trace>\n"
+          "       %s diff <trace_a> <trace_b>\n", program, program);
+}
+
+int OpenTrace(const char *path, Reader *reader) {
+  int ret = reader->Open(path);
+  if (ret) {
+    fprintf(stderr, "%s: cannot read trace: %s\n", path, strerror(-ret));
+  }
+
+  return ret;
+}
+
+int Dump(const char *path) {
+  Reader reader;
+  if (OpenTrace(path, &reader)) {
+    return 1;
+  }
+
+  Frame frame;
+  int ret = 0;
+  while ((ret = reader.Next(&frame)) > 0) {
+    printf("%s", layer_trace::FormatFrame(frame).c_str());
+  }
+
+  if (ret < 0) {
+    fprintf(stderr, "%s: corrupt frame record: %s\n", path, strerror(-ret));
+    return 1;
+  }
+
+  return 0;
+}
+
+// Walks both traces frame by frame. Traces recorded from the same content on two builds line up
+// by frame index, so the first differing frame points at the change in strategy or resource
+// behaviour.
+int Diff(const char *path_a, const char *path_b) {
+  Reader reader_a, reader_b;
+  if (OpenTrace(path_a, &reader_a) || OpenTrace(path_b, &reader_b)) {
+    return 2;
+  }
+
+  Frame frame_a, frame_b;
+  uint32_t index = 0, differing = 0;
+  int64_t first = -1;
+  int ret_a = 0, ret_b = 0;
+  while ((ret_a = reader_a.Next(&frame_a)) > 0 && (ret_b = reader_b.Next(&frame_b)) > 0) {
+    std::vector<std::string> diffs = layer_trace::DiffFrames(frame_a, frame_b);
+    if (!diffs.empty()) {
+      printf("frame %u (a #%" PRIu64 ", b #%" PRIu64 "):\n", index,
+             frame_a.header.frame_number, frame_b.header.frame_number);
+      for (auto &diff : diffs) {
+        printf("  %s\n", diff.c_str());
+      }
+      first = (first < 0) ? index : first;
+      differing++;
+    }
+    index++;
+  }
+
+  if (ret_a < 0 || ret_b < 0) {
+    fprintf(stderr, "corrupt frame record in %s\n", (ret_a < 0) ? path_a : path_b);
+    return 2;
+  }
+
+  if (ret_a > 0 || (ret_a == 0 && reader_b.Next(&frame_b) > 0)) {
+    printf("traces differ in length, compared the first %u frames\n", index);
+  }
+
+  printf("%u of %u frames differ", differing, index);
+  if (first >= 0) {
+    printf(", first at frame %" PRId64, first);
+  }
+  printf("\n");
+
+  return differing ? 1 : 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc == 3 && !strcmp(argv[1], "dump")) {
+    return Dump(argv[2]);
+  }
+
+  if (argc == 4 && !strcmp(argv[1], "diff")) {
+    return Diff(argv[2], argv[3]);
+  }
+
+  ShowUsage(argv[0]);
+  return 2;
+}
@@ -31,3 +31,16 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_VENDOR_MODULE := true
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := lights.c lights_test.cpp
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+LOCAL_STATIC_LIBRARIES := libgtest libgtest_main
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_CFLAGS := -DLOG_TAG=\"qdlights\" -DLIGHTS_SYSFS_ROOT=\"/data/local/tmp/lights_test\"
+LOCAL_MODULE := lights_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+
+include $(BUILD_EXECUTABLE)
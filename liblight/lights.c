@@ -27,17 +27,50 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <pthread.h>
+#include <time.h>
 
 #include <sys/ioctl.h>
 #include <sys/types.h>
 
 #include <hardware/lights.h>
 
+// Prefix of every sysfs path, lets tests run the HAL against a temporary tree
+#ifndef LIGHTS_SYSFS_ROOT
+#define LIGHTS_SYSFS_ROOT ""
+#endif
+
 #ifndef DEFAULT_LOW_PERSISTENCE_MODE_BRIGHTNESS
 #define DEFAULT_LOW_PERSISTENCE_MODE_BRIGHTNESS 0x80
 #endif
 
+// Brightness writes closer together than this are coalesced, only the latest value is written
+#ifndef BACKLIGHT_MIN_WRITE_INTERVAL_MS
+#define BACKLIGHT_MIN_WRITE_INTERVAL_MS 16
+#endif
+
+#ifndef NSEC_PER_MSEC
+#define NSEC_PER_MSEC 1000000LL
+#endif
+#ifndef NSEC_PER_SEC
+#define NSEC_PER_SEC 1000000000LL
+#endif
+// Number of writes to a node between two latency reports
+#define NODE_STATS_WINDOW 256
+
+/******************************************************************************/
+
+// A sysfs node kept open across writes
+struct sysfs_node {
+    char const* path;
+    int fd;
+    bool warned;
+    uint32_t write_count;
+    int64_t write_ns_total;
+    int64_t write_ns_max;
+};
+
 /******************************************************************************/
 
 static pthread_once_t g_init = PTHREAD_ONCE_INIT;
@@ -48,17 +81,27 @@ static int g_last_backlight_mode = BRIGHTNESS_MODE_USER;
 static int g_attention = 0;
 static bool g_has_persistence_node = false;
 
+static struct sysfs_node g_lcd_node = { .fd = -1 };
+static struct sysfs_node g_button_node = { .fd = -1 };
+static struct sysfs_node g_persistence_node = { .fd = -1 };
+
+static pthread_cond_t g_backlight_cond;
+static bool g_backlight_writer_started = false;
+static bool g_backlight_pending = false;
+static int g_backlight_pending_value = 0;
+static int64_t g_backlight_last_write_ns = 0;
+
 char const*const LCD_FILE
-        = "/sys/class/leds/lcd-backlight/brightness";
+        = LIGHTS_SYSFS_ROOT "/sys/class/leds/lcd-backlight/brightness";
 
 char const*const LCD_FILE2
-        = "/sys/class/backlight/panel0-backlight/brightness";
+        = LIGHTS_SYSFS_ROOT "/sys/class/backlight/panel0-backlight/brightness";
 
 char const*const BUTTON_FILE
-        = "/sys/class/leds/button-backlight/brightness";
+        = LIGHTS_SYSFS_ROOT "/sys/class/leds/button-backlight/brightness";
 
 char const*const PERSISTENCE_FILE
-        = "/sys/class/graphics/fb0/msm_fb_persist_mode";
+        = LIGHTS_SYSFS_ROOT "/sys/class/graphics/fb0/msm_fb_persist_mode";
 
 enum rgb_led {
     LED_RED = 0,
@@ -79,6 +122,19 @@ void init_globals(void)
 {
     // init the mutex
     pthread_mutex_init(&g_lock, NULL);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_backlight_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
 }
 
 static int write_int(char const* path, int value)
@@ -102,6 +158,116 @@ static int write_int(char const* path, int value)
     }
 }
 
+static void record_write_latency(struct sysfs_node* node, int64_t write_ns)
+{
+    node->write_ns_total += write_ns;
+    if (write_ns > node->write_ns_max)
+        node->write_ns_max = write_ns;
+
+    if (++node->write_count == NODE_STATS_WINDOW) {
+        ALOGV("%s: %d writes, avg %lld us, max %lld us\n", node->path, NODE_STATS_WINDOW,
+              (long long)(node->write_ns_total / NODE_STATS_WINDOW / 1000),
+              (long long)(node->write_ns_max / 1000));
+        node->write_count = 0;
+        node->write_ns_total = 0;
+        node->write_ns_max = 0;
+    }
+}
+
+static int write_node(struct sysfs_node* node, int value)
+{
+    if (node->fd < 0) {
+        node->fd = open(node->path, O_RDWR);
+        if (node->fd < 0) {
+            int err = -errno;
+            if (!node->warned) {
+                ALOGE("write_node failed to open %s, errno = %d\n", node->path, errno);
+                node->warned = true;
+            }
+            return err;
+        }
+    }
+
+    char buffer[20];
+    int bytes = snprintf(buffer, sizeof(buffer), "%d\n", value);
+    int64_t start = now_ns();
+    ssize_t amt = pwrite(node->fd, buffer, (size_t)bytes, 0);
+    if (amt != bytes) {
+        // sysfs stores take the whole value or nothing, a short write did not set it
+        int err = amt == -1 ? -errno : -EIO;
+        // Reopen on the next write in case the node went away with its device
+        close(node->fd);
+        node->fd = -1;
+        return err;
+    }
+    record_write_latency(node, now_ns() - start);
+
+    return 0;
+}
+
+static int write_backlight_locked(int brightness)
+{
+    // Always write, even the value written last: the kernel or other clients of the node may have
+    // changed the brightness since
+    g_backlight_pending = false;
+    int err = write_node(&g_lcd_node, brightness);
+    g_backlight_last_write_ns = now_ns();
+    return err;
+}
+
+// Writes the latest pending brightness once the minimum interval since the last write has passed
+static void* backlight_writer(void* arg __unused)
+{
+    pthread_mutex_lock(&g_lock);
+    for (;;) {
+        while (!g_backlight_pending)
+            pthread_cond_wait(&g_backlight_cond, &g_lock);
+
+        int64_t deadline = g_backlight_last_write_ns +
+                BACKLIGHT_MIN_WRITE_INTERVAL_MS * NSEC_PER_MSEC;
+        struct timespec ts = {
+            .tv_sec = (time_t)(deadline / NSEC_PER_SEC),
+            .tv_nsec = (long)(deadline % NSEC_PER_SEC),
+        };
+        while (g_backlight_pending && now_ns() < deadline)
+            pthread_cond_timedwait(&g_backlight_cond, &g_lock, &ts);
+
+        if (g_backlight_pending) {
+            int err = write_backlight_locked(g_backlight_pending_value);
+            if (err)
+                ALOGE("%s: Failed to write to %s: %d\n", __FUNCTION__, g_lcd_node.path, err);
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+static int set_backlight_locked(int brightness)
+{
+    int64_t since_last_write = now_ns() - g_backlight_last_write_ns;
+    if (!g_backlight_pending &&
+            since_last_write >= BACKLIGHT_MIN_WRITE_INTERVAL_MS * NSEC_PER_MSEC)
+        return write_backlight_locked(brightness);
+
+    g_backlight_pending_value = brightness;
+    if (g_backlight_pending)
+        return 0;
+
+    if (!g_backlight_writer_started) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, backlight_writer, NULL)) {
+            ALOGE("%s: Failed to start backlight writer, errno = %d\n", __FUNCTION__, errno);
+            return write_backlight_locked(brightness);
+        }
+        pthread_detach(thread);
+        g_backlight_writer_started = true;
+    }
+    g_backlight_pending = true;
+    pthread_cond_signal(&g_backlight_cond);
+
+    return 0;
+}
+
 static bool file_exists(const char *file)
 {
     int fd;
@@ -150,7 +316,7 @@ set_light_backlight(struct light_device_t* dev,
     bool cannot_handle_persistence = !g_has_persistence_node && persistence_mode;
     if (g_has_persistence_node) {
         if (persistence_mode) {
-            if ((err = write_int(PERSISTENCE_FILE, lpEnabled)) != 0) {
+            if ((err = write_node(&g_persistence_node, lpEnabled)) != 0) {
                 ALOGE("%s: Failed to write to %s: %s\n", __FUNCTION__,
                        PERSISTENCE_FILE, strerror(errno));
             }
@@ -162,10 +328,11 @@ set_light_backlight(struct light_device_t* dev,
     }
 
     if (!err) {
-        if (!access(LCD_FILE, F_OK)) {
-            err = write_int(LCD_FILE, brightness);
+        // A persistence mode switch must take effect with its brightness, so it is not deferred
+        if (persistence_mode && g_has_persistence_node) {
+            err = write_backlight_locked(brightness);
         } else {
-            err = write_int(LCD_FILE2, brightness);
+            err = set_backlight_locked(brightness);
         }
     }
 
@@ -175,23 +342,26 @@ set_light_backlight(struct light_device_t* dev,
 
 static int set_rgb_led_brightness(enum rgb_led led, int brightness)
 {
-    char file[48];
+    char file[PATH_MAX];
 
-    snprintf(file, sizeof(file), "/sys/class/leds/%s/brightness", led_names[led]);
+    snprintf(file, sizeof(file), LIGHTS_SYSFS_ROOT "/sys/class/leds/%s/brightness",
+             led_names[led]);
     return write_int(file, brightness);
 }
 
 static int set_rgb_led_timer_trigger(enum rgb_led led, int onMS, int offMS)
 {
-    char file[48];
+    char file[PATH_MAX];
     int rc;
 
-    snprintf(file, sizeof(file), "/sys/class/leds/%s/delay_off", led_names[led]);
+    snprintf(file, sizeof(file), LIGHTS_SYSFS_ROOT "/sys/class/leds/%s/delay_off",
+             led_names[led]);
     rc = write_int(file, offMS);
     if (rc < 0)
         goto out;
 
-    snprintf(file, sizeof(file), "/sys/class/leds/%s/delay_on", led_names[led]);
+    snprintf(file, sizeof(file), LIGHTS_SYSFS_ROOT "/sys/class/leds/%s/delay_on",
+             led_names[led]);
     rc = write_int(file, onMS);
     if (rc < 0)
         goto out;
@@ -204,11 +374,13 @@ out:
 
 static int set_rgb_led_hw_blink(enum rgb_led led, int blink)
 {
-    char file[48];
+    char file[PATH_MAX];
 
-    snprintf(file, sizeof(file), "/sys/class/leds/%s/breath", led_names[led]);
+    snprintf(file, sizeof(file), LIGHTS_SYSFS_ROOT "/sys/class/leds/%s/breath",
+             led_names[led]);
     if (!file_exists(file))
-        snprintf(file, sizeof(file), "/sys/class/leds/%s/blink", led_names[led]);
+        snprintf(file, sizeof(file), LIGHTS_SYSFS_ROOT "/sys/class/leds/%s/blink",
+                 led_names[led]);
 
     return write_int(file, blink);
 }
@@ -329,7 +501,7 @@ set_light_buttons(struct light_device_t* dev,
         return -1;
     }
     pthread_mutex_lock(&g_lock);
-    err = write_int(BUTTON_FILE, state->color & 0xFF);
+    err = write_node(&g_button_node, state->color & 0xFF);
     pthread_mutex_unlock(&g_lock);
     return err;
 }
@@ -360,6 +532,8 @@ static int open_lights(const struct hw_module_t* module, char const* name,
 
     if (0 == strcmp(LIGHT_ID_BACKLIGHT, name)) {
         g_has_persistence_node = !access(PERSISTENCE_FILE, F_OK);
+        g_persistence_node.path = PERSISTENCE_FILE;
+        g_lcd_node.path = !access(LCD_FILE, F_OK) ? LCD_FILE : LCD_FILE2;
         set_light = set_light_backlight;
     } else if (0 == strcmp(LIGHT_ID_BATTERY, name))
         set_light = set_light_battery;
@@ -368,6 +542,7 @@ static int open_lights(const struct hw_module_t* module, char const* name,
     else if (0 == strcmp(LIGHT_ID_BUTTONS, name)) {
         if (!access(BUTTON_FILE, F_OK)) {
           // enable light button when the file is present
+          g_button_node.path = BUTTON_FILE;
           set_light = set_light_buttons;
         } else {
           return -EINVAL;
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2021 The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs the HAL against a tree of regular files under LIGHTS_SYSFS_ROOT standing in for sysfs.
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include <hardware/lights.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+extern "C" struct hw_module_t HAL_MODULE_INFO_SYM;
+
+namespace {
+
+const std::string kRoot = LIGHTS_SYSFS_ROOT;
+const std::string kLcd = kRoot + "/sys/class/leds/lcd-backlight/brightness";
+const std::string kButton = kRoot + "/sys/class/leds/button-backlight/brightness";
+const std::string kPersistence = kRoot + "/sys/class/graphics/fb0/msm_fb_persist_mode";
+
+// Longer than BACKLIGHT_MIN_WRITE_INTERVAL_MS, so that the next backlight write is immediate
+const auto kWriteInterval = std::chrono::milliseconds(20);
+
+void MakeDirs(const std::string &path) {
+  for (size_t pos = 1; pos != std::string::npos; pos = path.find('/', pos + 1)) {
+    mkdir(path.substr(0, pos).c_str(), 0755);
+  }
+}
+
+void WriteNode(const std::string &path, int value) {
+  MakeDirs(path);
+  FILE *file = fopen(path.c_str(), "w");
+  ASSERT_NE(nullptr, file) << path;
+  fprintf(file, "%d\n", value);
+  fclose(file);
+}
+
+int ReadNode(const std::string &path) {
+  int value = -1;
+  FILE *file = fopen(path.c_str(), "r");
+  if (file) {
+    if (fscanf(file, "%d", &value) != 1) {
+      value = -1;
+    }
+    fclose(file);
+  }
+  return value;
+}
+
+// Polls for the value the backlight writer thread is expected to land.
+int WaitForNode(const std::string &path, int value) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+  while (ReadNode(path) != value && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return ReadNode(path);
+}
+
+light_state_t Gray(int level, int mode = BRIGHTNESS_MODE_USER) {
+  light_state_t state = {};
+  state.color = 0xff000000 | (static_cast<unsigned int>(level) * 0x010101);
+  state.brightnessMode = mode;
+  return state;
+}
+
+class LightsTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    WriteNode(kLcd, 0);
+    WriteNode(kPersistence, 0);
+  }
+
+  light_device_t *Open(const char *name) {
+    hw_device_t *device = nullptr;
+    if (HAL_MODULE_INFO_SYM.methods->open(&HAL_MODULE_INFO_SYM, name, &device)) {
+      return nullptr;
+    }
+    device_ = reinterpret_cast<light_device_t *>(device);
+    return device_;
+  }
+
+  void TearDown() override {
+    if (device_) {
+      device_->common.close(&device_->common);
+    }
+  }
+
+  light_device_t *device_ = nullptr;
+};
+
+TEST_F(LightsTest, BacklightWritesBrightness) {
+  light_device_t *lights = Open(LIGHT_ID_BACKLIGHT);
+  ASSERT_NE(nullptr, lights);
+
+  std::this_thread::sleep_for(kWriteInterval);
+  light_state_t state = Gray(128);
+  EXPECT_EQ(0, lights->set_light(lights, &state));
+  EXPECT_EQ(128, ReadNode(kLcd));
+}
+
+TEST_F(LightsTest, BacklightRewritesValueChangedBehindHal) {
+  light_device_t *lights = Open(LIGHT_ID_BACKLIGHT);
+  ASSERT_NE(nullptr, lights);
+
+  light_state_t state = Gray(64);
+  EXPECT_EQ(0, lights->set_light(lights, &state));
+  EXPECT_EQ(64, WaitForNode(kLcd, 64));
+
+  std::this_thread::sleep_for(kWriteInterval);
+  WriteNode(kLcd, 7);
+  EXPECT_EQ(0, lights->set_light(lights, &state));
+  EXPECT_EQ(64, WaitForNode(kLcd, 64));
+}
+
+TEST_F(LightsTest, BacklightBurstEndsOnLatestValue) {
+  light_device_t *lights = Open(LIGHT_ID_BACKLIGHT);
+  ASSERT_NE(nullptr, lights);
+
+  for (int level = 1; level <= 100; level++) {
+    light_state_t state = Gray(level);
+    EXPECT_EQ(0, lights->set_light(lights, &state));
+  }
+  EXPECT_EQ(100, WaitForNode(kLcd, 100));
+}
+
+TEST_F(LightsTest, LowPersistenceWritesBrightnessImmediately) {
+  light_device_t *lights = Open(LIGHT_ID_BACKLIGHT);
+  ASSERT_NE(nullptr, lights);
+
+  light_state_t state = Gray(50);
+  EXPECT_EQ(0, lights->set_light(lights, &state));
+  state = Gray(51, BRIGHTNESS_MODE_LOW_PERSISTENCE);
+  EXPECT_EQ(0, lights->set_light(lights, &state));
+  EXPECT_EQ(1, ReadNode(kPersistence));
+  // Not deferred even though the previous write was within the interval
+  EXPECT_EQ(0x80, ReadNode(kLcd));
+
+  state = Gray(52);
+  EXPECT_EQ(0, lights->set_light(lights, &state));
+  EXPECT_EQ(0, ReadNode(kPersistence));
+  EXPECT_EQ(52, ReadNode(kLcd));
+}
+
+TEST_F(LightsTest, ButtonsReportMissingNodeAndReopen) {
+  unlink(kButton.c_str());
+  EXPECT_EQ(nullptr, Open(LIGHT_ID_BUTTONS));
+
+  WriteNode(kButton, 0);
+  light_device_t *lights = Open(LIGHT_ID_BUTTONS);
+  ASSERT_NE(nullptr, lights);
+
+  // The node is opened on first write, a node gone by then fails the write
+  unlink(kButton.c_str());
+  light_state_t state = Gray(32);
+  EXPECT_EQ(-ENOENT, lights->set_light(lights, &state));
+
+  WriteNode(kButton, 0);
+  EXPECT_EQ(0, lights->set_light(lights, &state));
+  EXPECT_EQ(32, ReadNode(kButton));
+}
+
+}  // namespace
@@ -37,4 +37,18 @@ LOCAL_HEADER_LIBRARIES := libhardware_headers
 LOCAL_SRC_FILES := memtrack_msm.c kgsl.c
 LOCAL_MODULE := memtrack.$(TARGET_BOARD_PLATFORM)
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_VENDOR_MODULE := true
+LOCAL_C_INCLUDES += hardware/libhardware/include
+LOCAL_CFLAGS := -Wall -Werror -DKGSL_PROC_PATH=\"/data/local/tmp/memtrack_test/proc\"
+LOCAL_CONLYFLAGS := -Wconversion -Wno-sign-conversion
+LOCAL_CLANG  := true
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_STATIC_LIBRARIES := libgtest libgtest_main
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+LOCAL_SRC_FILES := memtrack_msm.c kgsl.c memtrack_test.cpp
+LOCAL_MODULE := memtrack_test
+include $(BUILD_EXECUTABLE)
 endif
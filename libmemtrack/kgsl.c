@@ -15,10 +15,14 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 #include <hardware/memtrack.h>
 
@@ -27,6 +31,13 @@
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof(x[0]))
 #define min(x, y) ((x) < (y) ? (x) : (y))
 
+#ifndef KGSL_PROC_PATH
+#define KGSL_PROC_PATH "/sys/class/kgsl/kgsl/proc"
+#endif
+
+/* Number of processes whose kgsl nodes are kept open between queries */
+#define KGSL_FD_CACHE_SIZE 64
+
 struct memtrack_record record_templates[] = {
     {
         .flags = MEMTRACK_FLAG_SMAPS_ACCOUNTED |
@@ -40,79 +51,206 @@ struct memtrack_record record_templates[] = {
     },
 };
 
-int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
-                             struct memtrack_record *records,
-                             size_t *num_records)
+enum kgsl_node {
+    KGSL_GPUMEM_MAPPED,
+    KGSL_GPUMEM_UNMAPPED,
+    KGSL_IMPORTED_MEM,
+    KGSL_NODE_MAX,
+};
+
+static const char *kgsl_node_names[KGSL_NODE_MAX] = {
+    "gpumem_mapped",
+    "gpumem_unmapped",
+    "imported_mem",
+};
+
+/* Open kgsl nodes of one process, -1 for nodes not opened yet */
+struct kgsl_proc_fds {
+    pid_t pid;
+    int fd[KGSL_NODE_MAX];
+    unsigned int last_use;
+};
+
+static pthread_mutex_t fd_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct kgsl_proc_fds fd_cache[KGSL_FD_CACHE_SIZE];
+static unsigned int fd_cache_clock;
+
+static void close_proc_fds(struct kgsl_proc_fds *proc, pid_t pid)
 {
-    size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
-    char syspath[128];
-    size_t accounted_size = 0;
-    size_t unaccounted_size = 0;
-    FILE *fp;
-    int ret;
+    for (int i = 0; i < KGSL_NODE_MAX; i++) {
+        /* pid 0 marks an entry that was never used, its fds are not initialized */
+        if (proc->pid && proc->fd[i] >= 0)
+            close(proc->fd[i]);
+        proc->fd[i] = -1;
+    }
+    proc->pid = pid;
+}
 
-    *num_records = ARRAY_SIZE(record_templates);
+static struct kgsl_proc_fds *get_proc_fds_locked(pid_t pid)
+{
+    struct kgsl_proc_fds *lru = &fd_cache[0];
 
-    /* fastpath to return the necessary number of records */
-    if (allocated_records == 0)
-        return 0;
+    fd_cache_clock++;
+    for (size_t i = 0; i < KGSL_FD_CACHE_SIZE; i++) {
+        if (fd_cache[i].pid == pid) {
+            fd_cache[i].last_use = fd_cache_clock;
+            return &fd_cache[i];
+        }
+        if (fd_cache[i].last_use < lru->last_use)
+            lru = &fd_cache[i];
+    }
 
-    memcpy(records, record_templates,
-            sizeof(struct memtrack_record) * allocated_records);
+    close_proc_fds(lru, pid);
+    lru->last_use = fd_cache_clock;
+    return lru;
+}
 
-    if (type == MEMTRACK_TYPE_GL) {
+/* Parses the decimal value at the start of buf, which holds len bytes */
+static int parse_size(const char *buf, size_t len, size_t *value)
+{
+    size_t i = 0;
+    size_t result = 0;
 
-        snprintf(syspath, sizeof(syspath),
-                 "/sys/class/kgsl/kgsl/proc/%d/gpumem_mapped", pid);
+    while (i < len && (buf[i] == ' ' || buf[i] == '\t'))
+        i++;
 
-        fp = fopen(syspath, "r");
-        if (fp == NULL)
-            return -errno;
+    if (i == len || buf[i] < '0' || buf[i] > '9')
+        return -EINVAL;
 
-        ret = fscanf(fp, "%zu", &accounted_size);
-        if (ret != 1) {
-            fclose(fp);
+    for (; i < len && buf[i] >= '0' && buf[i] <= '9'; i++) {
+        size_t digit = (size_t)(buf[i] - '0');
+        if (result > (SIZE_MAX - digit) / 10)
             return -EINVAL;
-        }
-        fclose(fp);
+        result = result * 10 + digit;
+    }
 
-        snprintf(syspath, sizeof(syspath),
-                 "/sys/class/kgsl/kgsl/proc/%d/gpumem_unmapped", pid);
+    *value = result;
+    return 0;
+}
+
+static int open_node(pid_t pid, enum kgsl_node node)
+{
+    char syspath[128];
 
-        fp = fopen(syspath, "r");
-        if (fp == NULL) {
-            return -errno;
+    snprintf(syspath, sizeof(syspath), KGSL_PROC_PATH "/%d/%s", pid, kgsl_node_names[node]);
+    return open(syspath, O_RDONLY | O_CLOEXEC);
+}
+
+static int read_node_locked(struct kgsl_proc_fds *proc, enum kgsl_node node, size_t *value)
+{
+    char buf[32];
+    ssize_t len = -1;
+
+    /*
+     * A cached fd goes stale when its process exits, and a new process may reuse the pid, so a
+     * failed read is retried once on a freshly opened node.
+     */
+    for (int attempt = 0; attempt < 2 && len < 0; attempt++) {
+        if (proc->fd[node] < 0) {
+            proc->fd[node] = open_node(proc->pid, node);
+            if (proc->fd[node] < 0)
+                return -errno;
         }
 
-        ret = fscanf(fp, "%zu", &unaccounted_size);
-        if (ret != 1) {
-            fclose(fp);
-            return -EINVAL;
+        len = pread(proc->fd[node], buf, sizeof(buf), 0);
+        if (len < 0) {
+            close(proc->fd[node]);
+            proc->fd[node] = -1;
         }
-        fclose(fp);
+    }
 
-    } else if (type == MEMTRACK_TYPE_GRAPHICS) {
+    if (len < 0)
+        return -EINVAL;
+
+    return parse_size(buf, (size_t)len, value);
+}
 
-        snprintf(syspath, sizeof(syspath),
-                 "/sys/class/kgsl/kgsl/proc/%d/imported_mem", pid);
+static int kgsl_read_sizes_locked(pid_t pid, enum memtrack_type type,
+                                  size_t *accounted_size, size_t *unaccounted_size)
+{
+    struct kgsl_proc_fds *proc;
+    int ret = 0;
 
-        fp = fopen(syspath, "r");
-        if (fp == NULL)
-            return -errno;
+    *accounted_size = 0;
+    *unaccounted_size = 0;
 
-        ret = fscanf(fp, "%zu", &unaccounted_size);
-        if (ret != 1) {
-            fclose(fp);
-            return -EINVAL;
-        }
-        fclose(fp);
+    /* pid 0 marks unused cache entries */
+    if (pid <= 0)
+        return -EINVAL;
+
+    proc = get_proc_fds_locked(pid);
+
+    if (type == MEMTRACK_TYPE_GL) {
+        ret = read_node_locked(proc, KGSL_GPUMEM_MAPPED, accounted_size);
+        if (!ret)
+            ret = read_node_locked(proc, KGSL_GPUMEM_UNMAPPED, unaccounted_size);
+    } else if (type == MEMTRACK_TYPE_GRAPHICS) {
+        ret = read_node_locked(proc, KGSL_IMPORTED_MEM, unaccounted_size);
     }
 
+    return ret;
+}
+
+static void fill_records(struct memtrack_record *records, size_t allocated_records,
+                         size_t accounted_size, size_t unaccounted_size)
+{
+    memcpy(records, record_templates,
+            sizeof(struct memtrack_record) * allocated_records);
+
     if (allocated_records > 0)
     records[0].size_in_bytes = accounted_size;
 
     if (allocated_records > 1)
     records[1].size_in_bytes = unaccounted_size;
+}
+
+int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
+                             struct memtrack_record *records,
+                             size_t *num_records)
+{
+    size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
+    size_t accounted_size = 0;
+    size_t unaccounted_size = 0;
+    int ret;
+
+    *num_records = ARRAY_SIZE(record_templates);
+
+    /* fastpath to return the necessary number of records */
+    if (allocated_records == 0)
+        return 0;
+
+    pthread_mutex_lock(&fd_cache_lock);
+    ret = kgsl_read_sizes_locked(pid, type, &accounted_size, &unaccounted_size);
+    pthread_mutex_unlock(&fd_cache_lock);
+    if (ret)
+        return ret;
+
+    fill_records(records, allocated_records, accounted_size, unaccounted_size);
+
+    return 0;
+}
+
+int kgsl_memtrack_get_memory_batch(const pid_t *pids, size_t num_pids,
+                                   enum memtrack_type type,
+                                   struct memtrack_record *records,
+                                   size_t num_records, int *results)
+{
+    size_t allocated_records = min(num_records, ARRAY_SIZE(record_templates));
+
+    if (!pids || !results || (num_records && !records))
+        return -EINVAL;
+
+    pthread_mutex_lock(&fd_cache_lock);
+    for (size_t i = 0; i < num_pids; i++) {
+        size_t accounted_size = 0;
+        size_t unaccounted_size = 0;
+
+        results[i] = kgsl_read_sizes_locked(pids[i], type, &accounted_size, &unaccounted_size);
+        if (!results[i] && allocated_records)
+            fill_records(&records[i * num_records], allocated_records, accounted_size,
+                         unaccounted_size);
+    }
+    pthread_mutex_unlock(&fd_cache_lock);
 
     return 0;
 }
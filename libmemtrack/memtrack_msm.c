@@ -42,6 +42,21 @@ int msm_memtrack_get_memory(const struct memtrack_module *module,
     return -EINVAL;
 }
 
+int msm_memtrack_get_memory_batch(const struct memtrack_module *module,
+                                  const pid_t *pids, size_t num_pids, int type,
+                                  struct memtrack_record *records,
+                                  size_t num_records, int *results)
+{
+    if(!module)
+        return -1;
+    if (type == MEMTRACK_TYPE_GL || type == MEMTRACK_TYPE_GRAPHICS) {
+        return kgsl_memtrack_get_memory_batch(pids, num_pids, type, records, num_records,
+                                              results);
+    }
+
+    return -EINVAL;
+}
+
 static struct hw_module_methods_t memtrack_module_methods = {
     .open = NULL,
 };
@@ -21,4 +21,24 @@ int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
                              struct memtrack_record *records,
                              size_t *num_records);
 
+/*
+ * Queries num_pids processes in one pass. Each pid gets num_records records, laid out pid after
+ * pid in records, and its return code in results.
+ */
+int kgsl_memtrack_get_memory_batch(const pid_t *pids, size_t num_pids,
+                                   enum memtrack_type type,
+                                   struct memtrack_record *records,
+                                   size_t num_records, int *results);
+
+/*
+ * Batched getMemory() for a caller that walks every process, as the memtrack service does for
+ * dumpsys meminfo. The legacy HAL has no entry point for it, so the symbol is exported from the
+ * module and looked up with dlsym(module->common.dso, "msm_memtrack_get_memory_batch").
+ * Returns -EINVAL for a type getMemory() does not report, 0 otherwise.
+ */
+int msm_memtrack_get_memory_batch(const struct memtrack_module *module,
+                                  const pid_t *pids, size_t num_pids, int type,
+                                  struct memtrack_record *records,
+                                  size_t num_records, int *results);
+
 #endif
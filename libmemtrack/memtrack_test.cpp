@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2021 The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs the HAL against a tree of regular files under KGSL_PROC_PATH standing in for the kgsl
+// sysfs nodes.
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include <hardware/memtrack.h>
+
+#include <string>
+
+extern "C" struct memtrack_module HAL_MODULE_INFO_SYM;
+extern "C" int msm_memtrack_get_memory_batch(const struct memtrack_module *module,
+                                             const pid_t *pids, size_t num_pids, int type,
+                                             struct memtrack_record *records,
+                                             size_t num_records, int *results);
+
+namespace {
+
+std::string NodePath(pid_t pid, const char *node) {
+  return std::string(KGSL_PROC_PATH) + "/" + std::to_string(pid) + "/" + node;
+}
+
+void MakeDirs(const std::string &path) {
+  for (size_t pos = 1; pos != std::string::npos; pos = path.find('/', pos + 1)) {
+    mkdir(path.substr(0, pos).c_str(), 0755);
+  }
+}
+
+void WriteNode(pid_t pid, const char *node, const std::string &contents) {
+  std::string path = NodePath(pid, node);
+  MakeDirs(path);
+  FILE *file = fopen(path.c_str(), "w");
+  ASSERT_NE(nullptr, file) << path;
+  fputs(contents.c_str(), file);
+  fclose(file);
+}
+
+void WriteProc(pid_t pid, size_t mapped, size_t unmapped, size_t imported) {
+  WriteNode(pid, "gpumem_mapped", std::to_string(mapped) + "\n");
+  WriteNode(pid, "gpumem_unmapped", std::to_string(unmapped) + "\n");
+  WriteNode(pid, "imported_mem", std::to_string(imported) + "\n");
+}
+
+void RemoveProc(pid_t pid) {
+  unlink(NodePath(pid, "gpumem_mapped").c_str());
+  unlink(NodePath(pid, "gpumem_unmapped").c_str());
+  unlink(NodePath(pid, "imported_mem").c_str());
+  rmdir((std::string(KGSL_PROC_PATH) + "/" + std::to_string(pid)).c_str());
+}
+
+size_t OpenFds() {
+  size_t count = 0;
+  DIR *dir = opendir("/proc/self/fd");
+  if (dir) {
+    while (readdir(dir)) {
+      count++;
+    }
+    closedir(dir);
+  }
+  return count;
+}
+
+int GetMemory(pid_t pid, int type, memtrack_record *records, size_t *num_records) {
+  return HAL_MODULE_INFO_SYM.getMemory(&HAL_MODULE_INFO_SYM, pid, type, records, num_records);
+}
+
+class MemtrackTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(0, HAL_MODULE_INFO_SYM.init(&HAL_MODULE_INFO_SYM));
+  }
+};
+
+TEST_F(MemtrackTest, ReportsGlMemory) {
+  WriteProc(100, 4096, 8192, 0);
+
+  memtrack_record records[2] = {};
+  size_t num_records = 2;
+  ASSERT_EQ(0, GetMemory(100, MEMTRACK_TYPE_GL, records, &num_records));
+  EXPECT_EQ(2U, num_records);
+  EXPECT_EQ(4096U, records[0].size_in_bytes);
+  EXPECT_EQ(8192U, records[1].size_in_bytes);
+  EXPECT_TRUE(records[0].flags & MEMTRACK_FLAG_SMAPS_ACCOUNTED);
+  EXPECT_TRUE(records[1].flags & MEMTRACK_FLAG_SMAPS_UNACCOUNTED);
+}
+
+TEST_F(MemtrackTest, ReportsImportedGraphicsMemory) {
+  WriteProc(101, 1, 2, 65536);
+
+  memtrack_record records[2] = {};
+  size_t num_records = 2;
+  ASSERT_EQ(0, GetMemory(101, MEMTRACK_TYPE_GRAPHICS, records, &num_records));
+  EXPECT_EQ(0U, records[0].size_in_bytes);
+  EXPECT_EQ(65536U, records[1].size_in_bytes);
+}
+
+TEST_F(MemtrackTest, ReturnsRecordCountWithoutReading) {
+  memtrack_record record = {};
+  size_t num_records = 0;
+  EXPECT_EQ(0, GetMemory(102, MEMTRACK_TYPE_GL, &record, &num_records));
+  EXPECT_EQ(2U, num_records);
+
+  WriteProc(102, 10, 20, 0);
+  num_records = 1;
+  ASSERT_EQ(0, GetMemory(102, MEMTRACK_TYPE_GL, &record, &num_records));
+  EXPECT_EQ(2U, num_records);
+  EXPECT_EQ(10U, record.size_in_bytes);
+}
+
+TEST_F(MemtrackTest, RejectsInvalidQueries) {
+  memtrack_record records[2] = {};
+  size_t num_records = 2;
+  EXPECT_EQ(-EINVAL, GetMemory(0, MEMTRACK_TYPE_GL, records, &num_records));
+  EXPECT_EQ(-EINVAL, GetMemory(100, MEMTRACK_TYPE_OTHER, records, &num_records));
+  EXPECT_EQ(-ENOENT, GetMemory(103, MEMTRACK_TYPE_GL, records, &num_records));
+}
+
+TEST_F(MemtrackTest, RejectsMalformedValues) {
+  memtrack_record records[2] = {};
+  size_t num_records = 2;
+
+  WriteProc(104, 0, 0, 0);
+  WriteNode(104, "gpumem_mapped", "abc\n");
+  EXPECT_EQ(-EINVAL, GetMemory(104, MEMTRACK_TYPE_GL, records, &num_records));
+  WriteNode(104, "gpumem_mapped", "");
+  EXPECT_EQ(-EINVAL, GetMemory(104, MEMTRACK_TYPE_GL, records, &num_records));
+  WriteNode(104, "gpumem_mapped", "99999999999999999999999999\n");
+  EXPECT_EQ(-EINVAL, GetMemory(104, MEMTRACK_TYPE_GL, records, &num_records));
+
+  WriteNode(104, "gpumem_mapped", "  123\n");
+  ASSERT_EQ(0, GetMemory(104, MEMTRACK_TYPE_GL, records, &num_records));
+  EXPECT_EQ(123U, records[0].size_in_bytes);
+}
+
+TEST_F(MemtrackTest, RereadsCachedNodes) {
+  memtrack_record records[2] = {};
+  size_t num_records = 2;
+
+  WriteProc(105, 1000, 2000, 0);
+  ASSERT_EQ(0, GetMemory(105, MEMTRACK_TYPE_GL, records, &num_records));
+  EXPECT_EQ(1000U, records[0].size_in_bytes);
+
+  // Rewritten in place, as the kernel does, through the fd kept open since the first query
+  WriteProc(105, 5, 2000, 0);
+  ASSERT_EQ(0, GetMemory(105, MEMTRACK_TYPE_GL, records, &num_records));
+  EXPECT_EQ(5U, records[0].size_in_bytes);
+}
+
+TEST_F(MemtrackTest, QueriesProcessesInOneBatch) {
+  WriteProc(106, 100, 200, 0);
+  WriteProc(108, 300, 400, 0);
+
+  const pid_t pids[] = {106, 107, 108};
+  memtrack_record records[3 * 2] = {};
+  int results[3] = {};
+  ASSERT_EQ(0, msm_memtrack_get_memory_batch(&HAL_MODULE_INFO_SYM, pids, 3, MEMTRACK_TYPE_GL,
+                                             records, 2, results));
+  EXPECT_EQ(0, results[0]);
+  EXPECT_EQ(-ENOENT, results[1]);
+  EXPECT_EQ(0, results[2]);
+  EXPECT_EQ(100U, records[0].size_in_bytes);
+  EXPECT_EQ(200U, records[1].size_in_bytes);
+  EXPECT_EQ(300U, records[4].size_in_bytes);
+  EXPECT_EQ(400U, records[5].size_in_bytes);
+  EXPECT_TRUE(records[5].flags & MEMTRACK_FLAG_SMAPS_UNACCOUNTED);
+
+  EXPECT_EQ(-EINVAL, msm_memtrack_get_memory_batch(&HAL_MODULE_INFO_SYM, pids, 3,
+                                                   MEMTRACK_TYPE_OTHER, records, 2, results));
+  EXPECT_EQ(-EINVAL, msm_memtrack_get_memory_batch(&HAL_MODULE_INFO_SYM, pids, 3,
+                                                   MEMTRACK_TYPE_GL, nullptr, 2, results));
+
+  RemoveProc(106);
+  RemoveProc(108);
+}
+
+TEST_F(MemtrackTest, ReopensNodesOfEvictedProcesses) {
+  const pid_t kFirstPid = 1000;
+  const pid_t kPids = 200;
+  for (pid_t pid = kFirstPid; pid < kFirstPid + kPids; pid++) {
+    WriteProc(pid, static_cast<size_t>(pid), static_cast<size_t>(pid) * 2, 0);
+  }
+
+  size_t fds = OpenFds();
+  for (int pass = 0; pass < 2; pass++) {
+    for (pid_t pid = kFirstPid; pid < kFirstPid + kPids; pid++) {
+      memtrack_record records[2] = {};
+      size_t num_records = 2;
+      ASSERT_EQ(0, GetMemory(pid, MEMTRACK_TYPE_GL, records, &num_records)) << pid;
+      EXPECT_EQ(static_cast<size_t>(pid), records[0].size_in_bytes);
+      EXPECT_EQ(static_cast<size_t>(pid) * 2, records[1].size_in_bytes);
+    }
+  }
+  // Nodes stay open for a bounded number of processes only
+  EXPECT_LE(OpenFds(), fds + 64 * 3);
+
+  for (pid_t pid = kFirstPid; pid < kFirstPid + kPids; pid++) {
+    RemoveProc(pid);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,1005 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <utility>
+
+#include "qdcm_calib_compiler.h"
+
+namespace qdcm {
+
+namespace {
+
+const int kMaxXmlDepth = 16;
+
+// Value ranges of the feature payloads whose layout is known: a few header words followed by
+// fixed size entries whose words must not exceed max_value.
+struct FeatureRule {
+  uint32_t type;
+  const char *name;
+  uint32_t header_words;
+  uint32_t entry_words;
+  uint32_t max_value;
+};
+
+const FeatureRule kFeatureRules[] = {
+  {3, "17x17x17 3D LUT", 4, 6, 4096},
+  {4, "13x13x13 3D LUT", 4, 6, 4096},
+  {7, "12 bit 1D LUT", 3, 1, 4095},
+  {8, "10 bit 1D LUT", 3, 1, 1023},
+};
+
+// Type 0 LUT packets are an int32 key followed by three float gains in [0, 1].
+const uint32_t kGainLutType = 0;
+const uint32_t kGainLutPacketSize = 16;
+
+void AddError(std::vector<std::string> *errors, const char *format, ...) {
+  if (!errors) {
+    return;
+  }
+
+  char buffer[256];
+  va_list list;
+  va_start(list, format);
+  vsnprintf(buffer, sizeof(buffer), format, list);
+  va_end(list);
+  errors->push_back(buffer);
+}
+
+struct XmlNode {
+  std::string name;
+  std::vector<std::pair<std::string, std::string>> attributes;
+  std::string text;
+  std::vector<XmlNode> children;
+  int line = 0;
+};
+
+// Reads the subset of XML the calibration files use: a prolog, comments, elements, attributes
+// and character data. DTDs and processing instructions after the prolog are skipped.
+class XmlReader {
+ public:
+  XmlReader(const std::string &in, std::vector<std::string> *errors)
+    : in_(in), errors_(errors) {}
+  bool Parse(XmlNode *root);
+
+ private:
+  bool StartsWith(const char *token) const { return in_.compare(pos_, strlen(token), token) == 0; }
+  bool SkipPast(const char *token);
+  void SkipSpace();
+  bool ReadName(std::string *name);
+  bool ReadAttributeValue(std::string *value);
+  bool ReadElement(XmlNode *node, int depth);
+  bool Fail(const char *what);
+
+  const std::string &in_;
+  std::vector<std::string> *errors_;
+  size_t pos_ = 0;
+  int line_ = 1;
+};
+
+bool XmlReader::Fail(const char *what) {
+  AddError(errors_, "line %d: %s", line_, what);
+  return false;
+}
+
+bool XmlReader::SkipPast(const char *token) {
+  size_t end = in_.find(token, pos_);
+  if (end == std::string::npos) {
+    return Fail("unterminated markup");
+  }
+
+  end += strlen(token);
+  for (; pos_ < end; pos_++) {
+    line_ += (in_[pos_] == '\n');
+  }
+
+  return true;
+}
+
+void XmlReader::SkipSpace() {
+  for (; pos_ < in_.size() && isspace(static_cast<unsigned char>(in_[pos_])); pos_++) {
+    line_ += (in_[pos_] == '\n');
+  }
+}
+
+bool XmlReader::ReadName(std::string *name) {
+  size_t start = pos_;
+  while (pos_ < in_.size()) {
+    char c = in_[pos_];
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-' && c != '.' && c != ':') {
+      break;
+    }
+    pos_++;
+  }
+
+  if (pos_ == start) {
+    return Fail("expected a name");
+  }
+
+  name->assign(in_, start, pos_ - start);
+  return true;
+}
+
+bool XmlReader::ReadAttributeValue(std::string *value) {
+  if (pos_ >= in_.size() || (in_[pos_] != '"' && in_[pos_] != '\'')) {
+    return Fail("expected a quoted attribute value");
+  }
+
+  char quote = in_[pos_++];
+  size_t end = in_.find(quote, pos_);
+  if (end == std::string::npos) {
+    return Fail("unterminated attribute value");
+  }
+
+  static const std::pair<const char *, char> kEntities[] = {
+    {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''},
+  };
+
+  value->clear();
+  while (pos_ < end) {
+    if (in_[pos_] == '&') {
+      bool found = false;
+      for (auto &entity : kEntities) {
+        if (StartsWith(entity.first)) {
+          value->push_back(entity.second);
+          pos_ += strlen(entity.first);
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        return Fail("unsupported entity in attribute value");
+      }
+      continue;
+    }
+    line_ += (in_[pos_] == '\n');
+    value->push_back(in_[pos_++]);
+  }
+  pos_++;
+
+  return true;
+}
+
+bool XmlReader::ReadElement(XmlNode *node, int depth) {
+  if (depth > kMaxXmlDepth) {
+    return Fail("elements nested too deep");
+  }
+
+  node->line = line_;
+  pos_++;  // '<'
+  if (!ReadName(&node->name)) {
+    return false;
+  }
+
+  while (true) {
+    SkipSpace();
+    if (pos_ >= in_.size()) {
+      return Fail("unterminated start tag");
+    }
+    if (StartsWith("/>")) {
+      pos_ += 2;
+      return true;
+    }
+    if (in_[pos_] == '>') {
+      pos_++;
+      break;
+    }
+
+    std::pair<std::string, std::string> attribute;
+    if (!ReadName(&attribute.first)) {
+      return false;
+    }
+    SkipSpace();
+    if (pos_ >= in_.size() || in_[pos_] != '=') {
+      return Fail("expected '=' after attribute name");
+    }
+    pos_++;
+    SkipSpace();
+    if (!ReadAttributeValue(&attribute.second)) {
+      return false;
+    }
+    for (auto &existing : node->attributes) {
+      if (existing.first == attribute.first) {
+        return Fail("duplicate attribute");
+      }
+    }
+    node->attributes.push_back(std::move(attribute));
+  }
+
+  while (pos_ < in_.size()) {
+    size_t lt = in_.find('<', pos_);
+    if (lt == std::string::npos) {
+      break;
+    }
+    for (; pos_ < lt; pos_++) {
+      line_ += (in_[pos_] == '\n');
+      if (!isspace(static_cast<unsigned char>(in_[pos_]))) {
+        node->text.push_back(in_[pos_]);
+      }
+    }
+
+    if (StartsWith("<!--")) {
+      if (!SkipPast("-->")) {
+        return false;
+      }
+    } else if (StartsWith("</")) {
+      pos_ += 2;
+      std::string name;
+      if (!ReadName(&name)) {
+        return false;
+      }
+      if (name != node->name) {
+        return Fail("mismatched end tag");
+      }
+      SkipSpace();
+      if (pos_ >= in_.size() || in_[pos_] != '>') {
+        return Fail("unterminated end tag");
+      }
+      pos_++;
+      return true;
+    } else {
+      node->children.emplace_back();
+      if (!ReadElement(&node->children.back(), depth + 1)) {
+        return false;
+      }
+    }
+  }
+
+  return Fail("missing end tag");
+}
+
+bool XmlReader::Parse(XmlNode *root) {
+  while (true) {
+    SkipSpace();
+    if (StartsWith("<?")) {
+      if (!SkipPast("?>")) {
+        return false;
+      }
+    } else if (StartsWith("<!--")) {
+      if (!SkipPast("-->")) {
+        return false;
+      }
+    } else if (StartsWith("<!")) {
+      if (!SkipPast(">")) {
+        return false;
+      }
+    } else {
+      break;
+    }
+  }
+
+  if (pos_ >= in_.size() || in_[pos_] != '<') {
+    return Fail("expected the root element");
+  }
+
+  if (!ReadElement(root, 0)) {
+    return false;
+  }
+
+  while (true) {
+    SkipSpace();
+    if (pos_ >= in_.size()) {
+      return true;
+    }
+    if (StartsWith("<!--")) {
+      if (!SkipPast("-->")) {
+        return false;
+      }
+    } else {
+      return Fail("content after the root element");
+    }
+  }
+}
+
+// Pulls typed attributes out of one element, recording every problem it meets.
+class AttributeReader {
+ public:
+  AttributeReader(const XmlNode &node, std::vector<std::string> *errors)
+    : node_(node), errors_(errors), used_(node.attributes.size(), false) {}
+
+  bool GetString(const char *name, bool required, std::string *value);
+  bool GetInt(const char *name, bool required, int32_t *value);
+  bool GetUint(const char *name, bool required, uint32_t *value);
+  bool GetBool(const char *name, bool required, bool *value);
+  // Reports attributes that none of the getters asked for.
+  bool CheckUnused();
+
+ private:
+  const std::string *Find(const char *name, bool required);
+  bool ParseInt(const char *name, const std::string &text, int64_t min, int64_t max,
+                int64_t *value);
+
+  const XmlNode &node_;
+  std::vector<std::string> *errors_;
+  std::vector<bool> used_;
+  bool ok_ = true;
+};
+
+const std::string *AttributeReader::Find(const char *name, bool required) {
+  for (size_t i = 0; i < node_.attributes.size(); i++) {
+    if (node_.attributes[i].first == name) {
+      used_[i] = true;
+      return &node_.attributes[i].second;
+    }
+  }
+
+  if (required) {
+    AddError(errors_, "line %d: <%s> is missing %s", node_.line, node_.name.c_str(), name);
+    ok_ = false;
+  }
+
+  return nullptr;
+}
+
+bool AttributeReader::ParseInt(const char *name, const std::string &text, int64_t min,
+                               int64_t max, int64_t *value) {
+  const char *begin = text.c_str();
+  char *end = nullptr;
+  errno = 0;
+  long long parsed = strtoll(begin, &end, 10);
+  if (text.empty() || *end || errno || parsed < min || parsed > max) {
+    AddError(errors_, "line %d: <%s> %s=\"%s\" is not a valid number", node_.line,
+             node_.name.c_str(), name, text.c_str());
+    ok_ = false;
+    return false;
+  }
+
+  *value = parsed;
+  return true;
+}
+
+bool AttributeReader::GetString(const char *name, bool required, std::string *value) {
+  const std::string *text = Find(name, required);
+  if (text) {
+    *value = *text;
+  }
+
+  return text != nullptr;
+}
+
+bool AttributeReader::GetInt(const char *name, bool required, int32_t *value) {
+  const std::string *text = Find(name, required);
+  int64_t parsed = 0;
+  if (!text || !ParseInt(name, *text, INT32_MIN, INT32_MAX, &parsed)) {
+    return false;
+  }
+
+  *value = static_cast<int32_t>(parsed);
+  return true;
+}
+
+bool AttributeReader::GetUint(const char *name, bool required, uint32_t *value) {
+  const std::string *text = Find(name, required);
+  int64_t parsed = 0;
+  if (!text || !ParseInt(name, *text, 0, UINT32_MAX, &parsed)) {
+    return false;
+  }
+
+  *value = static_cast<uint32_t>(parsed);
+  return true;
+}
+
+bool AttributeReader::GetBool(const char *name, bool required, bool *value) {
+  const std::string *text = Find(name, required);
+  if (!text) {
+    return false;
+  }
+
+  if (*text == "1" || *text == "true") {
+    *value = true;
+  } else if (*text == "0" || *text == "false") {
+    *value = false;
+  } else {
+    AddError(errors_, "line %d: <%s> %s=\"%s\" is not a boolean", node_.line,
+             node_.name.c_str(), name, text->c_str());
+    ok_ = false;
+    return false;
+  }
+
+  return true;
+}
+
+bool AttributeReader::CheckUnused() {
+  for (size_t i = 0; i < used_.size(); i++) {
+    if (!used_[i]) {
+      AddError(errors_, "line %d: <%s> has unknown attribute %s", node_.line, node_.name.c_str(),
+               node_.attributes[i].first.c_str());
+      ok_ = false;
+    }
+  }
+
+  return ok_;
+}
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+
+  return -1;
+}
+
+bool DecodeHex(const XmlNode &node, uint32_t expected_size, std::vector<uint8_t> *data,
+               std::vector<std::string> *errors) {
+  const std::string &text = node.text;
+  if (text.size() % 2) {
+    AddError(errors, "line %d: <%s> payload has an odd number of hex digits", node.line,
+             node.name.c_str());
+    return false;
+  }
+
+  if (expected_size != kCalibInvalidIndex && text.size() / 2 != expected_size) {
+    AddError(errors, "line %d: <%s> payload is %zu bytes, DataSize says %u", node.line,
+             node.name.c_str(), text.size() / 2, expected_size);
+    return false;
+  }
+
+  data->resize(text.size() / 2);
+  for (size_t i = 0; i < data->size(); i++) {
+    int high = HexValue(text[2 * i]);
+    int low = HexValue(text[2 * i + 1]);
+    if (high < 0 || low < 0) {
+      AddError(errors, "line %d: <%s> payload has a non hex digit at byte %zu", node.line,
+               node.name.c_str(), i);
+      return false;
+    }
+    (*data)[i] = static_cast<uint8_t>((high << 4) | low);
+  }
+
+  return true;
+}
+
+bool ParseFeature(const XmlNode &node, CalibFeature *feature, std::vector<std::string> *errors) {
+  AttributeReader reader(node, errors);
+  uint32_t data_size = 0;
+  feature->line = node.line;
+  reader.GetUint("FeatureType", true, &feature->type);
+  reader.GetBool("Disable", true, &feature->disabled);
+  bool has_size = reader.GetUint("DataSize", true, &data_size);
+  bool ok = reader.CheckUnused();
+
+  if (!node.children.empty()) {
+    AddError(errors, "line %d: <Feature> must not have child elements", node.line);
+    ok = false;
+  }
+
+  return DecodeHex(node, has_size ? data_size : kCalibInvalidIndex, &feature->data, errors) && ok;
+}
+
+bool ParseMode(const XmlNode &node, CalibMode *mode, std::vector<std::string> *errors) {
+  AttributeReader reader(node, errors);
+  mode->line = node.line;
+  reader.GetInt("ModeID", true, &mode->mode_id);
+  reader.GetInt("DisplayID", true, &mode->display_id);
+  reader.GetBool("IsDefaultMode", true, &mode->is_default);
+  reader.GetBool("IsAppMode", true, &mode->is_app);
+  reader.GetBool("IsMerge", false, &mode->is_merge);
+  reader.GetString("Name", true, &mode->name);
+  reader.GetUint("NumOfFeatures", true, &mode->num_of_features);
+  reader.GetInt("WhitePoint", true, &mode->white_point);
+  reader.GetInt("EValue", true, &mode->e_value);
+  reader.GetInt("BValue", true, &mode->b_value);
+  reader.GetInt("RValue", true, &mode->r_value);
+  reader.GetString("DynamicRange", true, &mode->dynamic_range);
+  reader.GetString("ColorGamut", true, &mode->color_gamut);
+  reader.GetString("PictureQuality", false, &mode->picture_quality);
+  mode->has_render_intent = reader.GetInt("RenderIntent", false, &mode->render_intent);
+  bool ok = reader.CheckUnused();
+
+  for (auto &child : node.children) {
+    if (child.name != "Feature") {
+      AddError(errors, "line %d: unexpected <%s> in <Mode>", child.line, child.name.c_str());
+      ok = false;
+      continue;
+    }
+    mode->features.emplace_back();
+    ok = ParseFeature(child, &mode->features.back(), errors) && ok;
+  }
+
+  return ok;
+}
+
+bool ParseLut(const XmlNode &node, CalibLut *lut, std::vector<std::string> *errors) {
+  AttributeReader reader(node, errors);
+  lut->line = node.line;
+  reader.GetUint("Type", true, &lut->type);
+  reader.GetUint("NumPackets", true, &lut->num_packets);
+  bool ok = reader.CheckUnused();
+
+  return DecodeHex(node, kCalibInvalidIndex, &lut->data, errors) && ok;
+}
+
+uint32_t ReadWord(const std::vector<uint8_t> &data, size_t offset) {
+  uint32_t word = 0;
+  memcpy(&word, &data[offset], sizeof(word));
+  return word;
+}
+
+void ValidateFeaturePayload(const CalibMode &mode, const CalibFeature &feature,
+                            std::vector<std::string> *errors, uint32_t *count) {
+  for (auto &rule : kFeatureRules) {
+    if (rule.type != feature.type || feature.data.empty()) {
+      continue;
+    }
+
+    size_t header_size = rule.header_words * sizeof(uint32_t);
+    size_t entry_size = rule.entry_words * sizeof(uint32_t);
+    if (feature.data.size() < header_size || (feature.data.size() - header_size) % entry_size) {
+      AddError(errors, "line %d: mode %d feature %u (%s) has a malformed size of %zu bytes",
+               feature.line, mode.mode_id, feature.type, rule.name, feature.data.size());
+      (*count)++;
+      return;
+    }
+
+    for (size_t offset = header_size; offset < feature.data.size(); offset += sizeof(uint32_t)) {
+      uint32_t value = ReadWord(feature.data, offset);
+      if (value > rule.max_value) {
+        AddError(errors, "line %d: mode %d feature %u (%s) value %u at byte %zu exceeds %u",
+                 feature.line, mode.mode_id, feature.type, rule.name, value, offset,
+                 rule.max_value);
+        (*count)++;
+        return;
+      }
+    }
+  }
+}
+
+void ValidateLutPayload(const CalibLut &lut, std::vector<std::string> *errors, uint32_t *count) {
+  if (lut.type != kGainLutType) {
+    if (lut.num_packets && lut.data.size() % lut.num_packets) {
+      AddError(errors, "line %d: lut %u size %zu is not a multiple of %u packets", lut.line,
+               lut.type, lut.data.size(), lut.num_packets);
+      (*count)++;
+    }
+    return;
+  }
+
+  if (lut.data.size() != size_t(lut.num_packets) * kGainLutPacketSize) {
+    AddError(errors, "line %d: lut %u is %zu bytes, %u packets need %zu", lut.line, lut.type,
+             lut.data.size(), lut.num_packets, size_t(lut.num_packets) * kGainLutPacketSize);
+    (*count)++;
+    return;
+  }
+
+  for (size_t packet = 0; packet < lut.num_packets; packet++) {
+    for (size_t i = 1; i < kGainLutPacketSize / sizeof(float); i++) {
+      float gain = 0.0f;
+      memcpy(&gain, &lut.data[packet * kGainLutPacketSize + i * sizeof(float)], sizeof(gain));
+      if (!(gain >= 0.0f && gain <= 1.0f)) {
+        AddError(errors, "line %d: lut %u packet %zu gain %f is outside [0, 1]", lut.line,
+                 lut.type, packet, static_cast<double>(gain));
+        (*count)++;
+        return;
+      }
+    }
+  }
+}
+
+void Align(std::vector<uint8_t> *image) {
+  image->resize((image->size() + kCalibAlignment - 1) / kCalibAlignment * kCalibAlignment, 0);
+}
+
+uint32_t Append(std::vector<uint8_t> *image, const void *data, size_t size) {
+  Align(image);
+  uint32_t offset = static_cast<uint32_t>(image->size());
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  image->insert(image->end(), bytes, bytes + size);
+  return offset;
+}
+
+template <class T>
+T *At(std::vector<uint8_t> *image, uint32_t offset) {
+  return reinterpret_cast<T *>(image->data() + offset);
+}
+
+}  // namespace
+
+int ParseCalibXml(const std::string &xml, CalibData *data, std::vector<std::string> *errors) {
+  XmlNode root;
+  XmlReader reader(xml, errors);
+  if (!reader.Parse(&root)) {
+    return -EINVAL;
+  }
+
+  if (root.name != "Calib_Data") {
+    AddError(errors, "line %d: root element is <%s>, expected <Calib_Data>", root.line,
+             root.name.c_str());
+    return -EINVAL;
+  }
+
+  *data = CalibData();
+  bool ok = true;
+  bool has_modes = false;
+  bool has_luts = false;
+  for (auto &section : root.children) {
+    AttributeReader attributes(section, errors);
+    if (section.name == "Disp_Modes" && !has_modes) {
+      has_modes = true;
+      attributes.GetUint("NumModes", true, &data->num_modes);
+      attributes.GetInt("DefaultMode", true, &data->default_mode_id);
+      ok = attributes.CheckUnused() && ok;
+      for (auto &child : section.children) {
+        if (child.name != "Mode") {
+          AddError(errors, "line %d: unexpected <%s> in <Disp_Modes>", child.line,
+                   child.name.c_str());
+          ok = false;
+          continue;
+        }
+        data->modes.emplace_back();
+        ok = ParseMode(child, &data->modes.back(), errors) && ok;
+      }
+    } else if (section.name == "Luts" && !has_luts) {
+      has_luts = true;
+      attributes.GetUint("NumLuts", true, &data->num_luts);
+      ok = attributes.CheckUnused() && ok;
+      for (auto &child : section.children) {
+        if (child.name != "Lut") {
+          AddError(errors, "line %d: unexpected <%s> in <Luts>", child.line, child.name.c_str());
+          ok = false;
+          continue;
+        }
+        data->luts.emplace_back();
+        ok = ParseLut(child, &data->luts.back(), errors) && ok;
+      }
+    } else {
+      AddError(errors, "line %d: unexpected or repeated <%s> in <Calib_Data>", section.line,
+               section.name.c_str());
+      ok = false;
+    }
+  }
+
+  if (!has_modes) {
+    AddError(errors, "<Calib_Data> has no <Disp_Modes>");
+    ok = false;
+  }
+
+  return ok ? 0 : -EINVAL;
+}
+
+int ParseCalibXmlFile(const std::string &path, CalibData *data, std::vector<std::string> *errors) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    AddError(errors, "%s: cannot open", path.c_str());
+    return -ENOENT;
+  }
+
+  std::stringstream contents;
+  contents << file.rdbuf();
+
+  return ParseCalibXml(contents.str(), data, errors);
+}
+
+uint32_t ValidateCalibData(const CalibData &data, std::vector<std::string> *errors) {
+  uint32_t count = 0;
+
+  if (data.num_modes != data.modes.size()) {
+    AddError(errors, "NumModes is %u but %zu modes are present", data.num_modes,
+             data.modes.size());
+    count++;
+  }
+
+  std::map<int32_t, int> mode_lines;
+  for (auto &mode : data.modes) {
+    auto inserted = mode_lines.insert(std::make_pair(mode.mode_id, mode.line));
+    if (!inserted.second) {
+      AddError(errors, "line %d: duplicate ModeID %d, first defined on line %d", mode.line,
+               mode.mode_id, inserted.first->second);
+      count++;
+    }
+
+    if (mode.name.empty()) {
+      AddError(errors, "line %d: mode %d has an empty Name", mode.line, mode.mode_id);
+      count++;
+    }
+
+    std::set<uint32_t> types;
+    for (auto &feature : mode.features) {
+      if (feature.type >= kCalibFeatureSlots) {
+        AddError(errors, "line %d: mode %d FeatureType %u is out of range [0, %u)", feature.line,
+                 mode.mode_id, feature.type, kCalibFeatureSlots);
+        count++;
+        continue;
+      }
+      if (!types.insert(feature.type).second) {
+        AddError(errors, "line %d: mode %d has FeatureType %u more than once", feature.line,
+                 mode.mode_id, feature.type);
+        count++;
+      }
+      ValidateFeaturePayload(mode, feature, errors, &count);
+    }
+  }
+
+  if (!mode_lines.empty()) {
+    int64_t span = int64_t(mode_lines.rbegin()->first) - mode_lines.begin()->first + 1;
+    if (span > kCalibMaxModeIdSpan) {
+      AddError(errors, "ModeIDs span %lld values, at most %u are supported",
+               static_cast<long long>(span), kCalibMaxModeIdSpan);
+      count++;
+    }
+    if (!mode_lines.count(data.default_mode_id)) {
+      AddError(errors, "DefaultMode %d is not a defined ModeID", data.default_mode_id);
+      count++;
+    }
+  }
+
+  if (data.num_luts != data.luts.size()) {
+    AddError(errors, "NumLuts is %u but %zu luts are present", data.num_luts, data.luts.size());
+    count++;
+  }
+
+  std::set<uint32_t> lut_types;
+  for (auto &lut : data.luts) {
+    if (lut.type >= kCalibLutSlots) {
+      AddError(errors, "line %d: lut Type %u is out of range [0, %u)", lut.line, lut.type,
+               kCalibLutSlots);
+      count++;
+      continue;
+    }
+    if (!lut_types.insert(lut.type).second) {
+      AddError(errors, "line %d: lut Type %u is defined more than once", lut.line, lut.type);
+      count++;
+    }
+    ValidateLutPayload(lut, errors, &count);
+  }
+
+  return count;
+}
+
+int CompileCalibData(const CalibData &data, std::vector<uint8_t> *image,
+                     std::vector<std::string> *errors) {
+  if (ValidateCalibData(data, errors)) {
+    return -EINVAL;
+  }
+
+  uint32_t num_features = 0;
+  int32_t min_mode_id = data.modes.empty() ? 0 : INT32_MAX;
+  int32_t max_mode_id = data.modes.empty() ? -1 : INT32_MIN;
+  for (auto &mode : data.modes) {
+    num_features += static_cast<uint32_t>(mode.features.size());
+    min_mode_id = std::min(min_mode_id, mode.mode_id);
+    max_mode_id = std::max(max_mode_id, mode.mode_id);
+  }
+
+  CalibHeader header = {};
+  header.magic = kCalibMagic;
+  header.version_major = kCalibVersionMajor;
+  header.version_minor = kCalibVersionMinor;
+  header.default_mode_id = data.default_mode_id;
+  header.num_modes = static_cast<uint32_t>(data.modes.size());
+  header.min_mode_id = min_mode_id;
+  header.mode_index_size = static_cast<uint32_t>(int64_t(max_mode_id) - min_mode_id + 1);
+  header.num_features = num_features;
+  header.num_luts = static_cast<uint32_t>(data.luts.size());
+  for (auto &slot : header.lut_slot) {
+    slot = kCalibInvalidIndex;
+  }
+
+  image->clear();
+  Append(image, &header, sizeof(header));
+  std::vector<uint32_t> mode_index(header.mode_index_size, kCalibInvalidIndex);
+  header.mode_index_offset = Append(image, mode_index.data(),
+                                    mode_index.size() * sizeof(uint32_t));
+  header.modes_offset = Append(image, nullptr, 0);
+  image->resize(image->size() + data.modes.size() * sizeof(CalibModeEntry), 0);
+  header.features_offset = Append(image, nullptr, 0);
+  image->resize(image->size() + num_features * sizeof(CalibFeatureEntry), 0);
+  header.luts_offset = Append(image, nullptr, 0);
+  image->resize(image->size() + data.luts.size() * sizeof(CalibLutEntry), 0);
+
+  // Strings and payloads are shared between modes; tuning tools repeat the same LUTs a lot.
+  std::map<std::string, uint32_t> string_offsets = {{"", 0}};
+  std::string strings(1, '\0');
+  auto add_string = [&](const std::string &value) {
+    auto it = string_offsets.find(value);
+    if (it != string_offsets.end()) {
+      return it->second;
+    }
+    uint32_t offset = static_cast<uint32_t>(strings.size());
+    strings.append(value.c_str(), value.size() + 1);
+    string_offsets[value] = offset;
+    return offset;
+  };
+
+  std::vector<CalibModeEntry> modes(data.modes.size());
+  uint32_t feature_index = 0;
+  for (size_t i = 0; i < data.modes.size(); i++) {
+    const CalibMode &mode = data.modes[i];
+    CalibModeEntry &entry = modes[i];
+    entry.mode_id = mode.mode_id;
+    entry.display_id = mode.display_id;
+    entry.flags = (mode.is_default ? kCalibModeDefault : 0) | (mode.is_app ? kCalibModeApp : 0) |
+                  (mode.is_merge ? kCalibModeMerge : 0) |
+                  (mode.has_render_intent ? kCalibModeHasRenderIntent : 0);
+    entry.name = add_string(mode.name);
+    entry.dynamic_range = add_string(mode.dynamic_range);
+    entry.color_gamut = add_string(mode.color_gamut);
+    entry.picture_quality = add_string(mode.picture_quality);
+    entry.white_point = mode.white_point;
+    entry.e_value = mode.e_value;
+    entry.b_value = mode.b_value;
+    entry.r_value = mode.r_value;
+    entry.render_intent = mode.render_intent;
+    entry.num_of_features = mode.num_of_features;
+    entry.first_feature = feature_index;
+    entry.feature_count = static_cast<uint32_t>(mode.features.size());
+    for (auto &slot : entry.feature_slot) {
+      slot = kCalibInvalidIndex;
+    }
+    for (auto &feature : mode.features) {
+      entry.feature_slot[feature.type] = feature_index++;
+    }
+    mode_index[static_cast<size_t>(int64_t(mode.mode_id) - min_mode_id)] =
+        static_cast<uint32_t>(i);
+  }
+
+  header.strings_offset = Append(image, strings.data(), strings.size());
+  header.strings_size = static_cast<uint32_t>(strings.size());
+
+  std::map<uint32_t, std::vector<std::pair<const std::vector<uint8_t> *, uint32_t>>> payloads;
+  auto add_payload = [&](const std::vector<uint8_t> &payload) {
+    if (payload.empty()) {
+      return uint32_t(0);
+    }
+    uint32_t crc = CalibCrc32(0, payload.data(), static_cast<uint32_t>(payload.size()));
+    auto &candidates = payloads[crc];
+    for (auto &candidate : candidates) {
+      if (*candidate.first == payload) {
+        return candidate.second;
+      }
+    }
+    uint32_t offset = Append(image, payload.data(), payload.size());
+    candidates.push_back(std::make_pair(&payload, offset));
+    return offset;
+  };
+
+  std::vector<CalibFeatureEntry> features;
+  for (auto &mode : data.modes) {
+    for (auto &feature : mode.features) {
+      CalibFeatureEntry entry = {};
+      entry.type = feature.type;
+      entry.flags = feature.disabled ? kCalibFeatureDisabled : 0;
+      entry.data_offset = add_payload(feature.data);
+      entry.data_size = static_cast<uint32_t>(feature.data.size());
+      features.push_back(entry);
+    }
+  }
+
+  std::vector<CalibLutEntry> luts;
+  for (size_t i = 0; i < data.luts.size(); i++) {
+    const CalibLut &lut = data.luts[i];
+    CalibLutEntry entry = {};
+    entry.type = lut.type;
+    entry.num_packets = lut.num_packets;
+    entry.data_offset = add_payload(lut.data);
+    entry.data_size = static_cast<uint32_t>(lut.data.size());
+    luts.push_back(entry);
+    header.lut_slot[lut.type] = static_cast<uint32_t>(i);
+  }
+  Align(image);
+
+  if (image->size() > UINT32_MAX) {
+    AddError(errors, "store of %zu bytes is too large", image->size());
+    return -EFBIG;
+  }
+
+  header.file_size = static_cast<uint32_t>(image->size());
+  memcpy(At<uint8_t>(image, header.mode_index_offset), mode_index.data(),
+         mode_index.size() * sizeof(uint32_t));
+  if (!modes.empty()) {
+    memcpy(At<uint8_t>(image, header.modes_offset), modes.data(),
+           modes.size() * sizeof(CalibModeEntry));
+  }
+  if (!features.empty()) {
+    memcpy(At<uint8_t>(image, header.features_offset), features.data(),
+           features.size() * sizeof(CalibFeatureEntry));
+  }
+  if (!luts.empty()) {
+    memcpy(At<uint8_t>(image, header.luts_offset), luts.data(),
+           luts.size() * sizeof(CalibLutEntry));
+  }
+  memcpy(At<uint8_t>(image, 0), &header, sizeof(header));
+  At<CalibHeader>(image, 0)->crc32 = CalibCrc32(0, image->data(),
+                                                static_cast<uint32_t>(image->size()));
+
+  return 0;
+}
+
+int DecompileCalibStore(const CalibStore &store, CalibData *data) {
+  if (!store.IsLoaded()) {
+    return -EINVAL;
+  }
+
+  *data = CalibData();
+  data->num_modes = store.GetNumModes();
+  data->default_mode_id = store.GetDefaultModeId();
+  data->num_luts = store.GetNumLuts();
+
+  for (uint32_t i = 0; i < store.GetNumModes(); i++) {
+    const CalibModeEntry *entry = store.GetModeAt(i);
+    CalibMode mode;
+    mode.mode_id = entry->mode_id;
+    mode.display_id = entry->display_id;
+    mode.is_default = entry->flags & kCalibModeDefault;
+    mode.is_app = entry->flags & kCalibModeApp;
+    mode.is_merge = entry->flags & kCalibModeMerge;
+    mode.name = store.GetString(entry->name);
+    mode.dynamic_range = store.GetString(entry->dynamic_range);
+    mode.color_gamut = store.GetString(entry->color_gamut);
+    mode.picture_quality = store.GetString(entry->picture_quality);
+    mode.white_point = entry->white_point;
+    mode.e_value = entry->e_value;
+    mode.b_value = entry->b_value;
+    mode.r_value = entry->r_value;
+    mode.has_render_intent = entry->flags & kCalibModeHasRenderIntent;
+    mode.render_intent = entry->render_intent;
+    mode.num_of_features = entry->num_of_features;
+    for (uint32_t j = 0; j < entry->feature_count; j++) {
+      const CalibFeatureEntry *feature_entry = store.GetFeatureAt(entry, j);
+      CalibFeature feature;
+      feature.type = feature_entry->type;
+      feature.disabled = feature_entry->flags & kCalibFeatureDisabled;
+      const uint8_t *payload = store.GetData(feature_entry->data_offset);
+      feature.data.assign(payload, payload + feature_entry->data_size);
+      mode.features.push_back(std::move(feature));
+    }
+    data->modes.push_back(std::move(mode));
+  }
+
+  for (uint32_t i = 0; i < store.GetNumLuts(); i++) {
+    const CalibLutEntry *entry = store.GetLutAt(i);
+    CalibLut lut;
+    lut.type = entry->type;
+    lut.num_packets = entry->num_packets;
+    const uint8_t *payload = store.GetData(entry->data_offset);
+    lut.data.assign(payload, payload + entry->data_size);
+    data->luts.push_back(std::move(lut));
+  }
+
+  return 0;
+}
+
+}  // namespace qdcm
@@ -0,0 +1,103 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __QDCM_CALIB_COMPILER_H__
+#define __QDCM_CALIB_COMPILER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "qdcm_calib_store.h"
+
+namespace qdcm {
+
+// In-memory form of a qdcm_calib_data_*.xml file. Line numbers point back at the source for
+// diagnostics and are zero for data that did not come from XML.
+struct CalibFeature {
+  uint32_t type = 0;
+  bool disabled = false;
+  std::vector<uint8_t> data;
+  int line = 0;
+};
+
+struct CalibMode {
+  int32_t mode_id = 0;
+  int32_t display_id = 0;
+  bool is_default = false;
+  bool is_app = false;
+  bool is_merge = false;
+  std::string name;
+  std::string dynamic_range;
+  std::string color_gamut;
+  std::string picture_quality;
+  int32_t white_point = 0;
+  int32_t e_value = 0;
+  int32_t b_value = 0;
+  int32_t r_value = 0;
+  bool has_render_intent = false;
+  int32_t render_intent = 0;
+  uint32_t num_of_features = 0;
+  std::vector<CalibFeature> features;
+  int line = 0;
+};
+
+struct CalibLut {
+  uint32_t type = 0;
+  uint32_t num_packets = 0;
+  std::vector<uint8_t> data;
+  int line = 0;
+};
+
+struct CalibData {
+  uint32_t num_modes = 0;
+  int32_t default_mode_id = 0;
+  std::vector<CalibMode> modes;
+  uint32_t num_luts = 0;
+  std::vector<CalibLut> luts;
+};
+
+// Parses the XML text. Returns 0 or -EINVAL, with the reasons in errors.
+int ParseCalibXml(const std::string &xml, CalibData *data, std::vector<std::string> *errors);
+int ParseCalibXmlFile(const std::string &path, CalibData *data, std::vector<std::string> *errors);
+
+// Checks the schema rules the binary store depends on and the value ranges of the LUT payloads
+// this tree knows the layout of. Returns the number of errors found.
+uint32_t ValidateCalibData(const CalibData &data, std::vector<std::string> *errors);
+
+// Lays out a validated CalibData as a store image. Output is deterministic for a given input.
+int CompileCalibData(const CalibData &data, std::vector<uint8_t> *image,
+                     std::vector<std::string> *errors);
+
+// Rebuilds the CalibData a loaded store was compiled from.
+int DecompileCalibStore(const CalibStore &store, CalibData *data);
+
+}  // namespace qdcm
+
+#endif  // __QDCM_CALIB_COMPILER_H__
@@ -0,0 +1,136 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __QDCM_CALIB_FORMAT_H__
+#define __QDCM_CALIB_FORMAT_H__
+
+#include <stdint.h>
+
+// On-disk layout of a compiled QDCM calibration store. All fields are little endian and every
+// table and payload starts on an 8 byte boundary, so the file can be used in place once mapped.
+//
+//   CalibHeader | mode index | CalibModeEntry[] | CalibFeatureEntry[] | CalibLutEntry[] |
+//   string table | payloads
+//
+// Offsets are from the start of the file. The crc32 covers the whole file with the crc32 field
+// itself taken as zero. A reader must reject a file whose major version differs from its own;
+// minor versions only append fields or tables that older readers can ignore.
+
+namespace qdcm {
+
+const uint32_t kCalibMagic = 0x42434451;  // "QDCB"
+const uint16_t kCalibVersionMajor = 1;
+const uint16_t kCalibVersionMinor = 0;
+const uint32_t kCalibAlignment = 8;
+const uint32_t kCalibInvalidIndex = 0xFFFFFFFF;
+
+// Feature and LUT types index fixed slot tables, which keeps lookups constant time.
+const uint32_t kCalibFeatureSlots = 64;
+const uint32_t kCalibLutSlots = 8;
+
+// Mode ids index a dense table from the smallest id, so the id span is bounded.
+const uint32_t kCalibMaxModeIdSpan = 1024;
+
+enum CalibModeFlags {
+  kCalibModeDefault = 0x1,
+  kCalibModeApp = 0x2,
+  kCalibModeMerge = 0x4,
+  kCalibModeHasRenderIntent = 0x8,
+};
+
+enum CalibFeatureFlags {
+  kCalibFeatureDisabled = 0x1,
+};
+
+struct CalibHeader {
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  uint32_t file_size;
+  uint32_t crc32;
+  int32_t default_mode_id;
+  uint32_t num_modes;
+  uint32_t modes_offset;
+  int32_t min_mode_id;
+  uint32_t mode_index_size;     // entries in the mode id -> mode table slot index
+  uint32_t mode_index_offset;
+  uint32_t num_features;
+  uint32_t features_offset;
+  uint32_t num_luts;
+  uint32_t luts_offset;
+  uint32_t strings_offset;
+  uint32_t strings_size;
+  uint32_t lut_slot[kCalibLutSlots];  // LUT type -> LUT table index
+};
+
+// String fields are offsets into the string table, 0 being the empty string.
+struct CalibModeEntry {
+  int32_t mode_id;
+  int32_t display_id;
+  uint32_t flags;
+  uint32_t name;
+  uint32_t dynamic_range;
+  uint32_t color_gamut;
+  uint32_t picture_quality;
+  int32_t white_point;
+  int32_t e_value;
+  int32_t b_value;
+  int32_t r_value;
+  int32_t render_intent;
+  uint32_t num_of_features;  // NumOfFeatures as declared by the tuning tool
+  uint32_t first_feature;
+  uint32_t feature_count;
+  uint32_t reserved;
+  uint32_t feature_slot[kCalibFeatureSlots];  // feature type -> feature table index
+};
+
+struct CalibFeatureEntry {
+  uint32_t type;
+  uint32_t flags;
+  uint32_t data_offset;
+  uint32_t data_size;
+};
+
+struct CalibLutEntry {
+  uint32_t type;
+  uint32_t num_packets;
+  uint32_t data_offset;
+  uint32_t data_size;
+};
+
+static_assert(sizeof(CalibHeader) == 96, "CalibHeader layout changed");
+static_assert(sizeof(CalibModeEntry) == 320, "CalibModeEntry layout changed");
+static_assert(sizeof(CalibFeatureEntry) == 16, "CalibFeatureEntry layout changed");
+static_assert(sizeof(CalibLutEntry) == 16, "CalibLutEntry layout changed");
+
+uint32_t CalibCrc32(uint32_t crc, const uint8_t *data, uint32_t size);
+
+}  // namespace qdcm
+
+#endif  // __QDCM_CALIB_FORMAT_H__
@@ -0,0 +1,393 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "qdcm_calib_store.h"
+
+namespace qdcm {
+
+namespace {
+
+struct Crc32Table {
+  Crc32Table() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+      }
+      entries[i] = c;
+    }
+  }
+  uint32_t entries[256];
+};
+
+void AddError(std::vector<std::string> *errors, const char *format, ...) {
+  if (!errors) {
+    return;
+  }
+
+  char buffer[256];
+  va_list list;
+  va_start(list, format);
+  vsnprintf(buffer, sizeof(buffer), format, list);
+  va_end(list);
+  errors->push_back(buffer);
+}
+
+bool IsAligned(uint32_t offset) {
+  return (offset % kCalibAlignment) == 0;
+}
+
+}  // namespace
+
+uint32_t CalibCrc32(uint32_t crc, const uint8_t *data, uint32_t size) {
+  static const Crc32Table table;
+
+  crc = ~crc;
+  for (uint32_t i = 0; i < size; i++) {
+    crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+
+CalibStore::~CalibStore() {
+  Close();
+}
+
+int CalibStore::Open(const std::string &path, std::vector<std::string> *errors) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    int err = errno;
+    AddError(errors, "%s: open failed: %s", path.c_str(), strerror(err));
+    return -err;
+  }
+
+  struct stat st = {};
+  if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(CalibHeader))) {
+    AddError(errors, "%s: not a calibration store", path.c_str());
+    close(fd);
+    return -EINVAL;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    int err = errno;
+    AddError(errors, "%s: mmap failed: %s", path.c_str(), strerror(err));
+    return -err;
+  }
+
+  base_ = static_cast<const uint8_t *>(map);
+  size_ = size;
+  mapped_ = true;
+
+  int ret = Verify(errors);
+  if (ret) {
+    Close();
+  }
+
+  return ret;
+}
+
+int CalibStore::Load(const void *data, size_t size, std::vector<std::string> *errors) {
+  Close();
+
+  if (!data || (reinterpret_cast<uintptr_t>(data) % kCalibAlignment)) {
+    AddError(errors, "store buffer is null or misaligned");
+    return -EINVAL;
+  }
+
+  base_ = static_cast<const uint8_t *>(data);
+  size_ = size;
+  mapped_ = false;
+
+  int ret = Verify(errors);
+  if (ret) {
+    Close();
+  }
+
+  return ret;
+}
+
+void CalibStore::Close() {
+  if (mapped_ && base_) {
+    munmap(const_cast<uint8_t *>(base_), size_);
+  }
+
+  base_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+  header_ = nullptr;
+  mode_index_ = nullptr;
+  modes_ = nullptr;
+  features_ = nullptr;
+  luts_ = nullptr;
+  strings_ = nullptr;
+}
+
+int CalibStore::Verify(std::vector<std::string> *errors) {
+  if (size_ < sizeof(CalibHeader) || size_ > UINT32_MAX) {
+    AddError(errors, "store size %zu is out of range", size_);
+    return -EINVAL;
+  }
+
+  const CalibHeader *header = reinterpret_cast<const CalibHeader *>(base_);
+  if (header->magic != kCalibMagic) {
+    AddError(errors, "bad magic 0x%08x", header->magic);
+    return -EINVAL;
+  }
+
+  if (header->version_major != kCalibVersionMajor) {
+    AddError(errors, "unsupported version %u.%u, expected %u.x", header->version_major,
+             header->version_minor, kCalibVersionMajor);
+    return -EPROTO;
+  }
+
+  if (header->file_size != size_) {
+    AddError(errors, "file size %u does not match store size %zu", header->file_size, size_);
+    return -EINVAL;
+  }
+
+  const uint32_t crc_offset = offsetof(CalibHeader, crc32);
+  const uint8_t zero[sizeof(header->crc32)] = {};
+  uint32_t crc = CalibCrc32(0, base_, crc_offset);
+  crc = CalibCrc32(crc, zero, sizeof(zero));
+  crc = CalibCrc32(crc, base_ + crc_offset + sizeof(zero),
+                   static_cast<uint32_t>(size_ - crc_offset - sizeof(zero)));
+  if (crc != header->crc32) {
+    AddError(errors, "checksum mismatch, stored 0x%08x computed 0x%08x", header->crc32, crc);
+    return -EBADMSG;
+  }
+
+  struct Table {
+    const char *name;
+    uint32_t offset;
+    uint64_t size;
+  } tables[] = {
+    {"mode index", header->mode_index_offset, uint64_t(header->mode_index_size) * sizeof(uint32_t)},
+    {"mode", header->modes_offset, uint64_t(header->num_modes) * sizeof(CalibModeEntry)},
+    {"feature", header->features_offset,
+     uint64_t(header->num_features) * sizeof(CalibFeatureEntry)},
+    {"lut", header->luts_offset, uint64_t(header->num_luts) * sizeof(CalibLutEntry)},
+    {"string", header->strings_offset, header->strings_size},
+  };
+  for (auto &table : tables) {
+    if (!IsAligned(table.offset) || !InRange(table.offset, table.size)) {
+      AddError(errors, "%s table at %u size %llu is outside the store", table.name, table.offset,
+               static_cast<unsigned long long>(table.size));
+      return -EINVAL;
+    }
+  }
+
+  if (header->mode_index_size > kCalibMaxModeIdSpan) {
+    AddError(errors, "mode index of %u entries exceeds %u", header->mode_index_size,
+             kCalibMaxModeIdSpan);
+    return -EINVAL;
+  }
+
+  const char *strings = reinterpret_cast<const char *>(base_ + header->strings_offset);
+  if (!header->strings_size || strings[0] || strings[header->strings_size - 1]) {
+    AddError(errors, "string table is not terminated");
+    return -EINVAL;
+  }
+
+  const uint32_t *mode_index = reinterpret_cast<const uint32_t *>(base_ +
+                                                                   header->mode_index_offset);
+  const CalibModeEntry *modes = reinterpret_cast<const CalibModeEntry *>(base_ +
+                                                                         header->modes_offset);
+  const CalibFeatureEntry *features =
+      reinterpret_cast<const CalibFeatureEntry *>(base_ + header->features_offset);
+  const CalibLutEntry *luts = reinterpret_cast<const CalibLutEntry *>(base_ + header->luts_offset);
+
+  for (uint32_t i = 0; i < header->mode_index_size; i++) {
+    uint32_t slot = mode_index[i];
+    if (slot == kCalibInvalidIndex) {
+      continue;
+    }
+    if (slot >= header->num_modes ||
+        int64_t(modes[slot].mode_id) != int64_t(header->min_mode_id) + i) {
+      AddError(errors, "mode index entry %u points at a wrong mode", i);
+      return -EINVAL;
+    }
+  }
+
+  for (uint32_t i = 0; i < header->num_modes; i++) {
+    const CalibModeEntry &mode = modes[i];
+    int64_t id_index = int64_t(mode.mode_id) - header->min_mode_id;
+    if (id_index < 0 || id_index >= header->mode_index_size || mode_index[id_index] != i) {
+      AddError(errors, "mode %d is not reachable through the mode index", mode.mode_id);
+      return -EINVAL;
+    }
+
+    uint32_t names[] = {mode.name, mode.dynamic_range, mode.color_gamut, mode.picture_quality};
+    for (uint32_t name : names) {
+      if (name >= header->strings_size) {
+        AddError(errors, "mode %d has a string outside the string table", mode.mode_id);
+        return -EINVAL;
+      }
+    }
+
+    if (uint64_t(mode.first_feature) + mode.feature_count > header->num_features) {
+      AddError(errors, "mode %d features are outside the feature table", mode.mode_id);
+      return -EINVAL;
+    }
+
+    for (uint32_t type = 0; type < kCalibFeatureSlots; type++) {
+      uint32_t slot = mode.feature_slot[type];
+      if (slot == kCalibInvalidIndex) {
+        continue;
+      }
+      if (slot < mode.first_feature || slot - mode.first_feature >= mode.feature_count ||
+          features[slot].type != type) {
+        AddError(errors, "mode %d feature slot %u points at a wrong feature", mode.mode_id, type);
+        return -EINVAL;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < header->num_features; i++) {
+    if (!InRange(features[i].data_offset, features[i].data_size)) {
+      AddError(errors, "feature %u payload is outside the store", i);
+      return -EINVAL;
+    }
+  }
+
+  for (uint32_t i = 0; i < header->num_luts; i++) {
+    if (!InRange(luts[i].data_offset, luts[i].data_size)) {
+      AddError(errors, "lut %u payload is outside the store", i);
+      return -EINVAL;
+    }
+  }
+
+  for (uint32_t type = 0; type < kCalibLutSlots; type++) {
+    uint32_t slot = header->lut_slot[type];
+    if (slot != kCalibInvalidIndex && (slot >= header->num_luts || luts[slot].type != type)) {
+      AddError(errors, "lut slot %u points at a wrong lut", type);
+      return -EINVAL;
+    }
+  }
+
+  header_ = header;
+  mode_index_ = mode_index;
+  modes_ = modes;
+  features_ = features;
+  luts_ = luts;
+  strings_ = strings;
+
+  if (header->num_modes && !GetMode(header->default_mode_id)) {
+    AddError(errors, "default mode %d is not in the store", header->default_mode_id);
+    header_ = nullptr;
+    return -EINVAL;
+  }
+
+  return 0;
+}
+
+const CalibModeEntry *CalibStore::GetModeAt(uint32_t index) const {
+  if (!header_ || index >= header_->num_modes) {
+    return nullptr;
+  }
+
+  return &modes_[index];
+}
+
+const CalibModeEntry *CalibStore::GetMode(int32_t mode_id) const {
+  if (!header_) {
+    return nullptr;
+  }
+
+  int64_t id_index = int64_t(mode_id) - header_->min_mode_id;
+  if (id_index < 0 || id_index >= header_->mode_index_size) {
+    return nullptr;
+  }
+
+  uint32_t slot = mode_index_[id_index];
+  return (slot == kCalibInvalidIndex) ? nullptr : &modes_[slot];
+}
+
+const CalibFeatureEntry *CalibStore::GetFeatureAt(const CalibModeEntry *mode,
+                                                  uint32_t index) const {
+  if (!header_ || !mode || index >= mode->feature_count) {
+    return nullptr;
+  }
+
+  return &features_[mode->first_feature + index];
+}
+
+const CalibFeatureEntry *CalibStore::GetFeature(const CalibModeEntry *mode, uint32_t type) const {
+  if (!header_ || !mode || type >= kCalibFeatureSlots) {
+    return nullptr;
+  }
+
+  uint32_t slot = mode->feature_slot[type];
+  return (slot == kCalibInvalidIndex) ? nullptr : &features_[slot];
+}
+
+const CalibFeatureEntry *CalibStore::GetFeature(int32_t mode_id, uint32_t type) const {
+  return GetFeature(GetMode(mode_id), type);
+}
+
+const CalibLutEntry *CalibStore::GetLutAt(uint32_t index) const {
+  if (!header_ || index >= header_->num_luts) {
+    return nullptr;
+  }
+
+  return &luts_[index];
+}
+
+const CalibLutEntry *CalibStore::GetLut(uint32_t type) const {
+  if (!header_ || type >= kCalibLutSlots) {
+    return nullptr;
+  }
+
+  uint32_t slot = header_->lut_slot[type];
+  return (slot == kCalibInvalidIndex) ? nullptr : &luts_[slot];
+}
+
+const char *CalibStore::GetString(uint32_t offset) const {
+  if (!header_ || offset >= header_->strings_size) {
+    return "";
+  }
+
+  return strings_ + offset;
+}
+
+}  // namespace qdcm
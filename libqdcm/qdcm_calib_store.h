@@ -0,0 +1,91 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __QDCM_CALIB_STORE_H__
+#define __QDCM_CALIB_STORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "qdcm_calib_format.h"
+
+namespace qdcm {
+
+// Read-only view of a compiled calibration store. Open() maps the file and checks its header,
+// checksum and every table reference once, so the lookups afterwards are plain index operations
+// that never touch data outside the mapping.
+class CalibStore {
+ public:
+  CalibStore() {}
+  ~CalibStore();
+  CalibStore(const CalibStore &) = delete;
+  CalibStore &operator=(const CalibStore &) = delete;
+
+  // Both return 0 or a negative errno; problems found are appended to errors when non null.
+  int Open(const std::string &path, std::vector<std::string> *errors = nullptr);
+  // Uses the caller's buffer in place. It must outlive the store.
+  int Load(const void *data, size_t size, std::vector<std::string> *errors = nullptr);
+  void Close();
+
+  bool IsLoaded() const { return base_ != nullptr; }
+  const CalibHeader *GetHeader() const { return header_; }
+  int32_t GetDefaultModeId() const { return header_ ? header_->default_mode_id : -1; }
+  uint32_t GetNumModes() const { return header_ ? header_->num_modes : 0; }
+  uint32_t GetNumLuts() const { return header_ ? header_->num_luts : 0; }
+
+  const CalibModeEntry *GetModeAt(uint32_t index) const;
+  const CalibModeEntry *GetMode(int32_t mode_id) const;
+  const CalibFeatureEntry *GetFeatureAt(const CalibModeEntry *mode, uint32_t index) const;
+  const CalibFeatureEntry *GetFeature(const CalibModeEntry *mode, uint32_t type) const;
+  const CalibFeatureEntry *GetFeature(int32_t mode_id, uint32_t type) const;
+  const CalibLutEntry *GetLutAt(uint32_t index) const;
+  const CalibLutEntry *GetLut(uint32_t type) const;
+  const uint8_t *GetData(uint32_t offset) const { return base_ + offset; }
+  const char *GetString(uint32_t offset) const;
+
+ private:
+  int Verify(std::vector<std::string> *errors);
+  bool InRange(uint32_t offset, uint64_t size) const { return offset + size <= size_; }
+
+  const uint8_t *base_ = nullptr;
+  size_t size_ = 0;
+  bool mapped_ = false;
+  const CalibHeader *header_ = nullptr;
+  const uint32_t *mode_index_ = nullptr;
+  const CalibModeEntry *modes_ = nullptr;
+  const CalibFeatureEntry *features_ = nullptr;
+  const CalibLutEntry *luts_ = nullptr;
+  const char *strings_ = nullptr;
+};
+
+}  // namespace qdcm
+
+#endif  // __QDCM_CALIB_STORE_H__
@@ -0,0 +1,262 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "qdcm_calib_compiler.h"
+
+using namespace qdcm;
+
+namespace {
+
+const char *kCalibFiles[] = {
+  "qdcm_calib_data_Sharp_4k_cmd_mode_dsc_dsi_panel.xml",
+  "qdcm_calib_data_bengal_default.xml",
+  "qdcm_calib_data_default.xml",
+  "qdcm_calib_data_nt35597_cmd_mode_dsi_truly_panel_with_DSC.xml",
+};
+
+// The shipped files live in config/; QDCM_CALIB_XML_DIR overrides the search.
+std::string FindCalibFile(const char *name) {
+  std::vector<std::string> dirs;
+  const char *env = getenv("QDCM_CALIB_XML_DIR");
+  if (env) {
+    dirs.push_back(env);
+  }
+  char exe[PATH_MAX] = {};
+  if (readlink("/proc/self/exe", exe, sizeof(exe) - 1) > 0) {
+    std::string exe_dir(exe);
+    exe_dir.erase(exe_dir.rfind('/'));
+    dirs.push_back(exe_dir);
+    dirs.push_back(exe_dir + "/config");
+  }
+  dirs.push_back("config");
+  dirs.push_back("../config");
+
+  for (auto &dir : dirs) {
+    std::string path = dir + "/" + name;
+    if (access(path.c_str(), R_OK) == 0) {
+      return path;
+    }
+  }
+
+  return "";
+}
+
+void ExpectSameData(const CalibData &a, const CalibData &b) {
+  EXPECT_EQ(a.num_modes, b.num_modes);
+  EXPECT_EQ(a.default_mode_id, b.default_mode_id);
+  EXPECT_EQ(a.num_luts, b.num_luts);
+  ASSERT_EQ(a.modes.size(), b.modes.size());
+  for (size_t i = 0; i < a.modes.size(); i++) {
+    const CalibMode &x = a.modes[i];
+    const CalibMode &y = b.modes[i];
+    EXPECT_EQ(x.mode_id, y.mode_id);
+    EXPECT_EQ(x.display_id, y.display_id);
+    EXPECT_EQ(x.is_default, y.is_default);
+    EXPECT_EQ(x.is_app, y.is_app);
+    EXPECT_EQ(x.is_merge, y.is_merge);
+    EXPECT_EQ(x.name, y.name);
+    EXPECT_EQ(x.dynamic_range, y.dynamic_range);
+    EXPECT_EQ(x.color_gamut, y.color_gamut);
+    EXPECT_EQ(x.picture_quality, y.picture_quality);
+    EXPECT_EQ(x.white_point, y.white_point);
+    EXPECT_EQ(x.e_value, y.e_value);
+    EXPECT_EQ(x.b_value, y.b_value);
+    EXPECT_EQ(x.r_value, y.r_value);
+    EXPECT_EQ(x.has_render_intent, y.has_render_intent);
+    EXPECT_EQ(x.render_intent, y.render_intent);
+    EXPECT_EQ(x.num_of_features, y.num_of_features);
+    ASSERT_EQ(x.features.size(), y.features.size());
+    for (size_t j = 0; j < x.features.size(); j++) {
+      EXPECT_EQ(x.features[j].type, y.features[j].type);
+      EXPECT_EQ(x.features[j].disabled, y.features[j].disabled);
+      EXPECT_TRUE(x.features[j].data == y.features[j].data);
+    }
+  }
+  ASSERT_EQ(a.luts.size(), b.luts.size());
+  for (size_t i = 0; i < a.luts.size(); i++) {
+    EXPECT_EQ(a.luts[i].type, b.luts[i].type);
+    EXPECT_EQ(a.luts[i].num_packets, b.luts[i].num_packets);
+    EXPECT_TRUE(a.luts[i].data == b.luts[i].data);
+  }
+}
+
+// Keeps the image 8 byte aligned, as Load() requires.
+struct AlignedImage {
+  explicit AlignedImage(const std::vector<uint8_t> &image)
+    : words((image.size() + 7) / 8) {
+    memcpy(words.data(), image.data(), image.size());
+    size = image.size();
+  }
+  uint8_t *data() { return reinterpret_cast<uint8_t *>(words.data()); }
+  std::vector<uint64_t> words;
+  size_t size;
+};
+
+const char *kMinimalXml =
+    "<?xml version=\"1.0\" ?>\n"
+    "<Calib_Data>\n"
+    "  <Disp_Modes NumModes=\"2\" DefaultMode=\"%d\">\n"
+    "    <Mode ModeID=\"0\" DisplayID=\"0\" IsDefaultMode=\"0\" IsAppMode=\"0\" Name=\"native\""
+    " NumOfFeatures=\"1\" WhitePoint=\"0\" EValue=\"255\" BValue=\"100\" RValue=\"100\""
+    " DynamicRange=\"sdr\" ColorGamut=\"native\">\n"
+    "      <Feature FeatureType=\"8\" Disable=\"false\" DataSize=\"16\">%s</Feature>\n"
+    "    </Mode>\n"
+    "    <Mode ModeID=\"%d\" DisplayID=\"0\" IsDefaultMode=\"0\" IsAppMode=\"0\" Name=\"srgb\""
+    " NumOfFeatures=\"0\" WhitePoint=\"0\" EValue=\"255\" BValue=\"100\" RValue=\"100\""
+    " DynamicRange=\"sdr\" ColorGamut=\"srgb\"/>\n"
+    "  </Disp_Modes>\n"
+    "</Calib_Data>\n";
+
+std::string MinimalXml(int default_mode, const char *gc_payload, int second_mode_id) {
+  char xml[2048];
+  snprintf(xml, sizeof(xml), kMinimalXml, default_mode, gc_payload, second_mode_id);
+  return xml;
+}
+
+// Header words 1, 1024, 6 followed by a single 10 bit entry.
+const char *kValidGc = "01000000000400000600000000030000";
+const char *kOverflowGc = "01000000000400000600000000040000";
+
+}  // namespace
+
+TEST(QdcmCalibTest, RoundTripShippedFiles) {
+  for (const char *name : kCalibFiles) {
+    SCOPED_TRACE(name);
+    std::string path = FindCalibFile(name);
+    ASSERT_FALSE(path.empty()) << "set QDCM_CALIB_XML_DIR to the config directory";
+
+    std::vector<std::string> errors;
+    CalibData parsed;
+    ASSERT_EQ(0, ParseCalibXmlFile(path, &parsed, &errors));
+    EXPECT_EQ(0u, ValidateCalibData(parsed, &errors));
+
+    std::vector<uint8_t> image;
+    ASSERT_EQ(0, CompileCalibData(parsed, &image, &errors));
+    std::vector<uint8_t> again;
+    ASSERT_EQ(0, CompileCalibData(parsed, &again, &errors));
+    EXPECT_TRUE(image == again);
+
+    AlignedImage aligned(image);
+    CalibStore store;
+    ASSERT_EQ(0, store.Load(aligned.data(), aligned.size, &errors));
+    for (auto &error : errors) {
+      ADD_FAILURE() << error;
+    }
+
+    CalibData decompiled;
+    ASSERT_EQ(0, DecompileCalibStore(store, &decompiled));
+    ExpectSameData(parsed, decompiled);
+
+    for (auto &mode : parsed.modes) {
+      const CalibModeEntry *entry = store.GetMode(mode.mode_id);
+      ASSERT_NE(nullptr, entry);
+      EXPECT_EQ(mode.name, store.GetString(entry->name));
+      for (auto &feature : mode.features) {
+        const CalibFeatureEntry *feature_entry = store.GetFeature(mode.mode_id, feature.type);
+        ASSERT_NE(nullptr, feature_entry);
+        ASSERT_EQ(feature.data.size(), feature_entry->data_size);
+        const uint8_t *payload = store.GetData(feature_entry->data_offset);
+        EXPECT_TRUE(feature.data.empty() ||
+                    !memcmp(feature.data.data(), payload, feature.data.size()));
+      }
+    }
+    for (auto &lut : parsed.luts) {
+      const CalibLutEntry *entry = store.GetLut(lut.type);
+      ASSERT_NE(nullptr, entry);
+      EXPECT_EQ(lut.num_packets, entry->num_packets);
+    }
+    EXPECT_EQ(nullptr, store.GetMode(-1));
+    EXPECT_EQ(nullptr, store.GetFeature(parsed.default_mode_id, kCalibFeatureSlots - 1));
+  }
+}
+
+TEST(QdcmCalibTest, RejectsCorruptStore) {
+  std::vector<std::string> errors;
+  CalibData data;
+  ASSERT_EQ(0, ParseCalibXml(MinimalXml(0, kValidGc, 1), &data, &errors));
+  std::vector<uint8_t> image;
+  ASSERT_EQ(0, CompileCalibData(data, &image, &errors));
+
+  AlignedImage aligned(image);
+  CalibStore store;
+  aligned.data()[aligned.size - 1] ^= 0x1;
+  EXPECT_EQ(-EBADMSG, store.Load(aligned.data(), aligned.size, &errors));
+  EXPECT_FALSE(store.IsLoaded());
+
+  aligned.data()[aligned.size - 1] ^= 0x1;
+  EXPECT_EQ(-EINVAL, store.Load(aligned.data(), aligned.size - 8, &errors));
+
+  CalibHeader *header = reinterpret_cast<CalibHeader *>(aligned.data());
+  header->version_major++;
+  EXPECT_EQ(-EPROTO, store.Load(aligned.data(), aligned.size, &errors));
+}
+
+TEST(QdcmCalibTest, ReportsValidationErrors) {
+  std::vector<std::string> errors;
+  CalibData data;
+
+  ASSERT_EQ(0, ParseCalibXml(MinimalXml(0, kValidGc, 0), &data, &errors));
+  EXPECT_EQ(1u, ValidateCalibData(data, &errors));
+  EXPECT_NE(std::string::npos, errors.back().find("duplicate ModeID"));
+
+  errors.clear();
+  ASSERT_EQ(0, ParseCalibXml(MinimalXml(0, kOverflowGc, 1), &data, &errors));
+  EXPECT_EQ(1u, ValidateCalibData(data, &errors));
+  EXPECT_NE(std::string::npos, errors.back().find("exceeds 1023"));
+
+  errors.clear();
+  ASSERT_EQ(0, ParseCalibXml(MinimalXml(5, kValidGc, 1), &data, &errors));
+  EXPECT_EQ(1u, ValidateCalibData(data, &errors));
+  std::vector<uint8_t> image;
+  EXPECT_EQ(-EINVAL, CompileCalibData(data, &image, &errors));
+
+  errors.clear();
+  std::string xml = MinimalXml(0, kValidGc, 1);
+  xml.replace(xml.find(" Name=\"srgb\""), strlen(" Name=\"srgb\""), " Nmae=\"srgb\"");
+  EXPECT_EQ(-EINVAL, ParseCalibXml(xml, &data, &errors));
+  ASSERT_EQ(2u, errors.size());
+  EXPECT_NE(std::string::npos, errors[0].find("missing Name"));
+  EXPECT_NE(std::string::npos, errors[1].find("unknown attribute Nmae"));
+
+  errors.clear();
+  xml = MinimalXml(0, kValidGc, 1);
+  xml.replace(xml.find("DataSize=\"16\""), strlen("DataSize=\"16\""), "DataSize=\"12\"");
+  EXPECT_EQ(-EINVAL, ParseCalibXml(xml, &data, &errors));
+  ASSERT_EQ(1u, errors.size());
+  EXPECT_NE(std::string::npos, errors[0].find("DataSize says 12"));
+}
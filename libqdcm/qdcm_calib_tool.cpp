@@ -0,0 +1,151 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "qdcm_calib_compiler.h"
+
+using qdcm::CalibData;
+using qdcm::CalibStore;
+
+namespace {
+
+void ShowUsage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s compile <calib.xml> <calib.bin>\n"
+          "       %s validate <calib.xml|calib.bin>\n"
+          "       %s dump <calib.bin>\n", program, program, program);
+}
+
+void PrintErrors(const std::vector<std::string> &errors) {
+  for (auto &error : errors) {
+    fprintf(stderr, "%s\n", error.c_str());
+  }
+}
+
+bool IsStore(const std::string &path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  uint32_t magic = 0;
+  file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+  return file && magic == qdcm::kCalibMagic;
+}
+
+int Compile(const std::string &in, const std::string &out) {
+  std::vector<std::string> errors;
+  CalibData data;
+  std::vector<uint8_t> image;
+  if (qdcm::ParseCalibXmlFile(in, &data, &errors) ||
+      qdcm::CompileCalibData(data, &image, &errors)) {
+    PrintErrors(errors);
+    fprintf(stderr, "%s: compile failed\n", in.c_str());
+    return 1;
+  }
+
+  std::ofstream file(out, std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char *>(image.data()),
+             static_cast<std::streamsize>(image.size()));
+  if (!file) {
+    fprintf(stderr, "%s: write failed\n", out.c_str());
+    return 1;
+  }
+
+  printf("%s: %zu modes, %zu luts, %zu bytes\n", out.c_str(), data.modes.size(),
+         data.luts.size(), image.size());
+  return 0;
+}
+
+int Validate(const std::string &path) {
+  std::vector<std::string> errors;
+  CalibData data;
+  if (IsStore(path)) {
+    CalibStore store;
+    if (store.Open(path, &errors) == 0) {
+      qdcm::DecompileCalibStore(store, &data);
+      qdcm::ValidateCalibData(data, &errors);
+    }
+  } else if (qdcm::ParseCalibXmlFile(path, &data, &errors) == 0) {
+    qdcm::ValidateCalibData(data, &errors);
+  }
+
+  PrintErrors(errors);
+  printf("%s: %zu error(s)\n", path.c_str(), errors.size());
+  return errors.empty() ? 0 : 1;
+}
+
+int Dump(const std::string &path) {
+  std::vector<std::string> errors;
+  CalibStore store;
+  if (store.Open(path, &errors)) {
+    PrintErrors(errors);
+    return 1;
+  }
+
+  const qdcm::CalibHeader *header = store.GetHeader();
+  printf("version %u.%u, %u bytes, crc32 0x%08x, default mode %d\n", header->version_major,
+         header->version_minor, header->file_size, header->crc32, header->default_mode_id);
+  for (uint32_t i = 0; i < store.GetNumModes(); i++) {
+    const qdcm::CalibModeEntry *mode = store.GetModeAt(i);
+    printf("mode %d \"%s\" display %d gamut %s range %s flags 0x%x\n", mode->mode_id,
+           store.GetString(mode->name), mode->display_id, store.GetString(mode->color_gamut),
+           store.GetString(mode->dynamic_range), mode->flags);
+    for (uint32_t j = 0; j < mode->feature_count; j++) {
+      const qdcm::CalibFeatureEntry *feature = store.GetFeatureAt(mode, j);
+      printf("  feature %u%s %u bytes at %u\n", feature->type,
+             (feature->flags & qdcm::kCalibFeatureDisabled) ? " (disabled)" : "",
+             feature->data_size, feature->data_offset);
+    }
+  }
+  for (uint32_t i = 0; i < store.GetNumLuts(); i++) {
+    const qdcm::CalibLutEntry *lut = store.GetLutAt(i);
+    printf("lut %u: %u packets, %u bytes at %u\n", lut->type, lut->num_packets, lut->data_size,
+           lut->data_offset);
+  }
+
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc == 4 && !strcmp(argv[1], "compile")) {
+    return Compile(argv[2], argv[3]);
+  } else if (argc == 3 && !strcmp(argv[1], "validate")) {
+    return Validate(argv[2]);
+  } else if (argc == 3 && !strcmp(argv[1], "dump")) {
+    return Dump(argv[2]);
+  }
+
+  ShowUsage(argv[0]);
+  return 2;
+}
@@ -28,9 +28,19 @@
  */
 
 #include <unistd.h>
+#include <linux/netlink.h>
+#include <pthread.h>
+#include <sys/socket.h>
 #include <gralloc_priv.h>
+#include <atomic>
+#include <mutex>
 #include "qd_utils.h"
 
+// Prefix of the fb node paths, lets tests run against a temporary tree
+#ifndef QDUTILS_SYSFS_ROOT
+#define QDUTILS_SYSFS_ROOT ""
+#endif
+
 static const int kFBNodeMax = 4;
 namespace qdutils {
 
@@ -52,34 +62,153 @@ static int parseLine(char *input, char *tokens[], const uint32_t maxToken, uint3
     return 0;
 }
 
-static int getExternalNode(const char *type) {
-    FILE *displayDeviceFP = NULL;
-    char fbType[MAX_FRAME_BUFFER_NAME_SIZE];
+// Types of the fb nodes, read once and kept until a display uevent.
+// Only the node types are cached, connection state is always read from sysfs.
+struct FBNodeCache {
+    std::mutex lock;
+    bool valid = false;
+    bool watchInitialized = false;
+    int ueventFd = -1;
+    // Written by the uevent listener thread
+    std::atomic<bool> watching{false};
+    std::atomic<bool> changed{false};
+    char types[kFBNodeMax][MAX_FRAME_BUFFER_NAME_SIZE] = {};
+};
+
+static FBNodeCache &getFBNodeCache() {
+    // Never destroyed, the uevent listener thread keeps using it until the process exits
+    static FBNodeCache *cache = new FBNodeCache();
+    return *cache;
+}
+
+static int openUeventSocket() {
+    struct sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;  // Kernel uevents
+
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Replaced by tests to feed scripted uevents.
+static int (*openUeventSource)() = openUeventSocket;
+
+static bool isDisplayUevent(const char *msg) {
+    // Each event starts with "<action>@<devpath>"
+    return strstr(msg, "/graphics/fb") || strstr(msg, "/switch/") || strstr(msg, "/extcon/");
+}
+
+// Drains the uevent socket as events arrive, so that it never fills up between two lookups.
+static void *ueventListener(void *arg) {
+    FBNodeCache *cache = static_cast<FBNodeCache *>(arg);
+    char msg[MAX_STRING_LENGTH];
+
+    for (;;) {
+        ssize_t len = recv(cache->ueventFd, msg, sizeof(msg) - 1, 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                // Events were dropped, any of them may have been a hotplug
+                cache->changed = true;
+                continue;
+            }
+            ALOGW("%s: uevent socket failed, errno = %d. fb nodes are scanned on every query",
+                  __func__, errno);
+            break;
+        }
+
+        msg[len] = '\0';
+        if (isDisplayUevent(msg)) {
+            cache->changed = true;
+        }
+    }
+
+    close(cache->ueventFd);
+    cache->watching = false;
+
+    return NULL;
+}
+
+static void startUeventListener(FBNodeCache *cache) {
+    cache->ueventFd = openUeventSource();
+    if (cache->ueventFd < 0) {
+        ALOGW("%s: Cannot watch uevents, errno = %d. fb nodes are scanned on every query",
+              __func__, errno);
+        return;
+    }
+
+    cache->watching = true;
+    pthread_t thread;
+    int err = pthread_create(&thread, NULL, ueventListener, cache);
+    if (err) {
+        ALOGW("%s: Cannot start uevent listener, error = %d. fb nodes are scanned on every query",
+              __func__, err);
+        cache->watching = false;
+        close(cache->ueventFd);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+static void scanFBNodes(FBNodeCache *cache) {
     char msmFbTypePath[MAX_FRAME_BUFFER_NAME_SIZE];
-    int j = 0;
 
-    for(j = 0; j < kFBNodeMax; j++) {
+    for (int j = 0; j < kFBNodeMax; j++) {
+        char *fbType = cache->types[j];
+        fbType[0] = '\0';
         snprintf (msmFbTypePath, sizeof(msmFbTypePath),
-                  "/sys/devices/virtual/graphics/fb%d/msm_fb_type", j);
-        displayDeviceFP = fopen(msmFbTypePath, "r");
-        if(displayDeviceFP) {
-            fread(fbType, sizeof(char), MAX_FRAME_BUFFER_NAME_SIZE,
-                    displayDeviceFP);
-            if(strncmp(fbType, type, strlen(type)) == 0) {
-                ALOGD("%s: %s is at fb%d", __func__, type, j);
-                fclose(displayDeviceFP);
-                break;
-            }
+                  QDUTILS_SYSFS_ROOT "/sys/devices/virtual/graphics/fb%d/msm_fb_type", j);
+        FILE *displayDeviceFP = fopen(msmFbTypePath, "r");
+        if (displayDeviceFP) {
+            size_t len = fread(fbType, sizeof(char), MAX_FRAME_BUFFER_NAME_SIZE - 1,
+                               displayDeviceFP);
+            fbType[len] = '\0';
             fclose(displayDeviceFP);
         } else {
             ALOGE("%s: Failed to open fb node %s", __func__, msmFbTypePath);
         }
     }
+}
+
+static int getExternalNode(const char *type) {
+    FBNodeCache &cache = getFBNodeCache();
+    std::lock_guard<std::mutex> lock(cache.lock);
+
+    // The listener starts before the first scan so that no hotplug in between goes unnoticed.
+    if (!cache.watchInitialized) {
+        startUeventListener(&cache);
+        cache.watchInitialized = true;
+    }
+
+    // Cleared before scanning, an event that arrives during the scan triggers the next one.
+    if (cache.changed.exchange(false) || !cache.watching) {
+        cache.valid = false;
+    }
+
+    if (!cache.valid) {
+        scanFBNodes(&cache);
+        cache.valid = cache.watching;
+    }
+
+    for (int j = 0; j < kFBNodeMax; j++) {
+        if (strncmp(cache.types[j], type, strlen(type)) == 0) {
+            ALOGD("%s: %s is at fb%d", __func__, type, j);
+            return j;
+        }
+    }
 
-    if (j < kFBNodeMax)
-        return j;
-    else
-        ALOGE("%s: Failed to find %s node", __func__, type);
+    ALOGE("%s: Failed to find %s node", __func__, type);
 
     return -1;
 }
@@ -98,7 +227,7 @@ bool isDPConnected() {
     }
 
     snprintf(connectPath, sizeof(connectPath),
-             "/sys/devices/virtual/graphics/fb%d/connected", nodeId);
+             QDUTILS_SYSFS_ROOT "/sys/devices/virtual/graphics/fb%d/connected", nodeId);
 
     connectFile = fopen(connectPath, "rb");
     if (!connectFile) {
@@ -137,7 +266,7 @@ int getDPTestConfig(uint32_t *panelBpp, uint32_t *patternType) {
     }
 
     snprintf(configPath, sizeof(configPath),
-             "/sys/devices/virtual/graphics/fb%d/config", nodeId);
+             QDUTILS_SYSFS_ROOT "/sys/devices/virtual/graphics/fb%d/config", nodeId);
 
     configFile = fopen(configPath, "rb");
     if (!configFile) {
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2021 The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Runs the fb node lookups against a tree of regular files under QDUTILS_SYSFS_ROOT and feeds
+// them scripted uevents through a socket pair instead of the kernel's uevent socket.
+
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Built into the test to reach the static lookup and replace its uevent source.
+#include "qd_utils.cpp"
+
+namespace qdutils {
+namespace {
+
+int g_ueventFds[2] = {-1, -1};  // Test end, library end
+
+std::string NodePath(int fb, const char *node) {
+    return std::string(QDUTILS_SYSFS_ROOT) + "/sys/devices/virtual/graphics/fb" +
+           std::to_string(fb) + "/" + node;
+}
+
+void WriteNode(int fb, const char *node, const std::string &contents) {
+    std::string path = NodePath(fb, node);
+    for (size_t pos = 1; pos != std::string::npos; pos = path.find('/', pos + 1)) {
+        mkdir(path.substr(0, pos).c_str(), 0755);
+    }
+    FILE *file = fopen(path.c_str(), "w");
+    ASSERT_NE(nullptr, file) << path;
+    fputs(contents.c_str(), file);
+    fclose(file);
+}
+
+void SendUevent(const std::string &header) {
+    std::string msg = header;
+    msg += '\0';
+    msg += "ACTION=change";
+    msg += '\0';
+    ASSERT_EQ(static_cast<ssize_t>(msg.size()), send(g_ueventFds[0], msg.data(), msg.size(), 0));
+}
+
+bool WaitFor(const std::function<bool()> &condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+bool Drained() {
+    int pending = 0;
+    return ioctl(g_ueventFds[1], FIONREAD, &pending) == 0 && pending == 0;
+}
+
+// Sends a display uevent and waits until a lookup has rescanned the nodes because of it.
+void SendDisplayUevent(const std::string &header) {
+    SendUevent(header);
+    ASSERT_TRUE(WaitFor([] { return Drained() && getFBNodeCache().changed.load(); }));
+    getExternalNode("dp panel");
+    ASSERT_FALSE(getFBNodeCache().changed.load());
+}
+
+class QdUtilsTest : public ::testing::Test {
+ protected:
+    static void SetUpTestCase() {
+        // The listener starts once per process and keeps its end of the pair
+        if (g_ueventFds[0] < 0) {
+            ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, g_ueventFds));
+            openUeventSource = [] { return g_ueventFds[1]; };
+        }
+    }
+
+    void SetUp() override {
+        WriteNode(0, "msm_fb_type", "dsi panel\n");
+        WriteNode(1, "msm_fb_type", "dp panel\n");
+        WriteNode(2, "msm_fb_type", "writeback panel\n");
+        WriteNode(3, "msm_fb_type", "\n");
+        WriteNode(1, "connected", "1\n");
+        getExternalNode("dp panel");
+        ASSERT_TRUE(getFBNodeCache().watching.load());
+        SendDisplayUevent("change@/devices/virtual/graphics/fb0");
+    }
+
+    // Moves the DP node to fb2 on disk only.
+    void MoveDPNode() {
+        WriteNode(1, "msm_fb_type", "writeback panel\n");
+        WriteNode(2, "msm_fb_type", "dp panel\n");
+    }
+};
+
+TEST_F(QdUtilsTest, FindsNodesByType) {
+    EXPECT_EQ(0, getExternalNode("dsi panel"));
+    EXPECT_EQ(1, getExternalNode("dp panel"));
+    EXPECT_EQ(-1, getExternalNode("hdmi panel"));
+
+    // Connection state is read on every query
+    EXPECT_TRUE(isDPConnected());
+    WriteNode(1, "connected", "0\n");
+    EXPECT_FALSE(isDPConnected());
+}
+
+TEST_F(QdUtilsTest, ReadsDPTestConfig) {
+    WriteNode(1, "config", "bpp=30\npattern=2\n");
+    uint32_t bpp = 0;
+    uint32_t pattern = 0;
+    ASSERT_EQ(0, getDPTestConfig(&bpp, &pattern));
+    EXPECT_EQ(30U, bpp);
+    EXPECT_EQ(2U, pattern);
+}
+
+TEST_F(QdUtilsTest, KeepsTypesUntilDisplayUevent) {
+    MoveDPNode();
+    EXPECT_EQ(1, getExternalNode("dp panel"));
+
+    SendDisplayUevent("change@/devices/virtual/graphics/fb2");
+    EXPECT_EQ(2, getExternalNode("dp panel"));
+}
+
+TEST_F(QdUtilsTest, IgnoresUnrelatedUevents) {
+    // Far more than the socket could hold if it were only drained on lookups
+    for (int i = 0; i < 5000; i++) {
+        SendUevent(i % 2 ? "change@/devices/system/cpu/cpu0" : "add@/devices/virtual/net/wlan0");
+    }
+    ASSERT_TRUE(WaitFor(Drained));
+
+    MoveDPNode();
+    EXPECT_EQ(1, getExternalNode("dp panel"));
+}
+
+TEST_F(QdUtilsTest, SwitchAndExtconUeventsInvalidate) {
+    MoveDPNode();
+    SendDisplayUevent("change@/devices/virtual/switch/hdmi");
+    EXPECT_EQ(2, getExternalNode("dp panel"));
+
+    WriteNode(2, "msm_fb_type", "writeback panel\n");
+    WriteNode(3, "msm_fb_type", "dp panel\n");
+    SendDisplayUevent("change@/devices/platform/soc/ae90000.qcom,dp_display/extcon/extcon1");
+    EXPECT_EQ(3, getExternalNode("dp panel"));
+}
+
+}  // namespace
+}  // namespace qdutils
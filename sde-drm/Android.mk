@@ -23,6 +23,7 @@ LOCAL_SRC_FILES           := drm_manager.cpp \
                              drm_atomic_req.cpp \
                              drm_utils.cpp \
                              drm_pp_manager.cpp \
+                             drm_blob_cache.cpp \
                              drm_property.cpp \
                              drm_dpps_mgr_imp.cpp
 
@@ -36,4 +37,48 @@ endif
 
 LOCAL_VENDOR_MODULE       := true
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+# Runs libsdedrm against libfakekms, which comes first so that both bind to the fake libdrm.
+LOCAL_MODULE              := sde_drm_test
+LOCAL_VENDOR_MODULE       := true
+LOCAL_MODULE_TAGS         := optional
+LOCAL_HEADER_LIBRARIES    := display_headers
+LOCAL_C_INCLUDES          := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/ \
+                             -isystem external/libdrm \
+                             $(LOCAL_PATH)/../libfakekms
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_CFLAGS              := -Wno-missing-field-initializers -Wall -Werror -fno-operator-names \
+                             -Wno-unused-parameter -DLOG_TAG=\"SDE_DRM\"
+LOCAL_CLANG               := true
+LOCAL_SRC_FILES           := drm_property_test.cpp \
+                             drm_cap_parser_test.cpp \
+                             drm_blob_cache_test.cpp \
+                             drm_connector_test.cpp
+LOCAL_STATIC_LIBRARIES    := libgtest libgtest_main
+LOCAL_SHARED_LIBRARIES    := libfakekms libsdedrm libdisplaydebug
+
+ifeq ($(TARGET_USES_DRM_PP),true)
+LOCAL_CFLAGS              += -DPP_DRM_ENABLE
+endif
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE              := sde_drm_cap_parser_fuzzer
+LOCAL_VENDOR_MODULE       := true
+LOCAL_MODULE_TAGS         := optional
+LOCAL_HEADER_LIBRARIES    := display_headers
+LOCAL_C_INCLUDES          := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/ \
+                             -isystem external/libdrm
+LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_CFLAGS              := -Wno-missing-field-initializers -Wall -Werror -fno-operator-names \
+                             -Wno-unused-parameter -DLOG_TAG=\"SDE_DRM\"
+LOCAL_CLANG               := true
+LOCAL_SRC_FILES           := drm_cap_parser_fuzzer.cpp
+LOCAL_SHARED_LIBRARIES    := libsdedrm libdrm libdisplaydebug
+
+include $(BUILD_FUZZ_TEST)
 endif
@@ -30,6 +30,7 @@
 #include <drm_logger.h>
 
 #include "drm_atomic_req.h"
+#include "drm_blob_cache.h"
 #include "drm_connector.h"
 #include "drm_crtc.h"
 #include "drm_manager.h"
@@ -182,6 +183,7 @@ int DRMAtomicReq::Commit(bool synchronous, bool retain_planes) {
   drm_mgr_->GetPlaneMgr()->PostCommit(token_.crtc_id, !ret);
   drm_mgr_->GetCrtcMgr()->PostCommit(token_.crtc_id, !ret);
   drmModeAtomicSetCursor(drm_atomic_req_, 0);
+  DRMBlobCache::GetInstance(fd_)->Flush(!ret);
 
   return ret;
 }
@@ -0,0 +1,178 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <drm_logger.h>
+#include <errno.h>
+#include <string.h>
+#include <utils/hash.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include <map>
+#include <vector>
+
+#include "drm_blob_cache.h"
+
+namespace sde_drm {
+
+using std::lock_guard;
+using std::map;
+using std::mutex;
+
+#define __CLASS__ "DRMBlobCache"
+
+map<int, DRMBlobCache *> DRMBlobCache::s_instances;
+mutex DRMBlobCache::s_lock;
+
+DRMBlobCache *DRMBlobCache::GetInstance(int fd) {
+  lock_guard<mutex> lock(s_lock);
+  DRMBlobCache *&instance = s_instances[fd];
+  if (!instance) {
+    instance = new DRMBlobCache(fd);
+  }
+
+  return instance;
+}
+
+void DRMBlobCache::Destroy(int fd) {
+  lock_guard<mutex> lock(s_lock);
+  auto it = s_instances.find(fd);
+  if (it != s_instances.end()) {
+    delete it->second;
+    s_instances.erase(it);
+  }
+}
+
+DRMBlobCache::~DRMBlobCache() {
+  for (auto &blob : blobs_) {
+    if (blob.second.refs) {
+      DRM_LOGW("Blob %u destroyed with %u references", blob.first, blob.second.refs);
+    }
+    drmModeDestroyPropertyBlob(fd_, blob.first);
+  }
+}
+
+int DRMBlobCache::Acquire(const void *data, uint32_t size, uint32_t *blob_id) {
+  if (!data || !size || !blob_id) {
+    return -EINVAL;
+  }
+
+  uint64_t hash = sdm::HashBytes(data, size);
+  lock_guard<mutex> lock(lock_);
+  auto range = blob_ids_.equal_range(hash);
+  for (auto it = range.first; it != range.second; it++) {
+    BlobEntry &entry = blobs_[it->second];
+    if (entry.content.size() != size || memcmp(entry.content.data(), data, size)) {
+      continue;
+    }
+    if (!entry.refs++) {
+      idle_blobs_.remove(it->second);
+    }
+    *blob_id = it->second;
+    return 0;
+  }
+
+  uint32_t id = 0;
+  int ret = drmModeCreatePropertyBlob(fd_, data, size, &id);
+  if (ret || !id) {
+    DRM_LOGE("Failed to create blob of size %u, ret %d", size, ret);
+    return ret ? ret : -EINVAL;
+  }
+
+  BlobEntry &entry = blobs_[id];
+  entry.refs = 1;
+  entry.hash = hash;
+  entry.content.assign(static_cast<const uint8_t *>(data),
+                       static_cast<const uint8_t *>(data) + size);
+  blob_ids_.emplace(hash, id);
+  *blob_id = id;
+
+  return 0;
+}
+
+void DRMBlobCache::Release(uint32_t blob_id) {
+  lock_guard<mutex> lock(lock_);
+  auto it = blobs_.find(blob_id);
+  if (it == blobs_.end() || !it->second.refs) {
+    DRM_LOGE("Release of unknown or unreferenced blob %u", blob_id);
+    return;
+  }
+
+  if (!--it->second.refs) {
+    it->second.released = pending_commit_;
+    idle_blobs_.push_back(blob_id);
+  }
+}
+
+int DRMBlobCache::Replace(const void *data, uint32_t size, uint32_t *blob_id) {
+  uint32_t new_blob_id = 0;
+  if (size) {
+    int ret = Acquire(data, size, &new_blob_id);
+    if (ret) {
+      return ret;
+    }
+  }
+
+  if (*blob_id) {
+    Release(*blob_id);
+  }
+  *blob_id = new_blob_id;
+
+  return 0;
+}
+
+void DRMBlobCache::Flush(bool committed) {
+  lock_guard<mutex> lock(lock_);
+  if (committed) {
+    retired_commit_ = pending_commit_;
+  }
+  pending_commit_++;
+
+  // Blobs are idle in release order, the first one not retired yet ends the walk.
+  while (idle_blobs_.size() > kMaxIdleBlobs) {
+    uint32_t blob_id = idle_blobs_.front();
+    auto it = blobs_.find(blob_id);
+    if (it->second.released > retired_commit_) {
+      break;
+    }
+
+    idle_blobs_.pop_front();
+    drmModeDestroyPropertyBlob(fd_, blob_id);
+    auto range = blob_ids_.equal_range(it->second.hash);
+    for (auto id = range.first; id != range.second; id++) {
+      if (id->second == blob_id) {
+        blob_ids_.erase(id);
+        break;
+      }
+    }
+    blobs_.erase(it);
+  }
+}
+
+}  // namespace sde_drm
@@ -0,0 +1,94 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __DRM_BLOB_CACHE_H__
+#define __DRM_BLOB_CACHE_H__
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace sde_drm {
+
+// Refcounted, content addressed cache of the property blobs of one device fd, shared by all its
+// DRM objects. A payload that matches an existing blob reuses its id, so unchanged modes, scaler
+// LUTs and post-processing payloads neither create new blobs nor look like a property change to
+// the driver. Payloads are looked up by hash and size and compared only on a match.
+class DRMBlobCache {
+ public:
+  // Returns the cache of fd, created on first use.
+  static DRMBlobCache *GetInstance(int fd);
+  // Destroys the cache of fd along with all its blobs.
+  static void Destroy(int fd);
+
+  // Returns in blob_id a blob holding the payload, created only if no blob has the same content.
+  // Every successful Acquire must be paired with a Release of the returned id.
+  int Acquire(const void *data, uint32_t size, uint32_t *blob_id);
+  void Release(uint32_t blob_id);
+  // Points blob_id at a blob holding the payload, or at none if size is 0, and releases the blob it
+  // pointed at before. The new blob is acquired first, so unchanged content keeps its id.
+  int Replace(const void *data, uint32_t size, uint32_t *blob_id);
+  // Called after every atomic commit with its outcome. Destroys the oldest unreferenced blobs
+  // beyond the few kept for reuse, but only those released before a commit that succeeded. A blob
+  // dropped while building a commit that failed stays alive, as the state it belonged to is still
+  // the one on screen.
+  void Flush(bool committed);
+
+ private:
+  struct BlobEntry {
+    uint32_t refs = 0;
+    uint64_t hash = 0;
+    uint64_t released = 0;  // Commit being built when the last reference was dropped
+    std::vector<uint8_t> content;
+  };
+
+  explicit DRMBlobCache(int fd) : fd_(fd) {}
+  ~DRMBlobCache();
+
+  // Unreferenced blobs kept alive, e.g. for toggling between two modes or LUTs.
+  static const size_t kMaxIdleBlobs = 8;
+
+  int fd_ = -1;
+  std::mutex lock_;
+  std::unordered_map<uint32_t, BlobEntry> blobs_;
+  std::unordered_multimap<uint64_t, uint32_t> blob_ids_;  // Content hash to blob ids
+  std::list<uint32_t> idle_blobs_;  // Least recently released first
+  uint64_t pending_commit_ = 1;
+  uint64_t retired_commit_ = 0;    // Last commit that succeeded
+
+  static std::map<int, DRMBlobCache *> s_instances;
+  static std::mutex s_lock;
+};
+
+}  // namespace sde_drm
+
+#endif  // __DRM_BLOB_CACHE_H__
@@ -0,0 +1,239 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <drm_interface.h>
+#include <gtest/gtest.h>
+#include <xf86drm.h>
+#include <string>
+#include <vector>
+
+#include "drm_blob_cache.h"
+#include "fake_kms.h"
+
+extern "C" int GetDRMManager(int fd, sde_drm::DRMManagerInterface **intf);
+extern "C" int DestroyDRMManager();
+
+namespace sde_drm {
+
+namespace {
+
+// Unreferenced blobs the cache keeps for reuse.
+const uint64_t kMaxIdleBlobs = 8;
+
+uint64_t LiveBlobs() {
+  fake_kms::Stats stats = {};
+  fake_kms::GetStats(&stats);
+  return stats.blobs_created - stats.blobs_destroyed;
+}
+
+std::vector<uint8_t> Payload(uint32_t value, size_t size = 64) {
+  std::vector<uint8_t> payload(size, 0x5a);
+  payload.back() = static_cast<uint8_t>(value);
+  payload.front() = static_cast<uint8_t>(value >> 8);
+  return payload;
+}
+
+class DRMBlobCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    ASSERT_EQ(0, fake_kms::Configure(fake_kms::DefaultConfig()));
+    fd_ = drmOpen("msm_drm", nullptr);
+    ASSERT_GE(fd_, 0);
+    fake_kms::ResetStats();
+  }
+
+  void TearDown() {
+    DRMBlobCache::Destroy(fd_);
+    EXPECT_EQ(0u, LiveBlobs());
+    drmClose(fd_);
+  }
+
+  uint32_t Acquire(const std::vector<uint8_t> &payload) {
+    uint32_t blob_id = 0;
+    EXPECT_EQ(0, DRMBlobCache::GetInstance(fd_)->Acquire(payload.data(),
+                                                          static_cast<uint32_t>(payload.size()),
+                                                          &blob_id));
+    EXPECT_NE(0u, blob_id);
+    return blob_id;
+  }
+
+  int fd_ = -1;
+};
+
+}  // namespace
+
+TEST_F(DRMBlobCacheTest, InstancePerFd) {
+  int other_fd = drmOpen("msm_drm", nullptr);
+  ASSERT_GE(other_fd, 0);
+  DRMBlobCache *cache = DRMBlobCache::GetInstance(fd_);
+  EXPECT_EQ(cache, DRMBlobCache::GetInstance(fd_));
+  EXPECT_NE(cache, DRMBlobCache::GetInstance(other_fd));
+
+  // Blobs belong to the fd that created them, so equal content is not shared across fds.
+  std::vector<uint8_t> payload = Payload(1);
+  uint32_t blob_id = 0, other_blob_id = 0;
+  EXPECT_EQ(0, cache->Acquire(payload.data(), 64, &blob_id));
+  EXPECT_EQ(0, DRMBlobCache::GetInstance(other_fd)->Acquire(payload.data(), 64, &other_blob_id));
+  EXPECT_NE(blob_id, other_blob_id);
+  EXPECT_EQ(2u, LiveBlobs());
+
+  DRMBlobCache::Destroy(other_fd);
+  EXPECT_EQ(1u, LiveBlobs());
+  cache->Release(blob_id);
+  drmClose(other_fd);
+}
+
+TEST_F(DRMBlobCacheTest, SharesEqualContent) {
+  uint32_t first = Acquire(Payload(1));
+  EXPECT_EQ(first, Acquire(Payload(1)));
+  // Same size, differing in the first or the last byte only.
+  uint32_t second = Acquire(Payload(2));
+  uint32_t third = Acquire(Payload(0x102));
+  EXPECT_NE(first, second);
+  EXPECT_NE(second, third);
+  // Same prefix, other size.
+  EXPECT_NE(first, Acquire(Payload(1, 65)));
+  EXPECT_EQ(4u, LiveBlobs());
+
+  DRMBlobCache *cache = DRMBlobCache::GetInstance(fd_);
+  cache->Release(first);
+  // Still referenced once, and an idle blob is reused as long as it is alive.
+  EXPECT_EQ(first, Acquire(Payload(1)));
+  cache->Release(first);
+  cache->Release(first);
+  EXPECT_EQ(first, Acquire(Payload(1)));
+  cache->Release(first);
+  EXPECT_EQ(4u, LiveBlobs());
+}
+
+// Blobs released while building a commit that failed stay alive until a later commit succeeds.
+TEST_F(DRMBlobCacheTest, RetiresBlobsOnSuccessfulCommit) {
+  DRMBlobCache *cache = DRMBlobCache::GetInstance(fd_);
+  for (uint32_t i = 0; i < 20; i++) {
+    cache->Release(Acquire(Payload(i)));
+  }
+  cache->Flush(false /* committed */);
+  EXPECT_EQ(20u, LiveBlobs());
+
+  // Released during the failed commit, so the next successful one retires them.
+  uint32_t held = Acquire(Payload(100));
+  cache->Flush(true /* committed */);
+  EXPECT_EQ(1u + kMaxIdleBlobs, LiveBlobs());
+  // The most recently released blobs are the ones kept.
+  uint64_t live = LiveBlobs();
+  cache->Release(Acquire(Payload(19)));
+  EXPECT_EQ(live, LiveBlobs());
+  cache->Release(held);
+}
+
+// Replaces a payload every frame, cycling through a few and adding unique ones now and then, with
+// every seventh commit failing. The number of live blobs stays bounded and nothing leaks.
+TEST_F(DRMBlobCacheTest, BoundedOverManyFrames) {
+  DRMBlobCache *cache = DRMBlobCache::GetInstance(fd_);
+  uint32_t blob_ids[3] = {};
+  for (uint32_t frame = 0; frame < 2000; frame++) {
+    for (uint32_t holder = 0; holder < 3; holder++) {
+      uint32_t value = (frame % 5 == holder) ? 1000 + frame : (frame + holder) % 12;
+      std::vector<uint8_t> payload = Payload(value, 64 + holder);
+      ASSERT_EQ(0, cache->Replace(payload.data(), static_cast<uint32_t>(payload.size()),
+                                  &blob_ids[holder]));
+    }
+    cache->Flush(frame % 7 != 0);
+    ASSERT_LE(LiveBlobs(), 3u + kMaxIdleBlobs + 3u);
+  }
+
+  for (auto &blob_id : blob_ids) {
+    cache->Replace(nullptr, 0, &blob_id);
+    EXPECT_EQ(0u, blob_id);
+  }
+  cache->Flush(true);
+  EXPECT_EQ(kMaxIdleBlobs, LiveBlobs());
+}
+
+#ifdef PP_DRM_ENABLE
+// An unchanged post-processing payload keeps its blob, and every commit still carries the property
+// so that the driver programs the feature again.
+TEST_F(DRMBlobCacheTest, ResendsUnchangedPostProcessingBlob) {
+  drmClose(fd_);
+  fake_kms::Config config = fake_kms::DefaultConfig();
+  config.crtc_properties = {"SDE_DSPP_PCC_V4"};
+  ASSERT_EQ(0, fake_kms::Configure(config));
+  fd_ = drmOpen("msm_drm", nullptr);
+  ASSERT_GE(fd_, 0);
+
+  DRMManagerInterface *drm_mgr = nullptr;
+  ASSERT_EQ(0, ::GetDRMManager(fd_, &drm_mgr));
+  DRMDisplayToken token = {};
+  DRMConnectorInfo conn_info = {};
+  ASSERT_EQ(0, drm_mgr->RegisterDisplay(DRMDisplayType::PERIPHERAL, &token));
+  ASSERT_EQ(0, drm_mgr->GetConnectorInfo(token.conn_id, &conn_info));
+  ASSERT_FALSE(conn_info.modes.empty());
+
+  DRMAtomicReqInterface *req = nullptr;
+  ASSERT_EQ(0, drm_mgr->CreateAtomicReq(token, &req));
+  drmModeModeInfo mode = conn_info.modes.at(0).mode;
+  req->Perform(DRMOps::CRTC_SET_MODE, token.crtc_id, &mode);
+  req->Perform(DRMOps::CRTC_SET_ACTIVE, token.crtc_id, 1);
+  req->Perform(DRMOps::CONNECTOR_SET_CRTC, token.conn_id, token.crtc_id);
+  req->Perform(DRMOps::CONNECTOR_SET_POWER_MODE, token.conn_id, DRMPowerMode::ON);
+  ASSERT_EQ(0, req->Commit(true /* synchronous */, false /* retain_planes */));
+  fake_kms::Stats start = {};
+  fake_kms::GetStats(&start);
+
+  std::vector<uint8_t> payload = Payload(7, 256);
+  DRMPPFeatureInfo feature = {};
+  feature.id = kFeaturePcc;
+  feature.type = kPropBlob;
+  feature.payload_size = static_cast<uint32_t>(payload.size());
+  for (int frame = 0; frame < 3; frame++) {
+    // A fresh copy each frame, as the color manager converts into a reused buffer.
+    std::vector<uint8_t> copy = payload;
+    feature.payload = copy.data();
+    req->Perform(DRMOps::CRTC_SET_POST_PROC, token.crtc_id, &feature);
+    ASSERT_EQ(0, req->Commit(true /* synchronous */, false /* retain_planes */));
+    EXPECT_EQ(static_cast<uint64_t>(frame + 1),
+              fake_kms::GetPropertyWrites(token.crtc_id, "SDE_DSPP_PCC_V4"));
+  }
+  fake_kms::Stats stats = {};
+  fake_kms::GetStats(&stats);
+  EXPECT_EQ(1u, stats.blobs_created - start.blobs_created);
+
+  // Disabling the feature writes the property once more, with no blob.
+  feature.payload = nullptr;
+  req->Perform(DRMOps::CRTC_SET_POST_PROC, token.crtc_id, &feature);
+  ASSERT_EQ(0, req->Commit(true /* synchronous */, false /* retain_planes */));
+  EXPECT_EQ(4u, fake_kms::GetPropertyWrites(token.crtc_id, "SDE_DSPP_PCC_V4"));
+
+  drm_mgr->DestroyAtomicReq(req);
+  drm_mgr->UnregisterDisplay(&token);
+  ::DestroyDRMManager();
+}
+#endif
+
+}  // namespace sde_drm
@@ -0,0 +1,98 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Feeds arbitrary capability and mode properties blobs through the libsdedrm parsers. The first
+// byte selects the parser, the second the blob id. Every input is parsed twice, the second time
+// under another id so that it comes from the cache, and both results must agree.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "drm_connector.h"
+#include "drm_crtc.h"
+
+using sde_drm::DRMConnector;
+using sde_drm::DRMConnectorInfo;
+using sde_drm::DRMCrtc;
+using sde_drm::DRMCrtcInfo;
+
+static void CheckCrtc(uint32_t blob_id, const uint8_t *data, uint32_t length) {
+  DRMCrtcInfo first = {}, second = {};
+  int first_error = DRMCrtc::ApplyCapabilities(blob_id, data, length, &first);
+  int second_error = DRMCrtc::ApplyCapabilities(blob_id + 256, data, length, &second);
+  if (first_error != second_error || first.max_blend_stages != second.max_blend_stages ||
+      first.line_width_limits != second.line_width_limits ||
+      first.comp_ratio_rt_map.size() != second.comp_ratio_rt_map.size()) {
+    abort();
+  }
+}
+
+static void CheckConnector(uint32_t blob_id, const uint8_t *data, uint32_t length) {
+  DRMConnectorInfo first = {}, second = {};
+  int first_error = DRMConnector::ApplyCapabilities(blob_id, data, length, &first);
+  int second_error = DRMConnector::ApplyCapabilities(blob_id + 256, data, length, &second);
+  if (first_error != second_error || first.panel_name != second.panel_name ||
+      first.formats_supported != second.formats_supported) {
+    abort();
+  }
+}
+
+static void CheckModes(uint32_t blob_id, const uint8_t *data, uint32_t length) {
+  DRMConnectorInfo first = {}, second = {};
+  first.modes.resize(3);
+  second.modes.resize(3);
+  int first_error = DRMConnector::ApplyModeProperties(blob_id, data, length, &first);
+  int second_error = DRMConnector::ApplyModeProperties(blob_id + 256, data, length, &second);
+  for (size_t i = 0; i < first.modes.size(); i++) {
+    if (first.modes[i].topology != second.modes[i].topology ||
+        first.modes[i].bit_clk_rate != second.modes[i].bit_clk_rate) {
+      abort();
+    }
+  }
+  if (first_error != second_error) {
+    abort();
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < 2 || size > UINT16_MAX) {
+    return 0;
+  }
+
+  uint32_t blob_id = data[1];
+  const uint8_t *blob = data + 2;
+  uint32_t length = static_cast<uint32_t>(size - 2);
+  switch (data[0] % 3) {
+    case 0: CheckCrtc(blob_id, blob, length); break;
+    case 1: CheckConnector(blob_id, blob, length); break;
+    default: CheckModes(blob_id, blob, length); break;
+  }
+
+  return 0;
+}
@@ -0,0 +1,322 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <drm/drm_fourcc.h>
+#include <gtest/gtest.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "drm_connector.h"
+#include "drm_crtc.h"
+#include "drm_utils.h"
+
+namespace sde_drm {
+
+namespace {
+
+struct TestCaps {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::string name = {};
+};
+
+// Schema over TestCaps that counts how often values are compiled, i.e. how often the cache missed.
+class CountingParser {
+ public:
+  CountingParser()
+    : parser_({
+        {"width", [this](const std::string &value, DRMCapSetter<TestCaps> *setter) {
+          compiles_++;
+          uint32_t width = 0;
+          if (!ParseCapValue(value, &width)) {
+            return false;
+          }
+          *setter = [width](TestCaps *caps) { caps->width = width; };
+          return true;
+        }},
+        CapField("height", &TestCaps::height),
+        {"name", [](const std::string &value, DRMCapSetter<TestCaps> *setter) {
+          *setter = [value](TestCaps *caps) { caps->name = value; };
+          return true;
+        }},
+      }) {}
+
+  int Parse(uint32_t blob_id, const std::string &text, TestCaps *caps) {
+    // Blobs carry their terminating NUL, like the ones the kernel exposes.
+    return parser_.Parse(blob_id, text.c_str(), static_cast<uint32_t>(text.size() + 1), caps);
+  }
+
+  uint32_t compiles_ = 0;
+
+ private:
+  DRMCapParser<TestCaps> parser_;
+};
+
+std::string Blob(uint32_t width) {
+  return "width=" + std::to_string(width) + "\nheight=1080\nname=panel\n";
+}
+
+// Capabilities of an SDM845 CRTC as read from the kernel.
+const char kCrtcCapabilities[] =
+  "max_blendstages=11\n"
+  "qseed_type=qseed3\n"
+  "smart_dma_rev=smart_dma_v2p5\n"
+  "has_src_split=1\n"
+  "has_hdr=1\n"
+  "core_ib_ff=2.5\n"
+  "core_clk_ff=1.0\n"
+  "comp_ratio_rt=AB24/5/1/1.2 NV12/5/1/1.65\n"
+  "comp_ratio_nrt=AB24/5/1/1.2 NV12/5/1/1.6\n"
+  "dest_scale_prefill_lines=3\n"
+  "undersized_prefill_lines=2\n"
+  "macrotile_prefill_lines=4\n"
+  "yuv_nv12_prefill_lines=8\n"
+  "linear_prefill_lines=1\n"
+  "downscaling_prefill_lines=1\n"
+  "xtra_prefill_lines=2\n"
+  "amortizable_threshold=25\n"
+  "max_bandwidth_low=9600000\n"
+  "max_bandwidth_high=9600000\n"
+  "max_mdp_clk=412500000\n"
+  "hw_version=1073741824\n"
+  "dim_layer_v1_max_layers=7\n"
+  "dest_scaler_count=2\n"
+  "max_dest_scale_up=2\n"
+  "max_dest_scaler_input_width=2048\n"
+  "max_dest_scaler_output_width=2560\n"
+  "min_prefill_lines=21\n"
+  "sec_ui_blendstage=4\n"
+  "num_mnoc_ports=2\n"
+  "axi_bus_width=32\n"
+  "sspp_linewidth_usecases=3\n"
+  "vig=1\n"
+  "dma=2\n"
+  "scale=3\n"
+  "inline_rot=4\n"
+  "sspp_linewidth_values=3\n"
+  "limit_usecase=1\n"
+  "limit_value=4096\n"
+  "limit_usecase=2\n"
+  "limit_value=0\n"
+  "limit_usecase=3\n"
+  "limit_value=2560\n"
+  "has_uidle=1\n"
+  "UBWC version=805306368\n"
+  "unknown_key=1\n";
+
+const char kConnectorCapabilities[] =
+  "pixel_formats=AB24 XB24 NV12/5/1\n"
+  "maxlinewidth=4096\n"
+  "display type=primary\n"
+  "panel name=sim cmd mode dsi panel\n"
+  "panel mode=command\n"
+  "dfps support=true\n"
+  "panel orientation=horz & vert flip\n"
+  "qsync support=false\n"
+  "dyn bitclk support=true\n";
+
+const char kModeProperties[] =
+  "mode_name=1080x2400\n"
+  "topology=sde_singlepipe_dsc\n"
+  "partial_update_num_roi=1\n"
+  "partial_update_xstart=0\n"
+  "partial_update_ystart=0\n"
+  "partial_update_walign=8\n"
+  "partial_update_halign=16\n"
+  "partial_update_wmin=8\n"
+  "partial_update_hmin=32\n"
+  "partial_update_roimerge=1\n"
+  "bit_clk_rate=1100000000\n"
+  "mdp_transfer_time_us=14000\n"
+  "mode_name=1080x2400\n"
+  "topology=sde_dualpipe_dsc\n"
+  "bit_clk_rate=1200000000\n"
+  "mode_name=720x1600\n"
+  "topology=sde_singlepipe\n";
+
+uint32_t Length(const char *text) {
+  return static_cast<uint32_t>(strlen(text) + 1);
+}
+
+}  // namespace
+
+TEST(DRMCapParserTest, AppliesBlob) {
+  CountingParser parser;
+  TestCaps caps;
+  EXPECT_EQ(0, parser.Parse(1, Blob(1920), &caps));
+  EXPECT_EQ(1920u, caps.width);
+  EXPECT_EQ(1080u, caps.height);
+  EXPECT_EQ("panel", caps.name);
+}
+
+TEST(DRMCapParserTest, MalformedValuesKeepWellFormedOnes) {
+  CountingParser parser;
+  TestCaps caps;
+  caps.height = 7;
+  EXPECT_EQ(-EINVAL, parser.Parse(1, "width=12\nheight=-1\nname=x\n", &caps));
+  EXPECT_EQ(12u, caps.width);
+  EXPECT_EQ(7u, caps.height);
+  EXPECT_EQ("x", caps.name);
+  // The error is cached along with the setters.
+  EXPECT_EQ(-EINVAL, parser.Parse(1, "width=12\nheight=-1\nname=x\n", &caps));
+}
+
+TEST(DRMCapParserTest, SharesCompiledBlobAcrossIds) {
+  CountingParser parser;
+  for (uint32_t blob_id = 1; blob_id <= 4; blob_id++) {
+    TestCaps caps;
+    parser.Parse(blob_id, Blob(1920), &caps);
+    EXPECT_EQ(1920u, caps.width);
+  }
+  EXPECT_EQ(1u, parser.compiles_);
+}
+
+TEST(DRMCapParserTest, ReusedIdWithNewContentIsParsedAgain) {
+  CountingParser parser;
+  TestCaps caps;
+  parser.Parse(5, Blob(1920), &caps);
+  parser.Parse(5, Blob(2560), &caps);
+  EXPECT_EQ(2560u, caps.width);
+  parser.Parse(5, Blob(1920), &caps);
+  EXPECT_EQ(1920u, caps.width);
+  // Same length, differing content.
+  parser.Parse(5, Blob(1921), &caps);
+  EXPECT_EQ(1921u, caps.width);
+}
+
+// A blob in use keeps its entry while more distinct blobs than the cache holds go by.
+TEST(DRMCapParserTest, EvictsLeastRecentlyUsed) {
+  CountingParser parser;
+  TestCaps caps;
+  for (uint32_t i = 0; i < 64; i++) {
+    parser.Parse(1, Blob(1920), &caps);
+    parser.Parse(100 + i, Blob(100 + i), &caps);
+  }
+  EXPECT_EQ(1u + 64u, parser.compiles_);
+
+  // The least recent blobs were dropped and are compiled again.
+  uint32_t compiles = parser.compiles_;
+  parser.Parse(100, Blob(100), &caps);
+  EXPECT_EQ(compiles + 1, parser.compiles_);
+}
+
+TEST(DRMCapParserTest, CrtcGolden) {
+  DRMCrtcInfo info = {};
+  EXPECT_EQ(0, DRMCrtc::ApplyCapabilities(1, kCrtcCapabilities, Length(kCrtcCapabilities), &info));
+  EXPECT_EQ(11u, info.max_blend_stages);
+  EXPECT_EQ(QSEEDVersion::V3, info.qseed_version);
+  EXPECT_EQ(SmartDMARevision::V2p5, info.smart_dma_rev);
+  EXPECT_TRUE(info.has_src_split);
+  EXPECT_TRUE(info.has_hdr);
+  EXPECT_FLOAT_EQ(2.5f, info.ib_fudge_factor);
+  EXPECT_FLOAT_EQ(1.0f, info.clk_fudge_factor);
+  EXPECT_EQ(3u, info.dest_scale_prefill_lines);
+  EXPECT_EQ(2u, info.undersized_prefill_lines);
+  EXPECT_EQ(4u, info.macrotile_prefill_lines);
+  EXPECT_EQ(8u, info.nv12_prefill_lines);
+  EXPECT_EQ(1u, info.linear_prefill_lines);
+  EXPECT_EQ(1u, info.downscale_prefill_lines);
+  EXPECT_EQ(2u, info.extra_prefill_lines);
+  EXPECT_EQ(25u, info.amortized_threshold);
+  EXPECT_EQ(9600000u, info.max_bandwidth_low);
+  EXPECT_EQ(9600000u, info.max_bandwidth_high);
+  EXPECT_EQ(412500000u, info.max_sde_clk);
+  EXPECT_EQ(0x40000000u, info.hw_version);
+  EXPECT_EQ(7u, info.max_solidfill_stages);
+  EXPECT_EQ(2u, info.dest_scaler_count);
+  EXPECT_EQ(2u, info.max_dest_scale_up);
+  EXPECT_EQ(2048u, info.max_dest_scaler_input_width);
+  EXPECT_EQ(2560u, info.max_dest_scaler_output_width);
+  EXPECT_EQ(21u, info.min_prefill_lines);
+  EXPECT_EQ(4, info.secure_disp_blend_stage);
+  EXPECT_EQ(2u, info.num_mnocports);
+  EXPECT_EQ(32u, info.mnoc_bus_width);
+  EXPECT_EQ(3u, info.line_width_constraints_count);
+  EXPECT_EQ(1u, info.vig_limit_index);
+  EXPECT_EQ(2u, info.dma_limit_index);
+  EXPECT_EQ(3u, info.scaling_limit_index);
+  EXPECT_EQ(4u, info.rotation_limit_index);
+  std::vector<std::pair<uint32_t, uint32_t>> limits = {{1, 4096}, {3, 2560}};
+  EXPECT_EQ(limits, info.line_width_limits);
+  EXPECT_TRUE(info.has_micro_idle);
+  EXPECT_EQ(3u, info.ubwc_version);
+
+  uint64_t ubwc = fourcc_mod_code(QCOM, 1);
+  auto rgba = std::make_pair(static_cast<uint32_t>(fourcc_code('A', 'B', '2', '4')), ubwc);
+  auto nv12 = std::make_pair(static_cast<uint32_t>(fourcc_code('N', 'V', '1', '2')), ubwc);
+  ASSERT_EQ(2u, info.comp_ratio_rt_map.size());
+  EXPECT_FLOAT_EQ(1.2f, info.comp_ratio_rt_map[rgba]);
+  EXPECT_FLOAT_EQ(1.65f, info.comp_ratio_rt_map[nv12]);
+  ASSERT_EQ(2u, info.comp_ratio_nrt_map.size());
+  EXPECT_FLOAT_EQ(1.6f, info.comp_ratio_nrt_map[nv12]);
+}
+
+TEST(DRMCapParserTest, ConnectorGolden) {
+  DRMConnectorInfo info = {};
+  EXPECT_EQ(0, DRMConnector::ApplyCapabilities(1, kConnectorCapabilities,
+                                               Length(kConnectorCapabilities), &info));
+  std::vector<std::pair<uint32_t, uint64_t>> formats = {
+    {fourcc_code('A', 'B', '2', '4'), 0}, {fourcc_code('X', 'B', '2', '4'), 0},
+    {fourcc_code('N', 'V', '1', '2'), fourcc_mod_code(QCOM, 1)},
+  };
+  EXPECT_EQ(formats, info.formats_supported);
+  EXPECT_EQ(4096u, info.max_linewidth);
+  EXPECT_TRUE(info.is_primary);
+  EXPECT_EQ("sim cmd mode dsi panel", info.panel_name);
+  EXPECT_EQ(DRMPanelMode::COMMAND, info.panel_mode);
+  EXPECT_TRUE(info.dynamic_fps);
+  EXPECT_EQ(DRMRotation::ROT_180, info.panel_orientation);
+  EXPECT_FALSE(info.qsync_support);
+  EXPECT_FALSE(info.is_wb_ubwc_supported);
+  EXPECT_TRUE(info.dyn_bitclk_support);
+}
+
+TEST(DRMCapParserTest, ModePropertiesGolden) {
+  DRMConnectorInfo info = {};
+  info.modes.resize(2);
+  EXPECT_EQ(0, DRMConnector::ApplyModeProperties(1, kModeProperties, Length(kModeProperties),
+                                                 &info));
+  const DRMModeInfo &first = info.modes.at(0);
+  EXPECT_EQ(DRMTopology::SINGLE_LM_DSC, first.topology);
+  EXPECT_EQ(1, first.num_roi);
+  EXPECT_EQ(8, first.walign);
+  EXPECT_EQ(16, first.halign);
+  EXPECT_EQ(8, first.wmin);
+  EXPECT_EQ(32, first.hmin);
+  EXPECT_TRUE(first.roi_merge);
+  EXPECT_EQ(1100000000u, first.bit_clk_rate);
+  EXPECT_EQ(14000u, first.transfer_time_us);
+  // Properties beyond the known modes are dropped.
+  EXPECT_EQ(DRMTopology::DUAL_LM_DSC, info.modes.at(1).topology);
+  EXPECT_EQ(1200000000u, info.modes.at(1).bit_clk_rate);
+}
+
+}  // namespace sde_drm
@@ -37,6 +37,7 @@
 #include <string.h>
 
 #include <algorithm>
+#include <chrono>
 #include <map>
 #include <memory>
 #include <sstream>
@@ -60,6 +61,9 @@ using std::map;
 using std::mutex;
 using std::lock_guard;
 using std::set;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
 
 static uint8_t ON = 0;
 static uint8_t DOZE = 1;
@@ -259,57 +263,99 @@ void DRMConnectorManager::Init(drmModeRes *resource) {
 }
 
 void DRMConnectorManager::Update() {
-  lock_guard<mutex> lock(lock_);
-  drmModeRes *resource = drmModeGetResources(fd_);
+  // Hotplug storms, e.g. an MST dock attaching several displays, queue updates back to back. A
+  // pass that started after a request was made reflects it, so requests that waited behind such a
+  // pass return right away.
+  uint64_t request = ++update_requests_;
+  lock_guard<mutex> update_lock(update_lock_);
+  if (updates_done_ >= request) {
+    return;
+  }
+  uint64_t covered = update_requests_;
 
+  auto start = steady_clock::now();
+  drmModeRes *resource = drmModeGetResources(fd_);
   if (NULL == resource) {
     DRM_LOGE("drmModeGetResources() failed. Connector status not updated.");
     return;
   }
 
-  // Build a map of the updated list of connector ids.
-  std::map<uint32_t, uint32_t> drm_connectors;
-  for (int i = 0; i < resource->count_connectors; i++) {
-    drm_connectors[resource->connectors[i]] = resource->connectors[i];
+  set<uint32_t> drm_conn_ids(resource->connectors,
+                             resource->connectors + resource->count_connectors);
+  drmModeFreeResources(resource);
+
+  vector<uint32_t> added_ids;
+  vector<uint32_t> removed_ids;
+  {
+    lock_guard<mutex> lock(lock_);
+    for (auto &conn : connector_pool_) {
+      if (!drm_conn_ids.count(conn.first)) {
+        removed_ids.push_back(conn.first);
+      }
+    }
+    for (auto id : drm_conn_ids) {
+      if (!connector_pool_.count(id)) {
+        added_ids.push_back(id);
+      }
+    }
   }
 
-  // Delete connectors in connector pool.
-  for (auto conn = connector_pool_.cbegin(); conn != connector_pool_.cend();) {
-    auto drmconn = drm_connectors.find(conn->first);
-    if (drmconn == drm_connectors.end()) {
-      // A DRM Connector in our pool was deleted.
+  // Parsing a connector reads several property blobs. Do it without lock_ so that active
+  // displays are not stalled, and only swap the results in under it.
+  vector<pair<uint32_t, unique_ptr<DRMConnector>>> added;
+  for (auto id : added_ids) {
+    auto parse_start = steady_clock::now();
+    drmModeConnector *libdrm_conn = drmModeGetConnector(fd_, id);
+    if (!libdrm_conn) {
+      DRM_LOGW("Critical error: drmModeGetConnector() failed for connector %u.", id);
+      continue;
+    }
+
+    unique_ptr<DRMConnector> conn(new DRMConnector(fd_));
+    conn->InitAndParse(libdrm_conn);
+    conn->SetSkipConnectorReload(true);
+    uint32_t type = 0;
+    conn->GetType(&type);
+    DRM_LOGI("Hotplug event: add, connector %u, type %u, parse time %lld us", id, type,
+             static_cast<long long>(
+                 duration_cast<microseconds>(steady_clock::now() - parse_start).count()));
+    added.emplace_back(id, std::move(conn));
+  }
+
+  size_t num_added = added.size();
+  size_t num_removed = 0;
+  // Destroyed after lock_ is dropped
+  vector<unique_ptr<DRMConnector>> removed;
+  {
+    lock_guard<mutex> lock(lock_);
+    for (auto id : removed_ids) {
+      auto conn = connector_pool_.find(id);
+      if (conn == connector_pool_.end()) {
+        continue;
+      }
       if (conn->second->GetStatus() == DRMStatus::FREE) {
-        DRM_LOGD("Removing connector id %u from pool.", conn->first);
-        conn = connector_pool_.erase(conn);
+        DRM_LOGI("Hotplug event: remove, connector %u", id);
+        removed.push_back(std::move(conn->second));
+        connector_pool_.erase(conn);
+        num_removed++;
       } else {
         // Physically removed DRM Connectors (displays) first go to disconnected state. When its
         // reserved resources are freed up, they are removed from the driver's connector list. Do
         // not remove DRM Connectors that are DRMStatus::BUSY.
-        DRM_LOGW("In-use connector id %u removed by DRM.", conn->first);
-        conn++;
+        DRM_LOGW("In-use connector id %u removed by DRM.", id);
       }
-    } else {
-      // Remove DRM Connector present in both lists to ensure that only new connector ids remain.
-      drm_connectors.erase(drmconn);
-      conn++;
     }
-  }
-
-  // Add new connectors in connector pool.
-  for (auto &drmconn : drm_connectors) {
-    DRM_LOGD("Adding connector id %u to pool.", drmconn.first);
-    unique_ptr<DRMConnector> conn(new DRMConnector(fd_));
-    drmModeConnector *libdrm_conn = drmModeGetConnector(fd_, drmconn.first);
-    if (libdrm_conn) {
-      conn->InitAndParse(libdrm_conn);
-      conn->SetSkipConnectorReload(true);
-      connector_pool_[drmconn.first] = std::move(conn);
-    } else {
-      DRM_LOGW("Critical error: drmModeGetConnector() failed for connector %u.", drmconn.first);
+    for (auto &conn : added) {
+      connector_pool_[conn.first] = std::move(conn.second);
     }
   }
 
-  drmModeFreeResources(resource);
+  if (num_added || num_removed) {
+    DRM_LOGI("Hotplug reconciled: %zu added, %zu removed in %lld us", num_added, num_removed,
+             static_cast<long long>(
+                 duration_cast<microseconds>(steady_clock::now() - start).count()));
+  }
+  updates_done_ = covered;
 }
 
 void DRMConnectorManager::DumpByID(uint32_t id) {
@@ -487,6 +533,140 @@ void DRMConnector::ParseProperties() {
   drmModeFreeObjectProperties(props);
 }
 
+// Schema entry for a key whose value is the literal "true" or "false".
+static DRMCapKey<DRMConnectorInfo> CapFlag(const string &key, bool DRMConnectorInfo::*field) {
+  return {key, [field](const string &value, DRMCapSetter<DRMConnectorInfo> *setter) {
+    bool flag = (value == "true");
+    *setter = [field, flag](DRMConnectorInfo *info) { info->*field = flag; };
+    return true;
+  }};
+}
+
+static DRMCapParser<DRMConnectorInfo> &GetCapParser() {
+  static DRMCapParser<DRMConnectorInfo> parser({
+    {"pixel_formats", [](const string &value, DRMCapSetter<DRMConnectorInfo> *setter) {
+      vector<pair<uint32_t, uint64_t>> formats_supported;
+      ParseFormats(value, &formats_supported);
+      *setter = [formats_supported](DRMConnectorInfo *info) {
+        info->formats_supported = formats_supported;
+      };
+      return true;
+    }},
+    CapField("maxlinewidth", &DRMConnectorInfo::max_linewidth),
+    {"display type", [](const string &value, DRMCapSetter<DRMConnectorInfo> *setter) {
+      bool is_primary = (value == "primary");
+      *setter = [is_primary](DRMConnectorInfo *info) { info->is_primary = is_primary; };
+      return true;
+    }},
+    {"panel name", [](const string &value, DRMCapSetter<DRMConnectorInfo> *setter) {
+      *setter = [value](DRMConnectorInfo *info) { info->panel_name = value; };
+      return true;
+    }},
+    {"panel mode", [](const string &value, DRMCapSetter<DRMConnectorInfo> *setter) {
+      DRMPanelMode mode = (value == "video") ? DRMPanelMode::VIDEO : DRMPanelMode::COMMAND;
+      *setter = [mode](DRMConnectorInfo *info) { info->panel_mode = mode; };
+      return true;
+    }},
+    CapFlag("dfps support", &DRMConnectorInfo::dynamic_fps),
+    {"panel orientation", [](const string &value, DRMCapSetter<DRMConnectorInfo> *setter) {
+      DRMRotation orientation = {};
+      if (value == "horz flip") {
+        orientation = DRMRotation::FLIP_H;
+      } else if (value == "vert flip") {
+        orientation = DRMRotation::FLIP_V;
+      } else if (value == "horz & vert flip") {
+        orientation = DRMRotation::ROT_180;
+      } else {
+        return true;
+      }
+      *setter = [orientation](DRMConnectorInfo *info) { info->panel_orientation = orientation; };
+      return true;
+    }},
+    CapFlag("qsync support", &DRMConnectorInfo::qsync_support),
+    // Presence alone means supported.
+    {"wb_ubwc", [](const string &, DRMCapSetter<DRMConnectorInfo> *setter) {
+      *setter = [](DRMConnectorInfo *info) { info->is_wb_ubwc_supported = true; };
+      return true;
+    }},
+    CapFlag("dyn bitclk support", &DRMConnectorInfo::dyn_bitclk_support),
+  });
+
+  return parser;
+}
+
+// Walks the modes of a connector while its mode properties blob is applied. Each mode_name line
+// starts the properties of the next mode.
+struct DRMModeCursor {
+  vector<DRMModeInfo> *modes;
+  DRMModeInfo *item;
+  size_t next;
+};
+
+template <class V>
+static DRMCapKey<DRMModeCursor> ModeField(const string &key, V DRMModeInfo::*field) {
+  return {key, [field](const string &value, DRMCapSetter<DRMModeCursor> *setter) {
+    V parsed = {};
+    if (!ParseCapValue(value, &parsed)) {
+      return false;
+    }
+    *setter = [field, parsed](DRMModeCursor *cursor) {
+      if (cursor->item) {
+        cursor->item->*field = parsed;
+      }
+    };
+    return true;
+  }};
+}
+
+static DRMCapParser<DRMModeCursor> &GetModeParser() {
+  static DRMCapParser<DRMModeCursor> parser({
+    {"mode_name", [](const string &, DRMCapSetter<DRMModeCursor> *setter) {
+      *setter = [](DRMModeCursor *cursor) {
+        // Properties beyond the known modes are dropped.
+        cursor->item = (cursor->next < cursor->modes->size()) ?
+                       &cursor->modes->at(cursor->next++) : nullptr;
+      };
+      return true;
+    }},
+    {"topology", [](const string &value, DRMCapSetter<DRMModeCursor> *setter) {
+      DRMTopology topology = GetTopologyEnum(value);
+      *setter = [topology](DRMModeCursor *cursor) {
+        if (cursor->item) {
+          cursor->item->topology = topology;
+        }
+      };
+      return true;
+    }},
+    ModeField("partial_update_num_roi", &DRMModeInfo::num_roi),
+    ModeField("partial_update_xstart", &DRMModeInfo::xstart),
+    ModeField("partial_update_ystart", &DRMModeInfo::ystart),
+    ModeField("partial_update_walign", &DRMModeInfo::walign),
+    ModeField("partial_update_halign", &DRMModeInfo::halign),
+    ModeField("partial_update_wmin", &DRMModeInfo::wmin),
+    ModeField("partial_update_hmin", &DRMModeInfo::hmin),
+    ModeField("partial_update_roimerge", &DRMModeInfo::roi_merge),
+    ModeField("bit_clk_rate", &DRMModeInfo::bit_clk_rate),
+    ModeField("mdp_transfer_time_us", &DRMModeInfo::transfer_time_us),
+  });
+
+  return parser;
+}
+
+int DRMConnector::ApplyCapabilities(uint32_t blob_id, const void *data, uint32_t length,
+                                    DRMConnectorInfo *info) {
+  return GetCapParser().Parse(blob_id, data, length, info);
+}
+
+int DRMConnector::ApplyModeProperties(uint32_t blob_id, const void *data, uint32_t length,
+                                      DRMConnectorInfo *info) {
+  if (info->modes.empty()) {
+    return 0;
+  }
+
+  DRMModeCursor cursor = {&info->modes, &info->modes.at(0), 0};
+  return GetModeParser().Parse(blob_id, data, length, &cursor);
+}
+
 void DRMConnector::ParseCapabilities(uint64_t blob_id, DRMConnectorInfo *info) {
   drmModePropertyBlobRes *blob = drmModeGetPropertyBlob(fd_, blob_id);
   if (!blob) {
@@ -494,62 +674,15 @@ void DRMConnector::ParseCapabilities(uint64_t blob_id, DRMConnectorInfo *info) {
   }
 
   if (!blob->data) {
+    drmModeFreePropertyBlob(blob);
     return;
   }
 
-  char *fmt_str = new char[blob->length + 1];
-  memcpy (fmt_str, blob->data, blob->length);
-  fmt_str[blob->length] = '\0';
-  stringstream stream(fmt_str);
-  DRM_LOGI("stream str %s len %zu blob str %s len %d", stream.str().c_str(), stream.str().length(),
-           blob->data, blob->length);
-  string line = {};
-  const string display_type = "display type=";
-  const string panel_name = "panel name=";
-  const string panel_mode = "panel mode=";
-  const string dfps_support = "dfps support=";
-  const string pixel_formats = "pixel_formats=";
-  const string max_linewidth = "maxlinewidth=";
-  const string panel_orientation = "panel orientation=";
-  const string qsync_support = "qsync support=";
-  const string wb_ubwc = "wb_ubwc";
-  const string dyn_bitclk_support = "dyn bitclk support=";
-
-  while (std::getline(stream, line)) {
-    if (line.find(pixel_formats) != string::npos) {
-      vector<pair<uint32_t, uint64_t>> formats_supported;
-      ParseFormats(line.erase(0, pixel_formats.length()), &formats_supported);
-      info->formats_supported = move(formats_supported);
-    } else if (line.find(max_linewidth) != string::npos) {
-      info->max_linewidth = std::stoi(string(line, max_linewidth.length()));
-    } else if (line.find(display_type) != string::npos) {
-      info->is_primary = (string(line, display_type.length()) == "primary");
-    } else if (line.find(panel_name) != string::npos) {
-      info->panel_name = string(line, panel_name.length());
-    } else if (line.find(panel_mode) != string::npos) {
-      info->panel_mode = (string(line, panel_mode.length()) == "video") ? DRMPanelMode::VIDEO
-                                                                        : DRMPanelMode::COMMAND;
-    } else if (line.find(dfps_support) != string::npos) {
-      info->dynamic_fps = (string(line, dfps_support.length()) == "true");
-    } else if (line.find(panel_orientation) != string::npos) {
-      if (string(line, panel_orientation.length()) == "horz flip") {
-        info->panel_orientation = DRMRotation::FLIP_H;
-      } else if (string(line, panel_orientation.length()) == "vert flip") {
-        info->panel_orientation = DRMRotation::FLIP_V;
-      } else if (string(line, panel_orientation.length()) == "horz & vert flip") {
-        info->panel_orientation = DRMRotation::ROT_180;
-      }
-    } else if (line.find(qsync_support) != string::npos) {
-      info->qsync_support = (string(line, qsync_support.length()) == "true");
-    } else if (line.find(wb_ubwc) != string::npos) {
-      info->is_wb_ubwc_supported = true;
-    } else if (line.find(dyn_bitclk_support) != string::npos) {
-      info->dyn_bitclk_support = (string(line, dyn_bitclk_support.length()) == "true");
-    }
+  if (ApplyCapabilities(blob->id, blob->data, blob->length, info)) {
+    DRM_LOGW("Connector %u capabilities partially parsed", drm_connector_->connector_id);
   }
 
   drmModeFreePropertyBlob(blob);
-  delete[] fmt_str;
 }
 
 void DRMConnector::ParseCapabilities(uint64_t blob_id, drm_panel_hdr_properties *hdr_info) {
@@ -577,73 +710,16 @@ void DRMConnector::ParseModeProperties(uint64_t blob_id, DRMConnectorInfo *info)
     return;
   }
 
-  if (!blob->data) {
+  if (!blob->data || !info->modes.size()) {
+    drmModeFreePropertyBlob(blob);
     return;
   }
 
-  if (!info->modes.size()) {
-    return;
-  }
-
-  char *fmt_str = new char[blob->length + 1];
-  memcpy (fmt_str, blob->data, blob->length);
-  fmt_str[blob->length] = '\0';
-  stringstream stream(fmt_str);
-  DRM_LOGI("stream str %s len %zu blob str %s len %d", stream.str().c_str(), stream.str().length(),
-           blob->data, blob->length);
-
-  string line = {};
-  const string mode_name = "mode_name=";
-  const string topology = "topology=";
-  const string pu_num_roi = "partial_update_num_roi=";
-  const string pu_xstart = "partial_update_xstart=";
-  const string pu_ystart = "partial_update_ystart=";
-  const string pu_walign = "partial_update_walign=";
-  const string pu_halign = "partial_update_halign=";
-  const string pu_wmin = "partial_update_wmin=";
-  const string pu_hmin = "partial_update_hmin=";
-  const string pu_roimerge = "partial_update_roimerge=";
-  const string bit_clk_rate = "bit_clk_rate=";
-  const string mdp_transfer_time_us = "mdp_transfer_time_us=";
-
-  DRMModeInfo *mode_item = &info->modes.at(0);
-  unsigned int index = 0;
-
-  while (std::getline(stream, line)) {
-    if (line.find(mode_name) != string::npos) {
-      string name(line, mode_name.length());
-      if (index >= info->modes.size()) {
-        break;
-      }
-      // Move to the next mode_item
-      mode_item = &info->modes.at(index++);
-    } else if (line.find(topology) != string::npos) {
-      mode_item->topology = GetTopologyEnum(string(line, topology.length()));;
-    } else if (line.find(pu_num_roi) != string::npos) {
-      mode_item->num_roi = std::stoi(string(line, pu_num_roi.length()));
-    } else if (line.find(pu_xstart) != string::npos) {
-      mode_item->xstart = std::stoi(string(line, pu_xstart.length()));
-    } else if (line.find(pu_ystart) != string::npos) {
-      mode_item->ystart = std::stoi(string(line, pu_ystart.length()));
-    } else if (line.find(pu_walign) != string::npos) {
-      mode_item->walign = std::stoi(string(line, pu_walign.length()));
-    } else if (line.find(pu_halign) != string::npos) {
-      mode_item->halign = std::stoi(string(line, pu_halign.length()));
-    } else if (line.find(pu_wmin) != string::npos) {
-      mode_item->wmin = std::stoi(string(line, pu_wmin.length()));
-    } else if (line.find(pu_hmin) != string::npos) {
-      mode_item->hmin = std::stoi(string(line, pu_hmin.length()));
-    } else if (line.find(pu_roimerge) != string::npos) {
-      mode_item->roi_merge = std::stoi(string(line, pu_roimerge.length()));
-    } else if (line.find(bit_clk_rate) != string::npos) {
-      mode_item->bit_clk_rate = std::stoi(string(line, bit_clk_rate.length()));
-    } else if (line.find(mdp_transfer_time_us) != string::npos) {
-      mode_item->transfer_time_us = std::stoi(string(line, mdp_transfer_time_us.length()));
-    }
+  if (ApplyModeProperties(blob->id, blob->data, blob->length, info)) {
+    DRM_LOGW("Connector %u mode properties partially parsed", drm_connector_->connector_id);
   }
 
   drmModeFreePropertyBlob(blob);
-  delete[] fmt_str;
 }
 
 void DRMConnector::ParseCapabilities(uint64_t blob_id, drm_msm_ext_hdr_properties *hdr_info) {
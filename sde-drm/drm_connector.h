@@ -33,6 +33,7 @@
 #include <drm_interface.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <memory>
@@ -61,6 +62,12 @@ class DRMConnector {
   int GetPossibleEncoders(std::set<uint32_t> *possible_encoders);
   void SetSkipConnectorReload(bool skip_reload) { skip_connector_reload_ = skip_reload; };
   void Dump();
+  // Apply the text of a capabilities or mode properties blob to info, return -EINVAL if parts
+  // were malformed. Mode properties are assigned to info->modes in order.
+  static int ApplyCapabilities(uint32_t blob_id, const void *data, uint32_t length,
+                               DRMConnectorInfo *info);
+  static int ApplyModeProperties(uint32_t blob_id, const void *data, uint32_t length,
+                                 DRMConnectorInfo *info);
 
  private:
   void ParseProperties();
@@ -102,6 +109,10 @@ class DRMConnectorManager {
   std::mutex lock_;
   // Map of connector id to DRMConnector *
   std::map<uint32_t, std::unique_ptr<DRMConnector>> connector_pool_{};
+  // Serializes Update() passes. Held while new connectors are parsed, but lock_ is not.
+  std::mutex update_lock_;
+  std::atomic<uint64_t> update_requests_{0};
+  uint64_t updates_done_ = 0;  // Last request covered by a completed pass
 };
 
 }  // namespace sde_drm
@@ -0,0 +1,213 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <drm_interface.h>
+#include <gtest/gtest.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "drm_connector.h"
+#include "fake_kms.h"
+
+namespace sde_drm {
+
+namespace {
+
+fake_kms::ConnectorConfig MstSink(uint32_t width, uint32_t height) {
+  fake_kms::ConnectorConfig config;
+  config.type = DRM_MODE_CONNECTOR_DisplayPort;
+  config.width = width;
+  config.height = height;
+  config.capabilities = "display type=secondary\n";
+  return config;
+}
+
+class DRMConnectorManagerTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    ASSERT_EQ(0, fake_kms::Configure(fake_kms::DefaultConfig()));
+    fd_ = drmOpen("msm_drm", nullptr);
+    ASSERT_GE(fd_, 0);
+
+    drmModeRes *resources = drmModeGetResources(fd_);
+    ASSERT_NE(nullptr, resources);
+    manager_.reset(new DRMConnectorManager(fd_));
+    manager_->Init(resources);
+    drmModeFreeResources(resources);
+    panel_id_ = List().at(0);
+  }
+
+  void TearDown() {
+    manager_.reset();
+    drmClose(fd_);
+  }
+
+  std::vector<uint32_t> List() {
+    std::vector<uint32_t> ids;
+    manager_->GetConnectorList(&ids);
+    return ids;
+  }
+
+  bool Listed(uint32_t id) {
+    std::vector<uint32_t> ids = List();
+    return std::find(ids.begin(), ids.end(), id) != ids.end();
+  }
+
+  int fd_ = -1;
+  uint32_t panel_id_ = 0;
+  std::unique_ptr<DRMConnectorManager> manager_;
+};
+
+}  // namespace
+
+TEST_F(DRMConnectorManagerTest, AttachesMstSinks) {
+  std::vector<uint32_t> sinks;
+  for (uint32_t i = 0; i < 3; i++) {
+    sinks.push_back(fake_kms::AttachConnector(MstSink(1920 + i * 640, 1080 + i * 360)));
+    ASSERT_NE(0u, sinks.back());
+  }
+  // Not seen until the hotplug is processed
+  EXPECT_EQ(1u, List().size());
+
+  manager_->Update();
+  EXPECT_EQ(4u, List().size());
+  for (uint32_t i = 0; i < sinks.size(); i++) {
+    DRMConnectorInfo info = {};
+    ASSERT_EQ(0, manager_->GetConnectorInfo(sinks[i], &info));
+    EXPECT_EQ(static_cast<uint32_t>(DRM_MODE_CONNECTOR_DisplayPort), info.type);
+    EXPECT_TRUE(info.is_connected);
+    ASSERT_EQ(1u, info.modes.size());
+    EXPECT_EQ(1920 + i * 640, info.modes[0].mode.hdisplay);
+    EXPECT_EQ(1080 + i * 360, info.modes[0].mode.vdisplay);
+  }
+
+  // The panel is left alone
+  DRMConnectorInfo info = {};
+  ASSERT_EQ(0, manager_->GetConnectorInfo(panel_id_, &info));
+  EXPECT_EQ(static_cast<uint32_t>(DRM_MODE_CONNECTOR_DSI), info.type);
+}
+
+TEST_F(DRMConnectorManagerTest, DetachesFreeSinksAndKeepsReservedOnes) {
+  uint32_t first = fake_kms::AttachConnector(MstSink(1920, 1080));
+  uint32_t second = fake_kms::AttachConnector(MstSink(3840, 2160));
+  manager_->Update();
+  ASSERT_TRUE(Listed(first));
+  ASSERT_TRUE(Listed(second));
+
+  DRMDisplayToken token = {};
+  ASSERT_EQ(0, manager_->Reserve(second, &token));
+  EXPECT_EQ(0, fake_kms::DetachConnector(first));
+  EXPECT_EQ(0, fake_kms::DetachConnector(second));
+  manager_->Update();
+  EXPECT_FALSE(Listed(first));
+  // In use, torn down once its display releases it
+  EXPECT_TRUE(Listed(second));
+  EXPECT_NE(0, manager_->GetConnectorInfo(first, nullptr));
+
+  manager_->Free(&token);
+  manager_->Update();
+  EXPECT_FALSE(Listed(second));
+  EXPECT_EQ(std::vector<uint32_t>{panel_id_}, List());
+}
+
+TEST_F(DRMConnectorManagerTest, ReattachedSinkGetsNewConnector) {
+  uint32_t sink = fake_kms::AttachConnector(MstSink(1920, 1080));
+  manager_->Update();
+  ASSERT_EQ(0, fake_kms::DetachConnector(sink));
+  EXPECT_EQ(-ENOENT, fake_kms::DetachConnector(sink));
+
+  uint32_t again = fake_kms::AttachConnector(MstSink(2560, 1440));
+  ASSERT_NE(sink, again);
+  manager_->Update();
+  EXPECT_FALSE(Listed(sink));
+  DRMConnectorInfo info = {};
+  ASSERT_EQ(0, manager_->GetConnectorInfo(again, &info));
+  EXPECT_EQ(2560u, info.modes.at(0).mode.hdisplay);
+}
+
+TEST_F(DRMConnectorManagerTest, UpdateWithoutChangesKeepsConnectors) {
+  uint32_t sink = fake_kms::AttachConnector(MstSink(1920, 1080));
+  manager_->Update();
+  std::vector<uint32_t> before = List();
+
+  fake_kms::Stats stats = {};
+  fake_kms::ResetStats();
+  manager_->Update();
+  fake_kms::GetStats(&stats);
+  EXPECT_EQ(before, List());
+  EXPECT_TRUE(Listed(sink));
+  // One drmModeGetResources() and no connector parsing
+  EXPECT_LE(stats.ioctls, 2u);
+}
+
+TEST_F(DRMConnectorManagerTest, HotplugStormWithConcurrentUpdates) {
+  // A dock attaching and detaching sinks while several threads handle the hotplug uevents and a
+  // display queries connector info.
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([this, &done] {
+      while (!done) {
+        manager_->Update();
+      }
+    });
+  }
+  threads.emplace_back([this, &done] {
+    while (!done) {
+      DRMConnectorInfo info = {};
+      EXPECT_EQ(0, manager_->GetConnectorInfo(panel_id_, &info));
+    }
+  });
+
+  std::vector<uint32_t> attached;
+  for (uint32_t round = 0; round < 50; round++) {
+    attached.push_back(fake_kms::AttachConnector(MstSink(1920, 1080)));
+    if (round % 3 == 2) {
+      ASSERT_EQ(0, fake_kms::DetachConnector(attached.front()));
+      attached.erase(attached.begin());
+    }
+  }
+  done = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // A pass requested after the last hotplug reflects it
+  manager_->Update();
+  std::vector<uint32_t> expected = attached;
+  expected.push_back(panel_id_);
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(expected, List());
+}
+
+}  // namespace sde_drm
@@ -33,6 +33,7 @@
 #include <drm/sde_drm.h>
 #include <drm_logger.h>
 #include <drm/drm_fourcc.h>
+#include <utils/hash.h>
 #include <string.h>
 
 #include <algorithm>
@@ -42,6 +43,7 @@
 #include <vector>
 #include <utility>
 
+#include "drm_blob_cache.h"
 #include "drm_utils.h"
 #include "drm_crtc.h"
 #include "drm_property.h"
@@ -132,6 +134,15 @@ void DRMCrtcManager::Init(drmModeRes *resource) {
   }
 }
 
+uint64_t DRMCrtcManager::GetCapsHash(uint64_t hash) {
+  for (auto &crtc : crtc_pool_) {
+    uint64_t caps_hash = crtc.second->GetCapsHash();
+    hash = sdm::HashBytes(&caps_hash, sizeof(caps_hash), hash);
+  }
+
+  return hash;
+}
+
 void DRMCrtcManager::DumpByID(uint32_t id) {
   crtc_pool_.at(id)->Dump();
 }
@@ -169,33 +180,27 @@ void DRMCrtcManager::SetScalerLUT(const DRMScalerLUTInfo &lut_info) {
     return;
   }
 
+  // Plane and CRTC scalers use the same LUT content and so share the blobs.
+  DRMBlobCache *blob_cache = DRMBlobCache::GetInstance(fd_);
   if (lut_info.dir_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.dir_lut),
-                              lut_info.dir_lut_size, &dir_lut_blob_id_);
+    blob_cache->Replace(reinterpret_cast<void *>(lut_info.dir_lut), lut_info.dir_lut_size,
+                        &dir_lut_blob_id_);
   }
   if (lut_info.cir_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.cir_lut),
-                              lut_info.cir_lut_size, &cir_lut_blob_id_);
+    blob_cache->Replace(reinterpret_cast<void *>(lut_info.cir_lut), lut_info.cir_lut_size,
+                        &cir_lut_blob_id_);
   }
   if (lut_info.sep_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.sep_lut),
-                              lut_info.sep_lut_size, &sep_lut_blob_id_);
+    blob_cache->Replace(reinterpret_cast<void *>(lut_info.sep_lut), lut_info.sep_lut_size,
+                        &sep_lut_blob_id_);
   }
 }
 
 void DRMCrtcManager::UnsetScalerLUT() {
-  if (dir_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, dir_lut_blob_id_);
-    dir_lut_blob_id_ = 0;
-  }
-  if (cir_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, cir_lut_blob_id_);
-    cir_lut_blob_id_ = 0;
-  }
-  if (sep_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, sep_lut_blob_id_);
-    sep_lut_blob_id_ = 0;
-  }
+  DRMBlobCache *blob_cache = DRMBlobCache::GetInstance(fd_);
+  blob_cache->Replace(nullptr, 0, &dir_lut_blob_id_);
+  blob_cache->Replace(nullptr, 0, &cir_lut_blob_id_);
+  blob_cache->Replace(nullptr, 0, &sep_lut_blob_id_);
 }
 
 int DRMCrtcManager::GetCrtcInfo(uint32_t crtc_id, DRMCrtcInfo *info) {
@@ -313,6 +318,161 @@ void DRMCrtc::ParseProperties() {
   drmModeFreeObjectProperties(props);
 }
 
+static DRMCapKey<DRMCrtcInfo> CompRatioKey(const string &key, bool real_time) {
+  return {key, [real_time](const string &value, DRMCapSetter<DRMCrtcInfo> *setter) {
+    // Space separated entries of format/vendor/modifier/ratio, e.g. NV12/5/1/1.25
+    vector<pair<pair<uint32_t, uint64_t>, float>> ratios;
+    vector<string> format_cr_list;
+    Tokenize(value, &format_cr_list, ' ');
+    for (auto &format_cr_str : format_cr_list) {
+      vector<string> format_cr;
+      Tokenize(format_cr_str, &format_cr, '/');
+      uint64_t vendor_code = 0;
+      uint64_t fmt_modifier = 0;
+      float comp_ratio = 0.0f;
+      if (format_cr.size() != 4 || format_cr.at(0).length() != 4 ||
+          !ParseCapValue(format_cr.at(1), &vendor_code) ||
+          !ParseCapValue(format_cr.at(2), &fmt_modifier) ||
+          !ParseCapValue(format_cr.at(3), &comp_ratio)) {
+        return false;
+      }
+
+      uint64_t modifier = 0;
+      if (vendor_code == DRM_FORMAT_MOD_VENDOR_QCOM) {
+        // Macro from drm_fourcc.h to form modifier
+        modifier = fourcc_mod_code(QCOM, fmt_modifier);
+      }
+
+      const string &format = format_cr.at(0);
+      ratios.push_back(std::make_pair(
+          std::make_pair(fourcc_code(format[0], format[1], format[2], format[3]), modifier),
+          comp_ratio));
+    }
+
+    *setter = [ratios, real_time](DRMCrtcInfo *info) {
+      CompRatioMap &comp_ratio_map = real_time ? info->comp_ratio_rt_map : info->comp_ratio_nrt_map;
+      comp_ratio_map.insert(ratios.begin(), ratios.end());
+    };
+    return true;
+  }};
+}
+
+static DRMCapParser<DRMCrtcInfo> &GetCapParser() {
+  static DRMCapParser<DRMCrtcInfo> parser({
+    CapField("max_blendstages", &DRMCrtcInfo::max_blend_stages),
+    {"qseed_type", [](const string &value, DRMCapSetter<DRMCrtcInfo> *setter) {
+      QSEEDVersion version = QSEEDVersion::V2;
+      if (value == "qseed2") {
+        version = QSEEDVersion::V2;
+      } else if (value == "qseed3") {
+        version = QSEEDVersion::V3;
+      } else if (value == "qseed3lite") {
+        version = QSEEDVersion::V3LITE;
+      } else {
+        return true;
+      }
+      *setter = [version](DRMCrtcInfo *info) { info->qseed_version = version; };
+      return true;
+    }},
+    CapField("has_src_split", &DRMCrtcInfo::has_src_split),
+    {"smart_dma_rev", [](const string &value, DRMCapSetter<DRMCrtcInfo> *setter) {
+      SmartDMARevision rev = SmartDMARevision::V1;
+      if (value == "smart_dma_v2p5") {
+        rev = SmartDMARevision::V2p5;
+      } else if (value == "smart_dma_v2") {
+        rev = SmartDMARevision::V2;
+      } else if (value == "smart_dma_v1") {
+        rev = SmartDMARevision::V1;
+      } else {
+        return true;
+      }
+      *setter = [rev](DRMCrtcInfo *info) { info->smart_dma_rev = rev; };
+      return true;
+    }},
+    CapField("core_ib_ff", &DRMCrtcInfo::ib_fudge_factor),
+    CapField("dest_scale_prefill_lines", &DRMCrtcInfo::dest_scale_prefill_lines),
+    CapField("undersized_prefill_lines", &DRMCrtcInfo::undersized_prefill_lines),
+    CapField("macrotile_prefill_lines", &DRMCrtcInfo::macrotile_prefill_lines),
+    CapField("yuv_nv12_prefill_lines", &DRMCrtcInfo::nv12_prefill_lines),
+    CapField("linear_prefill_lines", &DRMCrtcInfo::linear_prefill_lines),
+    CapField("downscaling_prefill_lines", &DRMCrtcInfo::downscale_prefill_lines),
+    CapField("xtra_prefill_lines", &DRMCrtcInfo::extra_prefill_lines),
+    CapField("amortizable_threshold", &DRMCrtcInfo::amortized_threshold),
+    CapField("max_bandwidth_low", &DRMCrtcInfo::max_bandwidth_low),
+    CapField("max_bandwidth_high", &DRMCrtcInfo::max_bandwidth_high),
+    CapField("max_mdp_clk", &DRMCrtcInfo::max_sde_clk),
+    CapField("core_clk_ff", &DRMCrtcInfo::clk_fudge_factor),
+    CompRatioKey("comp_ratio_rt", true),
+    CompRatioKey("comp_ratio_nrt", false),
+    CapField("hw_version", &DRMCrtcInfo::hw_version),
+    CapField("dim_layer_v1_max_layers", &DRMCrtcInfo::max_solidfill_stages),
+    CapField("dest_scaler_count", &DRMCrtcInfo::dest_scaler_count),
+    CapField("max_dest_scale_up", &DRMCrtcInfo::max_dest_scale_up),
+    CapField("max_dest_scaler_input_width", &DRMCrtcInfo::max_dest_scaler_input_width),
+    CapField("max_dest_scaler_output_width", &DRMCrtcInfo::max_dest_scaler_output_width),
+    CapField("has_hdr", &DRMCrtcInfo::has_hdr),
+    CapField("min_prefill_lines", &DRMCrtcInfo::min_prefill_lines),
+    CapField("sec_ui_blendstage", &DRMCrtcInfo::secure_disp_blend_stage),
+    CapField("num_mnoc_ports", &DRMCrtcInfo::num_mnocports),
+    CapField("axi_bus_width", &DRMCrtcInfo::mnoc_bus_width),
+    CapField("sspp_linewidth_usecases", &DRMCrtcInfo::line_width_constraints_count),
+    CapField("vig", &DRMCrtcInfo::vig_limit_index),
+    CapField("dma", &DRMCrtcInfo::dma_limit_index),
+    CapField("scale", &DRMCrtcInfo::scaling_limit_index),
+    CapField("inline_rot", &DRMCrtcInfo::rotation_limit_index),
+    // sspp_linewidth_values=<n> is followed by n limit_usecase/limit_value line pairs.
+    {"sspp_linewidth_values", [](const string &value, DRMCapSetter<DRMCrtcInfo> *setter) {
+      uint32_t count = 0;
+      if (!ParseCapValue(value, &count)) {
+        return false;
+      }
+      *setter = [](DRMCrtcInfo *info) { info->line_width_limits.clear(); };
+      return true;
+    }},
+    {"limit_usecase", [](const string &value, DRMCapSetter<DRMCrtcInfo> *setter) {
+      uint32_t constraint = 0;
+      if (!ParseCapValue(value, &constraint)) {
+        return false;
+      }
+      *setter = [constraint](DRMCrtcInfo *info) {
+        info->line_width_limits.push_back(std::make_pair(constraint, 0));
+      };
+      return true;
+    }},
+    {"limit_value", [](const string &value, DRMCapSetter<DRMCrtcInfo> *setter) {
+      uint32_t limit = 0;
+      if (!ParseCapValue(value, &limit)) {
+        return false;
+      }
+      *setter = [limit](DRMCrtcInfo *info) {
+        auto &limits = info->line_width_limits;
+        if (limits.empty() || limits.back().second) {
+          return;
+        }
+        // Use cases without a limit are not constraints.
+        if (limit) {
+          limits.back().second = limit;
+        } else {
+          limits.pop_back();
+        }
+      };
+      return true;
+    }},
+    CapField("has_uidle", &DRMCrtcInfo::has_micro_idle),
+    CapField("use_baselayer_for_stage", &DRMCrtcInfo::use_baselayer_for_stage),
+    {"UBWC version", [](const string &value, DRMCapSetter<DRMCrtcInfo> *setter) {
+      uint32_t version = 0;
+      if (!ParseCapValue(value, &version)) {
+        return false;
+      }
+      *setter = [version](DRMCrtcInfo *info) { info->ubwc_version = version >> 28; };
+      return true;
+    }},
+  });
+
+  return parser;
+}
+
 void DRMCrtc::ParseCapabilities(uint64_t blob_id) {
   drmModePropertyBlobRes *blob = drmModeGetPropertyBlob(fd_, blob_id);
   if (!blob) {
@@ -320,206 +480,22 @@ void DRMCrtc::ParseCapabilities(uint64_t blob_id) {
   }
 
   if (!blob->data) {
+    drmModeFreePropertyBlob(blob);
     return;
   }
 
-  char *fmt_str = new char[blob->length + 1];
-  memcpy (fmt_str, blob->data, blob->length);
-  fmt_str[blob->length] = '\0';
-  stringstream stream(fmt_str);
-  DRM_LOGI("stream str %s len %zu blob str %s len %d", stream.str().c_str(), stream.str().length(),
-           blob->data, blob->length);
-  string line = {};
-  string max_blendstages = "max_blendstages=";
-  string qseed_type = "qseed_type=";
-  string has_src_split = "has_src_split=";
-  string sdma_rev = "smart_dma_rev=";
-  string core_ib_ff = "core_ib_ff=";
-  string dest_scale_prefill_lines = "dest_scale_prefill_lines=";
-  string undersized_prefill_lines = "undersized_prefill_lines=";
-  string macrotile_prefill_lines = "macrotile_prefill_lines=";
-  string yuv_nv12_prefill_lines = "yuv_nv12_prefill_lines=";
-  string linear_prefill_lines = "linear_prefill_lines=";
-  string downscaling_prefill_lines = "downscaling_prefill_lines=";
-  string xtra_prefill_lines = "xtra_prefill_lines=";
-  string amortizable_threshold = "amortizable_threshold=";
-  string max_bandwidth_low = "max_bandwidth_low=";
-  string max_bandwidth_high = "max_bandwidth_high=";
-  string max_mdp_clk = "max_mdp_clk=";
-  string core_clk_ff = "core_clk_ff=";
-  string comp_ratio_rt = "comp_ratio_rt=";
-  string comp_ratio_nrt = "comp_ratio_nrt=";
-  string hw_version = "hw_version=";
-  string solidfill_stages = "dim_layer_v1_max_layers=";
-  string has_hdr = "has_hdr=";
-  string has_micro_idle = "has_uidle=";
-  string min_prefill_lines = "min_prefill_lines=";
-  string num_mnocports = "num_mnoc_ports=";
-  string mnoc_bus_width = "axi_bus_width=";
-
+  caps_hash_ = sdm::HashBytes(blob->data, blob->length);
   crtc_info_.max_solidfill_stages = 0;  // default _
-  string dest_scaler_count = "dest_scaler_count=";
-  string max_dest_scale_up = "max_dest_scale_up=";
-  string max_dest_scaler_input_width = "max_dest_scaler_input_width=";
-  string max_dest_scaler_output_width = "max_dest_scaler_output_width=";
-  string sec_ui_blendstage = "sec_ui_blendstage=";
-  string vig = "vig=";
-  string dma = "dma=";
-  string scaling = "scale=";
-  string rotation = "inline_rot=";
-  string linewidth_constraints = "sspp_linewidth_usecases=";
-  string linewidth_values = "sspp_linewidth_values=";
-  string limit_constraint = "limit_usecase=";
-  string limit_value = "limit_value=";
-  string use_baselayer_for_stage = "use_baselayer_for_stage=";
-  string ubwc_version = "UBWC version=";
-
-  while (std::getline(stream, line)) {
-    if (line.find(max_blendstages) != string::npos) {
-      crtc_info_.max_blend_stages = std::stoi(string(line, max_blendstages.length()));
-    } else if (line.find(qseed_type) != string::npos) {
-      if (string(line, qseed_type.length()) == "qseed2") {
-        crtc_info_.qseed_version = QSEEDVersion::V2;
-      } else if (string(line, qseed_type.length()) == "qseed3") {
-        crtc_info_.qseed_version = QSEEDVersion::V3;
-      } else if (string(line, qseed_type.length()) == "qseed3lite") {
-        crtc_info_.qseed_version = QSEEDVersion::V3LITE;
-      }
-    } else if (line.find(has_src_split) != string::npos) {
-      crtc_info_.has_src_split = std::stoi(string(line, has_src_split.length()));
-    } else if (line.find(sdma_rev) != string::npos) {
-      if (string(line, sdma_rev.length()) == "smart_dma_v2p5")
-        crtc_info_.smart_dma_rev = SmartDMARevision::V2p5;
-      else if (string(line, sdma_rev.length()) == "smart_dma_v2")
-        crtc_info_.smart_dma_rev = SmartDMARevision::V2;
-      else if (string(line, sdma_rev.length()) == "smart_dma_v1")
-        crtc_info_.smart_dma_rev = SmartDMARevision::V1;
-    } else if (line.find(core_ib_ff) != string::npos) {
-      crtc_info_.ib_fudge_factor = std::stof(string(line, core_ib_ff.length()));
-    } else if (line.find(dest_scale_prefill_lines) != string::npos) {
-      crtc_info_.dest_scale_prefill_lines =
-        std::stoi(string(line, dest_scale_prefill_lines.length()));
-    } else if (line.find(undersized_prefill_lines) != string::npos) {
-      crtc_info_.undersized_prefill_lines =
-        std::stoi(string(line, undersized_prefill_lines.length()));
-    } else if (line.find(macrotile_prefill_lines) != string::npos) {
-      crtc_info_.macrotile_prefill_lines =
-        std::stoi(string(line, macrotile_prefill_lines.length()));
-    } else if (line.find(yuv_nv12_prefill_lines) != string::npos) {
-      crtc_info_.nv12_prefill_lines = std::stoi(string(line, yuv_nv12_prefill_lines.length()));
-    } else if (line.find(linear_prefill_lines) != string::npos) {
-      crtc_info_.linear_prefill_lines = std::stoi(string(line, linear_prefill_lines.length()));
-    } else if (line.find(downscaling_prefill_lines) != string::npos) {
-      crtc_info_.downscale_prefill_lines =
-        std::stoi(string(line, downscaling_prefill_lines.length()));
-    } else if (line.find(xtra_prefill_lines) != string::npos) {
-      crtc_info_.extra_prefill_lines = std::stoi(string(line, xtra_prefill_lines.length()));
-    } else if (line.find(amortizable_threshold) != string::npos) {
-      crtc_info_.amortized_threshold = std::stoi(string(line, amortizable_threshold.length()));
-    } else if (line.find(max_bandwidth_low) != string::npos) {
-      crtc_info_.max_bandwidth_low = std::stoull(string(line, max_bandwidth_low.length()));
-    } else if (line.find(max_bandwidth_high) != string::npos) {
-      crtc_info_.max_bandwidth_high = std::stoull(string(line, max_bandwidth_high.length()));
-    } else if (line.find(max_mdp_clk) != string::npos) {
-      crtc_info_.max_sde_clk = std::stoi(string(line, max_mdp_clk.length()));
-    } else if (line.find(core_clk_ff) != string::npos) {
-      crtc_info_.clk_fudge_factor = std::stof(string(line, core_clk_ff.length()));
-    } else if (line.find(comp_ratio_rt) != string::npos) {
-      ParseCompRatio(line.substr(comp_ratio_rt.length()), true);
-    } else if (line.find(comp_ratio_nrt) != string::npos) {
-      ParseCompRatio(line.substr(comp_ratio_nrt.length()), false);
-    } else if (line.find(hw_version) != string::npos) {
-      crtc_info_.hw_version = std::stoi(string(line, hw_version.length()));
-    } else if (line.find(solidfill_stages) != string::npos) {
-      crtc_info_.max_solidfill_stages =  std::stoi(string(line, solidfill_stages.length()));
-    } else if (line.find(dest_scaler_count) != string::npos) {
-      crtc_info_.dest_scaler_count = std::stoi(string(line, dest_scaler_count.length()));
-    } else if (line.find(max_dest_scale_up) != string::npos) {
-      crtc_info_.max_dest_scale_up = std::stoi(string(line, max_dest_scale_up.length()));
-    } else if (line.find(max_dest_scaler_input_width) != string::npos) {
-      crtc_info_.max_dest_scaler_input_width =
-                          std::stoi(string(line, max_dest_scaler_input_width.length()));
-    } else if (line.find(max_dest_scaler_output_width) != string::npos) {
-      crtc_info_.max_dest_scaler_output_width =
-                         std::stoi(string(line, max_dest_scaler_output_width.length()));
-    } else if (line.find(has_hdr) != string::npos) {
-      crtc_info_.has_hdr = std::stoi(string(line, has_hdr.length()));
-    } else if (line.find(min_prefill_lines) != string::npos) {
-      crtc_info_.min_prefill_lines = std::stoi(string(line, min_prefill_lines.length()));
-    } else if (line.find(sec_ui_blendstage) != string::npos) {
-      crtc_info_.secure_disp_blend_stage = std::stoi(string(line, (sec_ui_blendstage).length()));
-    } else if (line.find(num_mnocports) != string::npos) {
-      crtc_info_.num_mnocports = std::stoi(string(line, num_mnocports.length()));
-    } else if (line.find(mnoc_bus_width) != string::npos) {
-      crtc_info_.mnoc_bus_width = std::stoi(string(line, mnoc_bus_width.length()));
-    } else if (line.find(linewidth_constraints) != string::npos) {
-      crtc_info_.line_width_constraints_count =
-                            std::stoi(string(line, (linewidth_constraints).length()));
-    } else if (line.find(vig) != string::npos) {
-      crtc_info_.vig_limit_index = std::stoi(string(line, (vig).length()));
-    } else if (line.find(dma) != string::npos) {
-      crtc_info_.dma_limit_index = std::stoi(string(line, (dma).length()));
-    } else if (line.find(scaling) != string::npos) {
-      crtc_info_.scaling_limit_index = std::stoi(string(line, (scaling).length()));
-    } else if (line.find(rotation) != string::npos) {
-      crtc_info_.rotation_limit_index = std::stoi(string(line, (rotation).length()));
-    } else if (line.find(linewidth_values) != string::npos) {
-      uint32_t num_linewidth_values = std::stoi(string(line, (linewidth_values).length()));
-      vector< pair <uint32_t,uint32_t> > constraint_vector;
-      for (uint32_t i = 0; i < num_linewidth_values; i++) {
-        uint32_t constraint = 0;
-        uint32_t value  = 0;
-        std::getline(stream, line);
-        if (line.find(limit_constraint) != string::npos) {
-          constraint = std::stoi(string(line, (limit_constraint).length()));
-        }
-        std::getline(stream, line);
-        if (line.find(limit_value) != string::npos) {
-          value = std::stoi(string(line, (limit_value).length()));
-        }
-        if (value) {
-          constraint_vector.push_back(std::make_pair(constraint,value));
-        }
-      }
-      crtc_info_.line_width_limits = std::move(constraint_vector);
-    } else if (line.find(has_micro_idle) != string::npos) {
-      crtc_info_.has_micro_idle = std::stoi(string(line, (has_micro_idle).length()));
-    } else if (line.find(use_baselayer_for_stage) != string::npos) {
-      crtc_info_.use_baselayer_for_stage =
-                         std::stoi(string(line, use_baselayer_for_stage.length()));
-    } else if (line.find(ubwc_version) != string::npos) {
-      crtc_info_.ubwc_version = (std::stoi(string(line, ubwc_version.length()))) >> 28;
-    }
+  if (ApplyCapabilities(blob->id, blob->data, blob->length, &crtc_info_)) {
+    DRM_LOGW("CRTC %u capabilities partially parsed", drm_crtc_->crtc_id);
   }
+
   drmModeFreePropertyBlob(blob);
-  delete[] fmt_str;
 }
 
-void DRMCrtc::ParseCompRatio(string line, bool real_time) {
-  CompRatioMap &comp_ratio_map =
-    real_time ? crtc_info_.comp_ratio_rt_map : crtc_info_.comp_ratio_nrt_map;
-  std::vector<string> format_cr_list;
-
-  Tokenize(line, &format_cr_list, ' ');
-
-  for (uint32_t i = 0; i < format_cr_list.size(); i++) {
-    std::vector<string> format_cr;
-    Tokenize(format_cr_list.at(i), &format_cr, '/');
-    std::string format = format_cr.at(0);
-    uint64_t vendor_code = stoi(format_cr.at(1));
-    uint64_t fmt_modifier = stoi(format_cr.at(2));
-    float comp_ratio = std::stof(format_cr.at(3));
-    uint64_t modifier = 0;
-
-    if (vendor_code == DRM_FORMAT_MOD_VENDOR_QCOM) {
-      // Macro from drm_fourcc.h to form modifier
-      modifier = fourcc_mod_code(QCOM, fmt_modifier);
-    }
-
-    std::pair<uint32_t, uint64_t> drm_format =
-      std::make_pair(fourcc_code(format[0], format[1], format[2], format[3]), modifier);
-    comp_ratio_map.insert(std::make_pair(drm_format, comp_ratio));
-  }
+int DRMCrtc::ApplyCapabilities(uint32_t blob_id, const void *data, uint32_t length,
+                               DRMCrtcInfo *info) {
+  return GetCapParser().Parse(blob_id, data, length, info);
 }
 
 void DRMCrtc::GetInfo(DRMCrtcInfo *info) {
@@ -532,7 +508,7 @@ void DRMCrtc::Lock() {
 
 void DRMCrtc::Unlock() {
   if (mode_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, mode_blob_id_);
+    DRMBlobCache::GetInstance(fd_)->Release(mode_blob_id_);
     mode_blob_id_ = 0;
   }
 
@@ -543,7 +519,7 @@ void DRMCrtc::Unlock() {
 
 void DRMCrtc::SetModeBlobID(uint64_t blob_id) {
   if (mode_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, mode_blob_id_);
+    DRMBlobCache::GetInstance(fd_)->Release(mode_blob_id_);
   }
 
   mode_blob_id_ = blob_id;
@@ -566,8 +542,9 @@ void DRMCrtc::Perform(DRMOps code, drmModeAtomicReq *req, va_list args) {
       uint32_t blob_id = 0;
 
       if (mode) {
-        if (drmModeCreatePropertyBlob(fd_, (const void *)mode, sizeof(drmModeModeInfo), &blob_id)) {
-          DRM_LOGE("drmModeCreatePropertyBlob failed for CRTC_SET_MODE, crtc %d", obj_id);
+        // The same mode is set every frame, so this is normally a cache hit.
+        if (DRMBlobCache::GetInstance(fd_)->Acquire(mode, sizeof(drmModeModeInfo), &blob_id)) {
+          DRM_LOGE("Failed to get mode blob for CRTC_SET_MODE, crtc %d", obj_id);
           return;
         }
       }
@@ -59,6 +59,7 @@ class DRMCrtc {
   void PostCommit(bool success);
   void Perform(DRMOps code, drmModeAtomicReq *req, va_list args);
   int GetIndex() { return crtc_index_; }
+  uint64_t GetCapsHash() { return caps_hash_; }
   void Dump();
   void Lock();
   void Unlock();
@@ -67,11 +68,13 @@ class DRMCrtc {
       pp_mgr_->GetPPInfo(info);
   }
   ~DRMCrtc();
+  // Applies the text of a capabilities blob to info, returns -EINVAL if parts were malformed.
+  static int ApplyCapabilities(uint32_t blob_id, const void *data, uint32_t length,
+                               DRMCrtcInfo *info);
 
  private:
   void ParseProperties();
   void ParseCapabilities(uint64_t blob_id);
-  void ParseCompRatio(std::string line, bool real_time);
   void SetROI(drmModeAtomicReq *req, uint32_t obj_id, uint32_t num_roi,
               DRMRect *crtc_rois);
   void SetSolidfillStages(drmModeAtomicReq *req, uint32_t obj_id,
@@ -87,6 +90,7 @@ class DRMCrtc {
   drmModeCrtc *drm_crtc_ = {};
   DRMStatus status_ = DRMStatus::FREE;
   DRMCrtcInfo crtc_info_ = {};
+  uint64_t caps_hash_ = 0;  // Hash of the capabilities blob
   DRMPropertyManager prop_mgr_ {};
   bool is_lut_configured_ = false;
   bool is_lut_validated_ = false;
@@ -112,6 +116,8 @@ class DRMCrtcManager {
   void GetPPInfo(uint32_t crtc_id, DRMPPFeatureInfo *info);
   void PostValidate(uint32_t crtc_id, bool success);
   void PostCommit(uint32_t crtc_id, bool success);
+  // Combines the capabilities blob hashes of all CRTCs in id order into hash.
+  uint64_t GetCapsHash(uint64_t hash);
 
  private:
   int fd_ = -1;
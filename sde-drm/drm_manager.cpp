@@ -28,9 +28,15 @@
 */
 
 #include <drm_logger.h>
+#include <utils/hash.h>
 
+#include <inttypes.h>
 #include <string.h>
+#include <chrono>
+#include <functional>
+#include <thread>
 #include "drm_atomic_req.h"
+#include "drm_blob_cache.h"
 #include "drm_connector.h"
 #include "drm_crtc.h"
 #include "drm_encoder.h"
@@ -39,6 +45,10 @@
 
 using std::lock_guard;
 using std::mutex;
+using std::thread;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
 
 extern "C" {
 
@@ -89,12 +99,26 @@ void DRMManager::Destroy() {
   }
 }
 
+static uint64_t ElapsedUs(const steady_clock::time_point &start) {
+  return static_cast<uint64_t>(duration_cast<microseconds>(steady_clock::now() - start).count());
+}
+
+// Runs init on its own thread and records how long it took.
+static thread TimedInit(std::function<void()> init, uint64_t *elapsed_us) {
+  return thread([init, elapsed_us] {
+    steady_clock::time_point start = steady_clock::now();
+    init();
+    *elapsed_us = ElapsedUs(start);
+  });
+}
+
 int DRMManager::Init(int drm_fd) {
   fd_ = drm_fd;
 
   drmSetClientCap(fd_, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
   drmSetClientCap(fd_, DRM_CLIENT_CAP_ATOMIC, 1);
 
+  steady_clock::time_point start = steady_clock::now();
   drmModeRes *resource = drmModeGetResources(fd_);
   if (resource == NULL) {
     DRM_LOGE("drmModeGetResources failed");
@@ -106,34 +130,51 @@ int DRMManager::Init(int drm_fd) {
     DRM_LOGE("Failed to get Connector Mgr");
     return DRM_ERR_INVALID;
   }
-  conn_mgr_->Init(resource);
 
   encoder_mgr_ = new DRMEncoderManager(fd_);
   if (!encoder_mgr_) {
     DRM_LOGE("Failed to get Encoder Mgr");
     return DRM_ERR_INVALID;
   }
-  encoder_mgr_->Init(resource);
 
   crtc_mgr_ = new DRMCrtcManager(fd_);
   if (!crtc_mgr_) {
     DRM_LOGE("Failed to get Crtc Mgr");
     return DRM_ERR_INVALID;
   }
-  crtc_mgr_->Init(resource);
 
   plane_mgr_ = new DRMPlaneManager(fd_);
   if (!plane_mgr_) {
     DRM_LOGE("Failed to get Plane Mgr");
     return DRM_ERR_INVALID;
   }
+
+  // Object types do not depend on each other, so they are enumerated and parsed concurrently.
+  thread conn_thread = TimedInit([this, resource] { conn_mgr_->Init(resource); },
+                                 &init_stats_.connectors_us);
+  thread encoder_thread = TimedInit([this, resource] { encoder_mgr_->Init(resource); },
+                                    &init_stats_.encoders_us);
+  thread crtc_thread = TimedInit([this, resource] { crtc_mgr_->Init(resource); },
+                                 &init_stats_.crtcs_us);
+  steady_clock::time_point planes_start = steady_clock::now();
   plane_mgr_->Init();
+  init_stats_.planes_us = ElapsedUs(planes_start);
+  conn_thread.join();
+  encoder_thread.join();
+  crtc_thread.join();
+
+  caps_hash_ = plane_mgr_->GetCapsHash(crtc_mgr_->GetCapsHash(sdm::kHashSeed));
 
   dpps_mgr_intf_ = GetDppsManagerIntf();
   if (dpps_mgr_intf_)
     dpps_mgr_intf_->Init(fd_, resource);
   drmModeFreeResources(resource);
 
+  init_stats_.total_us = ElapsedUs(start);
+  DRM_LOGI("Init took %" PRIu64 " us: connectors %" PRIu64 " encoders %" PRIu64 " crtcs %" PRIu64
+           " planes %" PRIu64, init_stats_.total_us, init_stats_.connectors_us,
+           init_stats_.encoders_us, init_stats_.crtcs_us, init_stats_.planes_us);
+
   return 0;
 }
 
@@ -336,6 +377,7 @@ DRMManager::~DRMManager() {
     delete plane_mgr_;
     plane_mgr_ = NULL;
   }
+  DRMBlobCache::Destroy(fd_);
 }
 
 int DRMManager::CreateAtomicReq(const DRMDisplayToken &token, DRMAtomicReqInterface **intf) {
@@ -375,4 +417,12 @@ void DRMManager::GetDppsFeatureInfo(DRMDppsFeatureInfo *info) {
     dpps_mgr_intf_->GetDppsFeatureInfo(info);
 }
 
+void DRMManager::GetInitStats(DRMInitStats *stats) {
+  *stats = init_stats_;
+}
+
+void DRMManager::GetCapabilitiesHash(uint64_t *hash) {
+  *hash = caps_hash_;
+}
+
 }  // namespace sde_drm
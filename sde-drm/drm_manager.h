@@ -63,6 +63,8 @@ class DRMManager : public DRMManagerInterface {
   virtual int SetScalerLUT(const DRMScalerLUTInfo &lut_info);
   virtual int UnsetScalerLUT();
   virtual void GetDppsFeatureInfo(DRMDppsFeatureInfo *info);
+  virtual void GetInitStats(DRMInitStats *stats);
+  virtual void GetCapabilitiesHash(uint64_t *hash);
 
   DRMPlaneManager *GetPlaneMgr();
   DRMConnectorManager *GetConnectorMgr();
@@ -82,6 +84,8 @@ class DRMManager : public DRMManagerInterface {
   DRMEncoderManager *encoder_mgr_ = {};
   DRMCrtcManager *crtc_mgr_ = {};
   DRMDppsManagerIntf *dpps_mgr_intf_ = {};
+  DRMInitStats init_stats_ = {};
+  uint64_t caps_hash_ = 0;
 
   static DRMManager *s_drm_instance;
   static std::mutex s_lock;
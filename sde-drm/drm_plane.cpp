@@ -35,6 +35,7 @@
 // version drm/drm.h
 #include <drm_logger.h>
 #include <drm/drm_fourcc.h>
+#include <utils/hash.h>
 #include <drm/sde_drm.h>
 
 #include <cstring>
@@ -46,6 +47,7 @@
 #include <vector>
 #include <algorithm>
 
+#include "drm_blob_cache.h"
 #include "drm_utils.h"
 #include "drm_plane.h"
 #include "drm_property.h"
@@ -328,6 +330,15 @@ void DRMPlaneManager::GetPlanesInfo(DRMPlanesInfo *info) {
   }
 }
 
+uint64_t DRMPlaneManager::GetCapsHash(uint64_t hash) {
+  for (auto &plane : plane_pool_) {
+    uint64_t caps_hash = plane.second->GetCapsHash();
+    hash = sdm::HashBytes(&caps_hash, sizeof(caps_hash), hash);
+  }
+
+  return hash;
+}
+
 void DRMPlaneManager::UnsetUnusedResources(uint32_t crtc_id, bool is_commit, drmModeAtomicReq *req) {
   // Unset planes that were assigned to the crtc referred to by crtc_id but are not requested
   // in this round
@@ -375,33 +386,27 @@ void DRMPlaneManager::PostCommit(uint32_t crtc_id, bool success) {
 }
 
 void DRMPlaneManager::SetScalerLUT(const DRMScalerLUTInfo &lut_info) {
+  // Plane and CRTC scalers use the same LUT content and so share the blobs.
+  DRMBlobCache *blob_cache = DRMBlobCache::GetInstance(fd_);
   if (lut_info.dir_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.dir_lut),
-                              lut_info.dir_lut_size, &dir_lut_blob_id_);
+    blob_cache->Replace(reinterpret_cast<void *>(lut_info.dir_lut), lut_info.dir_lut_size,
+                        &dir_lut_blob_id_);
   }
   if (lut_info.cir_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.cir_lut),
-                              lut_info.cir_lut_size, &cir_lut_blob_id_);
+    blob_cache->Replace(reinterpret_cast<void *>(lut_info.cir_lut), lut_info.cir_lut_size,
+                        &cir_lut_blob_id_);
   }
   if (lut_info.sep_lut_size) {
-    drmModeCreatePropertyBlob(fd_, reinterpret_cast<void *>(lut_info.sep_lut),
-                              lut_info.sep_lut_size, &sep_lut_blob_id_);
+    blob_cache->Replace(reinterpret_cast<void *>(lut_info.sep_lut), lut_info.sep_lut_size,
+                        &sep_lut_blob_id_);
   }
 }
 
 void DRMPlaneManager::UnsetScalerLUT() {
-  if (dir_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, dir_lut_blob_id_);
-    dir_lut_blob_id_ = 0;
-  }
-  if (cir_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, cir_lut_blob_id_);
-    cir_lut_blob_id_ = 0;
-  }
-  if (sep_lut_blob_id_) {
-    drmModeDestroyPropertyBlob(fd_, sep_lut_blob_id_);
-    sep_lut_blob_id_ = 0;
-  }
+  DRMBlobCache *blob_cache = DRMBlobCache::GetInstance(fd_);
+  blob_cache->Replace(nullptr, 0, &dir_lut_blob_id_);
+  blob_cache->Replace(nullptr, 0, &cir_lut_blob_id_);
+  blob_cache->Replace(nullptr, 0, &sep_lut_blob_id_);
 }
 
 // ==============================================================================================//
@@ -430,6 +435,7 @@ void DRMPlane::GetTypeInfo(const PropertyMap &prop_map) {
     return;
   }
 
+  caps_hash_ = sdm::HashBytes(blob->data, blob->length);
   char *fmt_str = new char[blob->length + 1];
   memcpy (fmt_str, blob->data, blob->length);
   fmt_str[blob->length] = '\0';
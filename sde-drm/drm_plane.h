@@ -71,6 +71,7 @@ class DRMPlane {
   bool ConfigureScalerLUT(drmModeAtomicReq *req, uint32_t dir_lut_blob_id,
                           uint32_t cir_lut_blob_id, uint32_t sep_lut_blob_id);
   const DRMPlaneTypeInfo& GetPlaneTypeInfo() { return plane_type_info_; }
+  uint64_t GetCapsHash() { return caps_hash_; }
   void SetDecimation(drmModeAtomicReq *req, uint32_t prop_id, uint32_t prop_value);
   void SetExclRect(drmModeAtomicReq *req, DRMRect rect);
   void Perform(DRMOps code, drmModeAtomicReq *req, va_list args);
@@ -95,6 +96,7 @@ class DRMPlane {
   uint32_t priority_ = 0;
   drmModePlane *drm_plane_ = {};
   DRMPlaneTypeInfo plane_type_info_{};
+  uint64_t caps_hash_ = 0;  // Hash of the capabilities blob
   uint32_t assigned_crtc_id_ = 0;
   uint32_t requested_crtc_id_ = 0;
   DRMPropertyManager prop_mgr_ {};
@@ -133,6 +135,8 @@ class DRMPlaneManager {
   void UnsetScalerLUT();
   void PostValidate(uint32_t crtc_id, bool success);
   void PostCommit(uint32_t crtc_id, bool success);
+  // Combines the capabilities blob hashes of all planes in id order into hash.
+  uint64_t GetCapsHash(uint64_t hash);
 
  private:
   void Perform(DRMOps code, drmModeAtomicReq *req, uint32_t obj_id, ...);
@@ -39,6 +39,7 @@
 #include <map>
 #include <string>
 
+#include "drm_blob_cache.h"
 #include "drm_pp_manager.h"
 #include "drm_property.h"
 
@@ -52,11 +53,11 @@ DRMPPManager::~DRMPPManager() {
 #ifdef PP_DRM_ENABLE
   DRMPPPropInfo prop_info = {};
 
-  /* free previously created blob to avoid memory leak */
+  /* release previously acquired blob to avoid memory leak */
   for (int i = 0; i < kPPFeaturesMax; i++) {
     prop_info = pp_prop_map_[i];
     if (prop_info.blob_id > 0) {
-      drmModeDestroyPropertyBlob(fd_, prop_info.blob_id);
+      DRMBlobCache::GetInstance(fd_)->Release(prop_info.blob_id);
       prop_info.blob_id = 0;
     }
   }
@@ -232,33 +233,16 @@ int DRMPPManager::SetPPBlobProperty(drmModeAtomicReq *req, uint32_t obj_id,
                                     DRMPPFeatureInfo &feature) {
   int ret = DRM_ERR_INVALID;
 #ifdef PP_DRM_ENABLE
-  uint32_t blob_id = 0;
-
-  /* free previously created blob for this feature if exist */
-  if (prop_info->blob_id > 0) {
-    ret = drmModeDestroyPropertyBlob(fd_, prop_info->blob_id);
-    if (ret) {
-      DRM_LOGE("failed to destroy property blob for feature %d, ret = %d", feature.id, ret);
-      return ret;
-    } else {
-      prop_info->blob_id = 0;
-    }
-  }
-
-  if (!feature.payload) {
-    // feature disable case
-    drmModeAtomicAddProperty(req, obj_id, prop_info->prop_id, 0);
-    return 0;
-  }
-
-  ret = drmModeCreatePropertyBlob(fd_, feature.payload, feature.payload_size, &blob_id);
-  if (ret || blob_id == 0) {
-    DRM_LOGE("failed to create property blob ret %d, blob_id = %d", ret, blob_id);
+  /* An unchanged payload keeps its blob id, so the driver sees no property change. A disable
+   * request releases the blob of this feature. */
+  uint32_t size = feature.payload ? feature.payload_size : 0;
+  ret = DRMBlobCache::GetInstance(fd_)->Replace(feature.payload, size, &prop_info->blob_id);
+  if (ret) {
+    DRM_LOGE("failed to get property blob for feature %d, ret %d", feature.id, ret);
     return DRM_ERR_INVALID;
   }
 
-  prop_info->blob_id = blob_id;
-  drmModeAtomicAddProperty(req, obj_id, prop_info->prop_id, blob_id);
+  drmModeAtomicAddProperty(req, obj_id, prop_info->prop_id, prop_info->blob_id);
 
 #endif
   return ret;
@@ -27,144 +27,158 @@
 * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <utils/hash.h>
+
 #include "drm_property.h"
 
 namespace sde_drm {
 
+// Property names are dispatched on their hash, evaluated at compile time for the case labels.
+// Duplicate case labels fail to build, so the hash stays perfect over the known names; the string
+// compare only rejects unknown names that happen to collide.
+#define PROPERTY_NAME(str, prop) \
+  case sdm::HashString(str): return (name == str) ? DRMProperty::prop : DRMProperty::INVALID;
+
 DRMProperty DRMPropertyManager::GetPropertyEnum(const std::string &name) const {
-  if (name == "type") { return DRMProperty::TYPE; }
-  if (name == "FB_ID") { return DRMProperty::FB_ID; }
-  if (name == "rot_fb_id") { return DRMProperty::ROT_FB_ID; }
-  if (name == "CRTC_ID") { return DRMProperty::CRTC_ID; }
-  if (name == "CRTC_X") { return DRMProperty::CRTC_X; }
-  if (name == "CRTC_Y") { return DRMProperty::CRTC_Y; }
-  if (name == "CRTC_W") { return DRMProperty::CRTC_W; }
-  if (name == "CRTC_H") { return DRMProperty::CRTC_H; }
-  if (name == "SRC_X") { return DRMProperty::SRC_X; }
-  if (name == "SRC_Y") { return DRMProperty::SRC_Y; }
-  if (name == "SRC_W") { return DRMProperty::SRC_W; }
-  if (name == "SRC_H") { return DRMProperty::SRC_H; }
-  if (name == "zpos") { return DRMProperty::ZPOS; }
-  if (name == "alpha") { return DRMProperty::ALPHA; }
-  if (name == "excl_rect_v1") { return DRMProperty::EXCL_RECT; }
-  if (name == "h_decimate") { return DRMProperty::H_DECIMATE; }
-  if (name == "v_decimate") { return DRMProperty::V_DECIMATE; }
-  if (name == "input_fence") { return DRMProperty::INPUT_FENCE; }
-  if (name == "rotation") { return DRMProperty::ROTATION; }
-  if (name == "blend_op") { return DRMProperty::BLEND_OP; }
-  if (name == "src_config") { return DRMProperty::SRC_CONFIG; }
-  if (name == "scaler_v1") { return DRMProperty::SCALER_V1; }
-  if (name == "scaler_v2") { return DRMProperty::SCALER_V2; }
-  if (name == "csc_v1") { return DRMProperty::CSC_V1; }
-  if (name == "capabilities") { return DRMProperty::CAPABILITIES; }
-  if (name == "mode_properties") { return DRMProperty::MODE_PROPERTIES; }
-  if (name == "lut_ed") { return DRMProperty::LUT_ED; }
-  if (name == "lut_cir") { return DRMProperty::LUT_CIR; }
-  if (name == "lut_sep") { return DRMProperty::LUT_SEP; }
-  if (name == "rot_caps_v1") { return DRMProperty::ROTATOR_CAPS_V1; }
-  if (name == "true_inline_rot_rev") { return DRMProperty::TRUE_INLINE_ROT_REV; }
-  if (name == "fb_translation_mode") { return DRMProperty::FB_TRANSLATION_MODE; }
-  if (name == "ACTIVE") { return DRMProperty::ACTIVE; }
-  if (name == "MODE_ID") { return DRMProperty::MODE_ID; }
-  if (name == "output_fence_offset") { return DRMProperty::OUTPUT_FENCE_OFFSET; }
-  if (name == "output_fence") { return DRMProperty::OUTPUT_FENCE; }
-  if (name == "sde_drm_roi_v1") { return DRMProperty::ROI_V1; }
-  if (name == "core_clk") { return DRMProperty::CORE_CLK; }
-  if (name == "core_ab") { return DRMProperty::CORE_AB; }
-  if (name == "core_ib") { return DRMProperty::CORE_IB; }
-  if (name == "llcc_ab") { return DRMProperty::LLCC_AB; }
-  if (name == "llcc_ib") { return DRMProperty::LLCC_IB; }
-  if (name == "dram_ab") { return DRMProperty::DRAM_AB; }
-  if (name == "dram_ib") { return DRMProperty::DRAM_IB; }
-  if (name == "rot_prefill_bw") { return DRMProperty::ROT_PREFILL_BW; }
-  if (name == "rot_clk") { return DRMProperty::ROT_CLK; }
-  if (name == "security_level") { return DRMProperty::SECURITY_LEVEL; }
-  if (name == "dim_layer_v1") { return DRMProperty::DIM_STAGES_V1; }
-  if (name == "idle_time") { return DRMProperty::IDLE_TIME; }
-  if (name == "RETIRE_FENCE") { return DRMProperty::RETIRE_FENCE; }
-  if (name == "DST_X") { return DRMProperty::DST_X; }
-  if (name == "DST_Y") { return DRMProperty::DST_Y; }
-  if (name == "DST_W") { return DRMProperty::DST_W; }
-  if (name == "DST_H") { return DRMProperty::DST_H; }
-  if (name == "LP") { return DRMProperty::LP; }
-  if (name == "dest_scaler") { return DRMProperty::DEST_SCALER; }
-  if (name == "ds_lut_ed") { return DRMProperty::DS_LUT_ED; }
-  if (name == "ds_lut_cir") { return DRMProperty::DS_LUT_CIR; }
-  if (name == "ds_lut_sep") { return DRMProperty::DS_LUT_SEP; }
-  if (name == "hdr_properties") { return DRMProperty::HDR_PROPERTIES; }
-  if (name == "SDE_DSPP_GAMUT_V3") { return DRMProperty::SDE_DSPP_GAMUT_V3; }
-  if (name == "SDE_DSPP_GAMUT_V4") { return DRMProperty::SDE_DSPP_GAMUT_V4; }
-  if (name == "SDE_DSPP_GAMUT_V5") { return DRMProperty::SDE_DSPP_GAMUT_V5; }
-  if (name == "SDE_DSPP_GC_V1") { return DRMProperty::SDE_DSPP_GC_V1; }
-  if (name == "SDE_DSPP_GC_V2") { return DRMProperty::SDE_DSPP_GC_V2; }
-  if (name == "SDE_DSPP_IGC_V2") { return DRMProperty::SDE_DSPP_IGC_V2; }
-  if (name == "SDE_DSPP_IGC_V3") { return DRMProperty::SDE_DSPP_IGC_V3; }
-  if (name == "SDE_DSPP_IGC_V4") { return DRMProperty::SDE_DSPP_IGC_V4; }
-  if (name == "SDE_DSPP_PCC_V3") { return DRMProperty::SDE_DSPP_PCC_V3; }
-  if (name == "SDE_DSPP_PCC_V4") { return DRMProperty::SDE_DSPP_PCC_V4; }
-  if (name == "SDE_DSPP_PCC_V5") { return DRMProperty::SDE_DSPP_PCC_V5; }
-  if (name == "SDE_DSPP_PA_HSIC_V1") { return DRMProperty::SDE_DSPP_PA_HSIC_V1; }
-  if (name == "SDE_DSPP_PA_HSIC_V2") { return DRMProperty::SDE_DSPP_PA_HSIC_V2; }
-  if (name == "SDE_DSPP_PA_SIXZONE_V1") { return DRMProperty::SDE_DSPP_PA_SIXZONE_V1; }
-  if (name == "SDE_DSPP_PA_SIXZONE_V2") { return DRMProperty::SDE_DSPP_PA_SIXZONE_V2; }
-  if (name == "SDE_DSPP_PA_MEMCOL_SKIN_V1") { return DRMProperty::SDE_DSPP_PA_MEMCOL_SKIN_V1; }
-  if (name == "SDE_DSPP_PA_MEMCOL_SKIN_V2") { return DRMProperty::SDE_DSPP_PA_MEMCOL_SKIN_V2; }
-  if (name == "SDE_DSPP_PA_MEMCOL_SKY_V1") { return DRMProperty::SDE_DSPP_PA_MEMCOL_SKY_V1; }
-  if (name == "SDE_DSPP_PA_MEMCOL_SKY_V2") { return DRMProperty::SDE_DSPP_PA_MEMCOL_SKY_V2; }
-  if (name == "SDE_DSPP_PA_MEMCOL_FOLIAGE_V1") { return DRMProperty::SDE_DSPP_PA_MEMCOL_FOLIAGE_V1; }
-  if (name == "SDE_DSPP_PA_MEMCOL_FOLIAGE_V2") { return DRMProperty::SDE_DSPP_PA_MEMCOL_FOLIAGE_V2; }
-  if (name == "SDE_DSPP_PA_MEMCOL_PROT_V1") { return DRMProperty::SDE_DSPP_PA_MEMCOL_PROT_V1; }
-  if (name == "SDE_DSPP_PA_MEMCOL_PROT_V2") { return DRMProperty::SDE_DSPP_PA_MEMCOL_PROT_V2; }
-  if (name == "autorefresh") { return DRMProperty::AUTOREFRESH; }
-  if (name == "ext_hdr_properties") { return DRMProperty::EXT_HDR_PROPERTIES; }
-  if (name == "hdr_metadata") { return DRMProperty::HDR_METADATA; }
-  if (name == "multirect_mode") { return DRMProperty::MULTIRECT_MODE; }
-  if (name == "SDE_DSPP_PA_DITHER_V1") { return DRMProperty::SDE_DSPP_PA_DITHER_V1; }
-  if (name == "SDE_DSPP_PA_DITHER_V2") { return DRMProperty::SDE_DSPP_PA_DITHER_V2; }
-  if (name == "SDE_PP_DITHER_V1") { return DRMProperty::SDE_PP_DITHER_V1; }
-  if (name == "SDE_PP_DITHER_V2") { return DRMProperty::SDE_PP_DITHER_V2; }
-  if (name == "inverse_pma") { return DRMProperty::INVERSE_PMA; }
-  if (name == "csc_dma_v1") { return DRMProperty::CSC_DMA_V1; }
-  if (name == "SDE_DGM_1D_LUT_IGC_V5") { return DRMProperty::SDE_DGM_1D_LUT_IGC_V5; }
-  if (name == "SDE_DGM_1D_LUT_GC_V5") { return DRMProperty::SDE_DGM_1D_LUT_GC_V5; }
-  if (name == "SDE_VIG_1D_LUT_IGC_V5") { return DRMProperty::SDE_VIG_1D_LUT_IGC_V5; }
-  if (name == "SDE_VIG_3D_LUT_GAMUT_V5") { return DRMProperty::SDE_VIG_3D_LUT_GAMUT_V5; }
-  if (name == "SDE_DSPP_AD_V4_MODE") { return DRMProperty::SDE_DSPP_AD4_MODE; }
-  if (name == "SDE_DSPP_AD_V4_INIT") { return DRMProperty::SDE_DSPP_AD4_INIT; }
-  if (name == "SDE_DSPP_AD_V4_CFG") { return DRMProperty::SDE_DSPP_AD4_CFG; }
-  if (name == "SDE_DSPP_AD_V4_ASSERTIVENESS") { return DRMProperty::SDE_DSPP_AD4_ASSERTIVENESS; }
-  if (name == "SDE_DSPP_AD_V4_STRENGTH") { return DRMProperty::SDE_DSPP_AD4_STRENGTH; }
-  if (name == "SDE_DSPP_AD_V4_INPUT") { return DRMProperty::SDE_DSPP_AD4_INPUT; }
-  if (name == "SDE_DSPP_AD_V4_BACKLIGHT") { return DRMProperty::SDE_DSPP_AD4_BACKLIGHT; }
-  if (name == "SDE_DSPP_AD_V4_ROI") { return DRMProperty::SDE_DSPP_AD4_ROI; }
-  if (name == "SDE_DSPP_HIST_CTRL_V1") { return DRMProperty::SDE_DSPP_ABA_HIST_CTRL; }
-  if (name == "SDE_DSPP_HIST_IRQ_V1") { return DRMProperty::SDE_DSPP_ABA_HIST_IRQ; }
-  if (name == "SDE_DSPP_VLUT_V1") { return DRMProperty::SDE_DSPP_ABA_LUT; }
-  if (name == "bl_scale") { return DRMProperty::SDE_DSPP_BL_SCALE; }
-  if (name == "sv_bl_scale") { return DRMProperty::SDE_DSPP_SV_BL_SCALE; }
-  if (name == "capture_mode") { return DRMProperty::CAPTURE_MODE; }
-  if (name == "qsync_mode") { return DRMProperty::QSYNC_MODE; }
-  if (name == "idle_pc_state") { return DRMProperty::IDLE_PC_STATE; }
-  if (name == "topology_control") { return DRMProperty::TOPOLOGY_CONTROL; }
-  if (name == "EDID") { return DRMProperty::EDID; }
-  if (name == "SDE_DSPP_LTM_V1") { return DRMProperty::SDE_LTM_VERSION; }
-  if (name == "SDE_DSPP_LTM_INIT_V1") { return DRMProperty::SDE_LTM_INIT; }
-  if (name == "SDE_DSPP_LTM_ROI_V1") { return DRMProperty::SDE_LTM_CFG; }
-  if (name == "SDE_DSPP_LTM_HIST_THRESH_V1") { return DRMProperty::SDE_LTM_NOISE_THRESH; }
-  if (name == "SDE_DSPP_LTM_HIST_CTRL_V1") { return DRMProperty::SDE_LTM_HIST_CTRL; }
-  if (name == "SDE_DSPP_LTM_SET_BUF_V1") { return DRMProperty::SDE_LTM_BUFFER_CTRL; }
-  if (name == "SDE_DSPP_LTM_QUEUE_BUF_V1") { return DRMProperty::SDE_LTM_QUEUE_BUFFER; }
-  if (name == "SDE_DSPP_LTM_QUEUE_BUF2_V1") { return DRMProperty::SDE_LTM_QUEUE_BUFFER2; }
-  if (name == "SDE_DSPP_LTM_QUEUE_BUF3_V1") { return DRMProperty::SDE_LTM_QUEUE_BUFFER3; }
-  if (name == "SDE_DSPP_LTM_VLUT_V1") { return DRMProperty::SDE_LTM_VLUT; }
-  if (name == "SDE_VIG_1D_LUT_IGC_V6") { return DRMProperty::SDE_VIG_1D_LUT_IGC_V6; }
-  if (name == "SDE_VIG_3D_LUT_GAMUT_V6") { return DRMProperty::SDE_VIG_3D_LUT_GAMUT_V6; }
-  if (name == "frame_trigger_mode") { return DRMProperty::FRAME_TRIGGER; }
-  if (name == "Colorspace") { return DRMProperty::COLORSPACE; }
-  if (name == "supported_colorspaces") { return DRMProperty::SUPPORTED_COLORSPACES; }
-  if (name == "sspp_layout") { return DRMProperty::SDE_SSPP_LAYOUT; }
+  switch (sdm::HashBytes(name.data(), name.size())) {
+    PROPERTY_NAME("type", TYPE)
+    PROPERTY_NAME("FB_ID", FB_ID)
+    PROPERTY_NAME("rot_fb_id", ROT_FB_ID)
+    PROPERTY_NAME("CRTC_ID", CRTC_ID)
+    PROPERTY_NAME("CRTC_X", CRTC_X)
+    PROPERTY_NAME("CRTC_Y", CRTC_Y)
+    PROPERTY_NAME("CRTC_W", CRTC_W)
+    PROPERTY_NAME("CRTC_H", CRTC_H)
+    PROPERTY_NAME("SRC_X", SRC_X)
+    PROPERTY_NAME("SRC_Y", SRC_Y)
+    PROPERTY_NAME("SRC_W", SRC_W)
+    PROPERTY_NAME("SRC_H", SRC_H)
+    PROPERTY_NAME("zpos", ZPOS)
+    PROPERTY_NAME("alpha", ALPHA)
+    PROPERTY_NAME("excl_rect_v1", EXCL_RECT)
+    PROPERTY_NAME("h_decimate", H_DECIMATE)
+    PROPERTY_NAME("v_decimate", V_DECIMATE)
+    PROPERTY_NAME("input_fence", INPUT_FENCE)
+    PROPERTY_NAME("rotation", ROTATION)
+    PROPERTY_NAME("blend_op", BLEND_OP)
+    PROPERTY_NAME("src_config", SRC_CONFIG)
+    PROPERTY_NAME("scaler_v1", SCALER_V1)
+    PROPERTY_NAME("scaler_v2", SCALER_V2)
+    PROPERTY_NAME("csc_v1", CSC_V1)
+    PROPERTY_NAME("capabilities", CAPABILITIES)
+    PROPERTY_NAME("mode_properties", MODE_PROPERTIES)
+    PROPERTY_NAME("lut_ed", LUT_ED)
+    PROPERTY_NAME("lut_cir", LUT_CIR)
+    PROPERTY_NAME("lut_sep", LUT_SEP)
+    PROPERTY_NAME("rot_caps_v1", ROTATOR_CAPS_V1)
+    PROPERTY_NAME("true_inline_rot_rev", TRUE_INLINE_ROT_REV)
+    PROPERTY_NAME("fb_translation_mode", FB_TRANSLATION_MODE)
+    PROPERTY_NAME("ACTIVE", ACTIVE)
+    PROPERTY_NAME("MODE_ID", MODE_ID)
+    PROPERTY_NAME("output_fence_offset", OUTPUT_FENCE_OFFSET)
+    PROPERTY_NAME("output_fence", OUTPUT_FENCE)
+    PROPERTY_NAME("sde_drm_roi_v1", ROI_V1)
+    PROPERTY_NAME("core_clk", CORE_CLK)
+    PROPERTY_NAME("core_ab", CORE_AB)
+    PROPERTY_NAME("core_ib", CORE_IB)
+    PROPERTY_NAME("llcc_ab", LLCC_AB)
+    PROPERTY_NAME("llcc_ib", LLCC_IB)
+    PROPERTY_NAME("dram_ab", DRAM_AB)
+    PROPERTY_NAME("dram_ib", DRAM_IB)
+    PROPERTY_NAME("rot_prefill_bw", ROT_PREFILL_BW)
+    PROPERTY_NAME("rot_clk", ROT_CLK)
+    PROPERTY_NAME("security_level", SECURITY_LEVEL)
+    PROPERTY_NAME("dim_layer_v1", DIM_STAGES_V1)
+    PROPERTY_NAME("idle_time", IDLE_TIME)
+    PROPERTY_NAME("RETIRE_FENCE", RETIRE_FENCE)
+    PROPERTY_NAME("DST_X", DST_X)
+    PROPERTY_NAME("DST_Y", DST_Y)
+    PROPERTY_NAME("DST_W", DST_W)
+    PROPERTY_NAME("DST_H", DST_H)
+    PROPERTY_NAME("LP", LP)
+    PROPERTY_NAME("dest_scaler", DEST_SCALER)
+    PROPERTY_NAME("ds_lut_ed", DS_LUT_ED)
+    PROPERTY_NAME("ds_lut_cir", DS_LUT_CIR)
+    PROPERTY_NAME("ds_lut_sep", DS_LUT_SEP)
+    PROPERTY_NAME("hdr_properties", HDR_PROPERTIES)
+    PROPERTY_NAME("SDE_DSPP_GAMUT_V3", SDE_DSPP_GAMUT_V3)
+    PROPERTY_NAME("SDE_DSPP_GAMUT_V4", SDE_DSPP_GAMUT_V4)
+    PROPERTY_NAME("SDE_DSPP_GAMUT_V5", SDE_DSPP_GAMUT_V5)
+    PROPERTY_NAME("SDE_DSPP_GC_V1", SDE_DSPP_GC_V1)
+    PROPERTY_NAME("SDE_DSPP_GC_V2", SDE_DSPP_GC_V2)
+    PROPERTY_NAME("SDE_DSPP_IGC_V2", SDE_DSPP_IGC_V2)
+    PROPERTY_NAME("SDE_DSPP_IGC_V3", SDE_DSPP_IGC_V3)
+    PROPERTY_NAME("SDE_DSPP_IGC_V4", SDE_DSPP_IGC_V4)
+    PROPERTY_NAME("SDE_DSPP_PCC_V3", SDE_DSPP_PCC_V3)
+    PROPERTY_NAME("SDE_DSPP_PCC_V4", SDE_DSPP_PCC_V4)
+    PROPERTY_NAME("SDE_DSPP_PCC_V5", SDE_DSPP_PCC_V5)
+    PROPERTY_NAME("SDE_DSPP_PA_HSIC_V1", SDE_DSPP_PA_HSIC_V1)
+    PROPERTY_NAME("SDE_DSPP_PA_HSIC_V2", SDE_DSPP_PA_HSIC_V2)
+    PROPERTY_NAME("SDE_DSPP_PA_SIXZONE_V1", SDE_DSPP_PA_SIXZONE_V1)
+    PROPERTY_NAME("SDE_DSPP_PA_SIXZONE_V2", SDE_DSPP_PA_SIXZONE_V2)
+    PROPERTY_NAME("SDE_DSPP_PA_MEMCOL_SKIN_V1", SDE_DSPP_PA_MEMCOL_SKIN_V1)
+    PROPERTY_NAME("SDE_DSPP_PA_MEMCOL_SKIN_V2", SDE_DSPP_PA_MEMCOL_SKIN_V2)
+    PROPERTY_NAME("SDE_DSPP_PA_MEMCOL_SKY_V1", SDE_DSPP_PA_MEMCOL_SKY_V1)
+    PROPERTY_NAME("SDE_DSPP_PA_MEMCOL_SKY_V2", SDE_DSPP_PA_MEMCOL_SKY_V2)
+    PROPERTY_NAME("SDE_DSPP_PA_MEMCOL_FOLIAGE_V1", SDE_DSPP_PA_MEMCOL_FOLIAGE_V1)
+    PROPERTY_NAME("SDE_DSPP_PA_MEMCOL_FOLIAGE_V2", SDE_DSPP_PA_MEMCOL_FOLIAGE_V2)
+    PROPERTY_NAME("SDE_DSPP_PA_MEMCOL_PROT_V1", SDE_DSPP_PA_MEMCOL_PROT_V1)
+    PROPERTY_NAME("SDE_DSPP_PA_MEMCOL_PROT_V2", SDE_DSPP_PA_MEMCOL_PROT_V2)
+    PROPERTY_NAME("autorefresh", AUTOREFRESH)
+    PROPERTY_NAME("ext_hdr_properties", EXT_HDR_PROPERTIES)
+    PROPERTY_NAME("hdr_metadata", HDR_METADATA)
+    PROPERTY_NAME("multirect_mode", MULTIRECT_MODE)
+    PROPERTY_NAME("SDE_DSPP_PA_DITHER_V1", SDE_DSPP_PA_DITHER_V1)
+    PROPERTY_NAME("SDE_DSPP_PA_DITHER_V2", SDE_DSPP_PA_DITHER_V2)
+    PROPERTY_NAME("SDE_PP_DITHER_V1", SDE_PP_DITHER_V1)
+    PROPERTY_NAME("SDE_PP_DITHER_V2", SDE_PP_DITHER_V2)
+    PROPERTY_NAME("inverse_pma", INVERSE_PMA)
+    PROPERTY_NAME("csc_dma_v1", CSC_DMA_V1)
+    PROPERTY_NAME("SDE_DGM_1D_LUT_IGC_V5", SDE_DGM_1D_LUT_IGC_V5)
+    PROPERTY_NAME("SDE_DGM_1D_LUT_GC_V5", SDE_DGM_1D_LUT_GC_V5)
+    PROPERTY_NAME("SDE_VIG_1D_LUT_IGC_V5", SDE_VIG_1D_LUT_IGC_V5)
+    PROPERTY_NAME("SDE_VIG_3D_LUT_GAMUT_V5", SDE_VIG_3D_LUT_GAMUT_V5)
+    PROPERTY_NAME("SDE_DSPP_AD_V4_MODE", SDE_DSPP_AD4_MODE)
+    PROPERTY_NAME("SDE_DSPP_AD_V4_INIT", SDE_DSPP_AD4_INIT)
+    PROPERTY_NAME("SDE_DSPP_AD_V4_CFG", SDE_DSPP_AD4_CFG)
+    PROPERTY_NAME("SDE_DSPP_AD_V4_ASSERTIVENESS", SDE_DSPP_AD4_ASSERTIVENESS)
+    PROPERTY_NAME("SDE_DSPP_AD_V4_STRENGTH", SDE_DSPP_AD4_STRENGTH)
+    PROPERTY_NAME("SDE_DSPP_AD_V4_INPUT", SDE_DSPP_AD4_INPUT)
+    PROPERTY_NAME("SDE_DSPP_AD_V4_BACKLIGHT", SDE_DSPP_AD4_BACKLIGHT)
+    PROPERTY_NAME("SDE_DSPP_AD_V4_ROI", SDE_DSPP_AD4_ROI)
+    PROPERTY_NAME("SDE_DSPP_HIST_CTRL_V1", SDE_DSPP_ABA_HIST_CTRL)
+    PROPERTY_NAME("SDE_DSPP_HIST_IRQ_V1", SDE_DSPP_ABA_HIST_IRQ)
+    PROPERTY_NAME("SDE_DSPP_VLUT_V1", SDE_DSPP_ABA_LUT)
+    PROPERTY_NAME("bl_scale", SDE_DSPP_BL_SCALE)
+    PROPERTY_NAME("sv_bl_scale", SDE_DSPP_SV_BL_SCALE)
+    PROPERTY_NAME("capture_mode", CAPTURE_MODE)
+    PROPERTY_NAME("qsync_mode", QSYNC_MODE)
+    PROPERTY_NAME("idle_pc_state", IDLE_PC_STATE)
+    PROPERTY_NAME("topology_control", TOPOLOGY_CONTROL)
+    PROPERTY_NAME("EDID", EDID)
+    PROPERTY_NAME("SDE_DSPP_LTM_V1", SDE_LTM_VERSION)
+    PROPERTY_NAME("SDE_DSPP_LTM_INIT_V1", SDE_LTM_INIT)
+    PROPERTY_NAME("SDE_DSPP_LTM_ROI_V1", SDE_LTM_CFG)
+    PROPERTY_NAME("SDE_DSPP_LTM_HIST_THRESH_V1", SDE_LTM_NOISE_THRESH)
+    PROPERTY_NAME("SDE_DSPP_LTM_HIST_CTRL_V1", SDE_LTM_HIST_CTRL)
+    PROPERTY_NAME("SDE_DSPP_LTM_SET_BUF_V1", SDE_LTM_BUFFER_CTRL)
+    PROPERTY_NAME("SDE_DSPP_LTM_QUEUE_BUF_V1", SDE_LTM_QUEUE_BUFFER)
+    PROPERTY_NAME("SDE_DSPP_LTM_QUEUE_BUF2_V1", SDE_LTM_QUEUE_BUFFER2)
+    PROPERTY_NAME("SDE_DSPP_LTM_QUEUE_BUF3_V1", SDE_LTM_QUEUE_BUFFER3)
+    PROPERTY_NAME("SDE_DSPP_LTM_VLUT_V1", SDE_LTM_VLUT)
+    PROPERTY_NAME("SDE_VIG_1D_LUT_IGC_V6", SDE_VIG_1D_LUT_IGC_V6)
+    PROPERTY_NAME("SDE_VIG_3D_LUT_GAMUT_V6", SDE_VIG_3D_LUT_GAMUT_V6)
+    PROPERTY_NAME("frame_trigger_mode", FRAME_TRIGGER)
+    PROPERTY_NAME("Colorspace", COLORSPACE)
+    PROPERTY_NAME("supported_colorspaces", SUPPORTED_COLORSPACES)
+    PROPERTY_NAME("sspp_layout", SDE_SSPP_LAYOUT)
+    default:
+      break;
+  }
 
   return DRMProperty::INVALID;
 }
 
+#undef PROPERTY_NAME
+
 }  // namespace sde_drm
@@ -0,0 +1,292 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <ctype.h>
+#include <drm_interface.h>
+#include <gtest/gtest.h>
+#include <xf86drm.h>
+#include <string>
+#include <vector>
+
+#include "drm_property.h"
+#include "fake_kms.h"
+
+extern "C" int GetDRMManager(int fd, sde_drm::DRMManagerInterface **intf);
+extern "C" int DestroyDRMManager();
+
+namespace sde_drm {
+
+namespace {
+
+enum ObjectType {
+  kCrtc,
+  kPlane,
+  kConnector,
+};
+
+struct RecordedProperty {
+  ObjectType object;
+  const char *name;
+  DRMProperty property;
+};
+
+// Property names an SDE driver exposes per object type, with the enum each resolves to. The last
+// entries are core DRM properties that libsdedrm does not use.
+const RecordedProperty kRecordedProperties[] = {
+  {kPlane, "type", DRMProperty::TYPE},
+  {kPlane, "FB_ID", DRMProperty::FB_ID},
+  {kPlane, "rot_fb_id", DRMProperty::ROT_FB_ID},
+  {kConnector, "CRTC_ID", DRMProperty::CRTC_ID},
+  {kPlane, "CRTC_X", DRMProperty::CRTC_X},
+  {kPlane, "CRTC_Y", DRMProperty::CRTC_Y},
+  {kPlane, "CRTC_W", DRMProperty::CRTC_W},
+  {kPlane, "CRTC_H", DRMProperty::CRTC_H},
+  {kPlane, "SRC_X", DRMProperty::SRC_X},
+  {kPlane, "SRC_Y", DRMProperty::SRC_Y},
+  {kPlane, "SRC_W", DRMProperty::SRC_W},
+  {kPlane, "SRC_H", DRMProperty::SRC_H},
+  {kPlane, "zpos", DRMProperty::ZPOS},
+  {kPlane, "alpha", DRMProperty::ALPHA},
+  {kPlane, "excl_rect_v1", DRMProperty::EXCL_RECT},
+  {kPlane, "h_decimate", DRMProperty::H_DECIMATE},
+  {kPlane, "v_decimate", DRMProperty::V_DECIMATE},
+  {kPlane, "input_fence", DRMProperty::INPUT_FENCE},
+  {kPlane, "rotation", DRMProperty::ROTATION},
+  {kPlane, "blend_op", DRMProperty::BLEND_OP},
+  {kPlane, "src_config", DRMProperty::SRC_CONFIG},
+  {kPlane, "scaler_v1", DRMProperty::SCALER_V1},
+  {kPlane, "scaler_v2", DRMProperty::SCALER_V2},
+  {kPlane, "csc_v1", DRMProperty::CSC_V1},
+  {kCrtc, "capabilities", DRMProperty::CAPABILITIES},
+  {kConnector, "mode_properties", DRMProperty::MODE_PROPERTIES},
+  {kPlane, "lut_ed", DRMProperty::LUT_ED},
+  {kPlane, "lut_cir", DRMProperty::LUT_CIR},
+  {kPlane, "lut_sep", DRMProperty::LUT_SEP},
+  {kPlane, "rot_caps_v1", DRMProperty::ROTATOR_CAPS_V1},
+  {kPlane, "true_inline_rot_rev", DRMProperty::TRUE_INLINE_ROT_REV},
+  {kConnector, "fb_translation_mode", DRMProperty::FB_TRANSLATION_MODE},
+  {kCrtc, "ACTIVE", DRMProperty::ACTIVE},
+  {kCrtc, "MODE_ID", DRMProperty::MODE_ID},
+  {kCrtc, "output_fence_offset", DRMProperty::OUTPUT_FENCE_OFFSET},
+  {kCrtc, "output_fence", DRMProperty::OUTPUT_FENCE},
+  {kCrtc, "sde_drm_roi_v1", DRMProperty::ROI_V1},
+  {kCrtc, "core_clk", DRMProperty::CORE_CLK},
+  {kCrtc, "core_ab", DRMProperty::CORE_AB},
+  {kCrtc, "core_ib", DRMProperty::CORE_IB},
+  {kCrtc, "llcc_ab", DRMProperty::LLCC_AB},
+  {kCrtc, "llcc_ib", DRMProperty::LLCC_IB},
+  {kCrtc, "dram_ab", DRMProperty::DRAM_AB},
+  {kCrtc, "dram_ib", DRMProperty::DRAM_IB},
+  {kCrtc, "rot_prefill_bw", DRMProperty::ROT_PREFILL_BW},
+  {kCrtc, "rot_clk", DRMProperty::ROT_CLK},
+  {kCrtc, "security_level", DRMProperty::SECURITY_LEVEL},
+  {kCrtc, "dim_layer_v1", DRMProperty::DIM_STAGES_V1},
+  {kCrtc, "idle_time", DRMProperty::IDLE_TIME},
+  {kConnector, "RETIRE_FENCE", DRMProperty::RETIRE_FENCE},
+  {kConnector, "DST_X", DRMProperty::DST_X},
+  {kConnector, "DST_Y", DRMProperty::DST_Y},
+  {kConnector, "DST_W", DRMProperty::DST_W},
+  {kConnector, "DST_H", DRMProperty::DST_H},
+  {kConnector, "LP", DRMProperty::LP},
+  {kCrtc, "dest_scaler", DRMProperty::DEST_SCALER},
+  {kCrtc, "ds_lut_ed", DRMProperty::DS_LUT_ED},
+  {kCrtc, "ds_lut_cir", DRMProperty::DS_LUT_CIR},
+  {kCrtc, "ds_lut_sep", DRMProperty::DS_LUT_SEP},
+  {kConnector, "hdr_properties", DRMProperty::HDR_PROPERTIES},
+  {kCrtc, "SDE_DSPP_GAMUT_V3", DRMProperty::SDE_DSPP_GAMUT_V3},
+  {kCrtc, "SDE_DSPP_GAMUT_V4", DRMProperty::SDE_DSPP_GAMUT_V4},
+  {kCrtc, "SDE_DSPP_GAMUT_V5", DRMProperty::SDE_DSPP_GAMUT_V5},
+  {kCrtc, "SDE_DSPP_GC_V1", DRMProperty::SDE_DSPP_GC_V1},
+  {kCrtc, "SDE_DSPP_GC_V2", DRMProperty::SDE_DSPP_GC_V2},
+  {kCrtc, "SDE_DSPP_IGC_V2", DRMProperty::SDE_DSPP_IGC_V2},
+  {kCrtc, "SDE_DSPP_IGC_V3", DRMProperty::SDE_DSPP_IGC_V3},
+  {kCrtc, "SDE_DSPP_IGC_V4", DRMProperty::SDE_DSPP_IGC_V4},
+  {kCrtc, "SDE_DSPP_PCC_V3", DRMProperty::SDE_DSPP_PCC_V3},
+  {kCrtc, "SDE_DSPP_PCC_V4", DRMProperty::SDE_DSPP_PCC_V4},
+  {kCrtc, "SDE_DSPP_PCC_V5", DRMProperty::SDE_DSPP_PCC_V5},
+  {kCrtc, "SDE_DSPP_PA_HSIC_V1", DRMProperty::SDE_DSPP_PA_HSIC_V1},
+  {kCrtc, "SDE_DSPP_PA_HSIC_V2", DRMProperty::SDE_DSPP_PA_HSIC_V2},
+  {kCrtc, "SDE_DSPP_PA_SIXZONE_V1", DRMProperty::SDE_DSPP_PA_SIXZONE_V1},
+  {kCrtc, "SDE_DSPP_PA_SIXZONE_V2", DRMProperty::SDE_DSPP_PA_SIXZONE_V2},
+  {kCrtc, "SDE_DSPP_PA_MEMCOL_SKIN_V1", DRMProperty::SDE_DSPP_PA_MEMCOL_SKIN_V1},
+  {kCrtc, "SDE_DSPP_PA_MEMCOL_SKIN_V2", DRMProperty::SDE_DSPP_PA_MEMCOL_SKIN_V2},
+  {kCrtc, "SDE_DSPP_PA_MEMCOL_SKY_V1", DRMProperty::SDE_DSPP_PA_MEMCOL_SKY_V1},
+  {kCrtc, "SDE_DSPP_PA_MEMCOL_SKY_V2", DRMProperty::SDE_DSPP_PA_MEMCOL_SKY_V2},
+  {kCrtc, "SDE_DSPP_PA_MEMCOL_FOLIAGE_V1", DRMProperty::SDE_DSPP_PA_MEMCOL_FOLIAGE_V1},
+  {kCrtc, "SDE_DSPP_PA_MEMCOL_FOLIAGE_V2", DRMProperty::SDE_DSPP_PA_MEMCOL_FOLIAGE_V2},
+  {kCrtc, "SDE_DSPP_PA_MEMCOL_PROT_V1", DRMProperty::SDE_DSPP_PA_MEMCOL_PROT_V1},
+  {kCrtc, "SDE_DSPP_PA_MEMCOL_PROT_V2", DRMProperty::SDE_DSPP_PA_MEMCOL_PROT_V2},
+  {kConnector, "autorefresh", DRMProperty::AUTOREFRESH},
+  {kConnector, "ext_hdr_properties", DRMProperty::EXT_HDR_PROPERTIES},
+  {kConnector, "hdr_metadata", DRMProperty::HDR_METADATA},
+  {kPlane, "multirect_mode", DRMProperty::MULTIRECT_MODE},
+  {kCrtc, "SDE_DSPP_PA_DITHER_V1", DRMProperty::SDE_DSPP_PA_DITHER_V1},
+  {kCrtc, "SDE_DSPP_PA_DITHER_V2", DRMProperty::SDE_DSPP_PA_DITHER_V2},
+  {kCrtc, "SDE_PP_DITHER_V1", DRMProperty::SDE_PP_DITHER_V1},
+  {kCrtc, "SDE_PP_DITHER_V2", DRMProperty::SDE_PP_DITHER_V2},
+  {kPlane, "inverse_pma", DRMProperty::INVERSE_PMA},
+  {kPlane, "csc_dma_v1", DRMProperty::CSC_DMA_V1},
+  {kPlane, "SDE_DGM_1D_LUT_IGC_V5", DRMProperty::SDE_DGM_1D_LUT_IGC_V5},
+  {kCrtc, "SDE_DGM_1D_LUT_GC_V5", DRMProperty::SDE_DGM_1D_LUT_GC_V5},
+  {kPlane, "SDE_VIG_1D_LUT_IGC_V5", DRMProperty::SDE_VIG_1D_LUT_IGC_V5},
+  {kPlane, "SDE_VIG_3D_LUT_GAMUT_V5", DRMProperty::SDE_VIG_3D_LUT_GAMUT_V5},
+  {kCrtc, "SDE_DSPP_AD_V4_MODE", DRMProperty::SDE_DSPP_AD4_MODE},
+  {kCrtc, "SDE_DSPP_AD_V4_INIT", DRMProperty::SDE_DSPP_AD4_INIT},
+  {kCrtc, "SDE_DSPP_AD_V4_CFG", DRMProperty::SDE_DSPP_AD4_CFG},
+  {kCrtc, "SDE_DSPP_AD_V4_ASSERTIVENESS", DRMProperty::SDE_DSPP_AD4_ASSERTIVENESS},
+  {kCrtc, "SDE_DSPP_AD_V4_STRENGTH", DRMProperty::SDE_DSPP_AD4_STRENGTH},
+  {kCrtc, "SDE_DSPP_AD_V4_INPUT", DRMProperty::SDE_DSPP_AD4_INPUT},
+  {kCrtc, "SDE_DSPP_AD_V4_BACKLIGHT", DRMProperty::SDE_DSPP_AD4_BACKLIGHT},
+  {kCrtc, "SDE_DSPP_AD_V4_ROI", DRMProperty::SDE_DSPP_AD4_ROI},
+  {kCrtc, "SDE_DSPP_HIST_CTRL_V1", DRMProperty::SDE_DSPP_ABA_HIST_CTRL},
+  {kCrtc, "SDE_DSPP_HIST_IRQ_V1", DRMProperty::SDE_DSPP_ABA_HIST_IRQ},
+  {kCrtc, "SDE_DSPP_VLUT_V1", DRMProperty::SDE_DSPP_ABA_LUT},
+  {kConnector, "bl_scale", DRMProperty::SDE_DSPP_BL_SCALE},
+  {kConnector, "sv_bl_scale", DRMProperty::SDE_DSPP_SV_BL_SCALE},
+  {kCrtc, "capture_mode", DRMProperty::CAPTURE_MODE},
+  {kConnector, "qsync_mode", DRMProperty::QSYNC_MODE},
+  {kCrtc, "idle_pc_state", DRMProperty::IDLE_PC_STATE},
+  {kConnector, "topology_control", DRMProperty::TOPOLOGY_CONTROL},
+  {kConnector, "EDID", DRMProperty::EDID},
+  {kCrtc, "SDE_DSPP_LTM_V1", DRMProperty::SDE_LTM_VERSION},
+  {kCrtc, "SDE_DSPP_LTM_INIT_V1", DRMProperty::SDE_LTM_INIT},
+  {kCrtc, "SDE_DSPP_LTM_ROI_V1", DRMProperty::SDE_LTM_CFG},
+  {kCrtc, "SDE_DSPP_LTM_HIST_THRESH_V1", DRMProperty::SDE_LTM_NOISE_THRESH},
+  {kCrtc, "SDE_DSPP_LTM_HIST_CTRL_V1", DRMProperty::SDE_LTM_HIST_CTRL},
+  {kCrtc, "SDE_DSPP_LTM_SET_BUF_V1", DRMProperty::SDE_LTM_BUFFER_CTRL},
+  {kCrtc, "SDE_DSPP_LTM_QUEUE_BUF_V1", DRMProperty::SDE_LTM_QUEUE_BUFFER},
+  {kCrtc, "SDE_DSPP_LTM_QUEUE_BUF2_V1", DRMProperty::SDE_LTM_QUEUE_BUFFER2},
+  {kCrtc, "SDE_DSPP_LTM_QUEUE_BUF3_V1", DRMProperty::SDE_LTM_QUEUE_BUFFER3},
+  {kCrtc, "SDE_DSPP_LTM_VLUT_V1", DRMProperty::SDE_LTM_VLUT},
+  {kPlane, "SDE_VIG_1D_LUT_IGC_V6", DRMProperty::SDE_VIG_1D_LUT_IGC_V6},
+  {kPlane, "SDE_VIG_3D_LUT_GAMUT_V6", DRMProperty::SDE_VIG_3D_LUT_GAMUT_V6},
+  {kConnector, "frame_trigger_mode", DRMProperty::FRAME_TRIGGER},
+  {kConnector, "Colorspace", DRMProperty::COLORSPACE},
+  {kConnector, "supported_colorspaces", DRMProperty::SUPPORTED_COLORSPACES},
+  {kPlane, "sspp_layout", DRMProperty::SDE_SSPP_LAYOUT},
+  {kCrtc, "OUT_FENCE_PTR", DRMProperty::INVALID},
+  {kCrtc, "VRR_ENABLED", DRMProperty::INVALID},
+  {kCrtc, "GAMMA_LUT", DRMProperty::INVALID},
+  {kCrtc, "DEGAMMA_LUT", DRMProperty::INVALID},
+  {kCrtc, "CTM", DRMProperty::INVALID},
+  {kCrtc, "input_fence_timeout", DRMProperty::INVALID},
+  {kPlane, "IN_FORMATS", DRMProperty::INVALID},
+  {kPlane, "IN_FENCE_FD", DRMProperty::INVALID},
+  {kPlane, "pixel blend mode", DRMProperty::INVALID},
+  {kPlane, "COLOR_ENCODING", DRMProperty::INVALID},
+  {kPlane, "COLOR_RANGE", DRMProperty::INVALID},
+  {kPlane, "prefill_size", DRMProperty::INVALID},
+  {kConnector, "DPMS", DRMProperty::INVALID},
+  {kConnector, "PATH", DRMProperty::INVALID},
+  {kConnector, "TILE", DRMProperty::INVALID},
+  {kConnector, "link-status", DRMProperty::INVALID},
+  {kConnector, "non-desktop", DRMProperty::INVALID},
+  {kConnector, "content type", DRMProperty::INVALID},
+  {kConnector, "max bpc", DRMProperty::INVALID},
+};
+
+std::vector<std::string> GetRecordedNames(ObjectType object) {
+  std::vector<std::string> names;
+  for (auto &recorded : kRecordedProperties) {
+    if (recorded.object == object) {
+      names.push_back(recorded.name);
+    }
+  }
+  return names;
+}
+
+}  // namespace
+
+TEST(DRMPropertyTest, ResolvesRecordedNames) {
+  DRMPropertyManager prop_mgr;
+  for (auto &recorded : kRecordedProperties) {
+    std::string name = recorded.name;
+    EXPECT_EQ(recorded.property, prop_mgr.GetPropertyEnum(name)) << name;
+    // Names that only share a prefix or differ in case must not resolve.
+    EXPECT_EQ(DRMProperty::INVALID, prop_mgr.GetPropertyEnum(name + "_")) << name;
+    std::string lower = name;
+    for (auto &c : lower) {
+      c = static_cast<char>(tolower(c));
+    }
+    if (lower != name) {
+      EXPECT_EQ(DRMProperty::INVALID, prop_mgr.GetPropertyEnum(lower)) << lower;
+    }
+  }
+  EXPECT_EQ(DRMProperty::INVALID, prop_mgr.GetPropertyEnum(""));
+}
+
+// Enumerates the fake device serving the recorded table, twice to catch results that depend on
+// the order the per-type enumeration threads ran in.
+TEST(DRMPropertyTest, InitServesRecordedTable) {
+  fake_kms::Config config = fake_kms::DefaultConfig();
+  config.crtc_properties = GetRecordedNames(kCrtc);
+  config.plane_properties = GetRecordedNames(kPlane);
+  config.connector_properties = GetRecordedNames(kConnector);
+  ASSERT_EQ(0, fake_kms::Configure(config));
+
+  uint64_t caps_hash = 0;
+  DRMPlanesInfo planes_info;
+  for (int run = 0; run < 2; run++) {
+    int fd = drmOpen("msm_drm", nullptr);
+    ASSERT_GE(fd, 0);
+    DRMManagerInterface *drm_mgr = nullptr;
+    ASSERT_EQ(0, ::GetDRMManager(fd, &drm_mgr));
+
+    DRMInitStats stats = {};
+    drm_mgr->GetInitStats(&stats);
+    EXPECT_GT(stats.total_us, 0u);
+    EXPECT_GE(stats.total_us, stats.planes_us);
+
+    DRMPlanesInfo info;
+    drm_mgr->GetPlanesInfo(&info);
+    EXPECT_EQ(config.planes.size(), info.size());
+    DRMConnectorsInfo connectors;
+    EXPECT_EQ(0, drm_mgr->GetConnectorsInfo(&connectors));
+    EXPECT_EQ(config.connectors.size(), connectors.size());
+
+    uint64_t hash = 0;
+    drm_mgr->GetCapabilitiesHash(&hash);
+    if (run) {
+      EXPECT_EQ(caps_hash, hash);
+      ASSERT_EQ(planes_info.size(), info.size());
+      for (size_t i = 0; i < info.size(); i++) {
+        EXPECT_EQ(planes_info[i].first, info[i].first);
+        EXPECT_EQ(planes_info[i].second.type, info[i].second.type);
+        EXPECT_EQ(planes_info[i].second.max_linewidth, info[i].second.max_linewidth);
+      }
+    }
+    caps_hash = hash;
+    planes_info = info;
+
+    ::DestroyDRMManager();
+    drmClose(fd);
+  }
+}
+
+}  // namespace sde_drm
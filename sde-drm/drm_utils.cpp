@@ -28,7 +28,11 @@
 */
 
 #include <drm/drm_fourcc.h>
+#include <drm_logger.h>
 #include <drm_utils.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
 #include <regex>
 #include <sstream>
 #include <sstream>
@@ -45,6 +49,8 @@ using std::vector;
 
 namespace sde_drm {
 
+#define __CLASS__ "DRMCapParser"
+
 void ParseFormats(const string &line, vector<pair<uint32_t, uint64_t>> *formats) {
   // Match fourcc strings like RA24 or those with modifier like RA24/5/1. The
   // digit after first / is vendor code, the digit after second / is modifier
@@ -115,4 +121,124 @@ void AddProperty(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t property_
 #endif
 }
 
+static bool ParseCapSigned(const string &value, long long min, long long max, long long *out) {
+  if (value.empty()) {
+    return false;
+  }
+
+  char *end = nullptr;
+  errno = 0;
+  long long parsed = strtoll(value.c_str(), &end, 10);
+  if (errno || *end || parsed < min || parsed > max) {
+    return false;
+  }
+  *out = parsed;
+
+  return true;
+}
+
+static bool ParseCapUnsigned(const string &value, unsigned long long max,
+                             unsigned long long *out) {
+  // strtoull silently negates values with a leading minus.
+  if (value.empty() || value[0] == '-') {
+    return false;
+  }
+
+  char *end = nullptr;
+  errno = 0;
+  unsigned long long parsed = strtoull(value.c_str(), &end, 10);
+  if (errno || *end || parsed > max) {
+    return false;
+  }
+  *out = parsed;
+
+  return true;
+}
+
+bool ParseCapValue(const string &value, int *out) {
+  long long parsed = 0;
+  if (!ParseCapSigned(value, INT_MIN, INT_MAX, &parsed)) {
+    return false;
+  }
+  *out = static_cast<int>(parsed);
+
+  return true;
+}
+
+bool ParseCapValue(const string &value, uint32_t *out) {
+  unsigned long long parsed = 0;
+  if (!ParseCapUnsigned(value, UINT32_MAX, &parsed)) {
+    return false;
+  }
+  *out = static_cast<uint32_t>(parsed);
+
+  return true;
+}
+
+bool ParseCapValue(const string &value, uint64_t *out) {
+  unsigned long long parsed = 0;
+  if (!ParseCapUnsigned(value, UINT64_MAX, &parsed)) {
+    return false;
+  }
+  *out = static_cast<uint64_t>(parsed);
+
+  return true;
+}
+
+bool ParseCapValue(const string &value, float *out) {
+  if (value.empty()) {
+    return false;
+  }
+
+  char *end = nullptr;
+  errno = 0;
+  float parsed = strtof(value.c_str(), &end);
+  if (errno || *end) {
+    return false;
+  }
+  *out = parsed;
+
+  return true;
+}
+
+bool ParseCapValue(const string &value, bool *out) {
+  int parsed = 0;
+  if (!ParseCapValue(value, &parsed)) {
+    return false;
+  }
+  *out = (parsed != 0);
+
+  return true;
+}
+
+void SplitCapabilities(const char *data, uint32_t length, vector<pair<string, string>> *caps) {
+  size_t text_length = strnlen(data, length);
+  size_t start = 0;
+  while (start < text_length) {
+    const char *line = data + start;
+    const char *line_end = static_cast<const char *>(memchr(line, '\n', text_length - start));
+    size_t line_length = line_end ? static_cast<size_t>(line_end - line) : text_length - start;
+    start += line_length + 1;
+    if (!line_length) {
+      continue;
+    }
+
+    const char *sep = static_cast<const char *>(memchr(line, '=', line_length));
+    if (sep) {
+      caps->push_back(std::make_pair(string(line, sep), string(sep + 1, line + line_length)));
+    } else {
+      caps->push_back(std::make_pair(string(line, line_length), string()));
+    }
+  }
+}
+
+void ReportCapability(DRMCapStatus status, const string &key, const string &value) {
+  if (status == DRMCapStatus::UNKNOWN_KEY) {
+    // The kernel exposes more keys than are consumed here.
+    DRM_LOGD("Ignoring capability %s=%s", key.c_str(), value.c_str());
+  } else {
+    DRM_LOGE("Malformed capability %s=%s", key.c_str(), value.c_str());
+  }
+}
+
 }  // namespace sde_drm
@@ -30,9 +30,15 @@
 #ifndef __DRM_UTILS_H__
 #define __DRM_UTILS_H__
 
+#include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <xf86drmMode.h>
+#include <utils/hash.h>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -50,6 +56,176 @@ void Tokenize(const std::string &str, std::vector<std::string> *tokens, char del
 void AddProperty(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t property_id, uint64_t value,
                  bool cache, std::unordered_map<uint32_t, uint64_t> &prop_val_map);
 
+// Strict converters for capability blob values. The whole value must be consumed and in range,
+// otherwise false is returned and out is left untouched. Booleans are written as integers.
+bool ParseCapValue(const std::string &value, int *out);
+bool ParseCapValue(const std::string &value, uint32_t *out);
+bool ParseCapValue(const std::string &value, uint64_t *out);
+bool ParseCapValue(const std::string &value, float *out);
+bool ParseCapValue(const std::string &value, bool *out);
+
+enum struct DRMCapStatus {
+  UNKNOWN_KEY,
+  MALFORMED_VALUE,
+};
+
+// Splits the text of a key=value capability blob into its lines. Lines without '=' are keys with
+// an empty value. Text after an embedded NUL is ignored.
+void SplitCapabilities(const char *data, uint32_t length,
+                       std::vector<std::pair<std::string, std::string>> *caps);
+void ReportCapability(DRMCapStatus status, const std::string &key, const std::string &value);
+
+template <class T>
+using DRMCapSetter = std::function<void(T *)>;
+
+// Schema entry for one capability key. Parse validates the value text and produces the setter
+// that applies it. It returns false for malformed values and may leave the setter empty for
+// values that are valid but carry nothing to apply.
+template <class T>
+struct DRMCapKey {
+  std::string key;
+  std::function<bool(const std::string &value, DRMCapSetter<T> *setter)> parse;
+};
+
+// Schema entry for a key whose value is stored as is into a numeric or boolean member of T.
+template <class T, class V>
+DRMCapKey<T> CapField(const std::string &key, V T::*field) {
+  return {key, [field](const std::string &value, DRMCapSetter<T> *setter) {
+    V parsed = {};
+    if (!ParseCapValue(value, &parsed)) {
+      return false;
+    }
+    *setter = [field, parsed](T *out) { out->*field = parsed; };
+    return true;
+  }};
+}
+
+// Table driven parser for the key=value capability blobs exposed by the kernel. Keys are matched
+// exactly against the schema, unknown keys and malformed values are reported. Blobs are compiled
+// into setters and cached by blob id and content hash. An identical blob under another id, such as
+// the same capabilities on every CRTC, shares the compiled setters, so it is not parsed again.
+template <class T>
+class DRMCapParser {
+ public:
+  explicit DRMCapParser(const std::vector<DRMCapKey<T>> &schema) : schema_(schema) {
+    for (size_t i = 0; i < schema_.size(); i++) {
+      index_[schema_[i].key] = i;
+    }
+  }
+
+  // Applies the blob to out. Returns -EINVAL if any value was malformed, the well formed ones are
+  // applied regardless.
+  int Parse(uint32_t blob_id, const void *data, uint32_t length, T *out) {
+    uint64_t hash = sdm::HashBytes(data, length);
+    std::shared_ptr<const Compiled> compiled = Find(blob_id, hash, data, length);
+    if (!compiled) {
+      compiled = Compile(data, length);
+      std::lock_guard<std::mutex> lock(cache_lock_);
+      Insert(blob_id, hash, compiled);
+    }
+
+    for (auto &setter : compiled->setters) {
+      setter(out);
+    }
+
+    return compiled->error;
+  }
+
+ private:
+  struct Compiled {
+    std::string text;
+    std::vector<DRMCapSetter<T>> setters;
+    int error = 0;
+  };
+
+  struct Entry {
+    uint32_t blob_id;
+    uint64_t hash;
+    std::shared_ptr<const Compiled> compiled;
+    uint64_t last_use;
+  };
+
+  // Distinct blobs are few: one per CRTC configuration and one per connected sink.
+  static const size_t kMaxCached = 8;
+
+  std::shared_ptr<const Compiled> Find(uint32_t blob_id, uint64_t hash, const void *data,
+                                       uint32_t length) {
+    std::lock_guard<std::mutex> lock(cache_lock_);
+    std::shared_ptr<const Compiled> same_content = nullptr;
+    for (auto &entry : cache_) {
+      const std::string &text = entry.compiled->text;
+      if (entry.hash != hash || text.size() != length || memcmp(text.data(), data, length)) {
+        continue;
+      }
+      if (entry.blob_id == blob_id) {
+        entry.last_use = ++use_count_;
+        return entry.compiled;
+      }
+      same_content = entry.compiled;
+    }
+
+    if (same_content) {
+      Insert(blob_id, hash, same_content);
+    }
+
+    return same_content;
+  }
+
+  // Adds or replaces the entry of blob_id, evicting the least recently used one when full.
+  void Insert(uint32_t blob_id, uint64_t hash, const std::shared_ptr<const Compiled> &compiled) {
+    Entry entry = {blob_id, hash, compiled, ++use_count_};
+    auto victim = cache_.end();
+    for (auto it = cache_.begin(); it != cache_.end(); it++) {
+      if (it->blob_id == blob_id) {
+        victim = it;
+        break;
+      }
+      if (victim == cache_.end() || it->last_use < victim->last_use) {
+        victim = it;
+      }
+    }
+
+    if (victim != cache_.end() && (victim->blob_id == blob_id || cache_.size() >= kMaxCached)) {
+      *victim = entry;
+    } else {
+      cache_.push_back(entry);
+    }
+  }
+
+  std::shared_ptr<const Compiled> Compile(const void *data, uint32_t length) const {
+    std::shared_ptr<Compiled> compiled = std::make_shared<Compiled>();
+    compiled->text.assign(static_cast<const char *>(data), length);
+    std::vector<std::pair<std::string, std::string>> caps;
+    SplitCapabilities(compiled->text.data(), length, &caps);
+    for (auto &cap : caps) {
+      auto it = index_.find(cap.first);
+      if (it == index_.end()) {
+        ReportCapability(DRMCapStatus::UNKNOWN_KEY, cap.first, cap.second);
+        continue;
+      }
+
+      DRMCapSetter<T> setter = nullptr;
+      if (!schema_[it->second].parse(cap.second, &setter)) {
+        ReportCapability(DRMCapStatus::MALFORMED_VALUE, cap.first, cap.second);
+        compiled->error = -EINVAL;
+        continue;
+      }
+
+      if (setter) {
+        compiled->setters.push_back(setter);
+      }
+    }
+
+    return compiled;
+  }
+
+  std::vector<DRMCapKey<T>> schema_;
+  std::unordered_map<std::string, size_t> index_;
+  std::mutex cache_lock_;
+  std::vector<Entry> cache_;
+  uint64_t use_count_ = 0;
+};
+
 }  // namespace sde_drm
 
 #endif  // __DRM_UTILS_H__
@@ -268,6 +268,28 @@ struct DisplayDetailEnhancerData {
   uint32_t de_blend = 0;              // DE Unsharp Mask blend between High and Low frequencies
 };
 
+/*! @brief The structure describes the pipes SDM assigned to a layer of the last frame.
+
+  @sa DisplayFrameLayout
+*/
+struct DisplayPipeAssignment {
+  uint32_t layer_index = 0;    //!< Index of the layer in the LayerStack.
+  uint32_t left_pipe_id = 0;   //!< Pipe for the left side of the output, 0 if none.
+  uint32_t right_pipe_id = 0;  //!< Pipe for the right side of the output, 0 if none.
+};
+
+/*! @brief The structure describes how SDM laid out the last validated frame.
+
+  @sa DisplayInterface::GetFrameLayout
+*/
+struct DisplayFrameLayout {
+  std::vector<DisplayPipeAssignment> pipes = {};  //!< Pipes of the layers composed by SDE.
+  std::vector<LayerRect> left_roi = {};           //!< Left frame ROI.
+  std::vector<LayerRect> right_roi = {};          //!< Right frame ROI, empty unless split.
+  uint32_t gpu_target_index = 0;                  //!< Index of the GPU target layer.
+  bool fast_path = false;                         //!< Frame qualified for fast path composition.
+};
+
 /*! @brief Display device event handler implemented by the client.
 
   @details This class declares prototype for display device event handler methods which must be
@@ -573,6 +595,19 @@ class DisplayInterface {
   */
   virtual DisplayError SetPanelBrightness(float brightness) = 0;
 
+  /*! @brief Method to move brightness of the builtin display to a new level over time.
+
+    @details The transition is perceptually uniform and each step is applied with a frame
+    update, so brightness and content changes land on the same frame.
+
+    @param[in] brightness the target backlight level 0.0f(min) to 1.0f(max) where -1.0f
+               represents off.
+    @param[in] duration_ms length of the transition, 0 applies the level right away.
+
+    @return \link DisplayError \endlink
+  */
+  virtual DisplayError SetPanelBrightnessRamp(float brightness, uint32_t duration_ms) = 0;
+
   /*! @brief Method to notify display about change in min HDCP encryption level.
 
     @param[in] min_enc_level minimum encryption level value.
@@ -949,6 +984,17 @@ class DisplayInterface {
   */
   virtual DisplayError ClearLUTs() = 0;
 
+  /*! @brief Method to get the strategy and resource decisions for the last validated frame.
+
+    @details Intended for debug tracing, the layout is only meaningful between Prepare and the
+    next Prepare.
+
+    @param[out] layout \link DisplayFrameLayout \endlink
+
+    @return \link DisplayError \endlink
+  */
+  virtual DisplayError GetFrameLayout(DisplayFrameLayout *layout) = 0;
+
  protected:
   virtual ~DisplayInterface() { }
 };
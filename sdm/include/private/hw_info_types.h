@@ -46,6 +46,7 @@ using std::vector;
 
 const int kMaxSDELayers = 16;   // Maximum number of layers that can be handled by MDP5 hardware
                                 // in a given layer stack.
+const uint32_t kMaxFrameROIs = 4;  // Maximum number of frame ROIs programmed on a panel.
 #define MAX_PLANES 4
 #define MAX_DETAIL_ENHANCE_CURVE 3
 #define MAJOR 28
@@ -287,6 +288,19 @@ const int  kPipeDmaLimit       = (1 << 1);
 const int  kPipeScalingLimit   = (1 << 2);
 const int  kPipeRotationLimit  = (1 << 3);
 
+// Time spent by the driver interface enumerating display objects at startup, and by SDM building
+// HWResourceInfo from them or from the saved snapshot.
+struct HWInitStats {
+  uint64_t total_us = 0;
+  uint64_t connectors_us = 0;
+  uint64_t encoders_us = 0;
+  uint64_t crtcs_us = 0;
+  uint64_t planes_us = 0;
+  uint64_t resource_info_us = 0;
+  bool resource_info_from_snapshot = false;
+};
+
+// Fields added here must also be added to Transfer() in hw_resource_snapshot.cpp.
 struct HWResourceInfo {
   uint32_t hw_version = 0;
   uint32_t num_dma_pipe = 0;
@@ -350,6 +364,7 @@ struct HWResourceInfo {
   bool use_baselayer_for_stage = false;
   bool has_micro_idle = false;
   uint32_t ubwc_version = 1;
+  HWInitStats init_stats = {};
 };
 
 struct HWSplitInfo {
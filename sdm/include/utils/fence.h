@@ -32,6 +32,7 @@
 
 #include <core/buffer_sync_handler.h>
 #include <unistd.h>
+#include <atomic>
 #include <utility>
 #include <memory>
 #include <string>
@@ -43,6 +44,8 @@ using std::shared_ptr;
 using std::string;
 using std::to_string;
 
+class FenceWatcher;
+
 class Fence {
  public:
   enum class Status : int32_t {
@@ -90,6 +93,10 @@ class Fence {
 
   static string GetStr(const shared_ptr<Fence> &fence);
 
+  // Shared watcher using the handler passed to Set(), started on first use. Returns nullptr if it
+  // could not be started, callers then fall back to Wait().
+  static FenceWatcher *GetWatcher();
+
   // Write all fences info to the output stream.
   static void Dump(std::ostringstream *os);
 
@@ -103,6 +110,7 @@ class Fence {
 
   static BufferSyncHandler *g_buffer_sync_handler_;
   static std::vector<std::weak_ptr<Fence>> wps_;
+  static std::atomic<FenceWatcher *> g_watcher_;
   int fd_ = -1;
   string name_ = "";
 };
@@ -0,0 +1,132 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __FENCE_WATCHER_H__
+#define __FENCE_WATCHER_H__
+
+#include <utils/fence.h>
+#include <utils/locker.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <functional>
+#include <future>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sdm {
+
+struct FenceWatchStats {
+  uint64_t signaled = 0;
+  uint64_t timed_out = 0;
+  uint64_t cancelled = 0;
+  uint64_t failed = 0;
+  uint64_t total_wait_ns = 0;  // Watch() to signal, signaled fences only
+  uint64_t max_wait_ns = 0;
+  uint64_t last_wait_ns = 0;
+};
+
+// Waits for many fences on one thread. Each fence is added to a single epoll set and its callback
+// runs on the watcher thread once the fence signals, times out or fails, so that callers need not
+// park a thread per fence. Callbacks must not block. Signal status is confirmed through the
+// BufferSyncHandler, so any pollable fd that the handler understands can stand in for a fence.
+class FenceWatcher {
+ public:
+  enum class Result : int32_t {
+    kSignaled = 0,
+    kTimedOut,
+    kCancelled,
+    kFailed,
+  };
+
+  typedef uint64_t WatchId;
+  static const WatchId kInvalidWatchId = 0;
+  // wait_ns is the time from Watch() to completion.
+  typedef std::function<void(Result result, int64_t wait_ns)> Callback;
+
+  FenceWatcher(BufferSyncHandler *buffer_sync_handler, const string &name);
+  ~FenceWatcher();
+
+  DisplayError Init();
+  // Stops the watcher thread and cancels all pending watches.
+  void Deinit();
+
+  // A null fence completes as signaled on the calling thread. A negative timeout waits forever.
+  // Statistics are kept per tag, e.g. per kind of fence.
+  DisplayError Watch(const shared_ptr<Fence> &fence, int timeout_ms, const string &tag,
+                     const Callback &callback, WatchId *id = nullptr);
+  DisplayError Watch(const shared_ptr<Fence> &fence, int timeout_ms, const string &tag,
+                     std::future<Result> *result);
+
+  // Returns true if the watch was still pending, its callback then runs with kCancelled on the
+  // calling thread. Otherwise waits until a completed watch's callback has returned, unless called
+  // from within a callback.
+  bool Cancel(WatchId id);
+
+  bool GetStats(const string &tag, FenceWatchStats *stats);
+  void Dump(std::ostringstream *os);
+
+ private:
+  struct PendingWatch {
+    int fd = -1;  // Duplicate of the fence fd, owned by the watcher
+    int64_t start_ns = 0;
+    int64_t deadline_ns = -1;
+    string tag;
+    Callback callback;
+  };
+
+  struct Completion {
+    WatchId id;
+    Result result;
+    int64_t wait_ns;
+    Callback callback;
+  };
+
+  void WatchThread();
+  void CheckPending(const struct epoll_event *events, int num_events,
+                    std::vector<Completion> *completions);
+  void Complete(WatchId id, Result result, int64_t now, std::vector<Completion> *completions);
+  int GetPollTimeout(int64_t now);
+  void Wake();
+
+  BufferSyncHandler *buffer_sync_handler_ = nullptr;
+  string name_;
+  Locker locker_;
+  std::thread watch_thread_;
+  std::thread::id watch_thread_id_;
+  bool exit_thread_ = false;
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;
+  WatchId next_id_ = kInvalidWatchId + 1;
+  std::set<WatchId> completing_;  // Completed watches whose callbacks have yet to return
+  std::map<WatchId, PendingWatch> pending_;
+  std::map<string, FenceWatchStats> stats_;
+};
+
+}  // namespace sdm
+
+#endif  // __FENCE_WATCHER_H__
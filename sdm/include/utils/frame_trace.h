@@ -0,0 +1,115 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __FRAME_TRACE_H__
+#define __FRAME_TRACE_H__
+
+#include <core/sdm_types.h>
+#include <stdint.h>
+#include <sstream>
+
+// Timestamps the stages of every frame into per-thread rings without taking locks, so that frame
+// time can be broken down without verbose logs changing the timing. A trace point costs two clock
+// reads and a handful of relaxed stores; the cost is measured and reported by FrameTrace::Dump().
+// Building without FRAME_TRACE_ENABLE compiles all trace points out.
+#ifdef FRAME_TRACE_ENABLE
+#define FRAME_TRACE_CONCAT_(a, b) a##b
+#define FRAME_TRACE_CONCAT(a, b) FRAME_TRACE_CONCAT_(a, b)
+#define FRAME_TRACE_SCOPED(display_id, stage) \
+  sdm::FrameTraceScope FRAME_TRACE_CONCAT(frame_trace_scope_, __LINE__)(display_id, stage)
+#else
+#define FRAME_TRACE_SCOPED(display_id, stage)
+#endif
+
+namespace sdm {
+
+enum FrameTraceStage : uint8_t {
+  kFrameTraceCommands,          // Composer command buffer parse, covers all displays
+  kFrameTraceBuildLayerStack,   // HWCDisplay::BuildLayerStack
+  kFrameTracePrepare,           // DisplayBase::Prepare
+  kFrameTraceStrategy,          // One strategy iteration within DisplayBase::Prepare
+  kFrameTraceValidate,          // HWInterface::Validate
+  kFrameTraceCommit,            // DisplayBase::Commit
+  kFrameTraceAtomicCommit,      // Atomic commit into the driver
+  kFrameTraceFenceWait,         // Blocking Fence::Wait
+  kFrameTraceReleaseFences,     // Release fence delivery to the layers after a commit
+  kFrameTraceStageMax,
+};
+
+enum FrameTraceFormat {
+  kFrameTraceBinary,  // FrameTraceFileHeader followed by FrameTraceFileRecords
+  kFrameTraceJson,    // Chrome trace event JSON, opens in Perfetto UI and chrome://tracing
+};
+
+// Layout of a binary export. Fields are little endian, timestamps are CLOCK_MONOTONIC.
+struct FrameTraceFileHeader {
+  uint32_t magic;         // kFrameTraceMagic
+  uint16_t version;       // kFrameTraceVersion
+  uint16_t record_size;   // sizeof(FrameTraceFileRecord)
+  uint32_t pid;
+  uint32_t num_records;
+};
+
+struct FrameTraceFileRecord {
+  int64_t start_ns;
+  uint32_t duration_ns;
+  int32_t tid;
+  int16_t display_id;     // -1 for stages not tied to one display
+  uint8_t stage;          // FrameTraceStage
+  uint8_t reserved[5];
+};
+
+static const uint32_t kFrameTraceMagic = 0x54464453;  // "SDFT"
+static const uint16_t kFrameTraceVersion = 1;
+
+class FrameTrace {
+ public:
+  // Attributes a record to the display of the innermost enclosing scope on the same thread.
+  static const int32_t kInheritDisplay = -2;
+
+  static int64_t Now();
+  static void Record(int32_t display_id, FrameTraceStage stage, int64_t start_ns, int64_t end_ns);
+  // Sets the display inherited by nested records on this thread, returns the previous one.
+  static int32_t SetThreadDisplay(int32_t display_id);
+  // Appends per display p50/p99 and counters of every stage.
+  static void Dump(std::ostringstream *os);
+  static DisplayError Export(const char *path, FrameTraceFormat format);
+  static const char *GetStageName(FrameTraceStage stage);
+};
+
+class FrameTraceScope {
+ public:
+  FrameTraceScope(int32_t display_id, FrameTraceStage stage);
+  ~FrameTraceScope();
+
+ private:
+  int32_t display_id_;
+  int32_t parent_display_id_;
+  FrameTraceStage stage_;
+  int64_t start_ns_;
+};
+
+}  // namespace sdm
+
+#endif  // __FRAME_TRACE_H__
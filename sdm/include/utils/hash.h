@@ -0,0 +1,79 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace sdm {
+
+// FNV-1a hash. Pass the previous result as seed to build a signature over several fields.
+const uint64_t kHashSeed = 0xcbf29ce484222325ULL;
+const uint64_t kHashPrime = 0x100000001b3ULL;
+
+// Multiplication modulo 2^64 on 32 bit halves, as integer_overflow sanitized builds trap on
+// unsigned wraparound.
+constexpr uint64_t MulMod64(uint64_t a, uint64_t b) {
+  return ((((((a >> 32) * (b & 0xffffffffULL)) & 0xffffffffULL) +
+            (((a & 0xffffffffULL) * (b >> 32)) & 0xffffffffULL) +
+            (((a & 0xffffffffULL) * (b & 0xffffffffULL)) >> 32)) & 0xffffffffULL) << 32) |
+         (((a & 0xffffffffULL) * (b & 0xffffffffULL)) & 0xffffffffULL);
+}
+
+inline uint64_t HashBytes(const void *data, size_t size, uint64_t seed = kHashSeed) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; i++) {
+    hash = MulMod64(hash ^ bytes[i], kHashPrime);
+  }
+  return hash;
+}
+
+// FNV-1a over 32 bit words, for lookup tables where a byte wise hash would cost more than the
+// conversion it lets the caller skip.
+inline uint64_t HashWords(const uint32_t *words, size_t count, uint64_t seed = kHashSeed) {
+  uint64_t hash = seed;
+  for (size_t i = 0; i < count; i++) {
+    hash = MulMod64(hash ^ words[i], kHashPrime);
+  }
+  return hash;
+}
+
+// Same as HashBytes over the characters of str, usable in constant expressions.
+constexpr uint64_t HashString(const char *str, uint64_t seed = kHashSeed) {
+  return *str ? HashString(str + 1, MulMod64(seed ^ static_cast<uint8_t>(*str), kHashPrime)) :
+                seed;
+}
+
+template<class T>
+uint64_t HashValue(const T &t, uint64_t seed = kHashSeed) {
+  return HashBytes(&t, sizeof(T), seed);
+}
+
+}  // namespace sdm
+
+#endif  // __HASH_H__
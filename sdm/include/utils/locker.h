@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2014 - 2016, 2018 - 2019, The Linux Foundation. All rights reserved.
+* Copyright (c) 2014 - 2016, 2018 - 2020, The Linux Foundation. All rights reserved.
 *
 * Redistribution and use in source and binary forms, with or without modification, are permitted
 * provided that the following conditions are met:
@@ -29,6 +29,9 @@
 #include <errno.h>
 #include <pthread.h>
 #include <sys/time.h>
+#include <atomic>
+#include <sstream>
+#include <vector>
 
 #define SCOPE_LOCK(locker) Locker::ScopeLock lock(locker)
 #define SEQUENCE_ENTRY_SCOPE_LOCK(locker) Locker::SequenceEntryScopeLock lock(locker)
@@ -38,12 +41,45 @@
 
 namespace sdm {
 
+struct LockerProfile;
+
+// Wait and hold times are bucketed by powers of two microseconds, bucket i counts [2^(i-1), 2^i) us
+// and the last bucket everything above.
+static const uint32_t kLockerHistogramBuckets = 16;
+
+struct LockerSiteStats {
+  const char *site = nullptr;
+  uint64_t acquisitions = 0;
+  uint64_t contended = 0;   // Acquisitions that found the lock held
+  uint64_t wait_ns = 0;
+  uint64_t hold_ns = 0;
+  uint64_t blocking = 0;    // Contended acquisitions by others while this site held the lock
+};
+
+struct LockerStats {
+  uint64_t acquisitions = 0;
+  uint64_t contended = 0;
+  uint64_t wait_ns = 0;
+  uint64_t max_wait_ns = 0;
+  uint64_t hold_ns = 0;
+  uint64_t max_hold_ns = 0;
+  uint64_t cond_waits = 0;  // Wait() and WaitFinite() calls, sequence waits included
+  uint64_t cond_wait_ns = 0;
+  uint64_t wait_histogram[kLockerHistogramBuckets] = {};
+  uint64_t hold_histogram[kLockerHistogramBuckets] = {};
+  int32_t owner_tid = 0;    // Current owner, 0 if the lock is free
+  const char *owner_site = nullptr;
+  int64_t owner_since_ns = 0;
+  std::vector<LockerSiteStats> sites;
+};
+
 class Locker {
  public:
   class ScopeLock {
    public:
-    explicit ScopeLock(Locker& locker) : locker_(locker) {
-      locker_.Lock();
+    explicit ScopeLock(Locker& locker, const char *site = __builtin_FUNCTION())
+      : locker_(locker) {
+      locker_.Lock(site);
     }
 
     ~ScopeLock() {
@@ -56,8 +92,9 @@ class Locker {
 
   class SequenceEntryScopeLock {
    public:
-    explicit SequenceEntryScopeLock(Locker& locker) : locker_(locker) {
-      locker_.Lock();
+    explicit SequenceEntryScopeLock(Locker& locker, const char *site = __builtin_FUNCTION())
+      : locker_(locker) {
+      locker_.Lock(site);
       locker_.sequence_wait_ = 1;
     }
 
@@ -71,8 +108,9 @@ class Locker {
 
   class SequenceExitScopeLock {
    public:
-    explicit SequenceExitScopeLock(Locker& locker) : locker_(locker) {
-      locker_.Lock();
+    explicit SequenceExitScopeLock(Locker& locker, const char *site = __builtin_FUNCTION())
+      : locker_(locker) {
+      locker_.Lock(site);
       locker_.sequence_wait_ = 0;
     }
 
@@ -87,8 +125,9 @@ class Locker {
 
   class SequenceWaitScopeLock {
    public:
-    explicit SequenceWaitScopeLock(Locker& locker) : locker_(locker), error_(false) {
-      locker_.Lock();
+    explicit SequenceWaitScopeLock(Locker& locker, const char *site = __builtin_FUNCTION())
+      : locker_(locker), error_(false) {
+      locker_.Lock(site);
 
       while (locker_.sequence_wait_ == 1) {
         locker_.Wait();
@@ -111,8 +150,9 @@ class Locker {
 
   class SequenceCancelScopeLock {
    public:
-    explicit SequenceCancelScopeLock(Locker& locker) : locker_(locker) {
-      locker_.Lock();
+    explicit SequenceCancelScopeLock(Locker& locker, const char *site = __builtin_FUNCTION())
+      : locker_(locker) {
+      locker_.Lock(site);
       locker_.sequence_wait_ = -1;
     }
 
@@ -140,17 +180,44 @@ class Locker {
   }
 
   ~Locker() {
+    if (profile_.load(std::memory_order_relaxed)) {
+      ReleaseProfile();
+    }
     pthread_mutex_destroy(&mutex_);
     pthread_cond_destroy(&condition_);
     pthread_condattr_destroy(&cond_attr_);
   }
 
-  void Lock() { pthread_mutex_lock(&mutex_); }
-  int32_t TryLock() { return pthread_mutex_trylock(&mutex_); }
-  void Unlock() { pthread_mutex_unlock(&mutex_); }
+  // The call site defaults to the calling function and is only recorded while profiling.
+  void Lock(const char *site = __builtin_FUNCTION()) {
+    if (profiling_.load(std::memory_order_relaxed)) {
+      LockProfiled(site);
+    } else {
+      pthread_mutex_lock(&mutex_);
+    }
+  }
+  int32_t TryLock(const char *site = __builtin_FUNCTION()) {
+    int32_t ret = pthread_mutex_trylock(&mutex_);
+    if (!ret && profiling_.load(std::memory_order_relaxed)) {
+      OnAcquired(site, 0, false, nullptr);
+    }
+    return ret;
+  }
+  void Unlock() {
+    if (hold_start_ns_) {
+      OnReleased();
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
   void Signal() { pthread_cond_signal(&condition_); }
   void Broadcast() { pthread_cond_broadcast(&condition_); }
-  void Wait() { pthread_cond_wait(&condition_, &mutex_); }
+  void Wait() {
+    if (hold_start_ns_) {
+      WaitProfiled(nullptr);
+    } else {
+      pthread_cond_wait(&condition_, &mutex_);
+    }
+  }
   int WaitFinite(uint32_t ms) {
     struct timespec ts;
     if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
@@ -159,9 +226,26 @@ class Locker {
     uint64_t ns = (uint64_t)ts.tv_nsec + (ms * 1000000L);
     ts.tv_sec   = ts.tv_sec + (time_t)(ns / 1000000000L);
     ts.tv_nsec  = ns % 1000000000L;
+    if (hold_start_ns_) {
+      return WaitProfiled(&ts);
+    }
     return pthread_cond_timedwait(&condition_, &mutex_, &ts);
   }
 
+  // Names the lock in the contention dump as name or name[index]. The name must outlive the lock.
+  void SetName(const char *name, int index = -1) {
+    name_ = name;
+    name_index_ = index;
+  }
+  // Returns false if the lock has not been taken while profiling.
+  bool GetStats(LockerStats *stats) const;
+
+  // Contention profiling is off by default and costs one relaxed load per Lock() while off.
+  static void EnableProfiling(bool enable);
+  static bool IsProfiling() { return profiling_.load(std::memory_order_relaxed); }
+  // Lists the locks with the longest total acquire wait, with their busiest call sites.
+  static void DumpProfile(std::ostringstream *os);
+
  private:
   pthread_mutex_t mutex_;
   pthread_cond_t condition_;
@@ -171,6 +255,21 @@ class Locker {
                         // so that capturing a transitionary snapshot of context is prevented.
                         // If flag is set to -1, these routines will exit without doing any
                         // further processing.
+
+  // Profiling state below is written by the owner with mutex_ held. hold_start_ns_ is non zero
+  // while a profiled acquisition is held, so a hold always ends up accounted where it started.
+  void LockProfiled(const char *site);
+  void OnAcquired(const char *site, int64_t wait_ns, bool contended, const char *blocker);
+  void OnReleased();
+  int WaitProfiled(const struct timespec *abs_time);
+  void ReleaseProfile();
+
+  static std::atomic<bool> profiling_;
+  std::atomic<LockerProfile *> profile_ {nullptr};  // Published once, read by contenders
+  int64_t hold_start_ns_ = 0;
+  const char *hold_site_ = nullptr;
+  const char *name_ = nullptr;
+  int name_index_ = -1;
 };
 
 }  // namespace sdm
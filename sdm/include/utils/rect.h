@@ -32,6 +32,7 @@
 
 #include <stdint.h>
 #include <core/sdm_types.h>
+#include <vector>
 #include <core/layer_stack.h>
 #include <utils/debug.h>
 
@@ -43,6 +44,16 @@ namespace sdm {
     kOrientationUnknown,
   };
 
+  // Alignment and minimum size restrictions of a region of interest.
+  struct RectConstraints {
+    uint32_t left_align = 1;
+    uint32_t width_align = 1;
+    uint32_t top_align = 1;
+    uint32_t height_align = 1;
+    uint32_t min_width = 1;
+    uint32_t min_height = 1;
+  };
+
   bool IsValid(const LayerRect &rect);
   bool IsCongruent(const LayerRect &rect1, const LayerRect &rect2);
   void LogI(DebugTag debug_tag, const char *prefix, const LayerRect &roi);
@@ -68,6 +79,11 @@ namespace sdm {
                                      float *dst_width, float *dst_height);
   DisplayError GetScaleFactor(const LayerRect &crop, const LayerRect &dst, bool rotate90,
                               float *scale_x, float *scale_y);
+  float Area(const LayerRect &rect);
+  void AlignRect(const RectConstraints &constraints, const LayerRect &bound, LayerRect *rect);
+  float CoalesceRects(const std::vector<LayerRect> &in_rects, uint32_t max_rects, float rect_cost,
+                      const RectConstraints &constraints, const LayerRect &bound,
+                      std::vector<LayerRect> *out_rects, uint32_t *pair_count = nullptr);
 }  // namespace sdm
 
 #endif  // __RECT_H__
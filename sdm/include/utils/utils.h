@@ -30,8 +30,11 @@
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
+#include <stdint.h>
 #include <cstring>
 
+#include <utils/hash.h>
+
 namespace sdm {
 
 float gcd(float a, float b);
@@ -35,13 +35,18 @@ LOCAL_SRC_FILES               := core_interface.cpp \
                                  color_manager.cpp \
                                  hw_events_interface.cpp \
                                  hw_info_interface.cpp \
-                                 hw_interface.cpp
+                                 hw_interface.cpp \
+                                 hw_resource_snapshot.cpp \
+                                 validate_cache.cpp
 
 ifneq ($(TARGET_IS_HEADLESS), true)
     LOCAL_SRC_FILES           += $(LOCAL_HW_INTF_PATH_2)/hw_info_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_device_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_peripheral_drm.cpp \
+                                 $(LOCAL_HW_INTF_PATH_2)/hw_brightness_engine.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_tv_drm.cpp \
+                                 $(LOCAL_HW_INTF_PATH_2)/hw_hdr_metadata_drm.cpp \
+                                 $(LOCAL_HW_INTF_PATH_2)/hw_mode_index.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_events_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_scale_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_virtual_drm.cpp \
@@ -49,3 +54,32 @@ ifneq ($(TARGET_IS_HEADLESS), true)
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+include $(LOCAL_PATH)/../../../common.mk
+
+LOCAL_MODULE                  := sdm_core_test
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes) $(kernel_includes)
+LOCAL_HEADER_LIBRARIES        := display_headers
+LOCAL_CFLAGS                  := -fno-operator-names -Wno-unused-parameter -DLOG_TAG=\"SDM\" \
+                                 $(common_flags)
+LOCAL_SRC_FILES               := hw_resource_snapshot_test.cpp \
+                                 resource_default_test.cpp \
+                                 validate_cache_test.cpp
+LOCAL_STATIC_LIBRARIES        := libgtest libgtest_main
+LOCAL_SHARED_LIBRARIES        := libsdmcore
+
+ifneq ($(TARGET_IS_HEADLESS), true)
+    LOCAL_CFLAGS              += -isystem external/libdrm
+    LOCAL_SRC_FILES           += drm/hw_mode_index_test.cpp \
+                                 drm/hw_brightness_engine_test.cpp \
+                                 drm/hw_hdr_metadata_drm_test.cpp
+    ifeq ($(TARGET_USES_DRM_PP),true)
+        LOCAL_CFLAGS          += -DPP_DRM_ENABLE
+        LOCAL_SRC_FILES       += drm/hw_color_manager_drm_test.cpp
+    endif
+endif
+
+include $(BUILD_EXECUTABLE)
@@ -41,6 +41,7 @@ DisplayError CompManager::Init(const HWResourceInfo &hw_res_info,
                                BufferAllocator *buffer_allocator,
                                SocketHandler *socket_handler) {
   SCOPE_LOCK(locker_);
+  locker_.SetName("CompManager::locker_");
 
   DisplayError error = kErrorNone;
 
@@ -47,6 +47,7 @@ CoreImpl::CoreImpl(BufferAllocator *buffer_allocator,
 
 DisplayError CoreImpl::Init() {
   SCOPE_LOCK(locker_);
+  locker_.SetName("CoreImpl::locker_");
   DisplayError error = kErrorNone;
 
   // Try to load extension library & get handle to its interface.
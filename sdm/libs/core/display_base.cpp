@@ -23,9 +23,11 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
 #include <utils/formats.h>
+#include <utils/frame_trace.h>
 #include <utils/rect.h>
 #include <utils/utils.h>
 
@@ -63,6 +65,16 @@ static ColorPrimaries GetColorPrimariesFromAttribute(const std::string &gamut) {
   return ColorPrimaries_BT709_5;
 }
 
+// Checks for the ITU-T T.35 header of an ST 2094-40 (HDR10+) message: country code, terminal
+// provider code, provider oriented code, application identifier and application version.
+static bool IsST2094_40MetaData(const uint8_t *payload, uint32_t size) {
+  static const uint8_t kHeader[] = {0xB5, 0x00, 0x3C, 0x00, 0x01, 0x04};
+  const uint32_t kHeaderSize = UINT32(sizeof(kHeader));
+
+  return (size > kHeaderSize) && !memcmp(payload, kHeader, kHeaderSize) &&
+         (payload[kHeaderSize] <= 1);
+}
+
 // TODO(user): Have a single structure handle carries all the interface pointers and variables.
 DisplayBase::DisplayBase(DisplayType display_type, DisplayEventHandler *event_handler,
                          HWDeviceType hw_device_type, BufferAllocator *buffer_allocator,
@@ -96,6 +108,7 @@ DisplayError DisplayBase::Init() {
 
   uint32_t active_index = 0;
   int drop_vsync = 0;
+  int disable_validate_cache = 0;
   hw_intf_->GetActiveConfig(&active_index);
   hw_intf_->GetDisplayAttributes(active_index, &display_attributes_);
   fb_config_ = display_attributes_;
@@ -175,6 +188,9 @@ DisplayError DisplayBase::Init() {
   Debug::Get()->GetProperty(DROP_SKEWED_VSYNC, &drop_vsync);
   drop_skewed_vsync_ = (drop_vsync == 1);
 
+  Debug::GetProperty(DISABLE_VALIDATE_CACHE_PROP, &disable_validate_cache);
+  disable_validate_cache_ = (disable_validate_cache == 1);
+
   return kErrorNone;
 
 CleanupOnError:
@@ -293,6 +309,7 @@ DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
   needs_validate_ = true;
 
   DTRACE_SCOPED();
+  FRAME_TRACE_SCOPED(display_id_, kFrameTracePrepare);
   // Allow prepare as pending doze/pending_power_on is handled as a part of draw cycle
   if (!active_ && !pending_doze_ && !pending_power_on_) {
     return kErrorPermission;
@@ -321,9 +338,18 @@ DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
 
   hw_layers_.updates_mask.set(kUpdateResources);
   comp_manager_->GenerateROI(display_comp_ctx_, &hw_layers_);
+  if (hw_panel_info_.partial_update) {
+    CoalesceFrameROI();
+  }
   comp_manager_->PrePrepare(display_comp_ctx_, &hw_layers_);
 
+  // Validate result cache is bypassed for writeback and while a power state change is pending,
+  // since those frames carry connector state that is not part of the strategy signature.
+  bool use_validate_cache = !disable_validate_cache_ && (display_type_ != kVirtual) &&
+                            !layer_stack->output_buffer && !pending_doze_ && !pending_power_on_;
+
   while (true) {
+    FRAME_TRACE_SCOPED(display_id_, kFrameTraceStrategy);
     error = comp_manager_->Prepare(display_comp_ctx_, &hw_layers_);
     if (error != kErrorNone) {
       break;
@@ -336,7 +362,17 @@ DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
       break;
     }
 
-    error = hw_intf_->Validate(&hw_layers_);
+    {
+      FRAME_TRACE_SCOPED(display_id_, kFrameTraceValidate);
+      if (use_validate_cache) {
+        // A configuration the driver already accepted skips the TEST_ONLY commit, and one it
+        // already rejected moves on to the next strategy straight away.
+        uint64_t signature = ValidateCache::GetSignature(hw_layers_, UINT64(qsync_mode_));
+        error = validate_cache_.Validate(hw_intf_, &hw_layers_, signature);
+      } else {
+        error = hw_intf_->Validate(&hw_layers_);
+      }
+    }
     if (error == kErrorNone) {
       // Strategy is successful now, wait for Commit().
       needs_validate_ = false;
@@ -360,6 +396,7 @@ DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
 DisplayError DisplayBase::Commit(LayerStack *layer_stack) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
   DisplayError error = kErrorNone;
+  FRAME_TRACE_SCOPED(display_id_, kFrameTraceCommit);
 
   // Allow commit as pending doze/pending_power_on is handled as a part of draw cycle
   if (!active_ && !pending_doze_ && !pending_power_on_) {
@@ -395,6 +432,8 @@ DisplayError DisplayBase::Commit(LayerStack *layer_stack) {
 
   error = hw_intf_->Commit(&hw_layers_);
   if (error != kErrorNone) {
+    // A cached configuration may no longer be accepted by the driver, revalidate from scratch.
+    InvalidateValidateCache();
     if (layer_stack->flags.fast_path && hw_layers_.info.fast_path_composition) {
       // If COMMIT fails on the Fast Path, set Safe Mode.
       DLOGE("COMMIT failed in Fast Path, set Safe Mode!");
@@ -404,6 +443,7 @@ DisplayError DisplayBase::Commit(LayerStack *layer_stack) {
     return error;
   }
 
+  validate_cache_.OnCommit();
   PostCommitLayerParams(layer_stack);
 
   if (partial_update_control_) {
@@ -449,6 +489,7 @@ DisplayError DisplayBase::Flush(LayerStack *layer_stack) {
   error = hw_intf_->Flush(&hw_layers_);
   if (error == kErrorNone) {
     comp_manager_->Purge(display_comp_ctx_);
+    InvalidateValidateCache();
     needs_validate_ = true;
   } else {
     DLOGW("Unable to flush display %d-%d", display_id_, display_type_);
@@ -553,6 +594,8 @@ DisplayError DisplayBase::SetDisplayState(DisplayState state, bool teardown,
     return kErrorNone;
   }
 
+  InvalidateValidateCache();
+
   // If vsync is enabled, disable vsync before power off/Doze suspend
   if (vsync_enable_ && (state == kStateOff || state == kStateDozeSuspend)) {
     error = SetVSyncState(false /* enable */);
@@ -682,6 +725,8 @@ DisplayError DisplayBase::SetActiveConfig(uint32_t index) {
     return error;
   }
 
+  InvalidateValidateCache();
+
   return ReconfigureDisplay();
 }
 
@@ -749,6 +794,23 @@ std::string DisplayBase::Dump() {
   os << " Topology: " << display_attributes_.topology;
   os << std::noboolalpha;
 
+  const HWInitStats &init_stats = hw_resource_info_.init_stats;
+  os << "\nHW init: " << init_stats.total_us << "us connectors: " << init_stats.connectors_us
+     << "us encoders: " << init_stats.encoders_us << "us crtcs: " << init_stats.crtcs_us
+     << "us planes: " << init_stats.planes_us << "us resources: "
+     << init_stats.resource_info_us << "us"
+     << (init_stats.resource_info_from_snapshot ? " (snapshot)" : "");
+
+  os << "\nValidate cache: " << (disable_validate_cache_ ? "disabled" : "enabled");
+  validate_cache_.Dump(&os);
+
+  if (hw_panel_info_.partial_update) {
+    os << "\nPartial update saved pixels: last frame: " << pu_saved_pixels_;
+    if (pu_frame_count_) {
+      os << " avg: " << (pu_total_saved_pixels_ / pu_frame_count_);
+    }
+  }
+
   os << "\nCurrent Color Mode: " << current_color_mode_.c_str();
   os << "\nAvailable Color Modes:\n";
   for (auto it : color_mode_map_) {
@@ -933,6 +995,7 @@ DisplayError DisplayBase::ColorSVCRequestRoute(const PPDisplayAPIPayload &in_pay
                                                PPDisplayAPIPayload *out_payload,
                                                PPPendingParams *pending_action) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
+  InvalidateValidateCache();
   if (color_mgr_)
     return color_mgr_->ColorSVCRequestRoute(in_payload, out_payload, pending_action);
   else
@@ -1063,6 +1126,7 @@ DisplayError DisplayBase::SetColorModeInternal(const std::string &color_mode,
 
   DLOGV_IF(kTagQDCM, "Color Mode Name = %s corresponding mode_id = %d", sde_display_mode->name,
            sde_display_mode->id);
+  InvalidateValidateCache();
   DisplayError error = kErrorNone;
   int32_t render_intent = 0;
   if (!str_render_intent.empty()) {
@@ -1137,6 +1201,8 @@ DisplayError DisplayBase::SetColorTransform(const uint32_t length, const double
     return kErrorParameters;
   }
 
+  InvalidateValidateCache();
+
   return color_mgr_->ColorMgrSetColorTransform(length, color_transform);
 }
 
@@ -1315,6 +1381,8 @@ DisplayError DisplayBase::ReconfigureDisplay() {
     return kErrorNone;
   }
 
+  InvalidateValidateCache();
+
   error = comp_manager_->ReconfigureDisplay(display_comp_ctx_, display_attributes, hw_panel_info,
                                             mixer_attributes, fb_config_,
                                             &(default_clock_hz_));
@@ -1539,6 +1607,7 @@ DisplayError DisplayBase::SetFrameBufferConfig(const DisplayConfigVariableInfo &
 
   fb_config_.x_pixels = width;
   fb_config_.y_pixels = height;
+  InvalidateValidateCache();
 
   DLOGI("New framebuffer resolution (%dx%d)", fb_config_.x_pixels, fb_config_.y_pixels);
 
@@ -1562,6 +1631,7 @@ DisplayError DisplayBase::SetDetailEnhancerData(const DisplayDetailEnhancerData
   if (error != kErrorNone) {
     return error;
   }
+  InvalidateValidateCache();
   // TODO(user): Temporary changes, to be removed when DRM driver supports
   // Partial update with Destination scaler enabled.
   if (de_data.enable) {
@@ -1653,9 +1723,35 @@ void DisplayBase::CommitLayerParams(LayerStack *layer_stack) {
     hw_layers_.elapse_timestamp = layer_stack->elapse_timestamp;
   }
 
+  UpdateDynamicHDRMetaData(layer_stack);
+
   return;
 }
 
+void DisplayBase::UpdateDynamicHDRMetaData(LayerStack *layer_stack) {
+  HWHDRLayerInfo &hdr_layer_info = hw_layers_.info.hdr_layer_info;
+  int32_t layer_index = hdr_layer_info.layer_index;
+
+  // Dynamic metadata travels with the buffer, so it is picked up at commit. The buffer may have
+  // changed since Prepare() when validation was skipped.
+  if (hw_panel_info_.hdr_plus_enabled && hdr_layer_info.operation == HWHDRLayerInfo::kSet &&
+      layer_index > -1 && UINT32(layer_index) < layer_stack->layers.size()) {
+    const LayerBuffer &buffer = layer_stack->layers.at(UINT32(layer_index))->input_buffer;
+    const ColorMetaData &color_metadata = buffer.color_metadata;
+    uint32_t size = std::min(color_metadata.dynamicMetaDataLen,
+                             UINT32(sizeof(color_metadata.dynamicMetaDataPayload)));
+    if (color_metadata.dynamicMetaDataValid &&
+        IsST2094_40MetaData(color_metadata.dynamicMetaDataPayload, size)) {
+      hdr_layer_info.dyn_hdr_vsif_payload.assign(color_metadata.dynamicMetaDataPayload,
+                                                 color_metadata.dynamicMetaDataPayload + size);
+      return;
+    }
+  }
+
+  // A payload taken from an earlier buffer must not outlive that frame.
+  hdr_layer_info.dyn_hdr_vsif_payload.clear();
+}
+
 void DisplayBase::PostCommitLayerParams(LayerStack *layer_stack) {
   // Copy the release fence from HWLayers to clients layers
     uint32_t hw_layers_count = UINT32(hw_layers_.info.hw_layers.size());
@@ -1951,6 +2047,7 @@ void DisplayBase::HwRecovery(const HWRecoveryEvent sdm_event_code) {
       }
       break;
     case HWRecoveryEvent::kDisplayPowerReset:
+      InvalidateValidateCache();
       DLOGI("display = %d attempting to start display power reset", display_type_);
       if (StartDisplayPowerReset()) {
         DLOGI("display = %d allowed to start display power reset", display_type_);
@@ -2115,9 +2212,94 @@ bool DisplayBase::GameEnhanceSupported() {
   return false;
 }
 
+DisplayError DisplayBase::GetFrameLayout(DisplayFrameLayout *layout) {
+  lock_guard<recursive_mutex> obj(recursive_mutex_);
+  if (!layout) {
+    return kErrorParameters;
+  }
+
+  const HWLayersInfo &hw_layers_info = hw_layers_.info;
+  uint32_t hw_layers_count = std::min(UINT32(hw_layers_info.hw_layers.size()),
+                                      UINT32(hw_layers_info.index.size()));
+  hw_layers_count = std::min(hw_layers_count, UINT32(kMaxSDELayers));
+
+  layout->pipes.clear();
+  for (uint32_t i = 0; i < hw_layers_count; i++) {
+    const HWLayerConfig &config = hw_layers_.config[i];
+    DisplayPipeAssignment pipe = {};
+    pipe.layer_index = hw_layers_info.index.at(i);
+    pipe.left_pipe_id = config.left_pipe.valid ? config.left_pipe.pipe_id : 0;
+    pipe.right_pipe_id = config.right_pipe.valid ? config.right_pipe.pipe_id : 0;
+    layout->pipes.push_back(pipe);
+  }
+
+  layout->left_roi = hw_layers_info.left_frame_roi;
+  layout->right_roi = hw_layers_info.roi_split ? hw_layers_info.right_frame_roi :
+                                                 std::vector<LayerRect>();
+  layout->gpu_target_index = hw_layers_info.gpu_target_index;
+  layout->fast_path = hw_layers_info.fast_path_composition;
+
+  return kErrorNone;
+}
+
 DisplayError DisplayBase::OnMinHdcpEncryptionLevelChange(uint32_t min_enc_level) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
   return hw_intf_->OnMinHdcpEncryptionLevelChange(min_enc_level);
 }
 
+void DisplayBase::InvalidateValidateCache() {
+  validate_cache_.Invalidate();
+}
+
+void DisplayBase::CoalesceFrameROI() {
+  // Every extra ROI costs about as much as fetching this many full mixer lines.
+  const uint32_t kROIOverheadLines = 8;
+
+  HWLayersInfo &hw_layers_info = hw_layers_.info;
+  LayerRect mixer_rect = LayerRect(0.0f, 0.0f, FLOAT(mixer_attributes_.width),
+                                   FLOAT(mixer_attributes_.height));
+  LayerRect left_bound = mixer_rect;
+  LayerRect right_bound = mixer_rect;
+  if (display_attributes_.is_device_split) {
+    left_bound.right = FLOAT(mixer_attributes_.split_left);
+    right_bound.left = FLOAT(mixer_attributes_.split_left);
+  }
+  float roi_cost = FLOAT(mixer_attributes_.width * kROIOverheadLines);
+  RectConstraints constraints = {};
+  constraints.left_align = UINT32(std::max(hw_panel_info_.left_align, 1));
+  constraints.width_align = UINT32(std::max(hw_panel_info_.width_align, 1));
+  constraints.top_align = UINT32(std::max(hw_panel_info_.top_align, 1));
+  constraints.height_align = UINT32(std::max(hw_panel_info_.height_align, 1));
+  constraints.min_width = UINT32(std::max(hw_panel_info_.min_roi_width, 1));
+  constraints.min_height = UINT32(std::max(hw_panel_info_.min_roi_height, 1));
+
+  float roi_area = 0.0f;
+  if (hw_layers_info.left_frame_roi.size() > 1) {
+    std::vector<LayerRect> damage = hw_layers_info.left_frame_roi;
+    uint32_t max_rois = std::min(std::max(hw_panel_info_.left_roi_count, 1u), kMaxFrameROIs);
+    roi_area += CoalesceRects(damage, max_rois, roi_cost, constraints, left_bound,
+                              &hw_layers_info.left_frame_roi);
+  } else {
+    for (auto &roi : hw_layers_info.left_frame_roi) {
+      roi_area += Area(roi);
+    }
+  }
+
+  if (hw_layers_info.right_frame_roi.size() > 1) {
+    std::vector<LayerRect> damage = hw_layers_info.right_frame_roi;
+    uint32_t max_rois = std::min(std::max(hw_panel_info_.right_roi_count, 1u), kMaxFrameROIs);
+    roi_area += CoalesceRects(damage, max_rois, roi_cost, constraints, right_bound,
+                              &hw_layers_info.right_frame_roi);
+  } else {
+    for (auto &roi : hw_layers_info.right_frame_roi) {
+      roi_area += Area(roi);
+    }
+  }
+
+  float frame_area = Area(mixer_rect);
+  pu_saved_pixels_ = (roi_area < frame_area) ? UINT64(frame_area - roi_area) : 0;
+  pu_total_saved_pixels_ += pu_saved_pixels_;
+  pu_frame_count_++;
+}
+
 }  // namespace sdm
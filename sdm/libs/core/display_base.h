@@ -38,6 +38,7 @@
 #include "comp_manager.h"
 #include "color_manager.h"
 #include "hw_events_interface.h"
+#include "validate_cache.h"
 
 namespace sdm {
 
@@ -86,6 +87,9 @@ class DisplayBase : public DisplayInterface {
   virtual DisplayError SetPanelBrightness(float brightness) {
     return kErrorNotSupported;
   }
+  virtual DisplayError SetPanelBrightnessRamp(float brightness, uint32_t duration_ms) {
+    return kErrorNotSupported;
+  }
   virtual DisplayError OnMinHdcpEncryptionLevelChange(uint32_t min_enc_level);
   virtual DisplayError ColorSVCRequestRoute(const PPDisplayAPIPayload &in_payload,
                                             PPDisplayAPIPayload *out_payload,
@@ -164,6 +168,7 @@ class DisplayBase : public DisplayInterface {
   virtual DisplayError ClearLUTs() {
     return kErrorNotSupported;
   }
+  virtual DisplayError GetFrameLayout(DisplayFrameLayout *layout);
 
  protected:
   const char *kBt2020Pq = "bt2020_pq";
@@ -172,6 +177,7 @@ class DisplayBase : public DisplayInterface {
   DisplayError BuildLayerStackStats(LayerStack *layer_stack);
   virtual DisplayError ValidateGPUTargetParams();
   void CommitLayerParams(LayerStack *layer_stack);
+  void UpdateDynamicHDRMetaData(LayerStack *layer_stack);
   void PostCommitLayerParams(LayerStack *layer_stack);
   DisplayError ValidateScaling(uint32_t width, uint32_t height);
   DisplayError ValidateDataspace(const ColorMetaData &color_metadata);
@@ -200,6 +206,8 @@ class DisplayBase : public DisplayInterface {
   void InsertBT2020PqHlgModes(const std::string &str_render_intent);
   DisplayError HandlePendingVSyncEnable(const shared_ptr<Fence> &retire_fence);
   DisplayError HandlePendingPowerState(const shared_ptr<Fence> &retire_fence);
+  void InvalidateValidateCache();
+  void CoalesceFrameROI();
 
   recursive_mutex recursive_mutex_;
   int32_t display_id_ = -1;
@@ -253,6 +261,12 @@ class DisplayBase : public DisplayInterface {
   bool pending_power_on_ = false;
   QSyncMode qsync_mode_ = kQSyncModeNone;
   bool needs_avr_update_ = false;
+  ValidateCache validate_cache_ = {};
+  bool disable_validate_cache_ = false;
+  // Partial update statistics, in pixels not fetched compared to a full frame update.
+  uint64_t pu_saved_pixels_ = 0;
+  uint64_t pu_total_saved_pixels_ = 0;
+  uint64_t pu_frame_count_ = 0;
 
   static Locker display_power_reset_lock_;
   static bool display_power_reset_pending_;
@@ -365,6 +365,16 @@ DisplayError DisplayBuiltIn::SetDisplayState(DisplayState state, bool teardown,
     SetDeferredFpsConfig();
   }
 
+  if (state == kStateOff) {
+    // Power off cancels any brightness ramp in the driver layer, along with the vsync events
+    // that were only kept on for it.
+    lock_guard<std::mutex> ramp_lock(brightness_ramp_lock_);
+    if (brightness_ramp_ && !vsync_enable_) {
+      hw_events_intf_->SetEventState(HWEvent::VSYNC, false);
+    }
+    brightness_ramp_ = false;
+  }
+
   error = DisplayBase::SetDisplayState(state, teardown, release_fence);
   if (error != kErrorNone) {
     return error;
@@ -423,6 +433,8 @@ DisplayError DisplayBuiltIn::SetDisplayMode(uint32_t mode) {
       return error;
     }
 
+    // The POMS switch is staged in the driver until the next commit.
+    validate_cache_.SetModeChangePending();
     DisplayBase::ReconfigureDisplay();
 
     if (mode == kModeVideo) {
@@ -442,6 +454,10 @@ DisplayError DisplayBuiltIn::SetDisplayMode(uint32_t mode) {
 }
 
 DisplayError DisplayBuiltIn::SetPanelBrightness(float brightness) {
+  return SetPanelBrightnessRamp(brightness, 0);
+}
+
+DisplayError DisplayBuiltIn::SetPanelBrightnessRamp(float brightness, uint32_t duration_ms) {
   lock_guard<recursive_mutex> obj(brightness_lock_);
 
   if (brightness != -1.0f && !(0.0f <= brightness && brightness <= 1.0f)) {
@@ -471,11 +487,18 @@ DisplayError DisplayBuiltIn::SetPanelBrightness(float brightness) {
     level_remainder = t - level;
   }
 
-  DisplayError err = hw_intf_->SetPanelBrightness(level);
+  DisplayError err = duration_ms ? hw_intf_->SetPanelBrightnessRamp(level, duration_ms) :
+                                   hw_intf_->SetPanelBrightness(level);
   if (err == kErrorNone) {
     level_remainder_ = level_remainder;
-    DLOGI_IF(kTagDisplay, "Setting brightness to level %d (%f percent)", level,
-             brightness * 100);
+    DLOGI_IF(kTagDisplay, "Setting brightness to level %d (%f percent) over %u ms", level,
+             brightness * 100, duration_ms);
+    if (duration_ms) {
+      // Steps also land on vsync, so keep vsync events on until the ramp completes.
+      lock_guard<std::mutex> ramp_lock(brightness_ramp_lock_);
+      brightness_ramp_ = true;
+      hw_events_intf_->SetEventState(HWEvent::VSYNC, true);
+    }
   } else if (err == kErrorDeferred) {
     // TODO(user): I8508d64a55c3b30239c6ed2886df391407d22f25 causes mismatch between perceived
     // power state and actual panel power state. Requires a rework. Below check will set up
@@ -535,6 +558,7 @@ DisplayError DisplayBuiltIn::SetRefreshRate(uint32_t refresh_rate, bool final_ra
       handle_idle_timeout_ = false;
       return error;
     }
+    validate_cache_.SetModeChangePending();
 
     error = comp_manager_->CheckEnforceSplit(display_comp_ctx_, refresh_rate);
     if (error != kErrorNone) {
@@ -574,6 +598,8 @@ bool DisplayBuiltIn::CanLowerFps(bool idle_screen) {
 }
 
 DisplayError DisplayBuiltIn::VSync(int64_t timestamp) {
+  LatchBrightnessRamp(timestamp);
+
   if (vsync_enable_ && !drop_hw_vsync_) {
     DisplayEventVSync vsync;
     vsync.timestamp = timestamp;
@@ -583,6 +609,36 @@ DisplayError DisplayBuiltIn::VSync(int64_t timestamp) {
   return kErrorNone;
 }
 
+void DisplayBuiltIn::LatchBrightnessRamp(int64_t timestamp) {
+  lock_guard<std::mutex> ramp_lock(brightness_ramp_lock_);
+  if (brightness_ramp_) {
+    bool pending = false;
+    if (hw_intf_->LatchPanelBrightness(timestamp, &pending) == kErrorNone && pending) {
+      return;
+    }
+    brightness_ramp_ = false;
+  }
+
+  // Nothing steps on vsync any more, e.g. after a ramp was cancelled, so drop events no client
+  // asked for.
+  if (!vsync_enable_) {
+    hw_events_intf_->SetEventState(HWEvent::VSYNC, false);
+  }
+}
+
+DisplayError DisplayBuiltIn::SetVSyncState(bool enable) {
+  lock_guard<recursive_mutex> obj(recursive_mutex_);
+  lock_guard<std::mutex> ramp_lock(brightness_ramp_lock_);
+
+  DisplayError error = DisplayBase::SetVSyncState(enable);
+  if (!enable && brightness_ramp_) {
+    // The ramp still steps on vsync; LatchBrightnessRamp() turns the events off once it is done.
+    hw_events_intf_->SetEventState(HWEvent::VSYNC, true);
+  }
+
+  return error;
+}
+
 void DisplayBuiltIn::IdleTimeout() {
   if (hw_panel_info_.mode == kModeVideo) {
     if (event_handler_->HandleEvent(kIdleTimeout) != kErrorNone) {
@@ -827,6 +883,7 @@ DisplayError DisplayBuiltIn::SetFrameTriggerMode(FrameTriggerMode mode) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
 
   trigger_mode_debug_ = mode;
+  InvalidateValidateCache();
   return kErrorNone;
 }
 
@@ -928,6 +985,7 @@ DisplayError DisplayBuiltIn::SetQSyncMode(QSyncMode qsync_mode) {
 
   qsync_mode_ = qsync_mode;
   needs_avr_update_ = true;
+  InvalidateValidateCache();
   event_handler_->Refresh();
 
   return kErrorNone;
@@ -976,6 +1034,8 @@ DisplayError DisplayBuiltIn::SetDynamicDSIClock(uint64_t bit_clk_rate) {
     return kErrorNone;
   }
 
+  validate_cache_.SetModeChangePending();
+
   return hw_intf_->SetDynamicDSIClock(bit_clk_rate);
 }
 
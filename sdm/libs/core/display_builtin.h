@@ -115,6 +115,7 @@ class DisplayBuiltIn : public DisplayBase, HWEventHandler, DppsPropIntf {
   virtual DisplayError GetRefreshRateRange(uint32_t *min_refresh_rate, uint32_t *max_refresh_rate);
   virtual DisplayError SetRefreshRate(uint32_t refresh_rate, bool final_rate, bool idle_screen);
   virtual DisplayError SetPanelBrightness(float brightness);
+  virtual DisplayError SetPanelBrightnessRamp(float brightness, uint32_t duration_ms);
   virtual DisplayError GetPanelBrightness(float *brightness);
   virtual DisplayError GetPanelMaxBrightness(uint32_t *max_brightness_level);
   virtual DisplayError GetRefreshRate(uint32_t *refresh_rate);
@@ -128,6 +129,7 @@ class DisplayBuiltIn : public DisplayBase, HWEventHandler, DppsPropIntf {
   virtual DisplayError SetFrameTriggerMode(FrameTriggerMode mode);
   virtual DisplayError SetBLScale(uint32_t level);
   virtual DisplayError GetQSyncMode(QSyncMode *qsync_mode);
+  virtual DisplayError SetVSyncState(bool enable);
   virtual DisplayError colorSamplingOn();
   virtual DisplayError colorSamplingOff();
 
@@ -160,6 +162,7 @@ class DisplayBuiltIn : public DisplayBase, HWEventHandler, DppsPropIntf {
   void GetFpsConfig(HWDisplayAttributes *display_attributes, HWPanelInfo *panel_info);
   void UpdateDisplayModeParams();
   bool CanLowerFps(bool idle_screen);
+  void LatchBrightnessRamp(int64_t timestamp);
 
   const uint32_t kPuTimeOutMs = 1000;
   std::vector<HWEvent> event_list_;
@@ -175,6 +178,9 @@ class DisplayBuiltIn : public DisplayBase, HWEventHandler, DppsPropIntf {
   float cached_brightness_ = 0.0f;
   bool pending_brightness_ = false;
   recursive_mutex brightness_lock_;
+  // Set while a brightness ramp needs vsync events to step, guarded by brightness_ramp_lock_.
+  bool brightness_ramp_ = false;
+  std::mutex brightness_ramp_lock_;
   LayerRect left_frame_roi_ = {};
   LayerRect right_frame_roi_ = {};
   Locker dpps_pu_lock_;
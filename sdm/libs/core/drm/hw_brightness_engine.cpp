@@ -0,0 +1,245 @@
+/*
+Copyright (c) 2020, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include <utils/debug.h>
+#include <utils/sys.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "hw_brightness_engine.h"
+
+#define __CLASS__ "HWBrightnessEngine"
+
+namespace sdm {
+
+static const float kPerceptualGamma = 2.2f;
+
+DisplayError HWBrightnessEngine::Init(const std::string &node, int max_level) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  if (fd_ >= 0) {
+    Sys::close_(fd_);
+  }
+
+  fd_ = -1;
+  node_ = node;
+  max_level_ = max_level;
+  written_level_ = -1;
+  ramping_ = false;
+  hold_for_commit_ = false;
+
+  return OpenNode();
+}
+
+DisplayError HWBrightnessEngine::OpenNode() {
+  if (fd_ >= 0) {
+    return kErrorNone;
+  }
+
+  if (node_.empty()) {
+    return kErrorHardware;
+  }
+
+  // Retried on use, the panel driver may register the node after the display comes up.
+  fd_ = Sys::open_(node_.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd_ < 0) {
+    DLOGE("Failed to open node = %s, error = %s ", node_.c_str(), strerror(errno));
+    return kErrorFileDescriptor;
+  }
+
+  return kErrorNone;
+}
+
+void HWBrightnessEngine::Deinit() {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  if (fd_ >= 0) {
+    Sys::close_(fd_);
+    fd_ = -1;
+  }
+  ramping_ = false;
+}
+
+int64_t HWBrightnessEngine::Now() {
+  struct timespec now = {};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t(now.tv_sec) * 1000000000LL) + now.tv_nsec;
+}
+
+float HWBrightnessEngine::ToPerceptual(int level) const {
+  if (max_level_ <= 0 || level <= 0) {
+    return 0.0f;
+  }
+
+  float linear = std::min(1.0f, static_cast<float>(level) / static_cast<float>(max_level_));
+  return powf(linear, 1.0f / kPerceptualGamma);
+}
+
+int HWBrightnessEngine::FromPerceptual(float perceptual) const {
+  float linear = powf(std::max(0.0f, std::min(1.0f, perceptual)), kPerceptualGamma);
+  return static_cast<int>(lroundf(linear * static_cast<float>(max_level_)));
+}
+
+DisplayError HWBrightnessEngine::WriteLevel(int level) {
+  char buffer[kMaxSysfsCommandLength] = {0};
+  int32_t bytes = snprintf(buffer, kMaxSysfsCommandLength, "%d\n", level);
+  ssize_t ret = Sys::pwrite_(fd_, buffer, static_cast<size_t>(bytes), 0);
+  // A sysfs store takes the whole value or nothing, a short write did not set the level.
+  if (ret != bytes) {
+    DLOGE("Failed to write to node = %s, wrote %zd of %d bytes, error = %s ", node_.c_str(), ret,
+          bytes, (ret < 0) ? strerror(errno) : "short write");
+    return kErrorHardware;
+  }
+
+  written_level_ = level;
+  return kErrorNone;
+}
+
+DisplayError HWBrightnessEngine::ReadLevel(int *level) {
+  // sysfs regenerates the attribute on every read from offset 0, so this sees writes made by
+  // other clients of the node too.
+  char value[kMaxStringLength] = {0};
+  if (Sys::pread_(fd_, value, sizeof(value) - 1, 0) <= 0) {
+    DLOGE("Failed to read panel brightness");
+    return kErrorHardware;
+  }
+
+  *level = atoi(value);
+  return kErrorNone;
+}
+
+DisplayError HWBrightnessEngine::SetTarget(int level, uint32_t duration_ms, int64_t now_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  DisplayError error = OpenNode();
+  if (error != kErrorNone) {
+    return error;
+  }
+
+  level = std::min(level, max_level_);
+  if (!duration_ms) {
+    ramping_ = false;
+    return WriteLevel(level);
+  }
+
+  // Other clients of the node, e.g. thermal mitigation, may have moved the backlight since the
+  // last write, so the ramp starts from what the panel shows now.
+  int current_level = 0;
+  error = ReadLevel(&current_level);
+  if (error != kErrorNone) {
+    return error;
+  }
+  written_level_ = current_level;
+
+  if (level == written_level_) {
+    ramping_ = false;
+    return WriteLevel(level);
+  }
+
+  start_level_ = written_level_;
+  target_level_ = level;
+  start_ns_ = now_ns;
+  duration_ns_ = int64_t(duration_ms) * 1000000LL;
+  ramping_ = true;
+  DLOGI_IF(kTagDriverConfig, "Ramp %d -> %d over %u ms", start_level_, target_level_,
+           duration_ms);
+
+  return kErrorNone;
+}
+
+bool HWBrightnessEngine::Latch(int64_t timestamp_ns, bool vsync) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  if (!ramping_ || fd_ < 0) {
+    return false;
+  }
+
+  if (vsync && hold_for_commit_) {
+    return true;
+  }
+  hold_for_commit_ = vsync ? hold_for_commit_ : false;
+
+  float t = 1.0f;
+  if (timestamp_ns < start_ns_ + duration_ns_) {
+    t = static_cast<float>(std::max(int64_t(0), timestamp_ns - start_ns_)) /
+        static_cast<float>(duration_ns_);
+  }
+
+  int level = target_level_;
+  if (t < 1.0f) {
+    float from = ToPerceptual(start_level_);
+    float to = ToPerceptual(target_level_);
+    level = FromPerceptual(from + (to - from) * t);
+    // Only the final step may turn the backlight off.
+    level = std::max(level, 1);
+  } else {
+    ramping_ = false;
+  }
+
+  if (level != written_level_ && WriteLevel(level) != kErrorNone) {
+    ramping_ = false;
+  }
+
+  return ramping_;
+}
+
+void HWBrightnessEngine::HoldForCommit() {
+  std::lock_guard<std::mutex> lock(lock_);
+  hold_for_commit_ = ramping_;
+}
+
+void HWBrightnessEngine::Cancel() {
+  std::lock_guard<std::mutex> lock(lock_);
+  ramping_ = false;
+  hold_for_commit_ = false;
+}
+
+DisplayError HWBrightnessEngine::GetLevel(int *level) {
+  std::lock_guard<std::mutex> lock(lock_);
+
+  DisplayError error = OpenNode();
+  if (error != kErrorNone) {
+    return error;
+  }
+
+  return ReadLevel(level);
+}
+
+bool HWBrightnessEngine::IsRamping() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return ramping_;
+}
+
+}  // namespace sdm
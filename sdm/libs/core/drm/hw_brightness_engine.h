@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2020, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_BRIGHTNESS_ENGINE_H__
+#define __HW_BRIGHTNESS_ENGINE_H__
+
+#include <core/sdm_types.h>
+#include <stdint.h>
+#include <mutex>
+#include <string>
+
+namespace sdm {
+
+// Drives the panel backlight node. The node stays open for the life of the display, and ramps
+// step through perceptually uniform levels: a gamma 2.2 curve maps levels to perceived lightness,
+// which is interpolated linearly in time. Ramp steps are only written from Latch(), which the
+// device calls right after a commit and on vsync, so a step lands on the same frame as the
+// content committed with it.
+class HWBrightnessEngine {
+ public:
+  ~HWBrightnessEngine() { Deinit(); }
+  DisplayError Init(const std::string &node, int max_level);
+  void Deinit();
+
+  // Starts a transition from the level the node reads back now. A zero duration writes the level
+  // right away.
+  DisplayError SetTarget(int level, uint32_t duration_ms, int64_t now_ns);
+  // Writes the ramp level due at timestamp_ns. Vsync latches are skipped while the next commit
+  // carries a backlight scale change, so the scale and the brightness step land together.
+  // Returns true while the ramp still has steps to write.
+  bool Latch(int64_t timestamp_ns, bool vsync);
+  // Marks that the next commit carries a backlight scale change.
+  void HoldForCommit();
+  // Stops a ramp where it is, e.g. when the panel powers off.
+  void Cancel();
+  DisplayError GetLevel(int *level);
+  bool IsRamping();
+
+  static int64_t Now();
+
+ private:
+  static const int kMaxSysfsCommandLength = 12;
+  static const int kMaxStringLength = 16;
+
+  float ToPerceptual(int level) const;
+  int FromPerceptual(float perceptual) const;
+  DisplayError OpenNode();
+  DisplayError ReadLevel(int *level);
+  DisplayError WriteLevel(int level);
+
+  std::mutex lock_;
+  std::string node_;
+  int fd_ = -1;
+  int max_level_ = 0;
+  int written_level_ = -1;
+  int start_level_ = 0;
+  int target_level_ = 0;
+  int64_t start_ns_ = 0;
+  int64_t duration_ns_ = 0;
+  bool ramping_ = false;
+  bool hold_for_commit_ = false;
+};
+
+}  // namespace sdm
+
+#endif  // __HW_BRIGHTNESS_ENGINE_H__
@@ -0,0 +1,233 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <utils/sys.h>
+#include <string>
+#include <vector>
+
+#include "hw_brightness_engine.h"
+
+using namespace sdm;
+
+namespace {
+
+const int kMaxLevel = 255;
+const int64_t kStartNs = 1000000000LL;
+const int64_t kVsyncNs = 16666667LL;
+
+// Stores all but the last byte, like a sysfs node that rejected part of the value.
+ssize_t ShortPwrite(int fd, const void *buf, size_t count, off_t offset) {
+  return pwrite(fd, buf, count - 1, offset);
+}
+
+// A regular file stands in for the sysfs backlight node. Like sysfs, it is read back from offset
+// 0 and rewritten in place.
+class HWBrightnessEngineTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_NE(nullptr, mkdtemp(dir_));
+    node_ = std::string(dir_) + "/brightness";
+  }
+
+  void TearDown() override {
+    engine_.Deinit();
+    unlink(node_.c_str());
+    rmdir(dir_);
+  }
+
+  // Writes the node the way another client would, padded so that no stale digits remain.
+  void SetNode(int level) {
+    FILE *file = fopen(node_.c_str(), "w");
+    ASSERT_NE(nullptr, file);
+    fprintf(file, "%d\n      ", level);
+    fclose(file);
+  }
+
+  int ReadNode() {
+    char value[16] = {0};
+    FILE *file = fopen(node_.c_str(), "r");
+    if (!file) {
+      return -1;
+    }
+    size_t read = fread(value, 1, sizeof(value) - 1, file);
+    fclose(file);
+    return read ? atoi(value) : -1;
+  }
+
+  // Latches on every vsync from start_ns until the ramp is done and returns the levels the node
+  // held after each one.
+  std::vector<int> RunVsyncs(int64_t start_ns, size_t max_vsyncs = 1000) {
+    std::vector<int> levels;
+    for (int64_t t = start_ns; levels.size() < max_vsyncs; t += kVsyncNs) {
+      bool pending = engine_.Latch(t, true);
+      levels.push_back(ReadNode());
+      if (!pending) {
+        break;
+      }
+    }
+    return levels;
+  }
+
+  char dir_[32] = "/tmp/hw_brightness_XXXXXX";
+  std::string node_;
+  HWBrightnessEngine engine_;
+};
+
+}  // namespace
+
+TEST_F(HWBrightnessEngineTest, ZeroDurationWritesRightAway) {
+  SetNode(10);
+  ASSERT_EQ(kErrorNone, engine_.Init(node_, kMaxLevel));
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(200, 0, kStartNs));
+  EXPECT_EQ(200, ReadNode());
+  EXPECT_FALSE(engine_.IsRamping());
+  EXPECT_FALSE(engine_.Latch(kStartNs, true));
+
+  int level = 0;
+  ASSERT_EQ(kErrorNone, engine_.GetLevel(&level));
+  EXPECT_EQ(200, level);
+}
+
+TEST_F(HWBrightnessEngineTest, ZeroDurationClampsToMaxLevel) {
+  SetNode(10);
+  ASSERT_EQ(kErrorNone, engine_.Init(node_, kMaxLevel));
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(kMaxLevel + 100, 0, kStartNs));
+  EXPECT_EQ(kMaxLevel, ReadNode());
+}
+
+TEST_F(HWBrightnessEngineTest, ShortWriteFails) {
+  SetNode(10);
+  ASSERT_EQ(kErrorNone, engine_.Init(node_, kMaxLevel));
+  Sys::pwrite saved_pwrite = Sys::pwrite_;
+  Sys::pwrite_ = ShortPwrite;
+  DisplayError error = engine_.SetTarget(200, 0, kStartNs);
+  Sys::pwrite_ = saved_pwrite;
+  EXPECT_EQ(kErrorHardware, error);
+}
+
+TEST_F(HWBrightnessEngineTest, RampStepsOnVsyncAndEndsAtTarget) {
+  SetNode(20);
+  ASSERT_EQ(kErrorNone, engine_.Init(node_, kMaxLevel));
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(230, 200, kStartNs));
+  // Nothing is written before the first latch.
+  EXPECT_EQ(20, ReadNode());
+
+  std::vector<int> levels = RunVsyncs(kStartNs + kVsyncNs);
+  // 200 ms at 60 Hz, the last latch lands on or after the end of the ramp.
+  EXPECT_GE(levels.size(), 12u);
+  EXPECT_LE(levels.size(), 13u);
+  EXPECT_EQ(230, levels.back());
+  for (size_t i = 1; i < levels.size(); i++) {
+    EXPECT_GE(levels[i], levels[i - 1]) << "vsync " << i;
+  }
+  EXPECT_FALSE(engine_.IsRamping());
+}
+
+TEST_F(HWBrightnessEngineTest, RampIsEvenInPerceivedLightness) {
+  SetNode(0);
+  ASSERT_EQ(kErrorNone, engine_.Init(node_, kMaxLevel));
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(kMaxLevel, 1000, kStartNs));
+
+  // Half way through, perceived lightness is half way, which is about a fifth of the levels.
+  engine_.Latch(kStartNs + 500000000LL, true);
+  EXPECT_NEAR(56, ReadNode(), 2);
+}
+
+TEST_F(HWBrightnessEngineTest, OnlyFinalStepTurnsBacklightOff) {
+  SetNode(40);
+  ASSERT_EQ(kErrorNone, engine_.Init(node_, kMaxLevel));
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(0, 100, kStartNs));
+
+  std::vector<int> levels = RunVsyncs(kStartNs + kVsyncNs);
+  ASSERT_GE(levels.size(), 2u);
+  for (size_t i = 0; i + 1 < levels.size(); i++) {
+    EXPECT_GE(levels[i], 1) << "vsync " << i;
+  }
+  EXPECT_EQ(0, levels.back());
+}
+
+TEST_F(HWBrightnessEngineTest, RampStartsFromLevelSetByOtherClient) {
+  SetNode(100);
+  ASSERT_EQ(kErrorNone, engine_.Init(node_, kMaxLevel));
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(100, 0, kStartNs));
+
+  // Thermal mitigation lowers the backlight behind the engine's back.
+  SetNode(10);
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(200, 100, kStartNs));
+  engine_.Latch(kStartNs + kVsyncNs, true);
+  int first_step = ReadNode();
+  EXPECT_GT(first_step, 10);
+  EXPECT_LT(first_step, 100);
+
+  // A target equal to what the node shows is written without a ramp.
+  SetNode(50);
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(50, 100, kStartNs));
+  EXPECT_FALSE(engine_.IsRamping());
+  EXPECT_EQ(50, ReadNode());
+}
+
+TEST_F(HWBrightnessEngineTest, VsyncWaitsForCommitCarryingScale) {
+  SetNode(0);
+  ASSERT_EQ(kErrorNone, engine_.Init(node_, kMaxLevel));
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(kMaxLevel, 100, kStartNs));
+  engine_.HoldForCommit();
+
+  // Vsyncs keep the ramp pending without stepping it.
+  EXPECT_TRUE(engine_.Latch(kStartNs + kVsyncNs, true));
+  EXPECT_TRUE(engine_.Latch(kStartNs + 2 * kVsyncNs, true));
+  EXPECT_EQ(0, ReadNode());
+
+  // The commit writes the step due by then, later vsyncs step again.
+  EXPECT_TRUE(engine_.Latch(kStartNs + 2 * kVsyncNs + 1000000LL, false));
+  int after_commit = ReadNode();
+  EXPECT_GT(after_commit, 0);
+  EXPECT_TRUE(engine_.Latch(kStartNs + 3 * kVsyncNs, true));
+  EXPECT_GT(ReadNode(), after_commit);
+}
+
+TEST_F(HWBrightnessEngineTest, CancelStopsRampWhereItIs) {
+  SetNode(0);
+  ASSERT_EQ(kErrorNone, engine_.Init(node_, kMaxLevel));
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(kMaxLevel, 100, kStartNs));
+  engine_.Latch(kStartNs + 3 * kVsyncNs, true);
+  int level = ReadNode();
+
+  engine_.Cancel();
+  EXPECT_FALSE(engine_.IsRamping());
+  EXPECT_FALSE(engine_.Latch(kStartNs + 10 * kVsyncNs, true));
+  EXPECT_EQ(level, ReadNode());
+}
+
+TEST_F(HWBrightnessEngineTest, OpensNodeRegisteredLater) {
+  EXPECT_NE(kErrorNone, engine_.Init(node_, kMaxLevel));
+  EXPECT_NE(kErrorNone, engine_.SetTarget(100, 0, kStartNs));
+
+  SetNode(0);
+  ASSERT_EQ(kErrorNone, engine_.SetTarget(100, 0, kStartNs));
+  EXPECT_EQ(100, ReadNode());
+}
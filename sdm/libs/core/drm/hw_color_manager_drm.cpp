@@ -32,12 +32,14 @@
 #include <array>
 #include <map>
 #include <cstring>
+#include <new>
 #include <vector>
 
 #ifdef PP_DRM_ENABLE
 #include <drm/msm_drm_pp.h>
 #endif
 #include <utils/debug.h>
+#include <utils/hash.h>
 #include "hw_color_manager_drm.h"
 
 #ifdef PP_DRM_ENABLE
@@ -84,6 +86,35 @@ static const uint32_t kSourceFeatureV5 = 5;
 
 namespace sdm {
 
+#ifdef PP_DRM_ENABLE
+// LUT conversions run over whole tables on every update. They are kept as flat loops over
+// non-aliasing arrays so the compiler can vectorize them.
+static void ConvertIgcLut(const uint32_t *__restrict c0_c1, const uint32_t *__restrict c2,
+                          uint32_t *__restrict out_c0, uint32_t *__restrict out_c1,
+                          uint32_t *__restrict out_c2) {
+  for (int i = 0; i < IGC_TBL_LEN; i++) {
+    out_c0[i] = c0_c1[i] & kIgcDataMask;
+    out_c1[i] = (c0_c1[i] >> kIgcShift) & kIgcDataMask;
+    out_c2[i] = c2[i] & kIgcDataMask;
+  }
+}
+
+// Packs two consecutive PGC entries into each output word.
+static void PackPgcLut(const uint32_t *__restrict in, uint32_t *__restrict out) {
+  for (int i = 0; i < PGC_TBL_LEN; i++) {
+    out[i] = (in[2 * i] & kPgcDataMask) | (in[2 * i + 1] & kPgcDataMask) << kPgcShift;
+  }
+}
+
+static void InterleaveGamutRow(const uint32_t *__restrict c0, const uint32_t *__restrict c1_c2,
+                               uint32_t size, drm_msm_3d_col *__restrict out) {
+  for (uint32_t col = 0; col < size; col++) {
+    out[col].c0 = c0[col];
+    out[col].c2_c1 = c1_c2[col];
+  }
+}
+#endif
+
 typedef std::map<uint32_t, std::vector<DRMPPFeatureID>> DrmPPFeatureMap;
 
 static const DrmPPFeatureMap g_dspp_map = {
@@ -117,7 +148,7 @@ static const std::array<const DrmPPFeatureMap *,
   {&g_dspp_map, &g_vig_map, &g_dgm_map}
 };
 
-DisplayError (*HWColorManagerDrm::pp_features_[])(const PPFeatureInfo &,
+DisplayError (*HWColorManagerDrm::pp_features_[])(const PPFeatureInfo &, void *,
                                                     DRMPPFeatureInfo *) = {
   [kFeaturePcc] = &HWColorManagerDrm::GetDrmPCC,
   [kFeatureIgc] = &HWColorManagerDrm::GetDrmIGC,
@@ -228,8 +259,28 @@ DisplayError HWColorManagerDrm::GetDrmFeature(PPFeatureInfo *in_data,
     in_data->enable_flags_ = kOpsDisable;
   }
 
-  if (pp_features_[out_data->id])
-    ret = pp_features_[out_data->id](*in_data, out_data);
+  if (pp_features_[out_data->id]) {
+    DRMPPFeatureID id = out_data->id;
+    Converted &converted = converted_[id];
+    uint64_t input_hash = 0;
+    bool hashed = HashInput(id, *in_data, &input_hash);
+    if (hashed && converted.valid && converted.input_hash == input_hash) {
+      /* Unchanged input, the slot still holds the payload of the last conversion. The payload is
+       * byte identical, so the DRM blob cache keeps its blob instead of creating a new one. */
+      uint32_t object_type = out_data->object_type;
+      *out_data = converted.output;
+      out_data->object_type = object_type;
+      ret = kErrorNone;
+    } else {
+      ret = pp_features_[id](*in_data, GetPayloadSlot(id), out_data);
+      if (ret != kErrorNone) {
+        out_data->payload = NULL;
+      }
+      converted.valid = hashed && (ret == kErrorNone);
+      converted.input_hash = input_hash;
+      converted.output = *out_data;
+    }
+  }
 
 
   /* Restore the original enable_flags_ */
@@ -241,94 +292,227 @@ DisplayError HWColorManagerDrm::GetDrmFeature(PPFeatureInfo *in_data,
 }
 
 void HWColorManagerDrm::FreeDrmFeatureData(DRMPPFeatureInfo *feature) {
-  if (feature && feature->payload) {
+  /* Payload lives in the feature's slot, which is reused by the next GetDrmFeature */
+  if (feature) {
+    feature->payload = nullptr;
+  }
+}
+
+size_t HWColorManagerDrm::GetPayloadSize(DRMPPFeatureID id) {
+  size_t size = 0;
+
+  switch (id) {
 #ifdef PP_DRM_ENABLE
-    void *ptr = feature->payload;
+    case kFeaturePcc:
+      size = sizeof(drm_msm_pcc);
+      break;
+    case kFeatureIgc:
+    case kFeatureDgmIgc:
+    case kFeatureVigIgc:
+      size = sizeof(drm_msm_igc_lut);
+      break;
+    case kFeaturePgc:
+    case kFeatureDgmGc:
+      size = sizeof(drm_msm_pgc_lut);
+      break;
+    case kFeatureDither:
+      size = sizeof(drm_msm_dither);
+      break;
+    case kFeatureGamut:
+    case kFeatureVigGamut:
+      size = sizeof(drm_msm_3d_gamut);
+      break;
+#ifdef DRM_MSM_PA_DITHER
+    case kFeaturePADither:
+      size = sizeof(drm_msm_pa_dither);
+      break;
 #endif
+#ifdef DRM_MSM_PA_HSIC
+    case kFeaturePAHsic:
+      size = sizeof(drm_msm_pa_hsic);
+      break;
+#endif
+#ifdef DRM_MSM_SIXZONE
+    case kFeaturePASixZone:
+      size = sizeof(drm_msm_sixzone);
+      break;
+#endif
+#ifdef DRM_MSM_MEMCOL
+    case kFeaturePAMemColSkin:
+    case kFeaturePAMemColSky:
+    case kFeaturePAMemColFoliage:
+    case kFeaturePAMemColProt:
+      size = sizeof(drm_msm_memcol);
+      break;
+#endif
+#endif
+    default:
+      break;
+  }
+
+  return size;
+}
+
+void *HWColorManagerDrm::GetPayloadSlot(DRMPPFeatureID id) {
+  std::vector<uint64_t> &slot = payload_slots_[id];
+  if (slot.empty()) {
+    size_t size = GetPayloadSize(id);
+    if (!size) {
+      return NULL;
+    }
+    slot.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+  }
+
+  return slot.data();
+}
 
-    switch (feature->id) {
-      case kFeaturePcc: {
 #ifdef PP_DRM_ENABLE
-        drm_msm_pcc *pcc = reinterpret_cast<drm_msm_pcc *>(ptr);
-        delete pcc;
+static uint64_t HashMemColor(const SDEPaMemColorData &memcol, uint64_t hash) {
+  hash = HashValue(memcol.adjust_p0, hash);
+  hash = HashValue(memcol.adjust_p1, hash);
+  hash = HashValue(memcol.adjust_p2, hash);
+  hash = HashValue(memcol.blend_gain, hash);
+  hash = HashValue(memcol.sat_hold, hash);
+  hash = HashValue(memcol.val_hold, hash);
+  hash = HashValue(memcol.hue_region, hash);
+  hash = HashValue(memcol.sat_region, hash);
+  return HashValue(memcol.val_region, hash);
+}
 #endif
-        break;
-      }
-      case kFeatureIgc:
-      case kFeatureDgmIgc:
-      case kFeatureVigIgc: {
+
+// Hashes everything the conversion of feature id reads from in_data, field by field so that
+// padding and table addresses do not take part. Returns false for input that is always converted.
+bool HWColorManagerDrm::HashInput(DRMPPFeatureID id, const PPFeatureInfo &in_data,
+                                  uint64_t *hash) {
+  uint64_t value = HashValue(id);
+  value = HashValue(in_data.enable_flags_, value);
+  value = HashValue(in_data.feature_version_, value);
+  if (in_data.enable_flags_ & kOpsDisable) {
+    /* Disable does not read the config */
+    *hash = value;
+    return true;
+  }
+
+  bool hashed = false;
 #ifdef PP_DRM_ENABLE
-        drm_msm_igc_lut *igc = reinterpret_cast<drm_msm_igc_lut *>(ptr);
-        delete igc;
-#endif
-        break;
+  const void *config = in_data.GetConfigData();
+  if (!config) {
+    return false;
+  }
+
+  switch (id) {
+    case kFeaturePcc:
+      if (in_data.feature_version_ == PPFeatureVersion::kSDEPccV4) {
+        value = HashValue(*static_cast<const SDEPccV4Cfg *>(config), value);
+        hashed = true;
       }
-      case kFeaturePgc:
-      case kFeatureDgmGc: {
-#ifdef PP_DRM_ENABLE
-        drm_msm_pgc_lut *pgc = reinterpret_cast<drm_msm_pgc_lut *>(ptr);
-        delete pgc;
-#endif
-        break;
+      break;
+    case kFeatureIgc:
+    case kFeatureDgmIgc:
+    case kFeatureVigIgc: {
+      const SDEIgcV30LUTData *igc = static_cast<const SDEIgcV30LUTData *>(config);
+      bool supported = in_data.feature_version_ == PPFeatureVersion::kSDEIgcV30 ||
+                       in_data.feature_version_ == kSourceFeatureV5;
+      if (supported && igc->c0_c1_data && igc->c2_data) {
+        value = HashValue(igc->strength, value);
+        value = HashWords(reinterpret_cast<const uint32_t *>(igc->c0_c1_data), IGC_TBL_LEN, value);
+        value = HashWords(reinterpret_cast<const uint32_t *>(igc->c2_data), IGC_TBL_LEN, value);
+        hashed = true;
       }
-      case kFeatureDither: {
-#ifdef PP_DRM_ENABLE
-        drm_msm_dither *dither = reinterpret_cast<drm_msm_dither *>(ptr);
-        delete dither;
-#endif
-        break;
+      break;
+    }
+    case kFeaturePgc:
+    case kFeatureDgmGc: {
+      const SDEPgcLUTData *pgc = static_cast<const SDEPgcLUTData *>(config);
+      if (pgc->c0_data && pgc->c1_data && pgc->c2_data) {
+        value = HashWords(pgc->c0_data, 2 * PGC_TBL_LEN, value);
+        value = HashWords(pgc->c1_data, 2 * PGC_TBL_LEN, value);
+        value = HashWords(pgc->c2_data, 2 * PGC_TBL_LEN, value);
+        hashed = true;
       }
-      case kFeatureGamut:
-      case kFeatureVigGamut: {
-#ifdef PP_DRM_ENABLE
-        drm_msm_3d_gamut *gamut = reinterpret_cast<drm_msm_3d_gamut *>(ptr);
-        delete gamut;
-#endif
-        break;
+      break;
+    }
+    case kFeatureDither:
+      value = HashValue(*static_cast<const SDEDitherCfg *>(config), value);
+      hashed = true;
+      break;
+    case kFeatureGamut:
+    case kFeatureVigGamut: {
+      const SDEGamutCfg *gamut = static_cast<const SDEGamutCfg *>(config);
+      uint32_t size = 0;
+      switch (gamut->mode) {
+        case SDEGamutCfgWrapper::GAMUT_FINE_MODE: size = GAMUT_3D_MODE17_TBL_SZ; break;
+        case SDEGamutCfgWrapper::GAMUT_COARSE_MODE: size = GAMUT_3D_MODE5_TBL_SZ; break;
+        case SDEGamutCfgWrapper::GAMUT_COARSE_MODE_13: size = GAMUT_3D_MODE13_TBL_SZ; break;
+        default: return false;
       }
-      case kFeaturePADither: {
-#if defined(PP_DRM_ENABLE) && defined(DRM_MSM_PA_DITHER)
-        drm_msm_pa_dither *pa_dither = reinterpret_cast<drm_msm_pa_dither *>(ptr);
-        delete pa_dither;
-#endif
-        break;
+      value = HashValue(gamut->mode, value);
+      value = HashValue(gamut->map_en, value);
+      for (uint32_t i = 0; gamut->map_en && i < GAMUT_3D_SCALE_OFF_TBL_NUM; i++) {
+        value = HashWords(gamut->scale_off_data[i], GAMUT_3D_SCALE_OFF_SZ, value);
       }
-      case kFeaturePAHsic: {
-#if defined(PP_DRM_ENABLE) && defined(DRM_MSM_PA_HSIC)
-        drm_msm_pa_hsic *hsic = reinterpret_cast<drm_msm_pa_hsic *>(ptr);
-        delete hsic;
-#endif
-        break;
+      for (uint32_t row = 0; row < GAMUT_3D_TBL_NUM; row++) {
+        value = HashWords(gamut->c0_data[row], size, value);
+        value = HashWords(gamut->c1_c2_data[row], size, value);
       }
-      case kFeaturePASixZone: {
-#if defined(PP_DRM_ENABLE) && defined(DRM_MSM_SIXZONE)
-        drm_msm_sixzone *sixzone = reinterpret_cast<drm_msm_sixzone *>(ptr);
-        delete sixzone;
-#endif
-        break;
+      hashed = true;
+      break;
+    }
+#ifdef DRM_MSM_PA_DITHER
+    case kFeaturePADither: {
+      const SDEPADitherData *dither = static_cast<const SDEPADitherData *>(config);
+      if (dither->matrix_size == DITHER_MATRIX_SZ && dither->matrix_data_addr) {
+        value = HashValue(dither->strength, value);
+        value = HashValue(dither->offset_en, value);
+        value = HashWords(reinterpret_cast<const uint32_t *>(dither->matrix_data_addr),
+                          DITHER_MATRIX_SZ, value);
+        hashed = true;
       }
-      case kFeaturePAMemColSkin:
-      case kFeaturePAMemColSky:
-      case kFeaturePAMemColFoliage:
-      case kFeaturePAMemColProt: {
-#if defined(PP_DRM_ENABLE) && defined(DRM_MSM_MEMCOL)
-        drm_msm_memcol *memcol = reinterpret_cast<drm_msm_memcol *>(ptr);
-        delete memcol;
+      break;
+    }
 #endif
-        break;
-      }
-      case kFeatureMixerGc:
-      case kFeaturePaV2:
-      default: {
-        DLOGE("Invalid feature: %d\n", feature->id);
-        return;
+    case kFeaturePAHsic:
+    case kFeaturePASixZone:
+    case kFeaturePAMemColSkin:
+    case kFeaturePAMemColSky:
+    case kFeaturePAMemColFoliage:
+    case kFeaturePAMemColProt: {
+      /* Each PA feature reads a part of the same config, any change converts all of them */
+      const SDEPaData *pa = static_cast<const SDEPaData *>(config);
+      value = HashValue(pa->mode, value);
+      value = HashValue(pa->hue_adj, value);
+      value = HashValue(pa->sat_adj, value);
+      value = HashValue(pa->val_adj, value);
+      value = HashValue(pa->cont_adj, value);
+      value = HashMemColor(pa->skin, value);
+      value = HashMemColor(pa->sky, value);
+      value = HashMemColor(pa->foliage, value);
+      value = HashValue(pa->six_zone_thresh, value);
+      value = HashValue(pa->six_zone_adj_p0, value);
+      value = HashValue(pa->six_zone_adj_p1, value);
+      value = HashValue(pa->six_zone_sat_hold, value);
+      value = HashValue(pa->six_zone_val_hold, value);
+      value = HashValue(pa->six_zone_len, value);
+#ifdef DRM_MSM_SIXZONE
+      if (pa->six_zone_len == SIXZONE_LUT_SIZE && pa->six_zone_curve_p0 &&
+          pa->six_zone_curve_p1) {
+        value = HashWords(pa->six_zone_curve_p0, SIXZONE_LUT_SIZE, value);
+        value = HashWords(pa->six_zone_curve_p1, SIXZONE_LUT_SIZE, value);
       }
+#endif
+      hashed = true;
+      break;
     }
-    feature->payload = nullptr;
+    default:
+      break;
   }
+#endif
+
+  *hash = value;
+  return hashed;
 }
 
-DisplayError HWColorManagerDrm::GetDrmPCC(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmPCC(const PPFeatureInfo &in_data, void *slot,
                                           DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #ifdef PP_DRM_ENABLE
@@ -360,11 +544,7 @@ DisplayError HWColorManagerDrm::GetDrmPCC(const PPFeatureInfo &in_data,
     return kErrorParameters;
   }
 
-  mdp_pcc = new drm_msm_pcc();
-  if (!mdp_pcc) {
-    DLOGE("Failed to allocate memory for pcc");
-    return kErrorMemory;
-  }
+  mdp_pcc = new (slot) drm_msm_pcc();
 
   mdp_pcc->flags = 0;
 
@@ -406,7 +586,7 @@ DisplayError HWColorManagerDrm::GetDrmPCC(const PPFeatureInfo &in_data,
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmIGC(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmIGC(const PPFeatureInfo &in_data, void *slot,
                                           DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #ifdef PP_DRM_ENABLE
@@ -438,11 +618,7 @@ DisplayError HWColorManagerDrm::GetDrmIGC(const PPFeatureInfo &in_data,
     return kErrorParameters;
   }
 
-  mdp_igc = new drm_msm_igc_lut();
-  if (!mdp_igc) {
-    DLOGE("Failed to allocate memory for igc");
-    return kErrorMemory;
-  }
+  mdp_igc = new (slot) drm_msm_igc_lut();
 
   mdp_igc->flags = IGC_DITHER_ENABLE;
   mdp_igc->strength = sde_igc->strength;
@@ -452,22 +628,17 @@ DisplayError HWColorManagerDrm::GetDrmIGC(const PPFeatureInfo &in_data,
 
   if (!c0_c1_data_ptr || !c2_data_ptr) {
     DLOGE("Invaid igc data pointer");
-    delete mdp_igc;
     out_data->payload = NULL;
     return kErrorParameters;
   }
 
-  for (int i = 0; i < IGC_TBL_LEN; i++) {
-    mdp_igc->c0[i] = c0_c1_data_ptr[i] & kIgcDataMask;
-    mdp_igc->c1[i] = (c0_c1_data_ptr[i] >> kIgcShift) & kIgcDataMask;
-    mdp_igc->c2[i] = c2_data_ptr[i] & kIgcDataMask;
-  }
+  ConvertIgcLut(c0_c1_data_ptr, c2_data_ptr, mdp_igc->c0, mdp_igc->c1, mdp_igc->c2);
   out_data->payload = mdp_igc;
 #endif
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmPGC(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmPGC(const PPFeatureInfo &in_data, void *slot,
                                           DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #ifdef PP_DRM_ENABLE
@@ -489,28 +660,19 @@ DisplayError HWColorManagerDrm::GetDrmPGC(const PPFeatureInfo &in_data,
     return kErrorParameters;
   }
 
-  mdp_pgc = new drm_msm_pgc_lut();
-  if (!mdp_pgc) {
-    DLOGE("Failed to allocate memory for pgc");
-    return kErrorMemory;
-  }
+  mdp_pgc = new (slot) drm_msm_pgc_lut();
 
   mdp_pgc->flags = 0;
 
-  for (int i = 0, j = 0; i < PGC_TBL_LEN; i++, j += 2) {
-    mdp_pgc->c0[i] = (sde_pgc->c0_data[j] & kPgcDataMask) |
-        (sde_pgc->c0_data[j + 1] & kPgcDataMask) << kPgcShift;
-    mdp_pgc->c1[i] = (sde_pgc->c1_data[j] & kPgcDataMask) |
-        (sde_pgc->c1_data[j + 1] & kPgcDataMask) << kPgcShift;
-    mdp_pgc->c2[i] = (sde_pgc->c2_data[j] & kPgcDataMask) |
-        (sde_pgc->c2_data[j + 1] & kPgcDataMask) << kPgcShift;
-  }
+  PackPgcLut(sde_pgc->c0_data, mdp_pgc->c0);
+  PackPgcLut(sde_pgc->c1_data, mdp_pgc->c1);
+  PackPgcLut(sde_pgc->c2_data, mdp_pgc->c2);
   out_data->payload = mdp_pgc;
 #endif
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmMixerGC(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmMixerGC(const PPFeatureInfo &in_data, void *slot,
                                               DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #ifdef PP_DRM_ENABLE
@@ -521,8 +683,8 @@ DisplayError HWColorManagerDrm::GetDrmMixerGC(const PPFeatureInfo &in_data,
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmPAHsic(const PPFeatureInfo &in_data,
-                                           DRMPPFeatureInfo *out_data) {
+DisplayError HWColorManagerDrm::GetDrmPAHsic(const PPFeatureInfo &in_data, void *slot,
+                                             DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #if defined(PP_DRM_ENABLE) && defined(DRM_MSM_PA_HSIC)
   struct SDEPaData *sde_pa;
@@ -549,11 +711,7 @@ DisplayError HWColorManagerDrm::GetDrmPAHsic(const PPFeatureInfo &in_data,
     return ret;
   }
 
-  mdp_hsic = new drm_msm_pa_hsic();
-  if (!mdp_hsic) {
-    DLOGE("Failed to allocate memory for pa hsic");
-    return kErrorMemory;
-  }
+  mdp_hsic = new (slot) drm_msm_pa_hsic();
 
   mdp_hsic->flags = 0;
 
@@ -579,14 +737,13 @@ DisplayError HWColorManagerDrm::GetDrmPAHsic(const PPFeatureInfo &in_data,
     out_data->payload_size = sizeof(struct drm_msm_pa_hsic);
   } else {
     /* PA HSIC configuration unchanged, no better return code available */
-    delete mdp_hsic;
     ret = kErrorPermission;
   }
 #endif
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmPASixZone(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmPASixZone(const PPFeatureInfo &in_data, void *slot,
                                                 DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #if defined(PP_DRM_ENABLE) && defined(DRM_MSM_SIXZONE)
@@ -622,11 +779,7 @@ DisplayError HWColorManagerDrm::GetDrmPASixZone(const PPFeatureInfo &in_data,
         return kErrorParameters;
     }
 
-    mdp_sixzone = new drm_msm_sixzone();
-    if (!mdp_sixzone) {
-      DLOGE("Failed to allocate memory for six zone");
-      return kErrorMemory;
-    }
+    mdp_sixzone = new (slot) drm_msm_sixzone();
 
     mdp_sixzone->flags = 0;
 
@@ -661,7 +814,7 @@ DisplayError HWColorManagerDrm::GetDrmPASixZone(const PPFeatureInfo &in_data,
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmPAMemColSkin(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmPAMemColSkin(const PPFeatureInfo &in_data, void *slot,
                                                    DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #if defined(PP_DRM_ENABLE) && defined(DRM_MSM_MEMCOL)
@@ -691,11 +844,7 @@ DisplayError HWColorManagerDrm::GetDrmPAMemColSkin(const PPFeatureInfo &in_data,
     struct drm_msm_memcol *mdp_memcol = NULL;
     struct SDEPaMemColorData *pa_memcol = &sde_pa->skin;
 
-    mdp_memcol = new drm_msm_memcol();
-    if (!mdp_memcol) {
-      DLOGE("Failed to allocate memory for memory color skin");
-      return kErrorMemory;
-    }
+    mdp_memcol = new (slot) drm_msm_memcol();
 
     mdp_memcol->prot_flags = 0;
     mdp_memcol->color_adjust_p0 = pa_memcol->adjust_p0;
@@ -718,7 +867,7 @@ DisplayError HWColorManagerDrm::GetDrmPAMemColSkin(const PPFeatureInfo &in_data,
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmPAMemColSky(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmPAMemColSky(const PPFeatureInfo &in_data, void *slot,
                                                   DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #if defined(PP_DRM_ENABLE) && defined(DRM_MSM_MEMCOL)
@@ -748,11 +897,7 @@ DisplayError HWColorManagerDrm::GetDrmPAMemColSky(const PPFeatureInfo &in_data,
     struct drm_msm_memcol *mdp_memcol = NULL;
     struct SDEPaMemColorData *pa_memcol = &sde_pa->sky;
 
-    mdp_memcol = new drm_msm_memcol();
-    if (!mdp_memcol) {
-      DLOGE("Failed to allocate memory for memory color sky");
-      return kErrorMemory;
-    }
+    mdp_memcol = new (slot) drm_msm_memcol();
 
     mdp_memcol->prot_flags = 0;
     mdp_memcol->color_adjust_p0 = pa_memcol->adjust_p0;
@@ -775,7 +920,7 @@ DisplayError HWColorManagerDrm::GetDrmPAMemColSky(const PPFeatureInfo &in_data,
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmPAMemColFoliage(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmPAMemColFoliage(const PPFeatureInfo &in_data, void *slot,
                                                       DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #if defined(PP_DRM_ENABLE) && defined(DRM_MSM_MEMCOL)
@@ -805,11 +950,7 @@ DisplayError HWColorManagerDrm::GetDrmPAMemColFoliage(const PPFeatureInfo &in_da
     struct drm_msm_memcol *mdp_memcol = NULL;
     struct SDEPaMemColorData *pa_memcol = &sde_pa->foliage;
 
-    mdp_memcol = new drm_msm_memcol();
-    if (!mdp_memcol) {
-      DLOGE("Failed to allocate memory for memory color foliage");
-      return kErrorMemory;
-    }
+    mdp_memcol = new (slot) drm_msm_memcol();
 
     mdp_memcol->prot_flags = 0;
     mdp_memcol->color_adjust_p0 = pa_memcol->adjust_p0;
@@ -832,7 +973,7 @@ DisplayError HWColorManagerDrm::GetDrmPAMemColFoliage(const PPFeatureInfo &in_da
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmPAMemColProt(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmPAMemColProt(const PPFeatureInfo &in_data, void *slot,
                                                    DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #if defined(PP_DRM_ENABLE) && defined(DRM_MSM_MEMCOL)
@@ -860,11 +1001,7 @@ DisplayError HWColorManagerDrm::GetDrmPAMemColProt(const PPFeatureInfo &in_data,
     return ret;
   }
 
-  mdp_memcol = new drm_msm_memcol();
-  if (!mdp_memcol) {
-    DLOGE("Failed to allocate memory for memory color prot");
-    return kErrorMemory;
-  }
+  mdp_memcol = new (slot) drm_msm_memcol();
 
   mdp_memcol->prot_flags = 0;
 
@@ -878,7 +1015,7 @@ DisplayError HWColorManagerDrm::GetDrmPAMemColProt(const PPFeatureInfo &in_data,
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmDither(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmDither(const PPFeatureInfo &in_data, void *slot,
                                              DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #ifdef PP_DRM_ENABLE
@@ -898,11 +1035,7 @@ DisplayError HWColorManagerDrm::GetDrmDither(const PPFeatureInfo &in_data,
     return kErrorParameters;
   }
 
-  mdp_dither = new drm_msm_dither();
-  if (!mdp_dither) {
-    DLOGE("Failed to allocate memory for dither");
-    return kErrorMemory;
-  }
+  mdp_dither = new (slot) drm_msm_dither();
 
   mdp_dither->flags = 0;
   std::memcpy(mdp_dither->matrix, sde_dither->dither_matrix,
@@ -917,7 +1050,7 @@ DisplayError HWColorManagerDrm::GetDrmDither(const PPFeatureInfo &in_data,
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmGamut(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmGamut(const PPFeatureInfo &in_data, void *slot,
                                             DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #ifdef PP_DRM_ENABLE
@@ -939,11 +1072,7 @@ DisplayError HWColorManagerDrm::GetDrmGamut(const PPFeatureInfo &in_data,
     return kErrorParameters;
   }
 
-  mdp_gamut = new drm_msm_3d_gamut();
-  if (!mdp_gamut) {
-    DLOGE("Failed to allocate memory for gamut");
-    return kErrorMemory;
-  }
+  mdp_gamut = new (slot) drm_msm_3d_gamut();
 
   if (sde_gamut->map_en)
     mdp_gamut->flags = GAMUT_3D_MAP_EN;
@@ -965,7 +1094,6 @@ DisplayError HWColorManagerDrm::GetDrmGamut(const PPFeatureInfo &in_data,
       break;
     default:
       DLOGE("Invalid gamut mode %d", sde_gamut->mode);
-      delete mdp_gamut;
       return kErrorParameters;
   }
 
@@ -979,17 +1107,15 @@ DisplayError HWColorManagerDrm::GetDrmGamut(const PPFeatureInfo &in_data,
   }
 
   for (uint32_t row = 0; row < GAMUT_3D_TBL_NUM; row++) {
-    for (uint32_t col = 0; col < size; col++) {
-      mdp_gamut->col[row][col].c0 = sde_gamut->c0_data[row][col];
-      mdp_gamut->col[row][col].c2_c1 = sde_gamut->c1_c2_data[row][col];
-    }
+    InterleaveGamutRow(sde_gamut->c0_data[row], sde_gamut->c1_c2_data[row], size,
+                       mdp_gamut->col[row]);
   }
   out_data->payload = mdp_gamut;
 #endif
   return ret;
 }
 
-DisplayError HWColorManagerDrm::GetDrmPADither(const PPFeatureInfo &in_data,
+DisplayError HWColorManagerDrm::GetDrmPADither(const PPFeatureInfo &in_data, void *slot,
                                                DRMPPFeatureInfo *out_data) {
   DisplayError ret = kErrorNone;
 #if defined(PP_DRM_ENABLE) && defined(DRM_MSM_PA_DITHER)
@@ -1016,11 +1142,7 @@ DisplayError HWColorManagerDrm::GetDrmPADither(const PPFeatureInfo &in_data,
     return kErrorParameters;
   }
 
-  mdp_dither = new drm_msm_pa_dither();
-  if (!mdp_dither) {
-    DLOGE("Failed to allocate memory for dither");
-    return kErrorMemory;
-  }
+  mdp_dither = new (slot) drm_msm_pa_dither();
 
   mdp_dither->flags = 0;
   mdp_dither->strength = sde_dither->strength;
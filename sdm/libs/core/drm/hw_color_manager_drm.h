@@ -80,23 +80,50 @@ class HWColorManagerDrm {
   ~HWColorManagerDrm() {}
 
  private:
-  static DisplayError GetDrmPCC(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmIGC(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmPGC(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmMixerGC(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmDither(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmGamut(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmPADither(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmPAHsic(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmPASixZone(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmPAMemColSkin(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmPAMemColSky(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmPAMemColFoliage(const PPFeatureInfo &in_data,
+  static DisplayError GetDrmPCC(const PPFeatureInfo &in_data, void *slot,
+                                DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmIGC(const PPFeatureInfo &in_data, void *slot,
+                                DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmPGC(const PPFeatureInfo &in_data, void *slot,
+                                DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmMixerGC(const PPFeatureInfo &in_data, void *slot,
+                                    DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmDither(const PPFeatureInfo &in_data, void *slot,
+                                   DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmGamut(const PPFeatureInfo &in_data, void *slot,
+                                  DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmPADither(const PPFeatureInfo &in_data, void *slot,
+                                     DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmPAHsic(const PPFeatureInfo &in_data, void *slot,
+                                   DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmPASixZone(const PPFeatureInfo &in_data, void *slot,
+                                      DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmPAMemColSkin(const PPFeatureInfo &in_data, void *slot,
+                                         DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmPAMemColSky(const PPFeatureInfo &in_data, void *slot,
+                                        DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmPAMemColFoliage(const PPFeatureInfo &in_data, void *slot,
                                             DRMPPFeatureInfo *out_data);
-  static DisplayError GetDrmPAMemColProt(const PPFeatureInfo &in_data, DRMPPFeatureInfo *out_data);
+  static DisplayError GetDrmPAMemColProt(const PPFeatureInfo &in_data, void *slot,
+                                         DRMPPFeatureInfo *out_data);
 
-  static DisplayError (*pp_features_[kPPFeaturesMax])(const PPFeatureInfo &in_data,
+  static DisplayError (*pp_features_[kPPFeaturesMax])(const PPFeatureInfo &in_data, void *slot,
                                                       DRMPPFeatureInfo *out_data);
+  static size_t GetPayloadSize(DRMPPFeatureID id);
+  static bool HashInput(DRMPPFeatureID id, const PPFeatureInfo &in_data, uint64_t *hash);
+  void *GetPayloadSlot(DRMPPFeatureID id);
+
+  // Output of the last successful conversion of a feature, valid while its slot is not rewritten.
+  struct Converted {
+    bool valid = false;
+    uint64_t input_hash = 0;
+    DRMPPFeatureInfo output = {};
+  };
+
+  // Payload buffers reused across commits, allocated on first use of each feature. The kernel
+  // copies the payload when its blob is created, so one buffer per feature id is enough.
+  std::vector<uint64_t> payload_slots_[kPPFeaturesMax];
+  Converted converted_[kPPFeaturesMax];
 };
 
 }  // namespace sdm
@@ -0,0 +1,476 @@
+/*
+* Copyright (c) 2021, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <drm/msm_drm_pp.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "hw_color_manager_drm.h"
+
+using namespace sdm;
+
+namespace {
+
+// Version of the source (plane) color features.
+const uint32_t kSourceFeatureV5 = 5;
+
+// Payload of one conversion, compared byte for byte.
+struct Payload {
+  DisplayError error = kErrorNone;
+  uint32_t size = 0;
+  std::vector<uint8_t> bytes;
+};
+
+bool operator==(const Payload &a, const Payload &b) {
+  return a.error == b.error && a.size == b.size && a.bytes == b.bytes;
+}
+
+// The kernel structs were heap allocated and value initialized before the payload slots.
+template <class T>
+Payload ReferencePayload(const std::unique_ptr<T> &payload) {
+  Payload reference;
+  reference.size = sizeof(T);
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(payload.get());
+  reference.bytes.assign(bytes, bytes + sizeof(T));
+  return reference;
+}
+
+template <class T>
+class TestFeature : public PPFeatureInfo {
+ public:
+  explicit TestFeature(uint32_t version) {
+    enable_flags_ = kOpsEnable;
+    feature_version_ = version;
+  }
+  void *GetConfigData(void) const { return const_cast<T *>(&config); }
+
+  T config = {};
+};
+
+std::vector<uint32_t> RandomTable(size_t size, uint32_t seed) {
+  std::vector<uint32_t> table(size);
+  for (auto &value : table) {
+    seed = seed * 1664525 + 1013904223;
+    value = seed;
+  }
+  return table;
+}
+
+Payload Convert(HWColorManagerDrm *color_mgr, DRMPPFeatureID id, PPFeatureInfo *in_data,
+                bool force_disable = false) {
+  DRMPPFeatureInfo out_data = {};
+  out_data.id = id;
+  Payload payload;
+  payload.error = color_mgr->GetDrmFeature(in_data, &out_data, force_disable);
+  payload.size = out_data.payload_size;
+  if (out_data.payload) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(out_data.payload);
+    payload.bytes.assign(bytes, bytes + out_data.payload_size);
+  }
+  color_mgr->FreeDrmFeatureData(&out_data);
+  return payload;
+}
+
+// Converts the feature, again unchanged, changed, force disabled and enabled again, and compares
+// every payload with the reference conversion of the same input.
+void CheckFeature(DRMPPFeatureID id, PPFeatureInfo *in_data,
+                  const std::function<Payload()> &reference, const std::function<void()> &change,
+                  uint32_t disabled_size) {
+  SCOPED_TRACE(testing::Message() << "feature " << id);
+  HWColorManagerDrm color_mgr;
+  Payload first = reference();
+  EXPECT_EQ(kErrorNone, first.error);
+  EXPECT_FALSE(first.bytes.empty());
+  EXPECT_TRUE(first == Convert(&color_mgr, id, in_data));
+  EXPECT_TRUE(first == Convert(&color_mgr, id, in_data));
+
+  change();
+  Payload changed = reference();
+  EXPECT_FALSE(first == changed);
+  EXPECT_TRUE(changed == Convert(&color_mgr, id, in_data));
+
+  Payload disabled;
+  disabled.size = disabled_size;
+  EXPECT_TRUE(disabled == Convert(&color_mgr, id, in_data, true));
+  EXPECT_TRUE(changed == Convert(&color_mgr, id, in_data));
+}
+
+Payload ReferencePcc(const SDEPccV4Cfg &sde_pcc) {
+  std::unique_ptr<drm_msm_pcc> mdp_pcc(new drm_msm_pcc());
+  const SDEPccV4Coeff *sde_coeffs[] = {&sde_pcc.red, &sde_pcc.green, &sde_pcc.blue};
+  drm_msm_pcc_coeff *mdp_coeffs[] = {&mdp_pcc->r, &mdp_pcc->g, &mdp_pcc->b};
+  for (int i = 0; i < 3; i++) {
+    mdp_coeffs[i]->c = sde_coeffs[i]->c;
+    mdp_coeffs[i]->r = sde_coeffs[i]->r;
+    mdp_coeffs[i]->g = sde_coeffs[i]->g;
+    mdp_coeffs[i]->b = sde_coeffs[i]->b;
+    mdp_coeffs[i]->rg = sde_coeffs[i]->rg;
+    mdp_coeffs[i]->gb = sde_coeffs[i]->gb;
+    mdp_coeffs[i]->rb = sde_coeffs[i]->rb;
+    mdp_coeffs[i]->rgb = sde_coeffs[i]->rgb;
+  }
+  mdp_pcc->r_rr = sde_pcc.red.rr;
+  mdp_pcc->r_gg = sde_pcc.red.gg;
+  mdp_pcc->r_bb = sde_pcc.red.bb;
+  mdp_pcc->g_rr = sde_pcc.green.rr;
+  mdp_pcc->g_gg = sde_pcc.green.gg;
+  mdp_pcc->g_bb = sde_pcc.green.bb;
+  mdp_pcc->b_rr = sde_pcc.blue.rr;
+  mdp_pcc->b_gg = sde_pcc.blue.gg;
+  mdp_pcc->b_bb = sde_pcc.blue.bb;
+  return ReferencePayload(mdp_pcc);
+}
+
+Payload ReferenceIgc(const SDEIgcV30LUTData &sde_igc) {
+  std::unique_ptr<drm_msm_igc_lut> mdp_igc(new drm_msm_igc_lut());
+  const uint32_t *c0_c1 = reinterpret_cast<const uint32_t *>(sde_igc.c0_c1_data);
+  const uint32_t *c2 = reinterpret_cast<const uint32_t *>(sde_igc.c2_data);
+  mdp_igc->flags = IGC_DITHER_ENABLE;
+  mdp_igc->strength = sde_igc.strength;
+  for (int i = 0; i < IGC_TBL_LEN; i++) {
+    mdp_igc->c0[i] = c0_c1[i] & 0xFFF;
+    mdp_igc->c1[i] = (c0_c1[i] >> 16) & 0xFFF;
+    mdp_igc->c2[i] = c2[i] & 0xFFF;
+  }
+  return ReferencePayload(mdp_igc);
+}
+
+Payload ReferencePgc(const SDEPgcLUTData &sde_pgc) {
+  std::unique_ptr<drm_msm_pgc_lut> mdp_pgc(new drm_msm_pgc_lut());
+  for (int i = 0, j = 0; i < PGC_TBL_LEN; i++, j += 2) {
+    mdp_pgc->c0[i] = (sde_pgc.c0_data[j] & 0x3FF) | (sde_pgc.c0_data[j + 1] & 0x3FF) << 16;
+    mdp_pgc->c1[i] = (sde_pgc.c1_data[j] & 0x3FF) | (sde_pgc.c1_data[j + 1] & 0x3FF) << 16;
+    mdp_pgc->c2[i] = (sde_pgc.c2_data[j] & 0x3FF) | (sde_pgc.c2_data[j + 1] & 0x3FF) << 16;
+  }
+  return ReferencePayload(mdp_pgc);
+}
+
+Payload ReferenceDither(const SDEDitherCfg &sde_dither) {
+  std::unique_ptr<drm_msm_dither> mdp_dither(new drm_msm_dither());
+  memcpy(mdp_dither->matrix, sde_dither.dither_matrix, sizeof(sde_dither.dither_matrix));
+  mdp_dither->temporal_en = sde_dither.temporal_en;
+  mdp_dither->c0_bitdepth = sde_dither.g_y_depth;
+  mdp_dither->c1_bitdepth = sde_dither.b_cb_depth;
+  mdp_dither->c2_bitdepth = sde_dither.r_cr_depth;
+  return ReferencePayload(mdp_dither);
+}
+
+Payload ReferenceGamut(const SDEGamutCfg &sde_gamut) {
+  std::unique_ptr<drm_msm_3d_gamut> mdp_gamut(new drm_msm_3d_gamut());
+  uint32_t size = 0;
+  mdp_gamut->flags = sde_gamut.map_en ? GAMUT_3D_MAP_EN : 0;
+  switch (sde_gamut.mode) {
+    case SDEGamutCfgWrapper::GAMUT_FINE_MODE:
+      mdp_gamut->mode = GAMUT_3D_MODE_17;
+      size = GAMUT_3D_MODE17_TBL_SZ;
+      break;
+    case SDEGamutCfgWrapper::GAMUT_COARSE_MODE:
+      mdp_gamut->mode = GAMUT_3D_MODE_5;
+      size = GAMUT_3D_MODE5_TBL_SZ;
+      break;
+    default:
+      mdp_gamut->mode = GAMUT_3D_MODE_13;
+      size = GAMUT_3D_MODE13_TBL_SZ;
+      break;
+  }
+  for (int i = 0; sde_gamut.map_en && i < GAMUT_3D_SCALE_OFF_TBL_NUM; i++) {
+    memcpy(mdp_gamut->scale_off[i], sde_gamut.scale_off_data[i],
+           sizeof(uint32_t) * GAMUT_3D_SCALE_OFF_SZ);
+  }
+  for (uint32_t row = 0; row < GAMUT_3D_TBL_NUM; row++) {
+    for (uint32_t col = 0; col < size; col++) {
+      mdp_gamut->col[row][col].c0 = sde_gamut.c0_data[row][col];
+      mdp_gamut->col[row][col].c2_c1 = sde_gamut.c1_c2_data[row][col];
+    }
+  }
+  return ReferencePayload(mdp_gamut);
+}
+
+Payload ReferencePADither(const SDEPADitherData &sde_dither) {
+  std::unique_ptr<drm_msm_pa_dither> mdp_dither(new drm_msm_pa_dither());
+  mdp_dither->strength = sde_dither.strength;
+  mdp_dither->offset_en = sde_dither.offset_en;
+  memcpy(mdp_dither->matrix, reinterpret_cast<void *>(sde_dither.matrix_data_addr),
+         sizeof(uint32_t) * DITHER_MATRIX_SZ);
+  return ReferencePayload(mdp_dither);
+}
+
+Payload ReferencePAHsic(const SDEPaData &sde_pa) {
+  std::unique_ptr<drm_msm_pa_hsic> mdp_hsic(new drm_msm_pa_hsic());
+  mdp_hsic->flags = PA_HSIC_HUE_ENABLE | PA_HSIC_SAT_ENABLE | PA_HSIC_VAL_ENABLE |
+                    PA_HSIC_CONT_ENABLE;
+  mdp_hsic->hue = sde_pa.hue_adj;
+  mdp_hsic->saturation = sde_pa.sat_adj;
+  mdp_hsic->value = sde_pa.val_adj;
+  mdp_hsic->contrast = sde_pa.cont_adj;
+  return ReferencePayload(mdp_hsic);
+}
+
+Payload ReferencePASixZone(const SDEPaData &sde_pa) {
+  std::unique_ptr<drm_msm_sixzone> mdp_sixzone(new drm_msm_sixzone());
+  mdp_sixzone->flags = SIXZONE_HUE_ENABLE | SIXZONE_SAT_ENABLE | SIXZONE_VAL_ENABLE;
+  mdp_sixzone->threshold = sde_pa.six_zone_thresh;
+  mdp_sixzone->adjust_p0 = sde_pa.six_zone_adj_p0;
+  mdp_sixzone->adjust_p1 = sde_pa.six_zone_adj_p1;
+  mdp_sixzone->sat_hold = sde_pa.six_zone_sat_hold;
+  mdp_sixzone->val_hold = sde_pa.six_zone_val_hold;
+  for (int i = 0; i < SIXZONE_LUT_SIZE; i++) {
+    mdp_sixzone->curve[i].p0 = sde_pa.six_zone_curve_p0[i] & 0x0FFF;
+    mdp_sixzone->curve[i].p1 = sde_pa.six_zone_curve_p1[i] & 0x0FFF0FFF;
+  }
+  return ReferencePayload(mdp_sixzone);
+}
+
+Payload ReferencePAMemColor(const SDEPaMemColorData &pa_memcol) {
+  std::unique_ptr<drm_msm_memcol> mdp_memcol(new drm_msm_memcol());
+  mdp_memcol->color_adjust_p0 = pa_memcol.adjust_p0;
+  mdp_memcol->color_adjust_p1 = pa_memcol.adjust_p1;
+  mdp_memcol->color_adjust_p2 = pa_memcol.adjust_p2;
+  mdp_memcol->blend_gain = pa_memcol.blend_gain;
+  mdp_memcol->sat_hold = pa_memcol.sat_hold;
+  mdp_memcol->val_hold = pa_memcol.val_hold;
+  mdp_memcol->hue_region = pa_memcol.hue_region;
+  mdp_memcol->sat_region = pa_memcol.sat_region;
+  mdp_memcol->val_region = pa_memcol.val_region;
+  return ReferencePayload(mdp_memcol);
+}
+
+Payload ReferencePAMemColProt(const SDEPaData &sde_pa) {
+  std::unique_ptr<drm_msm_memcol> mdp_memcol(new drm_msm_memcol());
+  mdp_memcol->prot_flags = sde_pa.mode & 0x3F;
+  return ReferencePayload(mdp_memcol);
+}
+
+void FillMemColor(uint32_t seed, SDEPaMemColorData *memcol) {
+  std::vector<uint32_t> values = RandomTable(9, seed);
+  memcol->adjust_p0 = values[0];
+  memcol->adjust_p1 = values[1];
+  memcol->adjust_p2 = values[2];
+  memcol->blend_gain = values[3];
+  memcol->sat_hold = static_cast<uint8_t>(values[4]);
+  memcol->val_hold = static_cast<uint8_t>(values[5]);
+  memcol->hue_region = values[6];
+  memcol->sat_region = values[7];
+  memcol->val_region = values[8];
+}
+
+// All of PA enabled: HSIC (bits 12-15), six zone (16-18), memory colors (19-21), protection (0-5).
+class PAFeature : public TestFeature<SDEPaData> {
+ public:
+  PAFeature()
+    : TestFeature<SDEPaData>(PPFeatureVersion::kSDEPaV17),
+      curve_p0_(RandomTable(SIXZONE_LUT_SIZE, 11)), curve_p1_(RandomTable(SIXZONE_LUT_SIZE, 12)) {
+    enable_flags_ = kOpsEnable | kPaHueEnable | kPaSatEnable | kPaValEnable | kPaContEnable |
+                    kPaSixZoneEnable | kPaSkinEnable | kPaSkyEnable | kPaFoliageEnable;
+    config.mode = 0x3FF03F;
+    config.hue_adj = 10;
+    config.sat_adj = 20;
+    config.val_adj = 30;
+    config.cont_adj = 40;
+    FillMemColor(1, &config.skin);
+    FillMemColor(2, &config.sky);
+    FillMemColor(3, &config.foliage);
+    config.six_zone_thresh = 50;
+    config.six_zone_adj_p0 = 60;
+    config.six_zone_adj_p1 = 70;
+    config.six_zone_sat_hold = 8;
+    config.six_zone_val_hold = 9;
+    config.six_zone_len = SIXZONE_LUT_SIZE;
+    config.six_zone_curve_p0 = curve_p0_.data();
+    config.six_zone_curve_p1 = curve_p1_.data();
+  }
+
+  std::vector<uint32_t> curve_p0_;
+  std::vector<uint32_t> curve_p1_;
+};
+
+}  // namespace
+
+TEST(HWColorManagerDrmTest, Pcc) {
+  TestFeature<SDEPccV4Cfg> pcc(PPFeatureVersion::kSDEPccV4);
+  SDEPccV4Coeff *coeffs[] = {&pcc.config.red, &pcc.config.green, &pcc.config.blue};
+  for (uint32_t i = 0; i < 3; i++) {
+    std::vector<uint32_t> values = RandomTable(11, i + 1);
+    *coeffs[i] = {values[0], values[1], values[2], values[3], values[4], values[5], values[6],
+                  values[7], values[8], values[9], values[10]};
+  }
+  CheckFeature(kFeaturePcc, &pcc, [&] { return ReferencePcc(pcc.config); },
+               [&] { pcc.config.green.rb++; }, sizeof(drm_msm_pcc));
+}
+
+TEST(HWColorManagerDrmTest, Igc) {
+  for (DRMPPFeatureID id : {kFeatureIgc, kFeatureDgmIgc, kFeatureVigIgc}) {
+    TestFeature<SDEIgcV30LUTData> igc(PPFeatureVersion::kSDEIgcV30);
+    std::vector<uint32_t> c0_c1 = RandomTable(IGC_TBL_LEN, 2);
+    std::vector<uint32_t> c2 = RandomTable(IGC_TBL_LEN, 3);
+    igc.config.c0_c1_data = reinterpret_cast<uint64_t>(c0_c1.data());
+    igc.config.c2_data = reinterpret_cast<uint64_t>(c2.data());
+    igc.config.strength = 4;
+    CheckFeature(id, &igc, [&] { return ReferenceIgc(igc.config); },
+                 [&] { c2[IGC_TBL_LEN - 1] ^= 1; }, sizeof(drm_msm_igc_lut));
+  }
+}
+
+TEST(HWColorManagerDrmTest, Pgc) {
+  for (DRMPPFeatureID id : {kFeaturePgc, kFeatureDgmGc}) {
+    TestFeature<SDEPgcLUTData> pgc(PPFeatureVersion::kSDEPgcV17);
+    std::vector<uint32_t> c0 = RandomTable(2 * PGC_TBL_LEN, 4);
+    std::vector<uint32_t> c1 = RandomTable(2 * PGC_TBL_LEN, 5);
+    std::vector<uint32_t> c2 = RandomTable(2 * PGC_TBL_LEN, 6);
+    pgc.config.c0_data = c0.data();
+    pgc.config.c1_data = c1.data();
+    pgc.config.c2_data = c2.data();
+    CheckFeature(id, &pgc, [&] { return ReferencePgc(pgc.config); }, [&] { c1[1] ^= 1; },
+                 sizeof(drm_msm_pgc_lut));
+  }
+}
+
+TEST(HWColorManagerDrmTest, Dither) {
+  TestFeature<SDEDitherCfg> dither(PPFeatureVersion::kSDEDitherV17);
+  std::vector<uint32_t> matrix = RandomTable(16, 7);
+  memcpy(dither.config.dither_matrix, matrix.data(), sizeof(dither.config.dither_matrix));
+  dither.config.g_y_depth = 6;
+  dither.config.r_cr_depth = 5;
+  dither.config.b_cb_depth = 4;
+  dither.config.temporal_en = 1;
+  CheckFeature(kFeatureDither, &dither, [&] { return ReferenceDither(dither.config); },
+               [&] { dither.config.dither_matrix[15]++; }, sizeof(drm_msm_dither));
+}
+
+TEST(HWColorManagerDrmTest, Gamut) {
+  const uint32_t modes[] = {SDEGamutCfgWrapper::GAMUT_FINE_MODE,
+                            SDEGamutCfgWrapper::GAMUT_COARSE_MODE,
+                            SDEGamutCfgWrapper::GAMUT_COARSE_MODE_13};
+  for (DRMPPFeatureID id : {kFeatureGamut, kFeatureVigGamut}) {
+    for (uint32_t mode : modes) {
+      for (uint32_t map_en : {0, 1}) {
+        TestFeature<SDEGamutCfg> gamut(PPFeatureVersion::kSDEGamutV4);
+        std::vector<std::vector<uint32_t>> tables;
+        for (uint32_t i = 0; i < 2 * GAMUT_3D_TBL_NUM + GAMUT_3D_SCALE_OFF_TBL_NUM; i++) {
+          tables.push_back(RandomTable(GAMUT_3D_MODE17_TBL_SZ, 8 + i));
+        }
+        gamut.config.mode = mode;
+        gamut.config.map_en = map_en;
+        for (uint32_t i = 0; i < GAMUT_3D_TBL_NUM; i++) {
+          gamut.config.c0_data[i] = tables[i].data();
+          gamut.config.c1_c2_data[i] = tables[GAMUT_3D_TBL_NUM + i].data();
+        }
+        for (uint32_t i = 0; i < GAMUT_3D_SCALE_OFF_TBL_NUM; i++) {
+          gamut.config.scale_off_data[i] = tables[2 * GAMUT_3D_TBL_NUM + i].data();
+        }
+        std::function<void()> change = [&] { tables[3][0] ^= 1; };
+        if (map_en) {
+          change = [&] { tables.back()[0] ^= 1; };
+        }
+        CheckFeature(id, &gamut, [&] { return ReferenceGamut(gamut.config); }, change,
+                     sizeof(drm_msm_3d_gamut));
+      }
+    }
+  }
+}
+
+TEST(HWColorManagerDrmTest, PADither) {
+  TestFeature<SDEPADitherData> dither(PPFeatureVersion::kSDEPADitherV17);
+  std::vector<uint32_t> matrix = RandomTable(DITHER_MATRIX_SZ, 9);
+  dither.config.matrix_size = DITHER_MATRIX_SZ;
+  dither.config.matrix_data_addr = reinterpret_cast<uint64_t>(matrix.data());
+  dither.config.strength = 3;
+  dither.config.offset_en = 1;
+  CheckFeature(kFeaturePADither, &dither, [&] { return ReferencePADither(dither.config); },
+               [&] { matrix[7]++; }, sizeof(drm_msm_pa_dither));
+}
+
+TEST(HWColorManagerDrmTest, PA) {
+  PAFeature pa;
+  CheckFeature(kFeaturePAHsic, &pa, [&] { return ReferencePAHsic(pa.config); },
+               [&] { pa.config.cont_adj++; }, 0);
+  CheckFeature(kFeaturePASixZone, &pa, [&] { return ReferencePASixZone(pa.config); },
+               [&] { pa.curve_p1_[SIXZONE_LUT_SIZE - 1] ^= 1; }, 0);
+  CheckFeature(kFeaturePAMemColSkin, &pa, [&] { return ReferencePAMemColor(pa.config.skin); },
+               [&] { pa.config.skin.sat_hold++; }, 0);
+  CheckFeature(kFeaturePAMemColSky, &pa, [&] { return ReferencePAMemColor(pa.config.sky); },
+               [&] { pa.config.sky.val_region++; }, 0);
+  CheckFeature(kFeaturePAMemColFoliage, &pa,
+               [&] { return ReferencePAMemColor(pa.config.foliage); },
+               [&] { pa.config.foliage.hue_region++; }, 0);
+  CheckFeature(kFeaturePAMemColProt, &pa, [&] { return ReferencePAMemColProt(pa.config); },
+               [&] { pa.config.mode ^= 1; }, sizeof(drm_msm_memcol));
+}
+
+// The slot is not written again for unchanged input, so a mark left in it survives.
+TEST(HWColorManagerDrmTest, UnchangedInputSkipsConversion) {
+  HWColorManagerDrm color_mgr;
+  TestFeature<SDEPccV4Cfg> pcc(PPFeatureVersion::kSDEPccV4);
+  DRMPPFeatureInfo out_data = {};
+  out_data.id = kFeaturePcc;
+  ASSERT_EQ(kErrorNone, color_mgr.GetDrmFeature(&pcc, &out_data));
+  ASSERT_NE(nullptr, out_data.payload);
+  drm_msm_pcc *payload = static_cast<drm_msm_pcc *>(out_data.payload);
+  payload->flags = 0xdead;
+
+  ASSERT_EQ(kErrorNone, color_mgr.GetDrmFeature(&pcc, &out_data));
+  EXPECT_EQ(payload, out_data.payload);
+  EXPECT_EQ(0xdeadu, payload->flags);
+
+  pcc.config.red.c = 1;
+  ASSERT_EQ(kErrorNone, color_mgr.GetDrmFeature(&pcc, &out_data));
+  EXPECT_EQ(0u, payload->flags);
+  EXPECT_EQ(1u, payload->r.c);
+}
+
+// Plane features of all pipes share one slot, each conversion follows its own input.
+TEST(HWColorManagerDrmTest, PipesSharingASlot) {
+  HWColorManagerDrm color_mgr;
+  TestFeature<SDEIgcV30LUTData> igc[2] = {TestFeature<SDEIgcV30LUTData>(kSourceFeatureV5),
+                                          TestFeature<SDEIgcV30LUTData>(kSourceFeatureV5)};
+  std::vector<uint32_t> tables[2] = {RandomTable(IGC_TBL_LEN, 10), RandomTable(IGC_TBL_LEN, 11)};
+  for (int i = 0; i < 2; i++) {
+    igc[i].config.c0_c1_data = reinterpret_cast<uint64_t>(tables[i].data());
+    igc[i].config.c2_data = reinterpret_cast<uint64_t>(tables[i].data());
+  }
+  for (int i = 0; i < 6; i++) {
+    EXPECT_TRUE(ReferenceIgc(igc[i % 2].config) ==
+                Convert(&color_mgr, kFeatureVigIgc, &igc[i % 2]));
+  }
+}
+
+TEST(HWColorManagerDrmTest, InvalidInputIsNotCached) {
+  HWColorManagerDrm color_mgr;
+  TestFeature<SDEIgcV30LUTData> igc(PPFeatureVersion::kSDEIgcV30);
+  std::vector<uint32_t> table = RandomTable(IGC_TBL_LEN, 12);
+  igc.config.c0_c1_data = reinterpret_cast<uint64_t>(table.data());
+  EXPECT_EQ(kErrorParameters, Convert(&color_mgr, kFeatureIgc, &igc).error);
+  EXPECT_EQ(kErrorParameters, Convert(&color_mgr, kFeatureIgc, &igc).error);
+
+  igc.config.c2_data = reinterpret_cast<uint64_t>(table.data());
+  EXPECT_TRUE(ReferenceIgc(igc.config) == Convert(&color_mgr, kFeatureIgc, &igc));
+  igc.enable_flags_ = 0;
+  EXPECT_EQ(kErrorParameters, Convert(&color_mgr, kFeatureIgc, &igc).error);
+  igc.enable_flags_ = kOpsEnable;
+  EXPECT_TRUE(ReferenceIgc(igc.config) == Convert(&color_mgr, kFeatureIgc, &igc));
+}
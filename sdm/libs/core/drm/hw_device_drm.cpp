@@ -48,6 +48,7 @@
 #include <utils/constants.h>
 #include <utils/debug.h>
 #include <utils/formats.h>
+#include <utils/frame_trace.h>
 #include <utils/sys.h>
 #include <drm/sde_drm.h>
 #include <private/color_params.h>
@@ -501,6 +502,7 @@ DisplayError HWDeviceDRM::Init() {
 
   hw_info_intf_->GetHWResourceInfo(&hw_resource_);
 
+  BuildModeIndex();
   InitializeConfigs();
   PopulateHWPanelInfo();
   UpdateMixerAttributes();
@@ -581,6 +583,12 @@ void HWDeviceDRM::InitializeConfigs() {
   SetDisplaySwitchMode(current_mode_index_);
 }
 
+void HWDeviceDRM::BuildModeIndex() {
+  mode_index_.Build(connector_info_.modes);
+  DLOGI("Indexed %d modes into %zu groups for %s", mode_index_.GetModeCount(),
+        mode_index_.GetGroupCount(), device_name_);
+}
+
 DisplayError HWDeviceDRM::PopulateDisplayAttributes(uint32_t index) {
   drmModeModeInfo mode = {};
   uint32_t mm_width = 0;
@@ -687,22 +695,9 @@ void HWDeviceDRM::PopulateHWPanelInfo() {
   hw_panel_info_.dynamic_fps = connector_info_.dynamic_fps;
   hw_panel_info_.qsync_support = connector_info_.qsync_support;
   drmModeModeInfo current_mode = connector_info_.modes[current_mode_index_].mode;
-  if (hw_panel_info_.dynamic_fps) {
-    uint32_t min_fps = current_mode.vrefresh;
-    uint32_t max_fps = current_mode.vrefresh;
-    for (uint32_t mode_index = 0; mode_index < connector_info_.modes.size(); mode_index++) {
-      if ((current_mode.vdisplay == connector_info_.modes[mode_index].mode.vdisplay) &&
-          (current_mode.hdisplay == connector_info_.modes[mode_index].mode.hdisplay)) {
-        if (min_fps > connector_info_.modes[mode_index].mode.vrefresh)  {
-          min_fps = connector_info_.modes[mode_index].mode.vrefresh;
-        }
-        if (max_fps < connector_info_.modes[mode_index].mode.vrefresh)  {
-          max_fps = connector_info_.modes[mode_index].mode.vrefresh;
-        }
-      }
-    }
-    hw_panel_info_.min_fps = min_fps;
-    hw_panel_info_.max_fps = max_fps;
+  if (hw_panel_info_.dynamic_fps && (current_mode_index_ < mode_index_.GetModeCount())) {
+    mode_index_.GetFpsRange(current_mode_index_, &hw_panel_info_.min_fps,
+                            &hw_panel_info_.max_fps);
   } else {
     hw_panel_info_.min_fps = current_mode.vrefresh;
     hw_panel_info_.max_fps = current_mode.vrefresh;
@@ -853,18 +848,14 @@ DisplayError HWDeviceDRM::GetHWPanelInfo(HWPanelInfo *panel_info) {
 
 void HWDeviceDRM::SetDisplaySwitchMode(uint32_t index) {
   uint32_t mode_flag = 0;
-  uint32_t curr_mode_flag = 0, switch_mode_flag = 0;
+  uint32_t curr_mode_flag = 0;
   drmModeModeInfo to_set = connector_info_.modes[index].mode;
   drmModeModeInfo current_mode = connector_info_.modes[current_mode_index_].mode;
-  uint64_t current_bit_clk = connector_info_.modes[current_mode_index_].bit_clk_rate;
-  uint32_t switch_index  = 0;
 
   if (to_set.flags & DRM_MODE_FLAG_CMD_MODE_PANEL) {
     mode_flag = DRM_MODE_FLAG_CMD_MODE_PANEL;
-    switch_mode_flag = DRM_MODE_FLAG_VID_MODE_PANEL;
   } else if (to_set.flags & DRM_MODE_FLAG_VID_MODE_PANEL) {
     mode_flag = DRM_MODE_FLAG_VID_MODE_PANEL;
-    switch_mode_flag = DRM_MODE_FLAG_CMD_MODE_PANEL;
   }
 
   if (current_mode.flags & DRM_MODE_FLAG_CMD_MODE_PANEL) {
@@ -877,47 +868,19 @@ void HWDeviceDRM::SetDisplaySwitchMode(uint32_t index) {
     panel_mode_changed_ = mode_flag;
   }
 
-  for (uint32_t mode_index = 0; mode_index < connector_info_.modes.size(); mode_index++) {
-    if ((to_set.vdisplay == connector_info_.modes[mode_index].mode.vdisplay) &&
-        (to_set.hdisplay == connector_info_.modes[mode_index].mode.hdisplay) &&
-        (to_set.vrefresh == connector_info_.modes[mode_index].mode.vrefresh) &&
-        (current_bit_clk == connector_info_.modes[mode_index].bit_clk_rate) &&
-        (mode_flag & connector_info_.modes[mode_index].mode.flags)) {
-      index = mode_index;
-      break;
-    }
+  // Of the modes with the requested timing, take the one that is cheapest to switch to.
+  mode_transition_ = mode_index_.GetTransition(current_mode_index_, index);
+  if (mode_flag) {
+    index = mode_index_.PlanSwitch(current_mode_index_, index, &mode_transition_);
   }
 
   current_mode_index_ = index;
 
+  uint32_t switch_index = 0;
   switch_mode_valid_ = false;
-  for (uint32_t mode_index = 0; mode_index < connector_info_.modes.size(); mode_index++) {
-    if ((to_set.vdisplay == connector_info_.modes[mode_index].mode.vdisplay) &&
-        (to_set.hdisplay == connector_info_.modes[mode_index].mode.hdisplay) &&
-        (to_set.vrefresh == connector_info_.modes[mode_index].mode.vrefresh) &&
-        (switch_mode_flag & connector_info_.modes[mode_index].mode.flags)) {
-      switch_index = mode_index;
-      switch_mode_valid_ = true;
-      break;
-    }
-  }
-
-  if (!switch_mode_valid_) {
-    // in case there is no corresponding switch mode with same fps, try for a switch
-    // mode with lowest fps. This is to handle cases where there are multiple video mode fps
-    // but only one command mode for doze like 30 fps.
-    uint32_t refresh_rate = 0;
-    for (uint32_t mode_index = 0; mode_index < connector_info_.modes.size(); mode_index++) {
-      if ((to_set.vdisplay == connector_info_.modes[mode_index].mode.vdisplay) &&
-          (to_set.hdisplay == connector_info_.modes[mode_index].mode.hdisplay) &&
-          (switch_mode_flag & connector_info_.modes[mode_index].mode.flags)) {
-        if (!refresh_rate || (refresh_rate > connector_info_.modes[mode_index].mode.vrefresh)) {
-          switch_index = mode_index;
-          switch_mode_valid_ = true;
-          refresh_rate = connector_info_.modes[mode_index].mode.vrefresh;
-        }
-      }
-    }
+  if (index < mode_index_.GetModeCount() && mode_index_.GetSwitchIndex(index) >= 0) {
+    switch_index = UINT32(mode_index_.GetSwitchIndex(index));
+    switch_mode_valid_ = true;
   }
 
   if (switch_mode_valid_) {
@@ -937,10 +900,13 @@ DisplayError HWDeviceDRM::SetDisplayAttributes(uint32_t index) {
     return kErrorParameters;
   }
 
+  uint32_t prev_mode_index = current_mode_index_;
   SetDisplaySwitchMode(index);
   PopulateHWPanelInfo();
   UpdateMixerAttributes();
 
+  DLOGI_IF(kTagDriverConfig, "Mode switch %d -> %d (requested %d), transition %d",
+           prev_mode_index, current_mode_index_, index, mode_transition_);
   DLOGI_IF(kTagDriverConfig,
         "Display attributes[%d]: WxH: %dx%d, DPI: %fx%f, FPS: %d, LM_SPLIT: %d, V_BACK_PORCH: %d," \
         " V_FRONT_PORCH: %d, V_PULSE_WIDTH: %d, V_TOTAL: %d, H_TOTAL: %d, CLK: %dKHZ, " \
@@ -1151,7 +1117,6 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
   DRMSecurityLevel crtc_security_level = DRMSecurityLevel::SECURE_NON_SECURE;
   uint32_t index = current_mode_index_;
   drmModeModeInfo current_mode = connector_info_.modes[index].mode;
-  uint64_t current_bit_clk = connector_info_.modes[index].bit_clk_rate;
 
   solid_fills_.clear();
   bool resource_update = hw_layers->updates_mask.test(kUpdateResources);
@@ -1163,12 +1128,14 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
     if (IsFullFrameUpdate(hw_layer_info)) {
       ResetROI();
     } else {
-      const int kNumMaxROIs = 4;
-      DRMRect crtc_rects[kNumMaxROIs] = {{0, 0, mixer_attributes_.width, mixer_attributes_.height}};
-      DRMRect conn_rects[kNumMaxROIs] = {{0, 0, display_attributes_[index].x_pixels,
-                                          display_attributes_[index].y_pixels}};
-
-      for (uint32_t i = 0; i < hw_layer_info.left_frame_roi.size(); i++) {
+      DRMRect crtc_rects[kMaxFrameROIs] = {{0, 0, mixer_attributes_.width,
+                                            mixer_attributes_.height}};
+      DRMRect conn_rects[kMaxFrameROIs] = {{0, 0, display_attributes_[index].x_pixels,
+                                            display_attributes_[index].y_pixels}};
+      // DisplayBase coalesces the damage into kMaxFrameROIs, never program more than that.
+      uint32_t num_rects = std::min(kMaxFrameROIs, UINT32(hw_layer_info.left_frame_roi.size()));
+
+      for (uint32_t i = 0; i < num_rects; i++) {
         auto &roi = hw_layer_info.left_frame_roi.at(i);
         // TODO(user): In multi PU, stitch ROIs vertically adjacent and upate plane destination
         crtc_rects[i].left = UINT32(roi.left);
@@ -1181,7 +1148,7 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
         conn_rects[i].bottom = UINT32(roi.bottom);
       }
 
-      uint32_t num_rects = std::max(1u, static_cast<uint32_t>(hw_layer_info.left_frame_roi.size()));
+      num_rects = std::max(1u, num_rects);
       drm_atomic_intf_->Perform(DRMOps::CRTC_SET_ROI, token_.crtc_id, num_rects, crtc_rects);
       drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_ROI, token_.conn_id, num_rects, conn_rects);
     }
@@ -1361,29 +1328,20 @@ void HWDeviceDRM::SetupAtomic(Fence::ScopedRef &scoped_ref, HWLayers *hw_layers,
            qos_data.rot_prefill_bw_bps / 1000.f, qos_data.rot_clock_hz);
 
   // Set refresh rate
+  uint32_t mode_index = index;
+  HWModeIndex::Key mode_key = mode_index_.GetKey(index);
   if (vrefresh_) {
-    for (uint32_t mode_index = 0; mode_index < connector_info_.modes.size(); mode_index++) {
-      if ((current_mode.vdisplay == connector_info_.modes[mode_index].mode.vdisplay) &&
-          (current_mode.hdisplay == connector_info_.modes[mode_index].mode.hdisplay) &&
-          (current_bit_clk == connector_info_.modes[mode_index].bit_clk_rate) &&
-          (current_mode.flags == connector_info_.modes[mode_index].mode.flags) &&
-          (vrefresh_ == connector_info_.modes[mode_index].mode.vrefresh)) {
-        current_mode = connector_info_.modes[mode_index].mode;
-        break;
-      }
+    mode_key.vrefresh = vrefresh_;
+    if (mode_index_.Find(mode_key, true /* match_flags */, current_mode.flags, &mode_index)) {
+      current_mode = connector_info_.modes[mode_index].mode;
     }
+    mode_key = mode_index_.GetKey(mode_index);
   }
 
   if (bit_clk_rate_) {
-    for (uint32_t mode_index = 0; mode_index < connector_info_.modes.size(); mode_index++) {
-      if ((current_mode.vdisplay == connector_info_.modes[mode_index].mode.vdisplay) &&
-          (current_mode.hdisplay == connector_info_.modes[mode_index].mode.hdisplay) &&
-          (current_mode.vrefresh == connector_info_.modes[mode_index].mode.vrefresh) &&
-          (current_mode.flags == connector_info_.modes[mode_index].mode.flags) &&
-          (bit_clk_rate_ == connector_info_.modes[mode_index].bit_clk_rate)) {
-        current_mode = connector_info_.modes[mode_index].mode;
-        break;
-      }
+    mode_key.bit_clk = bit_clk_rate_;
+    if (mode_index_.Find(mode_key, true /* match_flags */, current_mode.flags, &mode_index)) {
+      current_mode = connector_info_.modes[mode_index].mode;
     }
   }
 
@@ -1560,7 +1518,11 @@ DisplayError HWDeviceDRM::AtomicCommit(HWLayers *hw_layers) {
     }
   }
 
-  int ret = drm_atomic_intf_->Commit(synchronous_commit_, false /* retain_planes*/);
+  int ret = 0;
+  {
+    FRAME_TRACE_SCOPED(display_id_, kFrameTraceAtomicCommit);
+    ret = drm_atomic_intf_->Commit(synchronous_commit_, false /* retain_planes*/);
+  }
   shared_ptr<Fence> release_fence = Fence::Create(INT(release_fence_fd), "release");
   shared_ptr<Fence> retire_fence = Fence::Create(INT(retire_fence_fd), "retire");
   if (ret) {
@@ -1590,35 +1552,26 @@ DisplayError HWDeviceDRM::AtomicCommit(HWLayers *hw_layers) {
 
   hw_layer_info.sync_handle = release_fence;
 
+  uint32_t mode_index = current_mode_index_;
   if (vrefresh_) {
     // Update current mode index if refresh rate is changed
-    drmModeModeInfo current_mode = connector_info_.modes[current_mode_index_].mode;
-    uint64_t current_bit_clk = connector_info_.modes[current_mode_index_].bit_clk_rate;
-    for (uint32_t mode_index = 0; mode_index < connector_info_.modes.size(); mode_index++) {
-      if ((current_mode.vdisplay == connector_info_.modes[mode_index].mode.vdisplay) &&
-          (current_mode.hdisplay == connector_info_.modes[mode_index].mode.hdisplay) &&
-          (current_bit_clk == connector_info_.modes[mode_index].bit_clk_rate) &&
-          (vrefresh_ == connector_info_.modes[mode_index].mode.vrefresh)) {
-        current_mode_index_ = mode_index;
-        SetDisplaySwitchMode(mode_index);
-        break;
-      }
+    // Any panel mode, a pending panel mode switch is applied by SetDisplaySwitchMode().
+    HWModeIndex::Key mode_key = mode_index_.GetKey(current_mode_index_);
+    mode_key.vrefresh = vrefresh_;
+    if (mode_index_.FindAnyPanelMode(mode_key, &mode_index)) {
+      current_mode_index_ = mode_index;
+      SetDisplaySwitchMode(mode_index);
     }
     vrefresh_ = 0;
   }
 
   if (bit_clk_rate_) {
     // Update current mode index if bit clk rate is changed.
-    drmModeModeInfo current_mode = connector_info_.modes[current_mode_index_].mode;
-    for (uint32_t mode_index = 0; mode_index < connector_info_.modes.size(); mode_index++) {
-      if ((current_mode.vdisplay == connector_info_.modes[mode_index].mode.vdisplay) &&
-          (current_mode.hdisplay == connector_info_.modes[mode_index].mode.hdisplay) &&
-          (current_mode.vrefresh == connector_info_.modes[mode_index].mode.vrefresh) &&
-          (bit_clk_rate_ == connector_info_.modes[mode_index].bit_clk_rate)) {
-        current_mode_index_ = mode_index;
-        SetDisplaySwitchMode(mode_index);
-        break;
-      }
+    HWModeIndex::Key mode_key = mode_index_.GetKey(current_mode_index_);
+    mode_key.bit_clk = bit_clk_rate_;
+    if (mode_index_.FindAnyPanelMode(mode_key, &mode_index)) {
+      current_mode_index_ = mode_index;
+      SetDisplaySwitchMode(mode_index);
     }
     bit_clk_rate_ = 0;
   }
@@ -1861,21 +1814,18 @@ DisplayError HWDeviceDRM::SetRefreshRate(uint32_t refresh_rate) {
     return kErrorNotSupported;
   }
 
-  // Check if requested refresh rate is valid
-  drmModeModeInfo current_mode = connector_info_.modes[current_mode_index_].mode;
-  uint64_t current_bit_clk = connector_info_.modes[current_mode_index_].bit_clk_rate;
-  for (uint32_t mode_index = 0; mode_index < connector_info_.modes.size(); mode_index++) {
-    if ((current_mode.vdisplay == connector_info_.modes[mode_index].mode.vdisplay) &&
-        (current_mode.hdisplay == connector_info_.modes[mode_index].mode.hdisplay) &&
-        (current_bit_clk == connector_info_.modes[mode_index].bit_clk_rate) &&
-        (current_mode.flags == connector_info_.modes[mode_index].mode.flags) &&
-        (refresh_rate == connector_info_.modes[mode_index].mode.vrefresh)) {
-      vrefresh_ = refresh_rate;
-      DLOGV_IF(kTagDriverConfig, "Set refresh rate to %d", refresh_rate);
-      return kErrorNone;
-    }
+  // Check if requested refresh rate is reachable seamlessly at the current bit clock.
+  uint32_t mode_index = 0;
+  HWModeIndex::Key mode_key = mode_index_.GetKey(current_mode_index_);
+  mode_key.vrefresh = refresh_rate;
+  if (!mode_index_.Find(mode_key, true /* match_flags */,
+                        connector_info_.modes[current_mode_index_].mode.flags, &mode_index)) {
+    return kErrorNotSupported;
   }
-  return kErrorNotSupported;
+
+  vrefresh_ = refresh_rate;
+  DLOGV_IF(kTagDriverConfig, "Set refresh rate to %d", refresh_rate);
+  return kErrorNone;
 }
 
 
@@ -2250,6 +2200,7 @@ void HWDeviceDRM::AddDimLayerIfNeeded() {
 DisplayError HWDeviceDRM::NullCommit(bool synchronous, bool retain_planes) {
   DTRACE_SCOPED();
   AddDimLayerIfNeeded();
+  FRAME_TRACE_SCOPED(display_id_, kFrameTraceAtomicCommit);
   int ret = drm_atomic_intf_->Commit(synchronous , retain_planes);
   if (ret) {
     DLOGE("failed with error %d", ret);
@@ -41,6 +41,7 @@
 #include <memory>
 
 #include "hw_interface.h"
+#include "hw_mode_index.h"
 #include "hw_scale_drm.h"
 #include "hw_color_manager_drm.h"
 
@@ -97,6 +98,12 @@ class HWDeviceDRM : public HWInterface {
   virtual DisplayError SetDisplayMode(const HWDisplayMode hw_display_mode);
   virtual DisplayError SetRefreshRate(uint32_t refresh_rate);
   virtual DisplayError SetPanelBrightness(int level) { return kErrorNotSupported; }
+  virtual DisplayError SetPanelBrightnessRamp(int level, uint32_t duration_ms) {
+    return kErrorNotSupported;
+  }
+  virtual DisplayError LatchPanelBrightness(int64_t timestamp, bool *ramp_pending) {
+    return kErrorNotSupported;
+  }
   virtual DisplayError GetHWScanInfo(HWScanInfo *scan_info);
   virtual DisplayError GetVideoFormat(uint32_t config_index, uint32_t *video_format);
   virtual DisplayError GetMaxCEAFormat(uint32_t *max_cea_format);
@@ -185,6 +192,8 @@ class HWDeviceDRM : public HWInterface {
   void DumpHWLayers(HWLayers *hw_layers);
   bool IsFullFrameUpdate(const HWLayersInfo &hw_layer_info);
 
+  void BuildModeIndex();
+
   class Registry {
    public:
     explicit Registry(BufferAllocator *buffer_allocator);
@@ -243,6 +252,7 @@ class HWDeviceDRM : public HWInterface {
   uint32_t video_mode_index_ = 0;
   uint32_t cmd_mode_index_ = 0;
   bool switch_mode_valid_ = false;
+  HWModeIndex::Transition mode_transition_ = HWModeIndex::kTransitionNone;
   bool doze_poms_switch_done_ = false;
   bool pending_poms_switch_ = false;
   bool active_ = false;
@@ -252,6 +262,7 @@ class HWDeviceDRM : public HWInterface {
   // Destination scaler blocks in use by all HWDeviceDRM instances.
   static std::atomic<uint32_t> hw_dest_scaler_blocks_used_;
   bool null_display_commit_ = false;
+  HWModeIndex mode_index_ = {};
 
  private:
   void SetDisplaySwitchMode(uint32_t index);
@@ -0,0 +1,263 @@
+/*
+Copyright (c) 2020, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <vector>
+
+#include "hw_hdr_metadata_drm.h"
+
+#ifndef HDR_EOTF_SMTPE_ST2084
+#define HDR_EOTF_SMTPE_ST2084 2
+#endif
+#ifndef HDR_EOTF_HLG
+#define HDR_EOTF_HLG 3
+#endif
+
+#define __CLASS__ "HWHDRMetaDataDRM"
+
+#define HDR_DISABLE 0
+#define HDR_ENABLE 1
+#define MIN_HDR_RESET_WAITTIME 2
+
+using sde_drm::DRMAtomicReqInterface;
+using sde_drm::DRMOps;
+
+namespace sdm {
+
+static int32_t GetEOTF(const GammaTransfer &transfer) {
+  int32_t hdr_transfer = -1;
+
+  switch (transfer) {
+  case Transfer_SMPTE_ST2084:
+    hdr_transfer = HDR_EOTF_SMTPE_ST2084;
+    break;
+  case Transfer_HLG:
+    hdr_transfer = HDR_EOTF_HLG;
+    break;
+  default:
+    DLOGW("Unknown Transfer: %d", transfer);
+  }
+
+  return hdr_transfer;
+}
+
+static bool IsSameHDRMetaData(const drm_msm_ext_hdr_metadata &a,
+                              const drm_msm_ext_hdr_metadata &b) {
+  for (int i = 0; i < 3; i++) {
+    if (a.display_primaries_x[i] != b.display_primaries_x[i] ||
+        a.display_primaries_y[i] != b.display_primaries_y[i]) {
+      return false;
+    }
+  }
+
+  return (a.hdr_state == b.hdr_state && a.eotf == b.eotf && a.hdr_supported == b.hdr_supported &&
+          a.white_point_x == b.white_point_x && a.white_point_y == b.white_point_y &&
+          a.max_luminance == b.max_luminance && a.min_luminance == b.min_luminance &&
+          a.max_content_light_level == b.max_content_light_level &&
+          a.max_average_light_level == b.max_average_light_level);
+}
+
+void HWHDRMetaDataDRM::Update(DRMAtomicReqInterface *drm_atomic_intf, uint32_t conn_id,
+                              const HWHDRLayerInfo &hdr_layer_info, const LayerStack *stack,
+                              bool hdr_plus_enabled, int64_t now_ms) {
+  HWHDRLayerInfo::HDROperation hdr_op = hdr_layer_info.operation;
+  int32_t layer_index = hdr_layer_info.layer_index;
+
+  const LayerBuffer *layer_buffer = &no_buffer_;
+  if (hdr_op == HWHDRLayerInfo::kSet && layer_index > -1 &&
+      UINT32(layer_index) < stack->layers.size()) {
+    layer_buffer = &stack->layers.at(UINT32(layer_index))->input_buffer;
+  }
+
+  const MasteringDisplay &mastering_display = layer_buffer->color_metadata.masteringDisplayInfo;
+  const ContentLightLevel &light_level = layer_buffer->color_metadata.contentLightLevel;
+  const Primaries &primaries = mastering_display.primaries;
+
+  if (hdr_op == HWHDRLayerInfo::kSet && hdr_layer_info.hdr_layers.size() == 1) {
+    // Reset reset_hdr_flag_ to handle where there are two consecutive HDR video playbacks with not
+    // enough non-HDR frames in between to reset the HDR metadata.
+    reset_hdr_flag_ = false;
+    in_multiset_ = false;
+
+    int32_t eotf = GetEOTF(layer_buffer->color_metadata.transfer);
+    hdr_metadata_.hdr_supported = 1;
+    hdr_metadata_.hdr_state = HDR_ENABLE;
+    hdr_metadata_.eotf = (eotf < 0) ? 0 : UINT32(eotf);
+    hdr_metadata_.white_point_x = primaries.whitePoint[0];
+    hdr_metadata_.white_point_y = primaries.whitePoint[1];
+    hdr_metadata_.display_primaries_x[0] = primaries.rgbPrimaries[0][0];
+    hdr_metadata_.display_primaries_y[0] = primaries.rgbPrimaries[0][1];
+    hdr_metadata_.display_primaries_x[1] = primaries.rgbPrimaries[1][0];
+    hdr_metadata_.display_primaries_y[1] = primaries.rgbPrimaries[1][1];
+    hdr_metadata_.display_primaries_x[2] = primaries.rgbPrimaries[2][0];
+    hdr_metadata_.display_primaries_y[2] = primaries.rgbPrimaries[2][1];
+    hdr_metadata_.min_luminance = mastering_display.minDisplayLuminance;
+    hdr_metadata_.max_luminance = mastering_display.maxDisplayLuminance;
+    hdr_metadata_.max_content_light_level = light_level.maxContentLightLevel;
+    hdr_metadata_.max_average_light_level = light_level.minPicAverageLightLevel;
+    SetDynamicPayload(hdr_layer_info, *layer_buffer, hdr_plus_enabled);
+
+    Emit(drm_atomic_intf, conn_id, hdr_op);
+  } else if (hdr_op == HWHDRLayerInfo::kSet && !in_multiset_) {
+    // Special case to handle multiple HDR layers.
+    // If there are multiple HDR layers, then simply drop all metadata (which is optional) since
+    // content going in and out of view (e.g., video start/stop, scrolling video preview thumbnails)
+    // will cause flicker.
+    InitMaxHDRMetaData();
+    payload_.clear();
+    in_multiset_ = true;
+    reset_hdr_flag_ = false;
+    Emit(drm_atomic_intf, conn_id, hdr_op);
+  } else if (hdr_op == HWHDRLayerInfo::kReset) {
+    memset(&hdr_metadata_, 0, sizeof(hdr_metadata_));
+    hdr_metadata_.hdr_supported = 1;
+    hdr_metadata_.hdr_state = HDR_ENABLE;
+    payload_.clear();
+    reset_hdr_flag_ = true;
+    in_multiset_ = false;
+    hdr_reset_start_ms_ = now_ms;
+    Emit(drm_atomic_intf, conn_id, hdr_op);
+  } else if (hdr_op == HWHDRLayerInfo::kNoOp) {
+    // TODO(user): This case handles the state transition from HDR_ENABLED to HDR_DISABLED.
+    // As per HDMI spec requirement, we need to send zero metadata for atleast 2 sec after end of
+    // playback. This timer calculates the 2 sec window after playback stops to stop sending HDR
+    // metadata. This will be replaced with an idle timer implementation in the future.
+    if (reset_hdr_flag_ && (now_ms - hdr_reset_start_ms_) >= (MIN_HDR_RESET_WAITTIME * 1000)) {
+      reset_hdr_flag_ = false;
+      Disable(drm_atomic_intf, conn_id);
+    }
+  }
+}
+
+void HWHDRMetaDataDRM::SetDynamicPayload(const HWHDRLayerInfo &hdr_layer_info,
+                                         const LayerBuffer &layer_buffer, bool hdr_plus_enabled) {
+  const std::vector<uint8_t> &payload = hdr_layer_info.dyn_hdr_vsif_payload;
+  if (!hdr_plus_enabled || payload.empty()) {
+    payload_.clear();
+    return;
+  }
+
+  if (layer_buffer.color_metadata.transfer != Transfer_SMPTE_ST2084) {
+    DLOGW("Dropping dynamic HDR metadata on a layer with transfer %d",
+          layer_buffer.color_metadata.transfer);
+    payload_.clear();
+    return;
+  }
+
+  // DisplayBase takes the payload from this same layer buffer at commit, so it always describes
+  // the frame going out.
+  payload_ = payload;
+}
+
+void HWHDRMetaDataDRM::Emit(DRMAtomicReqInterface *drm_atomic_intf, uint32_t conn_id,
+                            HWHDRLayerInfo::HDROperation operation) {
+  hdr_metadata_.hdr_plus_payload = payload_.empty() ? reinterpret_cast<uint64_t>(nullptr) :
+                                   reinterpret_cast<uint64_t>(payload_.data());
+  hdr_metadata_.hdr_plus_payload_size = UINT32(payload_.size());
+
+  bool static_changed = !sent_valid_ || !IsSameHDRMetaData(hdr_metadata_, sent_metadata_);
+  if (!static_changed && payload_ == sent_payload_) {
+    return;
+  }
+
+  drm_atomic_intf->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, conn_id, &hdr_metadata_);
+  sent_metadata_ = hdr_metadata_;
+  sent_payload_ = payload_;
+  sent_valid_ = true;
+
+  // Dynamic metadata changes every frame, only log the static part changing.
+  if (static_changed) {
+    DumpHDRMetaData(operation);
+  } else {
+    DLOGV_IF(kTagDriverConfig, "Dynamic HDR payload size = %zu", payload_.size());
+  }
+}
+
+void HWHDRMetaDataDRM::Disable(DRMAtomicReqInterface *drm_atomic_intf, uint32_t conn_id) {
+  memset(&hdr_metadata_, 0, sizeof(hdr_metadata_));
+  hdr_metadata_.hdr_supported = 1;
+  hdr_metadata_.hdr_state = HDR_DISABLE;
+  payload_.clear();
+
+  drm_atomic_intf->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, conn_id, &hdr_metadata_);
+  sent_metadata_ = hdr_metadata_;
+  sent_payload_.clear();
+  sent_valid_ = true;
+}
+
+void HWHDRMetaDataDRM::Invalidate() {
+  sent_valid_ = false;
+}
+
+void HWHDRMetaDataDRM::DumpHDRMetaData(HWHDRLayerInfo::HDROperation operation) {
+  DLOGI("Operation = %d, HDR Metadata: MaxDisplayLuminance = %d MinDisplayLuminance = %d\n"
+        "MaxContentLightLevel = %d MaxAverageLightLevel = %d Red_x = %d Red_y = %d Green_x = %d\n"
+        "Green_y = %d Blue_x = %d Blue_y = %d WhitePoint_x = %d WhitePoint_y = %d EOTF = %d\n"
+        "HDR10+ payload size = %u\n",
+        operation, hdr_metadata_.max_luminance, hdr_metadata_.min_luminance,
+        hdr_metadata_.max_content_light_level, hdr_metadata_.max_average_light_level,
+        hdr_metadata_.display_primaries_x[0], hdr_metadata_.display_primaries_y[0],
+        hdr_metadata_.display_primaries_x[1], hdr_metadata_.display_primaries_y[1],
+        hdr_metadata_.display_primaries_x[2], hdr_metadata_.display_primaries_y[2],
+        hdr_metadata_.white_point_x, hdr_metadata_.white_point_y, hdr_metadata_.eotf,
+        hdr_metadata_.hdr_plus_payload_size);
+}
+
+void HWHDRMetaDataDRM::InitMaxHDRMetaData() {
+  memset(&hdr_metadata_, 0, sizeof(hdr_metadata_));
+  hdr_metadata_.hdr_supported = 1;
+  hdr_metadata_.hdr_state = HDR_ENABLE;
+  hdr_metadata_.eotf = UINT32(GetEOTF(Transfer_SMPTE_ST2084));
+  // Rec. 2020 (ITU-R Recommendation BT.2020) RGB color space parameters
+  // +---------------+-----------------+-----------------------------------------------+
+  // |               |   White point   |                Primary colors                 |
+  // |  Color space  +--------+--------+-------+-------+-------+-------+-------+-------+
+  // |               |   xW   |   yW   |  xR   |  yR   |  xG   |  yG   |  xB   |  yB   |
+  // +---------------+--------+--------+-------+-------+-------+-------+-------+-------+
+  // | ITU-R BT.2020 | 0.3127 | 0.3290 | 0.708 | 0.292 | 0.170 | 0.797 | 0.131 | 0.046 |
+  // +---------------+--------+--------+-------+-------+-------+-------+-------+-------+
+  // Rec. 2020 D65 'CIE Standard Illuminant'.
+  hdr_metadata_.white_point_x = 15635;                // 0.31271 x 50000
+  hdr_metadata_.white_point_y = 16451;                // 0.32902 x 50000
+  // Rec. 2020 primaries.
+  hdr_metadata_.display_primaries_x[0] = 35400;       // 0.708 x 50000
+  hdr_metadata_.display_primaries_y[0] = 14600;       // 0.292 x 50000
+  hdr_metadata_.display_primaries_x[1] = 8500;        // 0.170 x 50000
+  hdr_metadata_.display_primaries_y[1] = 39850;       // 0.797 x 50000
+  hdr_metadata_.display_primaries_x[2] = 6550;        // 0.131 x 50000
+  hdr_metadata_.display_primaries_y[2] = 2300;        // 0.046 x 50000
+  hdr_metadata_.min_luminance = 0;                    // 0 nits
+  hdr_metadata_.max_luminance = 100000000;            // 10000 nits
+  hdr_metadata_.max_content_light_level = 100000000;  // 10000 nits brightest pixel in content
+  hdr_metadata_.max_average_light_level = 100000000;  // 10000 nits brightest frame in content
+}
+
+}  // namespace sdm
@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2020, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_HDR_METADATA_DRM_H__
+#define __HW_HDR_METADATA_DRM_H__
+
+#include <core/layer_stack.h>
+#include <drm_interface.h>
+#include <private/hw_info_types.h>
+#include <stdint.h>
+#include <vector>
+
+namespace sdm {
+
+// Builds the HDR metadata a TV connector sends to the sink: static HDR10 mastering display and
+// content light level metadata, plus per-frame dynamic (ST 2094-40) metadata. The metadata is only
+// added to the atomic request when it differs from what the sink last received.
+class HWHDRMetaDataDRM {
+ public:
+  // Adds the metadata for the frame being committed. now_ms is a monotonic timestamp.
+  void Update(sde_drm::DRMAtomicReqInterface *drm_atomic_intf, uint32_t conn_id,
+              const HWHDRLayerInfo &hdr_layer_info, const LayerStack *stack,
+              bool hdr_plus_enabled, int64_t now_ms);
+  // Sends HDR_DISABLE to the sink.
+  void Disable(sde_drm::DRMAtomicReqInterface *drm_atomic_intf, uint32_t conn_id);
+  // Forgets what the sink holds, so the next frame sends its metadata again. Needed when the
+  // commit carrying the metadata failed or the connector was restarted.
+  void Invalidate();
+
+ private:
+  void SetDynamicPayload(const HWHDRLayerInfo &hdr_layer_info, const LayerBuffer &layer_buffer,
+                         bool hdr_plus_enabled);
+  void Emit(sde_drm::DRMAtomicReqInterface *drm_atomic_intf, uint32_t conn_id,
+            HWHDRLayerInfo::HDROperation operation);
+  void DumpHDRMetaData(HWHDRLayerInfo::HDROperation operation);
+  void InitMaxHDRMetaData();
+
+  drm_msm_ext_hdr_metadata hdr_metadata_ = {};
+  std::vector<uint8_t> payload_ = {};
+  drm_msm_ext_hdr_metadata sent_metadata_ = {};
+  std::vector<uint8_t> sent_payload_ = {};
+  bool sent_valid_ = false;
+  const LayerBuffer no_buffer_ = {};
+  int64_t hdr_reset_start_ms_ = 0;
+  bool reset_hdr_flag_ = false;
+  bool in_multiset_ = false;
+};
+
+}  // namespace sdm
+
+#endif  // __HW_HDR_METADATA_DRM_H__
@@ -0,0 +1,189 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+#include <stdarg.h>
+#include <vector>
+
+#include "hw_hdr_metadata_drm.h"
+
+using namespace sdm;
+using sde_drm::DRMOps;
+
+namespace {
+
+const uint32_t kConnectorId = 7;
+
+struct SentMetaData {
+  drm_msm_ext_hdr_metadata metadata;
+  std::vector<uint8_t> payload;
+};
+
+// Records the HDR metadata added to each atomic request, with a copy of the dynamic payload it
+// pointed to at the time.
+class FakeAtomicReq : public sde_drm::DRMAtomicReqInterface {
+ public:
+  int Perform(DRMOps opcode, uint32_t obj_id, ...) override {
+    EXPECT_EQ(DRMOps::CONNECTOR_SET_HDR_METADATA, opcode);
+    EXPECT_EQ(kConnectorId, obj_id);
+
+    va_list args;
+    va_start(args, obj_id);
+    auto metadata = va_arg(args, drm_msm_ext_hdr_metadata *);
+    va_end(args);
+
+    SentMetaData sent = {*metadata, {}};
+    if (metadata->hdr_plus_payload_size) {
+      auto payload = reinterpret_cast<const uint8_t *>(metadata->hdr_plus_payload);
+      sent.payload.assign(payload, payload + metadata->hdr_plus_payload_size);
+    }
+    sent_.push_back(sent);
+    return 0;
+  }
+  int Commit(bool synchronous, bool retain_planes) override { return 0; }
+  int Validate() override { return 0; }
+
+  std::vector<SentMetaData> sent_;
+};
+
+class HWHDRMetaDataDRMTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    layer_.input_buffer.color_metadata.transfer = Transfer_SMPTE_ST2084;
+    layer_.input_buffer.color_metadata.masteringDisplayInfo.maxDisplayLuminance = 1000;
+    layer_.input_buffer.color_metadata.contentLightLevel.maxContentLightLevel = 800;
+    stack_.layers.push_back(&layer_);
+    info_.operation = HWHDRLayerInfo::kSet;
+    info_.layer_index = 0;
+    info_.hdr_layers.insert(0);
+  }
+
+  void Frame(bool hdr_plus_enabled = true) {
+    hdr_.Update(&atomic_, kConnectorId, info_, &stack_, hdr_plus_enabled, now_ms_);
+    now_ms_ += 16;
+  }
+
+  FakeAtomicReq atomic_;
+  HWHDRMetaDataDRM hdr_;
+  Layer layer_;
+  LayerStack stack_;
+  HWHDRLayerInfo info_;
+  int64_t now_ms_ = 1000;
+};
+
+}  // namespace
+
+TEST_F(HWHDRMetaDataDRMTest, SendsStaticMetaDataOnce) {
+  Frame();
+  Frame();
+  Frame();
+  ASSERT_EQ(1u, atomic_.sent_.size());
+  EXPECT_EQ(1u, atomic_.sent_[0].metadata.hdr_state);
+  EXPECT_EQ(2u, atomic_.sent_[0].metadata.eotf);
+  EXPECT_EQ(1000u, atomic_.sent_[0].metadata.max_luminance);
+  EXPECT_EQ(800u, atomic_.sent_[0].metadata.max_content_light_level);
+  EXPECT_TRUE(atomic_.sent_[0].payload.empty());
+
+  layer_.input_buffer.color_metadata.contentLightLevel.maxContentLightLevel = 600;
+  Frame();
+  ASSERT_EQ(2u, atomic_.sent_.size());
+  EXPECT_EQ(600u, atomic_.sent_[1].metadata.max_content_light_level);
+}
+
+TEST_F(HWHDRMetaDataDRMTest, SendsDynamicPayloadOfEachFrame) {
+  info_.dyn_hdr_vsif_payload = {1, 2, 3};
+  Frame();
+  info_.dyn_hdr_vsif_payload = {4, 5};
+  Frame();
+  // Same payload on the next frame, nothing to send.
+  Frame();
+
+  ASSERT_EQ(2u, atomic_.sent_.size());
+  EXPECT_EQ((std::vector<uint8_t>{1, 2, 3}), atomic_.sent_[0].payload);
+  EXPECT_EQ((std::vector<uint8_t>{4, 5}), atomic_.sent_[1].payload);
+  EXPECT_EQ(2u, atomic_.sent_[1].metadata.hdr_plus_payload_size);
+}
+
+TEST_F(HWHDRMetaDataDRMTest, DropsDynamicPayloadSinkCannotUse) {
+  info_.dyn_hdr_vsif_payload = {1, 2, 3};
+  Frame(false);
+  ASSERT_EQ(1u, atomic_.sent_.size());
+  EXPECT_TRUE(atomic_.sent_[0].payload.empty());
+
+  // ST 2094-40 only applies to PQ content.
+  layer_.input_buffer.color_metadata.transfer = Transfer_HLG;
+  Frame(true);
+  ASSERT_EQ(2u, atomic_.sent_.size());
+  EXPECT_EQ(3u, atomic_.sent_[1].metadata.eotf);
+  EXPECT_TRUE(atomic_.sent_[1].payload.empty());
+}
+
+TEST_F(HWHDRMetaDataDRMTest, ResendsAfterInvalidate) {
+  info_.dyn_hdr_vsif_payload = {1, 2, 3};
+  Frame();
+  // The commit carrying the metadata failed.
+  hdr_.Invalidate();
+  Frame();
+  ASSERT_EQ(2u, atomic_.sent_.size());
+  EXPECT_EQ(atomic_.sent_[0].payload, atomic_.sent_[1].payload);
+}
+
+TEST_F(HWHDRMetaDataDRMTest, ResetHoldsZeroMetaDataBeforeDisable) {
+  Frame();
+  info_.operation = HWHDRLayerInfo::kReset;
+  Frame();
+  ASSERT_EQ(2u, atomic_.sent_.size());
+  EXPECT_EQ(1u, atomic_.sent_[1].metadata.hdr_state);
+  EXPECT_EQ(0u, atomic_.sent_[1].metadata.max_luminance);
+
+  info_.operation = HWHDRLayerInfo::kNoOp;
+  now_ms_ += 1000;
+  Frame();
+  EXPECT_EQ(2u, atomic_.sent_.size());
+  now_ms_ += 1000;
+  Frame();
+  ASSERT_EQ(3u, atomic_.sent_.size());
+  EXPECT_EQ(0u, atomic_.sent_[2].metadata.hdr_state);
+  Frame();
+  EXPECT_EQ(3u, atomic_.sent_.size());
+}
+
+TEST_F(HWHDRMetaDataDRMTest, MultipleHdrLayersSendMaxMetaDataOnce) {
+  Layer second;
+  stack_.layers.push_back(&second);
+  info_.hdr_layers.insert(1);
+  info_.dyn_hdr_vsif_payload = {1, 2, 3};
+  Frame();
+  Frame();
+  ASSERT_EQ(1u, atomic_.sent_.size());
+  EXPECT_EQ(100000000u, atomic_.sent_[0].metadata.max_luminance);
+  EXPECT_TRUE(atomic_.sent_[0].payload.empty());
+}
+
+TEST_F(HWHDRMetaDataDRMTest, IgnoresOutOfRangeLayerIndex) {
+  info_.layer_index = 5;
+  Frame();
+  ASSERT_EQ(1u, atomic_.sent_.size());
+  EXPECT_EQ(0u, atomic_.sent_[0].metadata.max_luminance);
+}
@@ -39,9 +39,13 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/utsname.h>
+#include <time.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/hash.h>
 #include <utils/sys.h>
+#include <xf86drm.h>
 
 #include <algorithm>
 #include <fstream>
@@ -118,6 +122,13 @@ static InlineRotationVersion GetInRotVersion(sde_drm::InlineRotationVersion drm_
 }
 
 HWResourceInfo *HWInfoDRM::hw_resource_ = nullptr;
+const char *HWInfoDRM::kSnapshotPath = "/data/vendor/display/hw_resource_info.bin";
+
+static uint64_t GetMonotonicTimeUs() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return UINT64(ts.tv_sec) * 1000000 + UINT64(ts.tv_nsec) / 1000;
+}
 
 DisplayError HWInfoDRM::Init() {
   default_mode_ = (DRMLibLoader::GetInstance()->IsLoaded() == false);
@@ -130,6 +141,7 @@ DisplayError HWInfoDRM::Init() {
       return kErrorCriticalResource;
     }
     drm_master->GetHandle(&dev_fd);
+    dev_fd_ = dev_fd;
     DRMLibLoader::GetInstance()->FuncGetDRMManager()(dev_fd, &drm_mgr_intf_);
     if (!drm_mgr_intf_) {
       DRMLibLoader::Destroy();
@@ -143,6 +155,10 @@ DisplayError HWInfoDRM::Init() {
 }
 
 void HWInfoDRM::Deinit() {
+  if (verify_thread_.joinable()) {
+    verify_thread_.join();
+  }
+
   delete hw_resource_;
   hw_resource_ = nullptr;
 
@@ -180,48 +196,38 @@ DisplayError HWInfoDRM::GetHWResourceInfo(HWResourceInfo *hw_resource) {
     return kErrorNone;
   }
 
-  hw_resource->num_blending_stages = 1;
-  hw_resource->max_pipe_width = 2560;
-  hw_resource->max_cursor_size = 128;
-  hw_resource->max_scale_down = 1;
-  hw_resource->max_scale_up = 1;
-  hw_resource->has_decimation = false;
-  hw_resource->max_bandwidth_low = 9600000;
-  hw_resource->max_bandwidth_high = 9600000;
-  hw_resource->max_pipe_bw = 4500000;
-  hw_resource->max_sde_clk = 412500000;
-  hw_resource->clk_fudge_factor = FLOAT(105) / FLOAT(100);
-  hw_resource->macrotile_nv12_factor = 8;
-  hw_resource->macrotile_factor = 4;
-  hw_resource->linear_factor = 1;
-  hw_resource->scale_factor = 1;
-  hw_resource->extra_fudge_factor = 2;
-  hw_resource->amortizable_threshold = 25;
-  hw_resource->system_overhead_lines = 0;
-  hw_resource->hw_dest_scalar_info.count = 0;
-  hw_resource->hw_dest_scalar_info.max_scale_up = 0;
-  hw_resource->hw_dest_scalar_info.max_input_width = 0;
-  hw_resource->hw_dest_scalar_info.max_output_width = 0;
-  hw_resource->is_src_split = true;
-  hw_resource->has_qseed3 = false;
-  hw_resource->has_concurrent_writeback = false;
+  uint64_t start_us = GetMonotonicTimeUs();
+  int value = 0;
+  bool use_snapshot = true;
+  if (Debug::GetProperty(DISABLE_HW_INFO_SNAPSHOT_PROP, &value) == kErrorNone) {
+    use_snapshot = (value != 1);
+  }
 
-  hw_resource->hw_version = SDEVERSION(4, 0, 1);
+  HWResourceSnapshotKey key;
+  bool from_snapshot = false;
+  if (use_snapshot) {
+    GetSnapshotKey(&key);
+    from_snapshot = (HWResourceSnapshot::Load(kSnapshotPath, key, hw_resource) == kErrorNone);
+  }
 
-  // TODO(user): Deprecate
-  hw_resource->max_mixer_width = 2560;
-  hw_resource->writeback_index = 0;
-  hw_resource->has_ubwc = true;
-  hw_resource->separate_rotator = true;
-  hw_resource->has_non_scalar_rgb = false;
+  if (from_snapshot) {
+    verify_thread_ = std::thread(&HWInfoDRM::VerifySnapshot, this, key, *hw_resource);
+  } else {
+    DiscoverHWResourceInfo(false /* verify */, hw_resource);
+    if (use_snapshot) {
+      HWResourceSnapshot::Store(kSnapshotPath, key, *hw_resource);
+    }
+  }
 
-  GetSystemInfo(hw_resource);
-  GetHWPlanesInfo(hw_resource);
-  GetWBInfo(hw_resource);
+  GetInitStats(hw_resource);
+  hw_resource->init_stats.resource_info_us = GetMonotonicTimeUs() - start_us;
+  hw_resource->init_stats.resource_info_from_snapshot = from_snapshot;
+  DLOGI("Resource info %s in %" PRIu64 " us", from_snapshot ? "loaded from snapshot" :
+        "discovered", hw_resource->init_stats.resource_info_us);
 
   // Disable destination scalar count to 0 if extension library is not present or disabled
   // through property
-  int value = 0;
+  value = 0;
   bool disable_dest_scalar = false;
   if (Debug::GetProperty(DISABLE_DESTINATION_SCALER_PROP, &value) == kErrorNone) {
     disable_dest_scalar = (value == 1);
@@ -259,10 +265,6 @@ DisplayError HWInfoDRM::GetHWResourceInfo(HWResourceInfo *hw_resource) {
   DLOGI("\tFudge_factor = %d", hw_resource->extra_fudge_factor);
   DLOGI("\tib_fudge_factor = %f", hw_resource->ib_fudge_factor);
 
-  if (hw_resource->separate_rotator || hw_resource->num_dma_pipe) {
-    GetHWRotatorInfo(hw_resource);
-  }
-
   DLOGI("Has Support for multiple bw limits shown below");
   for (int index = 0; index < kBwModeMax; index++) {
     DLOGI("Mode-index=%d  total_bw_limit=%" PRIu64 " and pipe_bw_limit=%" PRIu64, index,
@@ -278,6 +280,104 @@ DisplayError HWInfoDRM::GetHWResourceInfo(HWResourceInfo *hw_resource) {
   return kErrorNone;
 }
 
+void HWInfoDRM::DiscoverHWResourceInfo(bool verify, HWResourceInfo *hw_resource) {
+  hw_resource->num_blending_stages = 1;
+  hw_resource->max_pipe_width = 2560;
+  hw_resource->max_cursor_size = 128;
+  hw_resource->max_scale_down = 1;
+  hw_resource->max_scale_up = 1;
+  hw_resource->has_decimation = false;
+  hw_resource->max_bandwidth_low = 9600000;
+  hw_resource->max_bandwidth_high = 9600000;
+  hw_resource->max_pipe_bw = 4500000;
+  hw_resource->max_sde_clk = 412500000;
+  hw_resource->clk_fudge_factor = FLOAT(105) / FLOAT(100);
+  hw_resource->macrotile_nv12_factor = 8;
+  hw_resource->macrotile_factor = 4;
+  hw_resource->linear_factor = 1;
+  hw_resource->scale_factor = 1;
+  hw_resource->extra_fudge_factor = 2;
+  hw_resource->amortizable_threshold = 25;
+  hw_resource->system_overhead_lines = 0;
+  hw_resource->hw_dest_scalar_info.count = 0;
+  hw_resource->hw_dest_scalar_info.max_scale_up = 0;
+  hw_resource->hw_dest_scalar_info.max_input_width = 0;
+  hw_resource->hw_dest_scalar_info.max_output_width = 0;
+  hw_resource->is_src_split = true;
+  hw_resource->has_qseed3 = false;
+  hw_resource->has_concurrent_writeback = false;
+
+  hw_resource->hw_version = SDEVERSION(4, 0, 1);
+
+  // TODO(user): Deprecate
+  hw_resource->max_mixer_width = 2560;
+  hw_resource->writeback_index = 0;
+  hw_resource->has_ubwc = true;
+  hw_resource->separate_rotator = true;
+  hw_resource->has_non_scalar_rgb = false;
+
+  GetSystemInfo(hw_resource);
+  GetHWPlanesInfo(hw_resource);
+  GetWBInfo(verify, hw_resource);
+
+  if (hw_resource->separate_rotator || hw_resource->num_dma_pipe) {
+    GetHWRotatorInfo(hw_resource);
+  }
+}
+
+void HWInfoDRM::GetSnapshotKey(HWResourceSnapshotKey *key) {
+  drmVersionPtr version = drmGetVersion(dev_fd_);
+  if (version) {
+    key->driver_version = string(version->name, size_t(version->name_len)) + " " +
+                          to_string(version->version_major) + "." +
+                          to_string(version->version_minor) + "." +
+                          to_string(version->version_patchlevel);
+    drmFreeVersion(version);
+  }
+  struct utsname name = {};
+  if (!uname(&name)) {
+    key->driver_version += string(" ") + name.release + " " + name.version;
+  }
+
+  drm_mgr_intf_->GetCapabilitiesHash(&key->caps_hash);
+
+  // Properties read during discovery, and the library doing it, so that an update to either
+  // invalidates the snapshot.
+  uint32_t reduced_config[2] = {};
+  int disable_src_tonemap = 0;
+  Debug::GetReducedConfig(&reduced_config[0], &reduced_config[1]);
+  Debug::Get()->GetProperty(DISABLE_SRC_TONEMAP_PROP, &disable_src_tonemap);
+  uint64_t hash = HashBytes(reduced_config, sizeof(reduced_config));
+  hash = HashBytes(&disable_src_tonemap, sizeof(disable_src_tonemap), hash);
+
+  Dl_info lib_info = {};
+  struct stat lib_stat = {};
+  if (dladdr(reinterpret_cast<void *>(&GetMonotonicTimeUs), &lib_info) && lib_info.dli_fname &&
+      !stat(lib_info.dli_fname, &lib_stat)) {
+    hash = HashBytes(&lib_stat.st_size, sizeof(lib_stat.st_size), hash);
+    hash = HashBytes(&lib_stat.st_mtime, sizeof(lib_stat.st_mtime), hash);
+  }
+  key->config_hash = hash;
+}
+
+void HWInfoDRM::VerifySnapshot(HWResourceSnapshotKey key, HWResourceInfo snapshot) {
+  uint64_t start_us = GetMonotonicTimeUs();
+  HWResourceInfo discovered;
+  DiscoverHWResourceInfo(true /* verify */, &discovered);
+
+  std::string expected, actual;
+  HWResourceSnapshot::Serialize(key, snapshot, &expected);
+  HWResourceSnapshot::Serialize(key, discovered, &actual);
+  if (expected == actual) {
+    DLOGI("Snapshot verified in %" PRIu64 " us", GetMonotonicTimeUs() - start_us);
+    return;
+  }
+
+  // The values in use stay as loaded; the next start picks up the rediscovered ones.
+  DLOGW("Snapshot does not match discovered resources, rewriting %s", kSnapshotPath);
+  HWResourceSnapshot::Store(kSnapshotPath, key, discovered);
+}
+
 void HWInfoDRM::GetSystemInfo(HWResourceInfo *hw_resource) {
   DRMCrtcInfo info;
   drm_mgr_intf_->GetCrtcInfo(0 /* system_info */, &info);
@@ -526,36 +626,61 @@ void HWInfoDRM::PopulateSupportedInlineFmts(const sde_drm::DRMPlaneTypeInfo &inf
   }
 }
 
-void HWInfoDRM::GetWBInfo(HWResourceInfo *hw_resource) {
+void HWInfoDRM::GetInitStats(HWResourceInfo *hw_resource) {
+  sde_drm::DRMInitStats stats = {};
+  drm_mgr_intf_->GetInitStats(&stats);
+
+  HWInitStats &init_stats = hw_resource->init_stats;
+  init_stats.total_us = stats.total_us;
+  init_stats.connectors_us = stats.connectors_us;
+  init_stats.encoders_us = stats.encoders_us;
+  init_stats.crtcs_us = stats.crtcs_us;
+  init_stats.planes_us = stats.planes_us;
+}
+
+void HWInfoDRM::GetWBInfo(bool verify, HWResourceInfo *hw_resource) {
   HWSubBlockType sub_blk_type = kHWWBIntfOutput;
   vector<LayerBufferFormat> supported_sdm_formats;
   sde_drm::DRMDisplayToken token;
+  sde_drm::DRMConnectorInfo connector_info;
   int ret = 0;
 
-  // Fake register
-  ret = drm_mgr_intf_->RegisterDisplay(sde_drm::DRMDisplayType::VIRTUAL, &token);
-  if (ret) {
-    if (ret != -ENODEV) {
-      DLOGE("Failed registering display %d. Error: %d.", sde_drm::DRMDisplayType::VIRTUAL, ret);
+  if (verify) {
+    // Displays may be active by now, so read the first virtual connector without reserving it.
+    sde_drm::DRMConnectorsInfo conns_info = {};
+    drm_mgr_intf_->GetConnectorsInfo(&conns_info);
+    auto iter = conns_info.begin();
+    while (iter != conns_info.end() && iter->second.type != DRM_MODE_CONNECTOR_VIRTUAL) {
+      iter++;
+    }
+    if (iter == conns_info.end()) {
+      return;
+    }
+    connector_info = iter->second;
+  } else {
+    // Fake register
+    ret = drm_mgr_intf_->RegisterDisplay(sde_drm::DRMDisplayType::VIRTUAL, &token);
+    if (ret) {
+      if (ret != -ENODEV) {
+        DLOGE("Failed registering display %d. Error: %d.", sde_drm::DRMDisplayType::VIRTUAL, ret);
+      }
+      return;
     }
-    return;
-  }
 
-  sde_drm::DRMConnectorInfo connector_info;
-  ret = drm_mgr_intf_->GetConnectorInfo(token.conn_id, &connector_info);
-  if (ret) {
-    DLOGE("Failed getting info for connector id %u. Error: %d.", token.conn_id, ret);
+    ret = drm_mgr_intf_->GetConnectorInfo(token.conn_id, &connector_info);
     drm_mgr_intf_->UnregisterDisplay(&token);
-    return;
+    if (ret) {
+      DLOGE("Failed getting info for connector id %u. Error: %d.", token.conn_id, ret);
+      return;
+    }
   }
+
   for (auto &fmts : connector_info.formats_supported) {
     GetSDMFormat(fmts.first, fmts.second, &supported_sdm_formats);
   }
 
   hw_resource->supported_formats_map.erase(sub_blk_type);
   hw_resource->supported_formats_map.insert(make_pair(sub_blk_type, supported_sdm_formats));
-
-  drm_mgr_intf_->UnregisterDisplay(&token);
 }
 
 void HWInfoDRM::GetSDMFormat(uint32_t v4l2_format, LayerBufferFormat *sdm_format) {
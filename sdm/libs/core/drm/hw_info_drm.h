@@ -35,9 +35,12 @@
 #include <drm_interface.h>
 #include <private/hw_info_types.h>
 #include <bitset>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "hw_info_interface.h"
+#include "hw_resource_snapshot.h"
 
 namespace sdm {
 
@@ -52,10 +55,14 @@ class HWInfoDRM: public HWInfoInterface {
 
  private:
   void Deinit();
+  void DiscoverHWResourceInfo(bool verify, HWResourceInfo *hw_resource);
+  void GetSnapshotKey(HWResourceSnapshotKey *key);
+  void VerifySnapshot(HWResourceSnapshotKey key, HWResourceInfo snapshot);
   DisplayError GetHWRotatorInfo(HWResourceInfo *hw_resource);
   void GetSystemInfo(HWResourceInfo *hw_resource);
   void GetHWPlanesInfo(HWResourceInfo *hw_resource);
-  void GetWBInfo(HWResourceInfo *hw_resource);
+  void GetWBInfo(bool verify, HWResourceInfo *hw_resource);
+  void GetInitStats(HWResourceInfo *hw_resource);
   DisplayError GetDynamicBWLimits(HWResourceInfo *hw_resource);
   void GetSDMFormat(uint32_t drm_format, uint64_t drm_format_modifier,
                     std::vector<LayerBufferFormat> *sdm_formats);
@@ -72,9 +79,12 @@ class HWInfoDRM: public HWInfoInterface {
 
   sde_drm::DRMManagerInterface *drm_mgr_intf_ = {};
   bool default_mode_ = false;
+  int dev_fd_ = -1;
+  std::thread verify_thread_;  // Rediscovers resources to check a snapshot used at startup
 
   static const int kMaxStringLength = 1024;
   static const int kKiloUnit = 1000;
+  static const char *kSnapshotPath;
 
   static HWResourceInfo *hw_resource_;
 };
@@ -0,0 +1,178 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <algorithm>
+#include <tuple>
+
+#include "hw_mode_index.h"
+
+namespace sdm {
+
+void HWModeIndex::Build(const std::vector<sde_drm::DRMModeInfo> &modes) {
+  uint32_t num_modes = UINT32(modes.size());
+  modes_.assign(num_modes, ModeInfo());
+  index_.clear();
+  timing_index_.clear();
+
+  for (uint32_t i = 0; i < num_modes; i++) {
+    const drmModeModeInfo &mode = modes[i].mode;
+    Key &key = modes_[i].key;
+    key.width = mode.hdisplay;
+    key.height = mode.vdisplay;
+    key.vrefresh = mode.vrefresh;
+    key.panel_mode = mode.flags & (DRM_MODE_FLAG_CMD_MODE_PANEL | DRM_MODE_FLAG_VID_MODE_PANEL);
+    key.bit_clk = modes[i].bit_clk_rate;
+    modes_[i].flags = mode.flags;
+
+    index_[key].push_back(i);
+    Key timing_key = key;
+    timing_key.bit_clk = 0;
+    timing_index_[timing_key].push_back(i);
+  }
+
+  for (uint32_t i = 0; i < num_modes; i++) {
+    ModeInfo &info = modes_[i];
+    uint32_t switch_mode_flag = 0;
+    if (info.key.panel_mode == DRM_MODE_FLAG_CMD_MODE_PANEL) {
+      switch_mode_flag = DRM_MODE_FLAG_VID_MODE_PANEL;
+    } else if (info.key.panel_mode == DRM_MODE_FLAG_VID_MODE_PANEL) {
+      switch_mode_flag = DRM_MODE_FLAG_CMD_MODE_PANEL;
+    }
+
+    info.min_fps = info.key.vrefresh;
+    info.max_fps = info.key.vrefresh;
+    // Prefer a switch mode with the same fps. Otherwise fall back to the one with lowest fps,
+    // to handle panels with multiple video mode fps but only one command mode for doze.
+    uint32_t switch_fps = 0;
+    bool same_fps = false;
+    for (uint32_t j = 0; j < num_modes; j++) {
+      const Key &key = modes_[j].key;
+      if (key.width != info.key.width || key.height != info.key.height) {
+        continue;
+      }
+      info.min_fps = std::min(info.min_fps, key.vrefresh);
+      info.max_fps = std::max(info.max_fps, key.vrefresh);
+      if (same_fps || !(switch_mode_flag & modes_[j].flags)) {
+        continue;
+      }
+      if (key.vrefresh == info.key.vrefresh) {
+        info.switch_index = INT(j);
+        same_fps = true;
+      } else if (!switch_fps || switch_fps > key.vrefresh) {
+        info.switch_index = INT(j);
+        switch_fps = key.vrefresh;
+      }
+    }
+  }
+}
+
+bool HWModeIndex::Find(const Key &key, bool match_flags, uint32_t flags, uint32_t *index) const {
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    return false;
+  }
+
+  for (uint32_t mode_index : it->second) {
+    if (!match_flags || (modes_[mode_index].flags == flags)) {
+      *index = mode_index;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool HWModeIndex::FindAnyPanelMode(const Key &key, uint32_t *index) const {
+  const uint32_t panel_modes[] = {0, DRM_MODE_FLAG_CMD_MODE_PANEL, DRM_MODE_FLAG_VID_MODE_PANEL,
+                                  DRM_MODE_FLAG_CMD_MODE_PANEL | DRM_MODE_FLAG_VID_MODE_PANEL};
+  bool found = false;
+
+  for (uint32_t panel_mode : panel_modes) {
+    Key panel_key = key;
+    panel_key.panel_mode = panel_mode;
+    uint32_t mode_index = 0;
+    if (Find(panel_key, false /* match_flags */, 0, &mode_index) &&
+        (!found || mode_index < *index)) {
+      *index = mode_index;
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+HWModeIndex::Transition HWModeIndex::GetTransition(uint32_t from, uint32_t to) const {
+  if (from == to) {
+    return kTransitionNone;
+  }
+
+  const Key &from_key = modes_[from].key;
+  const Key &to_key = modes_[to].key;
+  if ((from_key.width != to_key.width) || (from_key.height != to_key.height) ||
+      (from_key.panel_mode != to_key.panel_mode)) {
+    return kTransitionModeset;
+  }
+
+  if (from_key.bit_clk == to_key.bit_clk) {
+    return kTransitionVRefresh;
+  }
+
+  if (from_key.vrefresh == to_key.vrefresh) {
+    return kTransitionBitClk;
+  }
+
+  return kTransitionModeset;
+}
+
+uint32_t HWModeIndex::PlanSwitch(uint32_t from, uint32_t to, Transition *transition) const {
+  Key timing_key = modes_[to].key;
+  timing_key.bit_clk = 0;
+  uint32_t best = to;
+  // Cheapest transition first, then staying on the current DSI clock, then the requested mode.
+  auto cost = [&](uint32_t index) {
+    bool bit_clk_change = (modes_[index].key.bit_clk != modes_[from].key.bit_clk);
+    return std::make_tuple(GetTransition(from, index), bit_clk_change, index != to, index);
+  };
+
+  auto it = timing_index_.find(timing_key);
+  if (it != timing_index_.end()) {
+    for (uint32_t index : it->second) {
+      if (cost(index) < cost(best)) {
+        best = index;
+      }
+    }
+  }
+
+  *transition = GetTransition(from, best);
+
+  return best;
+}
+
+void HWModeIndex::GetFpsRange(uint32_t index, uint32_t *min_fps, uint32_t *max_fps) const {
+  *min_fps = modes_[index].min_fps;
+  *max_fps = modes_[index].max_fps;
+}
+
+}  // namespace sdm
@@ -0,0 +1,102 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef __HW_MODE_INDEX_H__
+#define __HW_MODE_INDEX_H__
+
+#include <drm_interface.h>
+#include <xf86drmMode.h>
+#include <unordered_map>
+#include <vector>
+
+#include <utils/constants.h>
+#include <utils/utils.h>
+
+namespace sdm {
+
+// Lookup structures over a connector mode list, built once per connector info load so that mode
+// switches, refresh rate and DSI clock changes do not scan every mode.
+class HWModeIndex {
+ public:
+  // Kind of switch needed between two connector modes, ordered from cheapest to costliest.
+  enum Transition {
+    kTransitionNone,
+    kTransitionVRefresh,  // Same timing family, refresh rate change only.
+    kTransitionBitClk,    // Same timing family, dynamic DSI clock change only.
+    kTransitionModeset,   // Resolution/panel mode change or both rate and clock change.
+  };
+
+  struct Key {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t vrefresh = 0;
+    uint32_t panel_mode = 0;  // DRM_MODE_FLAG_VID_MODE_PANEL or DRM_MODE_FLAG_CMD_MODE_PANEL.
+    uint64_t bit_clk = 0;
+
+    bool operator==(const Key &key) const {
+      return (width == key.width) && (height == key.height) && (vrefresh == key.vrefresh) &&
+             (panel_mode == key.panel_mode) && (bit_clk == key.bit_clk);
+    }
+  };
+
+  void Build(const std::vector<sde_drm::DRMModeInfo> &modes);
+  uint32_t GetModeCount() const { return UINT32(modes_.size()); }
+  size_t GetGroupCount() const { return index_.size(); }
+  Key GetKey(uint32_t index) const { return modes_[index].key; }
+  // Finds the first mode matching key. If match_flags is set, mode flags must equal flags.
+  bool Find(const Key &key, bool match_flags, uint32_t flags, uint32_t *index) const;
+  // Finds the first mode matching key in any panel mode.
+  bool FindAnyPanelMode(const Key &key, uint32_t *index) const;
+  Transition GetTransition(uint32_t from, uint32_t to) const;
+  // Picks the mode with the timing, refresh rate and panel mode of to that is cheapest to reach
+  // from the mode from, preferring the current DSI clock and then to itself.
+  uint32_t PlanSwitch(uint32_t from, uint32_t to, Transition *transition) const;
+  // Counterpart of index in the other panel mode for doze and POMS, -1 if there is none.
+  int GetSwitchIndex(uint32_t index) const { return modes_[index].switch_index; }
+  // Refresh rate range over the modes with the resolution of index.
+  void GetFpsRange(uint32_t index, uint32_t *min_fps, uint32_t *max_fps) const;
+
+ private:
+  struct KeyHash {
+    size_t operator()(const Key &key) const { return size_t(HashValue(key)); }
+  };
+
+  struct ModeInfo {
+    Key key = {};
+    uint32_t flags = 0;
+    int switch_index = -1;
+    uint32_t min_fps = 0;
+    uint32_t max_fps = 0;
+  };
+
+  std::vector<ModeInfo> modes_ = {};
+  // Modes by key, and by key without the bit clock, in mode list order.
+  std::unordered_map<Key, std::vector<uint32_t>, KeyHash> index_ = {};
+  std::unordered_map<Key, std::vector<uint32_t>, KeyHash> timing_index_ = {};
+};
+
+}  // namespace sdm
+
+#endif  // __HW_MODE_INDEX_H__
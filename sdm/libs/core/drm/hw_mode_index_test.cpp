@@ -0,0 +1,239 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "hw_mode_index.h"
+
+using namespace sdm;
+
+namespace {
+
+const uint32_t kVid = DRM_MODE_FLAG_VID_MODE_PANEL;
+const uint32_t kCmd = DRM_MODE_FLAG_CMD_MODE_PANEL;
+const uint64_t kBitClks[] = {1100000000, 1150000000, 1200000000, 1250000000};
+
+sde_drm::DRMModeInfo MakeMode(uint16_t width, uint16_t height, uint32_t vrefresh,
+                              uint32_t panel_mode, uint64_t bit_clk) {
+  sde_drm::DRMModeInfo mode_info = {};
+  mode_info.mode.hdisplay = width;
+  mode_info.mode.vdisplay = height;
+  mode_info.mode.vrefresh = vrefresh;
+  mode_info.mode.flags = panel_mode;
+  mode_info.bit_clk_rate = bit_clk;
+  return mode_info;
+}
+
+// Two resolutions, four refresh rates, both panel modes and four DSI clocks: 64 modes.
+std::vector<sde_drm::DRMModeInfo> Make64Modes() {
+  std::vector<sde_drm::DRMModeInfo> modes;
+  const uint16_t widths[] = {1080, 1440};
+  const uint16_t heights[] = {2400, 3200};
+  for (int res = 0; res < 2; res++) {
+    for (uint32_t vrefresh : {60, 90, 120, 144}) {
+      for (uint32_t panel_mode : {kVid, kCmd}) {
+        for (uint64_t bit_clk : kBitClks) {
+          modes.push_back(MakeMode(widths[res], heights[res], vrefresh, panel_mode, bit_clk));
+        }
+      }
+    }
+  }
+  return modes;
+}
+
+bool SameTiming(const drmModeModeInfo &a, const drmModeModeInfo &b) {
+  return (a.hdisplay == b.hdisplay) && (a.vdisplay == b.vdisplay) && (a.vrefresh == b.vrefresh);
+}
+
+// The scan SetDisplaySwitchMode() did before the index: the first mode with the requested timing
+// and panel mode at the current bit clock, or the requested mode itself.
+uint32_t ScanSwitch(const std::vector<sde_drm::DRMModeInfo> &modes, uint32_t from, uint32_t to) {
+  uint32_t mode_flag = modes[to].mode.flags & (kVid | kCmd);
+  for (uint32_t i = 0; i < modes.size(); i++) {
+    if (SameTiming(modes[i].mode, modes[to].mode) &&
+        (modes[i].bit_clk_rate == modes[from].bit_clk_rate) && (mode_flag & modes[i].mode.flags)) {
+      return i;
+    }
+  }
+  return to;
+}
+
+}  // namespace
+
+class HWModeIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    modes_ = Make64Modes();
+    index_.Build(modes_);
+  }
+
+  uint32_t Index(uint32_t width, uint32_t vrefresh, uint32_t panel_mode, uint64_t bit_clk) {
+    for (uint32_t i = 0; i < modes_.size(); i++) {
+      const drmModeModeInfo &mode = modes_[i].mode;
+      if ((mode.hdisplay == width) && (mode.vrefresh == vrefresh) && (mode.flags == panel_mode) &&
+          (modes_[i].bit_clk_rate == bit_clk)) {
+        return i;
+      }
+    }
+    ADD_FAILURE() << "no mode " << width << " " << vrefresh;
+    return 0;
+  }
+
+  std::vector<sde_drm::DRMModeInfo> modes_;
+  HWModeIndex index_;
+};
+
+TEST_F(HWModeIndexTest, EveryModeFindsItself) {
+  ASSERT_EQ(64u, index_.GetModeCount());
+  EXPECT_EQ(64u, index_.GetGroupCount());
+
+  for (uint32_t i = 0; i < modes_.size(); i++) {
+    uint32_t found = UINT32(modes_.size());
+    ASSERT_TRUE(index_.Find(index_.GetKey(i), true /* match_flags */, modes_[i].mode.flags,
+                            &found));
+    EXPECT_EQ(i, found);
+    EXPECT_FALSE(index_.Find(index_.GetKey(i), true /* match_flags */, 0, &found));
+
+    uint32_t min_fps = 0, max_fps = 0;
+    index_.GetFpsRange(i, &min_fps, &max_fps);
+    EXPECT_EQ(60u, min_fps);
+    EXPECT_EQ(144u, max_fps);
+  }
+}
+
+TEST_F(HWModeIndexTest, FirstDuplicateWins) {
+  modes_.push_back(modes_[5]);
+  modes_.back().mode.flags |= DRM_MODE_FLAG_NHSYNC;
+  index_.Build(modes_);
+
+  uint32_t found = 0;
+  ASSERT_TRUE(index_.Find(index_.GetKey(64), false /* match_flags */, 0, &found));
+  EXPECT_EQ(5u, found);
+  ASSERT_TRUE(index_.Find(index_.GetKey(64), true /* match_flags */, modes_[64].mode.flags,
+                          &found));
+  EXPECT_EQ(64u, found);
+}
+
+TEST_F(HWModeIndexTest, FindAnyPanelModeIgnoresPanelMode) {
+  uint32_t cmd_90 = Index(1080, 90, kCmd, kBitClks[2]);
+  HWModeIndex::Key key = index_.GetKey(Index(1080, 60, kVid, kBitClks[2]));
+  key.vrefresh = 90;
+
+  // The video mode 90Hz entry comes first in the mode list.
+  uint32_t found = 0;
+  ASSERT_TRUE(index_.FindAnyPanelMode(key, &found));
+  EXPECT_EQ(Index(1080, 90, kVid, kBitClks[2]), found);
+
+  modes_.erase(modes_.begin() + Index(1080, 90, kVid, kBitClks[2]));
+  index_.Build(modes_);
+  ASSERT_TRUE(index_.FindAnyPanelMode(key, &found));
+  EXPECT_EQ(cmd_90 - 1, found);
+
+  key.vrefresh = 75;
+  EXPECT_FALSE(index_.FindAnyPanelMode(key, &found));
+}
+
+TEST_F(HWModeIndexTest, ClassifiesTransitions) {
+  uint32_t from = Index(1080, 60, kVid, kBitClks[0]);
+
+  EXPECT_EQ(HWModeIndex::kTransitionNone, index_.GetTransition(from, from));
+  EXPECT_EQ(HWModeIndex::kTransitionVRefresh,
+            index_.GetTransition(from, Index(1080, 120, kVid, kBitClks[0])));
+  EXPECT_EQ(HWModeIndex::kTransitionBitClk,
+            index_.GetTransition(from, Index(1080, 60, kVid, kBitClks[3])));
+  EXPECT_EQ(HWModeIndex::kTransitionModeset,
+            index_.GetTransition(from, Index(1080, 120, kVid, kBitClks[3])));
+  EXPECT_EQ(HWModeIndex::kTransitionModeset,
+            index_.GetTransition(from, Index(1080, 60, kCmd, kBitClks[0])));
+  EXPECT_EQ(HWModeIndex::kTransitionModeset,
+            index_.GetTransition(from, Index(1440, 60, kVid, kBitClks[0])));
+}
+
+TEST_F(HWModeIndexTest, PlansCheapestTransition) {
+  uint32_t from = Index(1080, 60, kVid, kBitClks[1]);
+  HWModeIndex::Transition transition = HWModeIndex::kTransitionNone;
+
+  // A refresh rate request at another clock is served on the current clock instead.
+  uint32_t planned = index_.PlanSwitch(from, Index(1080, 120, kVid, kBitClks[3]), &transition);
+  EXPECT_EQ(Index(1080, 120, kVid, kBitClks[1]), planned);
+  EXPECT_EQ(HWModeIndex::kTransitionVRefresh, transition);
+
+  // The current mode already has the requested timing, clock changes go through
+  // SetDynamicDSIClock() instead.
+  planned = index_.PlanSwitch(from, Index(1080, 60, kVid, kBitClks[2]), &transition);
+  EXPECT_EQ(from, planned);
+  EXPECT_EQ(HWModeIndex::kTransitionNone, transition);
+
+  // A resolution switch is a modeset either way, but the clock is kept.
+  planned = index_.PlanSwitch(from, Index(1440, 90, kVid, kBitClks[3]), &transition);
+  EXPECT_EQ(Index(1440, 90, kVid, kBitClks[1]), planned);
+  EXPECT_EQ(HWModeIndex::kTransitionModeset, transition);
+
+  // Without the current clock at the new rate the requested mode is kept.
+  modes_.erase(modes_.begin() + Index(1080, 120, kVid, kBitClks[1]));
+  index_.Build(modes_);
+  from = Index(1080, 60, kVid, kBitClks[1]);
+  uint32_t to = Index(1080, 120, kVid, kBitClks[3]);
+  planned = index_.PlanSwitch(from, to, &transition);
+  EXPECT_EQ(to, planned);
+  EXPECT_EQ(HWModeIndex::kTransitionModeset, transition);
+}
+
+TEST_F(HWModeIndexTest, PlanMatchesModeListScan) {
+  HWModeIndex::Transition transition = HWModeIndex::kTransitionNone;
+
+  for (uint32_t from = 0; from < modes_.size(); from++) {
+    for (uint32_t to = 0; to < modes_.size(); to++) {
+      uint32_t planned = index_.PlanSwitch(from, to, &transition);
+      ASSERT_EQ(ScanSwitch(modes_, from, to), planned) << from << " -> " << to;
+      ASSERT_EQ(index_.GetTransition(from, planned), transition);
+      // Nothing with the requested timing and panel mode would have been cheaper.
+      for (uint32_t i = 0; i < modes_.size(); i++) {
+        if (SameTiming(modes_[i].mode, modes_[to].mode) &&
+            (modes_[i].mode.flags == modes_[to].mode.flags)) {
+          ASSERT_LE(transition, index_.GetTransition(from, i)) << from << " -> " << to;
+        }
+      }
+    }
+  }
+}
+
+TEST_F(HWModeIndexTest, SwitchModeCounterpart) {
+  uint32_t vid_90 = Index(1080, 90, kVid, kBitClks[0]);
+  EXPECT_EQ(INT(Index(1080, 90, kCmd, kBitClks[0])), index_.GetSwitchIndex(vid_90));
+
+  // Only a 60Hz command mode for doze: every video mode switches to it.
+  std::vector<sde_drm::DRMModeInfo> modes;
+  for (uint32_t vrefresh : {60, 90, 120}) {
+    modes.push_back(MakeMode(1080, 2400, vrefresh, kVid, kBitClks[0]));
+  }
+  modes.push_back(MakeMode(1080, 2400, 60, kCmd, kBitClks[0]));
+  index_.Build(modes);
+  for (uint32_t i = 0; i < 3; i++) {
+    EXPECT_EQ(3, index_.GetSwitchIndex(i));
+  }
+  EXPECT_EQ(0, index_.GetSwitchIndex(3));
+}
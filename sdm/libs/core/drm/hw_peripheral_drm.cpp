@@ -200,6 +200,9 @@ DisplayError HWPeripheralDRM::Commit(HWLayers *hw_layers) {
     return error;
   }
 
+  // Step an active brightness ramp with the content of this commit.
+  brightness_engine_.Latch(HWBrightnessEngine::Now(), false /* vsync */);
+
   if (has_fence) {
     hw_layer_info.stack->output_buffer->release_fence = Fence::Create(INT(cwb_fence_fd),
                                                                       "release_cwb");
@@ -571,6 +574,7 @@ DisplayError HWPeripheralDRM::PowerOff(bool teardown) {
 
   pending_poms_switch_ = false;
   active_ = false;
+  brightness_engine_.Cancel();
 
   return kErrorNone;
 }
@@ -684,42 +688,33 @@ DisplayError HWPeripheralDRM::SetFrameTrigger(FrameTriggerMode mode) {
 }
 
 DisplayError HWPeripheralDRM::SetPanelBrightness(int level) {
+  return SetPanelBrightnessRamp(level, 0);
+}
+
+DisplayError HWPeripheralDRM::SetPanelBrightnessRamp(int level, uint32_t duration_ms) {
   if (pending_doze_) {
     DLOGI("Doze state pending!! Skip for now");
     return kErrorDeferred;
   }
 
-  char buffer[kMaxSysfsCommandLength] = {0};
-
   if (brightness_base_path_.empty()) {
     return kErrorHardware;
   }
 
-  std::string brightness_node(brightness_base_path_ + "brightness");
-  int fd = Sys::open_(brightness_node.c_str(), O_RDWR);
-  if (fd < 0) {
-    DLOGE("Failed to open node = %s, error = %s ", brightness_node.c_str(),
-          strerror(errno));
-    return kErrorFileDescriptor;
-  }
+  return brightness_engine_.SetTarget(level, duration_ms, HWBrightnessEngine::Now());
+}
 
-  int32_t bytes = snprintf(buffer, kMaxSysfsCommandLength, "%d\n", level);
-  ssize_t ret = Sys::pwrite_(fd, buffer, static_cast<size_t>(bytes), 0);
-  if (ret <= 0) {
-    DLOGE("Failed to write to node = %s, error = %s ", brightness_node.c_str(),
-          strerror(errno));
-    Sys::close_(fd);
-    return kErrorHardware;
+DisplayError HWPeripheralDRM::LatchPanelBrightness(int64_t timestamp, bool *ramp_pending) {
+  if (!ramp_pending) {
+    return kErrorParameters;
   }
 
-  Sys::close_(fd);
+  *ramp_pending = brightness_engine_.Latch(timestamp, true /* vsync */);
 
   return kErrorNone;
 }
 
 DisplayError HWPeripheralDRM::GetPanelBrightness(int *level) {
-  char value[kMaxStringLength] = {0};
-
   if (!level) {
     DLOGE("Invalid input, null pointer.");
     return kErrorParameters;
@@ -729,25 +724,7 @@ DisplayError HWPeripheralDRM::GetPanelBrightness(int *level) {
     return kErrorHardware;
   }
 
-  std::string brightness_node(brightness_base_path_ + "brightness");
-  int fd = Sys::open_(brightness_node.c_str(), O_RDWR);
-  if (fd < 0) {
-    DLOGE("Failed to open brightness node = %s, error = %s", brightness_node.c_str(),
-           strerror(errno));
-    return kErrorFileDescriptor;
-  }
-
-  if (Sys::pread_(fd, value, sizeof(value), 0) > 0) {
-    *level = atoi(value);
-  } else {
-    DLOGE("Failed to read panel brightness");
-    Sys::close_(fd);
-    return kErrorHardware;
-  }
-
-  Sys::close_(fd);
-
-  return kErrorNone;
+  return brightness_engine_.GetLevel(level);
 }
 
 void HWPeripheralDRM::GetHWPanelMaxBrightness() {
@@ -766,18 +743,18 @@ void HWPeripheralDRM::GetHWPanelMaxBrightness() {
   if (fd < 0) {
     DLOGE("Failed to open max brightness node = %s, error = %s", brightness_node.c_str(),
           strerror(errno));
-    return;
-  }
-
-  if (Sys::pread_(fd, value, sizeof(value), 0) > 0) {
-    hw_panel_info_.panel_max_brightness = static_cast<float>(atof(value));
-    DLOGI_IF(kTagDriverConfig, "Max brightness = %f", hw_panel_info_.panel_max_brightness);
   } else {
-    DLOGE("Failed to read max brightness. error = %s", strerror(errno));
+    if (Sys::pread_(fd, value, sizeof(value), 0) > 0) {
+      hw_panel_info_.panel_max_brightness = static_cast<float>(atof(value));
+      DLOGI_IF(kTagDriverConfig, "Max brightness = %f", hw_panel_info_.panel_max_brightness);
+    } else {
+      DLOGE("Failed to read max brightness. error = %s", strerror(errno));
+    }
+    Sys::close_(fd);
   }
 
-  Sys::close_(fd);
-  return;
+  brightness_engine_.Init(brightness_base_path_ + "brightness",
+                          static_cast<int>(hw_panel_info_.panel_max_brightness));
 }
 
 DisplayError HWPeripheralDRM::SetBLScale(uint32_t level) {
@@ -787,6 +764,9 @@ DisplayError HWPeripheralDRM::SetBLScale(uint32_t level) {
     DLOGE("Failed to set backlight scale level %d, ret %d", level, ret);
     return kErrorUndefined;
   }
+
+  // The scale is applied by the next commit; keep ramp steps for that commit too.
+  brightness_engine_.HoldForCommit();
   return kErrorNone;
 }
 
@@ -33,6 +33,7 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include <string>
 #include "hw_device_drm.h"
+#include "hw_brightness_engine.h"
 
 namespace sdm {
 
@@ -69,6 +70,8 @@ class HWPeripheralDRM : public HWDeviceDRM {
   virtual DisplayError TeardownConcurrentWriteback(void);
   virtual DisplayError SetFrameTrigger(FrameTriggerMode mode);
   virtual DisplayError SetPanelBrightness(int level);
+  virtual DisplayError SetPanelBrightnessRamp(int level, uint32_t duration_ms);
+  virtual DisplayError LatchPanelBrightness(int64_t timestamp, bool *ramp_pending);
   virtual DisplayError GetPanelBrightness(int *level);
   virtual void GetHWPanelMaxBrightness();
   virtual DisplayError SetBLScale(uint32_t level);
@@ -105,6 +108,7 @@ class HWPeripheralDRM : public HWDeviceDRM {
   void PopulateBitClkRates();
   std::vector<uint64_t> bitclk_rates_;
   std::string brightness_base_path_ = "";
+  HWBrightnessEngine brightness_engine_;
 };
 
 }  // namespace sdm
@@ -29,7 +29,7 @@
 
 #include "hw_tv_drm.h"
 #include <math.h>
-#include <sys/time.h>
+#include <time.h>
 #include <utils/debug.h>
 #include <utils/sys.h>
 #include <utils/formats.h>
@@ -44,19 +44,8 @@
 #include <map>
 #include <utility>
 
-#ifndef HDR_EOTF_SMTPE_ST2084
-#define HDR_EOTF_SMTPE_ST2084 2
-#endif
-#ifndef HDR_EOTF_HLG
-#define HDR_EOTF_HLG 3
-#endif
-
 #define __CLASS__ "HWTVDRM"
 
-#define HDR_DISABLE 0
-#define HDR_ENABLE 1
-#define MIN_HDR_RESET_WAITTIME 2
-
 using drm_utils::DRMMaster;
 using drm_utils::DRMResMgr;
 using drm_utils::DRMLibLoader;
@@ -74,23 +63,6 @@ using sde_drm::DRMColorspace;
 
 namespace sdm {
 
-static int32_t GetEOTF(const GammaTransfer &transfer) {
-  int32_t hdr_transfer = -1;
-
-  switch (transfer) {
-  case Transfer_SMPTE_ST2084:
-    hdr_transfer = HDR_EOTF_SMTPE_ST2084;
-    break;
-  case Transfer_HLG:
-    hdr_transfer = HDR_EOTF_HLG;
-    break;
-  default:
-    DLOGW("Unknown Transfer: %d", transfer);
-  }
-
-  return hdr_transfer;
-}
-
 static float GetMaxOrAverageLuminance(float luminance) {
   return (50.0f * powf(2.0f, (luminance / 32.0f)));
 }
@@ -166,11 +138,7 @@ DisplayError HWTVDRM::GetConfigIndex(char *mode, uint32_t *index) {
 
 DisplayError HWTVDRM::Deinit() {
   if (hw_panel_info_.hdr_enabled) {
-    memset(&hdr_metadata_, 0, sizeof(hdr_metadata_));
-    hdr_metadata_.hdr_supported = 1;
-    hdr_metadata_.hdr_state = HDR_DISABLE;
-    drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id,
-                              &hdr_metadata_);
+    hdr_metadata_drm_.Disable(drm_atomic_intf_, token_.conn_id);
   }
 
   return HWDeviceDRM::Deinit();
@@ -272,7 +240,14 @@ DisplayError HWTVDRM::Commit(HWLayers *hw_layers) {
   if (error != kErrorNone) {
     return error;
   }
-  return HWDeviceDRM::Commit(hw_layers);
+
+  error = HWDeviceDRM::Commit(hw_layers);
+  if (error != kErrorNone) {
+    // The sink did not get the metadata staged for this frame, send it again on the next one.
+    hdr_metadata_drm_.Invalidate();
+  }
+
+  return error;
 }
 
 DisplayError HWTVDRM::UpdateHDRMetaData(HWLayers *hw_layers) {
@@ -299,140 +274,13 @@ DisplayError HWTVDRM::UpdateHDRMetaData(HWLayers *hw_layers) {
     return kErrorNone;
   }
 
-  const HWHDRLayerInfo &hdr_layer_info = hw_layers->info.hdr_layer_info;
-  DisplayError error = kErrorNone;
-  HWHDRLayerInfo::HDROperation hdr_op = hdr_layer_info.operation;
-
-  Layer hdr_layer = {};
-  if (hdr_op == HWHDRLayerInfo::kSet && hdr_layer_info.layer_index > -1) {
-    hdr_layer = *(hw_layers->info.stack->layers.at(UINT32(hdr_layer_info.layer_index)));
-  }
-
-  const LayerBuffer *layer_buffer = &hdr_layer.input_buffer;
-  const MasteringDisplay &mastering_display = layer_buffer->color_metadata.masteringDisplayInfo;
-  const ContentLightLevel &light_level = layer_buffer->color_metadata.contentLightLevel;
-  const Primaries &primaries = mastering_display.primaries;
-
-  if (hdr_op == HWHDRLayerInfo::kSet && hdr_layer_info.hdr_layers.size() == 1) {
-    // Reset reset_hdr_flag_ to handle where there are two consecutive HDR video playbacks with not
-    // enough non-HDR frames in between to reset the HDR metadata.
-    reset_hdr_flag_ = false;
-    in_multiset_ = false;
-
-    int32_t eotf = GetEOTF(layer_buffer->color_metadata.transfer);
-    hdr_metadata_.hdr_supported = 1;
-    hdr_metadata_.hdr_state = HDR_ENABLE;
-    hdr_metadata_.eotf = (eotf < 0) ? 0 : UINT32(eotf);
-    hdr_metadata_.white_point_x = primaries.whitePoint[0];
-    hdr_metadata_.white_point_y = primaries.whitePoint[1];
-    hdr_metadata_.display_primaries_x[0] = primaries.rgbPrimaries[0][0];
-    hdr_metadata_.display_primaries_y[0] = primaries.rgbPrimaries[0][1];
-    hdr_metadata_.display_primaries_x[1] = primaries.rgbPrimaries[1][0];
-    hdr_metadata_.display_primaries_y[1] = primaries.rgbPrimaries[1][1];
-    hdr_metadata_.display_primaries_x[2] = primaries.rgbPrimaries[2][0];
-    hdr_metadata_.display_primaries_y[2] = primaries.rgbPrimaries[2][1];
-    hdr_metadata_.min_luminance = mastering_display.minDisplayLuminance;
-    hdr_metadata_.max_luminance = mastering_display.maxDisplayLuminance;
-    hdr_metadata_.max_content_light_level = light_level.maxContentLightLevel;
-    hdr_metadata_.max_average_light_level = light_level.minPicAverageLightLevel;
-    if (hw_panel_info_.hdr_plus_enabled && hdr_layer_info.dyn_hdr_vsif_payload.size()) {
-      hdr_metadata_.hdr_plus_payload = reinterpret_cast<uint64_t>
-                                        (hdr_layer_info.dyn_hdr_vsif_payload.data());
-      hdr_metadata_.hdr_plus_payload_size = UINT32(hdr_layer_info.dyn_hdr_vsif_payload.size());
-    } else {
-      hdr_metadata_.hdr_plus_payload = reinterpret_cast<uint64_t>(nullptr);
-      hdr_metadata_.hdr_plus_payload_size = 0;
-    }
+  struct timespec now = {};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t now_ms = (int64_t(now.tv_sec) * 1000) + (now.tv_nsec / 1000000);
+  hdr_metadata_drm_.Update(drm_atomic_intf_, token_.conn_id, hw_layers->info.hdr_layer_info,
+                           hw_layers->info.stack, hw_panel_info_.hdr_plus_enabled, now_ms);
 
-    drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id, &hdr_metadata_);
-    DumpHDRMetaData(hdr_op);
-  } else if (hdr_op == HWHDRLayerInfo::kSet && !in_multiset_) {
-    // Special case to handle multiple HDR layers.
-    // If there are multiple HDR layers, then simply drop all metadata (which is optional) since
-    // content going in and out of view (e.g., video start/stop, scrolling video preview thumbnails)
-    // will cause flicker.
-    InitMaxHDRMetaData();
-    in_multiset_ = true;
-    reset_hdr_flag_ = false;
-    drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id, &hdr_metadata_);
-    DumpHDRMetaData(hdr_op);
-  } else if (hdr_op == HWHDRLayerInfo::kReset) {
-    memset(&hdr_metadata_, 0, sizeof(hdr_metadata_));
-    hdr_metadata_.hdr_supported = 1;
-    hdr_metadata_.hdr_state = HDR_ENABLE;
-    reset_hdr_flag_ = true;
-    in_multiset_ = false;
-    gettimeofday(&hdr_reset_start_, NULL);
-
-    drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id, &hdr_metadata_);
-    DumpHDRMetaData(hdr_op);
-  } else if (hdr_op == HWHDRLayerInfo::kNoOp) {
-    // TODO(user): This case handles the state transition from HDR_ENABLED to HDR_DISABLED.
-    // As per HDMI spec requirement, we need to send zero metadata for atleast 2 sec after end of
-    // playback. This timer calculates the 2 sec window after playback stops to stop sending HDR
-    // metadata. This will be replaced with an idle timer implementation in the future.
-    if (reset_hdr_flag_) {
-      gettimeofday(&hdr_reset_end_, NULL);
-      float hdr_reset_time_start = ((hdr_reset_start_.tv_sec * 1000) +
-                                    (hdr_reset_start_.tv_usec / 1000));
-      float hdr_reset_time_end = ((hdr_reset_end_.tv_sec * 1000) + (hdr_reset_end_.tv_usec / 1000));
-
-      if (((hdr_reset_time_end - hdr_reset_time_start) / 1000) >= MIN_HDR_RESET_WAITTIME) {
-        memset(&hdr_metadata_, 0, sizeof(hdr_metadata_));
-        hdr_metadata_.hdr_supported = 1;
-        hdr_metadata_.hdr_state = HDR_DISABLE;
-        reset_hdr_flag_ = false;
-
-        drm_atomic_intf_->Perform(DRMOps::CONNECTOR_SET_HDR_METADATA, token_.conn_id,
-                                  &hdr_metadata_);
-      }
-    }
-  }
-
-  return error;
-}
-
-void HWTVDRM::DumpHDRMetaData(HWHDRLayerInfo::HDROperation operation) {
-  DLOGI("Operation = %d, HDR Metadata: MaxDisplayLuminance = %d MinDisplayLuminance = %d\n"
-        "MaxContentLightLevel = %d MaxAverageLightLevel = %d Red_x = %d Red_y = %d Green_x = %d\n"
-        "Green_y = %d Blue_x = %d Blue_y = %d WhitePoint_x = %d WhitePoint_y = %d EOTF = %d\n"
-        "HDR10+ payload size = %u\n",
-        operation, hdr_metadata_.max_luminance, hdr_metadata_.min_luminance,
-        hdr_metadata_.max_content_light_level, hdr_metadata_.max_average_light_level,
-        hdr_metadata_.display_primaries_x[0], hdr_metadata_.display_primaries_y[0],
-        hdr_metadata_.display_primaries_x[1], hdr_metadata_.display_primaries_y[1],
-        hdr_metadata_.display_primaries_x[2], hdr_metadata_.display_primaries_y[2],
-        hdr_metadata_.white_point_x, hdr_metadata_.white_point_y, hdr_metadata_.eotf,
-        hdr_metadata_.hdr_plus_payload_size);
-}
-
-void HWTVDRM::InitMaxHDRMetaData() {
-  memset(&hdr_metadata_, 0, sizeof(hdr_metadata_));
-  hdr_metadata_.hdr_supported = 1;
-  hdr_metadata_.hdr_state = HDR_ENABLE;
-  hdr_metadata_.eotf = UINT32(GetEOTF(Transfer_SMPTE_ST2084));
-  // Rec. 2020 (ITU-R Recommendation BT.2020) RGB color space parameters
-  // +---------------+-----------------+-----------------------------------------------+
-  // |               |   White point   |                Primary colors                 |
-  // |  Color space  +--------+--------+-------+-------+-------+-------+-------+-------+
-  // |               |   xW   |   yW   |  xR   |  yR   |  xG   |  yG   |  xB   |  yB   |
-  // +---------------+--------+--------+-------+-------+-------+-------+-------+-------+
-  // | ITU-R BT.2020 | 0.3127 | 0.3290 | 0.708 | 0.292 | 0.170 | 0.797 | 0.131 | 0.046 |
-  // +---------------+--------+--------+-------+-------+-------+-------+-------+-------+
-  // Rec. 2020 D65 'CIE Standard Illuminant'.
-  hdr_metadata_.white_point_x = 15635;                // 0.31271 x 50000
-  hdr_metadata_.white_point_y = 16451;                // 0.32902 x 50000
-  // Rec. 2020 primaries.
-  hdr_metadata_.display_primaries_x[0] = 35400;       // 0.708 x 50000
-  hdr_metadata_.display_primaries_y[0] = 14600;       // 0.292 x 50000
-  hdr_metadata_.display_primaries_x[1] = 8500;        // 0.170 x 50000
-  hdr_metadata_.display_primaries_y[1] = 39850;       // 0.797 x 50000
-  hdr_metadata_.display_primaries_x[2] = 6550;        // 0.131 x 50000
-  hdr_metadata_.display_primaries_y[2] = 2300;        // 0.046 x 50000
-  hdr_metadata_.min_luminance = 0;                    // 0 nits
-  hdr_metadata_.max_luminance = 100000000;            // 10000 nits
-  hdr_metadata_.max_content_light_level = 100000000;  // 10000 nits brightest pixel in content
-  hdr_metadata_.max_average_light_level = 100000000;  // 10000 nits brightest frame in content
+  return kErrorNone;
 }
 
 DisplayError HWTVDRM::PowerOn(const HWQosData &qos_data, shared_ptr<Fence> *release_fence) {
@@ -448,6 +296,9 @@ DisplayError HWTVDRM::PowerOn(const HWQosData &qos_data, shared_ptr<Fence> *rele
     drm_atomic_intf_->Perform(DRMOps::CRTC_SET_MODE, token_.crtc_id, &current_mode);
   }
 
+  // The sink may have been replugged or reset while off, resend HDR metadata on the next frame.
+  hdr_metadata_drm_.Invalidate();
+
   return HWDeviceDRM::PowerOn(qos_data, release_fence);
 }
 
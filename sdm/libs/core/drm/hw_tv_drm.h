@@ -29,6 +29,7 @@
 #include <vector>
 
 #include "hw_device_drm.h"
+#include "hw_hdr_metadata_drm.h"
 
 namespace sdm {
 
@@ -54,8 +55,6 @@ class HWTVDRM : public HWDeviceDRM {
 
  private:
   DisplayError UpdateHDRMetaData(HWLayers *hw_layers);
-  void DumpHDRMetaData(HWHDRLayerInfo::HDROperation operation);
-  void InitMaxHDRMetaData();
 
   static const int kBitRGB  = 20;
   static const int kBitYUV  = 21;
@@ -63,11 +62,7 @@ class HWTVDRM : public HWDeviceDRM {
   const float kDefaultMaxLuminance = 500.0f;
   const float kMinPeakLuminance = 300.0f;
   const float kMaxPeakLuminance = 1000.0f;
-  drm_msm_ext_hdr_metadata hdr_metadata_ = {};
-  struct timeval hdr_reset_start_ = {};
-  struct timeval hdr_reset_end_ = {};
-  bool reset_hdr_flag_ = false;
-  bool in_multiset_ = false;
+  HWHDRMetaDataDRM hdr_metadata_drm_;
 };
 
 }  // namespace sdm
@@ -198,6 +198,7 @@ DisplayError HWVirtualDRM::SetDisplayAttributes(const HWDisplayAttributes &displ
     DLOGE("Failed getting info for connector id %u. Error: %d.", token_.conn_id, ret);
     return kErrorHardware;
   }
+  BuildModeIndex();
   GetModeIndex(display_attributes, &mode_index);
 
   if (mode_index < 0) {
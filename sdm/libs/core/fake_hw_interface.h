@@ -0,0 +1,132 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __FAKE_HW_INTERFACE_H__
+#define __FAKE_HW_INTERFACE_H__
+
+#include <functional>
+#include <string>
+
+#include "hw_interface.h"
+
+namespace sdm {
+
+// HWInterface for unit tests. Every call succeeds; Validate() is counted and its verdict comes
+// from on_validate when set.
+class FakeHWInterface : public HWInterface {
+ public:
+  virtual ~FakeHWInterface() { }
+
+  virtual DisplayError Validate(HWLayers *hw_layers) {
+    validate_count++;
+    return on_validate ? on_validate(hw_layers) : kErrorNone;
+  }
+  virtual DisplayError Init() { return kErrorNone; }
+  virtual DisplayError Deinit() { return kErrorNone; }
+  virtual DisplayError GetDisplayId(int32_t *display_id) { return kErrorNone; }
+  virtual DisplayError GetActiveConfig(uint32_t *active_config) { return kErrorNone; }
+  virtual DisplayError GetDefaultConfig(uint32_t *default_config) { return kErrorNone; }
+  virtual DisplayError GetNumDisplayAttributes(uint32_t *count) { return kErrorNone; }
+  virtual DisplayError GetDisplayAttributes(uint32_t index,
+                                            HWDisplayAttributes *display_attributes) {
+    return kErrorNone;
+  }
+  virtual DisplayError GetHWPanelInfo(HWPanelInfo *panel_info) { return kErrorNone; }
+  virtual DisplayError SetDisplayAttributes(uint32_t index) { return kErrorNone; }
+  virtual DisplayError SetDisplayAttributes(const HWDisplayAttributes &display_attributes) {
+    return kErrorNone;
+  }
+  virtual DisplayError GetConfigIndex(char *mode, uint32_t *index) { return kErrorNone; }
+  virtual DisplayError PowerOn(const HWQosData &qos_data, shared_ptr<Fence> *release_fence) {
+    return kErrorNone;
+  }
+  virtual DisplayError PowerOff(bool teardown) { return kErrorNone; }
+  virtual DisplayError Doze(const HWQosData &qos_data, shared_ptr<Fence> *release_fence) {
+    return kErrorNone;
+  }
+  virtual DisplayError DozeSuspend(const HWQosData &qos_data, shared_ptr<Fence> *release_fence) {
+    return kErrorNone;
+  }
+  virtual DisplayError Standby() { return kErrorNone; }
+  virtual DisplayError Commit(HWLayers *hw_layers) { return kErrorNone; }
+  virtual DisplayError Flush(HWLayers *hw_layers) { return kErrorNone; }
+  virtual DisplayError GetPPFeaturesVersion(PPFeatureVersion *vers) { return kErrorNone; }
+  virtual DisplayError SetPPFeatures(PPFeaturesConfig *feature_list) { return kErrorNone; }
+  virtual DisplayError SetVSyncState(bool enable) { return kErrorNone; }
+  virtual void SetIdleTimeoutMs(uint32_t timeout_ms) { }
+  virtual DisplayError SetDisplayMode(const HWDisplayMode hw_display_mode) { return kErrorNone; }
+  virtual DisplayError SetRefreshRate(uint32_t refresh_rate) { return kErrorNone; }
+  virtual DisplayError SetPanelBrightness(int level) { return kErrorNone; }
+  virtual DisplayError SetPanelBrightnessRamp(int level, uint32_t duration_ms) {
+    return kErrorNone;
+  }
+  virtual DisplayError LatchPanelBrightness(int64_t timestamp, bool *ramp_pending) {
+    return kErrorNone;
+  }
+  virtual DisplayError GetHWScanInfo(HWScanInfo *scan_info) { return kErrorNone; }
+  virtual DisplayError GetVideoFormat(uint32_t config_index, uint32_t *video_format) {
+    return kErrorNone;
+  }
+  virtual DisplayError GetMaxCEAFormat(uint32_t *max_cea_format) { return kErrorNone; }
+  virtual DisplayError SetCursorPosition(HWLayers *hw_layers, int x, int y) { return kErrorNone; }
+  virtual DisplayError OnMinHdcpEncryptionLevelChange(uint32_t min_enc_level) { return kErrorNone; }
+  virtual DisplayError GetPanelBrightness(int *level) { return kErrorNone; }
+  virtual DisplayError SetAutoRefresh(bool enable) { return kErrorNone; }
+  virtual DisplayError SetScaleLutConfig(HWScaleLutInfo *lut_info) { return kErrorNone; }
+  virtual DisplayError UnsetScaleLutConfig() { return kErrorNone; }
+  virtual DisplayError SetMixerAttributes(const HWMixerAttributes &mixer_attributes) {
+    return kErrorNone;
+  }
+  virtual DisplayError GetMixerAttributes(HWMixerAttributes *mixer_attributes) {
+    return kErrorNone;
+  }
+  virtual DisplayError DumpDebugData() { return kErrorNone; }
+  virtual DisplayError SetDppsFeature(void *payload, size_t size) { return kErrorNone; }
+  virtual DisplayError GetDppsFeatureInfo(void *payload, size_t size) { return kErrorNone; }
+  virtual DisplayError HandleSecureEvent(SecureEvent secure_event, HWLayers *hw_layers) {
+    return kErrorNone;
+  }
+  virtual DisplayError ControlIdlePowerCollapse(bool enable, bool synchronous) {
+    return kErrorNone;
+  }
+  virtual DisplayError SetDisplayDppsAdROI(void *payload) { return kErrorNone; }
+  virtual DisplayError SetDynamicDSIClock(uint64_t bit_clk_rate) { return kErrorNone; }
+  virtual DisplayError GetDynamicDSIClock(uint64_t *bit_clk_rate) { return kErrorNone; }
+  virtual DisplayError TeardownConcurrentWriteback(void) { return kErrorNone; }
+  virtual DisplayError GetDisplayIdentificationData(uint8_t *out_port, uint32_t *out_data_size,
+                                                    uint8_t *out_data) {
+    return kErrorNone;
+  }
+  virtual DisplayError SetFrameTrigger(FrameTriggerMode mode) { return kErrorNone; }
+  virtual DisplayError SetBLScale(uint32_t level) { return kErrorNone; }
+  virtual DisplayError GetPanelBrightnessBasePath(std::string *base_path) { return kErrorNone; }
+  virtual DisplayError SetBlendSpace(const PrimariesTransfer &blend_space) { return kErrorNone; }
+
+  uint32_t validate_count = 0;
+  std::function<DisplayError(HWLayers *)> on_validate = nullptr;
+};
+
+}  // namespace sdm
+
+#endif  // __FAKE_HW_INTERFACE_H__
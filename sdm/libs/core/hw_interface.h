@@ -104,6 +104,8 @@ class HWInterface {
   virtual DisplayError SetDisplayMode(const HWDisplayMode hw_display_mode) = 0;
   virtual DisplayError SetRefreshRate(uint32_t refresh_rate) = 0;
   virtual DisplayError SetPanelBrightness(int level) = 0;
+  virtual DisplayError SetPanelBrightnessRamp(int level, uint32_t duration_ms) = 0;
+  virtual DisplayError LatchPanelBrightness(int64_t timestamp, bool *ramp_pending) = 0;
   virtual DisplayError GetHWScanInfo(HWScanInfo *scan_info) = 0;
   virtual DisplayError GetVideoFormat(uint32_t config_index, uint32_t *video_format) = 0;
   virtual DisplayError GetMaxCEAFormat(uint32_t *max_cea_format) = 0;
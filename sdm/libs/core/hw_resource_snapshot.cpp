@@ -0,0 +1,431 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/hash.h>
+
+#include <bitset>
+#include <fstream>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hw_resource_snapshot.h"
+
+#define __CLASS__ "HWResourceSnapshot"
+
+namespace sdm {
+
+const uint32_t HWResourceSnapshot::kVersion;
+
+static const uint32_t kSnapshotMagic = 0x48524453;  // "SDRH"
+static const size_t kMaxSnapshotSize = 1 << 20;
+
+// Appends fields to a byte string. Scalars are copied as is, containers are prefixed with their
+// element count and structs are expanded through Transfer() below.
+class SnapshotWriter {
+ public:
+  explicit SnapshotWriter(std::string *data) : data_(data) { }
+
+  template <class T>
+  void Field(const T &value) {
+    Put(value, std::integral_constant<bool, std::is_arithmetic<T>::value ||
+                                            std::is_enum<T>::value>());
+  }
+  template <class T, size_t N>
+  void Field(const T (&values)[N]) {
+    for (auto &value : values) {
+      Field(value);
+    }
+  }
+  void Field(const std::string &value) {
+    Field(UINT64(value.size()));
+    data_->append(value);
+  }
+  void Field(const std::bitset<32> &value) { Field(UINT32(value.to_ulong())); }
+  template <class A, class B>
+  void Field(const std::pair<A, B> &value) {
+    Field(value.first);
+    Field(value.second);
+  }
+  template <class T>
+  void Field(const std::vector<T> &values) {
+    Field(UINT64(values.size()));
+    for (auto &value : values) {
+      Field(value);
+    }
+  }
+  template <class K, class V>
+  void Field(const std::map<K, V> &values) {
+    Field(UINT64(values.size()));
+    for (auto &value : values) {
+      Field(value.first);
+      Field(value.second);
+    }
+  }
+
+ private:
+  template <class T>
+  void Put(const T &value, std::true_type) {
+    data_->append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+  template <class T>
+  void Put(const T &value, std::false_type) {
+    // Transfer() is shared with the reader and takes a mutable reference; the writer only reads.
+    Transfer(this, const_cast<T &>(value));
+  }
+
+  std::string *data_;
+};
+
+// Mirror of SnapshotWriter. Any read past the end of the data marks the reader as failed and
+// leaves the remaining fields untouched.
+class SnapshotReader {
+ public:
+  SnapshotReader(const std::string &data, size_t offset) : data_(data), offset_(offset) { }
+
+  bool Failed() { return failed_; }
+  bool AtEnd() { return offset_ == data_.size(); }
+
+  template <class T>
+  void Field(T &value) {
+    Get(&value, std::integral_constant<bool, std::is_arithmetic<T>::value ||
+                                             std::is_enum<T>::value>());
+  }
+  template <class T, size_t N>
+  void Field(T (&values)[N]) {
+    for (auto &value : values) {
+      Field(value);
+    }
+  }
+  void Field(std::string &value) {
+    uint64_t size = 0;
+    Field(size);
+    if (!Reserve(size)) {
+      return;
+    }
+    value.assign(data_, offset_, size);
+    offset_ += size;
+  }
+  void Field(std::bitset<32> &value) {
+    uint32_t bits = 0;
+    Field(bits);
+    value = bits;
+  }
+  template <class A, class B>
+  void Field(std::pair<A, B> &value) {
+    Field(value.first);
+    Field(value.second);
+  }
+  template <class T>
+  void Field(std::vector<T> &values) {
+    uint64_t count = 0;
+    Field(count);
+    values.clear();
+    // Every element takes at least one byte, which bounds count on corrupt input.
+    for (uint64_t i = 0; i < count && Reserve(1); i++) {
+      T value = {};
+      Field(value);
+      values.push_back(value);
+    }
+  }
+  template <class K, class V>
+  void Field(std::map<K, V> &values) {
+    uint64_t count = 0;
+    Field(count);
+    values.clear();
+    for (uint64_t i = 0; i < count && Reserve(1); i++) {
+      K key = {};
+      V value = {};
+      Field(key);
+      Field(value);
+      values[key] = value;
+    }
+  }
+
+ private:
+  bool Reserve(uint64_t size) {
+    if (failed_ || size > data_.size() - offset_) {
+      failed_ = true;
+      return false;
+    }
+    return true;
+  }
+  template <class T>
+  void Get(T *value, std::true_type) {
+    if (Reserve(sizeof(*value))) {
+      memcpy(value, data_.data() + offset_, sizeof(*value));
+      offset_ += sizeof(*value);
+    }
+  }
+  template <class T>
+  void Get(T *value, std::false_type) {
+    Transfer(this, *value);
+  }
+
+  const std::string &data_;
+  size_t offset_ = 0;
+  bool failed_ = false;
+};
+
+template <class Archive>
+void Transfer(Archive *ar, HWDynBwLimitInfo &info) {
+  ar->Field(info.cur_mode);
+  ar->Field(info.total_bw_limit);
+  ar->Field(info.pipe_bw_limit);
+}
+
+template <class Archive>
+void Transfer(Archive *ar, HWPipeCaps &caps) {
+  ar->Field(caps.type);
+  ar->Field(caps.id);
+  ar->Field(caps.master_pipe_id);
+  ar->Field(caps.max_rects);
+  ar->Field(caps.inverse_pma);
+  ar->Field(caps.dgm_csc_version);
+  ar->Field(caps.tm_lut_version_map);
+  ar->Field(caps.block_sec_ui);
+}
+
+template <class Archive>
+void Transfer(Archive *ar, HWRotatorInfo &info) {
+  ar->Field(info.num_rotator);
+  ar->Field(info.has_downscale);
+  ar->Field(info.device_path);
+  ar->Field(info.min_downscale);
+  ar->Field(info.downscale_compression);
+  ar->Field(info.max_line_width);
+}
+
+template <class Archive>
+void Transfer(Archive *ar, HWDestScalarInfo &info) {
+  ar->Field(info.count);
+  ar->Field(info.max_input_width);
+  ar->Field(info.max_output_width);
+  ar->Field(info.max_scale_up);
+  ar->Field(info.prefill_lines);
+}
+
+template <class Archive>
+void Transfer(Archive *ar, InlineRotationInfo &info) {
+  ar->Field(info.inrot_version);
+  ar->Field(info.inrot_fmts_supported);
+  ar->Field(info.max_downscale_rt);
+  ar->Field(info.max_ds_without_pre_downscaler);
+}
+
+template <class Archive>
+void Transfer(Archive *ar, HWResourceInfo &info) {
+  ar->Field(info.hw_version);
+  ar->Field(info.num_dma_pipe);
+  ar->Field(info.num_vig_pipe);
+  ar->Field(info.num_rgb_pipe);
+  ar->Field(info.num_cursor_pipe);
+  ar->Field(info.num_blending_stages);
+  ar->Field(info.num_solidfill_stages);
+  ar->Field(info.max_scale_up);
+  ar->Field(info.max_scale_down);
+  ar->Field(info.max_bandwidth_low);
+  ar->Field(info.max_bandwidth_high);
+  ar->Field(info.max_mixer_width);
+  ar->Field(info.max_pipe_width);
+  ar->Field(info.max_scaler_pipe_width);
+  ar->Field(info.max_rotation_pipe_width);
+  ar->Field(info.max_cursor_size);
+  ar->Field(info.max_pipe_bw);
+  ar->Field(info.max_pipe_bw_high);
+  ar->Field(info.max_sde_clk);
+  ar->Field(info.clk_fudge_factor);
+  ar->Field(info.macrotile_nv12_factor);
+  ar->Field(info.macrotile_factor);
+  ar->Field(info.linear_factor);
+  ar->Field(info.scale_factor);
+  ar->Field(info.extra_fudge_factor);
+  ar->Field(info.amortizable_threshold);
+  ar->Field(info.system_overhead_lines);
+  ar->Field(info.has_ubwc);
+  ar->Field(info.has_decimation);
+  ar->Field(info.has_non_scalar_rgb);
+  ar->Field(info.is_src_split);
+  ar->Field(info.separate_rotator);
+  ar->Field(info.has_qseed3);
+  ar->Field(info.has_concurrent_writeback);
+  ar->Field(info.has_ppp);
+  ar->Field(info.has_excl_rect);
+  ar->Field(info.writeback_index);
+  ar->Field(info.dyn_bw_info);
+  ar->Field(info.hw_pipes);
+  ar->Field(info.supported_formats_map);
+  ar->Field(info.hw_rot_info);
+  ar->Field(info.hw_dest_scalar_info);
+  ar->Field(info.has_hdr);
+  ar->Field(info.smart_dma_rev);
+  ar->Field(info.ib_fudge_factor);
+  ar->Field(info.undersized_prefill_lines);
+  ar->Field(info.comp_ratio_rt_map);
+  ar->Field(info.comp_ratio_nrt_map);
+  ar->Field(info.cache_size);
+  ar->Field(info.pipe_qseed3_version);
+  ar->Field(info.min_prefill_lines);
+  ar->Field(info.inline_rot_info);
+  ar->Field(info.src_tone_map);
+  ar->Field(info.secure_disp_blend_stage);
+  ar->Field(info.line_width_constraints_count);
+  ar->Field(info.line_width_limits);
+  ar->Field(info.line_width_constraints);
+  ar->Field(info.num_mnocports);
+  ar->Field(info.mnoc_bus_width);
+  ar->Field(info.use_baselayer_for_stage);
+  ar->Field(info.has_micro_idle);
+  ar->Field(info.ubwc_version);
+}
+
+// Header: magic, version, sizeof(HWResourceInfo), payload size and payload hash. The struct size
+// catches layouts that changed without a version bump.
+static const size_t kHeaderSize = 3 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+void HWResourceSnapshot::Serialize(const HWResourceSnapshotKey &key,
+                                   const HWResourceInfo &hw_resource, std::string *data) {
+  std::string payload;
+  SnapshotWriter payload_writer(&payload);
+  payload_writer.Field(key.driver_version);
+  payload_writer.Field(key.caps_hash);
+  payload_writer.Field(key.config_hash);
+  payload_writer.Field(hw_resource);
+
+  data->clear();
+  SnapshotWriter writer(data);
+  writer.Field(kSnapshotMagic);
+  writer.Field(kVersion);
+  writer.Field(UINT32(sizeof(HWResourceInfo)));
+  writer.Field(UINT64(payload.size()));
+  writer.Field(HashBytes(payload.data(), payload.size()));
+  data->append(payload);
+}
+
+DisplayError HWResourceSnapshot::Deserialize(const std::string &data,
+                                             const HWResourceSnapshotKey &key,
+                                             HWResourceInfo *hw_resource) {
+  if (data.size() < kHeaderSize) {
+    return kErrorParameters;
+  }
+
+  SnapshotReader header(data, 0);
+  uint32_t magic = 0, version = 0, layout_size = 0;
+  uint64_t payload_size = 0, payload_hash = 0;
+  header.Field(magic);
+  header.Field(version);
+  header.Field(layout_size);
+  header.Field(payload_size);
+  header.Field(payload_hash);
+  if (magic != kSnapshotMagic) {
+    return kErrorParameters;
+  }
+  if (version != kVersion || layout_size != sizeof(HWResourceInfo)) {
+    return kErrorVersion;
+  }
+  if (payload_size != data.size() - kHeaderSize ||
+      payload_hash != HashBytes(data.data() + kHeaderSize, data.size() - kHeaderSize)) {
+    return kErrorParameters;
+  }
+
+  SnapshotReader reader(data, kHeaderSize);
+  HWResourceSnapshotKey snapshot_key;
+  reader.Field(snapshot_key.driver_version);
+  reader.Field(snapshot_key.caps_hash);
+  reader.Field(snapshot_key.config_hash);
+  if (reader.Failed()) {
+    return kErrorParameters;
+  }
+  if (snapshot_key.driver_version != key.driver_version ||
+      snapshot_key.caps_hash != key.caps_hash || snapshot_key.config_hash != key.config_hash) {
+    return kErrorVersion;
+  }
+
+  HWResourceInfo info;
+  reader.Field(info);
+  if (reader.Failed() || !reader.AtEnd()) {
+    return kErrorParameters;
+  }
+
+  info.init_stats = hw_resource->init_stats;
+  *hw_resource = info;
+
+  return kErrorNone;
+}
+
+DisplayError HWResourceSnapshot::Load(const std::string &path, const HWResourceSnapshotKey &key,
+                                      HWResourceInfo *hw_resource) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    return kErrorNotSupported;
+  }
+
+  std::string data;
+  data.resize(kMaxSnapshotSize + 1);
+  file.read(&data[0], std::streamsize(data.size()));
+  if (file.bad() || UINT64(file.gcount()) > kMaxSnapshotSize) {
+    DLOGW("Failed to read %s", path.c_str());
+    return kErrorParameters;
+  }
+  data.resize(size_t(file.gcount()));
+
+  DisplayError error = Deserialize(data, key, hw_resource);
+  if (error != kErrorNone) {
+    DLOGI("Ignoring %s snapshot %s", (error == kErrorVersion) ? "stale" : "invalid",
+          path.c_str());
+  }
+
+  return error;
+}
+
+DisplayError HWResourceSnapshot::Store(const std::string &path, const HWResourceSnapshotKey &key,
+                                       const HWResourceInfo &hw_resource) {
+  std::string data;
+  Serialize(key, hw_resource, &data);
+
+  std::string tmp_path = path + ".tmp";
+  std::ofstream file(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    DLOGW("Failed to open %s", tmp_path.c_str());
+    return kErrorPermission;
+  }
+
+  file.write(data.data(), std::streamsize(data.size()));
+  file.close();
+  if (file.fail() || rename(tmp_path.c_str(), path.c_str())) {
+    DLOGW("Failed to write %s", path.c_str());
+    remove(tmp_path.c_str());
+    return kErrorUndefined;
+  }
+
+  return kErrorNone;
+}
+
+}  // namespace sdm
@@ -0,0 +1,66 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_RESOURCE_SNAPSHOT_H__
+#define __HW_RESOURCE_SNAPSHOT_H__
+
+#include <core/sdm_types.h>
+#include <private/hw_info_types.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace sdm {
+
+// Identifies the hardware and configuration a snapshot was discovered with. A snapshot is used
+// only when every field matches the running system.
+struct HWResourceSnapshotKey {
+  std::string driver_version = "";  // Driver name, version and kernel release
+  uint64_t caps_hash = 0;           // Hash of the driver capability blobs
+  uint64_t config_hash = 0;         // Hash of the properties that shape discovery
+};
+
+// Versioned on-disk image of a discovered HWResourceInfo, so that a composer restart can skip
+// querying the driver. Every field except init_stats is persisted; bump kVersion whenever the
+// encoding or the set of HWResourceInfo fields changes.
+class HWResourceSnapshot {
+ public:
+  static const uint32_t kVersion = 1;
+
+  static void Serialize(const HWResourceSnapshotKey &key, const HWResourceInfo &hw_resource,
+                        std::string *data);
+  // Returns kErrorVersion when data was written for another key or version and kErrorParameters
+  // when it is truncated or corrupt. hw_resource is only updated on success.
+  static DisplayError Deserialize(const std::string &data, const HWResourceSnapshotKey &key,
+                                  HWResourceInfo *hw_resource);
+  static DisplayError Load(const std::string &path, const HWResourceSnapshotKey &key,
+                           HWResourceInfo *hw_resource);
+  // Writes to a temporary file and renames it over path, so readers never see a partial file.
+  static DisplayError Store(const std::string &path, const HWResourceSnapshotKey &key,
+                            const HWResourceInfo &hw_resource);
+};
+
+}  // namespace sdm
+
+#endif  // __HW_RESOURCE_SNAPSHOT_H__
@@ -0,0 +1,184 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+
+#include "hw_resource_snapshot.h"
+
+using namespace sdm;
+
+static HWResourceSnapshotKey MakeKey() {
+  HWResourceSnapshotKey key;
+  key.driver_version = "msm_drm 1.5.0 4.19.81";
+  key.caps_hash = 0x1234567890abcdefULL;
+  key.config_hash = 42;
+  return key;
+}
+
+static HWResourceInfo MakeInfo() {
+  HWResourceInfo info;
+  info.hw_version = 0x60000000;
+  info.num_vig_pipe = 4;
+  info.num_dma_pipe = 4;
+  info.max_bandwidth_high = 9600000;
+  info.clk_fudge_factor = 1.05f;
+  info.has_qseed3 = true;
+  info.dyn_bw_info.total_bw_limit[kBwVFEOff] = 12345;
+
+  HWPipeCaps pipe;
+  pipe.type = kPipeTypeVIG;
+  pipe.id = 45;
+  pipe.max_rects = 2;
+  pipe.tm_lut_version_map[kVig1dIgc] = 1;
+  pipe.tm_lut_version_map[kVig3dGamut] = 6;
+  info.hw_pipes.push_back(pipe);
+  pipe.type = kPipeTypeDMA;
+  pipe.id = 46;
+  pipe.tm_lut_version_map.clear();
+  info.hw_pipes.push_back(pipe);
+
+  info.supported_formats_map[kHWVIGPipe] = {kFormatRGBA8888, kFormatYCbCr420SemiPlanarVenus};
+  info.supported_formats_map[kHWDMAPipe] = {kFormatRGB565};
+  info.hw_rot_info.num_rotator = 1;
+  info.hw_rot_info.device_path = "/dev/video2";
+  info.hw_dest_scalar_info.count = 2;
+  info.smart_dma_rev = SmartDMARevision::V2p5;
+  info.comp_ratio_rt_map[kFormatRGBA8888Ubwc] = 1.5f;
+  info.pipe_qseed3_version = kQseed3litev5;
+  info.inline_rot_info.inrot_version = kInlineRotationV2;
+  info.inline_rot_info.inrot_fmts_supported = {kFormatRGBA8888Ubwc};
+  info.src_tone_map = 0x5;
+  info.secure_disp_blend_stage = 3;
+  info.line_width_limits = {{1, 2160}, {2, 4096}};
+  info.ubwc_version = 4;
+  return info;
+}
+
+TEST(HWResourceSnapshotTest, RoundTrip) {
+  HWResourceSnapshotKey key = MakeKey();
+  HWResourceInfo info = MakeInfo();
+  std::string data;
+  HWResourceSnapshot::Serialize(key, info, &data);
+
+  HWResourceInfo loaded;
+  ASSERT_EQ(kErrorNone, HWResourceSnapshot::Deserialize(data, key, &loaded));
+  EXPECT_EQ(info.hw_version, loaded.hw_version);
+  EXPECT_EQ(info.clk_fudge_factor, loaded.clk_fudge_factor);
+  EXPECT_EQ(12345u, loaded.dyn_bw_info.total_bw_limit[kBwVFEOff]);
+  ASSERT_EQ(2u, loaded.hw_pipes.size());
+  EXPECT_EQ(kPipeTypeDMA, loaded.hw_pipes[1].type);
+  EXPECT_EQ(info.hw_pipes[0].tm_lut_version_map, loaded.hw_pipes[0].tm_lut_version_map);
+  EXPECT_EQ(info.supported_formats_map, loaded.supported_formats_map);
+  EXPECT_EQ("/dev/video2", loaded.hw_rot_info.device_path);
+  EXPECT_EQ(SmartDMARevision::V2p5, loaded.smart_dma_rev);
+  EXPECT_EQ(info.comp_ratio_rt_map, loaded.comp_ratio_rt_map);
+  EXPECT_EQ(info.inline_rot_info.inrot_fmts_supported, loaded.inline_rot_info.inrot_fmts_supported);
+  EXPECT_EQ(info.src_tone_map, loaded.src_tone_map);
+  EXPECT_EQ(info.line_width_limits, loaded.line_width_limits);
+  EXPECT_EQ(4u, loaded.ubwc_version);
+
+  // Re-encoding the decoded copy must reproduce the original bytes, which is also what the
+  // background verification relies on.
+  std::string again;
+  HWResourceSnapshot::Serialize(key, loaded, &again);
+  EXPECT_EQ(data, again);
+}
+
+TEST(HWResourceSnapshotTest, InitStatsNotPersisted) {
+  HWResourceInfo info = MakeInfo();
+  info.init_stats.total_us = 5000;
+  std::string data;
+  HWResourceSnapshot::Serialize(MakeKey(), info, &data);
+
+  HWResourceInfo loaded;
+  loaded.init_stats.total_us = 7;
+  ASSERT_EQ(kErrorNone, HWResourceSnapshot::Deserialize(data, MakeKey(), &loaded));
+  EXPECT_EQ(7u, loaded.init_stats.total_us);
+}
+
+TEST(HWResourceSnapshotTest, KeyMismatch) {
+  std::string data;
+  HWResourceSnapshot::Serialize(MakeKey(), MakeInfo(), &data);
+
+  HWResourceSnapshotKey key = MakeKey();
+  key.driver_version += "-dirty";
+  HWResourceInfo loaded;
+  EXPECT_EQ(kErrorVersion, HWResourceSnapshot::Deserialize(data, key, &loaded));
+  key = MakeKey();
+  key.caps_hash++;
+  EXPECT_EQ(kErrorVersion, HWResourceSnapshot::Deserialize(data, key, &loaded));
+  key = MakeKey();
+  key.config_hash++;
+  EXPECT_EQ(kErrorVersion, HWResourceSnapshot::Deserialize(data, key, &loaded));
+  EXPECT_TRUE(loaded.hw_pipes.empty());
+}
+
+TEST(HWResourceSnapshotTest, VersionMismatch) {
+  std::string data;
+  HWResourceSnapshot::Serialize(MakeKey(), MakeInfo(), &data);
+  // The version follows the 4 byte magic.
+  data[4]++;
+
+  HWResourceInfo loaded;
+  EXPECT_EQ(kErrorVersion, HWResourceSnapshot::Deserialize(data, MakeKey(), &loaded));
+}
+
+TEST(HWResourceSnapshotTest, RejectsCorruptData) {
+  std::string data;
+  HWResourceSnapshot::Serialize(MakeKey(), MakeInfo(), &data);
+
+  HWResourceInfo loaded;
+  for (size_t size = 0; size < data.size(); size++) {
+    EXPECT_NE(kErrorNone, HWResourceSnapshot::Deserialize(data.substr(0, size), MakeKey(),
+                                                          &loaded)) << "size " << size;
+  }
+
+  std::string corrupt = data;
+  corrupt[corrupt.size() / 2] ^= 0x40;
+  EXPECT_EQ(kErrorParameters, HWResourceSnapshot::Deserialize(corrupt, MakeKey(), &loaded));
+  EXPECT_EQ(kErrorParameters, HWResourceSnapshot::Deserialize(data + "x", MakeKey(), &loaded));
+  EXPECT_TRUE(loaded.hw_pipes.empty());
+}
+
+TEST(HWResourceSnapshotTest, StoreAndLoad) {
+  char dir[] = "/tmp/hw_snapshot_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  std::string path = std::string(dir) + "/hw_resource.bin";
+
+  HWResourceInfo loaded;
+  EXPECT_EQ(kErrorNotSupported, HWResourceSnapshot::Load(path, MakeKey(), &loaded));
+
+  HWResourceInfo info = MakeInfo();
+  ASSERT_EQ(kErrorNone, HWResourceSnapshot::Store(path, MakeKey(), info));
+  EXPECT_NE(0, access((path + ".tmp").c_str(), F_OK));
+  ASSERT_EQ(kErrorNone, HWResourceSnapshot::Load(path, MakeKey(), &loaded));
+  EXPECT_EQ(info.supported_formats_map, loaded.supported_formats_map);
+
+  unlink(path.c_str());
+  rmdir(dir);
+}
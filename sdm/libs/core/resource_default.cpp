@@ -79,6 +79,11 @@ DisplayError ResourceDefault::Init() {
     return kErrorParameters;
   }
 
+  if (num_pipe_ > kMaxPipes) {
+    DLOGE("Number of H/W pipes %d exceeds %d", num_pipe_, kMaxPipes);
+    return kErrorParameters;
+  }
+
   src_pipes_.resize(num_pipe_);
 
   // Priority order of pipes: VIG, RGB, DMA
@@ -108,6 +113,7 @@ DisplayError ResourceDefault::Init() {
 
   for (uint32_t i = 0; i < num_pipe_; i++) {
     src_pipes_[i].priority = INT(i);
+    type_pipe_mask_[src_pipes_[i].type] |= (1ULL << i);
   }
 
   DLOGI("hw_ver=%x, DMA=%d RGB=%d VIG=%d", hw_res_info_.hw_version, hw_res_info_.num_dma_pipe,
@@ -127,6 +133,12 @@ DisplayError ResourceDefault::Init() {
   src_pipes_[rgb_index + 1].owner = kPipeOwnerKernelMode;
 #endif
 
+  for (uint32_t i = 0; i < num_pipe_; i++) {
+    if (src_pipes_[i].owner == kPipeOwnerUserMode) {
+      free_pipe_mask_ |= (1ULL << i);
+    }
+  }
+
   return error;
 }
 
@@ -219,57 +231,80 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
   DisplayError error = kErrorNone;
   const struct HWLayersInfo &layer_info = hw_layers->info;
   HWBlockType hw_block_type = display_resource_ctx->hw_block_type;
+  uint32_t layer_count = UINT32(layer_info.hw_layers.size());
 
   DLOGV_IF(kTagResources, "==== Resource reserving start: hw_block_type = %d ====", hw_block_type);
 
-  if (layer_info.hw_layers.size() > 1) {
-    DLOGV_IF(kTagResources, "More than one FB layers");
+  if (!layer_count || layer_count > kMaxSDELayers) {
+    DLOGV_IF(kTagResources, "Invalid number of layers %d", layer_count);
     return kErrorResources;
   }
 
-  const Layer &layer = layer_info.hw_layers.at(0);
+  ReleasePipes(hw_block_type);
 
-  if (layer.composition != kCompositionGPUTarget) {
-    DLOGV_IF(kTagResources, "Not an FB layer");
-    return kErrorParameters;
+  // Layers are handled in z-order so that the pipe assignment only depends on the layer stack
+  // and the pipes owned by other blocks.
+  for (uint32_t i = 0; i < layer_count; i++) {
+    const Layer &layer = layer_info.hw_layers.at(i);
+
+    if (layer.composition == kCompositionGPU) {
+      DLOGV_IF(kTagResources, "Layer %d is marked for GPU composition", i);
+      error = kErrorParameters;
+      break;
+    }
+
+    error = Config(display_resource_ctx, hw_layers, i);
+    if (error != kErrorNone) {
+      DLOGV_IF(kTagResources, "Resource config failed for layer %d", i);
+      break;
+    }
+
+    error = AcquirePipes(hw_block_type, layer, &hw_layers->config[i]);
+    if (error != kErrorNone) {
+      ResourceStateLog();
+      break;
+    }
   }
 
-  error = Config(display_resource_ctx, hw_layers);
   if (error != kErrorNone) {
-    DLOGV_IF(kTagResources, "Resource config failed");
-    return error;
+    ReleasePipes(hw_block_type);
+    DLOGV_IF(kTagResources, "Resource reserving failed! hw_block_type = %d", hw_block_type);
+    return (error == kErrorParameters) ? error : kErrorResources;
   }
 
-  for (uint32_t i = 0; i < num_pipe_; i++) {
-    if (src_pipes_[i].hw_block_type == hw_block_type && src_pipes_[i].owner == kPipeOwnerUserMode) {
-      src_pipes_[i].ResetState();
-    }
-  }
+  DLOGV_IF(kTagResources, "%d layers configured, pipe mask = 0x%" PRIx64, layer_count,
+           block_pipe_mask_[hw_block_type]);
+
+  return kErrorNone;
+}
 
+DisplayError ResourceDefault::AcquirePipes(HWBlockType hw_block_type, const Layer &layer,
+                                           HWLayerConfig *layer_config) {
+  DisplayError error = kErrorNone;
   uint32_t left_index = num_pipe_;
   uint32_t right_index = num_pipe_;
+  // Only VIG pipes have CSC for YUV sources.
+  bool need_vig = (layer.input_buffer.format >= kFormatYCbCr420Planar) &&
+                  (layer.input_buffer.format != kFormatInvalid);
   bool need_scale = false;
 
-  struct HWLayerConfig &layer_config = hw_layers->config[0];
-
-  HWPipeInfo *left_pipe = &layer_config.left_pipe;
-  HWPipeInfo *right_pipe = &layer_config.right_pipe;
+  HWPipeInfo *left_pipe = &layer_config->left_pipe;
+  HWPipeInfo *right_pipe = &layer_config->right_pipe;
 
   // left pipe is needed
   if (left_pipe->valid) {
     need_scale = IsScalingNeeded(left_pipe);
-    left_index = GetPipe(hw_block_type, need_scale);
+    left_index = GetPipe(hw_block_type, need_scale, need_vig);
     if (left_index >= num_pipe_) {
       DLOGV_IF(kTagResources, "Get left pipe failed: hw_block_type = %d, need_scale = %d",
                hw_block_type, need_scale);
-      ResourceStateLog();
-      goto CleanupOnError;
+      return kErrorResources;
     }
   }
 
   error = SetDecimationFactor(left_pipe);
   if (error != kErrorNone) {
-    goto CleanupOnError;
+    return error;
   }
 
   if (!right_pipe->valid) {
@@ -277,18 +312,17 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
     if (left_index < num_pipe_) {
       left_pipe->pipe_id = src_pipes_[left_index].mdss_pipe_id;
     }
-    DLOGV_IF(kTagResources, "1 pipe acquired for FB layer, left_pipe = %x", left_pipe->pipe_id);
+    DLOGV_IF(kTagResources, "1 pipe acquired, left_pipe = %x", left_pipe->pipe_id);
     return kErrorNone;
   }
 
   need_scale = IsScalingNeeded(right_pipe);
 
-  right_index = GetPipe(hw_block_type, need_scale);
+  right_index = GetPipe(hw_block_type, need_scale, need_vig);
   if (right_index >= num_pipe_) {
     DLOGV_IF(kTagResources, "Get right pipe failed: hw_block_type = %d, need_scale = %d",
              hw_block_type, need_scale);
-    ResourceStateLog();
-    goto CleanupOnError;
+    return kErrorResources;
   }
 
   if (src_pipes_[right_index].priority < src_pipes_[left_index].priority) {
@@ -302,18 +336,13 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
 
   error = SetDecimationFactor(right_pipe);
   if (error != kErrorNone) {
-    goto CleanupOnError;
+    return error;
   }
 
-  DLOGV_IF(kTagResources, "2 pipes acquired for FB layer, left_pipe = %x, right_pipe = %x",
+  DLOGV_IF(kTagResources, "2 pipes acquired, left_pipe = %x, right_pipe = %x",
            left_pipe->pipe_id,  right_pipe->pipe_id);
 
   return kErrorNone;
-
-CleanupOnError:
-  DLOGV_IF(kTagResources, "Resource reserving failed! hw_block_type = %d", hw_block_type);
-
-  return kErrorResources;
 }
 
 DisplayError ResourceDefault::PostPrepare(Handle display_ctx, HWLayers *hw_layers) {
@@ -339,6 +368,7 @@ DisplayError ResourceDefault::PostCommit(Handle display_ctx, HWLayers *hw_layers
       if (src_pipes_[i].hw_block_type == hw_block_type &&
           src_pipes_[i].owner == kPipeOwnerKernelMode) {
         src_pipes_[i].owner = kPipeOwnerUserMode;
+        block_pipe_mask_[hw_block_type] |= (1ULL << i);
       }
     }
   }
@@ -353,11 +383,7 @@ void ResourceDefault::Purge(Handle display_ctx) {
                           reinterpret_cast<DisplayResourceContext *>(display_ctx);
   HWBlockType hw_block_type = display_resource_ctx->hw_block_type;
 
-  for (uint32_t i = 0; i < num_pipe_; i++) {
-    if (src_pipes_[i].hw_block_type == hw_block_type && src_pipes_[i].owner == kPipeOwnerUserMode) {
-      src_pipes_[i].ResetState();
-    }
-  }
+  ReleasePipes(hw_block_type);
   DLOGV_IF(kTagResources, "display hw_block_type = %d", display_resource_ctx->hw_block_type);
 }
 
@@ -365,50 +391,46 @@ DisplayError ResourceDefault::SetMaxMixerStages(Handle display_ctx, uint32_t max
   return kErrorNone;
 }
 
-uint32_t ResourceDefault::SearchPipe(HWBlockType hw_block_type, SourcePipe *src_pipes,
-                                     uint32_t num_pipe) {
-  uint32_t index = num_pipe_;
-  SourcePipe *src_pipe;
-
-  // search the pipe being used
-  for (uint32_t i = 0; i < num_pipe; i++) {
-    src_pipe = &src_pipes[i];
-    if (src_pipe->owner == kPipeOwnerUserMode && src_pipe->hw_block_type == kHWBlockMax) {
-      index = src_pipe->index;
-      src_pipe->hw_block_type = hw_block_type;
-      break;
+void ResourceDefault::ReleasePipes(HWBlockType hw_block_type) {
+  uint64_t pipe_mask = block_pipe_mask_[hw_block_type];
+
+  while (pipe_mask) {
+    uint32_t slot = UINT32(__builtin_ctzll(pipe_mask));
+    pipe_mask &= (pipe_mask - 1);
+    if (src_pipes_[slot].owner == kPipeOwnerUserMode) {
+      src_pipes_[slot].ResetState();
+      block_pipe_mask_[hw_block_type] &= ~(1ULL << slot);
+      free_pipe_mask_ |= (1ULL << slot);
     }
   }
-
-  return index;
 }
 
 uint32_t ResourceDefault::NextPipe(PipeType type, HWBlockType hw_block_type) {
-  uint32_t num_pipe = 0;
-  SourcePipe *src_pipes = NULL;
+  if (type != kPipeTypeVIG && type != kPipeTypeRGB) {
+    type = kPipeTypeDMA;
+  }
 
-  switch (type) {
-  case kPipeTypeVIG:
-    src_pipes = &src_pipes_[0];
-    num_pipe = hw_res_info_.num_vig_pipe;
-    break;
-  case kPipeTypeRGB:
-    src_pipes = &src_pipes_[hw_res_info_.num_vig_pipe];
-    num_pipe = hw_res_info_.num_rgb_pipe;
-    break;
-  case kPipeTypeDMA:
-  default:
-    src_pipes = &src_pipes_[hw_res_info_.num_vig_pipe + hw_res_info_.num_rgb_pipe];
-    num_pipe = hw_res_info_.num_dma_pipe;
-    break;
+  // Lowest free slot of the requested type, which keeps the pipe priority order.
+  uint64_t pipe_mask = free_pipe_mask_ & type_pipe_mask_[type];
+  if (!pipe_mask) {
+    return num_pipe_;
   }
 
-  return SearchPipe(hw_block_type, src_pipes, num_pipe);
+  uint32_t slot = UINT32(__builtin_ctzll(pipe_mask));
+  free_pipe_mask_ &= ~(1ULL << slot);
+  block_pipe_mask_[hw_block_type] |= (1ULL << slot);
+  src_pipes_[slot].hw_block_type = hw_block_type;
+
+  return slot;
 }
 
-uint32_t ResourceDefault::GetPipe(HWBlockType hw_block_type, bool need_scale) {
+uint32_t ResourceDefault::GetPipe(HWBlockType hw_block_type, bool need_scale, bool need_vig) {
   uint32_t index = num_pipe_;
 
+  if (need_vig) {
+    return NextPipe(kPipeTypeVIG, hw_block_type);
+  }
+
   // The default behavior is to assume RGB and VG pipes have scalars
   if (!need_scale) {
     index = NextPipe(kPipeTypeDMA, hw_block_type);
@@ -435,6 +457,7 @@ bool ResourceDefault::IsScalingNeeded(const HWPipeInfo *pipe_info) {
 
 void ResourceDefault::ResourceStateLog() {
   DLOGV_IF(kTagResources, "==== resource manager pipe state ====");
+  DLOGV_IF(kTagResources, "free pipe mask = 0x%" PRIx64, free_pipe_mask_);
   uint32_t i;
   for (i = 0; i < num_pipe_; i++) {
     SourcePipe *src_pipe = &src_pipes_[i];
@@ -525,17 +548,17 @@ DisplayError ResourceDefault::DisplaySplitConfig(DisplayResourceContext *display
 }
 
 DisplayError ResourceDefault::Config(DisplayResourceContext *display_resource_ctx,
-                                HWLayers *hw_layers) {
+                                HWLayers *hw_layers, uint32_t index) {
   HWLayersInfo &layer_info = hw_layers->info;
   DisplayError error = kErrorNone;
-  const Layer &layer = layer_info.hw_layers.at(0);
+  const Layer &layer = layer_info.hw_layers.at(index);
 
   error = ValidateLayerParams(&layer);
   if (error != kErrorNone) {
     return error;
   }
 
-  struct HWLayerConfig *layer_config = &hw_layers->config[0];
+  struct HWLayerConfig *layer_config = &hw_layers->config[index];
   HWPipeInfo &left_pipe = layer_config->left_pipe;
   HWPipeInfo &right_pipe = layer_config->right_pipe;
 
@@ -570,9 +593,9 @@ DisplayError ResourceDefault::Config(DisplayResourceContext *display_resource_ct
   }
 
   // set z_order, left_pipe should always be valid
-  left_pipe.z_order = 0;
+  left_pipe.z_order = index;
 
-  DLOGV_IF(kTagResources, "==== FB layer Config ====");
+  DLOGV_IF(kTagResources, "==== Layer %d Config ====", index);
   Log(kTagResources, "input layer src_rect", layer.src_rect);
   Log(kTagResources, "input layer dst_rect", layer.dst_rect);
   Log(kTagResources, "cropped src_rect", src_rect);
@@ -580,7 +603,7 @@ DisplayError ResourceDefault::Config(DisplayResourceContext *display_resource_ct
   Log(kTagResources, "left pipe src", layer_config->left_pipe.src_roi);
   Log(kTagResources, "left pipe dst", layer_config->left_pipe.dst_roi);
   if (right_pipe.valid) {
-    right_pipe.z_order = 0;
+    right_pipe.z_order = index;
     Log(kTagResources, "right pipe src", layer_config->right_pipe.src_roi);
     Log(kTagResources, "right pipe dst", layer_config->right_pipe.dst_roi);
   }
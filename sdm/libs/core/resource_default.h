@@ -82,6 +82,11 @@ class ResourceDefault : public ResourceInterface {
     kMaxDecimationDownScaleRatio = 16,
   };
 
+  // Pipe availability is tracked as one bit per src_pipes_ slot.
+  enum {
+    kMaxPipes = 64,
+  };
+
   struct SourcePipe {
     PipeType type;
     PipeOwner owner;
@@ -119,10 +124,13 @@ class ResourceDefault : public ResourceInterface {
   DisplayError Init();
   DisplayError Deinit();
   uint32_t NextPipe(PipeType pipe_type, HWBlockType hw_block_type);
-  uint32_t SearchPipe(HWBlockType hw_block_type, SourcePipe *src_pipes, uint32_t num_pipe);
-  uint32_t GetPipe(HWBlockType hw_block_type, bool need_scale);
+  uint32_t GetPipe(HWBlockType hw_block_type, bool need_scale, bool need_vig);
+  void ReleasePipes(HWBlockType hw_block_type);
   bool IsScalingNeeded(const HWPipeInfo *pipe_info);
-  DisplayError Config(DisplayResourceContext *display_resource_ctx, HWLayers *hw_layers);
+  DisplayError AcquirePipes(HWBlockType hw_block_type, const Layer &layer,
+                            HWLayerConfig *layer_config);
+  DisplayError Config(DisplayResourceContext *display_resource_ctx, HWLayers *hw_layers,
+                      uint32_t index);
   DisplayError DisplaySplitConfig(DisplayResourceContext *display_resource_ctx,
                                  const LayerRect &src_rect, const LayerRect &dst_rect,
                                  HWLayerConfig *layer_config);
@@ -150,6 +158,9 @@ class ResourceDefault : public ResourceInterface {
   HWBlockContext hw_block_ctx_[kHWBlockMax];
   std::vector<SourcePipe> src_pipes_;
   uint32_t num_pipe_ = 0;
+  uint64_t free_pipe_mask_ = 0;                      // user mode pipes not assigned to a block
+  uint64_t type_pipe_mask_[kPipeTypeCursor + 1] = {};  // src_pipes_ slots of each pipe type
+  uint64_t block_pipe_mask_[kHWBlockMax] = {};        // pipes assigned to each hw block
 };
 
 }  // namespace sdm
@@ -0,0 +1,339 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "resource_default.h"
+
+using namespace sdm;
+
+namespace {
+
+const uint32_t kMaxWidth = 2560;
+const int kConfigs = 64;
+const int kFramesPerConfig = 100;
+
+// Reference model of the pipe allocator before the bitmasks: a linear scan over the type region
+// of the priority ordered pipe list for the first user mode pipe not owned by any block.
+class LinearScanAllocator {
+ public:
+  explicit LinearScanAllocator(const HWResourceInfo &info) : info_(info) {
+    for (PipeType type : {kPipeTypeVIG, kPipeTypeRGB, kPipeTypeDMA}) {
+      for (const HWPipeCaps &caps : info.hw_pipes) {
+        if (caps.type == type) {
+          pipes_.push_back({type, caps.id, false, kHWBlockMax});
+        }
+      }
+    }
+#ifndef SDM_VIRTUAL_DRIVER
+    pipes_[info.num_vig_pipe].kernel = true;
+    pipes_[info.num_vig_pipe + 1].kernel = true;
+#endif
+  }
+
+  // Mirrors ResourceDefault::Prepare() for a stack that has already been split by Config().
+  bool Prepare(HWBlockType block, const HWLayers &hw_layers, std::vector<uint32_t> *ids) {
+    Release(block);
+    ids->clear();
+
+    for (uint32_t i = 0; i < hw_layers.info.hw_layers.size(); i++) {
+      const Layer &layer = hw_layers.info.hw_layers.at(i);
+      const HWLayerConfig &config = hw_layers.config[i];
+      bool need_vig = (layer.input_buffer.format >= kFormatYCbCr420Planar) &&
+                      (layer.input_buffer.format != kFormatInvalid);
+      size_t left = pipes_.size();
+      size_t right = pipes_.size();
+
+      if (config.left_pipe.valid) {
+        left = GetPipe(block, NeedScale(config.left_pipe), need_vig);
+        if (left >= pipes_.size()) {
+          Release(block);
+          return false;
+        }
+      }
+
+      if (!config.right_pipe.valid) {
+        ids->push_back(pipes_[left].id);
+        ids->push_back(0);
+        continue;
+      }
+
+      right = GetPipe(block, NeedScale(config.right_pipe), need_vig);
+      if (right >= pipes_.size()) {
+        Release(block);
+        return false;
+      }
+      ids->push_back(pipes_[std::min(left, right)].id);
+      ids->push_back(pipes_[std::max(left, right)].id);
+    }
+
+    return true;
+  }
+
+  void Release(HWBlockType block) {
+    for (RefPipe &pipe : pipes_) {
+      if (!pipe.kernel && pipe.block == block) {
+        pipe.block = kHWBlockMax;
+      }
+    }
+  }
+
+ private:
+  struct RefPipe {
+    PipeType type;
+    uint32_t id;
+    bool kernel;
+    HWBlockType block;
+  };
+
+  static bool NeedScale(const HWPipeInfo &pipe) {
+    return ((pipe.dst_roi.right - pipe.dst_roi.left) != (pipe.src_roi.right - pipe.src_roi.left)) ||
+           ((pipe.dst_roi.bottom - pipe.dst_roi.top) != (pipe.src_roi.bottom - pipe.src_roi.top));
+  }
+
+  size_t SearchPipe(PipeType type, HWBlockType block) {
+    for (size_t i = 0; i < pipes_.size(); i++) {
+      if (pipes_[i].type == type && !pipes_[i].kernel && pipes_[i].block == kHWBlockMax) {
+        pipes_[i].block = block;
+        return i;
+      }
+    }
+    return pipes_.size();
+  }
+
+  size_t GetPipe(HWBlockType block, bool need_scale, bool need_vig) {
+    size_t index = pipes_.size();
+
+    if (need_vig) {
+      return SearchPipe(kPipeTypeVIG, block);
+    }
+    if (!need_scale) {
+      index = SearchPipe(kPipeTypeDMA, block);
+    }
+    if ((index >= pipes_.size()) && (!need_scale || !info_.has_non_scalar_rgb)) {
+      index = SearchPipe(kPipeTypeRGB, block);
+    }
+    if (index >= pipes_.size()) {
+      index = SearchPipe(kPipeTypeVIG, block);
+    }
+
+    return index;
+  }
+
+  HWResourceInfo info_;
+  std::vector<RefPipe> pipes_;
+};
+
+HWResourceInfo RandomResourceInfo(std::mt19937 *rng) {
+  HWResourceInfo info;
+  uint32_t num_pipes = std::uniform_int_distribution<uint32_t>(4, 16)(*rng);
+
+  // Two RGB pipes are always held by the kernel for the splash screen.
+  info.num_rgb_pipe = 2;
+  for (uint32_t i = info.num_rgb_pipe; i < num_pipes; i++) {
+    switch ((*rng)() % 3) {
+      case 0: info.num_vig_pipe++; break;
+      case 1: info.num_rgb_pipe++; break;
+      default: info.num_dma_pipe++; break;
+    }
+  }
+
+  for (uint32_t i = 0; i < info.num_vig_pipe; i++) {
+    info.hw_pipes.push_back({});
+    info.hw_pipes.back().type = kPipeTypeVIG;
+  }
+  for (uint32_t i = 0; i < info.num_rgb_pipe; i++) {
+    info.hw_pipes.push_back({});
+    info.hw_pipes.back().type = kPipeTypeRGB;
+  }
+  for (uint32_t i = 0; i < info.num_dma_pipe; i++) {
+    info.hw_pipes.push_back({});
+    info.hw_pipes.back().type = kPipeTypeDMA;
+  }
+
+  // The driver does not report pipes grouped by type, so neither does the harness.
+  std::shuffle(info.hw_pipes.begin(), info.hw_pipes.end(), *rng);
+  for (uint32_t i = 0; i < info.hw_pipes.size(); i++) {
+    info.hw_pipes[i].id = 0x100 + i;
+  }
+
+  info.max_scale_up = 4;
+  info.max_scale_down = 4;
+  info.is_src_split = true;
+  info.max_pipe_width = kMaxWidth;
+  info.max_scaler_pipe_width = kMaxWidth;
+  info.has_non_scalar_rgb = ((*rng)() % 2) != 0;
+
+  return info;
+}
+
+void RandomLayerStack(std::mt19937 *rng, HWLayers *hw_layers) {
+  static const LayerBufferFormat kFormats[] = {
+    kFormatRGBA8888, kFormatRGB565, kFormatRGBA8888Ubwc, kFormatYCbCr420SemiPlanarVenus,
+    kFormatYCbCr420SPVenusUbwc,
+  };
+  uint32_t layer_count = std::uniform_int_distribution<uint32_t>(1, 8)(*rng);
+
+  for (uint32_t i = 0; i < layer_count; i++) {
+    Layer layer;
+    uint32_t width = std::uniform_int_distribution<uint32_t>(32, 2 * kMaxWidth)(*rng) & ~1U;
+    uint32_t height = std::uniform_int_distribution<uint32_t>(32, 2160)(*rng) & ~1U;
+    uint32_t dst_width = width;
+    uint32_t dst_height = height;
+
+    switch ((*rng)() % 4) {
+      case 0: dst_width = width / 2; dst_height = height / 2; break;
+      case 1: dst_width = std::min(width * 2, 2 * kMaxWidth); dst_height = height * 2; break;
+      default: break;
+    }
+
+    layer.input_buffer.width = width;
+    layer.input_buffer.height = height;
+    layer.input_buffer.format = kFormats[(*rng)() % (sizeof(kFormats) / sizeof(kFormats[0]))];
+    layer.src_rect = {0, 0, FLOAT(width), FLOAT(height)};
+    layer.dst_rect = {0, 0, FLOAT(dst_width), FLOAT(dst_height)};
+    layer.composition = kCompositionSDE;
+    hw_layers->info.hw_layers.push_back(layer);
+  }
+}
+
+std::vector<uint32_t> PipeIds(const HWLayers &hw_layers) {
+  std::vector<uint32_t> ids;
+  for (uint32_t i = 0; i < hw_layers.info.hw_layers.size(); i++) {
+    const HWLayerConfig &config = hw_layers.config[i];
+    ids.push_back(config.left_pipe.pipe_id);
+    ids.push_back(config.right_pipe.valid ? config.right_pipe.pipe_id : 0);
+  }
+  return ids;
+}
+
+}  // namespace
+
+// Random pipe configurations and layer mixes on two displays sharing the pipes must get the
+// same pipe for every layer as the linear scan allocator, and fail on the same frames.
+TEST(ResourceDefaultTest, MatchesLinearScanAllocator) {
+  std::mt19937 rng(0x5d3);
+  uint32_t frames = 0;
+  uint32_t failures = 0;
+
+  for (int iteration = 0; iteration < kConfigs; iteration++) {
+    HWResourceInfo info = RandomResourceInfo(&rng);
+    ResourceInterface *resource_intf = nullptr;
+    ASSERT_EQ(kErrorNone, ResourceDefault::CreateResourceDefault(info, &resource_intf));
+    ASSERT_NE(nullptr, resource_intf);
+    LinearScanAllocator reference(info);
+
+    const DisplayType types[] = {kBuiltIn, kPluggable};
+    const HWBlockType blocks[] = {kHWBuiltIn, kHWPluggable};
+    Handle ctx[2] = {};
+    for (int d = 0; d < 2; d++) {
+      ASSERT_EQ(kErrorNone, resource_intf->RegisterDisplay(d, types[d], {}, {}, {}, &ctx[d]));
+    }
+
+    for (int frame = 0; frame < kFramesPerConfig; frame++) {
+      int d = INT(rng() % 2);
+      HWLayers hw_layers;
+      RandomLayerStack(&rng, &hw_layers);
+
+      if (rng() % 16 == 0) {
+        resource_intf->Purge(ctx[d]);
+        reference.Release(blocks[d]);
+        continue;
+      }
+
+      DisplayError error = resource_intf->Prepare(ctx[d], &hw_layers);
+      ASSERT_TRUE(error == kErrorNone || error == kErrorResources) << "error " << error;
+
+      std::vector<uint32_t> expected;
+      bool success = reference.Prepare(blocks[d], hw_layers, &expected);
+      ASSERT_EQ(success, error == kErrorNone) << "iteration " << iteration << " frame " << frame;
+      if (success) {
+        EXPECT_EQ(expected, PipeIds(hw_layers)) << "iteration " << iteration << " frame " << frame;
+      }
+
+      frames++;
+      failures += success ? 0 : 1;
+    }
+
+    for (int d = 0; d < 2; d++) {
+      resource_intf->UnregisterDisplay(ctx[d]);
+    }
+    ResourceDefault::DestroyResourceDefault(resource_intf);
+  }
+
+  // Both outcomes have to be exercised for the comparison to mean anything.
+  EXPECT_GT(failures, 0u);
+  EXPECT_GT(frames - failures, 0u);
+}
+
+// The pipes held by a block after a failed Prepare are all returned to the free pool.
+TEST(ResourceDefaultTest, FailedPrepareReleasesPipes) {
+  HWResourceInfo info;
+  info.num_vig_pipe = 1;
+  info.num_rgb_pipe = 3;
+  for (PipeType type : {kPipeTypeVIG, kPipeTypeRGB, kPipeTypeRGB, kPipeTypeRGB}) {
+    info.hw_pipes.push_back({});
+    info.hw_pipes.back().type = type;
+    info.hw_pipes.back().id = UINT32(info.hw_pipes.size());
+  }
+  info.max_scale_up = 1;
+  info.max_scale_down = 1;
+  info.is_src_split = true;
+  info.max_pipe_width = kMaxWidth;
+  info.max_scaler_pipe_width = kMaxWidth;
+
+  ResourceInterface *resource_intf = nullptr;
+  ASSERT_EQ(kErrorNone, ResourceDefault::CreateResourceDefault(info, &resource_intf));
+  Handle builtin = nullptr;
+  Handle pluggable = nullptr;
+  ASSERT_EQ(kErrorNone, resource_intf->RegisterDisplay(0, kBuiltIn, {}, {}, {}, &builtin));
+  ASSERT_EQ(kErrorNone, resource_intf->RegisterDisplay(1, kPluggable, {}, {}, {}, &pluggable));
+
+  Layer layer;
+  layer.input_buffer.width = 1080;
+  layer.input_buffer.height = 1920;
+  layer.input_buffer.format = kFormatRGBA8888;
+  layer.src_rect = {0, 0, 1080, 1920};
+  layer.dst_rect = {0, 0, 1080, 1920};
+  layer.composition = kCompositionSDE;
+
+  // Only one RGB and one VIG pipe are available to user mode, three layers cannot fit.
+  HWLayers hw_layers;
+  hw_layers.info.hw_layers.assign(3, layer);
+  EXPECT_EQ(kErrorResources, resource_intf->Prepare(builtin, &hw_layers));
+
+  HWLayers fitting_layers;
+  fitting_layers.info.hw_layers.assign(2, layer);
+  EXPECT_EQ(kErrorNone, resource_intf->Prepare(pluggable, &fitting_layers));
+  EXPECT_EQ(4u, fitting_layers.config[0].left_pipe.pipe_id);
+  EXPECT_EQ(1u, fitting_layers.config[1].left_pipe.pipe_id);
+
+  resource_intf->UnregisterDisplay(pluggable);
+  resource_intf->UnregisterDisplay(builtin);
+  ResourceDefault::DestroyResourceDefault(resource_intf);
+}
@@ -0,0 +1,195 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/utils.h>
+#include <algorithm>
+
+#include "validate_cache.h"
+
+namespace sdm {
+
+static uint64_t HashScaleData(const HWScaleData &scale_data, uint64_t hash) {
+  // Hashed as a whole: padding can only turn a repeat into a miss, never a miss into a hit.
+  return HashValue(scale_data, hash);
+}
+
+uint64_t ValidateCache::GetSignature(const HWLayers &hw_layers, uint64_t display_state) {
+  const HWLayersInfo &hw_layers_info = hw_layers.info;
+  uint64_t hash = HashValue(display_state);
+
+  // Only the state consumed by the atomic TEST_ONLY check is hashed. Buffer handles, fences and
+  // dirty regions change every frame and do not affect whether the driver accepts the strategy.
+  for (uint32_t i = 0; i < hw_layers_info.hw_layers.size(); i++) {
+    const Layer &layer = hw_layers_info.hw_layers.at(i);
+    const LayerBuffer &input_buffer = layer.input_buffer;
+    const HWLayerConfig &layer_config = hw_layers.config[i];
+
+    hash = HashValue(input_buffer.width, hash);
+    hash = HashValue(input_buffer.height, hash);
+    hash = HashValue(input_buffer.unaligned_width, hash);
+    hash = HashValue(input_buffer.unaligned_height, hash);
+    hash = HashValue(input_buffer.format, hash);
+    hash = HashValue(input_buffer.flags.flags, hash);
+    hash = HashValue(input_buffer.color_metadata.colorPrimaries, hash);
+    hash = HashValue(input_buffer.color_metadata.transfer, hash);
+    hash = HashValue(input_buffer.color_metadata.range, hash);
+    for (auto &plane : input_buffer.planes) {
+      hash = HashValue(plane.stride, hash);
+      hash = HashValue(plane.offset, hash);
+    }
+    hash = HashValue(layer.composition, hash);
+    hash = HashValue(layer.src_rect, hash);
+    hash = HashValue(layer.dst_rect, hash);
+    hash = HashValue(layer.blending, hash);
+    hash = HashValue(layer.transform.rotation, hash);
+    hash = HashValue(layer.transform.flip_horizontal, hash);
+    hash = HashValue(layer.transform.flip_vertical, hash);
+    hash = HashValue(layer.plane_alpha, hash);
+    hash = HashValue(layer.flags.flags, hash);
+    hash = HashValue(layer.solid_fill_color, hash);
+
+    for (const HWPipeInfo *pipe : {&layer_config.left_pipe, &layer_config.right_pipe}) {
+      hash = HashValue(pipe->valid, hash);
+      if (!pipe->valid) {
+        continue;
+      }
+      hash = HashValue(pipe->pipe_id, hash);
+      hash = HashValue(pipe->rect, hash);
+      hash = HashValue(pipe->src_roi, hash);
+      hash = HashValue(pipe->dst_roi, hash);
+      hash = HashValue(pipe->excl_rect, hash);
+      hash = HashValue(pipe->z_order, hash);
+      hash = HashValue(pipe->flags, hash);
+      hash = HashValue(pipe->format, hash);
+      hash = HashValue(pipe->tonemap, hash);
+      hash = HashValue(pipe->horizontal_decimation, hash);
+      hash = HashValue(pipe->vertical_decimation, hash);
+      hash = HashScaleData(pipe->scale_data, hash);
+      hash = HashValue(pipe->inverse_pma_info.op, hash);
+      hash = HashValue(pipe->inverse_pma_info.inverse_pma, hash);
+      hash = HashValue(pipe->dgm_csc_info.op, hash);
+      hash = HashValue(pipe->dgm_csc_info.csc, hash);
+      for (auto &lut : pipe->lut_info) {
+        hash = HashValue(lut.op, hash);
+        hash = HashValue(lut.type, hash);
+      }
+    }
+    hash = HashValue(layer_config.use_inline_rot, hash);
+    hash = HashValue(layer_config.use_solidfill_stage, hash);
+    hash = HashValue(layer_config.hw_rotator_session.mode, hash);
+  }
+
+  for (auto &roi : hw_layers_info.left_frame_roi) {
+    hash = HashValue(roi, hash);
+  }
+  for (auto &roi : hw_layers_info.right_frame_roi) {
+    hash = HashValue(roi, hash);
+  }
+  hash = HashValue(hw_layers_info.roi_split, hash);
+  hash = HashValue(hw_layers_info.hdr_layer_info.operation, hash);
+  for (auto &dest_scale : hw_layers_info.dest_scale_info_map) {
+    const HWDestScaleInfo *dest_scale_info = dest_scale.second;
+    hash = HashValue(dest_scale.first, hash);
+    hash = HashValue(dest_scale_info->mixer_width, hash);
+    hash = HashValue(dest_scale_info->mixer_height, hash);
+    hash = HashValue(dest_scale_info->scale_update, hash);
+    hash = HashValue(dest_scale_info->panel_roi, hash);
+    hash = HashScaleData(dest_scale_info->scale_data, hash);
+  }
+
+  const HWQosData &qos_data = hw_layers.qos_data;
+  hash = HashValue(qos_data.clock_hz, hash);
+  hash = HashValue(qos_data.core_ab_bps, hash);
+  hash = HashValue(qos_data.core_ib_bps, hash);
+  hash = HashValue(qos_data.llcc_ab_bps, hash);
+  hash = HashValue(qos_data.llcc_ib_bps, hash);
+  hash = HashValue(qos_data.dram_ab_bps, hash);
+  hash = HashValue(qos_data.dram_ib_bps, hash);
+  hash = HashValue(hw_layers.hw_avr_info.update, hash);
+  hash = HashValue(hw_layers.hw_avr_info.mode, hash);
+
+  return hash;
+}
+
+DisplayError ValidateCache::Validate(HWInterface *hw_intf, HWLayers *hw_layers,
+                                     uint64_t signature) {
+  if (mode_change_pending_) {
+    return hw_intf->Validate(hw_layers);
+  }
+
+  lookups_++;
+  auto it = std::find_if(entries_.begin(), entries_.end(),
+                         [signature](const std::pair<uint64_t, DisplayError> &entry) {
+                           return entry.first == signature;
+                         });
+  if (it != entries_.end()) {
+    DisplayError error = it->second;
+    // Keep the most recently used signature in front.
+    entries_.erase(it);
+    entries_.emplace_front(signature, error);
+    hits_++;
+    if (error != kErrorNone) {
+      rejected_hits_++;
+    }
+    return error;
+  }
+
+  DisplayError error = hw_intf->Validate(hw_layers);
+  // Only a TEST_ONLY rejection is a verdict on the configuration; other errors are transient.
+  if (error == kErrorNone || error == kErrorHardware) {
+    entries_.emplace_front(signature, error);
+    if (entries_.size() > kMaxEntries) {
+      entries_.pop_back();
+    }
+  }
+
+  return error;
+}
+
+void ValidateCache::Invalidate() {
+  entries_.clear();
+}
+
+void ValidateCache::SetModeChangePending() {
+  entries_.clear();
+  mode_change_pending_ = true;
+}
+
+void ValidateCache::OnCommit() {
+  mode_change_pending_ = false;
+}
+
+void ValidateCache::Dump(std::ostream *os) {
+  *os << " entries: " << entries_.size();
+  *os << " hits: " << hits_ << "/" << lookups_;
+  if (lookups_) {
+    *os << " (" << (hits_ * 100 / lookups_) << "%)";
+  }
+  *os << " rejected hits: " << rejected_hits_;
+  if (mode_change_pending_) {
+    *os << " (mode change pending)";
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,70 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __VALIDATE_CACHE_H__
+#define __VALIDATE_CACHE_H__
+
+#include <core/sdm_types.h>
+#include <private/hw_info_types.h>
+#include <deque>
+#include <ostream>
+#include <utility>
+
+#include "hw_interface.h"
+
+namespace sdm {
+
+// Remembers the driver verdict on recent post-strategy configurations, so that a frame repeating
+// one of them neither issues the TEST_ONLY commit again nor retries a strategy the driver has
+// already rejected.
+class ValidateCache {
+ public:
+  // Hashes everything hw_intf->Validate() passes to the driver. display_state covers display level
+  // settings that are not part of hw_layers, e.g. the QSync mode.
+  static uint64_t GetSignature(const HWLayers &hw_layers, uint64_t display_state);
+
+  // Runs hw_intf->Validate() unless signature has a cached verdict, which is returned instead.
+  DisplayError Validate(HWInterface *hw_intf, HWLayers *hw_layers, uint64_t signature);
+  void Invalidate();
+  // A refresh rate or panel mode switch is staged in the driver and rides on the next TEST_ONLY
+  // and commit, outside of the signature. Until a commit carries it, every frame is validated
+  // and no verdict is kept, as a rejection also drops the staged switch.
+  void SetModeChangePending();
+  void OnCommit();
+  void Dump(std::ostream *os);
+
+  static const uint32_t kMaxEntries = 8;
+
+ private:
+  // Signature and verdict, most recently used first.
+  std::deque<std::pair<uint64_t, DisplayError>> entries_ = {};
+  uint64_t lookups_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t rejected_hits_ = 0;
+  bool mode_change_pending_ = false;
+};
+
+}  // namespace sdm
+
+#endif  // __VALIDATE_CACHE_H__
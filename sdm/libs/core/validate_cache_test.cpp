@@ -0,0 +1,192 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+
+#include "fake_hw_interface.h"
+#include "validate_cache.h"
+
+using namespace sdm;
+
+class ValidateCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Layer layer;
+    layer.input_buffer.width = 1080;
+    layer.input_buffer.height = 2340;
+    layer.input_buffer.format = kFormatRGBA8888;
+    layer.src_rect = {0, 0, 1080, 2340};
+    layer.dst_rect = {0, 0, 1080, 2340};
+    layer.composition = kCompositionSDE;
+    hw_layers_.info.hw_layers.push_back(layer);
+
+    HWPipeInfo &pipe = hw_layers_.config[0].left_pipe;
+    pipe.valid = true;
+    pipe.pipe_id = 45;
+    pipe.src_roi = layer.src_rect;
+    pipe.dst_roi = layer.dst_rect;
+  }
+
+  // Runs the cache the way DisplayBase::Prepare() does.
+  DisplayError Validate() {
+    return cache_.Validate(&hw_intf_, &hw_layers_, ValidateCache::GetSignature(hw_layers_, 0));
+  }
+
+  FakeHWInterface hw_intf_;
+  HWLayers hw_layers_;
+  ValidateCache cache_;
+};
+
+TEST_F(ValidateCacheTest, RepeatedConfigurationSkipsTestCommit) {
+  EXPECT_EQ(kErrorNone, Validate());
+  EXPECT_EQ(kErrorNone, Validate());
+  EXPECT_EQ(1u, hw_intf_.validate_count);
+
+  // Buffer handles and fences are not part of the configuration.
+  hw_layers_.info.hw_layers[0].input_buffer.planes[0].fd = 42;
+  EXPECT_EQ(kErrorNone, Validate());
+  EXPECT_EQ(1u, hw_intf_.validate_count);
+}
+
+TEST_F(ValidateCacheTest, FormatChangeRevalidates) {
+  Validate();
+  hw_layers_.info.hw_layers[0].input_buffer.format = kFormatRGBA8888Ubwc;
+  hw_layers_.config[0].left_pipe.format = kFormatRGBA8888Ubwc;
+  Validate();
+  EXPECT_EQ(2u, hw_intf_.validate_count);
+
+  hw_layers_.info.hw_layers[0].input_buffer.format = kFormatYCbCr420TP10Ubwc;
+  Validate();
+  EXPECT_EQ(3u, hw_intf_.validate_count);
+}
+
+TEST_F(ValidateCacheTest, BufferFlagsChangeRevalidates) {
+  Validate();
+  hw_layers_.info.hw_layers[0].input_buffer.flags.secure = 1;
+  Validate();
+  hw_layers_.info.hw_layers[0].input_buffer.flags.video = 1;
+  Validate();
+  EXPECT_EQ(3u, hw_intf_.validate_count);
+}
+
+TEST_F(ValidateCacheTest, ScalerChangeRevalidates) {
+  Validate();
+  hw_layers_.config[0].left_pipe.scale_data.enable.scale = 1;
+  Validate();
+  hw_layers_.config[0].left_pipe.scale_data.plane[0].phase_step_x = 1 << 20;
+  Validate();
+  EXPECT_EQ(3u, hw_intf_.validate_count);
+}
+
+TEST_F(ValidateCacheTest, DestScalerChangeRevalidates) {
+  HWDestScaleInfo dest_scale_info;
+  dest_scale_info.mixer_width = 1080;
+  dest_scale_info.mixer_height = 2340;
+  hw_layers_.info.dest_scale_info_map[0] = &dest_scale_info;
+  Validate();
+
+  // Same map size, different contents.
+  dest_scale_info.scale_update = true;
+  dest_scale_info.scale_data.enable.scale = 1;
+  Validate();
+  dest_scale_info.panel_roi = {0, 0, 540, 1170};
+  Validate();
+  EXPECT_EQ(3u, hw_intf_.validate_count);
+}
+
+TEST_F(ValidateCacheTest, DisplayStateChangeRevalidates) {
+  Validate();
+  hw_layers_.hw_avr_info.update = true;
+  hw_layers_.hw_avr_info.mode = kOneShotMode;
+  Validate();
+  EXPECT_EQ(kErrorNone, cache_.Validate(&hw_intf_, &hw_layers_,
+                                        ValidateCache::GetSignature(hw_layers_, 1)));
+  EXPECT_EQ(3u, hw_intf_.validate_count);
+}
+
+TEST_F(ValidateCacheTest, RejectedStrategyIsNotRetried) {
+  hw_intf_.on_validate = [](HWLayers *hw_layers) {
+    return hw_layers->config[0].left_pipe.pipe_id == 45 ? kErrorHardware : kErrorNone;
+  };
+
+  // The strategy loop: the first strategy fails validation, the second one passes.
+  for (int frame = 0; frame < 3; frame++) {
+    hw_layers_.config[0].left_pipe.pipe_id = 45;
+    EXPECT_EQ(kErrorHardware, Validate());
+    hw_layers_.config[0].left_pipe.pipe_id = 46;
+    EXPECT_EQ(kErrorNone, Validate());
+  }
+  EXPECT_EQ(2u, hw_intf_.validate_count);
+}
+
+TEST_F(ValidateCacheTest, TransientErrorsAreNotCached) {
+  hw_intf_.on_validate = [](HWLayers *) { return kErrorShutDown; };
+  EXPECT_EQ(kErrorShutDown, Validate());
+  hw_intf_.on_validate = nullptr;
+  EXPECT_EQ(kErrorNone, Validate());
+  EXPECT_EQ(2u, hw_intf_.validate_count);
+}
+
+TEST_F(ValidateCacheTest, RefreshRateChangeRevalidatesUntilCommitted) {
+  EXPECT_EQ(kErrorNone, Validate());
+  EXPECT_EQ(kErrorNone, Validate());
+  EXPECT_EQ(1u, hw_intf_.validate_count);
+
+  // The driver rejects the staged rate and drops it, as HWDeviceDRM::Validate() does.
+  uint32_t staged_rate = 90;
+  hw_intf_.on_validate = [&staged_rate](HWLayers *) {
+    DisplayError error = (staged_rate == 90) ? kErrorHardware : kErrorNone;
+    staged_rate = 0;
+    return error;
+  };
+  EXPECT_EQ(kErrorNone, hw_intf_.SetRefreshRate(staged_rate));
+  cache_.SetModeChangePending();
+
+  // The cached layer stack goes to the driver again, and its rejection is not kept.
+  EXPECT_EQ(kErrorHardware, Validate());
+  EXPECT_EQ(kErrorNone, Validate());
+  EXPECT_EQ(3u, hw_intf_.validate_count);
+
+  // Caching resumes once a commit has carried the switch.
+  cache_.OnCommit();
+  EXPECT_EQ(kErrorNone, Validate());
+  EXPECT_EQ(kErrorNone, Validate());
+  EXPECT_EQ(4u, hw_intf_.validate_count);
+}
+
+TEST_F(ValidateCacheTest, InvalidateAndEviction) {
+  Validate();
+  cache_.Invalidate();
+  Validate();
+  EXPECT_EQ(2u, hw_intf_.validate_count);
+
+  // Fill the cache with other configurations until the first one is evicted.
+  for (uint32_t i = 0; i < ValidateCache::kMaxEntries; i++) {
+    hw_layers_.config[0].left_pipe.z_order = i + 1;
+    Validate();
+  }
+  hw_layers_.config[0].left_pipe.z_order = 0;
+  Validate();
+  EXPECT_EQ(3u + ValidateCache::kMaxEntries, hw_intf_.validate_count);
+}
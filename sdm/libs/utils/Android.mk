@@ -13,8 +13,41 @@ LOCAL_SRC_FILES               := debug.cpp \
                                  rect.cpp \
                                  sys.cpp \
                                  fence.cpp \
+                                 fence_watcher.cpp \
                                  formats.cpp \
-                                 utils.cpp
+                                 utils.cpp \
+                                 frame_trace.cpp \
+                                 locker.cpp
 
 LOCAL_SHARED_LIBRARIES        := libdisplaydebug
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+include $(LOCAL_PATH)/../../../common.mk
+
+LOCAL_MODULE                  := sdm_utils_test
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes)
+LOCAL_HEADER_LIBRARIES        := display_headers
+LOCAL_CFLAGS                  := -DLOG_TAG=\"SDM\" $(common_flags)
+LOCAL_SRC_FILES               := locker_test.cpp \
+                                 fence_watcher_test.cpp \
+                                 frame_trace_test.cpp \
+                                 rect_test.cpp
+LOCAL_STATIC_LIBRARIES        := libgtest libgtest_main
+LOCAL_SHARED_LIBRARIES        := libsdmutils
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+include $(LOCAL_PATH)/../../../common.mk
+
+LOCAL_MODULE                  := rect_bench
+LOCAL_VENDOR_MODULE           := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes)
+LOCAL_HEADER_LIBRARIES        := display_headers
+LOCAL_CFLAGS                  := -DLOG_TAG=\"SDM\" $(common_flags)
+LOCAL_SRC_FILES               := rect_bench.cpp
+LOCAL_SHARED_LIBRARIES        := libsdmutils
+include $(BUILD_EXECUTABLE)
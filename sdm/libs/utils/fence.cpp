@@ -28,11 +28,14 @@
 */
 
 #include <utils/fence.h>
+#include <utils/fence_watcher.h>
+#include <utils/frame_trace.h>
 #include <debug_handler.h>
 #include <assert.h>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <mutex>
 
 #define __CLASS__ "Fence"
 
@@ -42,6 +45,7 @@ namespace sdm {
 
 BufferSyncHandler* Fence::g_buffer_sync_handler_ = nullptr;
 std::vector<std::weak_ptr<Fence>> Fence::wps_;
+std::atomic<FenceWatcher *> Fence::g_watcher_(nullptr);
 
 Fence::Fence(int fd, const string &name) : fd_(fd), name_(name) {
 }
@@ -116,6 +120,7 @@ shared_ptr<Fence> Fence::Merge(const std::vector<shared_ptr<Fence>> &fences, boo
 
 DisplayError Fence::Wait(const shared_ptr<Fence> &fence) {
   ASSERT_IF_NO_BUFFER_SYNC(g_buffer_sync_handler_);
+  FRAME_TRACE_SCOPED(FrameTrace::kInheritDisplay, kFrameTraceFenceWait);
 
   return g_buffer_sync_handler_->SyncWait(Fence::Get(fence), 1000);
 }
@@ -123,6 +128,12 @@ DisplayError Fence::Wait(const shared_ptr<Fence> &fence) {
 DisplayError Fence::Wait(const shared_ptr<Fence> &fence, int timeout) {
   ASSERT_IF_NO_BUFFER_SYNC(g_buffer_sync_handler_);
 
+  if (!timeout) {
+    // A status poll, not a wait.
+    return g_buffer_sync_handler_->SyncWait(Fence::Get(fence), timeout);
+  }
+
+  FRAME_TRACE_SCOPED(FrameTrace::kInheritDisplay, kFrameTraceFenceWait);
   return g_buffer_sync_handler_->SyncWait(Fence::Get(fence), timeout);
 }
 
@@ -142,6 +153,24 @@ string Fence::GetStr(const shared_ptr<Fence> &fence) {
   return std::to_string(Fence::Get(fence));
 }
 
+FenceWatcher *Fence::GetWatcher() {
+  ASSERT_IF_NO_BUFFER_SYNC(g_buffer_sync_handler_);
+
+  static std::once_flag once;
+  std::call_once(once, [] {
+    // Lives as long as the process, like the handler it watches with.
+    FenceWatcher *watcher = new FenceWatcher(g_buffer_sync_handler_, "sdm_fence_watch");
+    if (watcher->Init() != kErrorNone) {
+      DLOGE("Failed to start fence watcher");
+      delete watcher;
+      return;
+    }
+    g_watcher_.store(watcher);
+  });
+
+  return g_watcher_.load();
+}
+
 void Fence::Dump(std::ostringstream *os) {
   ASSERT_IF_NO_BUFFER_SYNC(g_buffer_sync_handler_);
 
@@ -160,6 +189,10 @@ void Fence::Dump(std::ostringstream *os) {
     g_buffer_sync_handler_->GetSyncInfo(fence->fd_, os);
   }
   */
+  FenceWatcher *watcher = g_watcher_.load();
+  if (watcher) {
+    watcher->Dump(os);
+  }
   *os << "\n---------------------------------------\n";
 }
 
@@ -0,0 +1,382 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/fence_watcher.h>
+#include <utils/constants.h>
+#include <utils/sys.h>
+#include <debug_handler.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <time.h>
+#include <memory>
+#include <vector>
+
+#define __CLASS__ "FenceWatcher"
+
+namespace sdm {
+
+static const int kMaxEvents = 16;
+
+const FenceWatcher::WatchId FenceWatcher::kInvalidWatchId;
+
+static int64_t Now() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+FenceWatcher::FenceWatcher(BufferSyncHandler *buffer_sync_handler, const string &name)
+  : buffer_sync_handler_(buffer_sync_handler), name_(name) {
+  locker_.SetName("FenceWatcher::locker_");
+}
+
+FenceWatcher::~FenceWatcher() {
+  Deinit();
+}
+
+DisplayError FenceWatcher::Init() {
+  SCOPE_LOCK(locker_);
+  if (epoll_fd_ >= 0) {
+    return kErrorNone;
+  }
+
+  if (!buffer_sync_handler_) {
+    return kErrorParameters;
+  }
+
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    DLOGE("epoll_create1 failed. error = %s", strerror(errno));
+    return kErrorResources;
+  }
+
+  // The wake fd is registered with id kInvalidWatchId.
+  wake_fd_ = Sys::eventfd_(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = kInvalidWatchId;
+  if (wake_fd_ < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event)) {
+    DLOGE("Failed to set up wake fd. error = %s", strerror(errno));
+    if (wake_fd_ >= 0) {
+      Sys::close_(wake_fd_);
+    }
+    Sys::close_(epoll_fd_);
+    wake_fd_ = -1;
+    epoll_fd_ = -1;
+    return kErrorResources;
+  }
+
+  exit_thread_ = false;
+  watch_thread_ = std::thread(&FenceWatcher::WatchThread, this);
+  watch_thread_id_ = watch_thread_.get_id();
+  DLOGI("%s started", name_.c_str());
+
+  return kErrorNone;
+}
+
+void FenceWatcher::Deinit() {
+  std::vector<Completion> completions;
+  {
+    SCOPE_LOCK(locker_);
+    if (epoll_fd_ < 0) {
+      return;
+    }
+    exit_thread_ = true;
+    Wake();
+  }
+
+  watch_thread_.join();
+
+  {
+    SCOPE_LOCK(locker_);
+    int64_t now = Now();
+    while (!pending_.empty()) {
+      Complete(pending_.begin()->first, Result::kCancelled, now, &completions);
+    }
+    Sys::close_(wake_fd_);
+    Sys::close_(epoll_fd_);
+    wake_fd_ = -1;
+    epoll_fd_ = -1;
+  }
+
+  for (auto &completion : completions) {
+    completion.callback(completion.result, completion.wait_ns);
+  }
+}
+
+DisplayError FenceWatcher::Watch(const shared_ptr<Fence> &fence, int timeout_ms,
+                                 const string &tag, const Callback &callback, WatchId *id) {
+  if (id) {
+    *id = kInvalidWatchId;
+  }
+
+  if (!callback) {
+    return kErrorParameters;
+  }
+
+  if (!fence) {
+    callback(Result::kSignaled, 0);
+    return kErrorNone;
+  }
+
+  SCOPE_LOCK(locker_);
+  if (epoll_fd_ < 0 || exit_thread_) {
+    return kErrorNotSupported;
+  }
+
+  PendingWatch watch;
+  watch.fd = Fence::Dup(fence);
+  if (watch.fd < 0) {
+    DLOGE("Failed to dup fence %s. error = %s", Fence::GetStr(fence).c_str(), strerror(errno));
+    return kErrorResources;
+  }
+  watch.start_ns = Now();
+  watch.deadline_ns = (timeout_ms < 0) ? -1 : (watch.start_ns + timeout_ms * 1000000LL);
+  watch.tag = tag;
+  watch.callback = callback;
+
+  WatchId watch_id = next_id_++;
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = watch_id;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, watch.fd, &event)) {
+    DLOGE("Failed to watch fence %s. error = %s", Fence::GetStr(fence).c_str(), strerror(errno));
+    Sys::close_(watch.fd);
+    return kErrorResources;
+  }
+
+  pending_[watch_id] = std::move(watch);
+  if (timeout_ms >= 0) {
+    // The watcher thread may be sleeping past the new deadline.
+    Wake();
+  }
+
+  if (id) {
+    *id = watch_id;
+  }
+
+  return kErrorNone;
+}
+
+DisplayError FenceWatcher::Watch(const shared_ptr<Fence> &fence, int timeout_ms,
+                                 const string &tag, std::future<Result> *result) {
+  if (!result) {
+    return kErrorParameters;
+  }
+
+  auto promise = std::make_shared<std::promise<Result>>();
+  *result = promise->get_future();
+  DisplayError error = Watch(fence, timeout_ms, tag, [promise](Result watch_result, int64_t) {
+    promise->set_value(watch_result);
+  });
+  if (error != kErrorNone) {
+    *result = {};
+  }
+
+  return error;
+}
+
+bool FenceWatcher::Cancel(WatchId id) {
+  std::vector<Completion> completions;
+  {
+    SCOPE_LOCK(locker_);
+    if (pending_.find(id) == pending_.end()) {
+      // Let a running callback finish so that the caller may release what it refers to.
+      while (completing_.count(id) && std::this_thread::get_id() != watch_thread_id_) {
+        locker_.Wait();
+      }
+      return false;
+    }
+
+    Complete(id, Result::kCancelled, Now(), &completions);
+  }
+
+  completions[0].callback(Result::kCancelled, completions[0].wait_ns);
+
+  return true;
+}
+
+void FenceWatcher::Complete(WatchId id, Result result, int64_t now,
+                            std::vector<Completion> *completions) {
+  auto it = pending_.find(id);
+  PendingWatch &watch = it->second;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, watch.fd, nullptr);
+  Sys::close_(watch.fd);
+
+  int64_t wait_ns = now - watch.start_ns;
+  FenceWatchStats &stats = stats_[watch.tag];
+  switch (result) {
+    case Result::kSignaled:
+      stats.signaled++;
+      stats.total_wait_ns += UINT64(wait_ns);
+      stats.max_wait_ns = std::max(stats.max_wait_ns, UINT64(wait_ns));
+      stats.last_wait_ns = UINT64(wait_ns);
+      break;
+    case Result::kTimedOut:
+      stats.timed_out++;
+      DLOGW("%s fence timed out after %" PRId64 " ms", watch.tag.c_str(), wait_ns / 1000000);
+      break;
+    case Result::kCancelled:
+      stats.cancelled++;
+      break;
+    case Result::kFailed:
+      stats.failed++;
+      break;
+  }
+
+  completions->push_back({id, result, wait_ns, std::move(watch.callback)});
+  pending_.erase(it);
+}
+
+void FenceWatcher::CheckPending(const struct epoll_event *events, int num_events,
+                                std::vector<Completion> *completions) {
+  int64_t now = Now();
+  for (int i = 0; i < num_events; i++) {
+    WatchId id = events[i].data.u64;
+    if (id == kInvalidWatchId) {
+      uint64_t count = 0;
+      Sys::read_(wake_fd_, &count, sizeof(count));
+      continue;
+    }
+
+    auto it = pending_.find(id);
+    if (it == pending_.end()) {
+      // Cancelled after epoll_wait() returned.
+      continue;
+    }
+
+    // Readiness is only a hint, the sync handler decides whether the fence signaled successfully.
+    DisplayError error = buffer_sync_handler_->SyncWait(it->second.fd, 0);
+    if (error == kErrorTimeOut && !(events[i].events & (EPOLLERR | EPOLLHUP))) {
+      continue;
+    }
+    Complete(id, (error == kErrorNone) ? Result::kSignaled : Result::kFailed, now, completions);
+  }
+
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    WatchId id = it->first;
+    int64_t deadline_ns = it->second.deadline_ns;
+    it++;
+    if (deadline_ns >= 0 && now >= deadline_ns) {
+      Complete(id, Result::kTimedOut, now, completions);
+    }
+  }
+}
+
+int FenceWatcher::GetPollTimeout(int64_t now) {
+  // Pending fences are few, a scan is cheaper than keeping a deadline queue in order.
+  int64_t nearest_ns = -1;
+  for (auto &it : pending_) {
+    int64_t deadline_ns = it.second.deadline_ns;
+    if (deadline_ns >= 0 && (nearest_ns < 0 || deadline_ns < nearest_ns)) {
+      nearest_ns = deadline_ns;
+    }
+  }
+
+  if (nearest_ns < 0) {
+    return -1;
+  }
+
+  // Round up so that the deadline has passed on wake up.
+  return INT(std::max((nearest_ns - now + 999999) / 1000000, int64_t(0)));
+}
+
+void FenceWatcher::Wake() {
+  uint64_t count = 1;
+  Sys::write_(wake_fd_, &count, sizeof(count));
+}
+
+void FenceWatcher::WatchThread() {
+  prctl(PR_SET_NAME, name_.c_str(), 0, 0, 0);
+
+  struct epoll_event events[kMaxEvents];
+  std::vector<Completion> completions;
+  int timeout_ms = -1;
+  while (true) {
+    int num_events = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+    if (num_events < 0 && errno != EINTR) {
+      DLOGW("epoll_wait failed. error = %s", strerror(errno));
+    }
+
+    {
+      SCOPE_LOCK(locker_);
+      if (exit_thread_) {
+        break;
+      }
+      CheckPending(events, std::max(num_events, 0), &completions);
+      for (auto &completion : completions) {
+        completing_.insert(completion.id);
+      }
+    }
+
+    for (auto &completion : completions) {
+      completion.callback(completion.result, completion.wait_ns);
+      SCOPE_LOCK(locker_);
+      completing_.erase(completion.id);
+      locker_.Broadcast();
+    }
+    completions.clear();
+
+    SCOPE_LOCK(locker_);
+    timeout_ms = GetPollTimeout(Now());
+  }
+}
+
+bool FenceWatcher::GetStats(const string &tag, FenceWatchStats *stats) {
+  SCOPE_LOCK(locker_);
+  auto it = stats_.find(tag);
+  if (it == stats_.end()) {
+    return false;
+  }
+
+  *stats = it->second;
+  return true;
+}
+
+void FenceWatcher::Dump(std::ostringstream *os) {
+  SCOPE_LOCK(locker_);
+  char line[256];
+  int64_t now = Now();
+
+  *os << "\n" << name_ << ": " << pending_.size() << " pending";
+  for (auto &it : pending_) {
+    snprintf(line, sizeof(line), "\n  %s: waiting %" PRId64 " ms", it.second.tag.c_str(),
+             (now - it.second.start_ns) / 1000000);
+    *os << line;
+  }
+  for (auto &it : stats_) {
+    const FenceWatchStats &stats = it.second;
+    double avg_ms = stats.signaled ? DOUBLE(stats.total_wait_ns) / DOUBLE(stats.signaled) / 1e6 : 0;
+    snprintf(line, sizeof(line), "\n  %s: signaled %" PRIu64 " avg %.3f ms max %.3f ms last "
+             "%.3f ms, timed out %" PRIu64 ", cancelled %" PRIu64 ", failed %" PRIu64,
+             it.first.c_str(), stats.signaled, avg_ms, DOUBLE(stats.max_wait_ns) / 1e6,
+             DOUBLE(stats.last_wait_ns) / 1e6, stats.timed_out, stats.cancelled, stats.failed);
+    *os << line;
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,256 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+#include <utils/constants.h>
+#include <utils/fence_watcher.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace sdm;
+using namespace std::chrono_literals;
+
+typedef FenceWatcher::Result Result;
+
+// Stands in for sync fences with eventfds, which poll readable once written to.
+class EventFdSyncHandler : public BufferSyncHandler {
+ public:
+  DisplayError SyncWait(int fd) { return SyncWait(fd, 1000); }
+  DisplayError SyncWait(int fd, int timeout) {
+    if (failed_fds_.count(fd)) {
+      return kErrorUndefined;
+    }
+    struct pollfd poll_fd = {fd, POLLIN, 0};
+    int ret = poll(&poll_fd, 1, timeout);
+    return (ret > 0) ? kErrorNone : (ret == 0 ? kErrorTimeOut : kErrorUndefined);
+  }
+  DisplayError SyncMerge(int fd1, int fd2, int *merged_fd) { return kErrorNotSupported; }
+  bool IsSyncSignaled(int fd) { return SyncWait(fd, 0) == kErrorNone; }
+  void GetSyncInfo(int fd, std::ostringstream *os) {}
+
+  std::set<int> failed_fds_;  // Fences that report an error status, matched by dup'd fd
+};
+
+static shared_ptr<Fence> CreateFence(int *signal_fd) {
+  int fd = eventfd(0, EFD_CLOEXEC);
+  *signal_fd = dup(fd);
+  return Fence::Create(fd, "test");
+}
+
+static void Signal(int signal_fd) {
+  uint64_t count = 1;
+  ASSERT_EQ(write(signal_fd, &count, sizeof(count)), ssize_t(sizeof(count)));
+}
+
+class FenceWatcherTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    Fence::Set(&handler_);
+    ASSERT_EQ(watcher_.Init(), kErrorNone);
+  }
+  void TearDown() {
+    watcher_.Deinit();
+    for (int fd : signal_fds_) {
+      close(fd);
+    }
+  }
+
+  shared_ptr<Fence> NewFence(int *signal_fd) {
+    shared_ptr<Fence> fence = CreateFence(signal_fd);
+    signal_fds_.push_back(*signal_fd);
+    return fence;
+  }
+
+  EventFdSyncHandler handler_;
+  FenceWatcher watcher_ {&handler_, "test_fence_watch"};
+  std::vector<int> signal_fds_;
+};
+
+TEST_F(FenceWatcherTest, NullFenceSignalsAtOnce) {
+  std::future<Result> result;
+  ASSERT_EQ(watcher_.Watch(nullptr, 100, "null", &result), kErrorNone);
+  EXPECT_EQ(result.wait_for(0s), std::future_status::ready);
+  EXPECT_EQ(result.get(), Result::kSignaled);
+}
+
+TEST_F(FenceWatcherTest, SignalsManyFencesFromOneThread) {
+  const int kFences = 32;
+  std::vector<int> signal_fds(kFences);
+  std::vector<std::future<Result>> results(kFences);
+  std::atomic<int> callbacks(0);
+  std::thread::id callback_thread;
+
+  for (int i = 0; i < kFences; i++) {
+    shared_ptr<Fence> fence = NewFence(&signal_fds[i]);
+    if (i % 2) {
+      ASSERT_EQ(watcher_.Watch(fence, -1, "odd", &results[i]), kErrorNone);
+    } else {
+      auto promise = std::make_shared<std::promise<Result>>();
+      results[i] = promise->get_future();
+      ASSERT_EQ(watcher_.Watch(fence, 1000, "even", [&, promise](Result result, int64_t wait_ns) {
+        callback_thread = std::this_thread::get_id();
+        callbacks++;
+        promise->set_value(result);
+      }), kErrorNone);
+    }
+  }
+
+  // The watcher holds its own reference, dropping the fence must not end the watch.
+  std::this_thread::sleep_for(5ms);
+  for (int i = kFences - 1; i >= 0; i--) {
+    Signal(signal_fds[i]);
+  }
+
+  for (auto &result : results) {
+    ASSERT_EQ(result.wait_for(1s), std::future_status::ready);
+    EXPECT_EQ(result.get(), Result::kSignaled);
+  }
+  EXPECT_EQ(callbacks, kFences / 2);
+  EXPECT_NE(callback_thread, std::this_thread::get_id());
+
+  FenceWatchStats stats;
+  ASSERT_TRUE(watcher_.GetStats("odd", &stats));
+  EXPECT_EQ(stats.signaled, UINT64(kFences / 2));
+  EXPECT_EQ(stats.timed_out + stats.cancelled + stats.failed, 0u);
+  EXPECT_GE(stats.max_wait_ns, UINT64(std::chrono::nanoseconds(5ms).count()));
+  EXPECT_GE(stats.total_wait_ns, stats.max_wait_ns);
+  ASSERT_TRUE(watcher_.GetStats("even", &stats));
+  EXPECT_EQ(stats.signaled, UINT64(kFences / 2));
+}
+
+TEST_F(FenceWatcherTest, TimesOut) {
+  int signal_fd = -1;
+  std::future<Result> late, never;
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(watcher_.Watch(NewFence(&signal_fd), -1, "never", &never), kErrorNone);
+  ASSERT_EQ(watcher_.Watch(NewFence(&signal_fd), 20, "late", &late), kErrorNone);
+
+  ASSERT_EQ(late.wait_for(1s), std::future_status::ready);
+  EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+  EXPECT_EQ(late.get(), Result::kTimedOut);
+  EXPECT_EQ(never.wait_for(0s), std::future_status::timeout);
+
+  FenceWatchStats stats;
+  ASSERT_TRUE(watcher_.GetStats("late", &stats));
+  EXPECT_EQ(stats.timed_out, 1u);
+  EXPECT_EQ(stats.signaled, 0u);
+
+  // Pending watches are cancelled on Deinit().
+  watcher_.Deinit();
+  ASSERT_EQ(never.wait_for(0s), std::future_status::ready);
+  EXPECT_EQ(never.get(), Result::kCancelled);
+}
+
+TEST_F(FenceWatcherTest, Cancels) {
+  int signal_fd = -1;
+  FenceWatcher::WatchId id = FenceWatcher::kInvalidWatchId;
+  std::atomic<int> calls(0);
+  Result cancel_result = Result::kSignaled;
+  ASSERT_EQ(watcher_.Watch(NewFence(&signal_fd), 1000, "cancel", [&](Result result, int64_t) {
+    cancel_result = result;
+    calls++;
+  }, &id), kErrorNone);
+  ASSERT_NE(id, FenceWatcher::kInvalidWatchId);
+
+  EXPECT_TRUE(watcher_.Cancel(id));
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(cancel_result, Result::kCancelled);
+
+  // A cancelled watch neither fires again nor cancels twice.
+  Signal(signal_fd);
+  std::this_thread::sleep_for(10ms);
+  EXPECT_FALSE(watcher_.Cancel(id));
+  EXPECT_EQ(calls, 1);
+
+  FenceWatchStats stats;
+  ASSERT_TRUE(watcher_.GetStats("cancel", &stats));
+  EXPECT_EQ(stats.cancelled, 1u);
+  EXPECT_EQ(stats.signaled, 0u);
+}
+
+TEST_F(FenceWatcherTest, CancelWaitsForRunningCallback) {
+  int signal_fd = -1;
+  FenceWatcher::WatchId id = FenceWatcher::kInvalidWatchId;
+  std::promise<void> entered;
+  std::atomic<bool> returned(false);
+  ASSERT_EQ(watcher_.Watch(NewFence(&signal_fd), -1, "slow", [&](Result result, int64_t) {
+    entered.set_value();
+    std::this_thread::sleep_for(20ms);
+    returned = true;
+  }, &id), kErrorNone);
+
+  Signal(signal_fd);
+  entered.get_future().wait();
+  EXPECT_FALSE(watcher_.Cancel(id));
+  EXPECT_TRUE(returned);
+}
+
+TEST_F(FenceWatcherTest, ReportsFailedFences) {
+  int signal_fd = -1;
+  shared_ptr<Fence> fence = NewFence(&signal_fd);
+  // The watcher watches its own dup of the fence fd, the next free descriptor.
+  int next_fd = dup(signal_fd);
+  close(next_fd);
+  handler_.failed_fds_.insert(next_fd);
+
+  std::future<Result> result;
+  ASSERT_EQ(watcher_.Watch(fence, 1000, "failed", &result), kErrorNone);
+  Signal(signal_fd);
+  ASSERT_EQ(result.wait_for(1s), std::future_status::ready);
+  EXPECT_EQ(result.get(), Result::kFailed);
+}
+
+TEST_F(FenceWatcherTest, DumpShowsPendingAndStats) {
+  int signal_fd = -1;
+  std::future<Result> result;
+  ASSERT_EQ(watcher_.Watch(NewFence(&signal_fd), -1, "retire", &result), kErrorNone);
+
+  std::ostringstream os;
+  watcher_.Dump(&os);
+  EXPECT_NE(os.str().find("test_fence_watch: 1 pending"), std::string::npos) << os.str();
+  EXPECT_NE(os.str().find("retire: waiting"), std::string::npos) << os.str();
+
+  Signal(signal_fd);
+  ASSERT_EQ(result.get(), Result::kSignaled);
+  os.str("");
+  watcher_.Dump(&os);
+  EXPECT_NE(os.str().find("retire: signaled 1 "), std::string::npos) << os.str();
+}
+
+TEST(FenceWatcherInit, WatchFailsWhenNotStarted) {
+  EventFdSyncHandler handler;
+  FenceWatcher watcher(&handler, "idle");
+  int signal_fd = -1;
+  std::future<Result> result;
+  EXPECT_EQ(watcher.Watch(CreateFence(&signal_fd), 10, "idle", &result), kErrorNotSupported);
+  EXPECT_FALSE(result.valid());
+  close(signal_fd);
+}
@@ -0,0 +1,412 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/frame_trace.h>
+#include <utils/constants.h>
+#include <debug_handler.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#define __CLASS__ "FrameTrace"
+
+namespace sdm {
+
+static const char *kStageNames[kFrameTraceStageMax] = {
+  "commands", "build_layer_stack", "prepare", "strategy", "validate", "commit", "atomic_commit",
+  "fence_wait", "release_fences",
+};
+
+const char *FrameTrace::GetStageName(FrameTraceStage stage) {
+  return (stage < kFrameTraceStageMax) ? kStageNames[stage] : "unknown";
+}
+
+int64_t FrameTrace::Now() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#ifdef FRAME_TRACE_ENABLE
+
+static const uint32_t kRingSize = 512;  // Records kept per thread, a power of two
+static const uint32_t kMaxRings = 16;   // Threads tracing at the same time
+// Counters are kept for displays -1 to kCounterDisplays - 2, higher ids share the last bucket.
+static const uint32_t kCounterDisplays = 8;
+
+// Single writer ring. The owning thread claims a slot by advancing claimed_ before writing it and
+// publishes it by advancing head_. A reader copies the published slots and then drops those whose
+// index a concurrent write may have reused, which it detects by re-reading claimed_.
+struct TraceRing {
+  struct Slot {
+    std::atomic<int64_t> start_ns;
+    std::atomic<uint64_t> info;  // duration_ns << 32 | uint16 display_id << 8 | stage
+  };
+
+  struct Counter {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+  };
+
+  std::atomic<bool> owned;
+  std::atomic<int32_t> tid;
+  std::atomic<uint64_t> claimed;
+  std::atomic<uint64_t> head;
+  Slot slots[kRingSize];
+  Counter counters[kCounterDisplays][kFrameTraceStageMax];
+};
+
+struct TraceEvent {
+  int64_t start_ns;
+  uint32_t duration_ns;
+  int32_t tid;
+  int16_t display_id;
+  uint8_t stage;
+};
+
+static TraceRing g_rings[kMaxRings];
+static std::atomic<uint64_t> g_ring_misses(0);  // Records dropped because every ring was owned
+
+// Returns the ring to its pool when the owning thread exits. Its records stay readable until the
+// next owner overwrites them, reported under the new owner's tid.
+class ThreadRing {
+ public:
+  ~ThreadRing() {
+    if (ring_) {
+      ring_->owned.store(false, std::memory_order_release);
+    }
+  }
+
+  TraceRing *Get() {
+    if (!ring_ && !exhausted_) {
+      for (auto &ring : g_rings) {
+        bool owned = false;
+        if (ring.owned.compare_exchange_strong(owned, true, std::memory_order_acq_rel)) {
+          ring.tid.store(static_cast<int32_t>(syscall(SYS_gettid)), std::memory_order_relaxed);
+          ring_ = &ring;
+          break;
+        }
+      }
+      exhausted_ = !ring_;
+    }
+    return ring_;
+  }
+
+ private:
+  TraceRing *ring_ = nullptr;
+  bool exhausted_ = false;
+};
+
+static thread_local ThreadRing t_ring;
+static thread_local int32_t t_display_id = -1;
+
+static uint32_t CounterIndex(int32_t display_id) {
+  return static_cast<uint32_t>(std::min(std::max(display_id + 1, 0),
+                                        static_cast<int32_t>(kCounterDisplays - 1)));
+}
+
+static void RecordTo(TraceRing *ring, int32_t display_id, FrameTraceStage stage, int64_t start_ns,
+                     int64_t end_ns) {
+  int64_t elapsed_ns = std::max(end_ns - start_ns, static_cast<int64_t>(0));
+  uint64_t duration_ns = std::min(static_cast<uint64_t>(elapsed_ns), UINT64(UINT32_MAX));
+  uint64_t info = (duration_ns << 32) | (UINT64(static_cast<uint16_t>(display_id)) << 8) | stage;
+
+  uint64_t index = ring->head.load(std::memory_order_relaxed);
+  ring->claimed.store(index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  TraceRing::Slot &slot = ring->slots[index & (kRingSize - 1)];
+  slot.start_ns.store(start_ns, std::memory_order_relaxed);
+  slot.info.store(info, std::memory_order_relaxed);
+  ring->head.store(index + 1, std::memory_order_release);
+
+  // Only the owner writes the counters, so plain load and store pairs are enough.
+  TraceRing::Counter &counter = ring->counters[CounterIndex(display_id)][stage];
+  counter.count.store(counter.count.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+  counter.total_ns.store(counter.total_ns.load(std::memory_order_relaxed) + duration_ns,
+                         std::memory_order_relaxed);
+  if (duration_ns > counter.max_ns.load(std::memory_order_relaxed)) {
+    counter.max_ns.store(duration_ns, std::memory_order_relaxed);
+  }
+}
+
+static void Snapshot(const TraceRing &ring, std::vector<TraceEvent> *events) {
+  uint64_t head = ring.head.load(std::memory_order_acquire);
+  uint64_t first = (head > kRingSize) ? head - kRingSize : 0;
+  size_t begin = events->size();
+  int32_t tid = ring.tid.load(std::memory_order_relaxed);
+  for (uint64_t index = first; index < head; index++) {
+    const TraceRing::Slot &slot = ring.slots[index & (kRingSize - 1)];
+    uint64_t info = slot.info.load(std::memory_order_relaxed);
+    TraceEvent event = {};
+    event.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+    event.duration_ns = static_cast<uint32_t>(info >> 32);
+    event.tid = tid;
+    event.display_id = static_cast<int16_t>((info >> 8) & 0xffff);
+    event.stage = static_cast<uint8_t>(info & 0xff);
+    events->push_back(event);
+  }
+
+  // Drop the records the owner may have overwritten while they were copied.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint64_t claimed = ring.claimed.load(std::memory_order_relaxed);
+  uint64_t valid = (claimed > kRingSize) ? claimed - kRingSize : 0;
+  if (valid > first) {
+    size_t stale = static_cast<size_t>(std::min(valid, head) - first);
+    events->erase(events->begin() + static_cast<std::ptrdiff_t>(begin),
+                  events->begin() + static_cast<std::ptrdiff_t>(begin + stale));
+  }
+}
+
+static std::vector<TraceEvent> SnapshotAll() {
+  std::vector<TraceEvent> events;
+  events.reserve(kMaxRings * kRingSize);
+  for (auto &ring : g_rings) {
+    Snapshot(ring, &events);
+  }
+  std::sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) {
+    return a.start_ns < b.start_ns;
+  });
+  return events;
+}
+
+// Cost of one trace point, clock reads included, measured on a ring nobody else reads.
+static int64_t MeasureRecordCost() {
+  const int kIterations = 1024;
+  std::unique_ptr<TraceRing> ring(new TraceRing());
+  int64_t start_ns = FrameTrace::Now();
+  for (int i = 0; i < kIterations; i++) {
+    int64_t now = FrameTrace::Now();
+    RecordTo(ring.get(), 0, kFrameTraceStrategy, now, FrameTrace::Now());
+  }
+  return (FrameTrace::Now() - start_ns) / kIterations;
+}
+
+static uint32_t Percentile(std::vector<uint32_t> *values, size_t percent) {
+  if (values->empty()) {
+    return 0;
+  }
+  size_t index = std::min(values->size() - 1, values->size() * percent / 100);
+  std::nth_element(values->begin(), values->begin() + static_cast<std::ptrdiff_t>(index),
+                   values->end());
+  return values->at(index);
+}
+
+void FrameTrace::Record(int32_t display_id, FrameTraceStage stage, int64_t start_ns,
+                        int64_t end_ns) {
+  TraceRing *ring = t_ring.Get();
+  if (!ring) {
+    g_ring_misses.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  RecordTo(ring, (display_id == kInheritDisplay) ? t_display_id : display_id, stage, start_ns,
+           end_ns);
+}
+
+int32_t FrameTrace::SetThreadDisplay(int32_t display_id) {
+  int32_t parent = t_display_id;
+  if (display_id != kInheritDisplay) {
+    t_display_id = display_id;
+  }
+  return parent;
+}
+
+void FrameTrace::Dump(std::ostringstream *os) {
+  std::vector<TraceEvent> events = SnapshotAll();
+
+  // Percentiles come from the records still in the rings, counters cover the whole run.
+  std::map<std::pair<int32_t, uint8_t>, std::vector<uint32_t>> durations;
+  for (auto &event : events) {
+    durations[{event.display_id, event.stage}].push_back(event.duration_ns);
+  }
+
+  uint64_t count[kCounterDisplays][kFrameTraceStageMax] = {};
+  uint64_t total_ns[kCounterDisplays][kFrameTraceStageMax] = {};
+  uint64_t max_ns[kCounterDisplays][kFrameTraceStageMax] = {};
+  for (auto &ring : g_rings) {
+    for (uint32_t display = 0; display < kCounterDisplays; display++) {
+      for (uint32_t stage = 0; stage < kFrameTraceStageMax; stage++) {
+        const TraceRing::Counter &counter = ring.counters[display][stage];
+        count[display][stage] += counter.count.load(std::memory_order_relaxed);
+        total_ns[display][stage] += counter.total_ns.load(std::memory_order_relaxed);
+        max_ns[display][stage] = std::max(max_ns[display][stage],
+                                          counter.max_ns.load(std::memory_order_relaxed));
+      }
+    }
+  }
+
+  char line[128];
+  *os << "\n------------Frame Trace------------\n";
+  snprintf(line, sizeof(line), "Trace point cost: %" PRId64 " ns, %u records per thread, "
+           "%" PRIu64 " records dropped\n", MeasureRecordCost(), kRingSize,
+           g_ring_misses.load(std::memory_order_relaxed));
+  *os << line;
+  snprintf(line, sizeof(line), "%-8s %-18s %10s %9s %9s %9s %9s\n", "display", "stage", "count",
+           "mean_us", "p50_us", "p99_us", "max_us");
+  *os << line;
+
+  for (uint32_t display = 0; display < kCounterDisplays; display++) {
+    for (uint32_t stage = 0; stage < kFrameTraceStageMax; stage++) {
+      if (!count[display][stage]) {
+        continue;
+      }
+
+      // The last bucket aggregates several displays, its percentiles span all of them.
+      std::vector<uint32_t> window;
+      for (auto &entry : durations) {
+        if (CounterIndex(entry.first.first) == display && entry.first.second == stage) {
+          window.insert(window.end(), entry.second.begin(), entry.second.end());
+        }
+      }
+
+      char name[16];
+      if (display == 0) {
+        snprintf(name, sizeof(name), "all");
+      } else if (display == kCounterDisplays - 1) {
+        snprintf(name, sizeof(name), "%u+", display - 1);
+      } else {
+        snprintf(name, sizeof(name), "%u", display - 1);
+      }
+      snprintf(line, sizeof(line), "%-8s %-18s %10" PRIu64 " %9.1f %9.1f %9.1f %9.1f\n", name,
+               kStageNames[stage], count[display][stage],
+               static_cast<double>(total_ns[display][stage] / count[display][stage]) / 1000.0,
+               Percentile(&window, 50) / 1000.0, Percentile(&window, 99) / 1000.0,
+               static_cast<double>(max_ns[display][stage]) / 1000.0);
+      *os << line;
+    }
+  }
+}
+
+static DisplayError ExportBinary(FILE *file, const std::vector<TraceEvent> &events) {
+  FrameTraceFileHeader header = {};
+  header.magic = kFrameTraceMagic;
+  header.version = kFrameTraceVersion;
+  header.record_size = sizeof(FrameTraceFileRecord);
+  header.pid = static_cast<uint32_t>(getpid());
+  header.num_records = static_cast<uint32_t>(events.size());
+  if (fwrite(&header, sizeof(header), 1, file) != 1) {
+    return kErrorUndefined;
+  }
+
+  for (auto &event : events) {
+    FrameTraceFileRecord record = {};
+    record.start_ns = event.start_ns;
+    record.duration_ns = event.duration_ns;
+    record.tid = event.tid;
+    record.display_id = event.display_id;
+    record.stage = event.stage;
+    if (fwrite(&record, sizeof(record), 1, file) != 1) {
+      return kErrorUndefined;
+    }
+  }
+
+  return kErrorNone;
+}
+
+static DisplayError ExportJson(FILE *file, const std::vector<TraceEvent> &events) {
+  int pid = getpid();
+  fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for (size_t i = 0; i < events.size(); i++) {
+    const TraceEvent &event = events.at(i);
+    fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"sdm\",\"ph\":\"X\",\"ts\":%" PRId64 ".%03d,"
+            "\"dur\":%u.%03u,\"pid\":%d,\"tid\":%d,\"args\":{\"display\":%d}}", i ? "," : "",
+            kStageNames[event.stage < kFrameTraceStageMax ? event.stage : 0],
+            event.start_ns / 1000, static_cast<int>(event.start_ns % 1000),
+            event.duration_ns / 1000, event.duration_ns % 1000, pid, event.tid, event.display_id);
+  }
+  fprintf(file, "\n]}\n");
+  return ferror(file) ? kErrorUndefined : kErrorNone;
+}
+
+DisplayError FrameTrace::Export(const char *path, FrameTraceFormat format) {
+  FILE *file = fopen(path, "we");
+  if (!file) {
+    DLOGW("Failed to open %s, error = %s", path, strerror(errno));
+    return kErrorResources;
+  }
+
+  std::vector<TraceEvent> events = SnapshotAll();
+  DisplayError error = (format == kFrameTraceJson) ? ExportJson(file, events) :
+                                                     ExportBinary(file, events);
+  if (fclose(file) != 0 || error != kErrorNone) {
+    DLOGW("Failed to write %s", path);
+    return kErrorUndefined;
+  }
+
+  DLOGI("Exported %zu records to %s", events.size(), path);
+  return kErrorNone;
+}
+
+FrameTraceScope::FrameTraceScope(int32_t display_id, FrameTraceStage stage)
+  : display_id_(display_id), stage_(stage) {
+  parent_display_id_ = FrameTrace::SetThreadDisplay(display_id);
+  start_ns_ = FrameTrace::Now();
+}
+
+FrameTraceScope::~FrameTraceScope() {
+  FrameTrace::Record(display_id_, stage_, start_ns_, FrameTrace::Now());
+  FrameTrace::SetThreadDisplay(parent_display_id_);
+}
+
+#else
+
+void FrameTrace::Record(int32_t display_id, FrameTraceStage stage, int64_t start_ns,
+                        int64_t end_ns) {
+}
+
+int32_t FrameTrace::SetThreadDisplay(int32_t display_id) {
+  return -1;
+}
+
+void FrameTrace::Dump(std::ostringstream *os) {
+  *os << "\n------------Frame Trace------------\nCompiled out\n";
+}
+
+DisplayError FrameTrace::Export(const char *path, FrameTraceFormat format) {
+  return kErrorNotSupported;
+}
+
+FrameTraceScope::FrameTraceScope(int32_t display_id, FrameTraceStage stage)
+  : display_id_(display_id), parent_display_id_(-1), stage_(stage), start_ns_(0) {
+}
+
+FrameTraceScope::~FrameTraceScope() {
+}
+
+#endif  // FRAME_TRACE_ENABLE
+
+}  // namespace sdm
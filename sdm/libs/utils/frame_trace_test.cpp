@@ -0,0 +1,133 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+#include <utils/frame_trace.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace sdm;
+
+#ifdef FRAME_TRACE_ENABLE
+
+// Records of record i start at kStartNs + i * 1000 and last Duration(i), so that a slot mixing the
+// fields of two records does not pass CheckRecord().
+static const int64_t kStartNs = 1000000000LL;
+
+static int64_t Duration(int64_t i) {
+  return i % 997 + 1;
+}
+
+static void RecordNumber(int32_t display_id, int64_t i) {
+  int64_t start_ns = kStartNs + i * 1000;
+  FrameTrace::Record(display_id, kFrameTraceStrategy, start_ns, start_ns + Duration(i));
+}
+
+static bool CheckRecord(const FrameTraceFileRecord &record, int64_t *number) {
+  *number = (record.start_ns - kStartNs) / 1000;
+  return record.start_ns >= kStartNs && (record.start_ns - kStartNs) % 1000 == 0 &&
+         record.duration_ns == Duration(*number) && record.stage == kFrameTraceStrategy;
+}
+
+// Exports the binary trace and returns the records of display_id in export order.
+static std::vector<FrameTraceFileRecord> ExportRecords(int32_t display_id) {
+  std::string path = ::testing::TempDir() + "frame_trace_test.bin";
+  std::vector<FrameTraceFileRecord> records;
+  EXPECT_EQ(FrameTrace::Export(path.c_str(), kFrameTraceBinary), kErrorNone);
+  FILE *file = fopen(path.c_str(), "re");
+  if (!file) {
+    ADD_FAILURE() << "Failed to open " << path;
+    return records;
+  }
+
+  FrameTraceFileHeader header = {};
+  EXPECT_EQ(fread(&header, sizeof(header), 1, file), 1u);
+  EXPECT_EQ(header.magic, kFrameTraceMagic);
+  EXPECT_EQ(header.record_size, sizeof(FrameTraceFileRecord));
+  FrameTraceFileRecord record = {};
+  for (uint32_t i = 0; i < header.num_records && fread(&record, sizeof(record), 1, file); i++) {
+    if (record.display_id == display_id) {
+      records.push_back(record);
+    }
+  }
+  fclose(file);
+  unlink(path.c_str());
+  return records;
+}
+
+TEST(FrameTraceTest, KeepsTheLatestRecordsOfAThread) {
+  const int32_t kDisplay = 5;
+  const int64_t kRecords = 5000;
+  std::thread writer([&] {
+    for (int64_t i = 0; i < kRecords; i++) {
+      RecordNumber(kDisplay, i);
+    }
+  });
+  writer.join();
+
+  // The ring wrapped, what is left is a contiguous run ending at the last record.
+  std::vector<FrameTraceFileRecord> records = ExportRecords(kDisplay);
+  ASSERT_FALSE(records.empty());
+  EXPECT_LT(records.size(), size_t(kRecords));
+  int64_t expected = kRecords - static_cast<int64_t>(records.size());
+  for (auto &record : records) {
+    int64_t number = 0;
+    ASSERT_TRUE(CheckRecord(record, &number));
+    EXPECT_EQ(number, expected++);
+  }
+}
+
+TEST(FrameTraceTest, DropsSlotsOverwrittenWhileRead) {
+  const int32_t kDisplay = 6;
+  std::atomic<bool> stop(false);
+  std::thread writer([&] {
+    for (int64_t i = 0; !stop.load(std::memory_order_relaxed); i++) {
+      RecordNumber(kDisplay, i);
+    }
+  });
+
+  // Every export races the writer lapping the ring. Stale slots are dropped from the front of the
+  // copy, so a stale slot left in it either mixes two records or leaves a gap in the run.
+  for (int pass = 0; pass < 1000; pass++) {
+    std::vector<FrameTraceFileRecord> records = ExportRecords(kDisplay);
+    int64_t previous = -1;
+    for (auto &record : records) {
+      int64_t number = 0;
+      ASSERT_TRUE(CheckRecord(record, &number)) << "pass " << pass;
+      if (previous >= 0) {
+        ASSERT_EQ(number, previous + 1) << "pass " << pass;
+      }
+      previous = number;
+    }
+  }
+
+  stop.store(true, std::memory_order_relaxed);
+  writer.join();
+}
+
+#endif  // FRAME_TRACE_ENABLE
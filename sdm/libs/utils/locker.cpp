@@ -0,0 +1,350 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/locker.h>
+#include <utils/constants.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <mutex>
+
+namespace sdm {
+
+static const uint32_t kMaxSites = 8;     // Call sites kept per lock, the last one collects the rest
+static const uint32_t kDumpLockers = 8;  // Locks listed by DumpProfile()
+static const uint32_t kDumpSites = 4;    // Call sites listed per lock
+static const char *kOtherSites = "<other>";
+
+struct LockerProfile {
+  struct Site {
+    std::atomic<const char *> site;
+    std::atomic<uint64_t> acquisitions;
+    std::atomic<uint64_t> contended;
+    std::atomic<uint64_t> wait_ns;
+    std::atomic<uint64_t> hold_ns;
+    std::atomic<uint64_t> blocking;
+  };
+
+  const Locker *locker = nullptr;
+  std::atomic<int32_t> owner_tid;
+  std::atomic<const char *> owner_site;
+  std::atomic<int64_t> owner_since_ns;
+  std::atomic<uint64_t> acquisitions;
+  std::atomic<uint64_t> contended;
+  std::atomic<uint64_t> wait_ns;
+  std::atomic<uint64_t> max_wait_ns;
+  std::atomic<uint64_t> hold_ns;
+  std::atomic<uint64_t> max_hold_ns;
+  std::atomic<uint64_t> cond_waits;
+  std::atomic<uint64_t> cond_wait_ns;
+  std::atomic<uint64_t> wait_histogram[kLockerHistogramBuckets];
+  std::atomic<uint64_t> hold_histogram[kLockerHistogramBuckets];
+  Site sites[kMaxSites];
+};
+
+// Profiles are published here for DumpProfile(). The registry lock is a leaf, it is taken with a
+// Locker held but never the other way round. It is never destroyed so that static locks may
+// still unregister during exit.
+struct LockerRegistry {
+  std::mutex mutex;
+  std::vector<LockerProfile *> profiles;
+};
+
+static LockerRegistry *GetRegistry() {
+  static LockerRegistry *registry = new LockerRegistry();
+  return registry;
+}
+
+std::atomic<bool> Locker::profiling_(false);
+
+static int64_t Now() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Counters have a single writer, the thread holding the lock, so they need no read-modify-write.
+static void Add(std::atomic<uint64_t> *counter, uint64_t value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static void Max(std::atomic<uint64_t> *counter, uint64_t value) {
+  if (value > counter->load(std::memory_order_relaxed)) {
+    counter->store(value, std::memory_order_relaxed);
+  }
+}
+
+static uint32_t GetBucket(uint64_t ns) {
+  uint64_t us = ns / 1000;
+  uint32_t bucket = 0;
+  while (us && bucket < kLockerHistogramBuckets - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+static LockerProfile::Site *GetSite(LockerProfile *profile, const char *site) {
+  for (uint32_t i = 0; i < kMaxSites - 1; i++) {
+    LockerProfile::Site *entry = &profile->sites[i];
+    const char *entry_site = entry->site.load(std::memory_order_relaxed);
+    if (entry_site == site) {
+      return entry;
+    }
+    if (!entry_site) {
+      entry->site.store(site, std::memory_order_relaxed);
+      return entry;
+    }
+  }
+  return &profile->sites[kMaxSites - 1];
+}
+
+void Locker::EnableProfiling(bool enable) {
+  profiling_.store(enable, std::memory_order_relaxed);
+}
+
+void Locker::LockProfiled(const char *site) {
+  int64_t start_ns = Now();
+  int ret = pthread_mutex_trylock(&mutex_);
+  if (ret != EBUSY) {
+    OnAcquired(site, 0, false, nullptr);
+    return;
+  }
+
+  // Owner fields are read without the lock, so the blocker is a best effort snapshot.
+  LockerProfile *profile = profile_.load(std::memory_order_acquire);
+  const char *blocker = profile ? profile->owner_site.load(std::memory_order_relaxed) : nullptr;
+  pthread_mutex_lock(&mutex_);
+  OnAcquired(site, Now() - start_ns, true, blocker);
+}
+
+void Locker::OnAcquired(const char *site, int64_t wait_ns, bool contended, const char *blocker) {
+  LockerProfile *profile = profile_.load(std::memory_order_relaxed);
+  if (!profile) {
+    // Value-initialized so that the counters start out zero.
+    profile = new LockerProfile();
+    profile->locker = this;
+    profile->sites[kMaxSites - 1].site.store(kOtherSites, std::memory_order_relaxed);
+    profile_.store(profile, std::memory_order_release);
+    LockerRegistry *registry = GetRegistry();
+    std::lock_guard<std::mutex> registry_lock(registry->mutex);
+    registry->profiles.push_back(profile);
+  }
+
+  uint64_t wait = UINT64(wait_ns);
+  LockerProfile::Site *entry = GetSite(profile, site ? site : kOtherSites);
+  Add(&profile->acquisitions, 1);
+  Add(&entry->acquisitions, 1);
+  if (contended) {
+    Add(&profile->contended, 1);
+    Add(&profile->wait_ns, wait);
+    Max(&profile->max_wait_ns, wait);
+    Add(&entry->contended, 1);
+    Add(&entry->wait_ns, wait);
+    if (blocker) {
+      Add(&GetSite(profile, blocker)->blocking, 1);
+    }
+  }
+  Add(&profile->wait_histogram[GetBucket(wait)], 1);
+
+  hold_start_ns_ = Now();
+  hold_site_ = site ? site : kOtherSites;
+  profile->owner_since_ns.store(hold_start_ns_, std::memory_order_relaxed);
+  profile->owner_site.store(hold_site_, std::memory_order_relaxed);
+  profile->owner_tid.store(static_cast<int32_t>(syscall(SYS_gettid)), std::memory_order_relaxed);
+}
+
+void Locker::OnReleased() {
+  LockerProfile *profile = profile_.load(std::memory_order_relaxed);
+  uint64_t hold = UINT64(Now() - hold_start_ns_);
+  Add(&profile->hold_ns, hold);
+  Max(&profile->max_hold_ns, hold);
+  Add(&profile->hold_histogram[GetBucket(hold)], 1);
+  Add(&GetSite(profile, hold_site_)->hold_ns, hold);
+
+  profile->owner_tid.store(0, std::memory_order_relaxed);
+  profile->owner_site.store(nullptr, std::memory_order_relaxed);
+  hold_start_ns_ = 0;
+  hold_site_ = nullptr;
+}
+
+int Locker::WaitProfiled(const struct timespec *abs_time) {
+  // The condition wait drops the lock, so it ends the current hold and starts a new one on wake up.
+  const char *site = hold_site_;
+  OnReleased();
+  int64_t start_ns = Now();
+  int ret = abs_time ? pthread_cond_timedwait(&condition_, &mutex_, abs_time) :
+                       pthread_cond_wait(&condition_, &mutex_);
+  LockerProfile *profile = profile_.load(std::memory_order_relaxed);
+  Add(&profile->cond_waits, 1);
+  Add(&profile->cond_wait_ns, UINT64(Now() - start_ns));
+  OnAcquired(site, 0, false, nullptr);
+
+  return ret;
+}
+
+void Locker::ReleaseProfile() {
+  LockerProfile *profile = profile_.exchange(nullptr);
+  LockerRegistry *registry = GetRegistry();
+  {
+    std::lock_guard<std::mutex> registry_lock(registry->mutex);
+    auto &profiles = registry->profiles;
+    profiles.erase(std::remove(profiles.begin(), profiles.end(), profile), profiles.end());
+  }
+  delete profile;
+}
+
+static void CopyStats(const LockerProfile &profile, LockerStats *stats) {
+  *stats = {};
+  stats->acquisitions = profile.acquisitions.load(std::memory_order_relaxed);
+  stats->contended = profile.contended.load(std::memory_order_relaxed);
+  stats->wait_ns = profile.wait_ns.load(std::memory_order_relaxed);
+  stats->max_wait_ns = profile.max_wait_ns.load(std::memory_order_relaxed);
+  stats->hold_ns = profile.hold_ns.load(std::memory_order_relaxed);
+  stats->max_hold_ns = profile.max_hold_ns.load(std::memory_order_relaxed);
+  stats->cond_waits = profile.cond_waits.load(std::memory_order_relaxed);
+  stats->cond_wait_ns = profile.cond_wait_ns.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < kLockerHistogramBuckets; i++) {
+    stats->wait_histogram[i] = profile.wait_histogram[i].load(std::memory_order_relaxed);
+    stats->hold_histogram[i] = profile.hold_histogram[i].load(std::memory_order_relaxed);
+  }
+  stats->owner_tid = profile.owner_tid.load(std::memory_order_relaxed);
+  stats->owner_site = profile.owner_site.load(std::memory_order_relaxed);
+  stats->owner_since_ns = profile.owner_since_ns.load(std::memory_order_relaxed);
+
+  for (auto &entry : profile.sites) {
+    LockerSiteStats site;
+    site.acquisitions = entry.acquisitions.load(std::memory_order_relaxed);
+    if (!site.acquisitions && !entry.blocking.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    site.site = entry.site.load(std::memory_order_relaxed);
+    site.contended = entry.contended.load(std::memory_order_relaxed);
+    site.wait_ns = entry.wait_ns.load(std::memory_order_relaxed);
+    site.hold_ns = entry.hold_ns.load(std::memory_order_relaxed);
+    site.blocking = entry.blocking.load(std::memory_order_relaxed);
+    stats->sites.push_back(site);
+  }
+}
+
+bool Locker::GetStats(LockerStats *stats) const {
+  LockerRegistry *registry = GetRegistry();
+  std::lock_guard<std::mutex> registry_lock(registry->mutex);
+  for (auto profile : registry->profiles) {
+    if (profile->locker == this) {
+      CopyStats(*profile, stats);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void DumpHistogram(const char *label, const uint64_t *histogram, std::ostringstream *os) {
+  *os << "\n    " << label << " us:";
+  for (uint32_t i = 0; i < kLockerHistogramBuckets; i++) {
+    if (!histogram[i]) {
+      continue;
+    }
+    if (i == kLockerHistogramBuckets - 1) {
+      *os << " >=" << (1u << (i - 1)) << ":" << histogram[i];
+    } else {
+      *os << " <" << (1u << i) << ":" << histogram[i];
+    }
+  }
+}
+
+void Locker::DumpProfile(std::ostringstream *os) {
+  struct Entry {
+    char name[64];
+    LockerStats stats;
+  };
+  std::vector<Entry> entries;
+  {
+    LockerRegistry *registry = GetRegistry();
+    std::lock_guard<std::mutex> registry_lock(registry->mutex);
+    if (!IsProfiling() && registry->profiles.empty()) {
+      return;
+    }
+    entries.resize(registry->profiles.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+      const LockerProfile *profile = registry->profiles[i];
+      const Locker *locker = profile->locker;
+      if (locker->name_ && locker->name_index_ >= 0) {
+        snprintf(entries[i].name, sizeof(entries[i].name), "%s[%d]", locker->name_,
+                 locker->name_index_);
+      } else if (locker->name_) {
+        snprintf(entries[i].name, sizeof(entries[i].name), "%s", locker->name_);
+      } else {
+        snprintf(entries[i].name, sizeof(entries[i].name), "%p", locker);
+      }
+      CopyStats(*profile, &entries[i].stats);
+    }
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+    return a.stats.wait_ns > b.stats.wait_ns;
+  });
+
+  char line[256];
+  int64_t now = Now();
+  *os << "\n------------Lock Contention------------";
+  *os << "\nProfiling: " << (IsProfiling() ? "on" : "off") << ", " << entries.size() << " locks";
+  for (size_t i = 0; i < std::min(entries.size(), size_t(kDumpLockers)); i++) {
+    const LockerStats &stats = entries[i].stats;
+    snprintf(line, sizeof(line), "\n%s: acquires %" PRIu64 " contended %" PRIu64 " wait %.3f ms"
+             " (max %" PRIu64 " us) hold %.3f ms (max %" PRIu64 " us) cond waits %" PRIu64
+             " (%.3f ms)", entries[i].name, stats.acquisitions, stats.contended,
+             DOUBLE(stats.wait_ns) / 1000000.0, stats.max_wait_ns / 1000,
+             DOUBLE(stats.hold_ns) / 1000000.0, stats.max_hold_ns / 1000, stats.cond_waits,
+             DOUBLE(stats.cond_wait_ns) / 1000000.0);
+    *os << line;
+    if (stats.owner_tid) {
+      snprintf(line, sizeof(line), "\n    held by tid %d in %s for %" PRId64 " us", stats.owner_tid,
+               stats.owner_site ? stats.owner_site : kOtherSites,
+               (now - stats.owner_since_ns) / 1000);
+      *os << line;
+    }
+    DumpHistogram("wait", stats.wait_histogram, os);
+    DumpHistogram("hold", stats.hold_histogram, os);
+
+    std::vector<LockerSiteStats> sites = stats.sites;
+    std::sort(sites.begin(), sites.end(), [](const LockerSiteStats &a, const LockerSiteStats &b) {
+      return (a.wait_ns + a.hold_ns) > (b.wait_ns + b.hold_ns);
+    });
+    for (size_t j = 0; j < std::min(sites.size(), size_t(kDumpSites)); j++) {
+      snprintf(line, sizeof(line), "\n    %s: acquires %" PRIu64 " contended %" PRIu64
+               " wait %.3f ms hold %.3f ms blocked others %" PRIu64, sites[j].site,
+               sites[j].acquisitions, sites[j].contended, DOUBLE(sites[j].wait_ns) / 1000000.0,
+               DOUBLE(sites[j].hold_ns) / 1000000.0, sites[j].blocking);
+      *os << line;
+    }
+  }
+  *os << "\n---------------------------------------\n";
+}
+
+}  // namespace sdm
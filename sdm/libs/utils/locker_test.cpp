@@ -0,0 +1,165 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+#include <utils/locker.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace sdm;
+using namespace std::chrono_literals;
+
+static const int kThreads = 4;
+static const int kIterations = 200;
+static const auto kHoldTime = 20us;
+
+static void HoldLock(Locker *locker) {
+  SCOPE_LOCK(*locker);
+  auto start = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - start < kHoldTime) {
+  }
+}
+
+static uint64_t Sum(const uint64_t *histogram) {
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < kLockerHistogramBuckets; i++) {
+    sum += histogram[i];
+  }
+  return sum;
+}
+
+class LockerProfileTest : public ::testing::Test {
+  void SetUp() { Locker::EnableProfiling(true); }
+  void TearDown() { Locker::EnableProfiling(false); }
+};
+
+TEST(LockerProfileDisabled, RecordsNothing) {
+  Locker locker;
+  Locker::EnableProfiling(false);
+  HoldLock(&locker);
+  EXPECT_EQ(locker.TryLock(), 0);
+  locker.Unlock();
+
+  LockerStats stats;
+  EXPECT_FALSE(locker.GetStats(&stats));
+}
+
+TEST_F(LockerProfileTest, ContendedStatsAddUp) {
+  Locker locker;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; i++) {
+    threads.emplace_back([&locker] {
+      for (int j = 0; j < kIterations; j++) {
+        HoldLock(&locker);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  LockerStats stats;
+  ASSERT_TRUE(locker.GetStats(&stats));
+  const uint64_t total = kThreads * kIterations;
+  EXPECT_EQ(stats.acquisitions, total);
+  EXPECT_GT(stats.contended, 0u);
+  EXPECT_LE(stats.contended, total);
+  EXPECT_EQ(Sum(stats.wait_histogram), total);
+  EXPECT_EQ(Sum(stats.hold_histogram), total);
+  EXPECT_EQ(stats.hold_histogram[0], 0u);
+  EXPECT_GE(stats.hold_ns, total * std::chrono::nanoseconds(kHoldTime).count());
+  EXPECT_GE(stats.max_hold_ns, std::chrono::nanoseconds(kHoldTime).count());
+  EXPECT_GE(stats.wait_ns, stats.max_wait_ns);
+  EXPECT_EQ(stats.owner_tid, 0);
+
+  ASSERT_EQ(stats.sites.size(), 1u);
+  EXPECT_STREQ(stats.sites[0].site, "HoldLock");
+  EXPECT_EQ(stats.sites[0].acquisitions, total);
+  EXPECT_EQ(stats.sites[0].contended, stats.contended);
+  EXPECT_EQ(stats.sites[0].wait_ns, stats.wait_ns);
+  EXPECT_EQ(stats.sites[0].hold_ns, stats.hold_ns);
+  EXPECT_LE(stats.sites[0].blocking, stats.contended);
+}
+
+TEST_F(LockerProfileTest, ReportsOwner) {
+  Locker locker;
+  {
+    SCOPE_LOCK(locker);
+    std::thread reader([&locker] {
+      LockerStats stats;
+      ASSERT_TRUE(locker.GetStats(&stats));
+      EXPECT_NE(stats.owner_tid, 0);
+      EXPECT_NE(stats.owner_tid, static_cast<int32_t>(syscall(SYS_gettid)));
+      EXPECT_STREQ(stats.owner_site, "TestBody");
+    });
+    reader.join();
+  }
+
+  LockerStats stats;
+  ASSERT_TRUE(locker.GetStats(&stats));
+  EXPECT_EQ(stats.owner_tid, 0);
+  EXPECT_EQ(stats.acquisitions, 1u);
+}
+
+TEST_F(LockerProfileTest, SequenceWaitEndsHold) {
+  Locker locker;
+  {
+    SEQUENCE_ENTRY_SCOPE_LOCK(locker);
+  }
+  std::thread waiter([&locker] {
+    SEQUENCE_WAIT_SCOPE_LOCK(locker);
+    EXPECT_FALSE(lock.IsError());
+  });
+  std::this_thread::sleep_for(10ms);
+  {
+    SEQUENCE_EXIT_SCOPE_LOCK(locker);
+  }
+  waiter.join();
+
+  LockerStats stats;
+  ASSERT_TRUE(locker.GetStats(&stats));
+  EXPECT_EQ(stats.cond_waits, 1u);
+  EXPECT_GE(stats.cond_wait_ns, std::chrono::nanoseconds(5ms).count());
+  // Time spent waiting on the condition does not count as holding the lock.
+  EXPECT_LT(stats.hold_ns, stats.cond_wait_ns);
+  // Entry, exit, the waiter and its reacquisition after waking up.
+  EXPECT_EQ(stats.acquisitions, 4u);
+}
+
+TEST_F(LockerProfileTest, DumpListsNamedLock) {
+  Locker locker;
+  locker.SetName("test_locker", 3);
+  HoldLock(&locker);
+
+  std::ostringstream os;
+  Locker::DumpProfile(&os);
+  std::string dump = os.str();
+  EXPECT_NE(dump.find("test_locker[3]: acquires 1 "), std::string::npos) << dump;
+  EXPECT_NE(dump.find("HoldLock: acquires 1 "), std::string::npos) << dump;
+}
@@ -350,5 +350,137 @@ DisplayError GetScaleFactor(const LayerRect &crop, const LayerRect &dst,
   return kErrorNone;
 }
 
-}  // namespace sdm
+float Area(const LayerRect &rect) {
+  if (!IsValid(rect)) {
+    return 0.0f;
+  }
+
+  return (rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+// Grows rect to the alignment and minimum size restrictions, keeping it inside bound.
+void AlignRect(const RectConstraints &constraints, const LayerRect &bound, LayerRect *rect) {
+  if (!IsValid(*rect) || !IsValid(bound)) {
+    return;
+  }
+
+  uint32_t left = FloorToMultipleOf(UINT32(rect->left), std::max(constraints.left_align, 1u));
+  uint32_t top = FloorToMultipleOf(UINT32(rect->top), std::max(constraints.top_align, 1u));
+  uint32_t width = UINT32(ceilf(rect->right)) - left;
+  uint32_t height = UINT32(ceilf(rect->bottom)) - top;
+
+  width = CeilToMultipleOf(std::max(width, constraints.min_width),
+                           std::max(constraints.width_align, 1u));
+  height = CeilToMultipleOf(std::max(height, constraints.min_height),
+                            std::max(constraints.height_align, 1u));
+
+  rect->left = FLOAT(left);
+  rect->top = FLOAT(top);
+  rect->right = FLOAT(left + width);
+  rect->bottom = FLOAT(top + height);
+
+  // Slide back inside the bound before clipping, so that the size restriction still holds.
+  if (rect->right > bound.right) {
+    float shift = std::min(rect->right - bound.right, rect->left - bound.left);
+    rect->left -= shift;
+    rect->right -= shift;
+  }
+  if (rect->bottom > bound.bottom) {
+    float shift = std::min(rect->bottom - bound.bottom, rect->top - bound.top);
+    rect->top -= shift;
+    rect->bottom -= shift;
+  }
+
+  *rect = Intersection(*rect, bound);
+}
+
+// The pairwise merge below is cubic in the number of rects, inputs beyond this are pre-merged.
+static const size_t kMaxCoalesceInput = 16;
+
+// Merges in_rects into at most max_rects disjoint aligned rects. Each rect is charged rect_cost
+// pixels of fixed overhead, so rects are also merged when the extra area is cheaper than a separate
+// rect. Returns the total area of out_rects. pair_count, if given, receives the number of rect
+// pairs whose merge cost was evaluated, the work done independent of the machine.
+float CoalesceRects(const std::vector<LayerRect> &in_rects, uint32_t max_rects, float rect_cost,
+                    const RectConstraints &constraints, const LayerRect &bound,
+                    std::vector<LayerRect> *out_rects, uint32_t *pair_count) {
+  std::vector<LayerRect> &rects = *out_rects;
+  rects.clear();
+  uint32_t pairs = 0;
+
+  for (auto &in_rect : in_rects) {
+    LayerRect rect = in_rect;
+    AlignRect(constraints, bound, &rect);
+    if (IsValid(rect)) {
+      rects.push_back(rect);
+    }
+  }
 
+  // Fold runs of rects that are close in scan order, so a frame with a lot of scattered damage
+  // costs the same as one with kMaxCoalesceInput rects.
+  if (rects.size() > kMaxCoalesceInput) {
+    std::sort(rects.begin(), rects.end(), [](const LayerRect &a, const LayerRect &b) {
+      return (a.top < b.top) || ((a.top == b.top) && (a.left < b.left));
+    });
+
+    size_t run = (rects.size() + kMaxCoalesceInput - 1) / kMaxCoalesceInput;
+    size_t count = 0;
+    for (size_t i = 0; i < rects.size(); i += run) {
+      LayerRect rect = rects[i];
+      for (size_t j = i + 1; j < std::min(i + run, rects.size()); j++) {
+        rect = Union(rect, rects[j]);
+      }
+      AlignRect(constraints, bound, &rect);
+      rects[count++] = rect;
+    }
+    rects.resize(count);
+  }
+
+  max_rects = std::max(max_rects, 1u);
+
+  while (rects.size() > 1) {
+    size_t merge_i = 0, merge_j = 1;
+    float min_cost = 0.0f;
+    LayerRect merged = {};
+
+    for (size_t i = 0; i < rects.size(); i++) {
+      for (size_t j = i + 1; j < rects.size(); j++) {
+        pairs++;
+        LayerRect rect = Union(rects[i], rects[j]);
+        AlignRect(constraints, bound, &rect);
+        float overlap = Area(Intersection(rects[i], rects[j]));
+        float cost = Area(rect) - (Area(rects[i]) + Area(rects[j]) - overlap) - rect_cost;
+        // Overlapping rects are always merged, the resulting rects must be disjoint.
+        if (overlap > 0.0f) {
+          cost = std::min(cost, 0.0f);
+        }
+        if ((i == 0 && j == 1) || cost < min_cost) {
+          min_cost = cost;
+          merge_i = i;
+          merge_j = j;
+          merged = rect;
+        }
+      }
+    }
+
+    if ((rects.size() <= max_rects) && (min_cost > 0.0f)) {
+      break;
+    }
+
+    rects[merge_i] = merged;
+    rects.erase(rects.begin() + static_cast<std::ptrdiff_t>(merge_j));
+  }
+
+  if (pair_count) {
+    *pair_count = pairs;
+  }
+
+  float area = 0.0f;
+  for (auto &rect : rects) {
+    area += Area(rect);
+  }
+
+  return area;
+}
+
+}  // namespace sdm
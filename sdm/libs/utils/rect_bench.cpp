@@ -0,0 +1,126 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Measures CoalesceRects() on synthetic damage: frames of random rects, in the counts and sizes of
+// common updates from a blinking cursor up to a particle animation. Prints the CPU time and the
+// merge pairs evaluated per frame, and the share of the panel the resulting ROIs fetch.
+
+#include <inttypes.h>
+#include <private/hw_info_types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <utils/constants.h>
+#include <utils/rect.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using sdm::LayerRect;
+using sdm::RectConstraints;
+
+static const LayerRect kBound = {0, 0, 1080, 2336};
+static const float kRectCost = 1080 * 8;
+static const int kDefaultFrames = 2000;
+
+struct DamageKind {
+  const char *name;
+  uint32_t rects;
+  uint32_t max_size;
+};
+
+static const DamageKind kDamageKinds[] = {
+  {"cursor", 2, 32},
+  {"status_bar", 6, 96},
+  {"keyboard", 12, 160},
+  {"scattered_icons", 64, 96},
+  {"particles", 512, 24},
+};
+
+static LayerRect RandomRect(std::mt19937 *rng, uint32_t max_size) {
+  uint32_t width = std::uniform_int_distribution<uint32_t>(1, max_size)(*rng);
+  uint32_t height = std::uniform_int_distribution<uint32_t>(1, max_size)(*rng);
+  float left = FLOAT((*rng)() % (UINT32(kBound.right) - 1));
+  float top = FLOAT((*rng)() % (UINT32(kBound.bottom) - 1));
+
+  return LayerRect(left, top, std::min(left + FLOAT(width), kBound.right),
+                   std::min(top + FLOAT(height), kBound.bottom));
+}
+
+static int64_t ThreadCpuNs() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  int frames = kDefaultFrames;
+  int opt;
+  while ((opt = getopt(argc, argv, "f:h")) != -1) {
+    switch (opt) {
+      case 'f': frames = atoi(optarg); break;
+      default: fprintf(stderr, "usage: %s [-f frames]\n", argv[0]); return 2;
+    }
+  }
+  frames = std::max(frames, 1);
+
+  RectConstraints constraints = {};
+  constraints.left_align = 4;
+  constraints.width_align = 4;
+  constraints.top_align = 2;
+  constraints.height_align = 2;
+  constraints.min_width = 8;
+  constraints.min_height = 8;
+
+  printf("%d frames per kind, time in us of thread CPU\n", frames);
+  printf("%-16s %6s %9s %8s %8s\n", "damage", "rects", "us/frame", "pairs", "fetched");
+
+  std::mt19937 rng(0x5eed);
+  for (auto &kind : kDamageKinds) {
+    std::vector<std::vector<LayerRect>> damage(UINT32(frames));
+    for (auto &frame : damage) {
+      for (uint32_t i = 0; i < kind.rects; i++) {
+        frame.push_back(RandomRect(&rng, kind.max_size));
+      }
+    }
+
+    std::vector<LayerRect> out_rects;
+    float area = 0.0f;
+    uint64_t pairs = 0;
+    int64_t start_ns = ThreadCpuNs();
+    for (auto &frame : damage) {
+      uint32_t frame_pairs = 0;
+      area += sdm::CoalesceRects(frame, sdm::kMaxFrameROIs, kRectCost, constraints, kBound,
+                                 &out_rects, &frame_pairs);
+      pairs += frame_pairs;
+    }
+    double frame_us = static_cast<double>(ThreadCpuNs() - start_ns) / 1000.0 / frames;
+
+    printf("%-16s %6u %9.2f %8" PRIu64 " %7.1f%%\n", kind.name, kind.rects, frame_us,
+           pairs / UINT64(frames), 100.0f * area / (sdm::Area(kBound) * FLOAT(frames)));
+  }
+
+  return 0;
+}
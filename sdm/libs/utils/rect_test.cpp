@@ -0,0 +1,181 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <gtest/gtest.h>
+#include <utils/rect.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace sdm;
+
+static const LayerRect kBound = {0, 0, 1080, 2336};
+static const float kRectCost = 1080 * 8;
+
+static LayerRect RandomRect(std::mt19937 *rng, uint32_t max_size) {
+  uint32_t width = std::uniform_int_distribution<uint32_t>(1, max_size)(*rng);
+  uint32_t height = std::uniform_int_distribution<uint32_t>(1, max_size)(*rng);
+  float left = FLOAT((*rng)() % (UINT32(kBound.right) - 1));
+  float top = FLOAT((*rng)() % (UINT32(kBound.bottom) - 1));
+
+  return LayerRect(left, top, std::min(left + FLOAT(width), kBound.right),
+                   std::min(top + FLOAT(height), kBound.bottom));
+}
+
+static RectConstraints RandomConstraints(std::mt19937 *rng) {
+  static const uint32_t kAligns[] = {1, 2, 4, 8};
+  RectConstraints constraints;
+  constraints.left_align = kAligns[(*rng)() % 4];
+  constraints.width_align = kAligns[(*rng)() % 4];
+  constraints.top_align = kAligns[(*rng)() % 4];
+  constraints.height_align = kAligns[(*rng)() % 4];
+  constraints.min_width = 1 + (*rng)() % 64;
+  constraints.min_height = 1 + (*rng)() % 64;
+  return constraints;
+}
+
+// Checks the guarantees CoalesceFrameROI() relies on and returns the first violation, if any.
+static std::string CheckCoalesced(const std::vector<LayerRect> &in_rects, uint32_t max_rects,
+                                  const RectConstraints &constraints,
+                                  const std::vector<LayerRect> &out_rects, float area) {
+  if (out_rects.size() > max_rects) {
+    return "too many rects";
+  }
+
+  float total = 0.0f;
+  for (size_t i = 0; i < out_rects.size(); i++) {
+    const LayerRect &rect = out_rects[i];
+    if (!IsValid(rect) || !Contains(kBound, rect)) {
+      return "rect outside of bound";
+    }
+    // Rects pushed back inside the bound at the right or bottom edge keep their size only.
+    if ((rect.right < kBound.right) &&
+        ((UINT32(rect.left) % constraints.left_align) ||
+         (UINT32(rect.right - rect.left) % constraints.width_align))) {
+      return "rect not aligned horizontally";
+    }
+    if ((rect.bottom < kBound.bottom) &&
+        ((UINT32(rect.top) % constraints.top_align) ||
+         (UINT32(rect.bottom - rect.top) % constraints.height_align))) {
+      return "rect not aligned vertically";
+    }
+    if ((rect.right - rect.left < constraints.min_width) ||
+        (rect.bottom - rect.top < constraints.min_height)) {
+      return "rect below minimum size";
+    }
+    for (size_t j = i + 1; j < out_rects.size(); j++) {
+      if (IsValid(Intersection(rect, out_rects[j]))) {
+        return "rects overlap";
+      }
+    }
+    total += Area(rect);
+  }
+
+  if (total != area) {
+    return "returned area does not match";
+  }
+
+  // Rects are only ever merged whole, so every aligned damage rect lies within one output rect.
+  for (auto &in_rect : in_rects) {
+    LayerRect rect = in_rect;
+    AlignRect(constraints, kBound, &rect);
+    bool covered = false;
+    for (auto &out_rect : out_rects) {
+      covered = covered || Contains(out_rect, rect);
+    }
+    if (!covered) {
+      return "damage not covered";
+    }
+  }
+
+  return "";
+}
+
+TEST(CoalesceRectsTest, RandomDamageKeepsInvariants) {
+  std::mt19937 rng(0x28);
+
+  for (int i = 0; i < 2000; i++) {
+    RectConstraints constraints = RandomConstraints(&rng);
+    uint32_t max_rects = 1 + rng() % 4;
+    uint32_t count = 1 + rng() % 40;
+    uint32_t max_size = (rng() % 2) ? 64 : 1080;
+    std::vector<LayerRect> in_rects;
+    for (uint32_t j = 0; j < count; j++) {
+      in_rects.push_back(RandomRect(&rng, max_size));
+    }
+
+    std::vector<LayerRect> out_rects;
+    float area = CoalesceRects(in_rects, max_rects, kRectCost, constraints, kBound, &out_rects);
+    ASSERT_EQ("", CheckCoalesced(in_rects, max_rects, constraints, out_rects, area))
+        << "iteration " << i;
+  }
+}
+
+TEST(CoalesceRectsTest, DistantRectsStaySeparate) {
+  std::vector<LayerRect> in_rects = {{0, 0, 100, 40}, {0, 2000, 100, 2040}};
+  std::vector<LayerRect> out_rects;
+
+  float area = CoalesceRects(in_rects, 2, kRectCost, {}, kBound, &out_rects);
+  EXPECT_EQ(2u, out_rects.size());
+  EXPECT_EQ(8000.0f, area);
+
+  // With a single ROI both have to be covered by one rect.
+  area = CoalesceRects(in_rects, 1, kRectCost, {}, kBound, &out_rects);
+  ASSERT_EQ(1u, out_rects.size());
+  EXPECT_EQ(100.0f * 2040.0f, area);
+}
+
+TEST(CoalesceRectsTest, NearbyRectsMergeBelowOverhead) {
+  // Two cursor sized rects a few lines apart are cheaper as one ROI.
+  std::vector<LayerRect> in_rects = {{10, 100, 20, 140}, {10, 144, 20, 184}};
+  std::vector<LayerRect> out_rects;
+
+  CoalesceRects(in_rects, 4, kRectCost, {}, kBound, &out_rects);
+  ASSERT_EQ(1u, out_rects.size());
+  EXPECT_TRUE(out_rects[0] == LayerRect(10, 100, 20, 184));
+}
+
+// The merge loop evaluates all pairs of the remaining rects for every merge. Scattered damage is
+// folded to 16 rects first, so however many rects come in, the work is at most that of merging 16
+// rects down to one: 120 + 105 + ... + 1 = 680 pairs.
+TEST(CoalesceRectsTest, ScatteredDamageWorkIsBounded) {
+  std::mt19937 rng(0x5eed);
+  RectConstraints constraints = {};
+  constraints.min_width = 8;
+  constraints.min_height = 8;
+
+  for (uint32_t count : {16u, 64u, 512u, 4096u}) {
+    std::vector<LayerRect> in_rects;
+    for (uint32_t i = 0; i < count; i++) {
+      in_rects.push_back(RandomRect(&rng, 24));
+    }
+
+    std::vector<LayerRect> out_rects;
+    uint32_t pairs = 0;
+    CoalesceRects(in_rects, 1, kRectCost, constraints, kBound, &out_rects, &pairs);
+    EXPECT_LE(pairs, 680u) << count << " rects";
+    EXPECT_EQ(1u, out_rects.size());
+  }
+}